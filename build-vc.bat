@@ -24,12 +24,20 @@ rem -- compile component --
 %COMPILE% component/Vector3r.cpp /Foobj/Vector3r.obj
 %COMPILE% component/OctreeAuxiliary.cpp /Foobj/OctreeAuxiliary.obj
 %COMPILE% component/OctreeImplementation.cpp /Foobj/OctreeImplementation.obj
+%COMPILE% component/OctreeLinear.cpp /Foobj/OctreeLinear.obj
+%COMPILE% component/OctreeStripedRoot.cpp /Foobj/OctreeStripedRoot.obj
+%COMPILE% component/OctreeLooseRoot.cpp /Foobj/OctreeLooseRoot.obj
+%COMPILE% component/OctreeFrozenRoot.cpp /Foobj/OctreeFrozenRoot.obj
+%COMPILE% component/OctreeAllocator.cpp /Foobj/OctreeAllocator.obj
+%COMPILE% component/OctreeTasks.cpp /Foobj/OctreeTasks.obj
 %COMPILE% component/Octree.cpp /Foobj/Octree.obj
 
 rem -- compile samples --
 %COMPILE% /Isamples samples/OctreeStreamOut.cpp /Foobj/OctreeStreamOut.obj
 %COMPILE% /Isamples samples/OctreeTest.cpp /Foobj/OctreeTest.obj
 %COMPILE% /Isamples samples/OctreeExample.cpp /Foobj/OctreeExample.obj
+%COMPILE% /Isamples samples/OctreeBench.cpp /Foobj/OctreeBench.obj
+%COMPILE% /Isamples samples/OctreeMesh.cpp /Foobj/OctreeMesh.obj
 
 
 rem -- link --------------------------------------------------------------------
@@ -37,10 +45,16 @@ rem -- link --------------------------------------------------------------------
 @echo --- link --
 
 rem -- link test sample --
-%LINKE% /OUT:octreetest.exe %LIBRARIES% obj/Array.obj obj/Vector3r.obj obj/OctreeAuxiliary.obj obj/OctreeImplementation.obj obj/Octree.obj obj/OctreeStreamOut.obj obj/OctreeTest.obj
+%LINKE% /OUT:octreetest.exe %LIBRARIES% obj/Array.obj obj/Vector3r.obj obj/OctreeAuxiliary.obj obj/OctreeImplementation.obj obj/OctreeLinear.obj obj/OctreeStripedRoot.obj obj/OctreeLooseRoot.obj obj/OctreeFrozenRoot.obj obj/OctreeAllocator.obj obj/OctreeTasks.obj obj/Octree.obj obj/OctreeStreamOut.obj obj/OctreeTest.obj
 
 rem -- link example sample --
-%LINKE% /OUT:octreeexample.exe %LIBRARIES% obj/Array.obj obj/Vector3r.obj obj/OctreeAuxiliary.obj obj/OctreeImplementation.obj obj/Octree.obj obj/OctreeExample.obj
+%LINKE% /OUT:octreeexample.exe %LIBRARIES% obj/Array.obj obj/Vector3r.obj obj/OctreeAuxiliary.obj obj/OctreeImplementation.obj obj/OctreeLinear.obj obj/OctreeStripedRoot.obj obj/OctreeLooseRoot.obj obj/OctreeFrozenRoot.obj obj/OctreeAllocator.obj obj/OctreeTasks.obj obj/Octree.obj obj/OctreeExample.obj
+
+rem -- link benchmark sample --
+%LINKE% /OUT:octreebench.exe %LIBRARIES% psapi.lib obj/Array.obj obj/Vector3r.obj obj/OctreeAuxiliary.obj obj/OctreeImplementation.obj obj/OctreeLinear.obj obj/OctreeStripedRoot.obj obj/OctreeLooseRoot.obj obj/OctreeFrozenRoot.obj obj/OctreeAllocator.obj obj/OctreeTasks.obj obj/Octree.obj obj/OctreeBench.obj
+
+rem -- link mesh sample --
+%LINKE% /OUT:octreemesh.exe %LIBRARIES% obj/Array.obj obj/Vector3r.obj obj/OctreeAuxiliary.obj obj/OctreeImplementation.obj obj/OctreeLinear.obj obj/OctreeStripedRoot.obj obj/OctreeLooseRoot.obj obj/OctreeFrozenRoot.obj obj/OctreeAllocator.obj obj/OctreeTasks.obj obj/Octree.obj obj/OctreeMesh.obj
 
 
 @echo.
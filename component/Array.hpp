@@ -53,11 +53,24 @@ namespace hxa7241_general
 /**
  * A simpler, compacter alternative to std::vector.<br/><br/>
  *
- * Length is explicit - there is no hidden reserve.<br/><br/>
+ * Length is explicit. Capacity is separate: append grows it geometrically (so
+ * appending is amortized constant time), and reserve and shrinkToFit set it
+ * directly. Nothing else changes it, except setLength beyond it.<br/><br/>
+ *
+ * setLength keeps the elements up to the lesser of the old and new lengths,
+ * whether or not it reallocates; the values of any added are unspecified.
+ * <br/><br/>
+ *
+ * Storage can be external: supplied by the owner of the array (eg. a buffer
+ * alongside it), and not deleted by it. Growing beyond it moves the elements
+ * to allocated storage. An array with external storage must not be swapped.
+ * <br/><br/>
  *
  * @invariants
- * * pStorage_m is 0 or a valid address<br/>
- * * length_m is >= 0 and <= getMaxLength() (DWORD_MAX)<br/>
+ * * pStorage_m is 0 or a valid address of capacity_m elements<br/>
+ * * length_m is >= 0 and <= capacity_m<br/>
+ * * capacity_m is >= 0 and <= getMaxLength() (DWORD_MAX)<br/>
+ * * isExternal_m is true only if pStorage_m was not allocated by this<br/>
  */
 template<class TYPE>
 class Array
@@ -66,6 +79,8 @@ class Array
 public:
                   Array();
    explicit       Array( dword length );                               // throws
+                  Array( TYPE* pExternalStorage,
+                         dword externalCapacity );
 
                  ~Array();
                   Array( const Array& );                               // throws
@@ -74,10 +89,15 @@ public:
 
 /// commands -------------------------------------------------------------------
            void   setLength( dword length );                           // throws
+           void   reserve( dword capacity );                           // throws
+           void   shrinkToFit();                                       // throws
+           void   useExternalStorage( TYPE* pStorage,
+                                      dword capacity );
 
            void   swap( Array& );
            void   append( const TYPE& );                               // throws
-           void   remove( int index );                                 // throws
+           void   remove( int index );
+           void   removeUnordered( int index );
 
            void   zeroStorage();
 
@@ -87,7 +107,9 @@ public:
 
 /// queries --------------------------------------------------------------------
            dword  getLength()                                             const;
+           dword  getCapacity()                                           const;
            bool   isEmpty()                                               const;
+           bool   isStorageExternal()                                     const;
    static  dword  getMaxLength();
 
            const TYPE*  getStorage()                                      const;
@@ -98,7 +120,7 @@ public:
 protected:
            void   assign( const Array<TYPE>& );
 
-           void   acquireStorage( dword length,
+           void   acquireStorage( dword capacity,
                                   bool  isCopied );
 
    static  void   copyObjects( TYPE*       lValStart,
@@ -110,6 +132,8 @@ protected:
 private:
    TYPE* pStorage_m;
    dword length_m;
+   dword capacity_m;
+   bool  isExternal_m;
 };
 
 
@@ -122,8 +146,10 @@ private:
 /// standard object services ---------------------------------------------------
 template<class TYPE>
 Array<TYPE>::Array()
- : pStorage_m( 0 )
- , length_m  ( 0 )
+ : pStorage_m  ( 0 )
+ , length_m    ( 0 )
+ , capacity_m  ( 0 )
+ , isExternal_m( false )
 {
 }
 
@@ -133,17 +159,36 @@ Array<TYPE>::Array
 (
    const dword length
 )
- : pStorage_m( 0 )
- , length_m  ( 0 )
+ : pStorage_m  ( 0 )
+ , length_m    ( 0 )
+ , capacity_m  ( 0 )
+ , isExternal_m( false )
 {
    Array<TYPE>::setLength( length );
 }
 
 
+template<class TYPE>
+Array<TYPE>::Array
+(
+   TYPE* const pExternalStorage,
+   const dword externalCapacity
+)
+ : pStorage_m  ( pExternalStorage )
+ , length_m    ( 0 )
+ , capacity_m  ( pExternalStorage ? externalCapacity : 0 )
+ , isExternal_m( true )
+{
+}
+
+
 template<class TYPE>
 Array<TYPE>::~Array()
 {
-   delete[] pStorage_m;
+   if( !isExternal_m )
+   {
+      delete[] pStorage_m;
+   }
 }
 
 
@@ -152,8 +197,10 @@ Array<TYPE>::Array
 (
    const Array<TYPE>& other
 )
- : pStorage_m( 0 )
- , length_m  ( 0 )
+ : pStorage_m  ( 0 )
+ , length_m    ( 0 )
+ , capacity_m  ( 0 )
+ , isExternal_m( false )
 {
    Array<TYPE>::assign( other );
 }
@@ -177,10 +224,66 @@ Array<TYPE>& Array<TYPE>::operator=
 template<class TYPE>
 void Array<TYPE>::setLength
 (
-   const dword length
+   dword length
+)
+{
+   // clamp to 0 min
+   length = (length >= 0) ? length : 0;
+
+   // only allocate if beyond capacity (elements kept)
+   if( length > capacity_m )
+   {
+      acquireStorage( length, true );
+   }
+
+   length_m = length;
+}
+
+
+template<class TYPE>
+void Array<TYPE>::reserve
+(
+   const dword capacity
 )
 {
-   acquireStorage( length, false );
+   // only allocate if beyond capacity
+   if( capacity > capacity_m )
+   {
+      acquireStorage( capacity, true );
+   }
+}
+
+
+template<class TYPE>
+void Array<TYPE>::shrinkToFit()
+{
+   if( capacity_m > length_m )
+   {
+      acquireStorage( length_m, true );
+   }
+}
+
+
+template<class TYPE>
+void Array<TYPE>::useExternalStorage
+(
+   TYPE* const pStorage,
+   const dword capacity
+)
+{
+   // only if elements fit, and not already in use
+   if( (length_m <= capacity) & (pStorage != pStorage_m) )
+   {
+      copyObjects( pStorage, pStorage_m, length_m );
+
+      if( !isExternal_m )
+      {
+         delete[] pStorage_m;
+      }
+      pStorage_m   = pStorage;
+      capacity_m   = pStorage ? capacity : 0;
+      isExternal_m = true;
+   }
 }
 
 
@@ -197,6 +300,14 @@ void Array<TYPE>::swap
    const dword tmpL = length_m;
    length_m         = other.length_m;
    other.length_m   = tmpL;
+
+   const dword tmpC = capacity_m;
+   capacity_m       = other.capacity_m;
+   other.capacity_m = tmpC;
+
+   const bool tmpE    = isExternal_m;
+   isExternal_m       = other.isExternal_m;
+   other.isExternal_m = tmpE;
 }
 
 
@@ -206,22 +317,17 @@ void Array<TYPE>::append
    const TYPE& element
 )
 {
-   // expand storage, duplicating elements
-   acquireStorage( length_m + 1, true );
+   // expand storage geometrically, duplicating elements
+   if( length_m == capacity_m )
+   {
+      const dword maxLength = getMaxLength();
+      acquireStorage( (capacity_m == 0) ? 1 :
+         ((capacity_m <= (maxLength >> 1)) ? (capacity_m << 1) : maxLength),
+         true );
+   }
 
    // write new element into last position
-   *(pStorage_m + length_m - 1) = element;
-
-
-// // make larger storage
-// Array<TYPE> newArray( length_m + 1 );
-//
-// // duplicate elements, and append new element
-// copyObjects( newArray.pStorage_m, pStorage_m, length_m );
-// *(newArray.pStorage_m + length_m) = element;
-//
-// // swap new storage with this
-// swap( newArray );
+   pStorage_m[ length_m++ ] = element;
 }
 
 
@@ -234,24 +340,31 @@ void Array<TYPE>::remove
    // check index is within range
    if( (index >= 0) & (index < length_m)  )
    {
-      // make smaller storage
-      Array<TYPE> newArray( length_m - 1 );
-
-      // copy elements, skipping element at index
+      // shift following elements down over index
+            TYPE* pDestination = pStorage_m + index;
+      const TYPE* pEnd         = pStorage_m + length_m - 1;
+      for( ;  pDestination < pEnd;  ++pDestination )
       {
-               TYPE* pDestination = newArray.pStorage_m;
-               TYPE* pEnd         = pDestination + newArray.length_m;
-         const TYPE* pSource      = pStorage_m;
-         const TYPE* pIndex       = pSource + index;
-         while( pDestination < pEnd )
-         {
-            pSource += static_cast<dword>(pSource == pIndex);
-            *(pDestination++) = *(pSource++);
-         }
+         *pDestination = *(pDestination + 1);
       }
 
-      // swap new storage with this
-      swap( newArray );
+      --length_m;
+   }
+}
+
+
+template<class TYPE>
+void Array<TYPE>::removeUnordered
+(
+   const int index
+)
+{
+   // check index is within range
+   if( (index >= 0) & (index < length_m)  )
+   {
+      // overwrite element at index with last element
+      --length_m;
+      pStorage_m[ index ] = pStorage_m[ length_m ];
    }
 }
 
@@ -296,6 +409,14 @@ dword Array<TYPE>::getLength() const
 }
 
 
+template<class TYPE>
+inline
+dword Array<TYPE>::getCapacity() const
+{
+   return capacity_m;
+}
+
+
 template<class TYPE>
 inline
 bool Array<TYPE>::isEmpty() const
@@ -304,6 +425,14 @@ bool Array<TYPE>::isEmpty() const
 }
 
 
+template<class TYPE>
+inline
+bool Array<TYPE>::isStorageExternal() const
+{
+   return isExternal_m;
+}
+
+
 template<class TYPE>
 inline
 dword Array<TYPE>::getMaxLength()
@@ -342,7 +471,9 @@ void Array<TYPE>::assign
 {
    if( &other != this )
    {
-      acquireStorage( other.getLength(), false );
+      // (emptied first, so growing copies none of the old elements)
+      setLength( 0 );
+      setLength( other.getLength() );
 
       copyObjects( getStorage(), other.getStorage(), other.getLength() );
    }
@@ -352,30 +483,36 @@ void Array<TYPE>::assign
 template<class TYPE>
 void Array<TYPE>::acquireStorage
 (
-   dword      newLength,
+   dword      newCapacity,
    const bool isCopied
 )
 {
    // clamp to 0 min
-   newLength = (newLength >= 0) ? newLength : 0;
+   newCapacity = (newCapacity >= 0) ? newCapacity : 0;
 
-   // only allocate if different length
-   if( newLength != length_m )
+   // only allocate if different capacity
+   if( newCapacity != capacity_m )
    {
-      // allocate new storage
-      TYPE* pNewStorage = new TYPE[ newLength ];
+      // allocate new storage (none for zero)
+      TYPE* pNewStorage = (newCapacity > 0) ? new TYPE[ newCapacity ] : 0;
 
       // copy elements to new storage
+      const dword newLength = (length_m <= newCapacity) ? length_m :
+         newCapacity;
       if( isCopied )
       {
-         copyObjects( pNewStorage, pStorage_m,
-            (length_m <= newLength ? length_m : newLength) );
+         copyObjects( pNewStorage, pStorage_m, newLength );
       }
 
-      // delete old storage and set the members
-      delete[] pStorage_m;
-      pStorage_m = pNewStorage;
-      length_m   = newLength;
+      // delete old storage (if its own) and set the members
+      if( !isExternal_m )
+      {
+         delete[] pStorage_m;
+      }
+      pStorage_m   = pNewStorage;
+      length_m     = newLength;
+      capacity_m   = newCapacity;
+      isExternal_m = false;
    }
 }
 
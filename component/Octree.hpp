@@ -41,12 +41,20 @@ OF SUCH DAMAGE.
 
 
 #include "OctreeImplementation.hpp"
+#include "OctreeLinear.hpp"
+#include "OctreeStripedRoot.hpp"
+#include "OctreeLooseRoot.hpp"
+#include "OctreeFrozenRoot.hpp"
+#include "OctreeAllocator.hpp"
+#include "OctreeTasks.hpp"
 
 
 
 
 namespace hxa7241_graphics
 {
+   template<class TYPE> class OctreeFrozen;
+   template<class TYPE, class AGENT, class ALLOCATOR> class OctreeStatic;
 
 
 /**
@@ -62,6 +70,15 @@ namespace hxa7241_graphics
  * for insertion or removal. The parameters supply the bounds of the cell.
  * <br/><br/>
  *
+ * getDistance is only needed for queryNearest, and getRayIntersection for
+ * queryRay.<br/><br/>
+ *
+ * isCoveringCell is optional: items that say they cover a whole branch's cell
+ * are held once, on the branch, instead of in every leaf below it.<br/><br/>
+ *
+ * For items that are points, boxes, spheres, or triangles, OctreeAgents.hpp
+ * has stock agents ready-made.<br/><br/>
+ *
  * Return value of getSubcellOverlaps is 8 bits, each bit is a bool
  * corresponding to a subcell, the high bit for subcell 7, the low bit for
  * subcell 0.<br/><br/>
@@ -116,6 +133,17 @@ public:
                                       const Vector3r& lower,
                                       const Vector3r& middle,
                                       const Vector3r& upper )             const;
+   virtual real  getDistanceV       ( const void*     pItem,
+                                      const Vector3r& point )             const;
+   virtual real  getRayIntersectionV( const void*     pItem,
+                                      const Vector3r& rayOrigin,
+                                      const Vector3r& rayDirection )      const;
+   virtual void  getBoundV          ( const void*     pItem,
+                                      Vector3r&       lowerCorner,
+                                      Vector3r&       upperCorner )       const;
+   virtual bool  isCoveringCellV    ( const void*     pItem,
+                                      const Vector3r& lowerCorner,
+                                      const Vector3r& upperCorner )       const;
 
 
 /// abstract interface
@@ -130,7 +158,7 @@ protected:
    /**
     * Called by Octree to get relation of item to subcell octants.<br/><br/>
     * Override to make a more efficent calculation (boundary testing can be
-    * shared).
+    * shared -- as OctreeShape does).
     * @return
     * 8 bits, each a bool corresponding to a subcell, the high bit for subcell
     * 7, the low bit for subcell 0.<br/><br/>
@@ -151,6 +179,47 @@ protected:
                                      const Vector3r& lowerCorner,
                                      const Vector3r& middlePoint,
                                      const Vector3r& upperCorner )        const;
+   /**
+    * Called by Octree::queryNearest to get distance of item from point.
+    * <br/><br/>
+    * Override to use queryNearest (the default gives REAL_MAX, so nothing is
+    * found).
+    * @return
+    * distance to the nearest part of the item, 0 if the point is inside it
+    */
+   virtual real  getDistance       ( const TYPE&     item,
+                                     const Vector3r& point )              const;
+   /**
+    * Called by Octree::queryRay to intersect a ray with item.<br/><br/>
+    * Override to use queryRay (the default gives REAL_MAX, so nothing is
+    * hit).
+    * @return
+    * least t at which rayOrigin + (rayDirection * t) is in the item, for t at
+    * or above 0 (so 0 if rayOrigin is inside it), or REAL_MAX if none
+    */
+   virtual real  getRayIntersection( const TYPE&     item,
+                                     const Vector3r& rayOrigin,
+                                     const Vector3r& rayDirection )       const;
+   /**
+    * Called by OctreeLooseRoot to get the item's axis-aligned bounding box.
+    * <br/><br/>
+    * Override to use OctreeLooseRoot (the default is unbounded, so every item
+    * is held at the root).
+    */
+   virtual void  getBound          ( const TYPE&     item,
+                                     Vector3r&       lowerCorner,
+                                     Vector3r&       upperCorner )        const;
+   /**
+    * Called by Octree to tell if item holds the whole of a branch's cell (its
+    * faces too): then it is held once, on the branch, instead of in every
+    * leaf below (and given to visitors by visitBranchItems).<br/><br/>
+    * Only asked of items overlapping all 8 subcells. Override to use it (the
+    * default is false, so items are held only in leafs). It must agree with
+    * the overlap methods, and be the same for insert and remove.
+    */
+   virtual bool  isCoveringCell    ( const TYPE&     item,
+                                     const Vector3r& lowerCorner,
+                                     const Vector3r& upperCorner )        const;
 };
 
 
@@ -202,6 +271,60 @@ dword OctreeAgent<TYPE>::getSubcellOverlapsV
 }
 
 
+template<class TYPE>
+inline
+real OctreeAgent<TYPE>::getDistanceV
+(
+   const void*     pItem,
+   const Vector3r& point
+) const
+{
+   return getDistance( *reinterpret_cast<const TYPE*>( pItem ), point );
+}
+
+
+template<class TYPE>
+inline
+real OctreeAgent<TYPE>::getRayIntersectionV
+(
+   const void*     pItem,
+   const Vector3r& rayOrigin,
+   const Vector3r& rayDirection
+) const
+{
+   return getRayIntersection( *reinterpret_cast<const TYPE*>( pItem ),
+      rayOrigin, rayDirection );
+}
+
+
+template<class TYPE>
+inline
+void OctreeAgent<TYPE>::getBoundV
+(
+   const void*     pItem,
+   Vector3r&       lowerCorner,
+   Vector3r&       upperCorner
+) const
+{
+   getBound( *reinterpret_cast<const TYPE*>( pItem ), lowerCorner,
+      upperCorner );
+}
+
+
+template<class TYPE>
+inline
+bool OctreeAgent<TYPE>::isCoveringCellV
+(
+   const void*     pItem,
+   const Vector3r& lowerCorner,
+   const Vector3r& upperCorner
+) const
+{
+   return isCoveringCell( *reinterpret_cast<const TYPE*>( pItem ),
+      lowerCorner, upperCorner );
+}
+
+
 /// default implementation
 template<class TYPE>
 dword OctreeAgent<TYPE>::getSubcellOverlaps
@@ -235,6 +358,54 @@ dword OctreeAgent<TYPE>::getSubcellOverlaps
 }
 
 
+template<class TYPE>
+real OctreeAgent<TYPE>::getDistance
+(
+   const TYPE&     ,//item,
+   const Vector3r& //point
+) const
+{
+   return REAL_MAX;
+}
+
+
+template<class TYPE>
+real OctreeAgent<TYPE>::getRayIntersection
+(
+   const TYPE&     ,//item,
+   const Vector3r& ,//rayOrigin,
+   const Vector3r& //rayDirection
+) const
+{
+   return REAL_MAX;
+}
+
+
+template<class TYPE>
+void OctreeAgent<TYPE>::getBound
+(
+   const TYPE&     ,//item,
+   Vector3r&       lowerCorner,
+   Vector3r&       upperCorner
+) const
+{
+   lowerCorner.set( -REAL_MAX, -REAL_MAX, -REAL_MAX );
+   upperCorner.set(  REAL_MAX,  REAL_MAX,  REAL_MAX );
+}
+
+
+template<class TYPE>
+bool OctreeAgent<TYPE>::isCoveringCell
+(
+   const TYPE&     ,//item,
+   const Vector3r& ,//lowerCorner,
+   const Vector3r& //upperCorner
+) const
+{
+   return false;
+}
+
+
 
 
 /**
@@ -294,6 +465,8 @@ public:
                                const OctreeData& octreeData );
    virtual void  visitLeafV  ( const Array<const void*>& items,
                                const OctreeData&         octreeData );
+   virtual void  visitBranchItemsV( const Array<const void*>& items,
+                                    const OctreeData&         octreeData );
 
 
 /// abstract interface
@@ -322,6 +495,15 @@ protected:
     */
    virtual void  visitLeaf  ( const Array<const TYPE*>& items,
                               const OctreeData&         octreeData )         =0;
+   /**
+    * Called by Octree when visit traversal is at a branch holding items
+    * itself (with OctreeLooseRoot, or items covering the branch, see
+    * OctreeAgent::isCoveringCell), before visitBranch.<br/><br/>
+    * By default, passes them to visitLeaf.
+    * @see OctreeData
+    */
+   virtual void  visitBranchItems( const Array<const TYPE*>& items,
+                                   const OctreeData&         octreeData );
 };
 
 
@@ -365,6 +547,31 @@ void OctreeVisitor<TYPE>::visitLeafV
 }
 
 
+template<class TYPE>
+inline
+void OctreeVisitor<TYPE>::visitBranchItemsV
+(
+   const Array<const void*>& items,
+   const OctreeData&         octreeData
+)
+{
+   visitBranchItems( reinterpret_cast<const Array<const TYPE*>&>( items ),
+      octreeData );
+}
+
+
+/// default implementation
+template<class TYPE>
+void OctreeVisitor<TYPE>::visitBranchItems
+(
+   const Array<const TYPE*>& items,
+   const OctreeData&         octreeData
+)
+{
+   visitLeaf( items, octreeData );
+}
+
+
 
 
 
@@ -372,212 +579,3524 @@ void OctreeVisitor<TYPE>::visitLeafV
 
 
 /**
- * Octree based spatial index.<br/><br/>
- *
- * Client must define concrete derivatives of OctreeAgent<ItemType> and
- * OctreeVisitor<ItemType>.<br/><br/>
- *
- * maxItemCountPerCell is ignored where maxLevelCount or minCellSize is reached.
+ * Parallel visitor abstract base, for client use with Octree::visitParallel.
  * <br/><br/>
  *
- * The octree is cubical and axis aligned, partitions are axis aligned,
- * partitions divide in half, each level partitions the previous level in all
- * three axiss.<br/><br/>
+ * Client must define a concrete derivative of
+ * OctreeVisitorParallel<ItemType>.<br/><br/>
  *
- * Storage is contracted or expanded as needed by item insertion and removal.
+ * It is a query (as for OctreeFrozen::query), with virtual members, that can
+ * make copies of itself: the tree is split into subtrees, each is visited by
+ * its own clone (on any thread), and the clones are then reduced into the
+ * original, in subtree order. The split depends only on the tree, so the
+ * result is the same for any thread count -- even for, say, sums of reals.
  * <br/><br/>
  *
- * (Occupies, very approximately, 20 bytes per point item. maybe...)<br/><br/>
- *
- * Octree is only an index: it points to client items, it does not manage
- * storage of items themselves.<br/><br/>
- *
- * @see OctreeAgent
- * @see OctreeVisitor
- *
- * @implementation
- * The octree structure follows the Composite pattern.<br/><br/>
- *
- * This template wrapper ensures the items indexed by the octree, and the agents
- * and visitors used when accessing them are, of matching types. All algorithmic
- * work is delegated to OctreeRoot and OctreeCell derivatives in
- * OctreeImplementation, which work with abstract base interfaces and void
- * pointers.<br/><br/>
- *
- * For the insertion and removal commands, the agent provides an interface for
- * the octree to query the typeless item, and for the visit query, the visitor
- * provides callbacks to read tree nodes for carrying out the visit operation.
+ * isEntering can be asked more than once for a cell, of the original or of a
+ * clone, so should depend only on the cell (not on what was visited).
+ * visitLeaf is called once for each leaf entered, and for each branch entered
+ * holding items itself (see OctreeAgent::isCoveringCell), on one of them.
  */
 template<class TYPE>
-class Octree
+class OctreeVisitorParallel
 {
 /// standard object services ---------------------------------------------------
+protected:
+            OctreeVisitorParallel() {}
+public:
+   virtual ~OctreeVisitorParallel() {}
+private:
+            OctreeVisitorParallel( const OctreeVisitorParallel& );
+   OctreeVisitorParallel& operator=( const OctreeVisitorParallel& );
 public:
-   /**
-    * Constructs a particular format of octree.<br/><br/>
-    * @parameters
-    * * sizeOfCube is desired length along a side<br/>
-    * * maxItemCountPerCell is desired max item pointers per leaf<br/>
-    * * maxLevelCount is desired max depth of tree<br/>
-    * * minCellSize is desired min size of cells<br/>
-    */
-            Octree( const Vector3r& positionOfLowerCorner,
-                    real            sizeOfCube,
-                    dword           maxItemCountPerCell,
-                    dword           maxLevelCount,
-                    real            minCellSize );
-
-           ~Octree();
-            Octree( const Octree& );
-   /**
-    * @exceptions
-    * Can throw storage allocation exceptions. In such cases the octree is
-    * unmodified.
-    */
-   Octree& operator=( const Octree& );
 
 
 /// commands -------------------------------------------------------------------
    /**
-    * Add pointer(s) to the item to the octree.<br/><br/>
-    * (If an item has non-zero volume, it may have pointers in multiple
-    * cells.)<br/><br/>
-    * @return is the item inserted -- false if item not inside root bound
-    * @exceptions
-    * Can throw storage allocation exceptions. In such cases the octree remains
-    * structurally ok, but the item will not be fully added, -- call this
-    * method again or the remove method.
-    * @see remove, OctreeAgent
-    */
-           bool  insert( const TYPE&              item,
-                         const OctreeAgent<TYPE>& agent );
-   /**
-    * Removes pointer(s) to the item from the octree.<br/><br/>
-    * (If an item has non-zero volume, it may have pointers in multiple
-    * cells.)<br/><br/>
-    * @return is the item removed -- false if item wasn't present
-    * @exceptions
-    * Can throw storage allocation exceptions. In such cases the octree remains
-    * structurally ok, but the item will not be fully removed, -- call this
-    * method again or the insert method.
-    * @see insert, OctreeAgent
-    */
-           bool  remove( const TYPE&              item,
-                         const OctreeAgent<TYPE>& agent );
-
-
-/// queries --------------------------------------------------------------------
-   /**
-    * Execute a visit query operation.
-    * @see OctreeVisitor
-    */
-           void  visit( OctreeVisitor<TYPE>& visitor )                    const;
-
-   /**
-    * Reports if the octree is empty.
+    * Makes a new visitor of the same kind and parameters, with an empty
+    * result. The caller deletes it.
     */
-           bool  isEmpty()                                                const;
+   virtual OctreeVisitorParallel* clone()                           const =0;
    /**
-    * Provides stats on the octree.<br/><br/>
-    * @parameters
-    * * byteSize is size in bytes<br/>
-    * * leafCount is number of leafs<br/>
-    * * itemRefCount is total number of item pointers in all leafs<br/>
-    * * maxDepth is deepest depth of tree<br/>
+    * Adds the result of a clone to this one's. (By default, does nothing: for
+    * visitors that only act on the items.)
     */
-           void  getInfo( dword& byteSize,
-                          dword& leafCount,
-                          dword& itemRefCount,
-                          dword& maxDepth )                               const;
+   virtual void  reduce( const OctreeVisitorParallel& clone );
 
    /**
-    * Gives the position supplied at construction.
-    */
-           const Vector3r& getPosition()                                  const;
-   /**
-    * Gives the size supplied at construction.
-    */
-           real            getSize()                                      const;
-   /**
-    * Gives the leaf pointer limit supplied at construction.
-    */
-           dword           getMaxItemCountPerCell()                       const;
-   /**
-    * Gives the depth limit supplied at construction.
+    * Asked for each cell, from the root down: its subcells are skipped if
+    * false. (By default, all are entered.)
     */
-           dword           getMaxLevelCount()                             const;
+   virtual bool  isEntering( const OctreeData& cellData );
    /**
-    * Gives the size limit supplied at construction.
+    * Called for each leaf entered (and each branch entered holding items
+    * itself, before its subcells).
     */
-           real            getMinCellSize()                               const;
-
-
-/// fields ---------------------------------------------------------------------
-private:
-   OctreeRoot root_m;
+   virtual void  visitLeaf ( const TYPE* const* pItems,
+                             dword              itemCount,
+                             const OctreeData&  leafData )                   =0;
 };
 
 
 
 
-/// templates ///
-
-/// standard object services ---------------------------------------------------
+/// commands -------------------------------------------------------------------
 template<class TYPE>
 inline
-Octree<TYPE>::Octree
+void OctreeVisitorParallel<TYPE>::reduce
 (
-   const Vector3r& position,
-   const real      sizeOfCube,
-   const dword     maxItemCountPerCell,
-   const dword     maxLevelCount,
-   const real      minCellSize
+   const OctreeVisitorParallel& //clone
 )
- : root_m( position, sizeOfCube, maxItemCountPerCell, maxLevelCount,
-      minCellSize )
-{
-}
-
-
-template<class TYPE>
-inline
-Octree<TYPE>::~Octree()
 {
 }
 
 
 template<class TYPE>
 inline
-Octree<TYPE>::Octree
+bool OctreeVisitorParallel<TYPE>::isEntering
 (
-   const Octree& other
+   const OctreeData& //cellData
 )
- : root_m( other.root_m )
 {
+   return true;
 }
 
 
-template<class TYPE>
-inline
-Octree<TYPE>& Octree<TYPE>::operator=
-(
-   const Octree& other
-)
-{
-   root_m = other.root_m;
 
-   return *this;
-}
 
 
 
 
-/// commands -------------------------------------------------------------------
-template<class TYPE>
-inline
-bool Octree<TYPE>::insert
-(
-   const TYPE&              item,
+
+/**
+ * Box range query, for Octree implementation use.<br/><br/>
+ *
+ * A query (as for OctreeRoot::query) collecting the items overlapping a box.
+ * Cells not overlapping the box are skipped. Items in cells wholly inside it
+ * are taken without testing, and the rest are tested with the agent.<br/><br/>
+ *
+ * An item in several leafs is taken from each, so finish sorts the items (by
+ * address) and removes the repeats, in place (by sortUnique).<br/><br/>
+ *
+ * AGENT has an isOverlappingCellV member, as OctreeAgentV.
+ *
+ * @implementation
+ * Traversal is depth-first, so cells after a wholly inside one are within it
+ * until one no deeper than it comes. insideLevel_m is that cell's level, or -1.
+ */
+template<class TYPE, class AGENT>
+class OctreeQueryBoxV
+{
+/// standard object services ---------------------------------------------------
+public:
+            OctreeQueryBoxV( const Vector3r&     lowerCorner,
+                             const Vector3r&     upperCorner,
+                             const AGENT&        agent,
+                             Array<const TYPE*>& items );
+
+           ~OctreeQueryBoxV();
+private:
+            OctreeQueryBoxV( const OctreeQueryBoxV& );
+   OctreeQueryBoxV& operator=( const OctreeQueryBoxV& );
+public:
+
+
+/// commands -------------------------------------------------------------------
+           bool  isEntering( const OctreeData& cellData );
+           void  visitLeaf ( const void* const* pItems,
+                             dword              itemCount,
+                             const OctreeData&  leafData );
+           void  finish();
+
+
+/// statics --------------------------------------------------------------------
+   static  void  sortUnique( Array<const TYPE*>& items );
+
+
+/// implementation -------------------------------------------------------------
+protected:
+   static  void  siftDown( const TYPE** pItems,
+                           dword        root,
+                           dword        length );
+
+
+/// fields ---------------------------------------------------------------------
+private:
+   const Vector3r&     lowerCorner_m;
+   const Vector3r&     upperCorner_m;
+   const AGENT&        agent_m;
+   Array<const TYPE*>& items_m;
+   dword               insideLevel_m;
+};
+
+
+
+
+/// standard object services ---------------------------------------------------
+template<class TYPE, class AGENT>
+inline
+OctreeQueryBoxV<TYPE,AGENT>::OctreeQueryBoxV
+(
+   const Vector3r&     lowerCorner,
+   const Vector3r&     upperCorner,
+   const AGENT&        agent,
+   Array<const TYPE*>& items
+)
+ : lowerCorner_m( lowerCorner )
+ , upperCorner_m( upperCorner )
+ , agent_m      ( agent )
+ , items_m      ( items )
+ , insideLevel_m( -1 )
+{
+}
+
+
+template<class TYPE, class AGENT>
+inline
+OctreeQueryBoxV<TYPE,AGENT>::~OctreeQueryBoxV()
+{
+}
+
+
+
+
+/// commands -------------------------------------------------------------------
+template<class TYPE, class AGENT>
+bool OctreeQueryBoxV<TYPE,AGENT>::isEntering
+(
+   const OctreeData& cellData
+)
+{
+   bool isEnter = true;
+
+   // leaving the wholly inside cell, if any
+   const dword level = cellData.getLevel();
+   if( level <= insideLevel_m )
+   {
+      insideLevel_m = -1;
+   }
+
+   // test only if not within a wholly inside cell
+   if( insideLevel_m < 0 )
+   {
+      const OctreeBound& bound = cellData.getBound();
+      isEnter = bound.isOverlapping( lowerCorner_m, upperCorner_m );
+      if( isEnter && bound.isInside( lowerCorner_m, upperCorner_m ) )
+      {
+         insideLevel_m = level;
+      }
+   }
+
+   return isEnter;
+}
+
+
+template<class TYPE, class AGENT>
+void OctreeQueryBoxV<TYPE,AGENT>::visitLeaf
+(
+   const void* const* pItems,
+   const dword        itemCount,
+   const OctreeData&  //leafData
+)
+{
+   // take all if within a wholly inside cell, else test each
+   const bool isInside = (insideLevel_m >= 0);
+   for( dword i = 0;  i < itemCount;  ++i )
+   {
+      if( isInside || agent_m.isOverlappingCellV( pItems[i], lowerCorner_m,
+         upperCorner_m ) )
+      {
+         items_m.append( reinterpret_cast<const TYPE*>( pItems[i] ) );
+      }
+   }
+}
+
+
+template<class TYPE, class AGENT>
+inline
+void OctreeQueryBoxV<TYPE,AGENT>::finish()
+{
+   sortUnique( items_m );
+}
+
+
+
+
+/// statics --------------------------------------------------------------------
+template<class TYPE, class AGENT>
+void OctreeQueryBoxV<TYPE,AGENT>::sortUnique
+(
+   Array<const TYPE*>& items
+)
+{
+   const TYPE** pItems = items.getStorage();
+   const dword  length = items.getLength();
+
+   // heap sort by address
+   for( dword i = length / 2;  i-- > 0; )
+   {
+      siftDown( pItems, i, length );
+   }
+   for( dword i = length;  i-- > 1; )
+   {
+      const TYPE* pTop = pItems[0];
+      pItems[0] = pItems[i];
+      pItems[i] = pTop;
+      siftDown( pItems, 0, i );
+   }
+
+   // remove repeats
+   dword unique = 0;
+   for( dword i = 0;  i < length;  ++i )
+   {
+      if( (0 == unique) || (pItems[i] != pItems[unique - 1]) )
+      {
+         pItems[unique++] = pItems[i];
+      }
+   }
+   items.setLength( unique );
+}
+
+
+
+
+/// implementation -------------------------------------------------------------
+template<class TYPE, class AGENT>
+void OctreeQueryBoxV<TYPE,AGENT>::siftDown
+(
+   const TYPE** pItems,
+   dword        root,
+   const dword  length
+)
+{
+   bool isDone = false;
+   while( !isDone )
+   {
+      // larger child, if any
+      dword child = (root * 2) + 1;
+      if( ((child + 1) < length) && (pItems[child] < pItems[child + 1]) )
+      {
+         ++child;
+      }
+
+      // swap down while smaller than it
+      isDone = (child >= length) || !(pItems[root] < pItems[child]);
+      if( !isDone )
+      {
+         const TYPE* pRoot = pItems[root];
+         pItems[root]  = pItems[child];
+         pItems[child] = pRoot;
+         root = child;
+      }
+   }
+}
+
+
+
+
+
+
+
+
+/**
+ * Nearest neighbours query, for Octree implementation use.<br/><br/>
+ *
+ * A query (as for OctreeRoot::queryNearest) collecting the k items nearest a
+ * point, within maxDistance. Candidates are held in a heap with the farthest
+ * on top: once there are k, the limit is its distance, and a nearer item
+ * replaces it.<br/><br/>
+ *
+ * An item in several leafs is taken once: candidates are searched before one
+ * is added (k is expected to be small).<br/><br/>
+ *
+ * AGENT has a getDistanceV member, as OctreeAgentV. k must be above 0.
+ */
+template<class TYPE, class AGENT>
+class OctreeQueryNearestV
+{
+/// standard object services ---------------------------------------------------
+public:
+            OctreeQueryNearestV( const Vector3r& point,
+                                 dword           k,
+                                 real            maxDistance,
+                                 const AGENT&    agent );
+
+           ~OctreeQueryNearestV();
+private:
+            OctreeQueryNearestV( const OctreeQueryNearestV& );
+   OctreeQueryNearestV& operator=( const OctreeQueryNearestV& );
+public:
+
+
+/// commands -------------------------------------------------------------------
+           void  visitLeaf( const void* const* pItems,
+                            dword              itemCount,
+                            const OctreeData&  leafData );
+           void  finish   ( Array<const TYPE*>& items,
+                            Array<real>&        distances );
+
+
+/// queries --------------------------------------------------------------------
+           real  getCellDistance( const OctreeData& cellData )            const;
+           real  getLimit()                                               const;
+
+
+/// implementation -------------------------------------------------------------
+protected:
+   struct Candidate
+   {
+      real        distance;
+      const void* pItem;
+   };
+
+
+/// fields ---------------------------------------------------------------------
+private:
+   const Vector3r&            point_m;
+   dword                      k_m;
+   real                       maxDistance_m;
+   const AGENT&               agent_m;
+   OctreeHeap<Candidate,true> candidates_m;
+};
+
+
+
+
+/// standard object services ---------------------------------------------------
+template<class TYPE, class AGENT>
+inline
+OctreeQueryNearestV<TYPE,AGENT>::OctreeQueryNearestV
+(
+   const Vector3r& point,
+   const dword     k,
+   const real      maxDistance,
+   const AGENT&    agent
+)
+ : point_m      ( point )
+ , k_m          ( k )
+ , maxDistance_m( maxDistance )
+ , agent_m      ( agent )
+ , candidates_m ()
+{
+}
+
+
+template<class TYPE, class AGENT>
+inline
+OctreeQueryNearestV<TYPE,AGENT>::~OctreeQueryNearestV()
+{
+}
+
+
+
+
+/// commands -------------------------------------------------------------------
+template<class TYPE, class AGENT>
+void OctreeQueryNearestV<TYPE,AGENT>::visitLeaf
+(
+   const void* const* pItems,
+   const dword        itemCount,
+   const OctreeData&  //leafData
+)
+{
+   for( dword i = 0;  i < itemCount;  ++i )
+   {
+      const real distance = agent_m.getDistanceV( pItems[i], point_m );
+
+      // nearer than the farthest candidate, or within range if not yet full
+      const bool isFull = (candidates_m.getLength() >= k_m);
+      if( isFull ? (distance < candidates_m.getTop().distance) :
+         (distance <= maxDistance_m) )
+      {
+         // skip if already taken from another leaf
+         bool isTaken = false;
+         for( dword j = candidates_m.getLength();  j-- > 0; )
+         {
+            isTaken |= (candidates_m[j].pItem == pItems[i]);
+         }
+
+         if( !isTaken )
+         {
+            if( isFull )
+            {
+               candidates_m.pop();
+            }
+
+            Candidate candidate;
+            candidate.distance = distance;
+            candidate.pItem    = pItems[i];
+            candidates_m.push( candidate );
+         }
+      }
+   }
+}
+
+
+template<class TYPE, class AGENT>
+void OctreeQueryNearestV<TYPE,AGENT>::finish
+(
+   Array<const TYPE*>& items,
+   Array<real>&        distances
+)
+{
+   const dword length = candidates_m.getLength();
+   items.setLength( length );
+   distances.setLength( length );
+
+   // farthest is on top, so fill from the back
+   for( dword i = length;  i-- > 0; )
+   {
+      const Candidate& top = candidates_m.getTop();
+      items[i]     = reinterpret_cast<const TYPE*>( top.pItem );
+      distances[i] = top.distance;
+      candidates_m.pop();
+   }
+}
+
+
+
+
+/// queries --------------------------------------------------------------------
+template<class TYPE, class AGENT>
+inline
+real OctreeQueryNearestV<TYPE,AGENT>::getCellDistance
+(
+   const OctreeData& cellData
+) const
+{
+   return cellData.getBound().getDistance( point_m );
+}
+
+
+template<class TYPE, class AGENT>
+inline
+real OctreeQueryNearestV<TYPE,AGENT>::getLimit() const
+{
+   return (candidates_m.getLength() < k_m) ? maxDistance_m :
+      candidates_m.getTop().distance;
+}
+
+
+
+
+
+
+
+
+/**
+ * Ray query, for Octree implementation use.<br/><br/>
+ *
+ * A query (as for OctreeRoot::query) finding the item a ray hits first. Cells
+ * the ray does not cross between 0 and the nearest hit so far (or maxT) are
+ * skipped, by a slab test. Given getSubcellOrder, subcells are entered
+ * front-to-back along the ray, so the limit shrinks early.<br/><br/>
+ *
+ * An item in several leafs is tested in each (the nearer hit is kept, so it
+ * is harmless).<br/><br/>
+ *
+ * AGENT has a getRayIntersectionV member, as OctreeAgentV.
+ *
+ * @implementation
+ * Going positively along an axis, the ray only passes from the lower half to
+ * the upper, so any subcells it crosses come in index order -- with the bits
+ * flipped for axiss it goes negatively along.
+ */
+template<class TYPE, class AGENT>
+class OctreeQueryRayV
+{
+/// standard object services ---------------------------------------------------
+public:
+            OctreeQueryRayV( const Vector3r& rayOrigin,
+                             const Vector3r& rayDirection,
+                             real            maxT,
+                             const AGENT&    agent );
+
+           ~OctreeQueryRayV();
+private:
+            OctreeQueryRayV( const OctreeQueryRayV& );
+   OctreeQueryRayV& operator=( const OctreeQueryRayV& );
+public:
+
+
+/// commands -------------------------------------------------------------------
+           bool  isEntering( const OctreeData& cellData );
+           void  visitLeaf ( const void* const* pItems,
+                             dword              itemCount,
+                             const OctreeData&  leafData );
+
+
+/// queries --------------------------------------------------------------------
+           dword       getSubcellOrder()                                  const;
+           const TYPE* getHitItem()                                       const;
+           real        getHitT()                                          const;
+
+
+/// fields ---------------------------------------------------------------------
+private:
+   const Vector3r& rayOrigin_m;
+   const Vector3r& rayDirection_m;
+   real            inverseDirection_m[3];
+   const AGENT&    agent_m;
+
+   real            hitT_m;
+   const void*     pHitItem_m;
+};
+
+
+
+
+/// standard object services ---------------------------------------------------
+template<class TYPE, class AGENT>
+OctreeQueryRayV<TYPE,AGENT>::OctreeQueryRayV
+(
+   const Vector3r& rayOrigin,
+   const Vector3r& rayDirection,
+   const real      maxT,
+   const AGENT&    agent
+)
+ : rayOrigin_m   ( rayOrigin )
+ , rayDirection_m( rayDirection )
+ , agent_m       ( agent )
+ , hitT_m        ( maxT )
+ , pHitItem_m    ( 0 )
+{
+   for( int i = 3;  i-- > 0; )
+   {
+      inverseDirection_m[i] = (0.0f != rayDirection[i]) ?
+         1.0f / rayDirection[i] : 0.0f;
+   }
+}
+
+
+template<class TYPE, class AGENT>
+inline
+OctreeQueryRayV<TYPE,AGENT>::~OctreeQueryRayV()
+{
+}
+
+
+
+
+/// commands -------------------------------------------------------------------
+template<class TYPE, class AGENT>
+bool OctreeQueryRayV<TYPE,AGENT>::isEntering
+(
+   const OctreeData& cellData
+)
+{
+   const Vector3r& lower = cellData.getBound().getLowerCorner();
+   const Vector3r& upper = cellData.getBound().getUpperCorner();
+
+   // intersect the ray's span with each axis's slab
+   real tEnter = 0.0f;
+   real tExit  = hitT_m;
+   for( int i = 3;  i-- > 0; )
+   {
+      if( 0.0f != rayDirection_m[i] )
+      {
+         const real t0 = (lower[i] - rayOrigin_m[i]) * inverseDirection_m[i];
+         const real t1 = (upper[i] - rayOrigin_m[i]) * inverseDirection_m[i];
+         const real tNear = (t0 < t1) ? t0 : t1;
+         const real tFar  = (t0 < t1) ? t1 : t0;
+         tEnter = (tNear > tEnter) ? tNear : tEnter;
+         tExit  = (tFar  < tExit)  ? tFar  : tExit;
+      }
+      else
+      {
+         // parallel to the slab: within it or never
+         if( (rayOrigin_m[i] < lower[i]) | (rayOrigin_m[i] > upper[i]) )
+         {
+            tExit = -1.0f;
+         }
+      }
+   }
+
+   return tEnter <= tExit;
+}
+
+
+template<class TYPE, class AGENT>
+void OctreeQueryRayV<TYPE,AGENT>::visitLeaf
+(
+   const void* const* pItems,
+   const dword        itemCount,
+   const OctreeData&  //leafData
+)
+{
+   // keep the nearest hit
+   for( dword i = 0;  i < itemCount;  ++i )
+   {
+      const real t = agent_m.getRayIntersectionV( pItems[i], rayOrigin_m,
+         rayDirection_m );
+      if( (t >= 0.0f) & (t < hitT_m) )
+      {
+         hitT_m     = t;
+         pHitItem_m = pItems[i];
+      }
+   }
+}
+
+
+
+
+/// queries --------------------------------------------------------------------
+template<class TYPE, class AGENT>
+dword OctreeQueryRayV<TYPE,AGENT>::getSubcellOrder() const
+{
+   // a bit for each axis the ray goes negatively along
+   dword order = 0;
+   for( int i = 3;  i-- > 0; )
+   {
+      order |= static_cast<dword>(rayDirection_m[i] < 0.0f) << i;
+   }
+
+   return order;
+}
+
+
+template<class TYPE, class AGENT>
+inline
+const TYPE* OctreeQueryRayV<TYPE,AGENT>::getHitItem() const
+{
+   return reinterpret_cast<const TYPE*>( pHitItem_m );
+}
+
+
+template<class TYPE, class AGENT>
+inline
+real OctreeQueryRayV<TYPE,AGENT>::getHitT() const
+{
+   return hitT_m;
+}
+
+
+
+
+
+
+
+
+/**
+ * Ray packet query, for Octree implementation use.<br/><br/>
+ *
+ * As OctreeQueryRayV, for up to MAX_COUNT rays at once: each cell is entered
+ * once for the packet, if any ray still active crosses it, and each leaf's
+ * items are tested against just the rays active there.<br/><br/>
+ *
+ * Subcells are ordered by the direction signs most of the packet's rays share
+ * (the order is exact for a coherent packet, all rays' directions of the same
+ * signs). The order only affects how soon each ray's limit shrinks: every ray
+ * is still clipped to its own nearest hit, so the hits are exact for any
+ * packet. queryAll splits any number of rays into packets.<br/><br/>
+ *
+ * AGENT has a getRayIntersectionV member, as OctreeAgentV.
+ *
+ * @implementation
+ * Traversal is depth-first, so the active rays of a cell's parent are those
+ * stored for the level above. Ray components are stored per axis (structure
+ * of arrays), and the slab tests run over the whole packet without branches,
+ * as loops GCC -O3 vectorizes. An axis-parallel ray has an inverse
+ * direction of REAL_MAX, which can only admit more cells, not fewer.
+ */
+template<class TYPE, class AGENT>
+class OctreeQueryRayPacketV
+{
+/// standard object services ---------------------------------------------------
+public:
+            OctreeQueryRayPacketV( const Vector3r* pRayOrigins,
+                                   const Vector3r* pRayDirections,
+                                   dword           rayCount,
+                                   real            maxT,
+                                   const AGENT&    agent );
+
+           ~OctreeQueryRayPacketV();
+private:
+            OctreeQueryRayPacketV( const OctreeQueryRayPacketV& );
+   OctreeQueryRayPacketV& operator=( const OctreeQueryRayPacketV& );
+public:
+
+
+/// commands -------------------------------------------------------------------
+           bool  isEntering( const OctreeData& cellData );
+           void  visitLeaf ( const void* const* pItems,
+                             dword              itemCount,
+                             const OctreeData&  leafData );
+
+
+/// queries --------------------------------------------------------------------
+           dword getSubcellOrder()                                        const;
+           void  getHits( const TYPE** pHitItems,
+                          real*        pHitTs )                           const;
+
+
+/// statics --------------------------------------------------------------------
+   template<class ROOT>
+   static  void  queryAll( const ROOT&     root,
+                           dword           rayCount,
+                           const Vector3r* pRayOrigins,
+                           const Vector3r* pRayDirections,
+                           real            maxT,
+                           const AGENT&    agent,
+                           const TYPE**    pHitItems,
+                           real*           pHitTs );
+
+
+/// constants ------------------------------------------------------------------
+   static const dword MAX_COUNT = 32;
+
+
+/// fields ---------------------------------------------------------------------
+private:
+   const Vector3r* pRayOrigins_m;
+   const Vector3r* pRayDirections_m;
+   dword           rayCount_m;
+   const AGENT&    agent_m;
+
+   real            origins_m[3][MAX_COUNT];
+   real            inverseDirections_m[3][MAX_COUNT];
+   real            hitTs_m[MAX_COUNT];
+   const void*     pHitItems_m[MAX_COUNT];
+
+   // by level (which is at most OctreeDimensions::MAX_LEVEL)
+   udword          activeMasks_m[64];
+};
+
+
+
+
+/// standard object services ---------------------------------------------------
+template<class TYPE, class AGENT>
+OctreeQueryRayPacketV<TYPE,AGENT>::OctreeQueryRayPacketV
+(
+   const Vector3r* pRayOrigins,
+   const Vector3r* pRayDirections,
+   const dword     rayCount,
+   const real      maxT,
+   const AGENT&    agent
+)
+ : pRayOrigins_m   ( pRayOrigins )
+ , pRayDirections_m( pRayDirections )
+ , rayCount_m      ( (rayCount <= MAX_COUNT) ? rayCount : MAX_COUNT )
+ , agent_m         ( agent )
+{
+   for( dword r = rayCount_m;  r-- > 0; )
+   {
+      for( int i = 3;  i-- > 0; )
+      {
+         const real d = pRayDirections[r][i];
+         origins_m[i][r]           = pRayOrigins[r][i];
+         inverseDirections_m[i][r] = (0.0f != d) ? 1.0f / d : REAL_MAX;
+      }
+      hitTs_m[r]     = maxT;
+      pHitItems_m[r] = 0;
+   }
+}
+
+
+template<class TYPE, class AGENT>
+inline
+OctreeQueryRayPacketV<TYPE,AGENT>::~OctreeQueryRayPacketV()
+{
+}
+
+
+
+
+/// commands -------------------------------------------------------------------
+template<class TYPE, class AGENT>
+bool OctreeQueryRayPacketV<TYPE,AGENT>::isEntering
+(
+   const OctreeData& cellData
+)
+{
+   const Vector3r& lower = cellData.getBound().getLowerCorner();
+   const Vector3r& upper = cellData.getBound().getUpperCorner();
+
+   // intersect every ray's span with each axis's slab
+   real tEnters[MAX_COUNT];
+   real tExits [MAX_COUNT];
+   for( dword r = 0;  r < rayCount_m;  ++r )
+   {
+      tEnters[r] = 0.0f;
+      tExits[r]  = hitTs_m[r];
+   }
+   for( int i = 3;  i-- > 0; )
+   {
+      const real  l        = lower[i];
+      const real  u        = upper[i];
+      const real* origins  = origins_m[i];
+      const real* inverses = inverseDirections_m[i];
+      for( dword r = 0;  r < rayCount_m;  ++r )
+      {
+         const real t0 = (l - origins[r]) * inverses[r];
+         const real t1 = (u - origins[r]) * inverses[r];
+         const real tNear = (t0 < t1) ? t0 : t1;
+         const real tFar  = (t0 < t1) ? t1 : t0;
+         tEnters[r] = (tNear > tEnters[r]) ? tNear : tEnters[r];
+         tExits[r]  = (tFar  < tExits[r])  ? tFar  : tExits[r];
+      }
+   }
+
+   // active if crossing, and active in the parent
+   udword mask = 0;
+   for( dword r = 0;  r < rayCount_m;  ++r )
+   {
+      mask |= static_cast<udword>(tEnters[r] <= tExits[r]) << r;
+   }
+   const dword level = cellData.getLevel();
+   if( level > 0 )
+   {
+      mask &= activeMasks_m[level - 1];
+   }
+   activeMasks_m[level] = mask;
+
+   return 0 != mask;
+}
+
+
+template<class TYPE, class AGENT>
+void OctreeQueryRayPacketV<TYPE,AGENT>::visitLeaf
+(
+   const void* const* pItems,
+   const dword        itemCount,
+   const OctreeData&  leafData
+)
+{
+   // keep each active ray's nearest hit
+   const udword mask = activeMasks_m[ leafData.getLevel() ];
+   for( dword r = 0;  r < rayCount_m;  ++r )
+   {
+      if( (mask >> r) & 1 )
+      {
+         for( dword i = 0;  i < itemCount;  ++i )
+         {
+            const real t = agent_m.getRayIntersectionV( pItems[i],
+               pRayOrigins_m[r], pRayDirections_m[r] );
+            if( (t >= 0.0f) & (t < hitTs_m[r]) )
+            {
+               hitTs_m[r]     = t;
+               pHitItems_m[r] = pItems[i];
+            }
+         }
+      }
+   }
+}
+
+
+
+
+/// queries --------------------------------------------------------------------
+template<class TYPE, class AGENT>
+dword OctreeQueryRayPacketV<TYPE,AGENT>::getSubcellOrder() const
+{
+   // a bit for each axis more than half the rays go negatively along
+   dword order = 0;
+   for( int i = 3;  i-- > 0; )
+   {
+      dword negatives = 0;
+      for( dword r = rayCount_m;  r-- > 0; )
+      {
+         negatives += static_cast<dword>(pRayDirections_m[r][i] < 0.0f);
+      }
+      order |= static_cast<dword>((negatives * 2) > rayCount_m) << i;
+   }
+
+   return order;
+}
+
+
+template<class TYPE, class AGENT>
+void OctreeQueryRayPacketV<TYPE,AGENT>::getHits
+(
+   const TYPE** pHitItems,
+   real*        pHitTs
+) const
+{
+   for( dword r = rayCount_m;  r-- > 0; )
+   {
+      pHitItems[r] = reinterpret_cast<const TYPE*>( pHitItems_m[r] );
+      pHitTs[r]    = hitTs_m[r];
+   }
+}
+
+
+
+
+/// statics --------------------------------------------------------------------
+template<class TYPE, class AGENT>
+template<class ROOT>
+void OctreeQueryRayPacketV<TYPE,AGENT>::queryAll
+(
+   const ROOT&           root,
+   const dword           rayCount,
+   const Vector3r* const pRayOrigins,
+   const Vector3r* const pRayDirections,
+   const real            maxT,
+   const AGENT&          agent,
+   const TYPE** const    pHitItems,
+   real* const           pHitTs
+)
+{
+   // step through whole packets, then the remainder
+   for( dword i = 0;  i < rayCount;  i += MAX_COUNT )
+   {
+      OctreeQueryRayPacketV query( pRayOrigins + i, pRayDirections + i,
+         rayCount - i, maxT, agent );
+      root.query( query, query.getSubcellOrder() );
+      query.getHits( pHitItems + i, pHitTs + i );
+   }
+}
+
+
+
+
+
+
+
+
+/**
+ * Box packet query, for Octree implementation use.<br/><br/>
+ *
+ * As OctreeQueryBoxV, for up to MAX_COUNT boxes at once: each cell is entered
+ * once for the packet, if any box still active overlaps it. Each box has its
+ * own items array. queryAll splits any number of boxes into packets.<br/><br/>
+ *
+ * AGENT has an isOverlappingCellV member, as OctreeAgentV.
+ *
+ * @implementation
+ * As OctreeQueryRayPacketV: a mask of the active boxes, and of those wholly
+ * containing the cell, is stored per level, and the overlap tests run over
+ * the whole packet without branches.
+ */
+template<class TYPE, class AGENT>
+class OctreeQueryBoxPacketV
+{
+/// standard object services ---------------------------------------------------
+public:
+            OctreeQueryBoxPacketV( const Vector3r*     pLowerCorners,
+                                   const Vector3r*     pUpperCorners,
+                                   dword               boxCount,
+                                   const AGENT&        agent,
+                                   Array<const TYPE*>* pItems );
+
+           ~OctreeQueryBoxPacketV();
+private:
+            OctreeQueryBoxPacketV( const OctreeQueryBoxPacketV& );
+   OctreeQueryBoxPacketV& operator=( const OctreeQueryBoxPacketV& );
+public:
+
+
+/// commands -------------------------------------------------------------------
+           bool  isEntering( const OctreeData& cellData );
+           void  visitLeaf ( const void* const* pItems,
+                             dword              itemCount,
+                             const OctreeData&  leafData );
+           void  finish();
+
+
+/// statics --------------------------------------------------------------------
+   template<class ROOT>
+   static  void  queryAll( const ROOT&         root,
+                           dword               boxCount,
+                           const Vector3r*     pLowerCorners,
+                           const Vector3r*     pUpperCorners,
+                           const AGENT&        agent,
+                           Array<const TYPE*>* pItems );
+
+
+/// constants ------------------------------------------------------------------
+   static const dword MAX_COUNT = 32;
+
+
+/// fields ---------------------------------------------------------------------
+private:
+   const Vector3r*     pLowerCorners_m;
+   const Vector3r*     pUpperCorners_m;
+   dword               boxCount_m;
+   const AGENT&        agent_m;
+   Array<const TYPE*>* pItems_m;
+
+   real                lowers_m[3][MAX_COUNT];
+   real                uppers_m[3][MAX_COUNT];
+
+   // by level (which is at most OctreeDimensions::MAX_LEVEL)
+   udword              activeMasks_m[64];
+   udword              insideMasks_m[64];
+};
+
+
+
+
+/// standard object services ---------------------------------------------------
+template<class TYPE, class AGENT>
+OctreeQueryBoxPacketV<TYPE,AGENT>::OctreeQueryBoxPacketV
+(
+   const Vector3r*     pLowerCorners,
+   const Vector3r*     pUpperCorners,
+   const dword         boxCount,
+   const AGENT&        agent,
+   Array<const TYPE*>* pItems
+)
+ : pLowerCorners_m( pLowerCorners )
+ , pUpperCorners_m( pUpperCorners )
+ , boxCount_m     ( (boxCount <= MAX_COUNT) ? boxCount : MAX_COUNT )
+ , agent_m        ( agent )
+ , pItems_m       ( pItems )
+{
+   for( dword b = boxCount_m;  b-- > 0; )
+   {
+      for( int i = 3;  i-- > 0; )
+      {
+         lowers_m[i][b] = pLowerCorners[b][i];
+         uppers_m[i][b] = pUpperCorners[b][i];
+      }
+   }
+}
+
+
+template<class TYPE, class AGENT>
+inline
+OctreeQueryBoxPacketV<TYPE,AGENT>::~OctreeQueryBoxPacketV()
+{
+}
+
+
+
+
+/// commands -------------------------------------------------------------------
+template<class TYPE, class AGENT>
+bool OctreeQueryBoxPacketV<TYPE,AGENT>::isEntering
+(
+   const OctreeData& cellData
+)
+{
+   const Vector3r& lower = cellData.getBound().getLowerCorner();
+   const Vector3r& upper = cellData.getBound().getUpperCorner();
+
+   // test every box against each axis's range
+   udword overlaps[MAX_COUNT];
+   udword insides [MAX_COUNT];
+   for( dword b = 0;  b < boxCount_m;  ++b )
+   {
+      overlaps[b] = 1;
+      insides[b]  = 1;
+   }
+   for( int i = 3;  i-- > 0; )
+   {
+      const real  l      = lower[i];
+      const real  u      = upper[i];
+      const real* lowers = lowers_m[i];
+      const real* uppers = uppers_m[i];
+      for( dword b = 0;  b < boxCount_m;  ++b )
+      {
+         overlaps[b] &= static_cast<udword>(l < uppers[b]) &
+                        static_cast<udword>(u > lowers[b]);
+         insides[b]  &= static_cast<udword>(l >= lowers[b]) &
+                        static_cast<udword>(u <= uppers[b]);
+      }
+   }
+
+   // active if overlapping, and active in the parent
+   udword mask   = 0;
+   udword inside = 0;
+   for( dword b = 0;  b < boxCount_m;  ++b )
+   {
+      mask   |= overlaps[b] << b;
+      inside |= insides[b]  << b;
+   }
+   const dword level = cellData.getLevel();
+   if( level > 0 )
+   {
+      mask &= activeMasks_m[level - 1];
+   }
+   activeMasks_m[level] = mask;
+   insideMasks_m[level] = mask & inside;
+
+   return 0 != mask;
+}
+
+
+template<class TYPE, class AGENT>
+void OctreeQueryBoxPacketV<TYPE,AGENT>::visitLeaf
+(
+   const void* const* pItems,
+   const dword        itemCount,
+   const OctreeData&  leafData
+)
+{
+   // for each active box: take all if it wholly contains the leaf, else test
+   // each
+   const udword mask   = activeMasks_m[ leafData.getLevel() ];
+   const udword inside = insideMasks_m[ leafData.getLevel() ];
+   for( dword b = 0;  b < boxCount_m;  ++b )
+   {
+      if( (mask >> b) & 1 )
+      {
+         const bool isInside = ((inside >> b) & 1) != 0;
+         for( dword i = 0;  i < itemCount;  ++i )
+         {
+            if( isInside || agent_m.isOverlappingCellV( pItems[i],
+               pLowerCorners_m[b], pUpperCorners_m[b] ) )
+            {
+               pItems_m[b].append( reinterpret_cast<const TYPE*>(
+                  pItems[i] ) );
+            }
+         }
+      }
+   }
+}
+
+
+template<class TYPE, class AGENT>
+void OctreeQueryBoxPacketV<TYPE,AGENT>::finish()
+{
+   for( dword b = boxCount_m;  b-- > 0; )
+   {
+      OctreeQueryBoxV<TYPE,AGENT>::sortUnique( pItems_m[b] );
+   }
+}
+
+
+
+
+/// statics --------------------------------------------------------------------
+template<class TYPE, class AGENT>
+template<class ROOT>
+void OctreeQueryBoxPacketV<TYPE,AGENT>::queryAll
+(
+   const ROOT&               root,
+   const dword               boxCount,
+   const Vector3r* const     pLowerCorners,
+   const Vector3r* const     pUpperCorners,
+   const AGENT&              agent,
+   Array<const TYPE*>* const pItems
+)
+{
+   for( dword b = boxCount;  b-- > 0; )
+   {
+      pItems[b].setLength( 0 );
+   }
+
+   // step through whole packets, then the remainder
+   for( dword i = 0;  i < boxCount;  i += MAX_COUNT )
+   {
+      OctreeQueryBoxPacketV query( pLowerCorners + i, pUpperCorners + i,
+         boxCount - i, agent, pItems + i );
+      root.query( query );
+      query.finish();
+   }
+}
+
+
+
+
+
+
+
+
+/**
+ * Parallel visit, for Octree implementation use.<br/><br/>
+ *
+ * visitAll splits the tree into subtrees, visits each with a clone of the
+ * visitor, as tasks on an OctreeTaskPool, then reduces the clones into the
+ * visitor in subtree order.<br/><br/>
+ *
+ * The subtrees are the cells of the shallowest level having at least
+ * SUBTREE_COUNT_MIN (or all there are), and the leafs above it, and the items
+ * of branchs above it holding any. Each is a task: a query (as for
+ * OctreeRoot::query) from the root that enters only the cells on the path to
+ * its subtree, then all the visitor wants within it (or, for a leaf or a
+ * branch's items, just those).
+ *
+ * @implementation
+ * The split is found by a query of each level in turn, that collects the
+ * cells of that level (and leafs above) without entering them. So it needs
+ * nothing of ROOT beyond query, and works the same for each kind of root.
+ */
+template<class TYPE, class ROOT>
+class OctreeVisitParallelV
+   : public OctreeTaskV
+{
+/// standard object services ---------------------------------------------------
+protected:
+            OctreeVisitParallelV( const ROOT&       root,
+                                  const OctreeData& subtreeData,
+                                  bool              isItemsOnly );
+public:
+   virtual ~OctreeVisitParallelV();
+private:
+            OctreeVisitParallelV( const OctreeVisitParallelV& );
+   OctreeVisitParallelV& operator=( const OctreeVisitParallelV& );
+public:
+
+
+/// commands -------------------------------------------------------------------
+   virtual void  run();
+
+           bool  isEntering( const OctreeData& cellData );
+           void  visitLeaf ( const void* const* pItems,
+                             dword              itemCount,
+                             const OctreeData&  leafData );
+
+
+/// statics --------------------------------------------------------------------
+   static  void  visitAll( const ROOT&                  root,
+                           OctreeVisitorParallel<TYPE>& visitor,
+                           dword                        threadCount );
+
+
+/// implementation -------------------------------------------------------------
+protected:
+   /**
+    * A cell to visit all of, or only the items of (a leaf, or a branch's
+    * own).
+    */
+   struct Subtree
+   {
+      OctreeData data;
+      bool       isItemsOnly;
+   };
+
+   /**
+    * Query collecting the cells of a level, and the leafs (and branchs' own
+    * items) above it.
+    */
+   class Splitter
+   {
+   public:
+      Splitter( OctreeVisitorParallel<TYPE>& visitor,
+                const dword                  level,
+                Array<Subtree>&              subtrees )
+       : visitor_m  ( visitor )
+       , level_m    ( level )
+       , subtrees_m ( subtrees )
+      {
+      }
+
+      bool isEntering( const OctreeData& cellData )
+      {
+         bool isEnter = false;
+
+         // above the level, enter; at it, collect
+         if( cellData.getLevel() < level_m )
+         {
+            isEnter = visitor_m.isEntering( cellData );
+         }
+         else if( visitor_m.isEntering( cellData ) )
+         {
+            const Subtree subtree = { cellData, false };
+            subtrees_m.append( subtree );
+         }
+
+         return isEnter;
+      }
+
+      void visitLeaf( const void* const* ,//pItems,
+                      const dword        ,//itemCount,
+                      const OctreeData&  leafData )
+      {
+         const Subtree subtree = { leafData, true };
+         subtrees_m.append( subtree );
+      }
+
+   private:
+      OctreeVisitorParallel<TYPE>& visitor_m;
+      dword                        level_m;
+      Array<Subtree>&              subtrees_m;
+   };
+
+   static  void  deleteAll( Array<OctreeVisitParallelV*>& subtrees );
+
+   /// least subtrees to split into (independent of thread count, so the
+   /// result is too)
+   static const dword SUBTREE_COUNT_MIN = 64;
+
+
+/// fields ---------------------------------------------------------------------
+private:
+   const ROOT&                  root_m;
+   OctreeData                   subtreeData_m;
+   bool                         isItemsOnly_m;
+   OctreeVisitorParallel<TYPE>* pVisitor_m;
+};
+
+
+
+
+/// standard object services ---------------------------------------------------
+template<class TYPE, class ROOT>
+inline
+OctreeVisitParallelV<TYPE,ROOT>::OctreeVisitParallelV
+(
+   const ROOT&       root,
+   const OctreeData& subtreeData,
+   const bool        isItemsOnly
+)
+ : root_m       ( root )
+ , subtreeData_m( subtreeData )
+ , isItemsOnly_m( isItemsOnly )
+ , pVisitor_m   ( 0 )
+{
+}
+
+
+template<class TYPE, class ROOT>
+OctreeVisitParallelV<TYPE,ROOT>::~OctreeVisitParallelV()
+{
+   delete pVisitor_m;
+}
+
+
+
+
+/// commands -------------------------------------------------------------------
+template<class TYPE, class ROOT>
+void OctreeVisitParallelV<TYPE,ROOT>::run()
+{
+   root_m.query( *this );
+}
+
+
+template<class TYPE, class ROOT>
+bool OctreeVisitParallelV<TYPE,ROOT>::isEntering
+(
+   const OctreeData& cellData
+)
+{
+   bool isEnter = false;
+
+   // down to the subtree, enter only cells holding it (the splitter has asked
+   // the visitor already); within it, ask the visitor (unless only its items
+   // are wanted)
+   if( cellData.getLevel() <= subtreeData_m.getLevel() )
+   {
+      const OctreeBound& bound = cellData.getBound();
+      isEnter = OctreeShape::isOverlappingPoint(
+         subtreeData_m.getBound().getCenter(), bound.getLowerCorner(),
+         bound.getUpperCorner() );
+   }
+   else if( !isItemsOnly_m )
+   {
+      isEnter = pVisitor_m->isEntering( cellData );
+   }
+
+   return isEnter;
+}
+
+
+template<class TYPE, class ROOT>
+inline
+void OctreeVisitParallelV<TYPE,ROOT>::visitLeaf
+(
+   const void* const* pItems,
+   const dword        itemCount,
+   const OctreeData&  leafData
+)
+{
+   // (items of branchs on the path to the subtree are another task's)
+   if( leafData.getLevel() >= subtreeData_m.getLevel() )
+   {
+      pVisitor_m->visitLeaf( reinterpret_cast<const TYPE* const*>( pItems ),
+         itemCount, leafData );
+   }
+}
+
+
+
+
+/// statics --------------------------------------------------------------------
+template<class TYPE, class ROOT>
+void OctreeVisitParallelV<TYPE,ROOT>::visitAll
+(
+   const ROOT&                  root,
+   OctreeVisitorParallel<TYPE>& visitor,
+   const dword                  threadCount
+)
+{
+   // split at the shallowest level with enough subtrees, or no more to come
+   Array<Subtree> cells;
+   bool isSplit = false;
+   for( dword level = 0;  !isSplit;  ++level )
+   {
+      const dword previousCount = cells.getLength();
+      cells.setLength( 0 );
+
+      Splitter splitter( visitor, level, cells );
+      root.query( splitter );
+
+      const dword count = cells.getLength();
+      isSplit = (count >= SUBTREE_COUNT_MIN) | (count == previousCount) |
+         (level >= root.getMaxLevelCount());
+   }
+
+   // make a task for each subtree, with its own clone of the visitor
+   Array<OctreeVisitParallelV*> subtrees;
+   try
+   {
+      const dword count = cells.getLength();
+      subtrees.reserve( count );
+      Array<OctreeTaskV*> tasks( count );
+      for( dword i = 0;  i < count;  ++i )
+      {
+         subtrees.append( new OctreeVisitParallelV( root, cells[i].data,
+            cells[i].isItemsOnly ) );
+         subtrees[i]->pVisitor_m = visitor.clone();
+         tasks[i] = subtrees[i];
+      }
+
+      OctreeTaskPool pool( threadCount );
+      pool.runAll( tasks.getStorage(), tasks.getLength() );
+
+      // merge the results, in subtree order
+      for( dword i = 0;  i < count;  ++i )
+      {
+         visitor.reduce( *(subtrees[i]->pVisitor_m) );
+      }
+   }
+   catch( ... )
+   {
+      deleteAll( subtrees );
+
+      throw;
+   }
+
+   deleteAll( subtrees );
+}
+
+
+template<class TYPE, class ROOT>
+void OctreeVisitParallelV<TYPE,ROOT>::deleteAll
+(
+   Array<OctreeVisitParallelV*>& subtrees
+)
+{
+   for( dword i = subtrees.getLength();  i-- > 0; )
+   {
+      delete subtrees[i];
+   }
+   subtrees.setLength( 0 );
+}
+
+
+
+
+/**
+ * Not for OctreeLooseRoot: subtrees are found by plain cell bounds. (Declared
+ * only, so a parallel visit of one does not compile.)
+ */
+template<class TYPE>
+class OctreeVisitParallelV<TYPE,OctreeLooseRoot>;
+
+
+
+
+
+
+
+
+/**
+ * Octree based spatial index.<br/><br/>
+ *
+ * Client must define concrete derivatives of OctreeAgent<ItemType> and
+ * OctreeVisitor<ItemType>.<br/><br/>
+ *
+ * maxItemCountPerCell is ignored where maxLevelCount or minCellSize is reached.
+ * <br/><br/>
+ *
+ * A branch collapses back to a leaf, on removal, when it holds no more than
+ * collapseItemCount item pointers. Below maxItemCountPerCell, that stops a
+ * cell whose count hovers about the max from splitting and collapsing over
+ * and over. At 0, only emptied branches go, and collapse can tidy the rest
+ * when idle.<br/><br/>
+ *
+ * The octree is cubical and axis aligned, partitions are axis aligned,
+ * partitions divide in half, each level partitions the previous level in all
+ * three axiss.<br/><br/>
+ *
+ * Storage is contracted or expanded as needed by item insertion and removal.
+ * <br/><br/>
+ *
+ * (Occupies, very approximately, 20 bytes per point item. maybe...)<br/><br/>
+ *
+ * Octree is only an index: it points to client items, it does not manage
+ * storage of items themselves.<br/><br/>
+ *
+ * ALLOCATOR is the storage for the octree's own cells: an OctreeAllocatorV
+ * derivative with a default constructor. Each octree has its own instance,
+ * shared with its copies. OctreeAllocatorPool (the default) recycles cells
+ * through slabs and releases them all at once at destruction;
+ * OctreeAllocatorHeap allocates each cell with new.<br/><br/>
+ *
+ * With OctreeRoot, copying is O(1): a copy shares all cells with the
+ * original, and whichever changes a shared cell first copies it (and the path
+ * to it from the root). So does assigning between copies of one octree
+ * (assigning between unrelated octrees copies the cells). A copy and its
+ * original can each be used on a different thread (shares are counted
+ * atomically, and the allocator is locked while shared), so a snapshot can
+ * be handed to another thread in O(1), and queried there while the original
+ * changes. Copying with isSharing false instead copies the cells into an
+ * allocator of its own, in O(n), so the two never contend for it. To query
+ * on several threads at once, use OctreeConcurrent.<br/><br/>
+ *
+ * ROOT is the implementation: OctreeRoot (the default), a tree of cells; or
+ * OctreeLinear, a sorted array of leafs (then ALLOCATOR is unused, and
+ * insertRange uses only the calling thread). Both present the same cells and
+ * items, for the same commands, to agents and visitors (except items covering
+ * a branch, which OctreeLinear holds in the leafs below, see
+ * OctreeAgent::isCoveringCell). Or
+ * OctreeStripedRoot, a tree with fixed top levels each locked separately
+ * (then ALLOCATOR is unused, and all members but copying and assignment can be
+ * called on several threads at once). Or OctreeLooseRoot, a loose octree
+ * holding each item once, in a cell about its size (then the agent must give
+ * item bounds, by getBound, and there is no visitParallel or freeze).
+ * <br/><br/>
+ *
+ * Built with OCTREE_INSTRUMENTED defined, each call is counted and timed (see
+ * getCounts). Otherwise the counting is compiled out.<br/><br/>
+ *
+ * @see OctreeAgent
+ * @see OctreeVisitor
+ * @see OctreeAllocatorPool
+ * @see OctreeStatic
+ * @see OctreeConcurrent
+ *
+ * @implementation
+ * The octree structure follows the Composite pattern.<br/><br/>
+ *
+ * This template wrapper ensures the items indexed by the octree, and the agents
+ * and visitors used when accessing them are, of matching types. All algorithmic
+ * work is delegated to OctreeRoot and OctreeCell derivatives in
+ * OctreeImplementation, which work with abstract base interfaces and void
+ * pointers.<br/><br/>
+ *
+ * For the insertion and removal commands, the agent provides an interface for
+ * the octree to query the typeless item, and for the visit query, the visitor
+ * provides callbacks to read tree nodes for carrying out the visit operation.
+ */
+template<class TYPE, class ALLOCATOR = OctreeAllocatorPool,
+   class ROOT = OctreeRoot>
+class Octree
+{
+/// standard object services ---------------------------------------------------
+public:
+   /**
+    * Constructs a particular format of octree.<br/><br/>
+    * @parameters
+    * * sizeOfCube is desired length along a side<br/>
+    * * maxItemCountPerCell is desired max item pointers per leaf<br/>
+    * * maxLevelCount is desired max depth of tree<br/>
+    * * minCellSize is desired min size of cells<br/>
+    * * collapseItemCount is item pointers at or below which a branch
+    *   collapses to a leaf on removal -- at most (and by default)
+    *   maxItemCountPerCell<br/>
+    * * looseness is, for OctreeLooseRoot only, how many times its size each
+    *   cell's bound is expanded to for holding items -- at least 1, and by
+    *   default 2<br/>
+    */
+            Octree( const Vector3r& positionOfLowerCorner,
+                    real            sizeOfCube,
+                    dword           maxItemCountPerCell,
+                    dword           maxLevelCount,
+                    real            minCellSize,
+                    dword           collapseItemCount = DWORD_MAX,
+                    real            looseness = 2.0f );
+
+           ~Octree();
+            Octree( const Octree& );
+   /**
+    * Copies, sharing the other's cells (as the copy constructor), or, if not
+    * isSharing, copying them into an allocator of its own -- so the copy
+    * shares nothing, and never contends with the other for the allocator.
+    * <br/><br/>
+    * @exceptions
+    * Can throw storage allocation exceptions.
+    */
+            Octree( const Octree& other,
+                    bool          isSharing );
+   /**
+    * @exceptions
+    * Can throw storage allocation exceptions. In such cases the octree is
+    * unmodified.
+    */
+   Octree& operator=( const Octree& );
+
+
+/// commands -------------------------------------------------------------------
+   /**
+    * Add pointer(s) to the item to the octree.<br/><br/>
+    * (If an item has non-zero volume, it may have pointers in multiple
+    * cells.)<br/><br/>
+    * @return is the item inserted -- false if item not inside root bound
+    * @exceptions
+    * Can throw storage allocation exceptions. In such cases the octree remains
+    * structurally ok, but the item will not be fully added, -- call this
+    * method again or the remove method.
+    * @see remove, OctreeAgent
+    */
+           bool  insert( const TYPE&              item,
+                         const OctreeAgent<TYPE>& agent );
+   /**
+    * Add pointer(s) to each of an array of items to the octree.<br/><br/>
+    * The result is the same as inserting each in turn, but the items are
+    * partitioned among the cells top-down in one pass, instead of leafs
+    * filling and subdividing repeatedly.<br/><br/>
+    * With threadCount above 1, subtrees are built in parallel on that many
+    * threads (the result is the same). The agent is then called from several
+    * threads at once.<br/><br/>
+    * @return how many items inserted -- those inside root bound
+    * @exceptions
+    * Can throw storage allocation exceptions. In such cases the octree remains
+    * structurally ok, but the items will not be fully added, -- call this
+    * method again or the remove method.
+    * @see insert, OctreeAgent
+    */
+           dword insertRange( const TYPE*              pItems,
+                              dword                    itemCount,
+                              const OctreeAgent<TYPE>& agent,
+                              dword                    threadCount = 1 );
+   /**
+    * Removes pointer(s) to the item from the octree.<br/><br/>
+    * (If an item has non-zero volume, it may have pointers in multiple
+    * cells.)<br/><br/>
+    * Only the cells the agent reports the item overlapping are searched, so
+    * the item must have the same position and extent as when inserted.
+    * <br/><br/>
+    * @return is the item removed -- false if item wasn't present
+    * @exceptions
+    * Can throw storage allocation exceptions. In such cases the octree remains
+    * structurally ok, but the item will not be fully removed, -- call this
+    * method again or the insert method.
+    * @see insert, OctreeAgent
+    */
+           bool  remove( const TYPE&              item,
+                         const OctreeAgent<TYPE>& agent );
+   /**
+    * Collapses to a leaf every branch holding no more than
+    * maxItemCountPerCell item pointers -- what removal leaves, above the
+    * collapse item count. For when idle, so a low collapse count defers the
+    * restructuring, instead of dropping it.<br/><br/>
+    * O(branches). A copy's branchs are copied only if something in them
+    * collapses.
+    * @exceptions
+    * Can throw storage allocation exceptions. In such cases the octree remains
+    * structurally ok, but not every branch may be collapsed.
+    * @see remove
+    */
+           void  collapse();
+
+
+/// queries --------------------------------------------------------------------
+   /**
+    * Execute a visit query operation.
+    * @see OctreeVisitor
+    */
+           void  visit( OctreeVisitor<TYPE>& visitor )                    const;
+   /**
+    * Execute a visit query operation, on threadCount threads.<br/><br/>
+    * The tree is split into subtrees, each visited by a clone of the visitor,
+    * and the clones are reduced into it in subtree order. So the result is
+    * the same for any thread count.
+    * @exceptions
+    * Can throw storage allocation exceptions (or std::bad_alloc, if the
+    * visitor throws on a thread). In such cases the visitor has none of the
+    * results of its clones.
+    * @see OctreeVisitorParallel
+    */
+           void  visitParallel( OctreeVisitorParallel<TYPE>& visitor,
+                                dword                        threadCount )
+                                                                          const;
+   /**
+    * Execute a direct query operation (as OctreeFrozen::query).
+    */
+   template<class QUERY>
+           void  query( QUERY& query,
+                        dword  subCellOrder = 0 )                         const;
+   /**
+    * Finds the items overlapping a box, by the agent's isOverlappingCell,
+    * into items (replacing what it held). Each is given once, in no
+    * particular order.<br/><br/>
+    * The storage of items is reused, so repeated queries with the same array
+    * allocate only when it must grow.<br/><br/>
+    * @exceptions
+    * Can throw storage allocation exceptions. In such cases items is
+    * incomplete.
+    */
+           void  queryBox( const Vector3r&          lowerCorner,
+                           const Vector3r&          upperCorner,
+                           const OctreeAgent<TYPE>& agent,
+                           Array<const TYPE*>&      items )               const;
+   /**
+    * Finds the k items nearest a point, within maxDistance, by the agent's
+    * getDistance, into items and distances (replacing what they held),
+    * nearest first. Each is given once; fewer if fewer are in range.
+    * <br/><br/>
+    * Cells are searched nearest first, and those farther than the kth
+    * nearest item found so far are skipped. The point should be inside the
+    * root bound: else an item nearest by a part outside it may be missed.
+    * <br/><br/>
+    * @exceptions
+    * Can throw storage allocation exceptions. In such cases items and
+    * distances are incomplete.
+    */
+           void  queryNearest( const Vector3r&          point,
+                               dword                    k,
+                               real                     maxDistance,
+                               const OctreeAgent<TYPE>& agent,
+                               Array<const TYPE*>&      items,
+                               Array<real>&             distances )       const;
+   /**
+    * Finds the item a ray first hits, by the agent's getRayIntersection,
+    * before maxT. The ray is rayOrigin + (rayDirection * t), for t at or
+    * above 0.<br/><br/>
+    * Only cells the ray crosses are entered, front-to-back, and none beyond
+    * the nearest hit found so far. So items are hit only where inside the
+    * root bound.
+    * @return the item hit, or 0 if none; hitT is its t (else maxT)
+    */
+           const TYPE* queryRay( const Vector3r&          rayOrigin,
+                                 const Vector3r&          rayDirection,
+                                 real                     maxT,
+                                 const OctreeAgent<TYPE>& agent,
+                                 real&                    hitT )          const;
+   /**
+    * As queryRay, for each of an array of rays, into arrays of the items hit
+    * and their ts.<br/><br/>
+    * The rays are taken in packets of up to 32, each traversing the tree once
+    * (entering only cells some of its rays cross). So packets of rays that
+    * are near each other and point the same way (by sign on each axis) go
+    * fastest.
+    */
+           void  queryRays( dword                    rayCount,
+                            const Vector3r*          pRayOrigins,
+                            const Vector3r*          pRayDirections,
+                            real                     maxT,
+                            const OctreeAgent<TYPE>& agent,
+                            const TYPE**             pHitItems,
+                            real*                    pHitTs )             const;
+   /**
+    * As queryBox, for each of an array of boxes, into an array of item
+    * arrays.<br/><br/>
+    * The boxes are taken in packets of up to 32, each traversing the tree
+    * once (entering only cells some of its boxes overlap).
+    * @exceptions
+    * Can throw storage allocation exceptions. In such cases the item arrays
+    * are incomplete.
+    */
+           void  queryBoxes( dword                    boxCount,
+                             const Vector3r*          pLowerCorners,
+                             const Vector3r*          pUpperCorners,
+                             const OctreeAgent<TYPE>& agent,
+                             Array<const TYPE*>*      pItems )            const;
+   /**
+    * Copies the octree's cells and items into an immutable form, for faster
+    * querying (replacing what it held).<br/><br/>
+    * @exceptions
+    * Can throw storage allocation exceptions. In such cases the frozen octree
+    * is unmodified.
+    * @see OctreeFrozen
+    */
+           void  freeze( OctreeFrozen<TYPE>& frozen )                     const;
+
+   /**
+    * Reports if the octree is empty.
+    */
+           bool  isEmpty()                                                const;
+   /**
+    * Provides stats on the octree. Kept up to date by the commands, so this
+    * is quick.<br/><br/>
+    * @parameters
+    * * byteSize is size in bytes<br/>
+    * * leafCount is number of leafs<br/>
+    * * itemRefCount is total number of item pointers in all leafs and
+    *   branchs<br/>
+    * * maxDepth is deepest depth of tree<br/>
+    */
+           void  getInfo( dword& byteSize,
+                          dword& leafCount,
+                          dword& itemRefCount,
+                          dword& maxDepth )                               const;
+   /**
+    * Provides fuller stats on the octree: cell counts by level, leaf counts
+    * by fill, and the distinct item count (so refs per item).
+    * @see OctreeStats
+    */
+           void  getStats( OctreeStats& stats )                           const;
+   /**
+    * Provides the traversal counts of the calls made on this octree (not on
+    * its copies) since construction or the last clearing: for each kind of
+    * call, the cells entered (by level), OctreeData made, agent and query
+    * overlap tests (and those failing, so exiting early), leaf items
+    * scanned, and a histogram of latencies with the counts of the slowest.
+    * <br/><br/>
+    * Only with OCTREE_INSTRUMENTED defined -- otherwise all are zero. Work
+    * done on task threads (by insertRange or visitParallel with threadCount
+    * above 1) is in the latency, but not in the counts.
+    * @see OctreeCounts
+    */
+           void  getCounts( OctreeCounts& counts,
+                            bool          isClearing = false )            const;
+
+   /**
+    * Gives the position supplied at construction.
+    */
+           const Vector3r& getPosition()                                  const;
+   /**
+    * Gives the size supplied at construction.
+    */
+           real            getSize()                                      const;
+   /**
+    * Gives the leaf pointer limit supplied at construction.
+    */
+           dword           getMaxItemCountPerCell()                       const;
+   /**
+    * Gives the depth limit supplied at construction.
+    */
+           dword           getMaxLevelCount()                             const;
+   /**
+    * Gives the size limit supplied at construction.
+    */
+           real            getMinCellSize()                               const;
+   /**
+    * Gives the collapse item count supplied at construction (clamped to
+    * getMaxItemCountPerCell).
+    */
+           dword           getCollapseItemCount()                         const;
+   /**
+    * Gives the looseness supplied at construction (clamped to at least 1).
+    */
+           real            getLooseness()                                 const;
+
+
+/// fields ---------------------------------------------------------------------
+private:
+   OctreeAllocatorShared<ALLOCATOR> allocator_m;
+   ROOT                             root_m;
+
+#ifdef OCTREE_INSTRUMENTED
+   mutable OctreeCounts             counts_m;
+   mutable OctreeMutex              countsMutex_m;
+#endif
+};
+
+
+
+
+/// templates ///
+
+/// standard object services ---------------------------------------------------
+template<class TYPE, class ALLOCATOR, class ROOT>
+inline
+Octree<TYPE,ALLOCATOR,ROOT>::Octree
+(
+   const Vector3r& position,
+   const real      sizeOfCube,
+   const dword     maxItemCountPerCell,
+   const dword     maxLevelCount,
+   const real      minCellSize,
+   const dword     collapseItemCount,
+   const real      looseness
+)
+ : allocator_m()
+ , root_m     ( position, sizeOfCube, maxItemCountPerCell, maxLevelCount,
+      minCellSize, collapseItemCount, allocator_m.get(), looseness )
+{
+}
+
+
+template<class TYPE, class ALLOCATOR, class ROOT>
+inline
+Octree<TYPE,ALLOCATOR,ROOT>::~Octree()
+{
+}
+
+
+template<class TYPE, class ALLOCATOR, class ROOT>
+inline
+Octree<TYPE,ALLOCATOR,ROOT>::Octree
+(
+   const Octree& other
+)
+ : allocator_m( other.allocator_m )
+ , root_m     ( other.root_m, allocator_m.get() )
+{
+}
+
+
+template<class TYPE, class ALLOCATOR, class ROOT>
+inline
+Octree<TYPE,ALLOCATOR,ROOT>::Octree
+(
+   const Octree& other,
+   const bool    isSharing
+)
+ : allocator_m( isSharing ? other.allocator_m :
+      OctreeAllocatorShared<ALLOCATOR>() )
+ , root_m     ( other.root_m, allocator_m.get() )
+{
+}
+
+
+template<class TYPE, class ALLOCATOR, class ROOT>
+inline
+Octree<TYPE,ALLOCATOR,ROOT>& Octree<TYPE,ALLOCATOR,ROOT>::operator=
+(
+   const Octree& other
+)
+{
+   root_m = other.root_m;
+
+   return *this;
+}
+
+
+
+
+/// commands -------------------------------------------------------------------
+template<class TYPE, class ALLOCATOR, class ROOT>
+inline
+bool Octree<TYPE,ALLOCATOR,ROOT>::insert
+(
+   const TYPE&              item,
+   const OctreeAgent<TYPE>& agent
+)
+{
+   OCTREE_COUNTED( counts_m, countsMutex_m, OctreeCounts::INSERT );
+
+   return root_m.insert( &item, agent );
+}
+
+
+template<class TYPE, class ALLOCATOR, class ROOT>
+dword Octree<TYPE,ALLOCATOR,ROOT>::insertRange
+(
+   const TYPE* const        pItems,
+   const dword              itemCount,
+   const OctreeAgent<TYPE>& agent,
+   const dword              threadCount
+)
+{
+   OCTREE_COUNTED( counts_m, countsMutex_m, OctreeCounts::INSERT_RANGE );
+
+   // make item pointers
+   Array<const void*> items( itemCount );
+   for( dword i = 0;  i < itemCount;  ++i )
+   {
+      items[i] = pItems + i;
+   }
+
+   return root_m.insertRange( items.getStorage(), items.getLength(), agent,
+      threadCount );
+}
+
+
+template<class TYPE, class ALLOCATOR, class ROOT>
+inline
+bool Octree<TYPE,ALLOCATOR,ROOT>::remove
+(
+   const TYPE&              item,
+   const OctreeAgent<TYPE>& agent
+)
+{
+   OCTREE_COUNTED( counts_m, countsMutex_m, OctreeCounts::REMOVE );
+
+   return root_m.remove( &item, agent );
+}
+
+
+template<class TYPE, class ALLOCATOR, class ROOT>
+inline
+void Octree<TYPE,ALLOCATOR,ROOT>::collapse()
+{
+   root_m.collapse();
+}
+
+
+
+
+/// queries --------------------------------------------------------------------
+template<class TYPE, class ALLOCATOR, class ROOT>
+inline
+void Octree<TYPE,ALLOCATOR,ROOT>::visit
+(
+   OctreeVisitor<TYPE>& visitor
+) const
+{
+   OCTREE_COUNTED( counts_m, countsMutex_m, OctreeCounts::VISIT );
+
+   root_m.visit( visitor );
+}
+
+
+template<class TYPE, class ALLOCATOR, class ROOT>
+void Octree<TYPE,ALLOCATOR,ROOT>::visitParallel
+(
+   OctreeVisitorParallel<TYPE>& visitor,
+   const dword                  threadCount
+) const
+{
+   OCTREE_COUNTED( counts_m, countsMutex_m, OctreeCounts::VISIT );
+
+   OctreeVisitParallelV<TYPE,ROOT>::visitAll( root_m, visitor, threadCount );
+}
+
+
+template<class TYPE, class ALLOCATOR, class ROOT>
+template<class QUERY>
+inline
+void Octree<TYPE,ALLOCATOR,ROOT>::query
+(
+   QUERY&      query,
+   const dword subCellOrder
+) const
+{
+   OCTREE_COUNTED( counts_m, countsMutex_m, OctreeCounts::QUERY );
+
+   typename OctreeFrozen<TYPE>::template QueryV<QUERY> queryV( query );
+   root_m.query( queryV, subCellOrder );
+}
+
+
+template<class TYPE, class ALLOCATOR, class ROOT>
+void Octree<TYPE,ALLOCATOR,ROOT>::queryBox
+(
+   const Vector3r&          lowerCorner,
+   const Vector3r&          upperCorner,
+   const OctreeAgent<TYPE>& agent,
+   Array<const TYPE*>&      items
+) const
+{
+   OCTREE_COUNTED( counts_m, countsMutex_m, OctreeCounts::QUERY );
+
+   items.setLength( 0 );
+
+   OctreeQueryBoxV<TYPE,OctreeAgentV> query( lowerCorner, upperCorner, agent,
+      items );
+   root_m.query( query );
+   query.finish();
+}
+
+
+template<class TYPE, class ALLOCATOR, class ROOT>
+void Octree<TYPE,ALLOCATOR,ROOT>::queryNearest
+(
+   const Vector3r&          point,
+   const dword              k,
+   const real               maxDistance,
+   const OctreeAgent<TYPE>& agent,
+   Array<const TYPE*>&      items,
+   Array<real>&             distances
+) const
+{
+   OCTREE_COUNTED( counts_m, countsMutex_m, OctreeCounts::QUERY );
+
+   items.setLength( 0 );
+   distances.setLength( 0 );
+
+   if( k > 0 )
+   {
+      OctreeQueryNearestV<TYPE,OctreeAgentV> query( point, k, maxDistance,
+         agent );
+      root_m.queryNearest( query );
+      query.finish( items, distances );
+   }
+}
+
+
+template<class TYPE, class ALLOCATOR, class ROOT>
+const TYPE* Octree<TYPE,ALLOCATOR,ROOT>::queryRay
+(
+   const Vector3r&          rayOrigin,
+   const Vector3r&          rayDirection,
+   const real               maxT,
+   const OctreeAgent<TYPE>& agent,
+   real&                    hitT
+) const
+{
+   OCTREE_COUNTED( counts_m, countsMutex_m, OctreeCounts::QUERY );
+
+   OctreeQueryRayV<TYPE,OctreeAgentV> query( rayOrigin, rayDirection, maxT,
+      agent );
+   root_m.query( query, query.getSubcellOrder() );
+
+   hitT = query.getHitT();
+   return query.getHitItem();
+}
+
+
+template<class TYPE, class ALLOCATOR, class ROOT>
+void Octree<TYPE,ALLOCATOR,ROOT>::queryRays
+(
+   const dword               rayCount,
+   const Vector3r* const     pRayOrigins,
+   const Vector3r* const     pRayDirections,
+   const real                maxT,
+   const OctreeAgent<TYPE>&  agent,
+   const TYPE** const        pHitItems,
+   real* const               pHitTs
+) const
+{
+   OCTREE_COUNTED( counts_m, countsMutex_m, OctreeCounts::QUERY );
+
+   OctreeQueryRayPacketV<TYPE,OctreeAgentV>::queryAll( root_m,
+      rayCount, pRayOrigins, pRayDirections, maxT, agent, pHitItems, pHitTs );
+}
+
+
+template<class TYPE, class ALLOCATOR, class ROOT>
+void Octree<TYPE,ALLOCATOR,ROOT>::queryBoxes
+(
+   const dword               boxCount,
+   const Vector3r* const     pLowerCorners,
+   const Vector3r* const     pUpperCorners,
+   const OctreeAgent<TYPE>&  agent,
+   Array<const TYPE*>* const pItems
+) const
+{
+   OCTREE_COUNTED( counts_m, countsMutex_m, OctreeCounts::QUERY );
+
+   OctreeQueryBoxPacketV<TYPE,OctreeAgentV>::queryAll( root_m,
+      boxCount, pLowerCorners, pUpperCorners, agent, pItems );
+}
+
+
+template<class TYPE, class ALLOCATOR, class ROOT>
+inline
+void Octree<TYPE,ALLOCATOR,ROOT>::freeze
+(
+   OctreeFrozen<TYPE>& frozen
+) const
+{
+   frozen.root_m.freeze( root_m );
+}
+
+
+template<class TYPE, class ALLOCATOR, class ROOT>
+inline
+bool Octree<TYPE,ALLOCATOR,ROOT>::isEmpty() const
+{
+   return root_m.isEmpty();
+}
+
+
+template<class TYPE, class ALLOCATOR, class ROOT>
+inline
+void Octree<TYPE,ALLOCATOR,ROOT>::getInfo
+(
+   dword& byteSize,
+   dword& leafCount,
+   dword& itemRefCount,
+   dword& maxDepth
+) const
+{
+   root_m.getInfo( sizeof(*this), byteSize, leafCount, itemRefCount, maxDepth );
+}
+
+
+template<class TYPE, class ALLOCATOR, class ROOT>
+inline
+void Octree<TYPE,ALLOCATOR,ROOT>::getStats
+(
+   OctreeStats& stats
+) const
+{
+   root_m.getStats( stats );
+}
+
+
+template<class TYPE, class ALLOCATOR, class ROOT>
+void Octree<TYPE,ALLOCATOR,ROOT>::getCounts
+(
+   OctreeCounts& counts,
+   const bool    isClearing
+) const
+{
+#ifdef OCTREE_INSTRUMENTED
+   OctreeMutexLocked locked( countsMutex_m );
+
+   counts = counts_m;
+   if( isClearing )
+   {
+      counts_m = OctreeCounts();
+   }
+#else
+   counts = OctreeCounts();
+   static_cast<void>( isClearing );
+#endif
+}
+
+
+template<class TYPE, class ALLOCATOR, class ROOT>
+inline
+const Vector3r& Octree<TYPE,ALLOCATOR,ROOT>::getPosition() const
+{
+   return root_m.getPosition();
+}
+
+
+template<class TYPE, class ALLOCATOR, class ROOT>
+inline
+real Octree<TYPE,ALLOCATOR,ROOT>::getSize() const
+{
+   return root_m.getSize();
+}
+
+
+template<class TYPE, class ALLOCATOR, class ROOT>
+inline
+dword Octree<TYPE,ALLOCATOR,ROOT>::getMaxItemCountPerCell() const
+{
+   return root_m.getMaxItemCountPerCell();
+}
+
+
+template<class TYPE, class ALLOCATOR, class ROOT>
+inline
+dword Octree<TYPE,ALLOCATOR,ROOT>::getMaxLevelCount() const
+{
+   return root_m.getMaxLevelCount();
+}
+
+
+template<class TYPE, class ALLOCATOR, class ROOT>
+inline
+real Octree<TYPE,ALLOCATOR,ROOT>::getMinCellSize() const
+{
+   return root_m.getMinCellSize();
+}
+
+
+template<class TYPE, class ALLOCATOR, class ROOT>
+inline
+dword Octree<TYPE,ALLOCATOR,ROOT>::getCollapseItemCount() const
+{
+   return root_m.getCollapseItemCount();
+}
+
+
+template<class TYPE, class ALLOCATOR, class ROOT>
+inline
+real Octree<TYPE,ALLOCATOR,ROOT>::getLooseness() const
+{
+   return root_m.getLooseness();
+}
+
+
+
+
+
+
+
+
+/**
+ * Immutable octree, made by Octree::freeze, for faster querying.<br/><br/>
+ *
+ * Holds the same cells and items as the octree it was frozen from, in a flat
+ * layout: nodes in one array, subcells addressed by index and occupancy mask,
+ * and item pointers in one array.<br/><br/>
+ *
+ * It can be visited as an Octree, with an OctreeVisitor<ItemType>. Or, faster,
+ * queried with any class having these member functions, which are called
+ * directly (not virtually):
+ * <pre>
+ *    bool isEntering( const OctreeData& cellData );
+ *    void visitLeaf ( const ItemType* const* pItems,
+ *                     dword                  itemCount,
+ *                     const OctreeData&      leafData );
+ * </pre>
+ * isEntering is asked for each cell, from the root down, and the cell's
+ * subcells are skipped if it gives false. visitLeaf is called for each leaf
+ * entered, in subcell order -- or with subCellOrder, in the order
+ * i ^ subCellOrder for i from 0 to 7 (so, with a bit set for each axis a ray
+ * goes negatively along, front-to-back along the ray). It is called too for
+ * each branch entered that holds items itself (see
+ * OctreeAgent::isCoveringCell), before its subcells.
+ *
+ * @see Octree
+ * @see OctreeVisitor
+ *
+ * @implementation
+ * Work is delegated to OctreeFrozenRoot.
+ */
+template<class TYPE>
+class OctreeFrozen
+{
+/// standard object services ---------------------------------------------------
+public:
+   /**
+    * Constructs an empty frozen octree (give it content with Octree::freeze).
+    */
+            OctreeFrozen();
+
+           ~OctreeFrozen();
+            OctreeFrozen( const OctreeFrozen& );
+   /**
+    * @exceptions
+    * Can throw storage allocation exceptions. In such cases the frozen octree
+    * is unmodified.
+    */
+   OctreeFrozen& operator=( const OctreeFrozen& );
+
+
+/// queries --------------------------------------------------------------------
+   /**
+    * Execute a visit query operation.
+    * @see OctreeVisitor
+    */
+           void  visit( OctreeVisitor<TYPE>& visitor )                    const;
+   /**
+    * As Octree::visitParallel.
+    */
+           void  visitParallel( OctreeVisitorParallel<TYPE>& visitor,
+                                dword                        threadCount )
+                                                                          const;
+   /**
+    * Execute a direct query operation.
+    */
+   template<class QUERY>
+           void  query( QUERY& query,
+                        dword  subCellOrder = 0 )                         const;
+   /**
+    * As Octree::queryBox.
+    */
+           void  queryBox( const Vector3r&          lowerCorner,
+                           const Vector3r&          upperCorner,
+                           const OctreeAgent<TYPE>& agent,
+                           Array<const TYPE*>&      items )               const;
+   /**
+    * As Octree::queryNearest.
+    */
+           void  queryNearest( const Vector3r&          point,
+                               dword                    k,
+                               real                     maxDistance,
+                               const OctreeAgent<TYPE>& agent,
+                               Array<const TYPE*>&      items,
+                               Array<real>&             distances )       const;
+   /**
+    * As Octree::queryRay.
+    */
+           const TYPE* queryRay( const Vector3r&          rayOrigin,
+                                 const Vector3r&          rayDirection,
+                                 real                     maxT,
+                                 const OctreeAgent<TYPE>& agent,
+                                 real&                    hitT )          const;
+   /**
+    * As Octree::queryRays.
+    */
+           void  queryRays( dword                    rayCount,
+                            const Vector3r*          pRayOrigins,
+                            const Vector3r*          pRayDirections,
+                            real                     maxT,
+                            const OctreeAgent<TYPE>& agent,
+                            const TYPE**             pHitItems,
+                            real*                    pHitTs )             const;
+   /**
+    * As Octree::queryBoxes.
+    */
+           void  queryBoxes( dword                    boxCount,
+                             const Vector3r*          pLowerCorners,
+                             const Vector3r*          pUpperCorners,
+                             const OctreeAgent<TYPE>& agent,
+                             Array<const TYPE*>*      pItems )            const;
+
+   /**
+    * Reports if the frozen octree is empty.
+    */
+           bool  isEmpty()                                                const;
+   /**
+    * Provides stats on the frozen octree (as Octree::getInfo).
+    */
+           void  getInfo( dword& byteSize,
+                          dword& leafCount,
+                          dword& itemRefCount,
+                          dword& maxDepth )                               const;
+
+           const Vector3r& getPosition()                                  const;
+           real            getSize()                                      const;
+           dword           getMaxItemCountPerCell()                       const;
+           dword           getMaxLevelCount()                             const;
+           real            getMinCellSize()                               const;
+
+
+/// implementation -------------------------------------------------------------
+private:
+   /**
+    * Void-to-type forwarder for a query.
+    */
+   template<class QUERY>
+   class QueryV
+   {
+   public:
+      explicit QueryV( QUERY& query )
+       : query_m( query )
+      {
+      }
+
+      bool isEntering( const OctreeData& cellData )
+      {
+         return query_m.isEntering( cellData );
+      }
+
+      void visitLeaf( const void* const* pItems,
+                      const dword        itemCount,
+                      const OctreeData&  leafData )
+      {
+         query_m.visitLeaf( reinterpret_cast<const TYPE* const*>( pItems ),
+            itemCount, leafData );
+      }
+
+   private:
+      QUERY& query_m;
+   };
+
+   template<class, class, class> friend class Octree;
+   template<class, class, class> friend class OctreeStatic;
+   template<class>               friend class OctreeReader;
+
+
+/// fields ---------------------------------------------------------------------
+   OctreeFrozenRoot root_m;
+};
+
+
+
+
+/// templates ///
+
+/// standard object services ---------------------------------------------------
+template<class TYPE>
+inline
+OctreeFrozen<TYPE>::OctreeFrozen()
+ : root_m()
+{
+}
+
+
+template<class TYPE>
+inline
+OctreeFrozen<TYPE>::~OctreeFrozen()
+{
+}
+
+
+template<class TYPE>
+inline
+OctreeFrozen<TYPE>::OctreeFrozen
+(
+   const OctreeFrozen& other
+)
+ : root_m( other.root_m )
+{
+}
+
+
+template<class TYPE>
+inline
+OctreeFrozen<TYPE>& OctreeFrozen<TYPE>::operator=
+(
+   const OctreeFrozen& other
+)
+{
+   root_m = other.root_m;
+
+   return *this;
+}
+
+
+
+
+/// queries --------------------------------------------------------------------
+template<class TYPE>
+inline
+void OctreeFrozen<TYPE>::visit
+(
+   OctreeVisitor<TYPE>& visitor
+) const
+{
+   root_m.visit( visitor );
+}
+
+
+template<class TYPE>
+void OctreeFrozen<TYPE>::visitParallel
+(
+   OctreeVisitorParallel<TYPE>& visitor,
+   const dword                  threadCount
+) const
+{
+   OctreeVisitParallelV<TYPE,OctreeFrozenRoot>::visitAll( root_m, visitor,
+      threadCount );
+}
+
+
+template<class TYPE>
+template<class QUERY>
+inline
+void OctreeFrozen<TYPE>::query
+(
+   QUERY&      query,
+   const dword subCellOrder
+) const
+{
+   QueryV<QUERY> queryV( query );
+   root_m.query( queryV, subCellOrder );
+}
+
+
+template<class TYPE>
+void OctreeFrozen<TYPE>::queryBox
+(
+   const Vector3r&          lowerCorner,
+   const Vector3r&          upperCorner,
+   const OctreeAgent<TYPE>& agent,
+   Array<const TYPE*>&      items
+) const
+{
+   items.setLength( 0 );
+
+   OctreeQueryBoxV<TYPE,OctreeAgentV> query( lowerCorner, upperCorner, agent,
+      items );
+   root_m.query( query );
+   query.finish();
+}
+
+
+template<class TYPE>
+void OctreeFrozen<TYPE>::queryNearest
+(
+   const Vector3r&          point,
+   const dword              k,
+   const real               maxDistance,
+   const OctreeAgent<TYPE>& agent,
+   Array<const TYPE*>&      items,
+   Array<real>&             distances
+) const
+{
+   items.setLength( 0 );
+   distances.setLength( 0 );
+
+   if( k > 0 )
+   {
+      OctreeQueryNearestV<TYPE,OctreeAgentV> query( point, k, maxDistance,
+         agent );
+      root_m.queryNearest( query );
+      query.finish( items, distances );
+   }
+}
+
+
+template<class TYPE>
+const TYPE* OctreeFrozen<TYPE>::queryRay
+(
+   const Vector3r&          rayOrigin,
+   const Vector3r&          rayDirection,
+   const real               maxT,
+   const OctreeAgent<TYPE>& agent,
+   real&                    hitT
+) const
+{
+   OctreeQueryRayV<TYPE,OctreeAgentV> query( rayOrigin, rayDirection, maxT,
+      agent );
+   root_m.query( query, query.getSubcellOrder() );
+
+   hitT = query.getHitT();
+   return query.getHitItem();
+}
+
+
+template<class TYPE>
+void OctreeFrozen<TYPE>::queryRays
+(
+   const dword               rayCount,
+   const Vector3r* const     pRayOrigins,
+   const Vector3r* const     pRayDirections,
+   const real                maxT,
+   const OctreeAgent<TYPE>&  agent,
+   const TYPE** const        pHitItems,
+   real* const               pHitTs
+) const
+{
+   OctreeQueryRayPacketV<TYPE,OctreeAgentV>::queryAll( root_m,
+      rayCount, pRayOrigins, pRayDirections, maxT, agent, pHitItems, pHitTs );
+}
+
+
+template<class TYPE>
+void OctreeFrozen<TYPE>::queryBoxes
+(
+   const dword               boxCount,
+   const Vector3r* const     pLowerCorners,
+   const Vector3r* const     pUpperCorners,
+   const OctreeAgent<TYPE>&  agent,
+   Array<const TYPE*>* const pItems
+) const
+{
+   OctreeQueryBoxPacketV<TYPE,OctreeAgentV>::queryAll( root_m,
+      boxCount, pLowerCorners, pUpperCorners, agent, pItems );
+}
+
+
+template<class TYPE>
+inline
+bool OctreeFrozen<TYPE>::isEmpty() const
+{
+   return root_m.isEmpty();
+}
+
+
+template<class TYPE>
+inline
+void OctreeFrozen<TYPE>::getInfo
+(
+   dword& byteSize,
+   dword& leafCount,
+   dword& itemRefCount,
+   dword& maxDepth
+) const
+{
+   root_m.getInfo( sizeof(*this), byteSize, leafCount, itemRefCount, maxDepth );
+}
+
+
+template<class TYPE>
+inline
+const Vector3r& OctreeFrozen<TYPE>::getPosition() const
+{
+   return root_m.getPosition();
+}
+
+
+template<class TYPE>
+inline
+real OctreeFrozen<TYPE>::getSize() const
+{
+   return root_m.getSize();
+}
+
+
+template<class TYPE>
+inline
+dword OctreeFrozen<TYPE>::getMaxItemCountPerCell() const
+{
+   return root_m.getMaxItemCountPerCell();
+}
+
+
+template<class TYPE>
+inline
+dword OctreeFrozen<TYPE>::getMaxLevelCount() const
+{
+   return root_m.getMaxLevelCount();
+}
+
+
+template<class TYPE>
+inline
+real OctreeFrozen<TYPE>::getMinCellSize() const
+{
+   return root_m.getMinCellSize();
+}
+
+
+
+
+
+
+
+
+/**
+ * Octree with its agent and queries fixed at compile time.<br/><br/>
+ *
+ * The same as Octree (with an OctreeRoot), except agent calls for insert and
+ * remove, and query calls for query, are made directly (not virtually), so
+ * they can be inlined into the tree traversal.<br/><br/>
+ *
+ * That is no speed-up for insert and remove: octreebench (200000 small
+ * blocks, gcc -O3, one core) measured them about the same as Octree (insert
+ * 1.0-1.07 times as fast, remove 0.8-0.96 -- slower), since cells, not agent
+ * calls, are most of the work. Queries gained a little: counting items in
+ * boxes 1.3 times as fast, queryNearest 1.15. So use it for a fixed agent or
+ * query type, not for speed.<br/><br/>
+ *
+ * AGENT is any class having these member functions (as OctreeAgent, but
+ * public, and not necessarily virtual):
+ * <pre>
+ *    bool  isOverlappingCell ( const ItemType& item,
+ *                              const Vector3r& lowerCorner,
+ *                              const Vector3r& upperCorner ) const;
+ *    dword getSubcellOverlaps( const ItemType& item,
+ *                              const Vector3r& lower,
+ *                              const Vector3r& middle,
+ *                              const Vector3r& upper )       const;
+ *    real  getDistance       ( const ItemType& item,
+ *                              const Vector3r& point )       const;
+ *    real  getRayIntersection( const ItemType& item,
+ *                              const Vector3r& rayOrigin,
+ *                              const Vector3r& rayDirection ) const;
+ *    bool  isCoveringCell    ( const ItemType& item,
+ *                              const Vector3r& lowerCorner,
+ *                              const Vector3r& upperCorner ) const;
+ * </pre>
+ * (getDistance only if queryNearest is used, getRayIntersection only if
+ * queryRay is. isCoveringCell can simply return false.)
+ * A query is as for OctreeFrozen::query. The visit query, with an
+ * OctreeVisitor<ItemType>, is still virtual.<br/><br/>
+ *
+ * @see Octree
+ * @see OctreeFrozen
+ *
+ * @implementation
+ * Work is delegated to the ___Static templates of OctreeRoot. insertRange
+ * wraps the agent in a virtual forwarder, and uses OctreeRoot::insertRange.
+ */
+template<class TYPE, class AGENT, class ALLOCATOR = OctreeAllocatorPool>
+class OctreeStatic
+{
+/// standard object services ---------------------------------------------------
+public:
+   /**
+    * Constructs a particular format of octree (as Octree).
+    */
+            OctreeStatic( const Vector3r& positionOfLowerCorner,
+                          real            sizeOfCube,
+                          dword           maxItemCountPerCell,
+                          dword           maxLevelCount,
+                          real            minCellSize,
+                          dword           collapseItemCount = DWORD_MAX );
+
+           ~OctreeStatic();
+            OctreeStatic( const OctreeStatic& );
+   /**
+    * As Octree's.
+    */
+            OctreeStatic( const OctreeStatic& other,
+                          bool                isSharing );
+   /**
+    * @exceptions
+    * Can throw storage allocation exceptions. In such cases the octree is
+    * unmodified.
+    */
+   OctreeStatic& operator=( const OctreeStatic& );
+
+
+/// commands -------------------------------------------------------------------
+   /**
+    * As Octree::insert.
+    */
+           bool  insert( const TYPE&  item,
+                         const AGENT& agent );
+   /**
+    * As Octree::insertRange.
+    */
+           dword insertRange( const TYPE*  pItems,
+                              dword        itemCount,
+                              const AGENT& agent,
+                              dword        threadCount = 1 );
+   /**
+    * As Octree::remove.
+    */
+           bool  remove( const TYPE&  item,
+                         const AGENT& agent );
+   /**
+    * As Octree::collapse.
+    */
+           void  collapse();
+
+
+/// queries --------------------------------------------------------------------
+   /**
+    * Execute a visit query operation.
+    * @see OctreeVisitor
+    */
+           void  visit( OctreeVisitor<TYPE>& visitor )                    const;
+   /**
+    * As Octree::visitParallel.
+    */
+           void  visitParallel( OctreeVisitorParallel<TYPE>& visitor,
+                                dword                        threadCount )
+                                                                          const;
+   /**
+    * Execute a direct query operation.
+    */
+   template<class QUERY>
+           void  query( QUERY& query,
+                        dword  subCellOrder = 0 )                         const;
+   /**
+    * As Octree::queryBox.
+    */
+           void  queryBox( const Vector3r&     lowerCorner,
+                           const Vector3r&     upperCorner,
+                           const AGENT&        agent,
+                           Array<const TYPE*>& items )                    const;
+   /**
+    * As Octree::queryNearest.
+    */
+           void  queryNearest( const Vector3r&     point,
+                               dword               k,
+                               real                maxDistance,
+                               const AGENT&        agent,
+                               Array<const TYPE*>& items,
+                               Array<real>&        distances )            const;
+   /**
+    * As Octree::queryRay.
+    */
+           const TYPE* queryRay( const Vector3r& rayOrigin,
+                                 const Vector3r& rayDirection,
+                                 real            maxT,
+                                 const AGENT&    agent,
+                                 real&           hitT )                   const;
+   /**
+    * As Octree::queryRays.
+    */
+           void  queryRays( dword           rayCount,
+                            const Vector3r* pRayOrigins,
+                            const Vector3r* pRayDirections,
+                            real            maxT,
+                            const AGENT&    agent,
+                            const TYPE**    pHitItems,
+                            real*           pHitTs )                      const;
+   /**
+    * As Octree::queryBoxes.
+    */
+           void  queryBoxes( dword               boxCount,
+                             const Vector3r*     pLowerCorners,
+                             const Vector3r*     pUpperCorners,
+                             const AGENT&        agent,
+                             Array<const TYPE*>* pItems )                 const;
+   /**
+    * As Octree::freeze.
+    */
+           void  freeze( OctreeFrozen<TYPE>& frozen )                     const;
+
+   /**
+    * Reports if the octree is empty.
+    */
+           bool  isEmpty()                                                const;
+   /**
+    * Provides stats on the octree (as Octree::getInfo).
+    */
+           void  getInfo( dword& byteSize,
+                          dword& leafCount,
+                          dword& itemRefCount,
+                          dword& maxDepth )                               const;
+   /**
+    * Provides fuller stats on the octree (as Octree::getStats).
+    */
+           void  getStats( OctreeStats& stats )                           const;
+
+           const Vector3r& getPosition()                                  const;
+           real            getSize()                                      const;
+           dword           getMaxItemCountPerCell()                       const;
+           dword           getMaxLevelCount()                             const;
+           real            getMinCellSize()                               const;
+           dword           getCollapseItemCount()                         const;
+
+
+/// implementation -------------------------------------------------------------
+private:
+   /**
+    * Void-to-type forwarder for the agent (not virtual).
+    */
+   class AgentV
+   {
+   public:
+      explicit AgentV( const AGENT& agent )
+       : agent_m( agent )
+      {
+      }
+
+      bool  isOverlappingCellV( const void*     pItem,
+                                const Vector3r& lowerCorner,
+                                const Vector3r& upperCorner ) const
+      {
+         return agent_m.isOverlappingCell( *reinterpret_cast<const TYPE*>(
+            pItem ), lowerCorner, upperCorner );
+      }
+
+      dword getSubcellOverlapsV( const void*     pItem,
+                                 const Vector3r& lower,
+                                 const Vector3r& middle,
+                                 const Vector3r& upper ) const
+      {
+         return agent_m.getSubcellOverlaps( *reinterpret_cast<const TYPE*>(
+            pItem ), lower, middle, upper );
+      }
+
+      real  getDistanceV( const void*     pItem,
+                          const Vector3r& point ) const
+      {
+         return agent_m.getDistance( *reinterpret_cast<const TYPE*>( pItem ),
+            point );
+      }
+
+      real  getRayIntersectionV( const void*     pItem,
+                                 const Vector3r& rayOrigin,
+                                 const Vector3r& rayDirection ) const
+      {
+         return agent_m.getRayIntersection( *reinterpret_cast<const TYPE*>(
+            pItem ), rayOrigin, rayDirection );
+      }
+
+      bool  isCoveringCellV( const void*     pItem,
+                             const Vector3r& lowerCorner,
+                             const Vector3r& upperCorner ) const
+      {
+         return agent_m.isCoveringCell( *reinterpret_cast<const TYPE*>(
+            pItem ), lowerCorner, upperCorner );
+      }
+
+   private:
+      const AGENT& agent_m;
+   };
+
+   /**
+    * Void-to-type forwarder for the agent (virtual, for insertRange).
+    */
+   class AgentVirtualV
+      : public OctreeAgentV
+   {
+   public:
+      explicit AgentVirtualV( const AGENT& agent )
+       : agentV_m( agent )
+      {
+      }
+
+      virtual bool  isOverlappingCellV( const void*     pItem,
+                                        const Vector3r& lowerCorner,
+                                        const Vector3r& upperCorner ) const
+      {
+         return agentV_m.isOverlappingCellV( pItem, lowerCorner, upperCorner );
+      }
+
+      virtual dword getSubcellOverlapsV( const void*     pItem,
+                                         const Vector3r& lower,
+                                         const Vector3r& middle,
+                                         const Vector3r& upper ) const
+      {
+         return agentV_m.getSubcellOverlapsV( pItem, lower, middle, upper );
+      }
+
+      virtual bool  isCoveringCellV( const void*     pItem,
+                                     const Vector3r& lowerCorner,
+                                     const Vector3r& upperCorner ) const
+      {
+         return agentV_m.isCoveringCellV( pItem, lowerCorner, upperCorner );
+      }
+
+   private:
+      const AgentV agentV_m;
+   };
+
+
+/// fields ---------------------------------------------------------------------
+   OctreeAllocatorShared<ALLOCATOR> allocator_m;
+   OctreeRoot                       root_m;
+};
+
+
+
+
+/// templates ///
+
+/// standard object services ---------------------------------------------------
+template<class TYPE, class AGENT, class ALLOCATOR>
+inline
+OctreeStatic<TYPE,AGENT,ALLOCATOR>::OctreeStatic
+(
+   const Vector3r& position,
+   const real      sizeOfCube,
+   const dword     maxItemCountPerCell,
+   const dword     maxLevelCount,
+   const real      minCellSize,
+   const dword     collapseItemCount
+)
+ : allocator_m()
+ , root_m     ( position, sizeOfCube, maxItemCountPerCell, maxLevelCount,
+      minCellSize, collapseItemCount, allocator_m.get() )
+{
+}
+
+
+template<class TYPE, class AGENT, class ALLOCATOR>
+inline
+OctreeStatic<TYPE,AGENT,ALLOCATOR>::~OctreeStatic()
+{
+}
+
+
+template<class TYPE, class AGENT, class ALLOCATOR>
+inline
+OctreeStatic<TYPE,AGENT,ALLOCATOR>::OctreeStatic
+(
+   const OctreeStatic& other
+)
+ : allocator_m( other.allocator_m )
+ , root_m     ( other.root_m, allocator_m.get() )
+{
+}
+
+
+template<class TYPE, class AGENT, class ALLOCATOR>
+inline
+OctreeStatic<TYPE,AGENT,ALLOCATOR>::OctreeStatic
+(
+   const OctreeStatic& other,
+   const bool          isSharing
+)
+ : allocator_m( isSharing ? other.allocator_m :
+      OctreeAllocatorShared<ALLOCATOR>() )
+ , root_m     ( other.root_m, allocator_m.get() )
+{
+}
+
+
+template<class TYPE, class AGENT, class ALLOCATOR>
+inline
+OctreeStatic<TYPE,AGENT,ALLOCATOR>&
+OctreeStatic<TYPE,AGENT,ALLOCATOR>::operator=
+(
+   const OctreeStatic& other
+)
+{
+   root_m = other.root_m;
+
+   return *this;
+}
+
+
+
+
+/// commands -------------------------------------------------------------------
+template<class TYPE, class AGENT, class ALLOCATOR>
+inline
+bool OctreeStatic<TYPE,AGENT,ALLOCATOR>::insert
+(
+   const TYPE&  item,
+   const AGENT& agent
+)
+{
+   return root_m.insertStatic( &item, AgentV( agent ) );
+}
+
+
+template<class TYPE, class AGENT, class ALLOCATOR>
+dword OctreeStatic<TYPE,AGENT,ALLOCATOR>::insertRange
+(
+   const TYPE* const pItems,
+   const dword       itemCount,
+   const AGENT&      agent,
+   const dword       threadCount
+)
+{
+   // make item pointers
+   Array<const void*> items( itemCount );
+   for( dword i = 0;  i < itemCount;  ++i )
+   {
+      items[i] = pItems + i;
+   }
+
+   const AgentVirtualV agentV( agent );
+   return root_m.insertRange( items.getStorage(), items.getLength(), agentV,
+      threadCount );
+}
+
+
+template<class TYPE, class AGENT, class ALLOCATOR>
+inline
+bool OctreeStatic<TYPE,AGENT,ALLOCATOR>::remove
+(
+   const TYPE&  item,
+   const AGENT& agent
+)
+{
+   return root_m.removeStatic( &item, AgentV( agent ) );
+}
+
+
+template<class TYPE, class AGENT, class ALLOCATOR>
+inline
+void OctreeStatic<TYPE,AGENT,ALLOCATOR>::collapse()
+{
+   root_m.collapse();
+}
+
+
+
+
+/// queries --------------------------------------------------------------------
+template<class TYPE, class AGENT, class ALLOCATOR>
+inline
+void OctreeStatic<TYPE,AGENT,ALLOCATOR>::visit
+(
+   OctreeVisitor<TYPE>& visitor
+) const
+{
+   root_m.visit( visitor );
+}
+
+
+template<class TYPE, class AGENT, class ALLOCATOR>
+void OctreeStatic<TYPE,AGENT,ALLOCATOR>::visitParallel
+(
+   OctreeVisitorParallel<TYPE>& visitor,
+   const dword                  threadCount
+) const
+{
+   OctreeVisitParallelV<TYPE,OctreeRoot>::visitAll( root_m, visitor,
+      threadCount );
+}
+
+
+template<class TYPE, class AGENT, class ALLOCATOR>
+template<class QUERY>
+inline
+void OctreeStatic<TYPE,AGENT,ALLOCATOR>::query
+(
+   QUERY&      query,
+   const dword subCellOrder
+) const
+{
+   typename OctreeFrozen<TYPE>::template QueryV<QUERY> queryV( query );
+   root_m.query( queryV, subCellOrder );
+}
+
+
+template<class TYPE, class AGENT, class ALLOCATOR>
+void OctreeStatic<TYPE,AGENT,ALLOCATOR>::queryBox
+(
+   const Vector3r&     lowerCorner,
+   const Vector3r&     upperCorner,
+   const AGENT&        agent,
+   Array<const TYPE*>& items
+) const
+{
+   items.setLength( 0 );
+
+   const AgentV agentV( agent );
+   OctreeQueryBoxV<TYPE,AgentV> query( lowerCorner, upperCorner, agentV,
+      items );
+   root_m.query( query );
+   query.finish();
+}
+
+
+template<class TYPE, class AGENT, class ALLOCATOR>
+void OctreeStatic<TYPE,AGENT,ALLOCATOR>::queryNearest
+(
+   const Vector3r&     point,
+   const dword         k,
+   const real          maxDistance,
+   const AGENT&        agent,
+   Array<const TYPE*>& items,
+   Array<real>&        distances
+) const
+{
+   items.setLength( 0 );
+   distances.setLength( 0 );
+
+   if( k > 0 )
+   {
+      const AgentV agentV( agent );
+      OctreeQueryNearestV<TYPE,AgentV> query( point, k, maxDistance, agentV );
+      root_m.queryNearest( query );
+      query.finish( items, distances );
+   }
+}
+
+
+template<class TYPE, class AGENT, class ALLOCATOR>
+const TYPE* OctreeStatic<TYPE,AGENT,ALLOCATOR>::queryRay
+(
+   const Vector3r& rayOrigin,
+   const Vector3r& rayDirection,
+   const real      maxT,
+   const AGENT&    agent,
+   real&           hitT
+) const
+{
+   const AgentV agentV( agent );
+   OctreeQueryRayV<TYPE,AgentV> query( rayOrigin, rayDirection, maxT, agentV );
+   root_m.query( query, query.getSubcellOrder() );
+
+   hitT = query.getHitT();
+   return query.getHitItem();
+}
+
+
+template<class TYPE, class AGENT, class ALLOCATOR>
+void OctreeStatic<TYPE,AGENT,ALLOCATOR>::queryRays
+(
+   const dword               rayCount,
+   const Vector3r* const     pRayOrigins,
+   const Vector3r* const     pRayDirections,
+   const real                maxT,
+   const AGENT&              agent,
+   const TYPE** const        pHitItems,
+   real* const               pHitTs
+) const
+{
+   const AgentV agentV( agent );
+   OctreeQueryRayPacketV<TYPE,AgentV>::queryAll( root_m,
+      rayCount, pRayOrigins, pRayDirections, maxT, agentV, pHitItems, pHitTs );
+}
+
+
+template<class TYPE, class AGENT, class ALLOCATOR>
+void OctreeStatic<TYPE,AGENT,ALLOCATOR>::queryBoxes
+(
+   const dword               boxCount,
+   const Vector3r* const     pLowerCorners,
+   const Vector3r* const     pUpperCorners,
+   const AGENT&              agent,
+   Array<const TYPE*>* const pItems
+) const
+{
+   const AgentV agentV( agent );
+   OctreeQueryBoxPacketV<TYPE,AgentV>::queryAll( root_m,
+      boxCount, pLowerCorners, pUpperCorners, agentV, pItems );
+}
+
+
+template<class TYPE, class AGENT, class ALLOCATOR>
+inline
+void OctreeStatic<TYPE,AGENT,ALLOCATOR>::freeze
+(
+   OctreeFrozen<TYPE>& frozen
+) const
+{
+   frozen.root_m.freeze( root_m );
+}
+
+
+template<class TYPE, class AGENT, class ALLOCATOR>
+inline
+bool OctreeStatic<TYPE,AGENT,ALLOCATOR>::isEmpty() const
+{
+   return root_m.isEmpty();
+}
+
+
+template<class TYPE, class AGENT, class ALLOCATOR>
+inline
+void OctreeStatic<TYPE,AGENT,ALLOCATOR>::getInfo
+(
+   dword& byteSize,
+   dword& leafCount,
+   dword& itemRefCount,
+   dword& maxDepth
+) const
+{
+   root_m.getInfo( sizeof(*this), byteSize, leafCount, itemRefCount, maxDepth );
+}
+
+
+template<class TYPE, class AGENT, class ALLOCATOR>
+inline
+void OctreeStatic<TYPE,AGENT,ALLOCATOR>::getStats
+(
+   OctreeStats& stats
+) const
+{
+   root_m.getStats( stats );
+}
+
+
+template<class TYPE, class AGENT, class ALLOCATOR>
+inline
+const Vector3r& OctreeStatic<TYPE,AGENT,ALLOCATOR>::getPosition() const
+{
+   return root_m.getPosition();
+}
+
+
+template<class TYPE, class AGENT, class ALLOCATOR>
+inline
+real OctreeStatic<TYPE,AGENT,ALLOCATOR>::getSize() const
+{
+   return root_m.getSize();
+}
+
+
+template<class TYPE, class AGENT, class ALLOCATOR>
+inline
+dword OctreeStatic<TYPE,AGENT,ALLOCATOR>::getMaxItemCountPerCell() const
+{
+   return root_m.getMaxItemCountPerCell();
+}
+
+
+template<class TYPE, class AGENT, class ALLOCATOR>
+inline
+dword OctreeStatic<TYPE,AGENT,ALLOCATOR>::getMaxLevelCount() const
+{
+   return root_m.getMaxLevelCount();
+}
+
+
+template<class TYPE, class AGENT, class ALLOCATOR>
+inline
+real OctreeStatic<TYPE,AGENT,ALLOCATOR>::getMinCellSize() const
+{
+   return root_m.getMinCellSize();
+}
+
+
+template<class TYPE, class AGENT, class ALLOCATOR>
+inline
+dword OctreeStatic<TYPE,AGENT,ALLOCATOR>::getCollapseItemCount() const
+{
+   return root_m.getCollapseItemCount();
+}
+
+
+
+
+
+
+
+
+
+/**
+ * Octree for querying on any threads while one thread changes it.<br/><br/>
+ *
+ * The writer thread inserts and removes (as Octree), then publishes the
+ * changes. Readers see only published versions, each whole and unchanging: an
+ * OctreeReader holds the version current when it was made, for its lifetime.
+ * <br/><br/>
+ *
+ * publish is O(1), sharing the writer's cells. Changes after it copy the
+ * cells they change (and the paths to them), so a publish after few changes
+ * still shares most cells. An older version is freed, by a later publish,
+ * once none of its readers remain.<br/><br/>
+ *
+ * All members are for the writer's thread, and do not lock. OctreeReader is
+ * for any thread, and never locks (it counts itself in its version
+ * atomically), so never waits for publish. All readers must be destroyed
+ * before the octree.
+ *
+ * @see Octree
+ * @see OctreeReader
+ *
+ * @implementation
+ * Work is delegated to OctreeRoot, for the writer's tree, and
+ * OctreeRootVersions, for the published sharing copies of it.
+ */
+template<class TYPE, class ALLOCATOR = OctreeAllocatorPool>
+class OctreeConcurrent
+{
+/// standard object services ---------------------------------------------------
+public:
+   /**
+    * Constructs a particular format of octree (as Octree), with an empty
+    * version published.
+    */
+            OctreeConcurrent( const Vector3r& positionOfLowerCorner,
+                              real            sizeOfCube,
+                              dword           maxItemCountPerCell,
+                              dword           maxLevelCount,
+                              real            minCellSize,            // throws
+                              dword           collapseItemCount = DWORD_MAX );
+
+           ~OctreeConcurrent();
+private:
+            OctreeConcurrent( const OctreeConcurrent& );
+   OctreeConcurrent& operator=( const OctreeConcurrent& );
+public:
+
+
+/// commands -------------------------------------------------------------------
+   /**
+    * As Octree::insert (seen by readers after publish).
+    */
+           bool  insert( const TYPE&              item,
+                         const OctreeAgent<TYPE>& agent );
+   /**
+    * As Octree::insertRange (seen by readers after publish).
+    */
+           dword insertRange( const TYPE*              pItems,
+                              dword                    itemCount,
+                              const OctreeAgent<TYPE>& agent,
+                              dword                    threadCount = 1 );
+   /**
+    * As Octree::remove (seen by readers after publish).
+    */
+           bool  remove( const TYPE&              item,
+                         const OctreeAgent<TYPE>& agent );
+   /**
+    * As Octree::collapse (seen by readers after publish).
+    */
+           void  collapse();
+
+   /**
+    * Makes the changes so far the current version, for readers made after
+    * this. And frees older versions no reader holds.
+    * @exceptions
+    * Can throw storage allocation exceptions. In such cases the current
+    * version is unchanged.
+    */
+           void  publish();
+
+
+/// queries --------------------------------------------------------------------
+   /**
+    * Gives how many versions are held: the current one, and older ones with
+    * readers (as of the last publish).
+    */
+           dword getVersionCount()                                        const;
+
+
+/// implementation -------------------------------------------------------------
+private:
+   template<class> friend class OctreeReader;
+
+
+/// fields ---------------------------------------------------------------------
+   ALLOCATOR          allocator_m;
+   OctreeRoot         root_m;
+   OctreeRootVersions versions_m;
+};
+
+
+
+
+/// templates ///
+
+/// standard object services ---------------------------------------------------
+template<class TYPE, class ALLOCATOR>
+inline
+OctreeConcurrent<TYPE,ALLOCATOR>::OctreeConcurrent
+(
+   const Vector3r& position,
+   const real      sizeOfCube,
+   const dword     maxItemCountPerCell,
+   const dword     maxLevelCount,
+   const real      minCellSize,
+   const dword     collapseItemCount
+)
+ : allocator_m()
+ , root_m     ( position, sizeOfCube, maxItemCountPerCell, maxLevelCount,
+      minCellSize, collapseItemCount, allocator_m )
+ , versions_m ( root_m )
+{
+}
+
+
+template<class TYPE, class ALLOCATOR>
+inline
+OctreeConcurrent<TYPE,ALLOCATOR>::~OctreeConcurrent()
+{
+   // (versions are destroyed before the writer's tree, so it can free all at
+   // once)
+}
+
+
+
+
+/// commands -------------------------------------------------------------------
+template<class TYPE, class ALLOCATOR>
+inline
+bool OctreeConcurrent<TYPE,ALLOCATOR>::insert
+(
+   const TYPE&              item,
    const OctreeAgent<TYPE>& agent
 )
 {
@@ -585,9 +4104,30 @@ bool Octree<TYPE>::insert
 }
 
 
-template<class TYPE>
+template<class TYPE, class ALLOCATOR>
+dword OctreeConcurrent<TYPE,ALLOCATOR>::insertRange
+(
+   const TYPE* const        pItems,
+   const dword              itemCount,
+   const OctreeAgent<TYPE>& agent,
+   const dword              threadCount
+)
+{
+   // make item pointers
+   Array<const void*> items( itemCount );
+   for( dword i = 0;  i < itemCount;  ++i )
+   {
+      items[i] = pItems + i;
+   }
+
+   return root_m.insertRange( items.getStorage(), items.getLength(), agent,
+      threadCount );
+}
+
+
+template<class TYPE, class ALLOCATOR>
 inline
-bool Octree<TYPE>::remove
+bool OctreeConcurrent<TYPE,ALLOCATOR>::remove
 (
    const TYPE&              item,
    const OctreeAgent<TYPE>& agent
@@ -597,31 +4137,330 @@ bool Octree<TYPE>::remove
 }
 
 
+template<class TYPE, class ALLOCATOR>
+inline
+void OctreeConcurrent<TYPE,ALLOCATOR>::collapse()
+{
+   root_m.collapse();
+}
+
+
+template<class TYPE, class ALLOCATOR>
+inline
+void OctreeConcurrent<TYPE,ALLOCATOR>::publish()
+{
+   versions_m.publish();
+}
+
+
+
+
+/// queries --------------------------------------------------------------------
+template<class TYPE, class ALLOCATOR>
+inline
+dword OctreeConcurrent<TYPE,ALLOCATOR>::getVersionCount() const
+{
+   return versions_m.getVersionCount();
+}
+
+
+
+
+
+
+
+
+/**
+ * Reader of an OctreeConcurrent, for any thread.<br/><br/>
+ *
+ * Holds the octree's current version for its lifetime, and queries it (as
+ * Octree) without locking. Changes published meanwhile are not seen: make
+ * another reader for them. Readers should be short-lived, as the cells of old
+ * versions are kept for them.
+ *
+ * @see OctreeConcurrent
+ *
+ * @implementation
+ * Work is delegated to the version's OctreeRoot.
+ */
+template<class TYPE>
+class OctreeReader
+{
+/// standard object services ---------------------------------------------------
+public:
+   template<class ALLOCATOR>
+   explicit OctreeReader( OctreeConcurrent<TYPE,ALLOCATOR>& octree );
+
+           ~OctreeReader();
+private:
+            OctreeReader( const OctreeReader& );
+   OctreeReader& operator=( const OctreeReader& );
+public:
+
+
+/// queries --------------------------------------------------------------------
+   /**
+    * Execute a visit query operation.
+    * @see OctreeVisitor
+    */
+           void  visit( OctreeVisitor<TYPE>& visitor )                    const;
+   /**
+    * As Octree::visitParallel.
+    */
+           void  visitParallel( OctreeVisitorParallel<TYPE>& visitor,
+                                dword                        threadCount )
+                                                                          const;
+   /**
+    * Execute a direct query operation (as OctreeFrozen::query).
+    */
+   template<class QUERY>
+           void  query( QUERY& query,
+                        dword  subCellOrder = 0 )                         const;
+   /**
+    * As Octree::queryBox.
+    */
+           void  queryBox( const Vector3r&          lowerCorner,
+                           const Vector3r&          upperCorner,
+                           const OctreeAgent<TYPE>& agent,
+                           Array<const TYPE*>&      items )               const;
+   /**
+    * As Octree::queryNearest.
+    */
+           void  queryNearest( const Vector3r&          point,
+                               dword                    k,
+                               real                     maxDistance,
+                               const OctreeAgent<TYPE>& agent,
+                               Array<const TYPE*>&      items,
+                               Array<real>&             distances )       const;
+   /**
+    * As Octree::queryRay.
+    */
+           const TYPE* queryRay( const Vector3r&          rayOrigin,
+                                 const Vector3r&          rayDirection,
+                                 real                     maxT,
+                                 const OctreeAgent<TYPE>& agent,
+                                 real&                    hitT )          const;
+   /**
+    * As Octree::queryRays.
+    */
+           void  queryRays( dword                    rayCount,
+                            const Vector3r*          pRayOrigins,
+                            const Vector3r*          pRayDirections,
+                            real                     maxT,
+                            const OctreeAgent<TYPE>& agent,
+                            const TYPE**             pHitItems,
+                            real*                    pHitTs )             const;
+   /**
+    * As Octree::queryBoxes.
+    */
+           void  queryBoxes( dword                    boxCount,
+                             const Vector3r*          pLowerCorners,
+                             const Vector3r*          pUpperCorners,
+                             const OctreeAgent<TYPE>& agent,
+                             Array<const TYPE*>*      pItems )            const;
+
+   /**
+    * Reports if the version is empty.
+    */
+           bool  isEmpty()                                                const;
+   /**
+    * Provides stats on the version (as Octree::getInfo).
+    */
+           void  getInfo( dword& byteSize,
+                          dword& leafCount,
+                          dword& itemRefCount,
+                          dword& maxDepth )                               const;
+   /**
+    * Provides fuller stats on the version (as Octree::getStats).
+    */
+           void  getStats( OctreeStats& stats )                           const;
+
+           const Vector3r& getPosition()                                  const;
+           real            getSize()                                      const;
+           dword           getMaxItemCountPerCell()                       const;
+           dword           getMaxLevelCount()                             const;
+           real            getMinCellSize()                               const;
+
+
+/// fields ---------------------------------------------------------------------
+private:
+   OctreeRootVersions*          pVersions_m;
+   OctreeRootVersions::Version* pVersion_m;
+   const OctreeRoot*            pRoot_m;
+};
+
+
+
+
+/// templates ///
+
+/// standard object services ---------------------------------------------------
+template<class TYPE>
+template<class ALLOCATOR>
+inline
+OctreeReader<TYPE>::OctreeReader
+(
+   OctreeConcurrent<TYPE,ALLOCATOR>& octree
+)
+ : pVersions_m( &octree.versions_m )
+ , pVersion_m ( octree.versions_m.acquire() )
+ , pRoot_m    ( pVersion_m->pRoot )
+{
+}
+
+
+template<class TYPE>
+inline
+OctreeReader<TYPE>::~OctreeReader()
+{
+   pVersions_m->release( pVersion_m );
+}
+
+
 
 
 /// queries --------------------------------------------------------------------
 template<class TYPE>
 inline
-void Octree<TYPE>::visit
+void OctreeReader<TYPE>::visit
 (
    OctreeVisitor<TYPE>& visitor
 ) const
 {
-   root_m.visit( visitor );
+   pRoot_m->visit( visitor );
+}
+
+
+template<class TYPE>
+void OctreeReader<TYPE>::visitParallel
+(
+   OctreeVisitorParallel<TYPE>& visitor,
+   const dword                  threadCount
+) const
+{
+   OctreeVisitParallelV<TYPE,OctreeRoot>::visitAll( *pRoot_m, visitor,
+      threadCount );
 }
 
 
 template<class TYPE>
+template<class QUERY>
 inline
-bool Octree<TYPE>::isEmpty() const
+void OctreeReader<TYPE>::query
+(
+   QUERY&      query,
+   const dword subCellOrder
+) const
 {
-   return root_m.isEmpty();
+   typename OctreeFrozen<TYPE>::template QueryV<QUERY> queryV( query );
+   pRoot_m->query( queryV, subCellOrder );
+}
+
+
+template<class TYPE>
+void OctreeReader<TYPE>::queryBox
+(
+   const Vector3r&          lowerCorner,
+   const Vector3r&          upperCorner,
+   const OctreeAgent<TYPE>& agent,
+   Array<const TYPE*>&      items
+) const
+{
+   items.setLength( 0 );
+
+   OctreeQueryBoxV<TYPE,OctreeAgentV> query( lowerCorner, upperCorner, agent,
+      items );
+   pRoot_m->query( query );
+   query.finish();
+}
+
+
+template<class TYPE>
+void OctreeReader<TYPE>::queryNearest
+(
+   const Vector3r&          point,
+   const dword              k,
+   const real               maxDistance,
+   const OctreeAgent<TYPE>& agent,
+   Array<const TYPE*>&      items,
+   Array<real>&             distances
+) const
+{
+   items.setLength( 0 );
+   distances.setLength( 0 );
+
+   if( k > 0 )
+   {
+      OctreeQueryNearestV<TYPE,OctreeAgentV> query( point, k, maxDistance,
+         agent );
+      pRoot_m->queryNearest( query );
+      query.finish( items, distances );
+   }
+}
+
+
+template<class TYPE>
+const TYPE* OctreeReader<TYPE>::queryRay
+(
+   const Vector3r&          rayOrigin,
+   const Vector3r&          rayDirection,
+   const real               maxT,
+   const OctreeAgent<TYPE>& agent,
+   real&                    hitT
+) const
+{
+   OctreeQueryRayV<TYPE,OctreeAgentV> query( rayOrigin, rayDirection, maxT,
+      agent );
+   pRoot_m->query( query, query.getSubcellOrder() );
+
+   hitT = query.getHitT();
+   return query.getHitItem();
+}
+
+
+template<class TYPE>
+void OctreeReader<TYPE>::queryRays
+(
+   const dword               rayCount,
+   const Vector3r* const     pRayOrigins,
+   const Vector3r* const     pRayDirections,
+   const real                maxT,
+   const OctreeAgent<TYPE>&  agent,
+   const TYPE** const        pHitItems,
+   real* const               pHitTs
+) const
+{
+   OctreeQueryRayPacketV<TYPE,OctreeAgentV>::queryAll( *pRoot_m,
+      rayCount, pRayOrigins, pRayDirections, maxT, agent, pHitItems, pHitTs );
+}
+
+
+template<class TYPE>
+void OctreeReader<TYPE>::queryBoxes
+(
+   const dword               boxCount,
+   const Vector3r* const     pLowerCorners,
+   const Vector3r* const     pUpperCorners,
+   const OctreeAgent<TYPE>&  agent,
+   Array<const TYPE*>* const pItems
+) const
+{
+   OctreeQueryBoxPacketV<TYPE,OctreeAgentV>::queryAll( *pRoot_m,
+      boxCount, pLowerCorners, pUpperCorners, agent, pItems );
+}
+
+
+template<class TYPE>
+inline
+bool OctreeReader<TYPE>::isEmpty() const
+{
+   return pRoot_m->isEmpty();
 }
 
 
 template<class TYPE>
 inline
-void Octree<TYPE>::getInfo
+void OctreeReader<TYPE>::getInfo
 (
    dword& byteSize,
    dword& leafCount,
@@ -629,47 +4468,59 @@ void Octree<TYPE>::getInfo
    dword& maxDepth
 ) const
 {
-   root_m.getInfo( sizeof(*this), byteSize, leafCount, itemRefCount, maxDepth );
+   pRoot_m->getInfo( sizeof(*this), byteSize, leafCount, itemRefCount,
+      maxDepth );
 }
 
 
 template<class TYPE>
 inline
-const Vector3r& Octree<TYPE>::getPosition() const
+void OctreeReader<TYPE>::getStats
+(
+   OctreeStats& stats
+) const
 {
-   return root_m.getPosition();
+   pRoot_m->getStats( stats );
 }
 
 
 template<class TYPE>
 inline
-real Octree<TYPE>::getSize() const
+const Vector3r& OctreeReader<TYPE>::getPosition() const
 {
-   return root_m.getSize();
+   return pRoot_m->getPosition();
 }
 
 
 template<class TYPE>
 inline
-dword Octree<TYPE>::getMaxItemCountPerCell() const
+real OctreeReader<TYPE>::getSize() const
 {
-   return root_m.getMaxItemCountPerCell();
+   return pRoot_m->getSize();
 }
 
 
 template<class TYPE>
 inline
-dword Octree<TYPE>::getMaxLevelCount() const
+dword OctreeReader<TYPE>::getMaxItemCountPerCell() const
 {
-   return root_m.getMaxLevelCount();
+   return pRoot_m->getMaxItemCountPerCell();
 }
 
 
 template<class TYPE>
 inline
-real Octree<TYPE>::getMinCellSize() const
+dword OctreeReader<TYPE>::getMaxLevelCount() const
 {
-   return root_m.getMinCellSize();
+   return pRoot_m->getMaxLevelCount();
+}
+
+
+template<class TYPE>
+inline
+real OctreeReader<TYPE>::getMinCellSize() const
+{
+   return pRoot_m->getMinCellSize();
 }
 
 
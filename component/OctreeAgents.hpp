@@ -0,0 +1,784 @@
+/*------------------------------------------------------------------------------
+
+   Octree Component, version 2.1
+   Copyright (c) 2004-2007,  Harrison Ainsworth / HXA7241.
+
+   http://www.hxa7241.org/
+
+------------------------------------------------------------------------------*/
+
+/*------------------------------------------------------------------------------
+
+Copyright (c) 2004-2007, Harrison Ainsworth / HXA7241.
+
+Redistribution and use in source and binary forms, with or without modification,
+are permitted provided that the following conditions are met:
+
+* Redistributions of source code must retain the above copyright notice, this
+  list of conditions and the following disclaimer.
+* Redistributions in binary form must reproduce the above copyright notice, this
+  list of conditions and the following disclaimer in the documentation and/or
+  other materials provided with the distribution.
+* The name of the author may not be used to endorse or promote products derived
+  from this software without specific prior written permission.
+
+THIS SOFTWARE IS PROVIDED BY THE AUTHOR "AS IS" AND ANY EXPRESS OR IMPLIED
+WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT
+SHALL THE AUTHOR BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT
+OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING
+IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY
+OF SUCH DAMAGE.
+
+------------------------------------------------------------------------------*/
+
+
+#ifndef OctreeAgents_h
+#define OctreeAgents_h
+
+
+#include "Octree.hpp"
+
+
+
+
+namespace hxa7241_graphics
+{
+
+
+/**
+ * Agent for OctreeStatic, with items that are points (by getPosition()).
+ *
+ * @see OctreeAgentAdapter
+ */
+template<class TYPE>
+class OctreeAgentStaticPoint
+{
+/// queries --------------------------------------------------------------------
+public:
+           bool  isOverlappingCell ( const TYPE&     item,
+                                     const Vector3r& lowerCorner,
+                                     const Vector3r& upperCorner )        const;
+           bool  isCoveringCell    ( const TYPE&     item,
+                                     const Vector3r& lowerCorner,
+                                     const Vector3r& upperCorner )        const;
+           dword getSubcellOverlaps( const TYPE&     item,
+                                     const Vector3r& lower,
+                                     const Vector3r& middle,
+                                     const Vector3r& upper )              const;
+           real  getDistance       ( const TYPE&     item,
+                                     const Vector3r& point )              const;
+           real  getRayIntersection( const TYPE&     item,
+                                     const Vector3r& rayOrigin,
+                                     const Vector3r& rayDirection )       const;
+           void  getBound          ( const TYPE&     item,
+                                     Vector3r&       lowerCorner,
+                                     Vector3r&       upperCorner )        const;
+};
+
+
+
+
+/**
+ * Agent for OctreeStatic, with items that are axis-aligned boxes (by
+ * getLowerCorner() and getUpperCorner()).
+ *
+ * @see OctreeAgentAdapter
+ */
+template<class TYPE>
+class OctreeAgentStaticBox
+{
+/// queries --------------------------------------------------------------------
+public:
+           bool  isOverlappingCell ( const TYPE&     item,
+                                     const Vector3r& lowerCorner,
+                                     const Vector3r& upperCorner )        const;
+           bool  isCoveringCell    ( const TYPE&     item,
+                                     const Vector3r& lowerCorner,
+                                     const Vector3r& upperCorner )        const;
+           dword getSubcellOverlaps( const TYPE&     item,
+                                     const Vector3r& lower,
+                                     const Vector3r& middle,
+                                     const Vector3r& upper )              const;
+           real  getDistance       ( const TYPE&     item,
+                                     const Vector3r& point )              const;
+           real  getRayIntersection( const TYPE&     item,
+                                     const Vector3r& rayOrigin,
+                                     const Vector3r& rayDirection )       const;
+           void  getBound          ( const TYPE&     item,
+                                     Vector3r&       lowerCorner,
+                                     Vector3r&       upperCorner )        const;
+};
+
+
+
+
+/**
+ * Agent for OctreeStatic, with items that are spheres (by getCenter() and
+ * getRadius()).
+ *
+ * @see OctreeAgentAdapter
+ */
+template<class TYPE>
+class OctreeAgentStaticSphere
+{
+/// queries --------------------------------------------------------------------
+public:
+           bool  isOverlappingCell ( const TYPE&     item,
+                                     const Vector3r& lowerCorner,
+                                     const Vector3r& upperCorner )        const;
+           bool  isCoveringCell    ( const TYPE&     item,
+                                     const Vector3r& lowerCorner,
+                                     const Vector3r& upperCorner )        const;
+           dword getSubcellOverlaps( const TYPE&     item,
+                                     const Vector3r& lower,
+                                     const Vector3r& middle,
+                                     const Vector3r& upper )              const;
+           real  getDistance       ( const TYPE&     item,
+                                     const Vector3r& point )              const;
+           real  getRayIntersection( const TYPE&     item,
+                                     const Vector3r& rayOrigin,
+                                     const Vector3r& rayDirection )       const;
+           void  getBound          ( const TYPE&     item,
+                                     Vector3r&       lowerCorner,
+                                     Vector3r&       upperCorner )        const;
+};
+
+
+
+
+/**
+ * Agent for OctreeStatic, with items that are triangles (by getVertex( 0 ),
+ * getVertex( 1 ), and getVertex( 2 )).
+ *
+ * @see OctreeAgentAdapter
+ */
+template<class TYPE>
+class OctreeAgentStaticTriangle
+{
+/// queries --------------------------------------------------------------------
+public:
+           bool  isOverlappingCell ( const TYPE&     item,
+                                     const Vector3r& lowerCorner,
+                                     const Vector3r& upperCorner )        const;
+           bool  isCoveringCell    ( const TYPE&     item,
+                                     const Vector3r& lowerCorner,
+                                     const Vector3r& upperCorner )        const;
+           dword getSubcellOverlaps( const TYPE&     item,
+                                     const Vector3r& lower,
+                                     const Vector3r& middle,
+                                     const Vector3r& upper )              const;
+           real  getDistance       ( const TYPE&     item,
+                                     const Vector3r& point )              const;
+           real  getRayIntersection( const TYPE&     item,
+                                     const Vector3r& rayOrigin,
+                                     const Vector3r& rayDirection )       const;
+           void  getBound          ( const TYPE&     item,
+                                     Vector3r&       lowerCorner,
+                                     Vector3r&       upperCorner )        const;
+};
+
+
+
+
+/**
+ * Agent for Octree, forwarding to an agent for OctreeStatic.<br/><br/>
+ *
+ * AGENT is an agent class with plain (non-virtual) members, as OctreeStatic
+ * takes.<br/><br/>
+ *
+ * The stock agents are for items that are points, boxes, spheres, or
+ * triangles.<br/><br/>
+ *
+ * Each shape has an agent for OctreeStatic (OctreeAgentStatic___), and one
+ * for Octree (OctreeAgent___, made by OctreeAgentAdapter). They work out all
+ * 8 subcell overlaps at once, and support queryNearest and queryRay (except a
+ * point, which no ray hits), all with OctreeShape, and OctreeLooseRoot (by
+ * getBound). Boxes and spheres say when they cover a cell (isCoveringCell),
+ * so are held once at a branch they cover.<br/><br/>
+ *
+ * The item type has to provide the shape, by const members:
+ * <ul>
+ * <li>point: getPosition()</li>
+ * <li>box: getLowerCorner() and getUpperCorner()</li>
+ * <li>sphere: getCenter() and getRadius()</li>
+ * <li>triangle: getVertex( dword index ), for index 0, 1, 2</li>
+ * </ul>
+ * (each returning a Vector3r, or a real for the radius).
+ *
+ * @see OctreeShape
+ */
+template<class TYPE, class AGENT>
+class OctreeAgentAdapter
+   : public OctreeAgent<TYPE>
+{
+/// standard object services ---------------------------------------------------
+public:
+            OctreeAgentAdapter();
+   explicit OctreeAgentAdapter( const AGENT& agent );
+
+   virtual ~OctreeAgentAdapter();
+private:
+            OctreeAgentAdapter( const OctreeAgentAdapter& );
+   OctreeAgentAdapter& operator=( const OctreeAgentAdapter& );
+
+
+/// octree agent overrides
+protected:
+/// queries --------------------------------------------------------------------
+   virtual bool  isOverlappingCell ( const TYPE&     item,
+                                     const Vector3r& lowerCorner,
+                                     const Vector3r& upperCorner )        const;
+   virtual bool  isCoveringCell    ( const TYPE&     item,
+                                     const Vector3r& lowerCorner,
+                                     const Vector3r& upperCorner )        const;
+   virtual dword getSubcellOverlaps( const TYPE&     item,
+                                     const Vector3r& lower,
+                                     const Vector3r& middle,
+                                     const Vector3r& upper )              const;
+   virtual real  getDistance       ( const TYPE&     item,
+                                     const Vector3r& point )              const;
+   virtual real  getRayIntersection( const TYPE&     item,
+                                     const Vector3r& rayOrigin,
+                                     const Vector3r& rayDirection )       const;
+   virtual void  getBound          ( const TYPE&     item,
+                                     Vector3r&       lowerCorner,
+                                     Vector3r&       upperCorner )        const;
+
+
+/// fields ---------------------------------------------------------------------
+private:
+   AGENT agent_m;
+};
+
+
+
+
+/**
+ * Agent for Octree, with items that are points.
+ */
+template<class TYPE>
+class OctreeAgentPoint
+   : public OctreeAgentAdapter<TYPE, OctreeAgentStaticPoint<TYPE> >
+{
+};
+
+
+/**
+ * Agent for Octree, with items that are axis-aligned boxes.
+ */
+template<class TYPE>
+class OctreeAgentBox
+   : public OctreeAgentAdapter<TYPE, OctreeAgentStaticBox<TYPE> >
+{
+};
+
+
+/**
+ * Agent for Octree, with items that are spheres.
+ */
+template<class TYPE>
+class OctreeAgentSphere
+   : public OctreeAgentAdapter<TYPE, OctreeAgentStaticSphere<TYPE> >
+{
+};
+
+
+/**
+ * Agent for Octree, with items that are triangles.
+ */
+template<class TYPE>
+class OctreeAgentTriangle
+   : public OctreeAgentAdapter<TYPE, OctreeAgentStaticTriangle<TYPE> >
+{
+};
+
+
+
+
+
+
+
+
+/// templates ///
+
+/// OctreeAgentStaticPoint -----------------------------------------------------
+template<class TYPE>
+inline
+bool OctreeAgentStaticPoint<TYPE>::isOverlappingCell
+(
+   const TYPE&     item,
+   const Vector3r& lowerCorner,
+   const Vector3r& upperCorner
+) const
+{
+   return OctreeShape::isOverlappingPoint( item.getPosition(), lowerCorner,
+      upperCorner );
+}
+
+
+template<class TYPE>
+inline
+bool OctreeAgentStaticPoint<TYPE>::isCoveringCell
+(
+   const TYPE&     ,//item,
+   const Vector3r& ,//lowerCorner,
+   const Vector3r& //upperCorner
+) const
+{
+   // a point never covers a cell
+   return false;
+}
+
+
+template<class TYPE>
+inline
+dword OctreeAgentStaticPoint<TYPE>::getSubcellOverlaps
+(
+   const TYPE&     item,
+   const Vector3r& lower,
+   const Vector3r& middle,
+   const Vector3r& upper
+) const
+{
+   return OctreeShape::getSubcellOverlapsPoint( item.getPosition(), lower,
+      middle, upper );
+}
+
+
+template<class TYPE>
+inline
+real OctreeAgentStaticPoint<TYPE>::getDistance
+(
+   const TYPE&     item,
+   const Vector3r& point
+) const
+{
+   return OctreeShape::getDistancePoint( item.getPosition(), point );
+}
+
+
+template<class TYPE>
+inline
+real OctreeAgentStaticPoint<TYPE>::getRayIntersection
+(
+   const TYPE&     ,//item,
+   const Vector3r& ,//rayOrigin,
+   const Vector3r& //rayDirection
+) const
+{
+   // a ray has no width, so can not hit a point
+   return REAL_MAX;
+}
+
+
+template<class TYPE>
+inline
+void OctreeAgentStaticPoint<TYPE>::getBound
+(
+   const TYPE&     item,
+   Vector3r&       lowerCorner,
+   Vector3r&       upperCorner
+) const
+{
+   lowerCorner = item.getPosition();
+   upperCorner = lowerCorner;
+}
+
+
+
+
+/// OctreeAgentStaticBox -------------------------------------------------------
+template<class TYPE>
+inline
+bool OctreeAgentStaticBox<TYPE>::isOverlappingCell
+(
+   const TYPE&     item,
+   const Vector3r& lowerCorner,
+   const Vector3r& upperCorner
+) const
+{
+   return OctreeShape::isOverlappingBox( item.getLowerCorner(),
+      item.getUpperCorner(), lowerCorner, upperCorner );
+}
+
+
+template<class TYPE>
+inline
+bool OctreeAgentStaticBox<TYPE>::isCoveringCell
+(
+   const TYPE&     item,
+   const Vector3r& lowerCorner,
+   const Vector3r& upperCorner
+) const
+{
+   return OctreeShape::isCoveringBox( item.getLowerCorner(),
+      item.getUpperCorner(), lowerCorner, upperCorner );
+}
+
+
+template<class TYPE>
+inline
+dword OctreeAgentStaticBox<TYPE>::getSubcellOverlaps
+(
+   const TYPE&     item,
+   const Vector3r& lower,
+   const Vector3r& middle,
+   const Vector3r& upper
+) const
+{
+   return OctreeShape::getSubcellOverlapsBox( item.getLowerCorner(),
+      item.getUpperCorner(), lower, middle, upper );
+}
+
+
+template<class TYPE>
+inline
+real OctreeAgentStaticBox<TYPE>::getDistance
+(
+   const TYPE&     item,
+   const Vector3r& point
+) const
+{
+   return OctreeShape::getDistanceBox( item.getLowerCorner(),
+      item.getUpperCorner(), point );
+}
+
+
+template<class TYPE>
+inline
+real OctreeAgentStaticBox<TYPE>::getRayIntersection
+(
+   const TYPE&     item,
+   const Vector3r& rayOrigin,
+   const Vector3r& rayDirection
+) const
+{
+   return OctreeShape::getRayIntersectionBox( item.getLowerCorner(),
+      item.getUpperCorner(), rayOrigin, rayDirection );
+}
+
+
+template<class TYPE>
+inline
+void OctreeAgentStaticBox<TYPE>::getBound
+(
+   const TYPE&     item,
+   Vector3r&       lowerCorner,
+   Vector3r&       upperCorner
+) const
+{
+   lowerCorner = item.getLowerCorner();
+   upperCorner = item.getUpperCorner();
+}
+
+
+
+
+/// OctreeAgentStaticSphere ----------------------------------------------------
+template<class TYPE>
+inline
+bool OctreeAgentStaticSphere<TYPE>::isOverlappingCell
+(
+   const TYPE&     item,
+   const Vector3r& lowerCorner,
+   const Vector3r& upperCorner
+) const
+{
+   return OctreeShape::isOverlappingSphere( item.getCenter(),
+      item.getRadius(), lowerCorner, upperCorner );
+}
+
+
+template<class TYPE>
+inline
+bool OctreeAgentStaticSphere<TYPE>::isCoveringCell
+(
+   const TYPE&     item,
+   const Vector3r& lowerCorner,
+   const Vector3r& upperCorner
+) const
+{
+   return OctreeShape::isCoveringSphere( item.getCenter(),
+      item.getRadius(), lowerCorner, upperCorner );
+}
+
+
+template<class TYPE>
+inline
+dword OctreeAgentStaticSphere<TYPE>::getSubcellOverlaps
+(
+   const TYPE&     item,
+   const Vector3r& lower,
+   const Vector3r& middle,
+   const Vector3r& upper
+) const
+{
+   return OctreeShape::getSubcellOverlapsSphere( item.getCenter(),
+      item.getRadius(), lower, middle, upper );
+}
+
+
+template<class TYPE>
+inline
+real OctreeAgentStaticSphere<TYPE>::getDistance
+(
+   const TYPE&     item,
+   const Vector3r& point
+) const
+{
+   return OctreeShape::getDistanceSphere( item.getCenter(),
+      item.getRadius(), point );
+}
+
+
+template<class TYPE>
+inline
+real OctreeAgentStaticSphere<TYPE>::getRayIntersection
+(
+   const TYPE&     item,
+   const Vector3r& rayOrigin,
+   const Vector3r& rayDirection
+) const
+{
+   return OctreeShape::getRayIntersectionSphere( item.getCenter(),
+      item.getRadius(), rayOrigin, rayDirection );
+}
+
+
+template<class TYPE>
+inline
+void OctreeAgentStaticSphere<TYPE>::getBound
+(
+   const TYPE&     item,
+   Vector3r&       lowerCorner,
+   Vector3r&       upperCorner
+) const
+{
+   const real     radius = item.getRadius();
+   const Vector3r extent( radius, radius, radius );
+   lowerCorner = item.getCenter() - extent;
+   upperCorner = item.getCenter() + extent;
+}
+
+
+
+
+/// OctreeAgentStaticTriangle --------------------------------------------------
+template<class TYPE>
+inline
+bool OctreeAgentStaticTriangle<TYPE>::isOverlappingCell
+(
+   const TYPE&     item,
+   const Vector3r& lowerCorner,
+   const Vector3r& upperCorner
+) const
+{
+   return OctreeShape::isOverlappingTriangle( item.getVertex( 0 ),
+      item.getVertex( 1 ), item.getVertex( 2 ), lowerCorner, upperCorner );
+}
+
+
+template<class TYPE>
+inline
+bool OctreeAgentStaticTriangle<TYPE>::isCoveringCell
+(
+   const TYPE&     ,//item,
+   const Vector3r& ,//lowerCorner,
+   const Vector3r& //upperCorner
+) const
+{
+   // a triangle is flat, so never covers a cell
+   return false;
+}
+
+
+template<class TYPE>
+inline
+dword OctreeAgentStaticTriangle<TYPE>::getSubcellOverlaps
+(
+   const TYPE&     item,
+   const Vector3r& lower,
+   const Vector3r& middle,
+   const Vector3r& upper
+) const
+{
+   return OctreeShape::getSubcellOverlapsTriangle( item.getVertex( 0 ),
+      item.getVertex( 1 ), item.getVertex( 2 ), lower, middle, upper );
+}
+
+
+template<class TYPE>
+inline
+real OctreeAgentStaticTriangle<TYPE>::getDistance
+(
+   const TYPE&     item,
+   const Vector3r& point
+) const
+{
+   return OctreeShape::getDistanceTriangle( item.getVertex( 0 ),
+      item.getVertex( 1 ), item.getVertex( 2 ), point );
+}
+
+
+template<class TYPE>
+inline
+real OctreeAgentStaticTriangle<TYPE>::getRayIntersection
+(
+   const TYPE&     item,
+   const Vector3r& rayOrigin,
+   const Vector3r& rayDirection
+) const
+{
+   return OctreeShape::getRayIntersectionTriangle( item.getVertex( 0 ),
+      item.getVertex( 1 ), item.getVertex( 2 ), rayOrigin, rayDirection );
+}
+
+
+template<class TYPE>
+inline
+void OctreeAgentStaticTriangle<TYPE>::getBound
+(
+   const TYPE&     item,
+   Vector3r&       lowerCorner,
+   Vector3r&       upperCorner
+) const
+{
+   const Vector3r v0( item.getVertex( 0 ) );
+   const Vector3r v1( item.getVertex( 1 ) );
+   const Vector3r v2( item.getVertex( 2 ) );
+
+   // least and greatest of the vertexs, on each axis
+   real lower[3];
+   real upper[3];
+   for( int i = 3;  i-- > 0; )
+   {
+      const real a = v0[i];
+      const real b = v1[i];
+      const real c = v2[i];
+      lower[i] = (a < b) ? ((a < c) ? a : c) : ((b < c) ? b : c);
+      upper[i] = (a > b) ? ((a > c) ? a : c) : ((b > c) ? b : c);
+   }
+
+   lowerCorner.set( lower[0], lower[1], lower[2] );
+   upperCorner.set( upper[0], upper[1], upper[2] );
+}
+
+
+
+
+/// OctreeAgentAdapter ---------------------------------------------------------
+
+/// standard object services ---------------------------------------------------
+template<class TYPE, class AGENT>
+inline
+OctreeAgentAdapter<TYPE,AGENT>::OctreeAgentAdapter()
+ : agent_m()
+{
+}
+
+
+template<class TYPE, class AGENT>
+inline
+OctreeAgentAdapter<TYPE,AGENT>::OctreeAgentAdapter
+(
+   const AGENT& agent
+)
+ : agent_m( agent )
+{
+}
+
+
+template<class TYPE, class AGENT>
+inline
+OctreeAgentAdapter<TYPE,AGENT>::~OctreeAgentAdapter()
+{
+}
+
+
+
+
+/// octree agent overrides
+/// queries --------------------------------------------------------------------
+template<class TYPE, class AGENT>
+bool OctreeAgentAdapter<TYPE,AGENT>::isOverlappingCell
+(
+   const TYPE&     item,
+   const Vector3r& lowerCorner,
+   const Vector3r& upperCorner
+) const
+{
+   return agent_m.isOverlappingCell( item, lowerCorner, upperCorner );
+}
+
+
+template<class TYPE, class AGENT>
+bool OctreeAgentAdapter<TYPE,AGENT>::isCoveringCell
+(
+   const TYPE&     item,
+   const Vector3r& lowerCorner,
+   const Vector3r& upperCorner
+) const
+{
+   return agent_m.isCoveringCell( item, lowerCorner, upperCorner );
+}
+
+
+template<class TYPE, class AGENT>
+dword OctreeAgentAdapter<TYPE,AGENT>::getSubcellOverlaps
+(
+   const TYPE&     item,
+   const Vector3r& lower,
+   const Vector3r& middle,
+   const Vector3r& upper
+) const
+{
+   return agent_m.getSubcellOverlaps( item, lower, middle, upper );
+}
+
+
+template<class TYPE, class AGENT>
+real OctreeAgentAdapter<TYPE,AGENT>::getDistance
+(
+   const TYPE&     item,
+   const Vector3r& point
+) const
+{
+   return agent_m.getDistance( item, point );
+}
+
+
+template<class TYPE, class AGENT>
+real OctreeAgentAdapter<TYPE,AGENT>::getRayIntersection
+(
+   const TYPE&     item,
+   const Vector3r& rayOrigin,
+   const Vector3r& rayDirection
+) const
+{
+   return agent_m.getRayIntersection( item, rayOrigin,
+      rayDirection );
+}
+
+
+template<class TYPE, class AGENT>
+void OctreeAgentAdapter<TYPE,AGENT>::getBound
+(
+   const TYPE&     item,
+   Vector3r&       lowerCorner,
+   Vector3r&       upperCorner
+) const
+{
+   agent_m.getBound( item, lowerCorner, upperCorner );
+}
+
+
+}//namespace
+
+
+
+
+#endif//OctreeAgents_h
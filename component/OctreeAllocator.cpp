@@ -0,0 +1,397 @@
+/*------------------------------------------------------------------------------
+
+   Octree Component, version 2.1
+   Copyright (c) 2004-2007,  Harrison Ainsworth / HXA7241.
+
+   http://www.hxa7241.org/
+
+------------------------------------------------------------------------------*/
+
+/*------------------------------------------------------------------------------
+
+Copyright (c) 2004-2007, Harrison Ainsworth / HXA7241.
+
+Redistribution and use in source and binary forms, with or without modification,
+are permitted provided that the following conditions are met:
+
+* Redistributions of source code must retain the above copyright notice, this
+  list of conditions and the following disclaimer.
+* Redistributions in binary form must reproduce the above copyright notice, this
+  list of conditions and the following disclaimer in the documentation and/or
+  other materials provided with the distribution.
+* The name of the author may not be used to endorse or promote products derived
+  from this software without specific prior written permission.
+
+THIS SOFTWARE IS PROVIDED BY THE AUTHOR "AS IS" AND ANY EXPRESS OR IMPLIED
+WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT
+SHALL THE AUTHOR BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT
+OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING
+IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY
+OF SUCH DAMAGE.
+
+------------------------------------------------------------------------------*/
+
+
+#include <functional>
+
+#include "OctreeLooseRoot.hpp"
+
+#include "OctreeAllocator.hpp"
+
+
+using namespace hxa7241_graphics;
+
+
+
+
+/// OctreeAllocatorHeap ////////////////////////////////////////////////////////
+
+
+/// standard object services ---------------------------------------------------
+OctreeAllocatorHeap::OctreeAllocatorHeap()
+{
+}
+
+
+OctreeAllocatorHeap::~OctreeAllocatorHeap()
+{
+}
+
+
+
+
+/// commands -------------------------------------------------------------------
+void* OctreeAllocatorHeap::allocateBranch()
+{
+   return ::operator new( sizeof(OctreeBranch) );
+}
+
+
+void OctreeAllocatorHeap::freeBranch
+(
+   void* pBranch
+)
+{
+   ::operator delete( pBranch );
+}
+
+
+void* OctreeAllocatorHeap::allocateLeaf()
+{
+   return ::operator new( sizeof(OctreeLeaf) );
+}
+
+
+void OctreeAllocatorHeap::freeLeaf
+(
+   void* pLeaf
+)
+{
+   ::operator delete( pLeaf );
+}
+
+
+void* OctreeAllocatorHeap::allocateLooseNode()
+{
+   return ::operator new( sizeof(OctreeLooseRoot::Node) );
+}
+
+
+void OctreeAllocatorHeap::freeLooseNode
+(
+   void* pNode
+)
+{
+   ::operator delete( pNode );
+}
+
+
+void OctreeAllocatorHeap::freeAll()
+{
+   // cells are freed individually
+}
+
+
+
+
+/// queries --------------------------------------------------------------------
+bool OctreeAllocatorHeap::isFreeingAll() const
+{
+   return false;
+}
+
+
+
+
+
+
+
+
+/// OctreeSlotPool /////////////////////////////////////////////////////////////
+
+
+// about 4-10KB slabs, for branchs, leafs and loose nodes
+const dword OctreeSlotPool::SLAB_SLOT_COUNT = 128;
+
+
+/// standard object services ---------------------------------------------------
+OctreeSlotPool::OctreeSlotPool
+(
+   const dword slotSize
+)
+ : slotSize_m  ( 0 )
+ , pSlabs_m    ( 0 )
+ , slabCount_m ( 0 )
+ , newestUsed_m( 0 )
+ , pFree_m     ( 0 )
+{
+   // round up to whole words, at least one (the free link)
+   const dword words = (slotSize + sizeof(void*) - 1) / sizeof(void*);
+   slotSize_m = (words >= 1 ? words : 1) * sizeof(void*);
+}
+
+
+OctreeSlotPool::~OctreeSlotPool()
+{
+   OctreeSlotPool::freeAll( 0 );
+}
+
+
+
+
+/// commands -------------------------------------------------------------------
+void OctreeSlotPool::freeAll
+(
+   void (*destroyLive)(void*)
+)
+{
+   // destroy the slots still live
+   if( destroyLive && pSlabs_m )
+   {
+      // sort slabs and freed slots by address, then step through both
+      // together: each carved slot not next in the free list is live
+      void**const pNewest = pSlabs_m;
+      pSlabs_m = sortList( pSlabs_m );
+      char* pFree = reinterpret_cast<char*>( sortList( pFree_m ) );
+
+      for( void** pSlab = pSlabs_m;  pSlab;
+         pSlab = static_cast<void**>( pSlab[0] ) )
+      {
+         char* pSlot = reinterpret_cast<char*>( pSlab + 1 );
+         for( dword i = (pSlab == pNewest) ? newestUsed_m : SLAB_SLOT_COUNT;
+            i-- > 0;  pSlot += slotSize_m )
+         {
+            if( pSlot == pFree )
+            {
+               pFree = *reinterpret_cast<char**>( pFree );
+            }
+            else
+            {
+               destroyLive( pSlot );
+            }
+         }
+      }
+   }
+
+   // release slabs whole
+   while( pSlabs_m )
+   {
+      void**const pSlab = pSlabs_m;
+      pSlabs_m = static_cast<void**>( pSlab[0] );
+      ::operator delete( pSlab );
+   }
+
+   slabCount_m  = 0;
+   newestUsed_m = 0;
+   pFree_m      = 0;
+}
+
+
+
+
+/// queries --------------------------------------------------------------------
+dword OctreeSlotPool::getSlotSize() const
+{
+   return slotSize_m;
+}
+
+
+dword OctreeSlotPool::getByteSize() const
+{
+   return slabCount_m * (sizeof(void*) + (SLAB_SLOT_COUNT * slotSize_m));
+}
+
+
+
+
+/// implementation -------------------------------------------------------------
+void** OctreeSlotPool::sortList
+(
+   void** pList
+)
+{
+   // (merge sort, by address, of a list linked by first words)
+   if( pList && pList[0] )
+   {
+      // split in the middle: step one pointer half as fast as another
+      void** pMiddle = pList;
+      for( void** pEnd = static_cast<void**>( pList[0] );
+         pEnd && pEnd[0];
+         pEnd = static_cast<void**>( static_cast<void**>( pEnd[0] )[0] ) )
+      {
+         pMiddle = static_cast<void**>( pMiddle[0] );
+      }
+      void** pSecond = static_cast<void**>( pMiddle[0] );
+      pMiddle[0] = 0;
+
+      // sort each half, then merge them
+      void** pA = sortList( pList );
+      void** pB = sortList( pSecond );
+
+      void*  pHead = 0;
+      void** pLink = &pHead;
+      while( pA && pB )
+      {
+         void**& pLower = std::less<void**>()( pB, pA ) ? pB : pA;
+         *pLink = pLower;
+         pLink  = pLower;
+         pLower = static_cast<void**>( pLower[0] );
+      }
+      *pLink = pA ? pA : pB;
+
+      pList = static_cast<void**>( pHead );
+   }
+
+   return pList;
+}
+
+
+
+
+
+
+
+
+/// OctreeAllocatorPool ////////////////////////////////////////////////////////
+
+
+/// standard object services ---------------------------------------------------
+OctreeAllocatorPool::OctreeAllocatorPool()
+ : branchs_m   ( sizeof(OctreeBranch) )
+ , leafs_m     ( sizeof(OctreeLeaf) )
+ , looseNodes_m( sizeof(OctreeLooseRoot::Node) )
+{
+}
+
+
+OctreeAllocatorPool::~OctreeAllocatorPool()
+{
+   OctreeAllocatorPool::freeAll();
+}
+
+
+
+
+/// commands -------------------------------------------------------------------
+void* OctreeAllocatorPool::allocateBranch()
+{
+   return branchs_m.allocate();
+}
+
+
+void OctreeAllocatorPool::freeBranch
+(
+   void* pBranch
+)
+{
+   branchs_m.free( pBranch );
+}
+
+
+void* OctreeAllocatorPool::allocateLeaf()
+{
+   return leafs_m.allocate();
+}
+
+
+void OctreeAllocatorPool::freeLeaf
+(
+   void* pLeaf
+)
+{
+   leafs_m.free( pLeaf );
+}
+
+
+void* OctreeAllocatorPool::allocateLooseNode()
+{
+   return looseNodes_m.allocate();
+}
+
+
+void OctreeAllocatorPool::freeLooseNode
+(
+   void* pNode
+)
+{
+   looseNodes_m.free( pNode );
+}
+
+
+void OctreeAllocatorPool::freeAll()
+{
+   // (live cells of all kinds are destroyed, to release their item arrays)
+   branchs_m.freeAll( &OctreeAllocatorPool::destroyBranch );
+   leafs_m.freeAll( &OctreeAllocatorPool::destroyLeaf );
+   looseNodes_m.freeAll( &OctreeAllocatorPool::destroyLooseNode );
+}
+
+
+
+
+/// queries --------------------------------------------------------------------
+bool OctreeAllocatorPool::isFreeingAll() const
+{
+   return true;
+}
+
+
+dword OctreeAllocatorPool::getByteSize() const
+{
+   return branchs_m.getByteSize() + leafs_m.getByteSize() +
+      looseNodes_m.getByteSize();
+}
+
+
+
+
+/// implementation -------------------------------------------------------------
+void OctreeAllocatorPool::destroyBranch
+(
+   void* pBranch
+)
+{
+   static_cast<OctreeBranch*>( pBranch )->~OctreeBranch();
+}
+
+
+void OctreeAllocatorPool::destroyLeaf
+(
+   void* pLeaf
+)
+{
+   static_cast<OctreeLeaf*>( pLeaf )->~OctreeLeaf();
+}
+
+
+void OctreeAllocatorPool::destroyLooseNode
+(
+   void* pNode
+)
+{
+   static_cast<OctreeLooseRoot::Node*>( pNode )->~Node();
+}
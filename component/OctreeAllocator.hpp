@@ -0,0 +1,447 @@
+/*------------------------------------------------------------------------------
+
+   Octree Component, version 2.1
+   Copyright (c) 2004-2007,  Harrison Ainsworth / HXA7241.
+
+   http://www.hxa7241.org/
+
+------------------------------------------------------------------------------*/
+
+/*------------------------------------------------------------------------------
+
+Copyright (c) 2004-2007, Harrison Ainsworth / HXA7241.
+
+Redistribution and use in source and binary forms, with or without modification,
+are permitted provided that the following conditions are met:
+
+* Redistributions of source code must retain the above copyright notice, this
+  list of conditions and the following disclaimer.
+* Redistributions in binary form must reproduce the above copyright notice, this
+  list of conditions and the following disclaimer in the documentation and/or
+  other materials provided with the distribution.
+* The name of the author may not be used to endorse or promote products derived
+  from this software without specific prior written permission.
+
+THIS SOFTWARE IS PROVIDED BY THE AUTHOR "AS IS" AND ANY EXPRESS OR IMPLIED
+WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT
+SHALL THE AUTHOR BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT
+OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING
+IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY
+OF SUCH DAMAGE.
+
+------------------------------------------------------------------------------*/
+
+
+#ifndef OctreeAllocator_h
+#define OctreeAllocator_h
+
+
+#include "OctreeImplementation.hpp"
+
+
+
+
+namespace hxa7241_graphics
+{
+
+
+/**
+ * Cell allocator using global new and delete.<br/><br/>
+ *
+ * Every cell (and loose node) is separately allocated, and freed when its
+ * tree releases it.
+ *
+ * @see OctreeAllocatorPool
+ */
+class OctreeAllocatorHeap
+   : public OctreeAllocatorV
+{
+/// standard object services ---------------------------------------------------
+public:
+            OctreeAllocatorHeap();
+
+   virtual ~OctreeAllocatorHeap();
+private:
+            OctreeAllocatorHeap( const OctreeAllocatorHeap& );
+   OctreeAllocatorHeap& operator=( const OctreeAllocatorHeap& );
+public:
+
+
+/// commands -------------------------------------------------------------------
+   virtual void* allocateBranch();
+   virtual void  freeBranch( void* pBranch );
+   virtual void* allocateLeaf();
+   virtual void  freeLeaf( void* pLeaf );
+   virtual void* allocateLooseNode();
+   virtual void  freeLooseNode( void* pNode );
+
+   virtual void  freeAll();
+
+
+/// queries --------------------------------------------------------------------
+   virtual bool  isFreeingAll()                                           const;
+};
+
+
+
+
+/**
+ * Fixed-size slot storage, for OctreeAllocatorPool.<br/><br/>
+ *
+ * Slots are carved from slabs, and recycled through a free list. All slabs are
+ * released together by freeAll (or destruction).<br/><br/>
+ *
+ * Slots have no header: a freed slot's first word links the free list. To
+ * destroy what is in the live slots, freeAll sorts the slabs and the free list
+ * by address, and steps through both together -- so it never reads the
+ * storage to tell live from free, and needs no memory. Without a destroy
+ * function, it only releases the slabs.
+ *
+ * @invariants
+ * slotSize_m >= 1 word, and a whole number of words<br/>
+ * pSlabs_m is 0, or the newest of a list of slabs, linked by their first
+ * words<br/>
+ * newestUsed_m <= SLAB_SLOT_COUNT; only the newest slab is partly used<br/>
+ * pFree_m is 0, or the first of a list of freed slots, linked by their first
+ * words<br/>
+ */
+class OctreeSlotPool
+{
+/// standard object services ---------------------------------------------------
+public:
+   explicit OctreeSlotPool( dword slotSize );
+
+           ~OctreeSlotPool();
+private:
+            OctreeSlotPool( const OctreeSlotPool& );
+   OctreeSlotPool& operator=( const OctreeSlotPool& );
+public:
+
+
+/// commands -------------------------------------------------------------------
+           void* allocate();                                           // throws
+           void  free( void* pSlot );
+
+           void  freeAll( void (*destroyLive)(void*) );
+
+
+/// queries --------------------------------------------------------------------
+           dword getSlotSize()                                            const;
+           dword getByteSize()                                            const;
+
+
+/// implementation -------------------------------------------------------------
+protected:
+   static  void** sortList( void** pList );
+
+
+/// fields ---------------------------------------------------------------------
+private:
+   dword  slotSize_m;
+   void** pSlabs_m;
+   dword  slabCount_m;
+   dword  newestUsed_m;
+   void** pFree_m;
+
+   static const dword SLAB_SLOT_COUNT;
+};
+
+
+
+
+/**
+ * Cell allocator pooling cells in slabs.<br/><br/>
+ *
+ * Branchs, leafs and loose nodes each have their own slabs and free list.
+ * Cells freed during tree changes are recycled; freeAll releases every slab
+ * at once, without walking the tree (only the live cells are visited, from a
+ * list, to release their item arrays).<br/><br/>
+ *
+ * One instance per octree.
+ *
+ * @see OctreeAllocatorHeap
+ */
+class OctreeAllocatorPool
+   : public OctreeAllocatorV
+{
+/// standard object services ---------------------------------------------------
+public:
+            OctreeAllocatorPool();
+
+   virtual ~OctreeAllocatorPool();
+private:
+            OctreeAllocatorPool( const OctreeAllocatorPool& );
+   OctreeAllocatorPool& operator=( const OctreeAllocatorPool& );
+public:
+
+
+/// commands -------------------------------------------------------------------
+   virtual void* allocateBranch();
+   virtual void  freeBranch( void* pBranch );
+   virtual void* allocateLeaf();
+   virtual void  freeLeaf( void* pLeaf );
+   virtual void* allocateLooseNode();
+   virtual void  freeLooseNode( void* pNode );
+
+   virtual void  freeAll();
+
+
+/// queries --------------------------------------------------------------------
+   virtual bool  isFreeingAll()                                           const;
+
+           dword getByteSize()                                            const;
+
+
+/// implementation -------------------------------------------------------------
+protected:
+   static  void  destroyBranch( void* pBranch );
+   static  void  destroyLeaf  ( void* pLeaf );
+   static  void  destroyLooseNode( void* pNode );
+
+
+/// fields ---------------------------------------------------------------------
+private:
+   OctreeSlotPool branchs_m;
+   OctreeSlotPool leafs_m;
+   OctreeSlotPool looseNodes_m;
+};
+
+
+
+
+/**
+ * Handle to an allocator shared by an octree and its copies.<br/><br/>
+ *
+ * The allocator is made with the first handle, and destroyed with the last.
+ * While it has more than one handle, it never frees the whole tree at once
+ * (then each tree releases only its own share of the cells).<br/><br/>
+ *
+ * Handles may be on different threads: the count of them is atomic, and while
+ * there is more than one, each allocator call is made under a mutex.
+ *
+ * @see Octree
+ */
+template<class ALLOCATOR>
+class OctreeAllocatorShared
+{
+/// standard object services ---------------------------------------------------
+public:
+            OctreeAllocatorShared();
+
+           ~OctreeAllocatorShared();
+            OctreeAllocatorShared( const OctreeAllocatorShared& );
+private:
+   OctreeAllocatorShared& operator=( const OctreeAllocatorShared& );
+public:
+
+
+/// queries --------------------------------------------------------------------
+           OctreeAllocatorV& get()                                        const;
+
+
+/// implementation -------------------------------------------------------------
+protected:
+   class Counted
+      : public ALLOCATOR
+   {
+   public:
+      Counted() : handleCount( 1 ) {}
+
+      virtual void* allocateBranch()
+      {
+         Locked locked( *this );
+         return ALLOCATOR::allocateBranch();
+      }
+
+      virtual void  freeBranch( void* pBranch )
+      {
+         Locked locked( *this );
+         ALLOCATOR::freeBranch( pBranch );
+      }
+
+      virtual void* allocateLeaf()
+      {
+         Locked locked( *this );
+         return ALLOCATOR::allocateLeaf();
+      }
+
+      virtual void  freeLeaf( void* pLeaf )
+      {
+         Locked locked( *this );
+         ALLOCATOR::freeLeaf( pLeaf );
+      }
+
+      virtual void* allocateLooseNode()
+      {
+         Locked locked( *this );
+         return ALLOCATOR::allocateLooseNode();
+      }
+
+      virtual void  freeLooseNode( void* pNode )
+      {
+         Locked locked( *this );
+         ALLOCATOR::freeLooseNode( pNode );
+      }
+
+      virtual void  freeAll()
+      {
+         Locked locked( *this );
+         ALLOCATOR::freeAll();
+      }
+
+      virtual bool  isFreeingAll() const
+      {
+         return (1 == OctreeAtomic::read( handleCount )) &&
+            ALLOCATOR::isFreeingAll();
+      }
+
+      // by OctreeAtomic only
+      dword       handleCount;
+      OctreeMutex mutex;
+   };
+
+   // holds the mutex locked for its lifetime, if there are other handles (a
+   // lone handle has no other thread to race, and can make none meanwhile)
+   class Locked
+   {
+   public:
+      explicit Locked( Counted& counted )
+       : pMutex( (OctreeAtomic::read( counted.handleCount ) > 1) ?
+            &counted.mutex : 0 )
+      {
+         if( pMutex )
+         {
+            pMutex->lock();
+         }
+      }
+
+      ~Locked()
+      {
+         if( pMutex )
+         {
+            pMutex->unlock();
+         }
+      }
+
+   private:
+      Locked( const Locked& );
+      Locked& operator=( const Locked& );
+
+      OctreeMutex* pMutex;
+   };
+
+
+/// fields ---------------------------------------------------------------------
+private:
+   Counted* pCounted_m;
+};
+
+
+
+
+/// templates ///
+
+/// OctreeAllocatorShared ------------------------------------------------------
+template<class ALLOCATOR>
+OctreeAllocatorShared<ALLOCATOR>::OctreeAllocatorShared()
+ : pCounted_m( new Counted )
+{
+}
+
+
+template<class ALLOCATOR>
+OctreeAllocatorShared<ALLOCATOR>::~OctreeAllocatorShared()
+{
+   if( 0 == OctreeAtomic::decrement( pCounted_m->handleCount ) )
+   {
+      delete pCounted_m;
+   }
+}
+
+
+template<class ALLOCATOR>
+OctreeAllocatorShared<ALLOCATOR>::OctreeAllocatorShared
+(
+   const OctreeAllocatorShared& other
+)
+ : pCounted_m( other.pCounted_m )
+{
+   OctreeAtomic::increment( pCounted_m->handleCount );
+}
+
+
+template<class ALLOCATOR>
+inline
+OctreeAllocatorV& OctreeAllocatorShared<ALLOCATOR>::get() const
+{
+   return *pCounted_m;
+}
+
+
+
+
+
+
+
+
+/// inlines ///
+
+/// OctreeSlotPool -------------------------------------------------------------
+inline
+void* OctreeSlotPool::allocate()
+{
+   void** pSlot = pFree_m;
+
+   // take from free list
+   if( pSlot )
+   {
+      pFree_m = static_cast<void**>( pSlot[0] );
+   }
+   // or carve from newest slab, making a new one if full
+   else
+   {
+      if( !pSlabs_m || (newestUsed_m >= SLAB_SLOT_COUNT) )
+      {
+         void**const pSlab = static_cast<void**>( ::operator new(
+            sizeof(void*) + (SLAB_SLOT_COUNT * slotSize_m) ) );
+         pSlab[0]     = pSlabs_m;
+         pSlabs_m     = pSlab;
+         newestUsed_m = 0;
+         ++slabCount_m;
+      }
+
+      pSlot = reinterpret_cast<void**>( reinterpret_cast<char*>(pSlabs_m + 1) +
+         (newestUsed_m * slotSize_m) );
+      ++newestUsed_m;
+   }
+
+   return pSlot;
+}
+
+
+inline
+void OctreeSlotPool::free
+(
+   void* pSlot
+)
+{
+   // push onto free list
+   if( pSlot )
+   {
+      void**const pFree = static_cast<void**>( pSlot );
+      pFree[0] = pFree_m;
+      pFree_m  = pFree;
+   }
+}
+
+
+}//namespace
+
+
+
+
+#endif//OctreeAllocator_h
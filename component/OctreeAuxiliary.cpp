@@ -36,6 +36,10 @@ OF SUCH DAMAGE.
 ------------------------------------------------------------------------------*/
 
 
+#include <math.h>
+
+#include "OctreeTasks.hpp"
+
 #include "OctreeAuxiliary.hpp"
 
 
@@ -61,14 +65,22 @@ OctreeDimensions::OctreeDimensions
    const real      size,
    const dword     maxItemsPerCell,
    const dword     maxLevelCount,
-   const real      minCellSize
+   const real      minCellSize,
+   const dword     collapseItemCount,
+   const real      looseness
 )
  : positionOfLowerCorner_m( positionOfLowerCorner )
  , size_m                 ( size            >= 0.0f ? size          : -size   )
  , maxItemsPerCell_m      ( maxItemsPerCell >  0    ? maxItemsPerCell   : 1   )
  , maxLevel_m             ( maxLevelCount   >  0    ? maxLevelCount - 1 : 0   )
  , minSize_m              ( minCellSize <= size_m   ? minCellSize   : size_m  )
+ , collapseItems_m        ( collapseItemCount > 0   ? collapseItemCount : 0   )
+ , looseness_m            ( looseness >= 1.0f       ? looseness     : 1.0f    )
 {
+   if( collapseItems_m > maxItemsPerCell_m )
+   {
+      collapseItems_m = maxItemsPerCell_m;
+   }
    if( maxLevel_m > MAX_LEVEL )
    {
       maxLevel_m = MAX_LEVEL;
@@ -94,6 +106,8 @@ OctreeDimensions::OctreeDimensions
  , maxItemsPerCell_m      ( other.maxItemsPerCell_m )
  , maxLevel_m             ( other.maxLevel_m )
  , minSize_m              ( other.minSize_m )
+ , collapseItems_m        ( other.collapseItems_m )
+ , looseness_m            ( other.looseness_m )
 {
 }
 
@@ -110,6 +124,8 @@ OctreeDimensions& OctreeDimensions::operator=
       maxItemsPerCell_m       = other.maxItemsPerCell_m;
       maxLevel_m              = other.maxLevel_m;
       minSize_m               = other.minSize_m;
+      collapseItems_m         = other.collapseItems_m;
+      looseness_m             = other.looseness_m;
    }
 
    return *this;
@@ -137,6 +153,302 @@ bool OctreeDimensions::isSubdivide
 
 
 
+/// OctreeStats ////////////////////////////////////////////////////////////////
+
+
+const dword OctreeStats::LEVEL_COUNT;
+const dword OctreeStats::FILL_BUCKET_COUNT;
+
+
+/// standard object services ---------------------------------------------------
+OctreeStats::OctreeStats()
+ : itemCount_m   ( 0 )
+ , itemRefCount_m( 0 )
+ , byteSize_m    ( 0 )
+ , branchCount_m ( 0 )
+ , leafCount_m   ( 0 )
+{
+   for( dword i = LEVEL_COUNT;  i-- > 0; )
+   {
+      branchCounts_m[i] = 0;
+      leafCounts_m[i]   = 0;
+   }
+   for( dword i = FILL_BUCKET_COUNT;  i-- > 0; )
+   {
+      fillCounts_m[i] = 0;
+   }
+}
+
+
+OctreeStats::~OctreeStats()
+{
+}
+
+
+OctreeStats::OctreeStats
+(
+   const OctreeStats& other
+)
+{
+   OctreeStats::operator=( other );
+}
+
+
+OctreeStats& OctreeStats::operator=
+(
+   const OctreeStats& other
+)
+{
+   if( &other != this )
+   {
+      itemCount_m    = other.itemCount_m;
+      itemRefCount_m = other.itemRefCount_m;
+      byteSize_m     = other.byteSize_m;
+      branchCount_m  = other.branchCount_m;
+      leafCount_m    = other.leafCount_m;
+      for( dword i = LEVEL_COUNT;  i-- > 0; )
+      {
+         branchCounts_m[i] = other.branchCounts_m[i];
+         leafCounts_m[i]   = other.leafCounts_m[i];
+      }
+      for( dword i = FILL_BUCKET_COUNT;  i-- > 0; )
+      {
+         fillCounts_m[i] = other.fillCounts_m[i];
+      }
+   }
+
+   return *this;
+}
+
+
+
+
+/// commands -------------------------------------------------------------------
+void OctreeStats::add
+(
+   const OctreeStats& part
+)
+{
+   itemCount_m    += part.itemCount_m;
+   itemRefCount_m += part.itemRefCount_m;
+   byteSize_m     += part.byteSize_m;
+   branchCount_m  += part.branchCount_m;
+   leafCount_m    += part.leafCount_m;
+   for( dword i = LEVEL_COUNT;  i-- > 0; )
+   {
+      branchCounts_m[i] += part.branchCounts_m[i];
+      leafCounts_m[i]   += part.leafCounts_m[i];
+   }
+   for( dword i = FILL_BUCKET_COUNT;  i-- > 0; )
+   {
+      fillCounts_m[i] += part.fillCounts_m[i];
+   }
+}
+
+
+
+
+/// queries --------------------------------------------------------------------
+real OctreeStats::getRefsPerItem() const
+{
+   return (itemCount_m > 0) ? (static_cast<real>(itemRefCount_m) /
+      static_cast<real>(itemCount_m)) : 0.0f;
+}
+
+
+dword OctreeStats::getMaxDepth() const
+{
+   // one below the deepest level holding leafs
+   dword depth = LEVEL_COUNT;
+   while( (depth > 0) && (0 == leafCounts_m[depth - 1]) )
+   {
+      --depth;
+   }
+
+   return depth;
+}
+
+
+
+
+
+
+
+
+/// OctreeCallCounts ///////////////////////////////////////////////////////////
+
+
+/// standard object services ---------------------------------------------------
+OctreeCallCounts::OctreeCallCounts()
+ : cellCount_m    ( 0 )
+ , dataCount_m    ( 0 )
+ , testCount_m    ( 0 )
+ , exitCount_m    ( 0 )
+ , itemScanCount_m( 0 )
+{
+   for( dword i = OctreeStats::LEVEL_COUNT;  i-- > 0; )
+   {
+      cellCounts_m[i] = 0;
+   }
+}
+
+
+OctreeCallCounts::~OctreeCallCounts()
+{
+}
+
+
+OctreeCallCounts::OctreeCallCounts
+(
+   const OctreeCallCounts& other
+)
+{
+   OctreeCallCounts::operator=( other );
+}
+
+
+OctreeCallCounts& OctreeCallCounts::operator=
+(
+   const OctreeCallCounts& other
+)
+{
+   if( &other != this )
+   {
+      cellCount_m     = other.cellCount_m;
+      dataCount_m     = other.dataCount_m;
+      testCount_m     = other.testCount_m;
+      exitCount_m     = other.exitCount_m;
+      itemScanCount_m = other.itemScanCount_m;
+      for( dword i = OctreeStats::LEVEL_COUNT;  i-- > 0; )
+      {
+         cellCounts_m[i] = other.cellCounts_m[i];
+      }
+   }
+
+   return *this;
+}
+
+
+
+
+/// commands -------------------------------------------------------------------
+void OctreeCallCounts::add
+(
+   const OctreeCallCounts& part
+)
+{
+   cellCount_m     += part.cellCount_m;
+   dataCount_m     += part.dataCount_m;
+   testCount_m     += part.testCount_m;
+   exitCount_m     += part.exitCount_m;
+   itemScanCount_m += part.itemScanCount_m;
+   for( dword i = OctreeStats::LEVEL_COUNT;  i-- > 0; )
+   {
+      cellCounts_m[i] += part.cellCounts_m[i];
+   }
+}
+
+
+
+
+
+
+
+
+/// OctreeCounts ///////////////////////////////////////////////////////////////
+
+
+const dword OctreeCounts::LATENCY_BUCKET_COUNT;
+
+
+/// standard object services ---------------------------------------------------
+OctreeCounts::OctreeCounts()
+{
+}
+
+
+OctreeCounts::~OctreeCounts()
+{
+}
+
+
+OctreeCounts::OctreeCounts
+(
+   const OctreeCounts& other
+)
+{
+   OctreeCounts::operator=( other );
+}
+
+
+OctreeCounts& OctreeCounts::operator=
+(
+   const OctreeCounts& other
+)
+{
+   if( &other != this )
+   {
+      for( dword i = OPERATION_COUNT;  i-- > 0; )
+      {
+         operations_m[i] = other.operations_m[i];
+      }
+   }
+
+   return *this;
+}
+
+
+OctreeCounts::Operation::Operation()
+ : callCount     ( 0 )
+ , counts        ()
+ , slowestLatency( 0 )
+ , slowestCounts ()
+{
+   for( dword i = LATENCY_BUCKET_COUNT;  i-- > 0; )
+   {
+      latencyCounts[i] = 0;
+   }
+}
+
+
+
+
+/// commands -------------------------------------------------------------------
+void OctreeCounts::addCall
+(
+   const EOperation        operation,
+   const OctreeCallCounts& callCounts,
+   const dword             nanoseconds
+)
+{
+   Operation& op = operations_m[operation];
+
+   ++op.callCount;
+   op.counts.add( callCounts );
+
+   // latency bucket is the time's highest bit
+   dword bucket = 0;
+   for( udword time = nanoseconds;  (time > 1) &&
+      (bucket < (LATENCY_BUCKET_COUNT - 1));  time >>= 1 )
+   {
+      ++bucket;
+   }
+   ++op.latencyCounts[bucket];
+
+   if( op.slowestLatency <= nanoseconds )
+   {
+      op.slowestLatency = nanoseconds;
+      op.slowestCounts  = callCounts;
+   }
+}
+
+
+
+
+
+
+
+
 /// OctreeBound ////////////////////////////////////////////////////////////////
 
 
@@ -229,6 +541,492 @@ OctreeBound& OctreeBound::operator=
 
 
 
+/// queries --------------------------------------------------------------------
+real OctreeBound::getDistance
+(
+   const Vector3r& point
+) const
+{
+   return OctreeShape::getDistanceBox( positionOfLowerCorner_m,
+      positionOfUpperCorner_m, point );
+}
+
+
+
+
+
+
+
+
+/// OctreeShape ////////////////////////////////////////////////////////////////
+
+
+/// statics --------------------------------------------------------------------
+bool OctreeShape::isOverlappingTriangle
+(
+   const Vector3r& vertex0,
+   const Vector3r& vertex1,
+   const Vector3r& vertex2,
+   const Vector3r& lowerCorner,
+   const Vector3r& upperCorner
+)
+{
+   // as the lowest of 8 subcells, the others empty, so the arithmetic is the
+   // same as for subcells
+   return 0 != (getSubcellOverlapsTriangle( vertex0, vertex1, vertex2,
+      lowerCorner, upperCorner, upperCorner ) & 1);
+}
+
+
+dword OctreeShape::getSubcellOverlapsTriangle
+(
+   const Vector3r& vertex0,
+   const Vector3r& vertex1,
+   const Vector3r& vertex2,
+   const Vector3r& lower,
+   const Vector3r& middle,
+   const Vector3r& upper
+)
+{
+#ifdef OCTREE_SSE
+   return getSubcellOverlapsTriangleSse( vertex0, vertex1, vertex2, lower,
+      middle, upper );
+#else
+   return getSubcellOverlapsTriangleScalar( vertex0, vertex1, vertex2, lower,
+      middle, upper );
+#endif
+}
+
+
+dword OctreeShape::getSubcellOverlapsTriangleScalar
+(
+   const Vector3r& vertex0,
+   const Vector3r& vertex1,
+   const Vector3r& vertex2,
+   const Vector3r& lower,
+   const Vector3r& middle,
+   const Vector3r& upper
+)
+{
+   const Vector3r* vertexs[] = { &vertex0, &vertex1, &vertex2 };
+
+   // the cell's face normals: the triangle's bound against the halfs, along
+   // each cell axis
+   dword flags = 0xFF;
+   for( int k = 3;  k-- > 0; )
+   {
+      const real boundMin = vertex0[k] < vertex1[k] ?
+         (vertex0[k] < vertex2[k] ? vertex0[k] : vertex2[k]) :
+         (vertex1[k] < vertex2[k] ? vertex1[k] : vertex2[k]);
+      const real boundMax = vertex0[k] > vertex1[k] ?
+         (vertex0[k] > vertex2[k] ? vertex0[k] : vertex2[k]) :
+         (vertex1[k] > vertex2[k] ? vertex1[k] : vertex2[k]);
+      flags &= getAxisSubcells( k,
+         (boundMin <= middle[k]) & (boundMax >= lower[k]),
+         (boundMin <= upper[k])  & (boundMax >= middle[k]) );
+   }
+
+   // the other axes: the triangle's normal, and the crosses of each cell axis
+   // with each triangle edge
+   real axes[10][3];
+   real edges[3][3];
+   for( int k = 3;  k-- > 0; )
+   {
+      edges[0][k] = vertex1[k] - vertex0[k];
+      edges[1][k] = vertex2[k] - vertex1[k];
+      edges[2][k] = vertex0[k] - vertex2[k];
+   }
+   for( int k = 3;  k-- > 0; )
+   {
+      axes[0][k] = (edges[0][(k + 1) % 3] * edges[1][(k + 2) % 3]) -
+                   (edges[0][(k + 2) % 3] * edges[1][(k + 1) % 3]);
+   }
+   for( int e = 3;  e-- > 0; )
+   {
+      for( int k = 3;  k-- > 0; )
+      {
+         real* axis = axes[1 + (e * 3) + k];
+         axis[k]           = 0.0f;
+         axis[(k + 1) % 3] = -edges[e][(k + 2) % 3];
+         axis[(k + 2) % 3] =  edges[e][(k + 1) % 3];
+      }
+   }
+
+   // clear the subcells separated from the triangle along each axis
+   for( int a = 0;  (a < 10) & (0 != flags);  ++a )
+   {
+      const real* axis = axes[a];
+
+      // the triangle's projection
+      real triangleMin = REAL_MAX;
+      real triangleMax = -REAL_MAX;
+      for( int v = 3;  v-- > 0; )
+      {
+         const Vector3r& vertex = *vertexs[v];
+         const real p = (axis[0] * vertex[0]) + (axis[1] * vertex[1]) +
+            (axis[2] * vertex[2]);
+         triangleMin = (p < triangleMin) ? p : triangleMin;
+         triangleMax = (p > triangleMax) ? p : triangleMax;
+      }
+
+      // the projections of each half of the cell, along each cell axis
+      real halfMins[3][2];
+      real halfMaxs[3][2];
+      for( int k = 3;  k-- > 0; )
+      {
+         const real pl = axis[k] * lower[k];
+         const real pm = axis[k] * middle[k];
+         const real pu = axis[k] * upper[k];
+         halfMins[k][0] = (pl < pm) ? pl : pm;
+         halfMaxs[k][0] = (pl < pm) ? pm : pl;
+         halfMins[k][1] = (pm < pu) ? pm : pu;
+         halfMaxs[k][1] = (pm < pu) ? pu : pm;
+      }
+
+      // each subcell's projection is the sum of its halfs'
+      for( dword i = 0;  i < 8;  ++i )
+      {
+         const real cellMin = halfMins[0][i & 1] + halfMins[1][(i >> 1) & 1] +
+            halfMins[2][(i >> 2) & 1];
+         const real cellMax = halfMaxs[0][i & 1] + halfMaxs[1][(i >> 1) & 1] +
+            halfMaxs[2][(i >> 2) & 1];
+         flags &= ~(static_cast<dword>((cellMin > triangleMax) |
+            (cellMax < triangleMin)) << i);
+      }
+   }
+
+   return flags;
+}
+
+
+#ifdef OCTREE_SSE
+
+dword OctreeShape::getSubcellOverlapsTriangleSse
+(
+   const Vector3r& vertex0,
+   const Vector3r& vertex1,
+   const Vector3r& vertex2,
+   const Vector3r& lower,
+   const Vector3r& middle,
+   const Vector3r& upper
+)
+{
+   const Vector3r* vertexs[] = { &vertex0, &vertex1, &vertex2 };
+
+   // the cell's face normals: the triangle's bound against the halfs, along
+   // all cell axes at once
+   dword flags = 0xFF;
+   {
+      const __m128 v0       = getSse( vertex0 );
+      const __m128 v1       = getSse( vertex1 );
+      const __m128 v2       = getSse( vertex2 );
+      const __m128 boundMin = _mm_min_ps( _mm_min_ps( v0, v1 ), v2 );
+      const __m128 boundMax = _mm_max_ps( _mm_max_ps( v0, v1 ), v2 );
+      const __m128 l        = getSse( lower );
+      const __m128 m        = getSse( middle );
+      const __m128 u        = getSse( upper );
+      flags &= getHalfsSubcells(
+         _mm_movemask_ps( _mm_and_ps( _mm_cmple_ps( boundMin, m ),
+            _mm_cmpge_ps( boundMax, l ) ) ),
+         _mm_movemask_ps( _mm_and_ps( _mm_cmple_ps( boundMin, u ),
+            _mm_cmpge_ps( boundMax, m ) ) ) );
+   }
+
+   // the other axes (as the scalar kernel), by component, four to a register
+   // (the last two zero: they separate nothing)
+   real axes[3][12];
+   real edges[3][3];
+   for( int k = 3;  k-- > 0; )
+   {
+      edges[0][k] = vertex1[k] - vertex0[k];
+      edges[1][k] = vertex2[k] - vertex1[k];
+      edges[2][k] = vertex0[k] - vertex2[k];
+      axes[k][10] = 0.0f;
+      axes[k][11] = 0.0f;
+   }
+   for( int k = 3;  k-- > 0; )
+   {
+      axes[k][0] = (edges[0][(k + 1) % 3] * edges[1][(k + 2) % 3]) -
+                   (edges[0][(k + 2) % 3] * edges[1][(k + 1) % 3]);
+   }
+   for( int e = 3;  e-- > 0; )
+   {
+      for( int k = 3;  k-- > 0; )
+      {
+         const int a = 1 + (e * 3) + k;
+         axes[k][a]           = 0.0f;
+         axes[(k + 1) % 3][a] = -edges[e][(k + 2) % 3];
+         axes[(k + 2) % 3][a] =  edges[e][(k + 1) % 3];
+      }
+   }
+
+   // clear the subcells separated from the triangle along any of four axes
+   for( int a = 0;  (a < 12) & (0 != flags);  a += 4 )
+   {
+      const __m128 axis[3] = { _mm_loadu_ps( axes[0] + a ),
+         _mm_loadu_ps( axes[1] + a ), _mm_loadu_ps( axes[2] + a ) };
+
+      // the triangle's projections
+      __m128 triangleMin = _mm_set1_ps( REAL_MAX );
+      __m128 triangleMax = _mm_set1_ps( -REAL_MAX );
+      for( int v = 3;  v-- > 0; )
+      {
+         const Vector3r& vertex = *vertexs[v];
+         const __m128 p = _mm_add_ps( _mm_add_ps(
+            _mm_mul_ps( axis[0], _mm_set1_ps( vertex[0] ) ),
+            _mm_mul_ps( axis[1], _mm_set1_ps( vertex[1] ) ) ),
+            _mm_mul_ps( axis[2], _mm_set1_ps( vertex[2] ) ) );
+         triangleMin = _mm_min_ps( p, triangleMin );
+         triangleMax = _mm_max_ps( p, triangleMax );
+      }
+
+      // the projections of each half of the cell, along each cell axis
+      __m128 halfMins[3][2];
+      __m128 halfMaxs[3][2];
+      for( int k = 3;  k-- > 0; )
+      {
+         const __m128 pl = _mm_mul_ps( axis[k], _mm_set1_ps( lower[k] ) );
+         const __m128 pm = _mm_mul_ps( axis[k], _mm_set1_ps( middle[k] ) );
+         const __m128 pu = _mm_mul_ps( axis[k], _mm_set1_ps( upper[k] ) );
+         halfMins[k][0] = _mm_min_ps( pl, pm );
+         halfMaxs[k][0] = _mm_max_ps( pm, pl );
+         halfMins[k][1] = _mm_min_ps( pm, pu );
+         halfMaxs[k][1] = _mm_max_ps( pu, pm );
+      }
+
+      // each subcell's projection is the sum of its halfs'
+      for( dword i = 0;  i < 8;  ++i )
+      {
+         const __m128 cellMin = _mm_add_ps( _mm_add_ps( halfMins[0][i & 1],
+            halfMins[1][(i >> 1) & 1] ), halfMins[2][(i >> 2) & 1] );
+         const __m128 cellMax = _mm_add_ps( _mm_add_ps( halfMaxs[0][i & 1],
+            halfMaxs[1][(i >> 1) & 1] ), halfMaxs[2][(i >> 2) & 1] );
+         flags &= ~(static_cast<dword>(0 != _mm_movemask_ps( _mm_or_ps(
+            _mm_cmpgt_ps( cellMin, triangleMax ),
+            _mm_cmplt_ps( cellMax, triangleMin ) ) )) << i);
+      }
+   }
+
+   return flags;
+}
+
+#endif
+
+
+real OctreeShape::getDistancePoint
+(
+   const Vector3r& point,
+   const Vector3r& from
+)
+{
+   return (point - from).length();
+}
+
+
+real OctreeShape::getDistanceBox
+(
+   const Vector3r& itemLowerCorner,
+   const Vector3r& itemUpperCorner,
+   const Vector3r& from
+)
+{
+   // sum the squared distances outside the range, along each axis
+   real distance2 = 0.0f;
+   for( int i = 3;  i-- > 0; )
+   {
+      distance2 += getAxisDistance2( from[i], itemLowerCorner[i],
+         itemUpperCorner[i] );
+   }
+
+   return sqrt( distance2 );
+}
+
+
+real OctreeShape::getDistanceSphere
+(
+   const Vector3r& center,
+   const real      radius,
+   const Vector3r& from
+)
+{
+   const real distance = (center - from).length() - radius;
+
+   return (distance > 0.0f) ? distance : 0.0f;
+}
+
+
+real OctreeShape::getDistanceTriangle
+(
+   const Vector3r& vertex0,
+   const Vector3r& vertex1,
+   const Vector3r& vertex2,
+   const Vector3r& from
+)
+{
+   // find the closest point, by which vertex, edge, or face region of the
+   // triangle the point projects into (as Ericson, Real-Time Collision
+   // Detection, 5.1.5)
+   const Vector3r edge01( vertex1 - vertex0 );
+   const Vector3r edge02( vertex2 - vertex0 );
+   const real d1 = edge01.dot( from - vertex0 );
+   const real d2 = edge02.dot( from - vertex0 );
+   const real d3 = edge01.dot( from - vertex1 );
+   const real d4 = edge02.dot( from - vertex1 );
+   const real d5 = edge01.dot( from - vertex2 );
+   const real d6 = edge02.dot( from - vertex2 );
+   const real va = (d3 * d6) - (d5 * d4);
+   const real vb = (d5 * d2) - (d1 * d6);
+   const real vc = (d1 * d4) - (d3 * d2);
+
+   Vector3r closest( vertex0 );
+   if( (d1 <= 0.0f) & (d2 <= 0.0f) )
+   {
+      closest = vertex0;
+   }
+   else if( (d3 >= 0.0f) & (d4 <= d3) )
+   {
+      closest = vertex1;
+   }
+   else if( (vc <= 0.0f) & (d1 >= 0.0f) & (d3 <= 0.0f) )
+   {
+      closest = vertex0 + (edge01 * (d1 / (d1 - d3)));
+   }
+   else if( (d6 >= 0.0f) & (d5 <= d6) )
+   {
+      closest = vertex2;
+   }
+   else if( (vb <= 0.0f) & (d2 >= 0.0f) & (d6 <= 0.0f) )
+   {
+      closest = vertex0 + (edge02 * (d2 / (d2 - d6)));
+   }
+   else if( (va <= 0.0f) & ((d4 - d3) >= 0.0f) & ((d5 - d6) >= 0.0f) )
+   {
+      closest = vertex1 + ((vertex2 - vertex1) * ((d4 - d3) /
+         ((d4 - d3) + (d5 - d6))));
+   }
+   else if( 0.0f != (va + vb + vc) )
+   {
+      const real denominator = 1.0f / (va + vb + vc);
+      closest = vertex0 + (edge01 * (vb * denominator)) +
+         (edge02 * (vc * denominator));
+   }
+
+   return (from - closest).length();
+}
+
+
+real OctreeShape::getRayIntersectionBox
+(
+   const Vector3r& itemLowerCorner,
+   const Vector3r& itemUpperCorner,
+   const Vector3r& rayOrigin,
+   const Vector3r& rayDirection
+)
+{
+   // narrow the ray's span by the slab along each axis
+   real tEnter = 0.0f;
+   real tExit  = REAL_MAX;
+   for( int i = 3;  i-- > 0; )
+   {
+      const real d = rayDirection[i];
+      if( 0.0f != d )
+      {
+         const real t0    = (itemLowerCorner[i] - rayOrigin[i]) / d;
+         const real t1    = (itemUpperCorner[i] - rayOrigin[i]) / d;
+         const real tNear = (t0 < t1) ? t0 : t1;
+         const real tFar  = (t0 < t1) ? t1 : t0;
+         tEnter = (tNear > tEnter) ? tNear : tEnter;
+         tExit  = (tFar  < tExit)  ? tFar  : tExit;
+      }
+      else if( (rayOrigin[i] < itemLowerCorner[i]) |
+         (rayOrigin[i] > itemUpperCorner[i]) )
+      {
+         // parallel, and outside the slab
+         tExit = -1.0f;
+      }
+   }
+
+   return (tEnter <= tExit) ? tEnter : REAL_MAX;
+}
+
+
+real OctreeShape::getRayIntersectionSphere
+(
+   const Vector3r& center,
+   const real      radius,
+   const Vector3r& rayOrigin,
+   const Vector3r& rayDirection
+)
+{
+   real t = REAL_MAX;
+
+   // solve |rayOrigin + (rayDirection * t) - center| = radius, for least t
+   const Vector3r offset( rayOrigin - center );
+   real a = 0.0f;
+   real b = 0.0f;
+   real c = -(radius * radius);
+   for( int i = 3;  i-- > 0; )
+   {
+      a += rayDirection[i] * rayDirection[i];
+      b += rayDirection[i] * offset[i];
+      c += offset[i] * offset[i];
+   }
+   const real discriminant = (b * b) - (a * c);
+
+   if( c <= 0.0f )
+   {
+      // origin is inside
+      t = 0.0f;
+   }
+   else if( (a > 0.0f) & (b < 0.0f) & (discriminant >= 0.0f) )
+   {
+      // heading toward, and crossing
+      t = (-b - sqrt( discriminant )) / a;
+   }
+
+   return t;
+}
+
+
+real OctreeShape::getRayIntersectionTriangle
+(
+   const Vector3r& vertex0,
+   const Vector3r& vertex1,
+   const Vector3r& vertex2,
+   const Vector3r& rayOrigin,
+   const Vector3r& rayDirection
+)
+{
+   real t = REAL_MAX;
+
+   // solve for the barycentric coordinates and t (as Moller and Trumbore),
+   // from either side
+   const Vector3r edge01( vertex1 - vertex0 );
+   const Vector3r edge02( vertex2 - vertex0 );
+   const Vector3r p( rayDirection.cross( edge02 ) );
+   const real     determinant = edge01.dot( p );
+
+   if( 0.0f != determinant )
+   {
+      const real     inverse = 1.0f / determinant;
+      const Vector3r s( rayOrigin - vertex0 );
+      const Vector3r q( s.cross( edge01 ) );
+      const real     u = s.dot( p ) * inverse;
+      const real     v = rayDirection.dot( q ) * inverse;
+      const real     tHit = edge02.dot( q ) * inverse;
+
+      if( (u >= 0.0f) & (v >= 0.0f) & ((u + v) <= 1.0f) & (tHit >= 0.0f) )
+      {
+         t = tHit;
+      }
+   }
+
+   return t;
+}
+
+
+
+
 
 
 
@@ -239,11 +1037,41 @@ OctreeBound& OctreeBound::operator=
 /// standard object services ---------------------------------------------------
 OctreeData::OctreeData
 (
-   const OctreeDimensions& dimensions
+   const OctreeDimensions& dimensions,
+   OctreeAllocatorV&       allocator
 )
  : bound_m      ( dimensions.getPosition(), dimensions.getSize() )
  , level_m      ( 0 )
  , pDimensions_m( &dimensions )
+ , pAllocator_m ( &allocator )
+ , pStats_m     ( 0 )
+{
+   OCTREE_COUNT( addData() );
+}
+
+
+OctreeData::OctreeData
+(
+   const OctreeDimensions& dimensions,
+   OctreeAllocatorV&       allocator,
+   OctreeStats&            stats
+)
+ : bound_m      ( dimensions.getPosition(), dimensions.getSize() )
+ , level_m      ( 0 )
+ , pDimensions_m( &dimensions )
+ , pAllocator_m ( &allocator )
+ , pStats_m     ( &stats )
+{
+   OCTREE_COUNT( addData() );
+}
+
+
+OctreeData::OctreeData()
+ : bound_m      ()
+ , level_m      ( 0 )
+ , pDimensions_m( 0 )
+ , pAllocator_m ( 0 )
+ , pStats_m     ( 0 )
 {
 }
 
@@ -256,7 +1084,10 @@ OctreeData::OctreeData
  : bound_m      ( parentCellData.bound_m, subCellIndex )
  , level_m      ( parentCellData.level_m + 1 )
  , pDimensions_m( parentCellData.pDimensions_m )
+ , pAllocator_m ( parentCellData.pAllocator_m )
+ , pStats_m     ( parentCellData.pStats_m )
 {
+   OCTREE_COUNT( addData() );
 }
 
 
@@ -268,10 +1099,55 @@ OctreeData::OctreeData
  : bound_m      ( other.bound_m )
  , level_m      ( other.level_m )
  , pDimensions_m( &dimensions )
+ , pAllocator_m ( other.pAllocator_m )
+ , pStats_m     ( other.pStats_m )
+{
+}
+
+
+OctreeData::OctreeData
+(
+   const OctreeData& other,
+   OctreeAllocatorV& allocator
+)
+ : bound_m      ( other.bound_m )
+ , level_m      ( other.level_m )
+ , pDimensions_m( other.pDimensions_m )
+ , pAllocator_m ( &allocator )
+ , pStats_m     ( other.pStats_m )
 {
 }
 
 
+OctreeData::OctreeData
+(
+   const OctreeData& other,
+   OctreeStats&      stats
+)
+ : bound_m      ( other.bound_m )
+ , level_m      ( other.level_m )
+ , pDimensions_m( other.pDimensions_m )
+ , pAllocator_m ( other.pAllocator_m )
+ , pStats_m     ( &stats )
+{
+}
+
+
+OctreeData::OctreeData
+(
+   const OctreeData&  other,
+   const OctreeBound& bound
+)
+ : bound_m      ( bound )
+ , level_m      ( other.level_m )
+ , pDimensions_m( other.pDimensions_m )
+ , pAllocator_m ( other.pAllocator_m )
+ , pStats_m     ( other.pStats_m )
+{
+   OCTREE_COUNT( addData() );
+}
+
+
 OctreeData::~OctreeData()
 {
 }
@@ -284,6 +1160,8 @@ OctreeData::OctreeData
  : bound_m      ( other.bound_m )
  , level_m      ( other.level_m )
  , pDimensions_m( other.pDimensions_m )
+ , pAllocator_m ( other.pAllocator_m )
+ , pStats_m     ( other.pStats_m )
 {
 }
 
@@ -298,7 +1176,83 @@ OctreeData& OctreeData::operator=
       bound_m       = other.bound_m;
       level_m       = other.level_m;
       pDimensions_m = other.pDimensions_m;
+      pAllocator_m  = other.pAllocator_m;
+      pStats_m      = other.pStats_m;
    }
 
    return *this;
 }
+
+
+
+
+
+
+
+
+/// OctreeAgentV ///////////////////////////////////////////////////////////////
+
+
+/// queries --------------------------------------------------------------------
+real OctreeAgentV::getDistanceV
+(
+   const void*     ,//pItem,
+   const Vector3r& //point
+) const
+{
+   return REAL_MAX;
+}
+
+
+real OctreeAgentV::getRayIntersectionV
+(
+   const void*     ,//pItem,
+   const Vector3r& ,//rayOrigin,
+   const Vector3r& //rayDirection
+) const
+{
+   return REAL_MAX;
+}
+
+
+void OctreeAgentV::getBoundV
+(
+   const void*     ,//pItem,
+   Vector3r&       lowerCorner,
+   Vector3r&       upperCorner
+) const
+{
+   lowerCorner.set( -REAL_MAX, -REAL_MAX, -REAL_MAX );
+   upperCorner.set(  REAL_MAX,  REAL_MAX,  REAL_MAX );
+}
+
+
+bool OctreeAgentV::isCoveringCellV
+(
+   const void*     ,//pItem,
+   const Vector3r& ,//lowerCorner,
+   const Vector3r& //upperCorner
+) const
+{
+   return false;
+}
+
+
+
+
+
+
+
+
+/// OctreeVisitorV /////////////////////////////////////////////////////////////
+
+
+/// commands -------------------------------------------------------------------
+void OctreeVisitorV::visitBranchItemsV
+(
+   const Array<const void*>& items,
+   const OctreeData&         octreeData
+)
+{
+   visitLeafV( items, octreeData );
+}
@@ -44,6 +44,20 @@ OF SUCH DAMAGE.
 #include "Vector3r.hpp"
 
 
+/**
+ * OCTREE_SSE is defined when the compiler targets SSE and real is float
+ * (unless OCTREE_NO_SSE is defined): OctreeShape then uses its SSE kernels.
+ */
+#if !defined(OCTREE_NO_SSE) && defined(REAL_IS_FLOAT) && (defined(__SSE__) || \
+   defined(_M_X64) || (defined(_M_IX86_FP) && (_M_IX86_FP >= 1)))
+#define OCTREE_SSE
+#endif
+
+#ifdef OCTREE_SSE
+#include <xmmintrin.h>
+#endif
+
+
 
 
 namespace hxa7241_graphics
@@ -51,18 +65,32 @@ namespace hxa7241_graphics
    using namespace hxa7241;
    using hxa7241_general::Array;
    class OctreeCell;
+   class OctreeAllocatorV;
+   class OctreeStats;
 
 
 /**
  * Global octree data -- one instance for whole octree.<br/><br/>
  *
- * Constant.
+ * Constant.<br/><br/>
+ *
+ * A cell subdivides when it holds more than maxItemCountPerCell item refs,
+ * and a branch collapses, on removal, when it holds no more than
+ * collapseItemCount. A collapse count below the max is a hysteresis band:
+ * a cell whose count hovers about the max no longer splits and collapses
+ * over and over. By default it is the max.<br/><br/>
+ *
+ * A loose octree (OctreeLooseRoot) holds items in each cell's bound expanded
+ * to looseness times its size, about the same center. By default it is 2
+ * (half the size added on each side).
  *
  * @invariants
  * size_m >= 0<br/>
  * maxItemsPerCell_m >= 1<br/>
+ * collapseItems_m >= 0 and <= maxItemsPerCell_m<br/>
  * maxLevel_m >= 0 and <= MAX_LEVEL<br/>
  * minSize_m >= MIN_SIZE and <= size_m<br/>
+ * looseness_m >= 1<br/>
  */
 class OctreeDimensions
 {
@@ -72,7 +100,9 @@ public:
                               real            size,
                               dword           maxItemCountPerCell,
                               dword           maxLevelCount,
-                              real            minCellSize );
+                              real            minCellSize,
+                              dword           collapseItemCount = DWORD_MAX,
+                              real            looseness = 2.0f );
 
            ~OctreeDimensions();
             OctreeDimensions( const OctreeDimensions& );
@@ -85,10 +115,13 @@ public:
            dword           getMaxItemCountPerCell()                       const;
            dword           getMaxLevelCount()                             const;
            real            getMinCellSize()                               const;
+           dword           getCollapseItemCount()                         const;
+           real            getLooseness()                                 const;
 
            bool            isSubdivide( dword itemCount,
                                         dword level,
                                         real  size )                      const;
+           bool            isCollapse( dword itemRefCount )               const;
 
 
 /// fields ---------------------------------------------------------------------
@@ -98,6 +131,8 @@ private:
    dword    maxItemsPerCell_m;
    dword    maxLevel_m;
    real     minSize_m;
+   dword    collapseItems_m;
+   real     looseness_m;
 
    static const dword MAX_LEVEL;
    static const real  MIN_SIZE;
@@ -106,6 +141,226 @@ private:
 
 
 
+/**
+ * Counts of the cells and items of an octree -- kept up to date by the tree's
+ * commands, so reading them is O(1).<br/><br/>
+ *
+ * Cells are counted by level (the root is level 0), and leafs by fill too:
+ * fill bucket b counts leafs holding 2^b to 2^(b+1) - 1 items. The byte size
+ * is of the cells (with their item storage). The item count is of the items
+ * inserted less those removed: so of distinct items, while none is inserted
+ * again while held (which the commands do not check). After a storage
+ * exception it may be off; the rest never is.<br/><br/>
+ *
+ * Counts are added to, so the changes made by a part of a command (on
+ * another thread) can be kept apart, as signed counts, and added into the
+ * whole after.<br/><br/>
+ *
+ * Item refs held at branches (by OctreeLooseRoot, or by OctreeRoot for items
+ * covering them) count in the item refs and byte size, but in no leaf's fill.
+ *
+ * @invariants
+ * levels are 0 to LEVEL_COUNT - 1 (OctreeDimensions clamps to that)<br/>
+ * branchCount_m and leafCount_m are the sums of their counts by level, and
+ * leafCount_m is the sum of the fill counts too<br/>
+ */
+class OctreeStats
+{
+/// standard object services ---------------------------------------------------
+public:
+            OctreeStats();
+
+           ~OctreeStats();
+            OctreeStats( const OctreeStats& );
+   OctreeStats& operator=( const OctreeStats& );
+
+
+/// commands -------------------------------------------------------------------
+           void  addBranch   ( dword level,
+                               dword byteSize );
+           void  removeBranch( dword level,
+                               dword byteSize );
+           void  addLeaf     ( dword level,
+                               dword itemRefCount,
+                               dword byteSize );
+           void  removeLeaf  ( dword level,
+                               dword itemRefCount,
+                               dword byteSize );
+           void  addItems    ( dword itemCount );
+           void  addBranchItems   ( dword itemRefCount,
+                                    dword byteSize );
+           void  removeBranchItems( dword itemRefCount,
+                                    dword byteSize );
+
+           void  add( const OctreeStats& part );
+
+
+/// queries --------------------------------------------------------------------
+           dword getItemCount()                                           const;
+           dword getItemRefCount()                                        const;
+           real  getRefsPerItem()                                         const;
+           dword getByteSize()                                            const;
+           dword getMaxDepth()                                            const;
+
+           dword getBranchCount()                                         const;
+           dword getLeafCount()                                           const;
+           dword getBranchCount( dword level )                            const;
+           dword getLeafCount  ( dword level )                            const;
+           dword getFillCount  ( dword bucket )                           const;
+
+
+/// constants ------------------------------------------------------------------
+   static const dword LEVEL_COUNT       = 45;
+   static const dword FILL_BUCKET_COUNT = 32;
+
+
+/// implementation -------------------------------------------------------------
+protected:
+           void  countLeaf( dword level,
+                            dword itemRefCount,
+                            dword byteSize,
+                            dword sign );
+
+
+/// fields ---------------------------------------------------------------------
+private:
+   dword itemCount_m;
+   dword itemRefCount_m;
+   dword byteSize_m;
+   dword branchCount_m;
+   dword leafCount_m;
+   dword branchCounts_m[ LEVEL_COUNT ];
+   dword leafCounts_m  [ LEVEL_COUNT ];
+   dword fillCounts_m  [ FILL_BUCKET_COUNT ];
+};
+
+
+
+
+/**
+ * Counts of the work of one call of an octree command or query: cells
+ * entered (by level), OctreeData made, overlap tests (agent and query calls)
+ * and how many ended a descent (early exits), and leaf items scanned.
+ * <br/><br/>
+ *
+ * Only counted when OCTREE_INSTRUMENTED is defined: then the OCTREE_COUNT
+ * points in the traversals add to the current call's counts, else they
+ * compile to nothing.
+ *
+ * @see OctreeCallCounted
+ */
+class OctreeCallCounts
+{
+/// standard object services ---------------------------------------------------
+public:
+            OctreeCallCounts();
+
+           ~OctreeCallCounts();
+            OctreeCallCounts( const OctreeCallCounts& );
+   OctreeCallCounts& operator=( const OctreeCallCounts& );
+
+
+/// commands -------------------------------------------------------------------
+           void  addCell     ( dword level );
+           void  addData     ();
+           void  addTests    ( dword testCount );
+           void  addTest     ( bool isPassed );
+           void  addItemScans( dword itemCount );
+
+           void  add( const OctreeCallCounts& part );
+
+
+/// queries --------------------------------------------------------------------
+           dword getCellCount()                                           const;
+           dword getCellCount( dword level )                              const;
+           dword getDataCount()                                           const;
+           dword getTestCount()                                           const;
+           dword getExitCount()                                           const;
+           dword getItemScanCount()                                       const;
+
+
+/// fields ---------------------------------------------------------------------
+private:
+   dword cellCount_m;
+   dword cellCounts_m[ OctreeStats::LEVEL_COUNT ];
+   dword dataCount_m;
+   dword testCount_m;
+   dword exitCount_m;
+   dword itemScanCount_m;
+};
+
+
+
+
+/**
+ * Counts of the counted calls of an octree's commands and queries, by
+ * operation: how many, the sums of their OctreeCallCounts, a histogram of
+ * their latencies, and the counts of the slowest.<br/><br/>
+ *
+ * Latency bucket b counts calls taking 2^b to 2^(b+1) - 1 nanoseconds (the
+ * last bucket also any longer).
+ *
+ * @see OctreeCallCounted
+ */
+class OctreeCounts
+{
+/// standard object services ---------------------------------------------------
+public:
+            OctreeCounts();
+
+           ~OctreeCounts();
+            OctreeCounts( const OctreeCounts& );
+   OctreeCounts& operator=( const OctreeCounts& );
+
+
+/// constants ------------------------------------------------------------------
+   enum EOperation
+   {
+      VISIT, QUERY, INSERT, INSERT_RANGE, REMOVE, OPERATION_COUNT
+   };
+
+   static const dword LATENCY_BUCKET_COUNT = 32;
+
+
+/// commands -------------------------------------------------------------------
+           void  addCall( EOperation              operation,
+                          const OctreeCallCounts& callCounts,
+                          dword                   nanoseconds );
+
+
+/// queries --------------------------------------------------------------------
+           dword getCallCount( EOperation operation )                     const;
+           const OctreeCallCounts& getCounts( EOperation operation )      const;
+           dword getLatencyCount( EOperation operation,
+                                  dword      bucket )                     const;
+
+           dword getSlowestLatency( EOperation operation )                const;
+           const OctreeCallCounts& getSlowestCounts( EOperation operation )
+                                                                          const;
+
+
+/// implementation -------------------------------------------------------------
+protected:
+   struct Operation
+   {
+      Operation();
+
+      dword            callCount;
+      OctreeCallCounts counts;
+      dword            latencyCounts[ LATENCY_BUCKET_COUNT ];
+      dword            slowestLatency;
+      OctreeCallCounts slowestCounts;
+   };
+
+
+/// fields ---------------------------------------------------------------------
+private:
+   Operation operations_m[ OPERATION_COUNT ];
+};
+
+
+
+
 /**
  * Geometric data for the bound of an octree cell.<br/><br/>
  *
@@ -113,6 +368,10 @@ private:
  *
  * Radius is that of the circumsphere.<br/><br/>
  *
+ * isOverlapping is true if this and the box share some volume (not just a
+ * face), isInside if this is wholly within the box. getDistance is from the
+ * point to the nearest point of this (0 if inside).<br/><br/>
+ *
  * Subcell numbering:
  * <pre>
  *    y z       6 7
@@ -148,6 +407,12 @@ public:
            real            getRadius()                                    const;
            real            getSize()                                      const;
 
+           bool            isOverlapping( const Vector3r& lowerCorner,
+                                          const Vector3r& upperCorner )   const;
+           bool            isInside     ( const Vector3r& lowerCorner,
+                                          const Vector3r& upperCorner )   const;
+           real            getDistance  ( const Vector3r& point )         const;
+
 
 /// fields ---------------------------------------------------------------------
 private:
@@ -160,6 +425,201 @@ private:
 
 
 
+/**
+ * Tests of simple item shapes against cells, for agents to use.<br/><br/>
+ *
+ * The shapes are: point, box (axis-aligned, by lower and upper corners),
+ * sphere, and triangle. A box overlaps a cell if they share some volume (as
+ * OctreeBound::isOverlapping), a point, sphere, or triangle if it touches it at
+ * all (so a point on a face is in both cells).<br/><br/>
+ *
+ * The getSubcellOverlaps functions find all 8 subcells at once, with the same
+ * result as isOverlapping on each. The isCovering functions tell if the shape
+ * holds the whole cell (its faces too): a point or triangle never does, so
+ * has none. The getDistance and getRayIntersection
+ * functions are as OctreeAgent::getDistance and getRayIntersection.<br/><br/>
+ *
+ * Each getSubcellOverlaps function has a portable kernel, ___Scalar, and
+ * (with OCTREE_SSE) an SSE one, ___Sse, which it then uses. Both give the
+ * same result -- except that, under fast-math, the compiler may regroup
+ * either triangle kernel's sums, so a vertex exactly on a subcell plane can
+ * fall either way. They then differ only on subcells the triangle just
+ * touches: it overlaps the subcell grown by a ten-thousandth of the cell's
+ * size, and not the subcell shrunk by as much.<br/><br/>
+ *
+ * Subcell numbering:
+ * <pre>
+ *    y z       6 7
+ *    |/   2 3  4 5
+ *     -x  0 1
+ * </pre>
+ * in binary:
+ * <pre>
+ *    y z           110 111
+ *    |/   010 011  100 101
+ *     -x  000 001
+ * </pre>
+ *
+ * @implementation
+ * Subcell overlaps are branch-free: each axis gives a mask of the subcells on
+ * the halfs of it the shape reaches, and the three masks are ANDed. (For a
+ * sphere, the per-axis squared distances to each half are summed for each
+ * subcell instead.) The SSE kernels test the three axes in one register,
+ * and sum a sphere's distances for four subcells in one.<br/><br/>
+ *
+ * A triangle is tested by separating axes: the cell's 3 face normals, the
+ * triangle's normal, and the 9 cross-products of their edges. The face
+ * normals are just the triangle's bound, so they take the per-axis masks
+ * first. For the rest, the axes and the triangle's projections are shared by
+ * all 8 subcells, and each subcell's projection is summed from its halfs'
+ * along each cell axis -- so the per-subcell work is a few adds and compares.
+ * The SSE kernel holds four axes to a register, so each subcell is tested
+ * against four axes at once. isOverlappingTriangle uses the same kernel as
+ * getSubcellOverlapsTriangle, so the two always agree.
+ */
+class OctreeShape
+{
+/// statics --------------------------------------------------------------------
+public:
+   static bool  isOverlappingPoint( const Vector3r& point,
+                                    const Vector3r& lowerCorner,
+                                    const Vector3r& upperCorner );
+   static bool  isOverlappingBox  ( const Vector3r& itemLowerCorner,
+                                    const Vector3r& itemUpperCorner,
+                                    const Vector3r& lowerCorner,
+                                    const Vector3r& upperCorner );
+   static bool  isOverlappingSphere( const Vector3r& center,
+                                     real            radius,
+                                     const Vector3r& lowerCorner,
+                                     const Vector3r& upperCorner );
+
+   static dword getSubcellOverlapsPoint( const Vector3r& point,
+                                         const Vector3r& lower,
+                                         const Vector3r& middle,
+                                         const Vector3r& upper );
+   static dword getSubcellOverlapsBox  ( const Vector3r& itemLowerCorner,
+                                         const Vector3r& itemUpperCorner,
+                                         const Vector3r& lower,
+                                         const Vector3r& middle,
+                                         const Vector3r& upper );
+   static dword getSubcellOverlapsSphere( const Vector3r& center,
+                                          real            radius,
+                                          const Vector3r& lower,
+                                          const Vector3r& middle,
+                                          const Vector3r& upper );
+
+   static dword getSubcellOverlapsPointScalar( const Vector3r& point,
+                                               const Vector3r& lower,
+                                               const Vector3r& middle,
+                                               const Vector3r& upper );
+   static dword getSubcellOverlapsBoxScalar  ( const Vector3r& itemLowerCorner,
+                                               const Vector3r& itemUpperCorner,
+                                               const Vector3r& lower,
+                                               const Vector3r& middle,
+                                               const Vector3r& upper );
+   static dword getSubcellOverlapsSphereScalar( const Vector3r& center,
+                                                real            radius,
+                                                const Vector3r& lower,
+                                                const Vector3r& middle,
+                                                const Vector3r& upper );
+#ifdef OCTREE_SSE
+   static dword getSubcellOverlapsPointSse( const Vector3r& point,
+                                            const Vector3r& lower,
+                                            const Vector3r& middle,
+                                            const Vector3r& upper );
+   static dword getSubcellOverlapsBoxSse  ( const Vector3r& itemLowerCorner,
+                                            const Vector3r& itemUpperCorner,
+                                            const Vector3r& lower,
+                                            const Vector3r& middle,
+                                            const Vector3r& upper );
+   static dword getSubcellOverlapsSphereSse( const Vector3r& center,
+                                             real            radius,
+                                             const Vector3r& lower,
+                                             const Vector3r& middle,
+                                             const Vector3r& upper );
+#endif
+
+   static bool  isCoveringBox   ( const Vector3r& itemLowerCorner,
+                                  const Vector3r& itemUpperCorner,
+                                  const Vector3r& lowerCorner,
+                                  const Vector3r& upperCorner );
+   static bool  isCoveringSphere( const Vector3r& center,
+                                  real            radius,
+                                  const Vector3r& lowerCorner,
+                                  const Vector3r& upperCorner );
+
+   static bool  isOverlappingTriangle( const Vector3r& vertex0,
+                                       const Vector3r& vertex1,
+                                       const Vector3r& vertex2,
+                                       const Vector3r& lowerCorner,
+                                       const Vector3r& upperCorner );
+   static dword getSubcellOverlapsTriangle( const Vector3r& vertex0,
+                                            const Vector3r& vertex1,
+                                            const Vector3r& vertex2,
+                                            const Vector3r& lower,
+                                            const Vector3r& middle,
+                                            const Vector3r& upper );
+   static dword getSubcellOverlapsTriangleScalar( const Vector3r& vertex0,
+                                                  const Vector3r& vertex1,
+                                                  const Vector3r& vertex2,
+                                                  const Vector3r& lower,
+                                                  const Vector3r& middle,
+                                                  const Vector3r& upper );
+#ifdef OCTREE_SSE
+   static dword getSubcellOverlapsTriangleSse( const Vector3r& vertex0,
+                                               const Vector3r& vertex1,
+                                               const Vector3r& vertex2,
+                                               const Vector3r& lower,
+                                               const Vector3r& middle,
+                                               const Vector3r& upper );
+#endif
+
+   static real  getDistancePoint( const Vector3r& point,
+                                  const Vector3r& from );
+   static real  getDistanceBox  ( const Vector3r& itemLowerCorner,
+                                  const Vector3r& itemUpperCorner,
+                                  const Vector3r& from );
+   static real  getDistanceSphere( const Vector3r& center,
+                                   real            radius,
+                                   const Vector3r& from );
+   static real  getDistanceTriangle( const Vector3r& vertex0,
+                                     const Vector3r& vertex1,
+                                     const Vector3r& vertex2,
+                                     const Vector3r& from );
+
+   static real  getRayIntersectionBox   ( const Vector3r& itemLowerCorner,
+                                          const Vector3r& itemUpperCorner,
+                                          const Vector3r& rayOrigin,
+                                          const Vector3r& rayDirection );
+   static real  getRayIntersectionSphere( const Vector3r& center,
+                                          real            radius,
+                                          const Vector3r& rayOrigin,
+                                          const Vector3r& rayDirection );
+   static real  getRayIntersectionTriangle( const Vector3r& vertex0,
+                                            const Vector3r& vertex1,
+                                            const Vector3r& vertex2,
+                                            const Vector3r& rayOrigin,
+                                            const Vector3r& rayDirection );
+
+
+/// implementation -------------------------------------------------------------
+protected:
+   static dword getAxisSubcells( int  axis,
+                                 bool isInLowerHalf,
+                                 bool isInUpperHalf );
+   static real  getAxisDistance2( real position,
+                                 real lower,
+                                 real upper );
+#ifdef OCTREE_SSE
+   static dword getHalfsSubcells( dword lowerHalfs,
+                                  dword upperHalfs );
+   static __m128 getSse( const Vector3r& );
+#endif
+};
+
+
+
+
 /**
  * Octree cell data during traversal.<br/><br/>
  *
@@ -168,6 +628,15 @@ private:
  * To be made during each level of tree descent, so storage is avoided, except
  * to hold one at the root.<br/><br/>
  *
+ * The default constructor is only for storage in arrays: its dimensions and
+ * allocator are null until assigned.<br/><br/>
+ *
+ * The stats are null unless given: only the commands use them, to count the
+ * cells they make and delete.<br/><br/>
+ *
+ * The bound can be replaced (keeping the level): OctreeLooseRoot gives its
+ * cells' expanded bounds that way.<br/><br/>
+ *
  * Subcell numbering:
  * <pre>
  *    y z       6 7
@@ -183,16 +652,28 @@ private:
  *
  * @see OctreeBound
  * @see OctreeDimensions
+ * @see OctreeAllocatorV
  */
 class OctreeData
 {
 /// standard object services ---------------------------------------------------
 public:
-   explicit OctreeData( const OctreeDimensions& dimensions );
+            OctreeData( const OctreeDimensions& dimensions,
+                        OctreeAllocatorV&       allocator );
+            OctreeData( const OctreeDimensions& dimensions,
+                        OctreeAllocatorV&       allocator,
+                        OctreeStats&            stats );
+            OctreeData();
             OctreeData( const OctreeData& parentCellData,
                         dword             subCellIndex );
             OctreeData( const OctreeData&,
                         const OctreeDimensions& );
+            OctreeData( const OctreeData&,
+                        OctreeAllocatorV& );
+            OctreeData( const OctreeData&,
+                        OctreeStats& );
+            OctreeData( const OctreeData&,
+                        const OctreeBound& );
 
            ~OctreeData();
             OctreeData( const OctreeData& );
@@ -203,6 +684,8 @@ public:
            const OctreeBound&      getBound()                             const;
            dword                   getLevel()                             const;
            const OctreeDimensions& getDimensions()                        const;
+           OctreeAllocatorV&       getAllocator()                         const;
+           OctreeStats&            getStats()                             const;
 
            bool  isSubdivide( dword itemCount )                           const;
 
@@ -215,6 +698,8 @@ private:
 
    // global for octree
    const OctreeDimensions* pDimensions_m;
+   OctreeAllocatorV*       pAllocator_m;
+   OctreeStats*            pStats_m;
 };
 
 
@@ -231,6 +716,17 @@ private:
  * corresponding to a subcell, the high bit for subcell 7, the low bit for
  * subcell 0.<br/><br/>
  *
+ * getDistanceV is only needed for nearest queries, and getRayIntersectionV for
+ * ray queries: by default every item is REAL_MAX away.<br/><br/>
+ *
+ * getBoundV is only needed by OctreeLooseRoot: it gives the item's
+ * axis-aligned bounding box. By default it is unbounded (so the item is held
+ * at the root).<br/><br/>
+ *
+ * isCoveringCellV tells if the item holds the whole cell: then OctreeRoot
+ * keeps it once, on the branch, instead of in every leaf below. By default
+ * none does.<br/><br/>
+ *
  * Subcell numbering:
  * <pre>
  *    y z       6 7
@@ -269,6 +765,17 @@ public:
                                       const Vector3r& lower,
                                       const Vector3r& middle,
                                       const Vector3r& upper )          const =0;
+   virtual real  getDistanceV       ( const void*     pItem,
+                                      const Vector3r& point )             const;
+   virtual real  getRayIntersectionV( const void*     pItem,
+                                      const Vector3r& rayOrigin,
+                                      const Vector3r& rayDirection )      const;
+   virtual void  getBoundV          ( const void*     pItem,
+                                      Vector3r&       lowerCorner,
+                                      Vector3r&       upperCorner )       const;
+   virtual bool  isCoveringCellV    ( const void*     pItem,
+                                      const Vector3r& lowerCorner,
+                                      const Vector3r& upperCorner )       const;
 
 
 /// constants ------------------------------------------------------------------
@@ -279,9 +786,60 @@ public:
 
 
 
+/**
+ * Cell storage abstract base, for Octree implementation use.<br/><br/>
+ *
+ * Supplies raw storage for branch and leaf cells, and for OctreeLooseRoot's
+ * nodes, which are constructed in it and destructed before it is
+ * freed.<br/><br/>
+ *
+ * If isFreeingAll is true, freeAll releases every cell (and node) still
+ * allocated (destructing any that need it), so a whole tree can be disposed
+ * of without visiting its cells.
+ *
+ * @see OctreeCell
+ * @see OctreeBranch
+ * @see OctreeLeaf
+ * @see OctreeLooseRoot
+ */
+class OctreeAllocatorV
+{
+/// standard object services ---------------------------------------------------
+protected:
+            OctreeAllocatorV() {}
+public:
+   virtual ~OctreeAllocatorV() {}
+private:
+            OctreeAllocatorV( const OctreeAllocatorV& );
+   OctreeAllocatorV& operator=( const OctreeAllocatorV& );
+public:
+
+
+/// commands -------------------------------------------------------------------
+   virtual void* allocateBranch()                                            =0;
+   virtual void  freeBranch( void* pBranch )                                 =0;
+   virtual void* allocateLeaf()                                              =0;
+   virtual void  freeLeaf( void* pLeaf )                                     =0;
+   virtual void* allocateLooseNode()                                         =0;
+   virtual void  freeLooseNode( void* pNode )                                =0;
+
+   virtual void  freeAll()                                                   =0;
+
+
+/// queries --------------------------------------------------------------------
+   virtual bool  isFreeingAll()                                        const =0;
+};
+
+
+
+
 /**
  * Visitor abstract base, for Octree implementation use.<br/><br/>
  *
+ * visitBranchItemsV is given the items held at a branch itself (by
+ * OctreeLooseRoot, or by OctreeRoot for items covering the branch), before
+ * visitBranchV. By default it passes them to visitLeafV.<br/><br/>
+ *
  * Subcell numbering:
  * <pre>
  *    y z       6 7
@@ -319,6 +877,59 @@ public:
                                const OctreeData& octreeData )                =0;
    virtual void  visitLeafV  ( const Array<const void*>& items,
                                const OctreeData&         octreeData )        =0;
+   virtual void  visitBranchItemsV( const Array<const void*>& items,
+                                    const OctreeData&         octreeData );
+};
+
+
+
+
+/**
+ * Heap of entries ordered by distance, for Octree implementation use.<br/><br/>
+ *
+ * ENTRY has a real distance field. If IS_FARTHEST_TOP, the top is the
+ * farthest entry (to bound a set of nearest candidates), else the nearest (to
+ * order a best-first traversal).<br/><br/>
+ *
+ * @invariants
+ * entries_m is a binary heap: no entry is above its parent (by isAbove).
+ */
+template<class ENTRY, bool IS_FARTHEST_TOP>
+class OctreeHeap
+{
+/// standard object services ---------------------------------------------------
+public:
+            OctreeHeap();
+
+           ~OctreeHeap();
+private:
+            OctreeHeap( const OctreeHeap& );
+   OctreeHeap& operator=( const OctreeHeap& );
+public:
+
+
+/// commands -------------------------------------------------------------------
+           void  push( const ENTRY& entry );                           // throws
+           void  pop();
+           void  reserve( dword capacity );                            // throws
+
+
+/// queries --------------------------------------------------------------------
+           const ENTRY& getTop()                                          const;
+           const ENTRY& operator[]( dword index )                         const;
+           dword        getLength()                                       const;
+           bool         isEmpty()                                         const;
+
+
+/// implementation -------------------------------------------------------------
+protected:
+   static  bool  isAbove( const ENTRY& a,
+                          const ENTRY& b );
+
+
+/// fields ---------------------------------------------------------------------
+private:
+   Array<ENTRY> entries_m;
 };
 
 
@@ -366,78 +977,997 @@ real OctreeDimensions::getMinCellSize() const
 }
 
 
+inline
+dword OctreeDimensions::getCollapseItemCount() const
+{
+   return collapseItems_m;
+}
 
 
-/// OctreeBound ----------------------------------------------------------------
 inline
-const Vector3r& OctreeBound::getLowerCorner() const
+real OctreeDimensions::getLooseness() const
 {
-   return positionOfLowerCorner_m;
+   return looseness_m;
 }
 
 
 inline
-const Vector3r& OctreeBound::getUpperCorner() const
+bool OctreeDimensions::isCollapse
+(
+   const dword itemRefCount
+) const
 {
-   return positionOfUpperCorner_m;
+   return itemRefCount <= collapseItems_m;
 }
 
 
+
+
+/// OctreeStats ----------------------------------------------------------------
 inline
-const Vector3r& OctreeBound::getCenter() const
+void OctreeStats::addBranch
+(
+   const dword level,
+   const dword byteSize
+)
 {
-   return center_m;
+   ++branchCounts_m[level];
+   ++branchCount_m;
+   byteSize_m += byteSize;
 }
 
 
 inline
-real OctreeBound::getRadius() const
+void OctreeStats::removeBranch
+(
+   const dword level,
+   const dword byteSize
+)
 {
-   return circumSphereRadius_m;
+   --branchCounts_m[level];
+   --branchCount_m;
+   byteSize_m -= byteSize;
 }
 
 
 inline
-real OctreeBound::getSize() const
+void OctreeStats::addLeaf
+(
+   const dword level,
+   const dword itemRefCount,
+   const dword byteSize
+)
 {
-   return positionOfUpperCorner_m.getX() - positionOfLowerCorner_m.getX();
+   countLeaf( level, itemRefCount, byteSize, 1 );
 }
 
 
+inline
+void OctreeStats::removeLeaf
+(
+   const dword level,
+   const dword itemRefCount,
+   const dword byteSize
+)
+{
+   countLeaf( level, itemRefCount, byteSize, -1 );
+}
 
 
-/// OctreeData -----------------------------------------------------------------
 inline
-const OctreeBound& OctreeData::getBound() const
+void OctreeStats::addItems
+(
+   const dword itemCount
+)
 {
-   return bound_m;
+   itemCount_m += itemCount;
 }
 
 
 inline
-dword OctreeData::getLevel() const
+void OctreeStats::addBranchItems
+(
+   const dword itemRefCount,
+   const dword byteSize
+)
 {
-   return level_m;
+   itemRefCount_m += itemRefCount;
+   byteSize_m     += byteSize;
 }
 
 
 inline
-const OctreeDimensions& OctreeData::getDimensions() const
+void OctreeStats::removeBranchItems
+(
+   const dword itemRefCount,
+   const dword byteSize
+)
 {
-   return *pDimensions_m;
+   itemRefCount_m -= itemRefCount;
+   byteSize_m     -= byteSize;
 }
 
 
 inline
-bool OctreeData::isSubdivide
+dword OctreeStats::getItemCount() const
+{
+   return itemCount_m;
+}
+
+
+inline
+dword OctreeStats::getItemRefCount() const
+{
+   return itemRefCount_m;
+}
+
+
+inline
+dword OctreeStats::getByteSize() const
+{
+   return byteSize_m;
+}
+
+
+inline
+dword OctreeStats::getBranchCount() const
+{
+   return branchCount_m;
+}
+
+
+inline
+dword OctreeStats::getLeafCount() const
+{
+   return leafCount_m;
+}
+
+
+inline
+dword OctreeStats::getBranchCount
 (
-   const dword itemCount
+   const dword level
+) const
+{
+   return branchCounts_m[level];
+}
+
+
+inline
+dword OctreeStats::getLeafCount
+(
+   const dword level
+) const
+{
+   return leafCounts_m[level];
+}
+
+
+inline
+dword OctreeStats::getFillCount
+(
+   const dword bucket
+) const
+{
+   return fillCounts_m[bucket];
+}
+
+
+inline
+void OctreeStats::countLeaf
+(
+   const dword level,
+   const dword itemRefCount,
+   const dword byteSize,
+   const dword sign
+)
+{
+   // fill bucket is the item count's highest bit
+   dword bucket = 0;
+   for( udword count = itemRefCount;  count > 1;  count >>= 1 )
+   {
+      ++bucket;
+   }
+
+   leafCounts_m[level] += sign;
+   fillCounts_m[bucket] += sign;
+   leafCount_m         += sign;
+   itemRefCount_m      += sign * itemRefCount;
+   byteSize_m          += sign * byteSize;
+}
+
+
+
+
+/// OctreeCallCounts -----------------------------------------------------------
+inline
+void OctreeCallCounts::addCell
+(
+   const dword level
+)
+{
+   ++cellCounts_m[level];
+   ++cellCount_m;
+}
+
+
+inline
+void OctreeCallCounts::addData()
+{
+   ++dataCount_m;
+}
+
+
+inline
+void OctreeCallCounts::addTests
+(
+   const dword testCount
+)
+{
+   testCount_m += testCount;
+}
+
+
+inline
+void OctreeCallCounts::addTest
+(
+   const bool isPassed
+)
+{
+   ++testCount_m;
+   exitCount_m += isPassed ? 0 : 1;
+}
+
+
+inline
+void OctreeCallCounts::addItemScans
+(
+   const dword itemCount
+)
+{
+   itemScanCount_m += itemCount;
+}
+
+
+inline
+dword OctreeCallCounts::getCellCount() const
+{
+   return cellCount_m;
+}
+
+
+inline
+dword OctreeCallCounts::getCellCount
+(
+   const dword level
+) const
+{
+   return cellCounts_m[level];
+}
+
+
+inline
+dword OctreeCallCounts::getDataCount() const
+{
+   return dataCount_m;
+}
+
+
+inline
+dword OctreeCallCounts::getTestCount() const
+{
+   return testCount_m;
+}
+
+
+inline
+dword OctreeCallCounts::getExitCount() const
+{
+   return exitCount_m;
+}
+
+
+inline
+dword OctreeCallCounts::getItemScanCount() const
+{
+   return itemScanCount_m;
+}
+
+
+
+
+/// OctreeCounts ---------------------------------------------------------------
+inline
+dword OctreeCounts::getCallCount
+(
+   const EOperation operation
+) const
+{
+   return operations_m[operation].callCount;
+}
+
+
+inline
+const OctreeCallCounts& OctreeCounts::getCounts
+(
+   const EOperation operation
+) const
+{
+   return operations_m[operation].counts;
+}
+
+
+inline
+dword OctreeCounts::getLatencyCount
+(
+   const EOperation operation,
+   const dword      bucket
+) const
+{
+   return operations_m[operation].latencyCounts[bucket];
+}
+
+
+inline
+dword OctreeCounts::getSlowestLatency
+(
+   const EOperation operation
+) const
+{
+   return operations_m[operation].slowestLatency;
+}
+
+
+inline
+const OctreeCallCounts& OctreeCounts::getSlowestCounts
+(
+   const EOperation operation
+) const
+{
+   return operations_m[operation].slowestCounts;
+}
+
+
+
+
+/// OctreeBound ----------------------------------------------------------------
+inline
+const Vector3r& OctreeBound::getLowerCorner() const
+{
+   return positionOfLowerCorner_m;
+}
+
+
+inline
+const Vector3r& OctreeBound::getUpperCorner() const
+{
+   return positionOfUpperCorner_m;
+}
+
+
+inline
+const Vector3r& OctreeBound::getCenter() const
+{
+   return center_m;
+}
+
+
+inline
+real OctreeBound::getRadius() const
+{
+   return circumSphereRadius_m;
+}
+
+
+inline
+real OctreeBound::getSize() const
+{
+   return positionOfUpperCorner_m.getX() - positionOfLowerCorner_m.getX();
+}
+
+
+inline
+bool OctreeBound::isOverlapping
+(
+   const Vector3r& lowerCorner,
+   const Vector3r& upperCorner
+) const
+{
+   return OctreeShape::isOverlappingBox( positionOfLowerCorner_m,
+      positionOfUpperCorner_m, lowerCorner, upperCorner );
+}
+
+
+inline
+bool OctreeBound::isInside
+(
+   const Vector3r& lowerCorner,
+   const Vector3r& upperCorner
+) const
+{
+   bool isIn = true;
+   for( int i = 3;  i-- > 0; )
+   {
+      isIn &= (positionOfLowerCorner_m[i] >= lowerCorner[i]) &
+              (positionOfUpperCorner_m[i] <= upperCorner[i]);
+   }
+
+   return isIn;
+}
+
+
+
+
+/// OctreeShape ----------------------------------------------------------------
+inline
+bool OctreeShape::isOverlappingPoint
+(
+   const Vector3r& point,
+   const Vector3r& lowerCorner,
+   const Vector3r& upperCorner
+)
+{
+   bool isOverlap = true;
+   for( int i = 3;  i-- > 0; )
+   {
+      isOverlap &= (lowerCorner[i] <= point[i]) & (point[i] <= upperCorner[i]);
+   }
+
+   return isOverlap;
+}
+
+
+inline
+bool OctreeShape::isOverlappingBox
+(
+   const Vector3r& itemLowerCorner,
+   const Vector3r& itemUpperCorner,
+   const Vector3r& lowerCorner,
+   const Vector3r& upperCorner
+)
+{
+   bool isOverlap = true;
+   for( int i = 3;  i-- > 0; )
+   {
+      isOverlap &= (itemLowerCorner[i] < upperCorner[i]) &
+                   (itemUpperCorner[i] > lowerCorner[i]);
+   }
+
+   return isOverlap;
+}
+
+
+inline
+bool OctreeShape::isOverlappingSphere
+(
+   const Vector3r& center,
+   const real      radius,
+   const Vector3r& lowerCorner,
+   const Vector3r& upperCorner
+)
+{
+   // sum the squared distances outside the range, along each axis
+   const real distance2 =
+      getAxisDistance2( center[0], lowerCorner[0], upperCorner[0] ) +
+      getAxisDistance2( center[1], lowerCorner[1], upperCorner[1] ) +
+      getAxisDistance2( center[2], lowerCorner[2], upperCorner[2] );
+
+   return distance2 <= (radius * radius);
+}
+
+
+inline
+dword OctreeShape::getSubcellOverlapsPoint
+(
+   const Vector3r& point,
+   const Vector3r& lower,
+   const Vector3r& middle,
+   const Vector3r& upper
+)
+{
+#ifdef OCTREE_SSE
+   return getSubcellOverlapsPointSse( point, lower, middle, upper );
+#else
+   return getSubcellOverlapsPointScalar( point, lower, middle, upper );
+#endif
+}
+
+
+inline
+dword OctreeShape::getSubcellOverlapsBox
+(
+   const Vector3r& itemLowerCorner,
+   const Vector3r& itemUpperCorner,
+   const Vector3r& lower,
+   const Vector3r& middle,
+   const Vector3r& upper
+)
+{
+#ifdef OCTREE_SSE
+   return getSubcellOverlapsBoxSse( itemLowerCorner, itemUpperCorner, lower,
+      middle, upper );
+#else
+   return getSubcellOverlapsBoxScalar( itemLowerCorner, itemUpperCorner, lower,
+      middle, upper );
+#endif
+}
+
+
+inline
+dword OctreeShape::getSubcellOverlapsSphere
+(
+   const Vector3r& center,
+   const real      radius,
+   const Vector3r& lower,
+   const Vector3r& middle,
+   const Vector3r& upper
+)
+{
+#ifdef OCTREE_SSE
+   return getSubcellOverlapsSphereSse( center, radius, lower, middle, upper );
+#else
+   return getSubcellOverlapsSphereScalar( center, radius, lower, middle,
+      upper );
+#endif
+}
+
+
+inline
+dword OctreeShape::getSubcellOverlapsPointScalar
+(
+   const Vector3r& point,
+   const Vector3r& lower,
+   const Vector3r& middle,
+   const Vector3r& upper
+)
+{
+   // the halfs reached, along each axis
+   dword flags = 0xFF;
+   for( int i = 3;  i-- > 0; )
+   {
+      flags &= getAxisSubcells( i,
+         (lower[i]  <= point[i]) & (point[i] <= middle[i]),
+         (middle[i] <= point[i]) & (point[i] <= upper[i]) );
+   }
+
+   return flags;
+}
+
+
+inline
+dword OctreeShape::getSubcellOverlapsBoxScalar
+(
+   const Vector3r& itemLowerCorner,
+   const Vector3r& itemUpperCorner,
+   const Vector3r& lower,
+   const Vector3r& middle,
+   const Vector3r& upper
+)
+{
+   // the halfs reached, along each axis
+   dword flags = 0xFF;
+   for( int i = 3;  i-- > 0; )
+   {
+      flags &= getAxisSubcells( i,
+         (itemLowerCorner[i] < middle[i]) & (itemUpperCorner[i] > lower[i]),
+         (itemLowerCorner[i] < upper[i])  & (itemUpperCorner[i] > middle[i]) );
+   }
+
+   return flags;
+}
+
+
+inline
+dword OctreeShape::getSubcellOverlapsSphereScalar
+(
+   const Vector3r& center,
+   const real      radius,
+   const Vector3r& lower,
+   const Vector3r& middle,
+   const Vector3r& upper
+)
+{
+   // the squared distances to each half, along each axis
+   real halfs[3][2];
+   for( int i = 3;  i-- > 0; )
+   {
+      halfs[i][0] = getAxisDistance2( center[i], lower[i], middle[i] );
+      halfs[i][1] = getAxisDistance2( center[i], middle[i], upper[i] );
+   }
+
+   // a subcell is overlapped if the sum of its halfs' is within the radius
+   const real radius2 = radius * radius;
+   dword flags = 0;
+   for( dword i = 8;  i-- > 0; )
+   {
+      flags |= static_cast<dword>((halfs[0][i & 1] + halfs[1][(i >> 1) & 1] +
+         halfs[2][(i >> 2) & 1]) <= radius2) << i;
+   }
+
+   return flags;
+}
+
+
+#ifdef OCTREE_SSE
+
+inline
+dword OctreeShape::getSubcellOverlapsPointSse
+(
+   const Vector3r& point,
+   const Vector3r& lower,
+   const Vector3r& middle,
+   const Vector3r& upper
+)
+{
+   const __m128 p = getSse( point );
+   const __m128 l = getSse( lower );
+   const __m128 m = getSse( middle );
+   const __m128 u = getSse( upper );
+
+   // the halfs reached, along all axes at once
+   return getHalfsSubcells(
+      _mm_movemask_ps( _mm_and_ps( _mm_cmple_ps( l, p ),
+         _mm_cmple_ps( p, m ) ) ),
+      _mm_movemask_ps( _mm_and_ps( _mm_cmple_ps( m, p ),
+         _mm_cmple_ps( p, u ) ) ) );
+}
+
+
+inline
+dword OctreeShape::getSubcellOverlapsBoxSse
+(
+   const Vector3r& itemLowerCorner,
+   const Vector3r& itemUpperCorner,
+   const Vector3r& lower,
+   const Vector3r& middle,
+   const Vector3r& upper
+)
+{
+   const __m128 il = getSse( itemLowerCorner );
+   const __m128 iu = getSse( itemUpperCorner );
+   const __m128 l  = getSse( lower );
+   const __m128 m  = getSse( middle );
+   const __m128 u  = getSse( upper );
+
+   // the halfs reached, along all axes at once
+   return getHalfsSubcells(
+      _mm_movemask_ps( _mm_and_ps( _mm_cmplt_ps( il, m ),
+         _mm_cmpgt_ps( iu, l ) ) ),
+      _mm_movemask_ps( _mm_and_ps( _mm_cmplt_ps( il, u ),
+         _mm_cmpgt_ps( iu, m ) ) ) );
+}
+
+
+inline
+dword OctreeShape::getSubcellOverlapsSphereSse
+(
+   const Vector3r& center,
+   const real      radius,
+   const Vector3r& lower,
+   const Vector3r& middle,
+   const Vector3r& upper
+)
+{
+   const __m128 c    = getSse( center );
+   const __m128 l    = getSse( lower );
+   const __m128 m    = getSse( middle );
+   const __m128 u    = getSse( upper );
+   const __m128 zero = _mm_setzero_ps();
+
+   // the squared distances to each half, along all axes at once (as
+   // getAxisDistance2: at most one of below and above is positive)
+   __m128 d0 = _mm_max_ps( _mm_max_ps( _mm_sub_ps( l, c ), _mm_sub_ps( c, m ) ),
+      zero );
+   __m128 d1 = _mm_max_ps( _mm_max_ps( _mm_sub_ps( m, c ), _mm_sub_ps( c, u ) ),
+      zero );
+   d0 = _mm_mul_ps( d0, d0 );
+   d1 = _mm_mul_ps( d1, d1 );
+
+   // spread to subcells 0-3: x by bit 0, y by bit 1 (z is by bit 2, so the
+   // same for all four, and for 4-7)
+   const __m128 xy = _mm_unpacklo_ps( d0, d1 );
+   const __m128 x  = _mm_movelh_ps( xy, xy );
+   const __m128 y  = _mm_shuffle_ps( xy, xy, _MM_SHUFFLE(3, 3, 2, 2) );
+   const __m128 z0 = _mm_shuffle_ps( d0, d0, _MM_SHUFFLE(2, 2, 2, 2) );
+   const __m128 z1 = _mm_shuffle_ps( d1, d1, _MM_SHUFFLE(2, 2, 2, 2) );
+
+   // a subcell is overlapped if the sum of its halfs' is within the radius
+   const __m128 radius2 = _mm_set1_ps( radius * radius );
+   const __m128 sumXy   = _mm_add_ps( x, y );
+   return _mm_movemask_ps( _mm_cmple_ps( _mm_add_ps( sumXy, z0 ), radius2 ) ) |
+      (_mm_movemask_ps( _mm_cmple_ps( _mm_add_ps( sumXy, z1 ), radius2 ) ) <<
+      4);
+}
+
+#endif
+
+
+inline
+bool OctreeShape::isCoveringBox
+(
+   const Vector3r& itemLowerCorner,
+   const Vector3r& itemUpperCorner,
+   const Vector3r& lowerCorner,
+   const Vector3r& upperCorner
+)
+{
+   // check the item's range holds the cell's in every dimension
+   bool isCover = true;
+   for( int i = 3;  i-- > 0; )
+   {
+      isCover &= (itemLowerCorner[i] <= lowerCorner[i]) &
+                 (itemUpperCorner[i] >= upperCorner[i]);
+   }
+
+   return isCover;
+}
+
+
+inline
+bool OctreeShape::isCoveringSphere
+(
+   const Vector3r& center,
+   const real      radius,
+   const Vector3r& lowerCorner,
+   const Vector3r& upperCorner
+)
+{
+   // sum the squared distances to the farthest corner, along each axis
+   real distance2 = 0.0f;
+   for( int i = 3;  i-- > 0; )
+   {
+      const real toLower = center[i] - lowerCorner[i];
+      const real toUpper = upperCorner[i] - center[i];
+      const real farther = (toLower > toUpper) ? toLower : toUpper;
+      distance2 += farther * farther;
+   }
+
+   return distance2 <= (radius * radius);
+}
+
+
+inline
+dword OctreeShape::getAxisSubcells
+(
+   const int  axis,
+   const bool isInLowerHalf,
+   const bool isInUpperHalf
+)
+{
+   // subcells in the lower half along x, y, z: 0x55, 0x33, 0x0F
+   static const dword LOWERS[3] = { 0x55, 0x33, 0x0F };
+
+   const dword lowers = LOWERS[axis];
+   return (-static_cast<dword>(isInLowerHalf) & lowers) |
+          (-static_cast<dword>(isInUpperHalf) & (lowers ^ 0xFF));
+}
+
+
+inline
+real OctreeShape::getAxisDistance2
+(
+   const real position,
+   const real lower,
+   const real upper
+)
+{
+   const real below = lower - position;
+   const real above = position - upper;
+   const real d     = (below > 0.0f) ? below : ((above > 0.0f) ? above : 0.0f);
+
+   return d * d;
+}
+
+
+#ifdef OCTREE_SSE
+
+inline
+dword OctreeShape::getHalfsSubcells
+(
+   const dword lowerHalfs,
+   const dword upperHalfs
+)
+{
+   // a bit per axis, for each half
+   return getAxisSubcells( 0, 0 != (lowerHalfs & 1), 0 != (upperHalfs & 1) ) &
+      getAxisSubcells( 1, 0 != (lowerHalfs & 2), 0 != (upperHalfs & 2) ) &
+      getAxisSubcells( 2, 0 != (lowerHalfs & 4), 0 != (upperHalfs & 4) );
+}
+
+
+inline
+__m128 OctreeShape::getSse
+(
+   const Vector3r& v
+)
+{
+   return _mm_set_ps( 0.0f, v[2], v[1], v[0] );
+}
+
+#endif
+
+
+
+/// OctreeData -----------------------------------------------------------------
+inline
+const OctreeBound& OctreeData::getBound() const
+{
+   return bound_m;
+}
+
+
+inline
+dword OctreeData::getLevel() const
+{
+   return level_m;
+}
+
+
+inline
+const OctreeDimensions& OctreeData::getDimensions() const
+{
+   return *pDimensions_m;
+}
+
+
+inline
+OctreeAllocatorV& OctreeData::getAllocator() const
+{
+   return *pAllocator_m;
+}
+
+
+inline
+OctreeStats& OctreeData::getStats() const
+{
+   return *pStats_m;
+}
+
+
+inline
+bool OctreeData::isSubdivide
+(
+   const dword itemCount
 ) const
 {
    return pDimensions_m->isSubdivide( itemCount, level_m, bound_m.getSize() );
 }
 
 
+
+
+/// templates ///
+
+/// OctreeHeap -----------------------------------------------------------------
+template<class ENTRY, bool IS_FARTHEST_TOP>
+inline
+OctreeHeap<ENTRY,IS_FARTHEST_TOP>::OctreeHeap()
+ : entries_m()
+{
+}
+
+
+template<class ENTRY, bool IS_FARTHEST_TOP>
+inline
+OctreeHeap<ENTRY,IS_FARTHEST_TOP>::~OctreeHeap()
+{
+}
+
+
+template<class ENTRY, bool IS_FARTHEST_TOP>
+void OctreeHeap<ENTRY,IS_FARTHEST_TOP>::push
+(
+   const ENTRY& entry
+)
+{
+   entries_m.append( entry );
+
+   // sift up
+   dword i = entries_m.getLength() - 1;
+   while( (i > 0) && isAbove( entries_m[i], entries_m[(i - 1) / 2] ) )
+   {
+      const ENTRY e = entries_m[i];
+      entries_m[i] = entries_m[(i - 1) / 2];
+      entries_m[(i - 1) / 2] = e;
+      i = (i - 1) / 2;
+   }
+}
+
+
+template<class ENTRY, bool IS_FARTHEST_TOP>
+void OctreeHeap<ENTRY,IS_FARTHEST_TOP>::pop()
+{
+   const dword length = entries_m.getLength() - 1;
+   if( length >= 0 )
+   {
+      // move last to top, and sift down
+      entries_m[0] = entries_m[length];
+      entries_m.setLength( length );
+
+      bool  isDone = false;
+      dword i      = 0;
+      while( !isDone )
+      {
+         dword child = (i * 2) + 1;
+         if( ((child + 1) < length) &&
+            isAbove( entries_m[child + 1], entries_m[child] ) )
+         {
+            ++child;
+         }
+
+         isDone = (child >= length) || !isAbove( entries_m[child],
+            entries_m[i] );
+         if( !isDone )
+         {
+            const ENTRY e = entries_m[i];
+            entries_m[i] = entries_m[child];
+            entries_m[child] = e;
+            i = child;
+         }
+      }
+   }
+}
+
+
+template<class ENTRY, bool IS_FARTHEST_TOP>
+inline
+void OctreeHeap<ENTRY,IS_FARTHEST_TOP>::reserve
+(
+   const dword capacity
+)
+{
+   entries_m.reserve( capacity );
+}
+
+
+template<class ENTRY, bool IS_FARTHEST_TOP>
+inline
+const ENTRY& OctreeHeap<ENTRY,IS_FARTHEST_TOP>::getTop() const
+{
+   return entries_m[0];
+}
+
+
+template<class ENTRY, bool IS_FARTHEST_TOP>
+inline
+const ENTRY& OctreeHeap<ENTRY,IS_FARTHEST_TOP>::operator[]
+(
+   const dword index
+) const
+{
+   return entries_m[index];
+}
+
+
+template<class ENTRY, bool IS_FARTHEST_TOP>
+inline
+dword OctreeHeap<ENTRY,IS_FARTHEST_TOP>::getLength() const
+{
+   return entries_m.getLength();
+}
+
+
+template<class ENTRY, bool IS_FARTHEST_TOP>
+inline
+bool OctreeHeap<ENTRY,IS_FARTHEST_TOP>::isEmpty() const
+{
+   return entries_m.isEmpty();
+}
+
+
+template<class ENTRY, bool IS_FARTHEST_TOP>
+inline
+bool OctreeHeap<ENTRY,IS_FARTHEST_TOP>::isAbove
+(
+   const ENTRY& a,
+   const ENTRY& b
+)
+{
+   return IS_FARTHEST_TOP ? (a.distance > b.distance) :
+      (a.distance < b.distance);
+}
+
+
 }//namespace
 
 
@@ -0,0 +1,617 @@
+/*------------------------------------------------------------------------------
+
+   Octree Component, version 2.1
+   Copyright (c) 2004-2007,  Harrison Ainsworth / HXA7241.
+
+   http://www.hxa7241.org/
+
+------------------------------------------------------------------------------*/
+
+/*------------------------------------------------------------------------------
+
+Copyright (c) 2004-2007, Harrison Ainsworth / HXA7241.
+
+Redistribution and use in source and binary forms, with or without modification,
+are permitted provided that the following conditions are met:
+
+* Redistributions of source code must retain the above copyright notice, this
+  list of conditions and the following disclaimer.
+* Redistributions in binary form must reproduce the above copyright notice, this
+  list of conditions and the following disclaimer in the documentation and/or
+  other materials provided with the distribution.
+* The name of the author may not be used to endorse or promote products derived
+  from this software without specific prior written permission.
+
+THIS SOFTWARE IS PROVIDED BY THE AUTHOR "AS IS" AND ANY EXPRESS OR IMPLIED
+WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT
+SHALL THE AUTHOR BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT
+OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING
+IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY
+OF SUCH DAMAGE.
+
+------------------------------------------------------------------------------*/
+
+
+#include "OctreeFrozenRoot.hpp"
+
+
+using namespace hxa7241_graphics;
+
+
+
+
+/// OctreeFrozenRoot::Cell /////////////////////////////////////////////////////
+
+/**
+ * View of a node of an OctreeFrozenRoot, for visiting, presented through the
+ * OctreeCell interface.<br/><br/>
+ *
+ * Made during the visit traversal, on the stack, and read-only: the commands
+ * do nothing, and clone gives 0.
+ */
+class OctreeFrozenRoot::Cell
+   : public OctreeCell
+{
+/// standard object services ---------------------------------------------------
+public:
+            Cell();
+   virtual ~Cell();
+private:
+            Cell( const Cell& );
+   Cell& operator=( const Cell& );
+public:
+
+
+/// commands -------------------------------------------------------------------
+           void  set( const OctreeFrozenRoot* pTree,
+                      dword                   nodeIndex );
+
+   virtual void  insert( const OctreeData&   thisData,
+                         OctreeCell*&        pThis,
+                         const void*         pItem,
+                         const OctreeAgentV& agent );
+   virtual void  insertRange( const OctreeData&   thisData,
+                              OctreeCell*&        pThis,
+                              const void* const*  pItems,
+                              dword               itemCount,
+                              const OctreeAgentV& agent,
+                              OctreeTaskPool*     pTasks );
+   virtual bool  remove( const OctreeData&   thisData,
+                         OctreeCell*&        pThis,
+                         const void*         pItem,
+                         const OctreeAgentV& agent );
+
+
+/// queries --------------------------------------------------------------------
+   virtual void  visit( const OctreeData& thisData,
+                        OctreeVisitorV&   visitor )                       const;
+
+   virtual OctreeCell* clone( OctreeAllocatorV& allocator )               const;
+
+   virtual dword getItemRefCount()                                        const;
+   virtual bool  isBranch()                                               const;
+
+   virtual void  getInfo( dword& byteSize,
+                          dword& leafCount,
+                          dword& itemCount,
+                          dword& maxDepth )                               const;
+
+
+/// implementation -------------------------------------------------------------
+protected:
+   virtual void  destroy( OctreeAllocatorV& allocator );
+
+
+/// fields ---------------------------------------------------------------------
+private:
+   const OctreeFrozenRoot* pTree_m;
+   dword                   nodeIndex_m;
+};
+
+
+
+
+/// standard object services ---------------------------------------------------
+OctreeFrozenRoot::Cell::Cell()
+ : pTree_m    ( 0 )
+ , nodeIndex_m( 0 )
+{
+}
+
+
+OctreeFrozenRoot::Cell::~Cell()
+{
+}
+
+
+
+
+/// commands -------------------------------------------------------------------
+void OctreeFrozenRoot::Cell::set
+(
+   const OctreeFrozenRoot* pTree,
+   const dword             nodeIndex
+)
+{
+   pTree_m     = pTree;
+   nodeIndex_m = nodeIndex;
+}
+
+
+void OctreeFrozenRoot::Cell::insert
+(
+   const OctreeData&   ,//thisData,
+   OctreeCell*&        ,//pThis,
+   const void* const   ,//pItem,
+   const OctreeAgentV& //agent
+)
+{
+   // read-only view
+}
+
+
+void OctreeFrozenRoot::Cell::insertRange
+(
+   const OctreeData&   ,//thisData,
+   OctreeCell*&        ,//pThis,
+   const void* const*  ,//pItems,
+   const dword         ,//itemCount,
+   const OctreeAgentV& ,//agent,
+   OctreeTaskPool*     //pTasks
+)
+{
+   // read-only view
+}
+
+
+bool OctreeFrozenRoot::Cell::remove
+(
+   const OctreeData&   ,//thisData,
+   OctreeCell*&        ,//pThis,
+   const void* const   ,//pItem,
+   const OctreeAgentV& //agent
+)
+{
+   // read-only view
+   return false;
+}
+
+
+
+
+/// queries --------------------------------------------------------------------
+void OctreeFrozenRoot::Cell::visit
+(
+   const OctreeData& thisData,
+   OctreeVisitorV&   visitor
+) const
+{
+   const Node& node = pTree_m->nodes_m[ nodeIndex_m ];
+
+   if( 0 == node.subCellMask )
+   {
+      // present the leaf's span of the items array
+      Array<const void*> items( const_cast<const void**>(
+         pTree_m->items_m.getStorage() + node.index ), node.itemCount );
+      items.setLength( node.itemCount );
+
+      visitor.visitLeafV( items, thisData );
+   }
+   else
+   {
+      // present the branch's own items first
+      dword subNodeIndex = node.index;
+      if( node.subCellMask & ITEMS_NODE )
+      {
+         const Node& itemsNode = pTree_m->nodes_m[ subNodeIndex++ ];
+         Array<const void*> items( const_cast<const void**>(
+            pTree_m->items_m.getStorage() + itemsNode.index ),
+            itemsNode.itemCount );
+         items.setLength( itemsNode.itemCount );
+
+         visitor.visitBranchItemsV( items, thisData );
+      }
+
+      // present the occupied subcells (null where not)
+      Cell              subCells[8];
+      const OctreeCell* pSubCells[8];
+      for( dword i = 0;  i < 8;  ++i )
+      {
+         pSubCells[i] = 0;
+         if( (node.subCellMask >> i) & 1 )
+         {
+            subCells[i].set( pTree_m, subNodeIndex++ );
+            pSubCells[i] = &subCells[i];
+         }
+      }
+
+      visitor.visitBranchV( pSubCells, thisData );
+   }
+}
+
+
+OctreeCell* OctreeFrozenRoot::Cell::clone
+(
+   OctreeAllocatorV& //allocator
+) const
+{
+   // read-only view
+   return 0;
+}
+
+
+dword OctreeFrozenRoot::Cell::getItemRefCount() const
+{
+   return pTree_m->nodes_m[ nodeIndex_m ].itemCount;
+}
+
+
+bool OctreeFrozenRoot::Cell::isBranch() const
+{
+   return 0 != pTree_m->nodes_m[ nodeIndex_m ].subCellMask;
+}
+
+
+void OctreeFrozenRoot::Cell::getInfo
+(
+   dword& byteSize,
+   dword& leafCount,
+   dword& itemCount,
+   dword& maxDepth
+) const
+{
+   const Node& node = pTree_m->nodes_m[ nodeIndex_m ];
+
+   byteSize += sizeof(Node);
+
+   if( 0 == node.subCellMask )
+   {
+      byteSize  += node.itemCount * sizeof(void*);
+      ++leafCount;
+      itemCount += node.itemCount;
+      ++maxDepth;
+   }
+   else
+   {
+      const dword thisDepth = maxDepth + 1;
+
+      // branch's own items
+      dword subNodeIndex = node.index;
+      if( node.subCellMask & ITEMS_NODE )
+      {
+         const Node& itemsNode = pTree_m->nodes_m[ subNodeIndex++ ];
+         byteSize  += sizeof(Node) + (itemsNode.itemCount * sizeof(void*));
+         itemCount += itemsNode.itemCount;
+      }
+
+      for( dword i = 8;  i-- > 0; )
+      {
+         if( (node.subCellMask >> i) & 1 )
+         {
+            Cell subCell;
+            subCell.set( pTree_m, subNodeIndex++ );
+
+            dword depth = thisDepth;
+            subCell.getInfo( byteSize, leafCount, itemCount, depth );
+
+            if( maxDepth < depth )
+            {
+               maxDepth = depth;
+            }
+         }
+      }
+   }
+}
+
+
+
+
+/// implementation -------------------------------------------------------------
+void OctreeFrozenRoot::Cell::destroy
+(
+   OctreeAllocatorV& //allocator
+)
+{
+   // read-only view
+}
+
+
+
+
+
+
+
+
+/// OctreeFrozenRoot::Builder //////////////////////////////////////////////////
+
+
+/// standard object services ---------------------------------------------------
+OctreeFrozenRoot::Builder::Builder()
+ : nodes_m       ()
+ , items_m       ()
+ , leafCount_m   ( 0 )
+ , maxDepth_m    ( 0 )
+ , current_m     ( 0 )
+ , pBranchItems_m( 0 )
+{
+}
+
+
+OctreeFrozenRoot::Builder::~Builder()
+{
+}
+
+
+
+
+/// commands -------------------------------------------------------------------
+void OctreeFrozenRoot::Builder::visitRootV
+(
+   const OctreeCell* pRootCell,
+   const OctreeData& octreeData
+)
+{
+   if( pRootCell )
+   {
+      const Node root = { 0, 0, 0 };
+      nodes_m.append( root );
+      current_m = 0;
+
+      pRootCell->visit( octreeData, *this );
+   }
+}
+
+
+void OctreeFrozenRoot::Builder::visitBranchV
+(
+   const OctreeCell* subCells[8],
+   const OctreeData& octreeData
+)
+{
+   // add a block of nodes: for the branch's own items (if any, just given
+   // to visitBranchItemsV), then the occupied subcells
+   const dword thisNode  = current_m;
+   const dword first     = nodes_m.getLength();
+   udword      mask      = 0;
+   dword       itemCount = 0;
+   if( pBranchItems_m )
+   {
+      Node itemsNode = { 0, 0, 0 };
+      setItems( itemsNode, *pBranchItems_m );
+      nodes_m.append( itemsNode );
+      mask |= ITEMS_NODE;
+
+      itemCount += itemsNode.itemCount;
+      pBranchItems_m = 0;
+   }
+   for( dword i = 0;  i < 8;  ++i )
+   {
+      if( subCells[i] )
+      {
+         const Node subNode = { 0, 0, 0 };
+         nodes_m.append( subNode );
+         mask |= 1u << i;
+      }
+   }
+   nodes_m[ thisNode ].subCellMask = mask;
+   nodes_m[ thisNode ].index       = first;
+
+   // fill each, in order, summing their item refs
+   for( dword i = 0, subNode = first + ((mask >> 8) & 1);  i < 8;  ++i )
+   {
+      if( subCells[i] )
+      {
+         current_m = subNode;
+         OctreeBranch::continueVisit( subCells, octreeData, i, *this );
+
+         itemCount += nodes_m[ subNode++ ].itemCount;
+      }
+   }
+   nodes_m[ thisNode ].itemCount = itemCount;
+}
+
+
+void OctreeFrozenRoot::Builder::visitLeafV
+(
+   const Array<const void*>& items,
+   const OctreeData&         octreeData
+)
+{
+   setItems( nodes_m[ current_m ], items );
+
+   ++leafCount_m;
+   if( maxDepth_m <= octreeData.getLevel() )
+   {
+      maxDepth_m = octreeData.getLevel() + 1;
+   }
+}
+
+
+void OctreeFrozenRoot::Builder::visitBranchItemsV
+(
+   const Array<const void*>& items,
+   const OctreeData&         //octreeData
+)
+{
+   // (added by visitBranchV, which follows)
+   pBranchItems_m = &items;
+}
+
+
+
+
+/// implementation -------------------------------------------------------------
+void OctreeFrozenRoot::Builder::setItems
+(
+   Node&                     node,
+   const Array<const void*>& items
+)
+{
+   node.subCellMask = 0;
+   node.index       = items_m.getLength();
+   node.itemCount   = items.getLength();
+
+   for( dword j = 0;  j < items.getLength();  ++j )
+   {
+      items_m.append( items[j] );
+   }
+}
+
+
+
+
+
+
+
+
+/// OctreeFrozenRoot ///////////////////////////////////////////////////////////
+
+
+/// standard object services ---------------------------------------------------
+OctreeFrozenRoot::OctreeFrozenRoot()
+ : dimensions_m( Vector3r::ZERO(), 1.0f, 1, 1, 1.0f )
+ , nodes_m     ()
+ , items_m     ()
+ , leafCount_m ( 0 )
+ , maxDepth_m  ( 0 )
+ , allocator_m ()
+{
+}
+
+
+OctreeFrozenRoot::~OctreeFrozenRoot()
+{
+}
+
+
+OctreeFrozenRoot::OctreeFrozenRoot
+(
+   const OctreeFrozenRoot& other
+)
+ : dimensions_m( other.dimensions_m )
+ , nodes_m     ( other.nodes_m )
+ , items_m     ( other.items_m )
+ , leafCount_m ( other.leafCount_m )
+ , maxDepth_m  ( other.maxDepth_m )
+ , allocator_m ()
+{
+}
+
+
+OctreeFrozenRoot& OctreeFrozenRoot::operator=
+(
+   const OctreeFrozenRoot& other
+)
+{
+   if( &other != this )
+   {
+      // make new data before replacing old
+      Array<Node>        nodes( other.nodes_m );
+      Array<const void*> items( other.items_m );
+      nodes_m.swap( nodes );
+      items_m.swap( items );
+
+      dimensions_m = other.dimensions_m;
+      leafCount_m  = other.leafCount_m;
+      maxDepth_m   = other.maxDepth_m;
+   }
+
+   return *this;
+}
+
+
+
+
+/// queries --------------------------------------------------------------------
+void OctreeFrozenRoot::visit
+(
+   OctreeVisitorV& visitor
+) const
+{
+   const OctreeData data( dimensions_m, allocator_m );
+
+   Cell rootCell;
+   rootCell.set( this, 0 );
+
+   visitor.visitRootV( nodes_m.isEmpty() ? 0 : &rootCell, data );
+}
+
+
+bool OctreeFrozenRoot::isEmpty() const
+{
+   return nodes_m.isEmpty();
+}
+
+
+void OctreeFrozenRoot::getInfo
+(
+   const dword rootWrapperByteSize,
+   dword&      byteSize,
+   dword&      leafCount,
+   dword&      itemCount,
+   dword&      maxDepth
+) const
+{
+   byteSize  = rootWrapperByteSize +
+      (nodes_m.getCapacity() * sizeof(Node)) +
+      (items_m.getCapacity() * sizeof(void*));
+   leafCount = leafCount_m;
+   itemCount = items_m.getLength();
+   maxDepth  = maxDepth_m;
+}
+
+
+const Vector3r& OctreeFrozenRoot::getPosition() const
+{
+   return dimensions_m.getPosition();
+}
+
+
+real OctreeFrozenRoot::getSize() const
+{
+   return dimensions_m.getSize();
+}
+
+
+dword OctreeFrozenRoot::getMaxItemCountPerCell() const
+{
+   return dimensions_m.getMaxItemCountPerCell();
+}
+
+
+dword OctreeFrozenRoot::getMaxLevelCount() const
+{
+   return dimensions_m.getMaxLevelCount();
+}
+
+
+real OctreeFrozenRoot::getMinCellSize() const
+{
+   return dimensions_m.getMinCellSize();
+}
+
+
+
+
+/// implementation -------------------------------------------------------------
+void OctreeFrozenRoot::assign
+(
+   const OctreeDimensions& dimensions,
+   Builder&                builder
+)
+{
+   // trim to size, since it will not change
+   builder.nodes_m.shrinkToFit();
+   builder.items_m.shrinkToFit();
+
+   nodes_m.swap( builder.nodes_m );
+   items_m.swap( builder.items_m );
+
+   dimensions_m = dimensions;
+   leafCount_m  = builder.leafCount_m;
+   maxDepth_m   = builder.maxDepth_m;
+}
@@ -0,0 +1,400 @@
+/*------------------------------------------------------------------------------
+
+   Octree Component, version 2.1
+   Copyright (c) 2004-2007,  Harrison Ainsworth / HXA7241.
+
+   http://www.hxa7241.org/
+
+------------------------------------------------------------------------------*/
+
+/*------------------------------------------------------------------------------
+
+Copyright (c) 2004-2007, Harrison Ainsworth / HXA7241.
+
+Redistribution and use in source and binary forms, with or without modification,
+are permitted provided that the following conditions are met:
+
+* Redistributions of source code must retain the above copyright notice, this
+  list of conditions and the following disclaimer.
+* Redistributions in binary form must reproduce the above copyright notice, this
+  list of conditions and the following disclaimer in the documentation and/or
+  other materials provided with the distribution.
+* The name of the author may not be used to endorse or promote products derived
+  from this software without specific prior written permission.
+
+THIS SOFTWARE IS PROVIDED BY THE AUTHOR "AS IS" AND ANY EXPRESS OR IMPLIED
+WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT
+SHALL THE AUTHOR BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT
+OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING
+IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY
+OF SUCH DAMAGE.
+
+------------------------------------------------------------------------------*/
+
+
+#ifndef OctreeFrozenRoot_h
+#define OctreeFrozenRoot_h
+
+
+#include "OctreeImplementation.hpp"
+#include "OctreeAllocator.hpp"
+
+
+
+
+namespace hxa7241_graphics
+{
+   class OctreeLooseRoot;
+
+
+/**
+ * Immutable implementation class for the OctreeFrozen template: a copy of an
+ * octree's cells in a flat, read-only layout.<br/><br/>
+ *
+ * Nodes are held in one array. The occupied subcells of a branch are
+ * consecutive nodes, in subcell order, addressed by the index of the first and
+ * a mask of which subcells are occupied. Each block of subcells follows its
+ * parent's depth-first (so a descent reads forward through the array). Item
+ * pointers are held in one array, each leaf having a span of it. A branch
+ * holding items itself (those covering it) has an extra node first in its
+ * block, flagged by ITEMS_NODE in its mask, giving its span of items.
+ * <br/><br/>
+ *
+ * Made by freeze, from OctreeRoot or OctreeLinear (through visiting, so the
+ * same cells and items). Not from OctreeLooseRoot, whose cells are entered by
+ * their loose bounds: that overload is private, and undefined.<br/><br/>
+ *
+ * Queries run either through the visitor interface (with transient OctreeCell
+ * views, as OctreeLinear), or through query, which calls a QUERY object's
+ * member functions directly (no virtual calls):
+ * <pre>
+ *    bool isEntering( const OctreeData& cellData );
+ *    void visitLeaf ( const void* const* pItems,
+ *                     dword              itemCount,
+ *                     const OctreeData&  leafData );
+ * </pre>
+ * isEntering is asked for each cell (the root too), and its subcells are
+ * skipped if false. A branch's own items are given to visitLeaf before its
+ * subcells. Subcells are entered in the order i ^ subCellOrder, for i
+ * from 0 to 7 (so, with a bit set for each axis a ray points negatively
+ * along, front-to-back along the ray).<br/><br/>
+ *
+ * queryNearest enters cells best-first instead: always the nearest not yet
+ * entered, by a QUERY having these member functions (and visitLeaf):
+ * <pre>
+ *    real getCellDistance( const OctreeData& cellData ) const;
+ *    real getLimit() const;
+ * </pre>
+ * Cells farther than the limit (which may shrink as leafs are visited) are
+ * skipped, and it ends when the nearest remaining cell is beyond it.
+ *
+ * @invariants
+ * nodes_m is empty, or nodes_m[0] is the root.<br/>
+ * nodes_m subCellMask is 0 for a leaf; for a branch it is not 0, and index is
+ * the first of its popcount(subCellMask) nodes: its items node (a leaf node,
+ * not counted as a leaf) if ITEMS_NODE is set, then its subcell nodes.<br/>
+ * nodes_m itemCount is the leaf's items (from index in items_m), or the
+ * branch's item refs in itself and all below.<br/>
+ */
+class OctreeFrozenRoot
+{
+/// standard object services ---------------------------------------------------
+public:
+            OctreeFrozenRoot();
+
+           ~OctreeFrozenRoot();
+            OctreeFrozenRoot( const OctreeFrozenRoot& );
+   OctreeFrozenRoot& operator=( const OctreeFrozenRoot& );
+
+
+/// commands -------------------------------------------------------------------
+   template<class ROOT>
+           void  freeze( const ROOT& root );                           // throws
+private:
+           void  freeze( const OctreeLooseRoot& root );
+public:
+
+
+/// queries --------------------------------------------------------------------
+           void  visit( OctreeVisitorV& visitor )                         const;
+   template<class QUERY>
+           void  query( QUERY& query,
+                        dword  subCellOrder = 0 )                         const;
+   template<class QUERY>
+           void  queryNearest( QUERY& query )                             const;
+
+           bool  isEmpty()                                                const;
+           void  getInfo( dword  rootWrapperByteSize,
+                          dword& byteSize,
+                          dword& leafCount,
+                          dword& itemCount,
+                          dword& maxDepth )                               const;
+
+           const Vector3r& getPosition()                                  const;
+           real            getSize()                                      const;
+           dword           getMaxItemCountPerCell()                       const;
+           dword           getMaxLevelCount()                             const;
+           real            getMinCellSize()                               const;
+
+
+/// implementation -------------------------------------------------------------
+   static const udword ITEMS_NODE = 0x100;
+
+   struct Node
+   {
+      udword subCellMask;
+      dword  index;
+      dword  itemCount;
+   };
+
+   struct NearCell
+   {
+      real       distance;
+      dword      nodeIndex;
+      OctreeData data;
+   };
+
+   class Builder;
+   class Cell;
+   friend class Cell;
+
+protected:
+           void  assign( const OctreeDimensions& dimensions,
+                         Builder&                builder );
+
+   template<class QUERY>
+           void  queryNode( dword             nodeIndex,
+                            const OctreeData& nodeData,
+                            QUERY&            query,
+                            dword             subCellOrder )              const;
+
+
+/// fields ---------------------------------------------------------------------
+private:
+   OctreeDimensions   dimensions_m;
+   Array<Node>        nodes_m;
+   Array<const void*> items_m;
+   dword              leafCount_m;
+   dword              maxDepth_m;
+
+   // only for making OctreeData (nothing is allocated)
+   mutable OctreeAllocatorHeap allocator_m;
+};
+
+
+
+
+/**
+ * Visitor that copies an octree's cells into the OctreeFrozenRoot layout.
+ */
+class OctreeFrozenRoot::Builder
+   : public OctreeVisitorV
+{
+   friend class OctreeFrozenRoot;
+
+/// standard object services ---------------------------------------------------
+public:
+            Builder();
+   virtual ~Builder();
+private:
+            Builder( const Builder& );
+   Builder& operator=( const Builder& );
+public:
+
+
+/// commands -------------------------------------------------------------------
+   virtual void  visitRootV  ( const OctreeCell* pRootCell,
+                               const OctreeData& octreeData );
+   virtual void  visitBranchV( const OctreeCell* subCells[8],
+                               const OctreeData& octreeData );
+   virtual void  visitLeafV  ( const Array<const void*>& items,
+                               const OctreeData&         octreeData );
+   virtual void  visitBranchItemsV( const Array<const void*>& items,
+                                    const OctreeData&         octreeData );
+
+
+/// implementation -------------------------------------------------------------
+protected:
+           void  setItems( Node&                     node,
+                           const Array<const void*>& items );
+
+
+/// fields ---------------------------------------------------------------------
+private:
+   Array<Node>               nodes_m;
+   Array<const void*>        items_m;
+   dword                     leafCount_m;
+   dword                     maxDepth_m;
+   dword                     current_m;
+   const Array<const void*>* pBranchItems_m;
+};
+
+
+
+
+/// templates ///
+
+/// commands -------------------------------------------------------------------
+template<class ROOT>
+void OctreeFrozenRoot::freeze
+(
+   const ROOT& root
+)
+{
+   // copy the cells, by visiting
+   Builder builder;
+   root.visit( builder );
+
+   // replace content (unchanged if the copying throws)
+   assign( OctreeDimensions( root.getPosition(), root.getSize(),
+      root.getMaxItemCountPerCell(), root.getMaxLevelCount(),
+      root.getMinCellSize() ), builder );
+}
+
+
+
+
+/// queries --------------------------------------------------------------------
+template<class QUERY>
+void OctreeFrozenRoot::query
+(
+   QUERY&      query,
+   const dword subCellOrder
+) const
+{
+   if( !nodes_m.isEmpty() )
+   {
+      const OctreeData data( dimensions_m, allocator_m );
+
+      if( query.isEntering( data ) )
+      {
+         queryNode( 0, data, query, subCellOrder );
+      }
+   }
+}
+
+
+template<class QUERY>
+void OctreeFrozenRoot::queryNearest
+(
+   QUERY& query
+) const
+{
+   if( !nodes_m.isEmpty() )
+   {
+      OctreeHeap<NearCell,false> cells;
+
+      NearCell cell;
+      cell.nodeIndex = 0;
+      cell.data      = OctreeData( dimensions_m, allocator_m );
+      cell.distance  = query.getCellDistance( cell.data );
+      if( cell.distance <= query.getLimit() )
+      {
+         cells.push( cell );
+      }
+
+      // enter the nearest cell, until it is beyond the query's limit
+      while( !cells.isEmpty() && (cells.getTop().distance <= query.getLimit()) )
+      {
+         const NearCell nearest = cells.getTop();
+         cells.pop();
+
+         const Node& node = nodes_m[ nearest.nodeIndex ];
+         if( 0 == node.subCellMask )
+         {
+            query.visitLeaf( items_m.getStorage() + node.index, node.itemCount,
+               nearest.data );
+         }
+         else
+         {
+            // branch's own items first
+            dword subNodeIndex = node.index;
+            if( node.subCellMask & ITEMS_NODE )
+            {
+               const Node& itemsNode = nodes_m[ subNodeIndex++ ];
+               query.visitLeaf( items_m.getStorage() + itemsNode.index,
+                  itemsNode.itemCount, nearest.data );
+            }
+
+            // step through occupied subcells, which are consecutive nodes
+            for( dword i = 0;  i < 8;  ++i )
+            {
+               if( (node.subCellMask >> i) & 1 )
+               {
+                  cell.nodeIndex = subNodeIndex++;
+                  cell.data      = OctreeData( nearest.data, i );
+                  cell.distance  = query.getCellDistance( cell.data );
+                  if( cell.distance <= query.getLimit() )
+                  {
+                     cells.push( cell );
+                  }
+               }
+            }
+         }
+      }
+   }
+}
+
+
+template<class QUERY>
+void OctreeFrozenRoot::queryNode
+(
+   const dword       nodeIndex,
+   const OctreeData& nodeData,
+   QUERY&            query,
+   const dword       subCellOrder
+) const
+{
+   const Node& node = nodes_m[ nodeIndex ];
+
+   if( 0 == node.subCellMask )
+   {
+      query.visitLeaf( items_m.getStorage() + node.index, node.itemCount,
+         nodeData );
+   }
+   else
+   {
+      // branch's own items first
+      dword subNodeIndex = node.index;
+      if( node.subCellMask & ITEMS_NODE )
+      {
+         const Node& itemsNode = nodes_m[ subNodeIndex++ ];
+         query.visitLeaf( items_m.getStorage() + itemsNode.index,
+            itemsNode.itemCount, nodeData );
+      }
+
+      // occupied subcells are consecutive nodes, so number them first
+      dword subNodeIndexs[8];
+      for( dword i = 0;  i < 8;  ++i )
+      {
+         subNodeIndexs[i] = subNodeIndex;
+         subNodeIndex += (node.subCellMask >> i) & 1;
+      }
+
+      // step through occupied subcells (in the given order)
+      for( dword i = 0;  i < 8;  ++i )
+      {
+         const dword s = i ^ subCellOrder;
+         if( (node.subCellMask >> s) & 1 )
+         {
+            const OctreeData subCellData( nodeData, s );
+            if( query.isEntering( subCellData ) )
+            {
+               queryNode( subNodeIndexs[s], subCellData, query, subCellOrder );
+            }
+         }
+      }
+   }
+}
+
+
+}//namespace
+
+
+
+
+#endif//OctreeFrozenRoot_h
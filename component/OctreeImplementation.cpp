@@ -36,6 +36,8 @@ OF SUCH DAMAGE.
 ------------------------------------------------------------------------------*/
 
 
+#include "OctreeTasks.hpp"
+
 #include "OctreeImplementation.hpp"
 
 
@@ -44,28 +46,155 @@ using namespace hxa7241_graphics;
 
 
 
+namespace
+{
+
+/// least items for a branch to build its subcells in parallel
+const dword PARALLEL_ITEMS_MIN  = 1024;
+
+/// number of parts to split the items into, for overlap calculation
+const dword OVERLAPS_TASK_COUNT = 16;
+
+
+/**
+ * Calculates subcell overlaps for a part of a branch's items.
+ */
+class OverlapsTask
+   : public OctreeTaskV
+{
+public:
+            OverlapsTask() {}
+   virtual ~OverlapsTask() {}
+
+   void set( const OctreeData&   thisData,
+             const OctreeAgentV& agent,
+             const void* const*  pItems,
+             dword               begin,
+             dword               end,
+             dword*              pOverlaps )
+   {
+      pThisData_m = &thisData;
+      pAgent_m    = &agent;
+      pItems_m    = pItems;
+      begin_m     = begin;
+      end_m       = end;
+      pOverlaps_m = pOverlaps;
+   }
+
+   virtual void run()
+   {
+      const OctreeBound& bound = pThisData_m->getBound();
+      for( dword j = begin_m;  j < end_m;  ++j )
+      {
+         pOverlaps_m[j] = pAgent_m->getSubcellOverlapsV( pItems_m[j],
+            bound.getLowerCorner(), bound.getCenter(), bound.getUpperCorner() );
+      }
+   }
+
+private:
+   const OctreeData*   pThisData_m;
+   const OctreeAgentV* pAgent_m;
+   const void* const*  pItems_m;
+   dword               begin_m;
+   dword               end_m;
+   dword*              pOverlaps_m;
+};
+
+
+/**
+ * Inserts a branch's items into one of its subcells, counting the changes in
+ * its own stats (for the branch to add in after).
+ */
+class SubCellTask
+   : public OctreeTaskV
+{
+public:
+            SubCellTask() {}
+   virtual ~SubCellTask() {}
+
+   void set( const OctreeData&         thisData,
+             dword                     subCellIndex,
+             OctreeCell*&              pSubCell,
+             const Array<const void*>& items,
+             const OctreeAgentV&       agent,
+             OctreeTaskPool&           tasks )
+   {
+      pThisData_m    = &thisData;
+      subCellIndex_m = subCellIndex;
+      ppSubCell_m    = &pSubCell;
+      pItems_m       = &items;
+      pAgent_m       = &agent;
+      pTasks_m       = &tasks;
+   }
+
+   virtual void run()
+   {
+      const OctreeData subCellData( OctreeData( *pThisData_m,
+         subCellIndex_m ), stats_m );
+      OctreeCell::insertRangeMaybeCreate( subCellData, *ppSubCell_m,
+         pItems_m->getStorage(), pItems_m->getLength(), *pAgent_m, pTasks_m );
+   }
+
+   const OctreeStats& getStats() const
+   {
+      return stats_m;
+   }
+
+private:
+   const OctreeData*         pThisData_m;
+   dword                     subCellIndex_m;
+   OctreeCell**              ppSubCell_m;
+   const Array<const void*>* pItems_m;
+   const OctreeAgentV*       pAgent_m;
+   OctreeTaskPool*           pTasks_m;
+   OctreeStats               stats_m;
+};
+
+}
+
+
+
+
 /// OctreeRoot /////////////////////////////////////////////////////////////////
 
 
 /// standard object services ---------------------------------------------------
 OctreeRoot::OctreeRoot
 (
-   const Vector3r& position,
-   const real      sizeOfCube,
-   const dword     maxItemsPerCell,
-   const dword     maxLevelCount,
-   const real      minCellSize
+   const Vector3r&   position,
+   const real        sizeOfCube,
+   const dword       maxItemsPerCell,
+   const dword       maxLevelCount,
+   const real        minCellSize,
+   const dword       collapseItemCount,
+   OctreeAllocatorV& allocator,
+   const real        looseness
 )
  : dimensions_m( position, sizeOfCube, maxItemsPerCell, maxLevelCount,
-      minCellSize )
+      minCellSize, collapseItemCount, looseness )
+ , pAllocator_m( &allocator )
  , pRootCell_m ( 0 )
+ , isSharing_m ( false )
+ , stats_m     ()
 {
 }
 
 
-OctreeRoot::~OctreeRoot()
+OctreeRoot::OctreeRoot
+(
+   const OctreeRoot& other,
+   OctreeAllocatorV& allocator
+)
+ : dimensions_m( other.dimensions_m )
+ , pAllocator_m( &allocator )
+ , pRootCell_m ( 0 )
+ , isSharing_m ( &allocator == other.pAllocator_m )
+ , stats_m     ( other.stats_m )
 {
-   delete pRootCell_m;
+   // share cells with a root on the same allocator, else copy them
+   pRootCell_m = isSharing_m ?
+      OctreeCell::shareNonZero( other.pRootCell_m ) :
+      OctreeCell::cloneNonZero( other.pRootCell_m, allocator );
 }
 
 
@@ -74,8 +203,26 @@ OctreeRoot::OctreeRoot
    const OctreeRoot& other
 )
  : dimensions_m( other.dimensions_m )
- , pRootCell_m ( OctreeCell::cloneNonZero( other.pRootCell_m ) )
+ , pAllocator_m( other.pAllocator_m )
+ , pRootCell_m ( OctreeCell::shareNonZero( other.pRootCell_m ) )
+ , isSharing_m ( true )
+ , stats_m     ( other.stats_m )
+{
+}
+
+
+OctreeRoot::~OctreeRoot()
 {
+   // release whole tree at once, or cell by cell (and only this one's share,
+   // of those shared)
+   if( pAllocator_m->isFreeingAll() && !isSharing_m )
+   {
+      pAllocator_m->freeAll();
+   }
+   else
+   {
+      OctreeCell::deleteNonZero( pRootCell_m, *pAllocator_m );
+   }
 }
 
 
@@ -86,12 +233,19 @@ OctreeRoot& OctreeRoot::operator=
 {
    if( &other != this )
    {
-      // make new data before deleting old
-      OctreeCell* pRootCell = OctreeCell::cloneNonZero( other.pRootCell_m );
-      delete pRootCell_m;
+      // make new data before deleting old (sharing cells with a root on the
+      // same allocator, else copying them)
+      const bool isSharing = (pAllocator_m == other.pAllocator_m);
+      OctreeCell* pRootCell = isSharing ?
+         OctreeCell::shareNonZero( other.pRootCell_m ) :
+         OctreeCell::cloneNonZero( other.pRootCell_m, *pAllocator_m );
+      OctreeCell::deleteNonZero( pRootCell_m, *pAllocator_m );
       pRootCell_m = pRootCell;
 
+      // (isSharing_m stays as constructed: the allocator is unchanged)
+
       dimensions_m = other.dimensions_m;
+      stats_m      = other.stats_m;
    }
 
    return *this;
@@ -109,14 +263,15 @@ bool OctreeRoot::insert
 {
    bool isInserted = false;
 
-   const OctreeData data( dimensions_m );
+   const OctreeData data( dimensions_m, *pAllocator_m, stats_m );
 
    // check if item overlaps root cell
-   if( agent.isOverlappingCellV( pItem, data.getBound().getLowerCorner(),
-      data.getBound().getUpperCorner() ) )
+   if( OCTREE_COUNT_TEST( agent.isOverlappingCellV( pItem,
+      data.getBound().getLowerCorner(), data.getBound().getUpperCorner() ) ) )
    {
       OctreeLeaf::insertMaybeCreate( data, pRootCell_m, pItem, agent );
 
+      stats_m.addItems( 1 );
       isInserted = true;
    }
 
@@ -124,25 +279,87 @@ bool OctreeRoot::insert
 }
 
 
+dword OctreeRoot::insertRange
+(
+   const void* const*  pItems,
+   const dword         itemCount,
+   const OctreeAgentV& agent,
+   const dword         threadCount
+)
+{
+   const OctreeData data( dimensions_m, *pAllocator_m, stats_m );
+
+   // keep only items overlapping root cell
+   Array<const void*> items;
+   items.reserve( itemCount );
+   for( dword i = 0;  i < itemCount;  ++i )
+   {
+      if( OCTREE_COUNT_TEST( agent.isOverlappingCellV( pItems[i],
+         data.getBound().getLowerCorner(),
+         data.getBound().getUpperCorner() ) ) )
+      {
+         items.append( pItems[i] );
+      }
+   }
+
+   if( threadCount > 1 )
+   {
+      // build with threads, sharing the allocator between them
+      OctreeTaskPool         tasks( threadCount );
+      OctreeAllocatorLocking allocator( *pAllocator_m );
+      const OctreeData       sharedData( dimensions_m, allocator, stats_m );
+
+      OctreeCell::insertRangeMaybeCreate( sharedData, pRootCell_m,
+         items.getStorage(), items.getLength(), agent, &tasks );
+   }
+   else
+   {
+      OctreeCell::insertRangeMaybeCreate( data, pRootCell_m,
+         items.getStorage(), items.getLength(), agent, 0 );
+   }
+
+   stats_m.addItems( items.getLength() );
+
+   return items.getLength();
+}
+
+
 bool OctreeRoot::remove
 (
    const void* const   pItem,
-   const OctreeAgentV& //agent
+   const OctreeAgentV& agent
 )
 {
    bool isRemoved = false;
 
    if( pRootCell_m )
    {
-      dword unusedBranchItemCount = 0;
-      isRemoved = pRootCell_m->remove( pRootCell_m, pItem,
-         dimensions_m.getMaxItemCountPerCell(), unusedBranchItemCount );
+      const OctreeData data( dimensions_m, *pAllocator_m, stats_m );
+
+      // check if item overlaps root cell (if not, it cannot have been inserted)
+      if( OCTREE_COUNT_TEST( agent.isOverlappingCellV( pItem,
+         data.getBound().getLowerCorner(),
+         data.getBound().getUpperCorner() ) ) )
+      {
+         OctreeCell::unshare( pRootCell_m, *pAllocator_m );
+         isRemoved = pRootCell_m->remove( data, pRootCell_m, pItem, agent );
+
+         stats_m.addItems( isRemoved ? -1 : 0 );
+      }
    }
 
    return isRemoved;
 }
 
 
+void OctreeRoot::collapse()
+{
+   const OctreeData data( dimensions_m, *pAllocator_m, stats_m );
+
+   OctreeCell::collapseAll( data, pRootCell_m );
+}
+
+
 
 
 /// queries --------------------------------------------------------------------
@@ -151,7 +368,7 @@ void OctreeRoot::visit
    OctreeVisitorV& visitor
 ) const
 {
-   const OctreeData data( dimensions_m );
+   const OctreeData data( dimensions_m, *pAllocator_m );
 
    visitor.visitRootV( pRootCell_m, data );
 }
@@ -172,17 +389,20 @@ void OctreeRoot::getInfo
    dword&      maxDepth
 ) const
 {
-   byteSize  = 0;
-   leafCount = 0;
-   itemCount = 0;
-   maxDepth  = 0;
+   // (from the stats, kept by the commands, instead of visiting the cells)
+   byteSize  = rootWrapperByteSize + stats_m.getByteSize();
+   leafCount = stats_m.getLeafCount();
+   itemCount = stats_m.getItemRefCount();
+   maxDepth  = stats_m.getMaxDepth();
+}
 
-   if( pRootCell_m )
-   {
-      pRootCell_m->getInfo( byteSize, leafCount, itemCount, maxDepth );
-   }
 
-   byteSize += rootWrapperByteSize;
+void OctreeRoot::getStats
+(
+   OctreeStats& stats
+) const
+{
+   stats = stats_m;
 }
 
 
@@ -216,6 +436,18 @@ real OctreeRoot::getMinCellSize() const
 }
 
 
+dword OctreeRoot::getCollapseItemCount() const
+{
+   return dimensions_m.getCollapseItemCount();
+}
+
+
+real OctreeRoot::getLooseness() const
+{
+   return dimensions_m.getLooseness();
+}
+
+
 
 
 /// statics --------------------------------------------------------------------
@@ -245,115 +477,270 @@ void OctreeRoot::continueVisit
 /// statics --------------------------------------------------------------------
 OctreeCell* OctreeCell::cloneNonZero
 (
-   const OctreeCell* pOriginal
+   const OctreeCell* pOriginal,
+   OctreeAllocatorV& allocator
 )
 {
-   return pOriginal ? pOriginal->clone() : 0;
+   return pOriginal ? pOriginal->clone( allocator ) : 0;
 }
 
 
+void OctreeCell::deleteNonZero
+(
+   OctreeCell*       pCell,
+   OctreeAllocatorV& allocator
+)
+{
+   // destroy with the last share
+   if( pCell && (0 == OctreeAtomic::decrement( pCell->shareCount_m )) )
+   {
+      pCell->destroy( allocator );
+   }
+}
 
 
+OctreeCell* OctreeCell::shareNonZero
+(
+   const OctreeCell* pCell
+)
+{
+   if( pCell )
+   {
+      OctreeAtomic::increment( pCell->shareCount_m );
+   }
 
+   return const_cast<OctreeCell*>( pCell );
+}
 
 
-
-/// OctreeBranch ///////////////////////////////////////////////////////////////
+void OctreeCell::unshare
+(
+   OctreeCell*&      pCell,
+   OctreeAllocatorV& allocator
+)
+{
+   if( OctreeAtomic::read( pCell->shareCount_m ) > 1 )
+   {
+      // copy the cell (sharing its subcells), and drop this share of the
+      // original (destroying it, if the other sharers dropped theirs
+      // meanwhile, on other threads)
+      OctreeCell*const pCopy = pCell->isBranch() ?
+         static_cast<OctreeCell*>( new( allocator ) OctreeBranch(
+            *static_cast<const OctreeBranch*>(pCell) ) ) :
+         static_cast<OctreeCell*>( new( allocator ) OctreeLeaf(
+            *static_cast<const OctreeLeaf*>(pCell) ) );
+
+      OctreeCell::deleteNonZero( pCell, allocator );
+      pCell = pCopy;
+   }
+}
 
 
-/// standard object services ---------------------------------------------------
-OctreeBranch::OctreeBranch()
+void OctreeCell::removeStatsAll
+(
+   const OctreeCell* pCell,
+   const OctreeData& cellData
+)
 {
-   OctreeBranch::zeroSubCells();
+   // uncount the cell and all below it
+   if( pCell )
+   {
+      if( pCell->isBranch() )
+      {
+         const OctreeBranch*const pBranch =
+            static_cast<const OctreeBranch*>(pCell);
+         pBranch->removeStats( cellData );
+         for( int i = 8;  i-- > 0; )
+         {
+            OctreeCell::removeStatsAll( pBranch->subCells_m[i],
+               OctreeData( cellData, i ) );
+         }
+      }
+      else
+      {
+         static_cast<const OctreeLeaf*>(pCell)->removeStats( cellData );
+      }
+   }
 }
 
 
-OctreeBranch::OctreeBranch
+void OctreeCell::collapseAll
 (
-   const OctreeData&         thisData,
-   const Array<const void*>& items,
-   const void* const         pItem,
-   const OctreeAgentV&       agent
+   const OctreeData& cellData,
+   OctreeCell*&      pCell
 )
 {
-   OctreeBranch::zeroSubCells();
-
-   try
+   // only branchs collapse (and a shared one is unshared only if something in
+   // it collapses)
+   if( pCell && pCell->isBranch() &&
+      ((1 == OctreeAtomic::read( pCell->shareCount_m )) ||
+      static_cast<const OctreeBranch*>(pCell)->isCollapsing(
+         cellData.getDimensions().getMaxItemCountPerCell() )) )
    {
-      OctreeCell* pNotUsed = 0;
+      OctreeCell::unshare( pCell, cellData.getAllocator() );
+      static_cast<OctreeBranch*>(pCell)->collapseAll( cellData, pCell );
+   }
+}
+
 
-      // insert items
-      for( int j = items.getLength();  j-- > 0; )
+void OctreeCell::insertRangeMaybeCreate
+(
+   const OctreeData&   cellData,
+   OctreeCell*&        pCell,
+   const void* const*  pItems,
+   dword               itemCount,
+   const OctreeAgentV& agent,
+   OctreeTaskPool*     pTasks
+)
+{
+   if( itemCount > 0 )
+   {
+      // make cell if none: a branch straight away if the items would
+      // subdivide a leaf, else a leaf holding the first item (items are
+      // distinct -- the Octree interface takes an array of them)
+      if( !pCell )
+      {
+         if( cellData.isSubdivide( itemCount ) )
+         {
+            OctreeBranch*const pBranch = new( cellData.getAllocator() )
+               OctreeBranch();
+            pBranch->addStats( cellData );
+            pCell = pBranch;
+         }
+         else
+         {
+            OctreeLeaf::insertMaybeCreate( cellData, pCell, *pItems, agent );
+            ++pItems;
+            --itemCount;
+         }
+      }
+      // else add to existing cell (made unshared)
+      else
       {
-         OctreeBranch::insert( thisData, pNotUsed, items[j], agent );
+         OctreeCell::unshare( pCell, cellData.getAllocator() );
       }
 
-      // insert last item
-      OctreeBranch::insert( thisData, pNotUsed, pItem, agent );
-   }
-   catch( ... )
-   {
-      // delete any allocated cells
-      this->~OctreeBranch();
+      try
+      {
+         pCell->insertRange( cellData, pCell, pItems, itemCount, agent,
+            pTasks );
+      }
+      catch( ... )
+      {
+         // do not leave a new branch empty
+         if( 0 == pCell->getItemRefCount() )
+         {
+            OctreeCell::removeStatsAll( pCell, cellData );
+            OctreeCell::deleteNonZero( pCell, cellData.getAllocator() );
+            pCell = 0;
+         }
 
-      throw;
+         throw;
+      }
    }
 }
 
 
-OctreeBranch::~OctreeBranch()
+
+
+
+
+
+
+/// OctreeBranch ///////////////////////////////////////////////////////////////
+
+
+/// standard object services ---------------------------------------------------
+OctreeBranch::OctreeBranch()
+ : itemRefCount_m( 0 )
+ , items_m       ()
 {
-   for( int i = 8;  i-- > 0; )
-   {
-      delete subCells_m[i];
-   }
+   OctreeBranch::zeroSubCells();
 }
 
 
 OctreeBranch::OctreeBranch
 (
-   const OctreeBranch& other
+   const OctreeBranch& other,
+   OctreeAllocatorV&   allocator
 )
+ : itemRefCount_m( other.itemRefCount_m )
+ , items_m       ()
 {
    OctreeBranch::zeroSubCells();
 
+   // same capacity as well as content, so copy is the same size
+   items_m.reserve( other.items_m.getCapacity() );
+   items_m = other.items_m;
+
    try
    {
       for( int i = 8;  i-- > 0; )
       {
-         subCells_m[i] = OctreeCell::cloneNonZero( other.subCells_m[i] );
+         subCells_m[i] = OctreeCell::cloneNonZero( other.subCells_m[i],
+            allocator );
       }
    }
    catch( ... )
    {
       // delete any allocated cells
-      this->~OctreeBranch();
+      deleteSubCells( allocator );
 
       throw;
    }
 }
 
 
-OctreeBranch& OctreeBranch::operator=
+OctreeBranch::OctreeBranch
 (
    const OctreeBranch& other
 )
+ : OctreeCell()
+ , itemRefCount_m( other.itemRefCount_m )
+ , items_m       ()
 {
-   if( &other != this )
+   items_m.reserve( other.items_m.getCapacity() );
+   items_m = other.items_m;
+
+   for( int i = 8;  i-- > 0; )
    {
-      OctreeBranch copy( other );
+      subCells_m[i] = OctreeCell::shareNonZero( other.subCells_m[i] );
+   }
+}
 
-      // 'move' subCells copies to this (leaving copy empty)
-      for( int i = 8;  i-- > 0; )
-      {
-         delete subCells_m[i];
-         subCells_m[i] = copy.subCells_m[i];
 
-         copy.subCells_m[i] = 0;
-      }
-   }
+OctreeBranch::~OctreeBranch()
+{
+   // sub cells are deleted by destroy (they need the allocator)
+}
 
-   return *this;
+
+void* OctreeBranch::operator new
+(
+   size_t            ,//size,
+   OctreeAllocatorV& allocator
+)
+{
+   return allocator.allocateBranch();
+}
+
+
+void OctreeBranch::operator delete
+(
+   void*             pStorage,
+   OctreeAllocatorV& allocator
+)
+{
+   allocator.freeBranch( pStorage );
+}
+
+
+void OctreeBranch::operator delete
+(
+   void* //pStorage
+)
+{
+   // never used: cells are disposed of by OctreeCell::deleteNonZero
 }
 
 
@@ -368,88 +755,98 @@ void OctreeBranch::insert
    const OctreeAgentV& agent
 )
 {
-   // get subcell-item overlaps flags
-   const OctreeBound& bound    = thisData.getBound();
-   const dword        overlaps = agent.getSubcellOverlapsV( pItem,
-      bound.getLowerCorner(), bound.getCenter(), bound.getUpperCorner() );
-
-   // loop through sub cells
-   for( int i = 8;  i-- > 0; )
-   {
-      // check if sub cell is overlapped by item
-      if( (overlaps >> i) & 1 )
-      {
-         // make sub cell data
-         const OctreeData subCellData( thisData, i );
-
-         // add item to sub cell
-         OctreeLeaf::insertMaybeCreate( subCellData, subCells_m[i],
-            pItem, agent );
-      }
-   }
+   insertItem( thisData, pItem, agent );
 }
 
 
-bool OctreeBranch::remove
+void OctreeBranch::insertRange
 (
-   OctreeCell*&      pThis,
-   const void* const pItem,
-   const dword       maxItemsPerCell,
-   dword&            itemCount
+   const OctreeData&   thisData,
+   OctreeCell*&        ,//pThis,
+   const void* const*  pItems,
+   const dword         itemCount,
+   const OctreeAgentV& agent,
+   OctreeTaskPool*     pTasks
 )
 {
-   bool  isRemoved       = false;
-   dword branchItemCount = 0;
+   OCTREE_COUNT( addCell( thisData.getLevel() ) );
 
-   // loop through sub cells
-   for( int i = 8;  i-- > 0; )
+   // build subcells in parallel, if worthwhile
+   if( pTasks && (itemCount >= PARALLEL_ITEMS_MIN) )
    {
-      // remove item from non-null sub cell
-      OctreeCell*& pSubCell = subCells_m[i];
-      if( pSubCell )
+      insertRangeParallel( thisData, pItems, itemCount, agent, *pTasks );
+   }
+   else
+   {
+      OCTREE_COUNT( addTests( itemCount ) );
+
+      // get subcell-item overlaps flags, once for each item
+      const OctreeBound& bound = thisData.getBound();
+      Array<dword> overlaps( itemCount );
+      for( dword j = 0;  j < itemCount;  ++j )
       {
-         isRemoved |= pSubCell->remove( pSubCell, pItem, maxItemsPerCell,
-            branchItemCount );
+         overlaps[j] = agent.getSubcellOverlapsV( pItems[j],
+            bound.getLowerCorner(), bound.getCenter(),
+            bound.getUpperCorner() );
       }
-   }
 
-   itemCount += branchItemCount;
+      // hold items covering this cell here, and not in sub cells
+      holdCovering( thisData, pItems, itemCount, overlaps.getStorage(),
+         agent );
 
-   // decide whether to collapse this branch
-   if( branchItemCount > 0 )
-   {
-      // collapse to leaf
-      if( branchItemCount <= maxItemsPerCell )
+      // loop through sub cells, partitioning the items into each in turn
+      Array<const void*> subItems;
+      subItems.reserve( itemCount );
+      for( int i = 8;  i-- > 0; )
       {
-         // all subcells *will* be leafs!
-         // because:
-         // a) if a branch has below it less item refs than the threshold,
-         //    it collapses to a leaf (this function!)
-         // b) the total of item refs below this branch in the tree is less
-         //    than the threshold
-         // c) therefore the total of item refs in any branch below this
-         //    cell will be less than the threshold
-         // d) branchs below this cell will be collapsed before this branch
-         //    (because the recursive 'remove' call is before the
-         //    collapsing code)
-         // so: if this branch will collapse to a leaf, then all its sub
-         // branchs (direct and indirect) will collapse to leafs, and that
-         // will happen before this branch.
-         OctreeCell*const pLeaf = new OctreeLeaf(
-            reinterpret_cast<OctreeLeaf**>( subCells_m ) );
-
-         delete pThis;
-         pThis = pLeaf;
+         subItems.setLength( 0 );
+         for( dword j = 0;  j < itemCount;  ++j )
+         {
+            if( (overlaps[j] >> i) & 1 )
+            {
+               subItems.append( pItems[j] );
+            }
+         }
+
+         if( !subItems.isEmpty() )
+         {
+            // make sub cell data
+            const OctreeData subCellData( thisData, i );
+
+            // add items to sub cell, keeping count in step (even if it
+            // throws)
+            OctreeCell*& pSubCell = subCells_m[i];
+            const dword  subCount = pSubCell ?
+               pSubCell->getItemRefCount() : 0;
+            try
+            {
+               OctreeCell::insertRangeMaybeCreate( subCellData, pSubCell,
+                  subItems.getStorage(), subItems.getLength(), agent,
+                  pTasks );
+            }
+            catch( ... )
+            {
+               itemRefCount_m += (pSubCell ? pSubCell->getItemRefCount() :
+                  0) - subCount;
+               throw;
+            }
+
+            itemRefCount_m += pSubCell->getItemRefCount() - subCount;
+         }
       }
    }
-   else
-   {
-      // delete this branch
-      delete pThis;
-      pThis = 0;
-   }
+}
 
-   return isRemoved;
+
+bool OctreeBranch::remove
+(
+   const OctreeData&   thisData,
+   OctreeCell*&        pThis,
+   const void* const   pItem,
+   const OctreeAgentV& agent
+)
+{
+   return removeItem( thisData, pThis, pItem, agent );
 }
 
 
@@ -462,13 +859,38 @@ void OctreeBranch::visit
    OctreeVisitorV&   visitor
 ) const
 {
+   OCTREE_COUNT( addCell( thisData.getLevel() ) );
+
+   // this cell's own items first
+   if( !items_m.isEmpty() )
+   {
+      OCTREE_COUNT( addItemScans( items_m.getLength() ) );
+
+      visitor.visitBranchItemsV( items_m, thisData );
+   }
+
    visitor.visitBranchV( const_cast<const OctreeCell**>(subCells_m), thisData );
 }
 
 
-OctreeCell* OctreeBranch::clone() const
+OctreeCell* OctreeBranch::clone
+(
+   OctreeAllocatorV& allocator
+) const
+{
+   return new( allocator ) OctreeBranch( *this, allocator );
+}
+
+
+dword OctreeBranch::getItemRefCount() const
+{
+   return itemRefCount_m;
+}
+
+
+bool OctreeBranch::isBranch() const
 {
-   return new OctreeBranch( *this );
+   return true;
 }
 
 
@@ -480,7 +902,8 @@ void OctreeBranch::getInfo
    dword& maxDepth
 ) const
 {
-   byteSize += sizeof(*this);
+   byteSize  += getByteSize();
+   itemCount += items_m.getLength();
 
    const dword thisDepth = maxDepth + 1;
 
@@ -524,6 +947,18 @@ void OctreeBranch::continueVisit
 
 
 /// implementation -------------------------------------------------------------
+void OctreeBranch::destroy
+(
+   OctreeAllocatorV& allocator
+)
+{
+   deleteSubCells( allocator );
+
+   this->~OctreeBranch();
+   allocator.freeBranch( this );
+}
+
+
 void OctreeBranch::zeroSubCells()
 {
    for( int i = 8;  i-- > 0; )
@@ -533,6 +968,329 @@ void OctreeBranch::zeroSubCells()
 }
 
 
+void OctreeBranch::deleteSubCells
+(
+   OctreeAllocatorV& allocator
+)
+{
+   for( int i = 8;  i-- > 0; )
+   {
+      OctreeCell::deleteNonZero( subCells_m[i], allocator );
+      subCells_m[i] = 0;
+   }
+}
+
+
+void OctreeBranch::collapseMaybe
+(
+   const OctreeData& thisData,
+   OctreeCell*&      pThis
+)
+{
+   // decide whether to collapse this branch
+   if( itemRefCount_m > 0 )
+   {
+      // collapse to leaf
+      if( thisData.getDimensions().isCollapse( itemRefCount_m ) )
+      {
+         // all subcells *will* be leafs!
+         // because:
+         // a) a branch is only made when a leaf exceeds the threshold, and
+         //    whenever a branch falls to the collapse count (at most the
+         //    threshold) it collapses to a leaf (this function!, or
+         //    collapseAll, at the threshold itself), so every branch holds
+         //    more item refs than the collapse count
+         // b) the total of item refs below this branch in the tree is not more
+         //    than the collapse count
+         // c) therefore no cell below this branch can be a branch
+         // (sub branchs not on the removal path are unchanged, so they still
+         // hold more than the collapse count, so cannot be below this one)
+         collapse( thisData, pThis );
+      }
+   }
+   else
+   {
+      // delete this branch
+      removeStats( thisData );
+      OctreeCell::deleteNonZero( pThis, thisData.getAllocator() );
+      pThis = 0;
+   }
+}
+
+
+void OctreeBranch::collapseAll
+(
+   const OctreeData& thisData,
+   OctreeCell*&      pThis
+)
+{
+   // collapse the subcells first, so if this collapses, all below are leafs
+   for( int i = 8;  i-- > 0; )
+   {
+      OctreeCell::collapseAll( OctreeData( thisData, i ), subCells_m[i] );
+   }
+
+   // (this may be deleted)
+   if( itemRefCount_m <= thisData.getDimensions().getMaxItemCountPerCell() )
+   {
+      collapse( thisData, pThis );
+   }
+}
+
+
+void OctreeBranch::collapse
+(
+   const OctreeData& thisData,
+   OctreeCell*&      pThis
+)
+{
+   // merge the subcells, which must all be leafs, into one leaf
+   // (this branch's own items go into the leaf too)
+   OctreeLeaf*const pLeaf = new( thisData.getAllocator() ) OctreeLeaf(
+      reinterpret_cast<OctreeLeaf**>( subCells_m ), items_m );
+
+   OctreeCell::removeStatsAll( this, thisData );
+   pLeaf->addStats( thisData );
+   OctreeCell::deleteNonZero( pThis, thisData.getAllocator() );
+   pThis = pLeaf;
+}
+
+
+bool OctreeBranch::isCollapsing
+(
+   const dword maxItemCount
+) const
+{
+   // check if this, or any branch below, holds few enough to collapse
+   bool isCollapsing = (itemRefCount_m <= maxItemCount);
+   for( int i = 8;  (i-- > 0) & !isCollapsing; )
+   {
+      isCollapsing = subCells_m[i] && subCells_m[i]->isBranch() &&
+         static_cast<const OctreeBranch*>(subCells_m[i])->isCollapsing(
+            maxItemCount );
+   }
+
+   return isCollapsing;
+}
+
+
+void OctreeBranch::insertRangeParallel
+(
+   const OctreeData&   thisData,
+   const void* const*  pItems,
+   const dword         itemCount,
+   const OctreeAgentV& agent,
+   OctreeTaskPool&     tasks
+)
+{
+   // get subcell-item overlaps flags, split into parts for the tasks
+   Array<dword> overlaps( itemCount );
+   {
+      OverlapsTask overlapsTasks[ OVERLAPS_TASK_COUNT ];
+      OctreeTaskV* pOverlapsTasks[ OVERLAPS_TASK_COUNT ];
+      const dword  partLength = (itemCount + OVERLAPS_TASK_COUNT - 1) /
+         OVERLAPS_TASK_COUNT;
+      for( dword t = 0, begin = 0;  t < OVERLAPS_TASK_COUNT;  ++t )
+      {
+         const dword end = (itemCount - begin > partLength) ?
+            (begin + partLength) : itemCount;
+         overlapsTasks[t].set( thisData, agent, pItems, begin, end,
+            overlaps.getStorage() );
+         pOverlapsTasks[t] = &overlapsTasks[t];
+         begin = end;
+      }
+      tasks.runAll( pOverlapsTasks, OVERLAPS_TASK_COUNT );
+   }
+
+   // hold items covering this cell here, and not in sub cells
+   holdCovering( thisData, pItems, itemCount, overlaps.getStorage(), agent );
+
+   // partition the items into all sub cells at once
+   Array<const void*> subItems[8];
+   for( int i = 8;  i-- > 0; )
+   {
+      dword subLength = 0;
+      for( dword j = 0;  j < itemCount;  ++j )
+      {
+         subLength += (overlaps[j] >> i) & 1;
+      }
+      subItems[i].reserve( subLength );
+
+      for( dword j = 0;  j < itemCount;  ++j )
+      {
+         if( (overlaps[j] >> i) & 1 )
+         {
+            subItems[i].append( pItems[j] );
+         }
+      }
+   }
+
+   // add items to each sub cell as a task (tasks touch only their own sub
+   // cell, and the allocator is shared safely)
+   SubCellTask  subCellTasks[8];
+   OctreeTaskV* pSubCellTasks[8];
+   dword        taskCount = 0;
+   for( int i = 8;  i-- > 0; )
+   {
+      if( !subItems[i].isEmpty() )
+      {
+         subCellTasks[i].set( thisData, i, subCells_m[i], subItems[i], agent,
+            tasks );
+         pSubCellTasks[taskCount++] = &subCellTasks[i];
+      }
+   }
+
+   // keep counts in step (even if it throws)
+   try
+   {
+      tasks.runAll( pSubCellTasks, taskCount );
+   }
+   catch( ... )
+   {
+      sumItemRefCount();
+      for( int i = 8;  i-- > 0; )
+      {
+         thisData.getStats().add( subCellTasks[i].getStats() );
+      }
+      throw;
+   }
+
+   // (add in the tasks' stats here, on one thread)
+   sumItemRefCount();
+   for( int i = 8;  i-- > 0; )
+   {
+      thisData.getStats().add( subCellTasks[i].getStats() );
+   }
+}
+
+
+void OctreeBranch::holdItem
+(
+   const OctreeData& thisData,
+   const void* const pItem
+)
+{
+   OCTREE_COUNT( addItemScans( items_m.getLength() ) );
+
+   // check item isn't already held
+   bool isHeld = false;
+   for( int i = items_m.getLength();  (i-- > 0) && !isHeld; )
+   {
+      isHeld = (pItem == items_m[i]);
+   }
+
+   if( !isHeld )
+   {
+      // add item, counting it and any growth
+      const dword capacity = items_m.getCapacity();
+      items_m.append( pItem );
+      ++itemRefCount_m;
+
+      thisData.getStats().addBranchItems( 1, (items_m.getCapacity() -
+         capacity) * sizeof(void*) );
+   }
+}
+
+
+bool OctreeBranch::releaseItem
+(
+   const OctreeData& thisData,
+   const void* const pItem
+)
+{
+   bool isRemoved = false;
+
+   OCTREE_COUNT( addItemScans( items_m.getLength() ) );
+
+   // find and remove item (order of items is not significant)
+   const dword capacity = items_m.getCapacity();
+   for( int i = items_m.getLength();  (i-- > 0) && !isRemoved; )
+   {
+      if( items_m[i] == pItem )
+      {
+         items_m.removeUnordered( i );
+         isRemoved = true;
+      }
+   }
+
+   if( isRemoved )
+   {
+      // free storage when empty
+      if( items_m.isEmpty() )
+      {
+         Array<const void*> empty;
+         items_m.swap( empty );
+      }
+      --itemRefCount_m;
+
+      thisData.getStats().removeBranchItems( 1, (capacity -
+         items_m.getCapacity()) * sizeof(void*) );
+   }
+
+   return isRemoved;
+}
+
+
+void OctreeBranch::holdCovering
+(
+   const OctreeData&   thisData,
+   const void* const*  pItems,
+   const dword         itemCount,
+   dword*const         pOverlaps,
+   const OctreeAgentV& agent
+)
+{
+   for( dword j = 0;  j < itemCount;  ++j )
+   {
+      if( isCovering( thisData, pItems[j], pOverlaps[j], agent ) )
+      {
+         holdItem( thisData, pItems[j] );
+         pOverlaps[j] = 0;
+      }
+   }
+}
+
+
+dword OctreeBranch::getByteSize() const
+{
+   return sizeof(*this) + (items_m.getCapacity() * sizeof(void*));
+}
+
+
+void OctreeBranch::addStats
+(
+   const OctreeData& thisData
+) const
+{
+   OctreeStats& stats = thisData.getStats();
+   stats.addBranch( thisData.getLevel(), sizeof(*this) );
+   stats.addBranchItems( items_m.getLength(), items_m.getCapacity() *
+      sizeof(void*) );
+}
+
+
+void OctreeBranch::removeStats
+(
+   const OctreeData& thisData
+) const
+{
+   OctreeStats& stats = thisData.getStats();
+   stats.removeBranch( thisData.getLevel(), sizeof(*this) );
+   stats.removeBranchItems( items_m.getLength(), items_m.getCapacity() *
+      sizeof(void*) );
+}
+
+
+void OctreeBranch::sumItemRefCount()
+{
+   itemRefCount_m = items_m.getLength();
+   for( int i = 8;  i-- > 0; )
+   {
+      itemRefCount_m += subCells_m[i] ? subCells_m[i]->getItemRefCount() : 0;
+   }
+}
+
+
 
 
 
@@ -544,7 +1302,7 @@ void OctreeBranch::zeroSubCells()
 
 /// standard object services ---------------------------------------------------
 OctreeLeaf::OctreeLeaf()
- : items_m()
+ : items_m( inlineItems_m, OCTREE_LEAF_INLINE_ITEMS )
 {
 }
 
@@ -553,7 +1311,7 @@ OctreeLeaf::OctreeLeaf
 (
    const void* pItem
 )
- : items_m()
+ : items_m( inlineItems_m, OCTREE_LEAF_INLINE_ITEMS )
 {
    items_m.append( pItem );
 }
@@ -561,12 +1319,13 @@ OctreeLeaf::OctreeLeaf
 
 OctreeLeaf::OctreeLeaf
 (
-   const OctreeLeaf*const leafs[8]
+   const OctreeLeaf*const    leafs[8],
+   const Array<const void*>& items
 )
- : items_m()
+ : items_m( inlineItems_m, OCTREE_LEAF_INLINE_ITEMS )
 {
    // sum all items lengths
-   dword totalLength = 0;
+   dword totalLength = items.getLength();
    for( int i = 8;  i-- > 0; )
    {
       const OctreeLeaf*const pLeaf = leafs[i];
@@ -579,8 +1338,12 @@ OctreeLeaf::OctreeLeaf
    // prepare items array to hold all other items
    items_m.setLength( totalLength );
 
-   // copy items arrays
+   // copy items arrays (the given items first)
    const void** pElement = items_m.getStorage();
+   for( dword i = 0;  i < items.getLength();  ++i, ++pElement )
+   {
+      *pElement = items[i];
+   }
    for( int i = 0;  i < 8;  ++i )
    {
       const OctreeLeaf*const pLeaf = leafs[i];
@@ -607,8 +1370,12 @@ OctreeLeaf::OctreeLeaf
 (
    const OctreeLeaf& other
 )
- : items_m( other.items_m )
+ : items_m( inlineItems_m, OCTREE_LEAF_INLINE_ITEMS )
 {
+   // same capacity as well as content, so copy is the same size (reserve does
+   // nothing if the other is inline too)
+   items_m.reserve( other.items_m.getCapacity() );
+   items_m = other.items_m;
 }
 
 
@@ -623,6 +1390,35 @@ OctreeLeaf& OctreeLeaf::operator=
 }
 
 
+void* OctreeLeaf::operator new
+(
+   size_t            ,//size,
+   OctreeAllocatorV& allocator
+)
+{
+   return allocator.allocateLeaf();
+}
+
+
+void OctreeLeaf::operator delete
+(
+   void*             pStorage,
+   OctreeAllocatorV& allocator
+)
+{
+   allocator.freeLeaf( pStorage );
+}
+
+
+void OctreeLeaf::operator delete
+(
+   void* //pStorage
+)
+{
+   // never used: cells are disposed of by OctreeCell::deleteNonZero
+}
+
+
 
 
 /// commands -------------------------------------------------------------------
@@ -634,71 +1430,93 @@ void OctreeLeaf::insert
    const OctreeAgentV& agent
 )
 {
-   // check if item already present
-   bool isAlreadyPresent = false;
-   for( int i = items_m.getLength();  (i-- > 0) & !isAlreadyPresent; )
+   insertItem( thisData, pThis, pItem, agent );
+}
+
+
+void OctreeLeaf::insertRange
+(
+   const OctreeData&   thisData,
+   OctreeCell*&        pThis,
+   const void* const*  pItems,
+   const dword         itemCount,
+   const OctreeAgentV& agent,
+   OctreeTaskPool*     pTasks
+)
+{
+   // insert one at a time, while this is still a leaf
+   dword i = 0;
+   for( ;  (i < itemCount) && (pThis == this);  ++i )
    {
-      isAlreadyPresent |= (pItem == items_m[i]);
+      OctreeLeaf::insert( thisData, pThis, pItems[i], agent );
    }
 
-   // only insert if item not already present
-   if( !isAlreadyPresent )
+   // pass the rest to the branch this subdivided into (this is now deleted)
+   if( i < itemCount )
    {
-      // check if leaf should be subdivided
-      if( !thisData.isSubdivide( items_m.getLength() + 1 ) )
-      {
-         // append item to collection
-         items_m.append( pItem );
-      }
-      else
-      {
-         // subdivide by making branch and adding items to it
-         OctreeCell*const pBranch = new OctreeBranch( thisData, items_m, pItem,
-            agent );
-
-         // replace this with branch
-         delete pThis;
-         pThis = pBranch;
-      }
+      pThis->insertRange( thisData, pThis, pItems + i, itemCount - i, agent,
+         pTasks );
    }
 }
 
 
 bool OctreeLeaf::remove
 (
+   const OctreeData&   thisData,
+   OctreeCell*&        pThis,
+   const void* const   pItem,
+   const OctreeAgentV& //agent
+)
+{
+   return removeItem( thisData, pThis, pItem );
+}
+
+
+bool OctreeLeaf::removeItem
+(
+   const OctreeData& thisData,
    OctreeCell*&      pThis,
-   const void* const pItem,
-   const dword       ,//maxItemsPerCell,
-   dword&            itemCount
+   const void* const pItem
 )
 {
    bool isRemoved = false;
 
-   // loop through items
-   for( int i = 0;  i < items_m.getLength(); )
+   OCTREE_COUNT( addCell( thisData.getLevel() ) );
+   OCTREE_COUNT( addItemScans( items_m.getLength() ) );
+
+   // (recounted after, if still here)
+   removeStats( thisData );
+
+   // loop through items (backwards, since removal moves the last item)
+   for( int i = items_m.getLength();  i-- > 0; )
    {
       // check if item is present
       if( items_m[i] == pItem )
       {
-         // remove item
-         items_m.remove( i );
+         // remove item (order of items is not significant)
+         items_m.removeUnordered( i );
          isRemoved = true;
       }
-      else
-      {
-         ++i;
-      }
    }
 
-   itemCount += items_m.getLength();
-
    // check if leaf is now empty
    if( items_m.isEmpty() )
    {
       // remove this leaf
-      delete pThis;
+      OctreeCell::deleteNonZero( pThis, thisData.getAllocator() );
       pThis = 0;
    }
+   else
+   {
+      // move back inline when well inside (so as not to thrash at the limit)
+      if( !items_m.isStorageExternal() &&
+         (items_m.getLength() <= (OCTREE_LEAF_INLINE_ITEMS / 2)) )
+      {
+         items_m.useExternalStorage( inlineItems_m, OCTREE_LEAF_INLINE_ITEMS );
+      }
+
+      addStats( thisData );
+   }
 
    return isRemoved;
 }
@@ -713,13 +1531,31 @@ void OctreeLeaf::visit
    OctreeVisitorV&   visitor
 ) const
 {
+   OCTREE_COUNT( addCell( thisData.getLevel() ) );
+   OCTREE_COUNT( addItemScans( items_m.getLength() ) );
+
    visitor.visitLeafV( items_m, thisData );
 }
 
 
-OctreeCell* OctreeLeaf::clone() const
+OctreeCell* OctreeLeaf::clone
+(
+   OctreeAllocatorV& allocator
+) const
+{
+   return new( allocator ) OctreeLeaf( *this );
+}
+
+
+dword OctreeLeaf::getItemRefCount() const
+{
+   return items_m.getLength();
+}
+
+
+bool OctreeLeaf::isBranch() const
 {
-   return new OctreeLeaf( *this );
+   return false;
 }
 
 
@@ -731,7 +1567,7 @@ void OctreeLeaf::getInfo
    dword& maxDepth
 ) const
 {
-   byteSize  += sizeof(*this) + (items_m.getLength() * sizeof(void*));
+   byteSize  += getByteSize();
    ++leafCount;
    itemCount += items_m.getLength();
    ++maxDepth;
@@ -753,15 +1589,97 @@ void OctreeLeaf::insertMaybeCreate
    if( !pCell )
    {
       // make leaf, adding item
-      OctreeCell*const pLeaf = new OctreeLeaf( pItem );
-
-      // replace cell with leaf
-      delete pCell;
+      OctreeLeaf*const pLeaf = new( cellData.getAllocator() ) OctreeLeaf(
+         pItem );
+      pLeaf->addStats( cellData );
       pCell = pLeaf;
    }
    else
    {
-      // forward to existing cell
+      // forward to existing cell (made unshared)
+      OctreeCell::unshare( pCell, cellData.getAllocator() );
       pCell->insert( cellData, pCell, pItem, agent );
    }
 }
+
+
+
+
+/// implementation -------------------------------------------------------------
+void OctreeLeaf::destroy
+(
+   OctreeAllocatorV& allocator
+)
+{
+   this->~OctreeLeaf();
+   allocator.freeLeaf( this );
+}
+
+
+bool OctreeLeaf::hasItem
+(
+   const void* const pItem
+) const
+{
+   bool isPresent = false;
+   for( int i = items_m.getLength();  (i-- > 0) & !isPresent; )
+   {
+      isPresent |= (pItem == items_m[i]);
+   }
+
+   return isPresent;
+}
+
+
+void OctreeLeaf::appendItem
+(
+   const OctreeData& thisData,
+   const void* const pItem
+)
+{
+   const dword byteSize = getByteSize();
+
+   // grow storage geometrically, but not past the subdivision limit
+   const dword length   = items_m.getLength();
+   const dword maxItems = thisData.getDimensions().getMaxItemCountPerCell();
+   if( (length == items_m.getCapacity()) & (length < maxItems) )
+   {
+      const dword doubled = (length > 0) ? (length * 2) : 1;
+      items_m.reserve( (doubled < maxItems) ? doubled : maxItems );
+   }
+
+   // append item to collection
+   items_m.append( pItem );
+
+   // recount (after anything that can throw)
+   thisData.getStats().removeLeaf( thisData.getLevel(), length, byteSize );
+   addStats( thisData );
+}
+
+
+dword OctreeLeaf::getByteSize() const
+{
+   // inline items are already counted in the node size
+   return sizeof(*this) + (items_m.isStorageExternal() ? 0 :
+      (items_m.getCapacity() * sizeof(void*)));
+}
+
+
+void OctreeLeaf::addStats
+(
+   const OctreeData& thisData
+) const
+{
+   thisData.getStats().addLeaf( thisData.getLevel(), items_m.getLength(),
+      getByteSize() );
+}
+
+
+void OctreeLeaf::removeStats
+(
+   const OctreeData& thisData
+) const
+{
+   thisData.getStats().removeLeaf( thisData.getLevel(), items_m.getLength(),
+      getByteSize() );
+}
@@ -40,13 +40,31 @@ OF SUCH DAMAGE.
 #define OctreeImplementation_h
 
 
+#include <stddef.h>
+
 #include "OctreeAuxiliary.hpp"
+#include "OctreeTasks.hpp"
+
+
+
+
+/**
+ * Number of item pointers a leaf holds inside itself, before moving them to
+ * separate storage (at least 1).<br/><br/>
+ *
+ * Define before including (or in the build) to change -- it must be the same
+ * for all translation units.
+ */
+#ifndef OCTREE_LEAF_INLINE_ITEMS
+#define OCTREE_LEAF_INLINE_ITEMS 4
+#endif
 
 
 
 
 namespace hxa7241_graphics
 {
+   class OctreeTaskPool;
 
 
 /**
@@ -59,32 +77,94 @@ namespace hxa7241_graphics
  * At destruction, pRootCell_m is deleted.<br/>
  * Whenever pRootCell_m is modified, it must be deleted then set to a legal
  * value.<br/>
- * A legal value is: either 0, or the value from invocation of 'new'.
+ * A legal value is: either 0, or the value from invocation of 'new' with
+ * *pAllocator_m.<br/><br/>
+ *
+ * The allocator is not owned, and is used by this root only (so at
+ * destruction, if it can, it frees the whole tree at once) -- unless this is
+ * a sharing copy.<br/><br/>
+ *
+ * A sharing copy (made by the copy constructor, or by copying or assigning
+ * from a root on the same allocator) holds the same cells as the other root,
+ * in O(1): cells count their sharers, and whichever root changes a shared cell
+ * first copies it (and the path to it). It uses the other's allocator, never
+ * frees the whole tree at once, and must be destroyed before the other
+ * (unless the allocator stops freeing all while both remain, as
+ * OctreeAllocatorShared does). Sharers are counted atomically, so the two
+ * can be on different threads if the allocator can (as OctreeAllocatorShared
+ * can, locking while shared). Being a sharing copy is fixed at construction,
+ * since assigning never changes the allocator: an original assigned from its
+ * copy still frees all at once (its copies being gone by then), and a sharing
+ * copy assigned from an unrelated root still never does.<br/><br/>
+ *
+ * An item covering a whole branch's cell (by the agent's isCoveringCellV) is
+ * held once, on the branch, instead of in every leaf below it (see
+ * OctreeBranch).<br/><br/>
+ *
+ * remove collapses a branch to a leaf when it falls to the collapse item
+ * count; collapse does so for every branch at or below maxItemsPerCell, so a
+ * tree made with a lower collapse count (or 0, collapsing only empty
+ * branches) can be tidied when idle. collapse copies a shared branch only if
+ * something in it collapses.<br/><br/>
+ *
+ * stats_m counts the cells and items: the commands give it to the cells, in
+ * the OctreeData, to count what they make and delete (on other threads, into
+ * stats of their own, added in after). So getInfo and getStats are O(1).
+ * A copy copies it too.<br/><br/>
+ *
+ * The ___Static commands and query are templated on the agent and query
+ * types, so their calls are resolved at compile time (and can be inlined).
+ * AGENT has isOverlappingCellV and getSubcellOverlapsV members, as
+ * OctreeAgentV but not necessarily virtual. QUERY is as for OctreeFrozenRoot
+ * (and for queryNearest, as OctreeFrozenRoot::queryNearest). Cells are told
+ * apart with one virtual call (isBranch) each.
  */
 class OctreeRoot
 {
 /// standard object services ---------------------------------------------------
 public:
-            OctreeRoot( const Vector3r& position,
-                        real            sizeOfCube,
-                        dword           maxItemsPerCell,
-                        dword           maxLevelCount,
-                        real            minCellSize );
+            OctreeRoot( const Vector3r&   position,
+                        real              sizeOfCube,
+                        dword             maxItemsPerCell,
+                        dword             maxLevelCount,
+                        real              minCellSize,
+                        dword             collapseItemCount,
+                        OctreeAllocatorV& allocator,
+                        real              looseness = 2.0f );
+            OctreeRoot( const OctreeRoot& other,
+                        OctreeAllocatorV& allocator );
+            OctreeRoot( const OctreeRoot& other );
 
            ~OctreeRoot();
-            OctreeRoot( const OctreeRoot& );
    OctreeRoot& operator=( const OctreeRoot& );
 
 
 /// commands -------------------------------------------------------------------
            bool  insert( const void*         pItem,
                          const OctreeAgentV& agent );
+           dword insertRange( const void* const*  pItems,
+                              dword               itemCount,
+                              const OctreeAgentV& agent,
+                              dword               threadCount );
            bool  remove( const void*         pItem,
                          const OctreeAgentV& agent );
+           void  collapse();
+
+   template<class AGENT>
+           bool  insertStatic( const void*  pItem,
+                               const AGENT& agent );
+   template<class AGENT>
+           bool  removeStatic( const void*  pItem,
+                               const AGENT& agent );
 
 
 /// queries --------------------------------------------------------------------
            void  visit( OctreeVisitorV& visitor )                         const;
+   template<class QUERY>
+           void  query( QUERY& query,
+                        dword  subCellOrder = 0 )                         const;
+   template<class QUERY>
+           void  queryNearest( QUERY& query )                             const;
 
            bool  isEmpty()                                                const;
            void  getInfo( dword  rootWrapperByteSize,
@@ -92,12 +172,15 @@ public:
                           dword& leafCount,
                           dword& itemCount,
                           dword& maxDepth )                               const;
+           void  getStats( OctreeStats& stats )                           const;
 
            const Vector3r& getPosition()                                  const;
            real            getSize()                                      const;
            dword           getMaxItemCountPerCell()                       const;
            dword           getMaxLevelCount()                             const;
            real            getMinCellSize()                               const;
+           dword           getCollapseItemCount()                         const;
+           real            getLooseness()                                 const;
 
 
 /// statics --------------------------------------------------------------------
@@ -106,17 +189,43 @@ public:
                                 OctreeVisitorV&   visitor );
 
 
+/// implementation -------------------------------------------------------------
+protected:
+   struct NearCell
+   {
+      real              distance;
+      const OctreeCell* pCell;
+      OctreeData        data;
+   };
+
+
 /// fields ---------------------------------------------------------------------
 private:
-   OctreeDimensions dimensions_m;
-   OctreeCell*      pRootCell_m;
+   OctreeDimensions  dimensions_m;
+   OctreeAllocatorV* pAllocator_m;
+   OctreeCell*       pRootCell_m;
+   bool              isSharing_m;
+   OctreeStats       stats_m;
 };
 
 
 
 
 /**
- * Abstract base for Composite types, for implementing Octree nodes.
+ * Abstract base for Composite types, for implementing Octree nodes.<br/><br/>
+ *
+ * Cells are made with placement new on an OctreeAllocatorV, and disposed of
+ * with deleteNonZero, never with delete.<br/><br/>
+ *
+ * A cell can be shared, by several parents or roots (see OctreeRoot): then
+ * deleteNonZero only drops one share, and the cell is destroyed with the last.
+ * A shared cell is never changed: the commands first unshare it (replacing it
+ * with a copy of its own, that shares its subcells). Shares are counted
+ * atomically, so sharers may be on different threads.<br/><br/>
+ *
+ * The ___Static functions work on OctreeBranch and OctreeLeaf only (not cell
+ * views), telling them apart with isBranch, and calling their templated
+ * members directly.
  *
  * @implementation
  * Subcell numbering:
@@ -136,7 +245,7 @@ class OctreeCell
 {
 /// standard object services ---------------------------------------------------
 protected:
-            OctreeCell() {}
+            OctreeCell() : shareCount_m( 1 ) {}
 public:
    virtual ~OctreeCell() {}
 private:
@@ -150,17 +259,26 @@ public:
                          OctreeCell*&        pThis,
                          const void*         pItem,
                          const OctreeAgentV& agent )                         =0;
-   virtual bool  remove( OctreeCell*&        pThis,
+   virtual void  insertRange( const OctreeData&   thisData,
+                              OctreeCell*&        pThis,
+                              const void* const*  pItems,
+                              dword               itemCount,
+                              const OctreeAgentV& agent,
+                              OctreeTaskPool*     pTasks )                   =0;
+   virtual bool  remove( const OctreeData&   thisData,
+                         OctreeCell*&        pThis,
                          const void*         pItem,
-                         const dword         maxItemsPerCell,
-                         dword&              itemCount )                     =0;
+                         const OctreeAgentV& agent )                         =0;
 
 
 /// queries --------------------------------------------------------------------
    virtual void  visit( const OctreeData& thisData,
                         OctreeVisitorV&   visitor )                    const =0;
 
-   virtual OctreeCell* clone()                                         const =0;
+   virtual OctreeCell* clone( OctreeAllocatorV& allocator )            const =0;
+
+   virtual dword getItemRefCount()                                     const =0;
+   virtual bool  isBranch()                                            const =0;
 
    virtual void  getInfo( dword& byteSize,
                           dword& leafCount,
@@ -169,7 +287,52 @@ public:
 
 
 /// statics --------------------------------------------------------------------
-   static  OctreeCell* cloneNonZero( const OctreeCell* );
+   static  OctreeCell* cloneNonZero ( const OctreeCell* pOriginal,
+                                      OctreeAllocatorV& allocator );
+   static  void        deleteNonZero( OctreeCell*       pCell,
+                                      OctreeAllocatorV& allocator );
+   static  OctreeCell* shareNonZero ( const OctreeCell* pCell );
+   static  void        unshare      ( OctreeCell*&      pCell,
+                                      OctreeAllocatorV& allocator );
+   static  void        removeStatsAll( const OctreeCell* pCell,
+                                       const OctreeData& cellData );
+   static  void        collapseAll  ( const OctreeData& cellData,
+                                      OctreeCell*&      pCell );
+
+   template<class AGENT>
+   static  void        insertStatic( const OctreeData& cellData,
+                                     OctreeCell*&      pCell,
+                                     const void*       pItem,
+                                     const AGENT&      agent );
+   template<class AGENT>
+   static  bool        removeStatic( const OctreeData& cellData,
+                                     OctreeCell*&      pCell,
+                                     const void*       pItem,
+                                     const AGENT&      agent );
+   template<class QUERY>
+   static  void        queryStatic ( const OctreeCell* pCell,
+                                     const OctreeData& cellData,
+                                     QUERY&            query,
+                                     dword             subCellOrder );
+
+   static  void        insertRangeMaybeCreate( const OctreeData&   cellData,
+                                               OctreeCell*&        pCell,
+                                               const void* const*  pItems,
+                                               dword               itemCount,
+                                               const OctreeAgentV& agent,
+                                               OctreeTaskPool*     pTasks );
+
+
+/// implementation -------------------------------------------------------------
+protected:
+   virtual void  destroy( OctreeAllocatorV& allocator )                      =0;
+
+
+/// fields ---------------------------------------------------------------------
+private:
+   // sharers bookkeeping, not content (so changed by sharing a const cell),
+   // by OctreeAtomic only
+   mutable dword shareCount_m;
 };
 
 
@@ -178,25 +341,56 @@ public:
 /**
  * Inner node implementation of an octree cell.<br/><br/>
  *
- * Stores pointers to eight (at most) child cells.
+ * Stores pointers to eight (at most) child cells, the items covering this
+ * cell, and the total count of item pointers in itself and all below.
+ * <br/><br/>
+ *
+ * An item overlapping all eight subcells is asked if it covers this cell (by
+ * the agent's isCoveringCellV). If so it is held here, once, instead of being
+ * added to the subcells (and so to every leaf below, splitting them). Insert
+ * and remove ask the same, so find it in the same place. Visits give a
+ * branch's items before its subcells: to visitBranchItemsV, and to a query's
+ * visitLeaf with the branch's data.<br/><br/>
+ *
+ * The copy constructor is shallow: the copy shares the subcells (and copies
+ * the items).
  *
  * @invariants
- * subCells_m elements can be null, or point to an OctreeCell instance.
+ * subCells_m elements can be null, or point to an OctreeCell instance.<br/>
+ * items_m holds each item at most once, and only items covering this cell.
+ * <br/>
+ * itemRefCount_m equals the length of items_m plus the sum of getItemRefCount
+ * of the non-null subCells_m elements.<br/>
  */
 class OctreeBranch
    : public OctreeCell
 {
+   friend class OctreeRoot;
+   friend class OctreeCell;
+   friend class OctreeStripedRoot;
+
 /// standard object services ---------------------------------------------------
 public:
             OctreeBranch();
+   template<class AGENT>
             OctreeBranch( const OctreeData&         thisData,
                           const Array<const void*>& items,
                           const void* const         pItem,
-                          const OctreeAgentV&       agent );
+                          const AGENT&              agent );
+            OctreeBranch( const OctreeBranch& other,
+                          OctreeAllocatorV&   allocator );
 
    virtual ~OctreeBranch();
+private:
             OctreeBranch( const OctreeBranch& );
    OctreeBranch& operator=( const OctreeBranch& );
+public:
+
+   static  void* operator new   ( size_t, OctreeAllocatorV& );
+   static  void  operator delete( void*,  OctreeAllocatorV& );
+private:
+   static  void  operator delete( void* );
+public:
 
 
 /// commands -------------------------------------------------------------------
@@ -204,23 +398,52 @@ public:
                          OctreeCell*&        pThis,
                          const void*         pItem,
                          const OctreeAgentV& agent );
-   virtual bool  remove( OctreeCell*&        pThis,
+   virtual void  insertRange( const OctreeData&   thisData,
+                              OctreeCell*&        pThis,
+                              const void* const*  pItems,
+                              dword               itemCount,
+                              const OctreeAgentV& agent,
+                              OctreeTaskPool*     pTasks );
+   virtual bool  remove( const OctreeData&   thisData,
+                         OctreeCell*&        pThis,
                          const void*         pItem,
-                         const dword         maxItemsPerCell,
-                         dword&              itemCount );
+                         const OctreeAgentV& agent );
+
+   template<class AGENT>
+           void  insertItem( const OctreeData& thisData,
+                             const void*       pItem,
+                             const AGENT&      agent );
+   template<class AGENT>
+           bool  removeItem( const OctreeData& thisData,
+                             OctreeCell*&      pThis,
+                             const void*       pItem,
+                             const AGENT&      agent );
 
 
 /// queries --------------------------------------------------------------------
    virtual void  visit( const OctreeData& thisData,
                         OctreeVisitorV&   visitor )                       const;
+   template<class QUERY>
+           void  query( const OctreeData& thisData,
+                        QUERY&            query,
+                        dword             subCellOrder )                  const;
+   template<class QUERY>
+           void  queryItems( const OctreeData& thisData,
+                             QUERY&            query )                    const;
+
+   virtual OctreeCell* clone( OctreeAllocatorV& allocator )               const;
 
-   virtual OctreeCell* clone()                                            const;
+   virtual dword getItemRefCount()                                        const;
+   virtual bool  isBranch()                                               const;
 
    virtual void  getInfo( dword& byteSize,
                           dword& leafCount,
                           dword& itemCount,
                           dword& maxDepth )                               const;
 
+           void  addStats   ( const OctreeData& thisData )                const;
+           void  removeStats( const OctreeData& thisData )                const;
+
 
 /// statics --------------------------------------------------------------------
    static  void  continueVisit( const OctreeCell* subCells[8],
@@ -231,12 +454,48 @@ public:
 
 /// implementation -------------------------------------------------------------
 protected:
+   virtual void  destroy( OctreeAllocatorV& allocator );
+
    virtual void  zeroSubCells();
+           void  deleteSubCells( OctreeAllocatorV& allocator );
+           void  collapseMaybe( const OctreeData& thisData,
+                                OctreeCell*&      pThis );
+           void  collapseAll  ( const OctreeData& thisData,
+                                OctreeCell*&      pThis );
+           void  collapse     ( const OctreeData& thisData,
+                                OctreeCell*&      pThis );
+           bool  isCollapsing ( dword maxItemCount )                      const;
+
+   template<class AGENT>
+   static  bool  isCovering( const OctreeData& thisData,
+                             const void*       pItem,
+                             dword             overlaps,
+                             const AGENT&      agent );
+           void  holdItem   ( const OctreeData& thisData,
+                              const void*       pItem );
+           bool  releaseItem( const OctreeData& thisData,
+                              const void*       pItem );
+           void  holdCovering( const OctreeData&   thisData,
+                               const void* const*  pItems,
+                               dword               itemCount,
+                               dword*              pOverlaps,
+                               const OctreeAgentV& agent );
+           dword getByteSize()                                            const;
+
+           void  insertRangeParallel( const OctreeData&   thisData,
+                                      const void* const*  pItems,
+                                      dword               itemCount,
+                                      const OctreeAgentV& agent,
+                                      OctreeTaskPool&     tasks );
+           void  sumItemRefCount();
 
 
 /// fields ---------------------------------------------------------------------
 private:
-   OctreeCell* subCells_m[ 8 ];
+   // (first, so it can fill the base's padding)
+   dword              itemRefCount_m;
+   OctreeCell*        subCells_m[ 8 ];
+   Array<const void*> items_m;
 };
 
 
@@ -245,15 +504,23 @@ private:
 /**
  * Outer node implementation of an octree cell.<br/><br/>
  *
- * Stores pointers to items.
+ * Stores pointers to items: the first OCTREE_LEAF_INLINE_ITEMS in the node
+ * itself, so small leafs need no separate allocation. More than that move to
+ * separate storage, and back again when fewer than half remain.
+ *
+ * @invariants
+ * items_m storage is either external, and is inlineItems_m, or is its own.<br/>
  */
 class OctreeLeaf
    : public OctreeCell
 {
+   friend class OctreeCell;
+
 /// standard object services ---------------------------------------------------
 public:
             OctreeLeaf();
-            OctreeLeaf( const OctreeLeaf*const leafs[8] );
+            OctreeLeaf( const OctreeLeaf*const  leafs[8],
+                        const Array<const void*>& items );
 private:
    explicit OctreeLeaf( const void* pItem );
 
@@ -262,29 +529,59 @@ public:
             OctreeLeaf( const OctreeLeaf& );
    OctreeLeaf& operator=( const OctreeLeaf& );
 
+   static  void* operator new   ( size_t, OctreeAllocatorV& );
+   static  void  operator delete( void*,  OctreeAllocatorV& );
+private:
+   static  void  operator delete( void* );
+public:
+
 
 /// commands -------------------------------------------------------------------
    virtual void  insert( const OctreeData&   thisData,
                          OctreeCell*&        pThis,
                          const void*         pItem,
                          const OctreeAgentV& agent );
-   virtual bool  remove( OctreeCell*&        pThis,
+   virtual void  insertRange( const OctreeData&   thisData,
+                              OctreeCell*&        pThis,
+                              const void* const*  pItems,
+                              dword               itemCount,
+                              const OctreeAgentV& agent,
+                              OctreeTaskPool*     pTasks );
+   virtual bool  remove( const OctreeData&   thisData,
+                         OctreeCell*&        pThis,
                          const void*         pItem,
-                         const dword         maxItemsPerCell,
-                         dword&              itemCount );
+                         const OctreeAgentV& agent );
+
+   template<class AGENT>
+           void  insertItem( const OctreeData& thisData,
+                             OctreeCell*&      pThis,
+                             const void*       pItem,
+                             const AGENT&      agent );
+           bool  removeItem( const OctreeData& thisData,
+                             OctreeCell*&      pThis,
+                             const void*       pItem );
 
 
 /// queries --------------------------------------------------------------------
    virtual void  visit( const OctreeData& thisData,
                         OctreeVisitorV&   visitor )                       const;
+   template<class QUERY>
+           void  query( const OctreeData& thisData,
+                        QUERY&            query )                         const;
+
+   virtual OctreeCell* clone( OctreeAllocatorV& allocator )               const;
 
-   virtual OctreeCell* clone()                                            const;
+   virtual dword getItemRefCount()                                        const;
+   virtual bool  isBranch()                                               const;
 
    virtual void  getInfo( dword& byteSize,
                           dword& leafCount,
                           dword& itemCount,
                           dword& maxDepth )                               const;
 
+           void  addStats   ( const OctreeData& thisData )                const;
+           void  removeStats( const OctreeData& thisData )                const;
+
 
 /// statics --------------------------------------------------------------------
    static  void  insertMaybeCreate( const OctreeData&   cellData,
@@ -293,12 +590,514 @@ public:
                                     const OctreeAgentV& agent );
 
 
+/// implementation -------------------------------------------------------------
+protected:
+   virtual void  destroy( OctreeAllocatorV& allocator );
+
+           bool  hasItem( const void* pItem )                             const;
+           void  appendItem( const OctreeData& thisData,
+                             const void*       pItem );
+           dword getByteSize()                                            const;
+
+
 /// fields ---------------------------------------------------------------------
 private:
    Array<const void*> items_m;
+   const void*        inlineItems_m[ OCTREE_LEAF_INLINE_ITEMS ];
 };
 
 
+
+/// templates ///
+
+/// OctreeRoot -----------------------------------------------------------------
+template<class AGENT>
+bool OctreeRoot::insertStatic
+(
+   const void* const pItem,
+   const AGENT&      agent
+)
+{
+   bool isInserted = false;
+
+   const OctreeData data( dimensions_m, *pAllocator_m, stats_m );
+
+   // check if item overlaps root cell
+   if( OCTREE_COUNT_TEST( agent.isOverlappingCellV( pItem,
+      data.getBound().getLowerCorner(), data.getBound().getUpperCorner() ) ) )
+   {
+      OctreeCell::insertStatic( data, pRootCell_m, pItem, agent );
+
+      stats_m.addItems( 1 );
+      isInserted = true;
+   }
+
+   return isInserted;
+}
+
+
+template<class AGENT>
+bool OctreeRoot::removeStatic
+(
+   const void* const pItem,
+   const AGENT&      agent
+)
+{
+   bool isRemoved = false;
+
+   if( pRootCell_m )
+   {
+      const OctreeData data( dimensions_m, *pAllocator_m, stats_m );
+
+      // check if item overlaps root cell (if not, it cannot have been inserted)
+      if( OCTREE_COUNT_TEST( agent.isOverlappingCellV( pItem,
+         data.getBound().getLowerCorner(),
+         data.getBound().getUpperCorner() ) ) )
+      {
+         isRemoved = OctreeCell::removeStatic( data, pRootCell_m, pItem,
+            agent );
+
+         stats_m.addItems( isRemoved ? -1 : 0 );
+      }
+   }
+
+   return isRemoved;
+}
+
+
+template<class QUERY>
+void OctreeRoot::query
+(
+   QUERY&      query,
+   const dword subCellOrder
+) const
+{
+   if( pRootCell_m )
+   {
+      const OctreeData data( dimensions_m, *pAllocator_m );
+
+      if( OCTREE_COUNT_TEST( query.isEntering( data ) ) )
+      {
+         OctreeCell::queryStatic( pRootCell_m, data, query, subCellOrder );
+      }
+   }
+}
+
+
+template<class QUERY>
+void OctreeRoot::queryNearest
+(
+   QUERY& query
+) const
+{
+   if( pRootCell_m )
+   {
+      OctreeHeap<NearCell,false> cells;
+
+      NearCell cell;
+      cell.pCell    = pRootCell_m;
+      cell.data     = OctreeData( dimensions_m, *pAllocator_m );
+      cell.distance = query.getCellDistance( cell.data );
+      if( OCTREE_COUNT_TEST( cell.distance <= query.getLimit() ) )
+      {
+         cells.push( cell );
+      }
+
+      // enter the nearest cell, until it is beyond the query's limit
+      while( !cells.isEmpty() && (cells.getTop().distance <= query.getLimit()) )
+      {
+         const NearCell nearest = cells.getTop();
+         cells.pop();
+
+         if( !nearest.pCell->isBranch() )
+         {
+            static_cast<const OctreeLeaf*>(nearest.pCell)->query( nearest.data,
+               query );
+         }
+         else
+         {
+            OCTREE_COUNT( addCell( nearest.data.getLevel() ) );
+
+            const OctreeBranch*const pBranch =
+               static_cast<const OctreeBranch*>(nearest.pCell);
+            pBranch->queryItems( nearest.data, query );
+
+            const OctreeCell*const* subCells = pBranch->subCells_m;
+            for( dword i = 0;  i < 8;  ++i )
+            {
+               if( subCells[i] )
+               {
+                  cell.pCell    = subCells[i];
+                  cell.data     = OctreeData( nearest.data, i );
+                  cell.distance = query.getCellDistance( cell.data );
+                  if( OCTREE_COUNT_TEST( cell.distance <= query.getLimit() ) )
+                  {
+                     cells.push( cell );
+                  }
+               }
+            }
+         }
+      }
+   }
+}
+
+
+
+
+/// OctreeCell -----------------------------------------------------------------
+template<class AGENT>
+void OctreeCell::insertStatic
+(
+   const OctreeData& cellData,
+   OctreeCell*&      pCell,
+   const void* const pItem,
+   const AGENT&      agent
+)
+{
+   // make leaf, adding item, if no cell
+   if( !pCell )
+   {
+      OctreeLeaf*const pLeaf = new( cellData.getAllocator() ) OctreeLeaf(
+         pItem );
+      pLeaf->addStats( cellData );
+      pCell = pLeaf;
+   }
+   // else forward to existing cell (made unshared), by its kind
+   else
+   {
+      OctreeCell::unshare( pCell, cellData.getAllocator() );
+
+      if( pCell->isBranch() )
+      {
+         static_cast<OctreeBranch*>(pCell)->insertItem( cellData, pItem,
+            agent );
+      }
+      else
+      {
+         static_cast<OctreeLeaf*>(pCell)->insertItem( cellData, pCell, pItem,
+            agent );
+      }
+   }
+}
+
+
+template<class AGENT>
+bool OctreeCell::removeStatic
+(
+   const OctreeData& cellData,
+   OctreeCell*&      pCell,
+   const void* const pItem,
+   const AGENT&      agent
+)
+{
+   OctreeCell::unshare( pCell, cellData.getAllocator() );
+
+   return pCell->isBranch() ?
+      static_cast<OctreeBranch*>(pCell)->removeItem( cellData, pCell, pItem,
+         agent ) :
+      static_cast<OctreeLeaf*>(pCell)->removeItem( cellData, pCell, pItem );
+}
+
+
+template<class QUERY>
+void OctreeCell::queryStatic
+(
+   const OctreeCell* pCell,
+   const OctreeData& cellData,
+   QUERY&            query,
+   const dword       subCellOrder
+)
+{
+   if( pCell->isBranch() )
+   {
+      static_cast<const OctreeBranch*>(pCell)->query( cellData, query,
+         subCellOrder );
+   }
+   else
+   {
+      static_cast<const OctreeLeaf*>(pCell)->query( cellData, query );
+   }
+}
+
+
+
+
+/// OctreeBranch ---------------------------------------------------------------
+template<class AGENT>
+OctreeBranch::OctreeBranch
+(
+   const OctreeData&         thisData,
+   const Array<const void*>& items,
+   const void* const         pItem,
+   const AGENT&              agent
+)
+ : itemRefCount_m( 0 )
+ , items_m       ()
+{
+   OctreeBranch::zeroSubCells();
+
+   // (counted first, so items held here are counted as they come)
+   addStats( thisData );
+
+   try
+   {
+      // insert items
+      for( int j = items.getLength();  j-- > 0; )
+      {
+         insertItem( thisData, items[j], agent );
+      }
+
+      // insert last item
+      insertItem( thisData, pItem, agent );
+   }
+   catch( ... )
+   {
+      // delete any allocated cells (uncounting them, and this)
+      for( int i = 8;  i-- > 0; )
+      {
+         OctreeCell::removeStatsAll( subCells_m[i], OctreeData( thisData,
+            i ) );
+      }
+      deleteSubCells( thisData.getAllocator() );
+      removeStats( thisData );
+
+      throw;
+   }
+}
+
+
+template<class AGENT>
+void OctreeBranch::insertItem
+(
+   const OctreeData& thisData,
+   const void* const pItem,
+   const AGENT&      agent
+)
+{
+   OCTREE_COUNT( addCell( thisData.getLevel() ) );
+   OCTREE_COUNT( addTests( 1 ) );
+
+   // get subcell-item overlaps flags
+   const OctreeBound& bound    = thisData.getBound();
+   dword              overlaps = agent.getSubcellOverlapsV( pItem,
+      bound.getLowerCorner(), bound.getCenter(), bound.getUpperCorner() );
+
+   // hold item here if it covers this cell (and so in no sub cell)
+   if( isCovering( thisData, pItem, overlaps, agent ) )
+   {
+      holdItem( thisData, pItem );
+      overlaps = 0;
+   }
+
+   // loop through sub cells
+   for( int i = 8;  i-- > 0; )
+   {
+      // check if sub cell is overlapped by item
+      if( (overlaps >> i) & 1 )
+      {
+         // make sub cell data
+         const OctreeData subCellData( thisData, i );
+
+         // add item to sub cell, keeping count in step (even if it throws)
+         OctreeCell*& pSubCell = subCells_m[i];
+         const dword  subCount = pSubCell ? pSubCell->getItemRefCount() : 0;
+         try
+         {
+            OctreeCell::insertStatic( subCellData, pSubCell, pItem, agent );
+         }
+         catch( ... )
+         {
+            itemRefCount_m += (pSubCell ? pSubCell->getItemRefCount() : 0) -
+               subCount;
+            throw;
+         }
+
+         itemRefCount_m += pSubCell->getItemRefCount() - subCount;
+      }
+   }
+}
+
+
+template<class AGENT>
+bool OctreeBranch::removeItem
+(
+   const OctreeData& thisData,
+   OctreeCell*&      pThis,
+   const void* const pItem,
+   const AGENT&      agent
+)
+{
+   bool isRemoved = false;
+
+   OCTREE_COUNT( addCell( thisData.getLevel() ) );
+   OCTREE_COUNT( addTests( 1 ) );
+
+   // get subcell-item overlaps flags (same as when inserted)
+   const OctreeBound& bound    = thisData.getBound();
+   dword              overlaps = agent.getSubcellOverlapsV( pItem,
+      bound.getLowerCorner(), bound.getCenter(), bound.getUpperCorner() );
+
+   // release item held here if it covers this cell (and so in no sub cell)
+   if( isCovering( thisData, pItem, overlaps, agent ) )
+   {
+      isRemoved = releaseItem( thisData, pItem );
+      overlaps  = 0;
+   }
+
+   // loop through sub cells
+   for( int i = 8;  i-- > 0; )
+   {
+      // remove item from non-null sub cell overlapped by item
+      OctreeCell*& pSubCell = subCells_m[i];
+      if( pSubCell && ((overlaps >> i) & 1) )
+      {
+         const OctreeData subCellData( thisData, i );
+         const dword      subCount = pSubCell->getItemRefCount();
+
+         // remove, keeping count in step (even if it throws)
+         try
+         {
+            isRemoved |= OctreeCell::removeStatic( subCellData, pSubCell,
+               pItem, agent );
+         }
+         catch( ... )
+         {
+            itemRefCount_m -= subCount -
+               (pSubCell ? pSubCell->getItemRefCount() : 0);
+            throw;
+         }
+
+         itemRefCount_m -= subCount -
+            (pSubCell ? pSubCell->getItemRefCount() : 0);
+      }
+   }
+
+   // (this may be deleted)
+   collapseMaybe( thisData, pThis );
+
+   return isRemoved;
+}
+
+
+template<class QUERY>
+void OctreeBranch::query
+(
+   const OctreeData& thisData,
+   QUERY&            query,
+   const dword       subCellOrder
+) const
+{
+   OCTREE_COUNT( addCell( thisData.getLevel() ) );
+
+   // this cell's own items first
+   queryItems( thisData, query );
+
+   // step through sub cells (in the given order), entering those the query
+   // wants
+   for( dword i = 0;  i < 8;  ++i )
+   {
+      const dword            s        = i ^ subCellOrder;
+      const OctreeCell*const pSubCell = subCells_m[s];
+      if( pSubCell )
+      {
+         const OctreeData subCellData( thisData, s );
+         if( OCTREE_COUNT_TEST( query.isEntering( subCellData ) ) )
+         {
+            OctreeCell::queryStatic( pSubCell, subCellData, query,
+               subCellOrder );
+         }
+      }
+   }
+}
+
+
+template<class QUERY>
+inline
+void OctreeBranch::queryItems
+(
+   const OctreeData& thisData,
+   QUERY&            query
+) const
+{
+   if( !items_m.isEmpty() )
+   {
+      OCTREE_COUNT( addItemScans( items_m.getLength() ) );
+
+      query.visitLeaf( items_m.getStorage(), items_m.getLength(), thisData );
+   }
+}
+
+
+template<class AGENT>
+inline
+bool OctreeBranch::isCovering
+(
+   const OctreeData& thisData,
+   const void* const pItem,
+   const dword       overlaps,
+   const AGENT&      agent
+)
+{
+   // only items overlapping all subcells are asked
+   const OctreeBound& bound = thisData.getBound();
+   return (0xFF == (overlaps & 0xFF)) && OCTREE_COUNT_TEST(
+      agent.isCoveringCellV( pItem, bound.getLowerCorner(),
+      bound.getUpperCorner() ) );
+}
+
+
+
+
+/// OctreeLeaf -----------------------------------------------------------------
+template<class AGENT>
+void OctreeLeaf::insertItem
+(
+   const OctreeData& thisData,
+   OctreeCell*&      pThis,
+   const void* const pItem,
+   const AGENT&      agent
+)
+{
+   OCTREE_COUNT( addCell( thisData.getLevel() ) );
+   OCTREE_COUNT( addItemScans( items_m.getLength() ) );
+
+   // only insert if item not already present
+   if( !hasItem( pItem ) )
+   {
+      // check if leaf should be subdivided
+      if( !thisData.isSubdivide( items_m.getLength() + 1 ) )
+      {
+         appendItem( thisData, pItem );
+      }
+      else
+      {
+         // subdivide by making branch and adding items to it
+         OctreeBranch*const pBranch = new( thisData.getAllocator() )
+            OctreeBranch( thisData, items_m, pItem, agent );
+
+         // replace this with branch (which counted itself)
+         removeStats( thisData );
+         OctreeCell::deleteNonZero( pThis, thisData.getAllocator() );
+         pThis = pBranch;
+      }
+   }
+}
+
+
+template<class QUERY>
+void OctreeLeaf::query
+(
+   const OctreeData& thisData,
+   QUERY&            query
+) const
+{
+   OCTREE_COUNT( addCell( thisData.getLevel() ) );
+   OCTREE_COUNT( addItemScans( items_m.getLength() ) );
+
+   query.visitLeaf( items_m.getStorage(), items_m.getLength(), thisData );
+}
+
+
 }//namespace
 
 
@@ -0,0 +1,1227 @@
+/*------------------------------------------------------------------------------
+
+   Octree Component, version 2.1
+   Copyright (c) 2004-2007,  Harrison Ainsworth / HXA7241.
+
+   http://www.hxa7241.org/
+
+------------------------------------------------------------------------------*/
+
+/*------------------------------------------------------------------------------
+
+Copyright (c) 2004-2007, Harrison Ainsworth / HXA7241.
+
+Redistribution and use in source and binary forms, with or without modification,
+are permitted provided that the following conditions are met:
+
+* Redistributions of source code must retain the above copyright notice, this
+  list of conditions and the following disclaimer.
+* Redistributions in binary form must reproduce the above copyright notice, this
+  list of conditions and the following disclaimer in the documentation and/or
+  other materials provided with the distribution.
+* The name of the author may not be used to endorse or promote products derived
+  from this software without specific prior written permission.
+
+THIS SOFTWARE IS PROVIDED BY THE AUTHOR "AS IS" AND ANY EXPRESS OR IMPLIED
+WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT
+SHALL THE AUTHOR BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT
+OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING
+IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY
+OF SUCH DAMAGE.
+
+------------------------------------------------------------------------------*/
+
+
+#include "OctreeLinear.hpp"
+
+
+using namespace hxa7241_graphics;
+
+
+
+
+namespace
+{
+
+/// subcell index digits (three bits each) held in one key word
+const dword KEY_DIGITS_PER_WORD = 10;
+
+
+/**
+ * Gives the subcell index of the cell at the level (from 1), on the path in the
+ * key.
+ */
+dword getKeyDigit
+(
+   const udword key[2],
+   const dword  level
+)
+{
+   // first digit at the top of the first word
+   const dword d = level - 1;
+
+   return static_cast<dword>( (key[ d / KEY_DIGITS_PER_WORD ] >>
+      (27 - ((d % KEY_DIGITS_PER_WORD) * 3))) & 0x07 );
+}
+
+
+/**
+ * Makes the key of a subcell, at the level (from 1), from its parent's key.
+ */
+void makeSubKey
+(
+   const udword key[2],
+   const dword  subLevel,
+   const dword  subCellIndex,
+   udword       subKey[2]
+)
+{
+   const dword d = subLevel - 1;
+
+   subKey[0] = key[0];
+   subKey[1] = key[1];
+   subKey[ d / KEY_DIGITS_PER_WORD ] |= static_cast<udword>(subCellIndex) <<
+      (27 - ((d % KEY_DIGITS_PER_WORD) * 3));
+}
+
+
+/**
+ * Ensures capacity for the length, growing geometrically (so repeated
+ * insertion is amortized).
+ */
+template<class TYPE>
+void reserveGrowing
+(
+   Array<TYPE>& array,
+   const dword  length
+)
+{
+   const dword capacity = array.getCapacity();
+   if( length > capacity )
+   {
+      const dword maxLength = Array<TYPE>::getMaxLength();
+      const dword doubled   = (capacity <= (maxLength >> 1)) ? (capacity << 1) :
+         maxLength;
+      array.reserve( (length > doubled) ? length : doubled );
+   }
+}
+
+
+/**
+ * Replaces part of an array with other elements, moving the following ones
+ * along. The capacity must already be enough, so it cannot throw.
+ */
+template<class TYPE>
+void spliceElements
+(
+   Array<TYPE>&      array,
+   const dword       index,
+   const dword       removeCount,
+   const TYPE* const pElements,
+   const dword       elementCount
+)
+{
+   const dword length     = array.getLength();
+   const dword newLength  = length - removeCount + elementCount;
+   const dword tailBegin  = index + removeCount;
+   const dword tailLength = length - tailBegin;
+
+   // lengthen within capacity (keeping elements)
+   if( newLength > length )
+   {
+      array.setLength( newLength );
+   }
+
+   // move the following elements, in whichever direction does not overwrite
+   TYPE* const pStorage = array.getStorage();
+   if( elementCount > removeCount )
+   {
+      for( dword i = tailLength;  i-- > 0; )
+      {
+         pStorage[ index + elementCount + i ] = pStorage[ tailBegin + i ];
+      }
+   }
+   else
+   {
+      for( dword i = 0;  i < tailLength;  ++i )
+      {
+         pStorage[ index + elementCount + i ] = pStorage[ tailBegin + i ];
+      }
+   }
+
+   // write the new elements
+   for( dword i = elementCount;  i-- > 0; )
+   {
+      pStorage[ index + i ] = pElements[ i ];
+   }
+
+   array.setLength( newLength );
+}
+
+}
+
+
+
+
+/// OctreeLinear::Cell /////////////////////////////////////////////////////////
+
+/**
+ * View of a cell of an OctreeLinear, for visiting: the run of its leafs,
+ * presented through the OctreeCell interface.<br/><br/>
+ *
+ * Made during the visit traversal, on the stack, and read-only: the commands
+ * do nothing, and clone gives 0.
+ */
+class OctreeLinear::Cell
+   : public OctreeCell
+{
+/// standard object services ---------------------------------------------------
+public:
+            Cell();
+   virtual ~Cell();
+private:
+            Cell( const Cell& );
+   Cell& operator=( const Cell& );
+public:
+
+
+/// commands -------------------------------------------------------------------
+           void  set( const OctreeLinear* pTree,
+                      dword               level,
+                      dword               begin,
+                      dword               end );
+
+   virtual void  insert( const OctreeData&   thisData,
+                         OctreeCell*&        pThis,
+                         const void*         pItem,
+                         const OctreeAgentV& agent );
+   virtual void  insertRange( const OctreeData&   thisData,
+                              OctreeCell*&        pThis,
+                              const void* const*  pItems,
+                              dword               itemCount,
+                              const OctreeAgentV& agent,
+                              OctreeTaskPool*     pTasks );
+   virtual bool  remove( const OctreeData&   thisData,
+                         OctreeCell*&        pThis,
+                         const void*         pItem,
+                         const OctreeAgentV& agent );
+
+
+/// queries --------------------------------------------------------------------
+   virtual void  visit( const OctreeData& thisData,
+                        OctreeVisitorV&   visitor )                       const;
+
+   virtual OctreeCell* clone( OctreeAllocatorV& allocator )               const;
+
+   virtual dword getItemRefCount()                                        const;
+   virtual bool  isBranch()                                               const;
+
+   virtual void  getInfo( dword& byteSize,
+                          dword& leafCount,
+                          dword& itemCount,
+                          dword& maxDepth )                               const;
+
+
+/// implementation -------------------------------------------------------------
+protected:
+   virtual void  destroy( OctreeAllocatorV& allocator );
+
+
+/// fields ---------------------------------------------------------------------
+private:
+   const OctreeLinear* pTree_m;
+   dword               level_m;
+   dword               begin_m;
+   dword               end_m;
+};
+
+
+
+
+/// standard object services ---------------------------------------------------
+OctreeLinear::Cell::Cell()
+ : pTree_m ( 0 )
+ , level_m ( 0 )
+ , begin_m ( 0 )
+ , end_m   ( 0 )
+{
+}
+
+
+OctreeLinear::Cell::~Cell()
+{
+}
+
+
+
+
+/// commands -------------------------------------------------------------------
+void OctreeLinear::Cell::set
+(
+   const OctreeLinear* pTree,
+   const dword         level,
+   const dword         begin,
+   const dword         end
+)
+{
+   pTree_m  = pTree;
+   level_m  = level;
+   begin_m  = begin;
+   end_m    = end;
+}
+
+
+void OctreeLinear::Cell::insert
+(
+   const OctreeData&   ,//thisData,
+   OctreeCell*&        ,//pThis,
+   const void* const   ,//pItem,
+   const OctreeAgentV& //agent
+)
+{
+   // read-only view
+}
+
+
+void OctreeLinear::Cell::insertRange
+(
+   const OctreeData&   ,//thisData,
+   OctreeCell*&        ,//pThis,
+   const void* const*  ,//pItems,
+   const dword         ,//itemCount,
+   const OctreeAgentV& ,//agent,
+   OctreeTaskPool*     //pTasks
+)
+{
+   // read-only view
+}
+
+
+bool OctreeLinear::Cell::remove
+(
+   const OctreeData&   ,//thisData,
+   OctreeCell*&        ,//pThis,
+   const void* const   ,//pItem,
+   const OctreeAgentV& //agent
+)
+{
+   // read-only view
+   return false;
+}
+
+
+
+
+/// queries --------------------------------------------------------------------
+void OctreeLinear::Cell::visit
+(
+   const OctreeData& thisData,
+   OctreeVisitorV&   visitor
+) const
+{
+   OCTREE_COUNT( addCell( level_m ) );
+
+   if( pTree_m->isLeaf( begin_m, end_m, level_m ) )
+   {
+      // present the leaf's span of the items array
+      const dword itemsBegin = pTree_m->getItemsBegin( begin_m );
+      const dword itemCount  = pTree_m->getItemsBegin( end_m ) - itemsBegin;
+      OCTREE_COUNT( addItemScans( itemCount ) );
+      Array<const void*> items( const_cast<const void**>(
+         pTree_m->items_m.getStorage() + itemsBegin ), itemCount );
+      items.setLength( itemCount );
+
+      visitor.visitLeafV( items, thisData );
+   }
+   else
+   {
+      // present the runs of the subcells (null where empty)
+      dword runs[9];
+      pTree_m->findSubRuns( level_m, begin_m, end_m, runs );
+
+      Cell              subCells[8];
+      const OctreeCell* pSubCells[8];
+      for( int i = 8;  i-- > 0; )
+      {
+         subCells[i].set( pTree_m, level_m + 1, runs[i], runs[i + 1] );
+         pSubCells[i] = (runs[i] < runs[i + 1]) ? &subCells[i] : 0;
+      }
+
+      visitor.visitBranchV( pSubCells, thisData );
+   }
+}
+
+
+OctreeCell* OctreeLinear::Cell::clone
+(
+   OctreeAllocatorV& //allocator
+) const
+{
+   // read-only view
+   return 0;
+}
+
+
+dword OctreeLinear::Cell::getItemRefCount() const
+{
+   return pTree_m->getItemsBegin( end_m ) - pTree_m->getItemsBegin( begin_m );
+}
+
+
+bool OctreeLinear::Cell::isBranch() const
+{
+   return !pTree_m->isLeaf( begin_m, end_m, level_m );
+}
+
+
+void OctreeLinear::Cell::getInfo
+(
+   dword& byteSize,
+   dword& leafCount,
+   dword& itemCount,
+   dword& maxDepth
+) const
+{
+   const dword thisDepth = maxDepth;
+
+   for( dword i = begin_m;  i < end_m;  ++i )
+   {
+      const dword depth = thisDepth + (pTree_m->leafs_m[i].level - level_m) +
+         1;
+      if( maxDepth < depth )
+      {
+         maxDepth = depth;
+      }
+   }
+
+   const dword items = getItemRefCount();
+   byteSize  += ((end_m - begin_m) * sizeof(Leaf)) + (items * sizeof(void*));
+   leafCount += end_m - begin_m;
+   itemCount += items;
+}
+
+
+
+
+/// implementation -------------------------------------------------------------
+void OctreeLinear::Cell::destroy
+(
+   OctreeAllocatorV& //allocator
+)
+{
+   // read-only view
+}
+
+
+
+
+
+
+
+
+/// OctreeLinear ///////////////////////////////////////////////////////////////
+
+
+/// constants ------------------------------------------------------------------
+const dword OctreeLinear::MAX_LEVEL_COUNT = 21;
+
+
+
+
+/// standard object services ---------------------------------------------------
+OctreeLinear::OctreeLinear
+(
+   const Vector3r&   position,
+   const real        sizeOfCube,
+   const dword       maxItemsPerCell,
+   const dword       maxLevelCount,
+   const real        minCellSize,
+   const dword       collapseItemCount,
+   OctreeAllocatorV& allocator,
+   const real        looseness
+)
+ : dimensions_m( position, sizeOfCube, maxItemsPerCell,
+      (maxLevelCount <= MAX_LEVEL_COUNT) ? maxLevelCount : MAX_LEVEL_COUNT,
+      minCellSize, collapseItemCount, looseness )
+ , pAllocator_m( &allocator )
+ , leafs_m     ()
+ , items_m     ()
+ , stats_m     ()
+{
+}
+
+
+OctreeLinear::OctreeLinear
+(
+   const OctreeLinear& other,
+   OctreeAllocatorV&   allocator
+)
+ : dimensions_m( other.dimensions_m )
+ , pAllocator_m( &allocator )
+ , leafs_m     ( other.leafs_m )
+ , items_m     ( other.items_m )
+ , stats_m     ( other.stats_m )
+{
+}
+
+
+OctreeLinear::~OctreeLinear()
+{
+}
+
+
+OctreeLinear& OctreeLinear::operator=
+(
+   const OctreeLinear& other
+)
+{
+   if( &other != this )
+   {
+      // make new data before replacing old
+      Array<Leaf>        leafs( other.leafs_m );
+      Array<const void*> items( other.items_m );
+      leafs_m.swap( leafs );
+      items_m.swap( items );
+
+      dimensions_m = other.dimensions_m;
+      stats_m      = other.stats_m;
+   }
+
+   return *this;
+}
+
+
+
+
+/// commands -------------------------------------------------------------------
+bool OctreeLinear::insert
+(
+   const void* const   pItem,
+   const OctreeAgentV& agent
+)
+{
+   bool isInserted = false;
+
+   const OctreeData data( dimensions_m, *pAllocator_m );
+
+   // check if item overlaps root cell
+   if( OCTREE_COUNT_TEST( agent.isOverlappingCellV( pItem,
+      data.getBound().getLowerCorner(), data.getBound().getUpperCorner() ) ) )
+   {
+      const udword rootKey[2] = { 0, 0 };
+      insertInCell( data, rootKey, 0, leafs_m.getLength(), &pItem, 1, agent );
+
+      stats_m.addItems( 1 );
+      isInserted = true;
+   }
+
+   return isInserted;
+}
+
+
+dword OctreeLinear::insertRange
+(
+   const void* const*  pItems,
+   const dword         itemCount,
+   const OctreeAgentV& agent,
+   const dword         //threadCount
+)
+{
+   const OctreeData data( dimensions_m, *pAllocator_m );
+
+   // keep only items overlapping root cell
+   Array<const void*> items;
+   items.reserve( itemCount );
+   for( dword i = 0;  i < itemCount;  ++i )
+   {
+      if( OCTREE_COUNT_TEST( agent.isOverlappingCellV( pItems[i],
+         data.getBound().getLowerCorner(),
+         data.getBound().getUpperCorner() ) ) )
+      {
+         items.append( pItems[i] );
+      }
+   }
+
+   const udword rootKey[2] = { 0, 0 };
+   insertInCell( data, rootKey, 0, leafs_m.getLength(), items.getStorage(),
+      items.getLength(), agent );
+
+   stats_m.addItems( items.getLength() );
+
+   return items.getLength();
+}
+
+
+bool OctreeLinear::remove
+(
+   const void* const   pItem,
+   const OctreeAgentV& agent
+)
+{
+   bool isRemoved = false;
+
+   if( !leafs_m.isEmpty() )
+   {
+      const OctreeData data( dimensions_m, *pAllocator_m );
+
+      // check if item overlaps root cell (if not, it cannot have been inserted)
+      if( OCTREE_COUNT_TEST( agent.isOverlappingCellV( pItem,
+         data.getBound().getLowerCorner(),
+         data.getBound().getUpperCorner() ) ) )
+      {
+         const udword rootKey[2] = { 0, 0 };
+         dword        end        = leafs_m.getLength();
+         isRemoved = removeInCell( data, rootKey, 0, end, pItem, agent );
+
+         stats_m.addItems( isRemoved ? -1 : 0 );
+      }
+   }
+
+   return isRemoved;
+}
+
+
+void OctreeLinear::collapse()
+{
+   const OctreeData data( dimensions_m, *pAllocator_m );
+
+   const udword rootKey[2] = { 0, 0 };
+   dword        end        = leafs_m.getLength();
+   collapseInCell( data, rootKey, 0, end );
+}
+
+
+
+
+/// queries --------------------------------------------------------------------
+void OctreeLinear::visit
+(
+   OctreeVisitorV& visitor
+) const
+{
+   const OctreeData data( dimensions_m, *pAllocator_m );
+
+   Cell rootCell;
+   rootCell.set( this, 0, 0, leafs_m.getLength() );
+
+   visitor.visitRootV( leafs_m.isEmpty() ? 0 : &rootCell, data );
+}
+
+
+bool OctreeLinear::isEmpty() const
+{
+   return leafs_m.isEmpty();
+}
+
+
+void OctreeLinear::getInfo
+(
+   const dword rootWrapperByteSize,
+   dword&      byteSize,
+   dword&      leafCount,
+   dword&      itemCount,
+   dword&      maxDepth
+) const
+{
+   byteSize  = rootWrapperByteSize +
+      (leafs_m.getCapacity() * sizeof(Leaf)) +
+      (items_m.getCapacity() * sizeof(void*));
+   leafCount = leafs_m.getLength();
+   itemCount = items_m.getLength();
+   maxDepth  = stats_m.getMaxDepth();
+}
+
+
+void OctreeLinear::getStats
+(
+   OctreeStats& stats
+) const
+{
+   stats = stats_m;
+}
+
+
+const Vector3r& OctreeLinear::getPosition() const
+{
+   return dimensions_m.getPosition();
+}
+
+
+real OctreeLinear::getSize() const
+{
+   return dimensions_m.getSize();
+}
+
+
+dword OctreeLinear::getMaxItemCountPerCell() const
+{
+   return dimensions_m.getMaxItemCountPerCell();
+}
+
+
+dword OctreeLinear::getMaxLevelCount() const
+{
+   return dimensions_m.getMaxLevelCount();
+}
+
+
+real OctreeLinear::getMinCellSize() const
+{
+   return dimensions_m.getMinCellSize();
+}
+
+
+dword OctreeLinear::getCollapseItemCount() const
+{
+   return dimensions_m.getCollapseItemCount();
+}
+
+
+real OctreeLinear::getLooseness() const
+{
+   return dimensions_m.getLooseness();
+}
+
+
+
+
+/// implementation -------------------------------------------------------------
+void OctreeLinear::insertInCell
+(
+   const OctreeData&   cellData,
+   const udword        cellKey[2],
+   const dword         begin,
+   const dword         end,
+   const void* const*  pItems,
+   const dword         itemCount,
+   const OctreeAgentV& agent
+)
+{
+   if( itemCount > 0 )
+   {
+      OCTREE_COUNT( addCell( cellData.getLevel() ) );
+
+      // empty or leaf: rebuild from the leaf's items and those not already
+      // present (the same as the Composite leaf inserting them in turn,
+      // subdividing when full)
+      if( (begin == end) || isLeaf( begin, end, cellData.getLevel() ) )
+      {
+         const dword itemsBegin = getItemsBegin( begin );
+         const dword itemsEnd   = getItemsBegin( end );
+         OCTREE_COUNT( addItemScans( itemsEnd - itemsBegin ) );
+
+         Array<const void*> cellItems;
+         cellItems.reserve( itemsEnd - itemsBegin + itemCount );
+         for( dword j = itemsBegin;  j < itemsEnd;  ++j )
+         {
+            cellItems.append( items_m[j] );
+         }
+         for( dword j = 0;  j < itemCount;  ++j )
+         {
+            bool isAlreadyPresent = false;
+            for( dword k = itemsBegin;  (k < itemsEnd) & !isAlreadyPresent;
+               ++k )
+            {
+               isAlreadyPresent |= (pItems[j] == items_m[k]);
+            }
+
+            if( !isAlreadyPresent )
+            {
+               cellItems.append( pItems[j] );
+            }
+         }
+
+         // only change if any item not already present
+         if( cellItems.getLength() > (itemsEnd - itemsBegin) )
+         {
+            Array<Leaf>        leafs;
+            Array<const void*> items;
+
+            // leaf, if not too many (counting any duplicates from a collapse,
+            // as OctreeLeaf does)
+            if( !cellData.isSubdivide( cellItems.getLength() ) )
+            {
+               build( cellData, cellKey, cellItems.getStorage(),
+                  cellItems.getLength(), agent, leafs, items );
+            }
+            // else subdivide, with each item once (as OctreeBranch does,
+            // re-inserting them)
+            else
+            {
+               dword length = 0;
+               for( dword j = 0;  j < cellItems.getLength();  ++j )
+               {
+                  bool isDuplicate = false;
+                  for( dword k = length;  (k-- > 0) & !isDuplicate; )
+                  {
+                     isDuplicate |= (cellItems[j] == cellItems[k]);
+                  }
+
+                  if( !isDuplicate )
+                  {
+                     cellItems[length++] = cellItems[j];
+                  }
+               }
+               cellItems.setLength( length );
+
+               buildSubCells( cellData, cellKey, cellItems.getStorage(),
+                  cellItems.getLength(), agent, leafs, items );
+            }
+
+            replaceLeafs( begin, end, leafs, items );
+         }
+      }
+      // branch: partition the items into the subcells
+      else
+      {
+         OCTREE_COUNT( addTests( itemCount ) );
+
+         // get subcell-item overlaps flags, once for each item
+         const OctreeBound& bound = cellData.getBound();
+         Array<dword> overlaps( itemCount );
+         for( dword j = 0;  j < itemCount;  ++j )
+         {
+            overlaps[j] = agent.getSubcellOverlapsV( pItems[j],
+               bound.getLowerCorner(), bound.getCenter(),
+               bound.getUpperCorner() );
+         }
+
+         dword runs[9];
+         findSubRuns( cellData.getLevel(), begin, end, runs );
+
+         // loop through sub cells, last first (so changing one moves only the
+         // runs of those done already)
+         Array<const void*> subItems;
+         subItems.reserve( itemCount );
+         for( int i = 8;  i-- > 0; )
+         {
+            subItems.setLength( 0 );
+            for( dword j = 0;  j < itemCount;  ++j )
+            {
+               if( (overlaps[j] >> i) & 1 )
+               {
+                  subItems.append( pItems[j] );
+               }
+            }
+
+            if( !subItems.isEmpty() )
+            {
+               const OctreeData subCellData( cellData, i );
+               udword           subKey[2];
+               makeSubKey( cellKey, subCellData.getLevel(), i, subKey );
+
+               insertInCell( subCellData, subKey, runs[i], runs[i + 1],
+                  subItems.getStorage(), subItems.getLength(), agent );
+            }
+         }
+      }
+   }
+}
+
+
+bool OctreeLinear::removeInCell
+(
+   const OctreeData&   cellData,
+   const udword        cellKey[2],
+   const dword         begin,
+   dword&              end,
+   const void* const   pItem,
+   const OctreeAgentV& agent
+)
+{
+   bool isRemoved = false;
+
+   OCTREE_COUNT( addCell( cellData.getLevel() ) );
+
+   if( isLeaf( begin, end, cellData.getLevel() ) )
+   {
+      // keep the other items
+      const dword itemsBegin = getItemsBegin( begin );
+      const dword itemsEnd   = getItemsBegin( end );
+      OCTREE_COUNT( addItemScans( itemsEnd - itemsBegin ) );
+
+      Array<const void*> items;
+      items.reserve( itemsEnd - itemsBegin );
+      for( dword j = itemsBegin;  j < itemsEnd;  ++j )
+      {
+         if( items_m[j] != pItem )
+         {
+            items.append( items_m[j] );
+         }
+         else
+         {
+            isRemoved = true;
+         }
+      }
+
+      // replace leaf with one holding the rest, or nothing if none
+      if( isRemoved )
+      {
+         Array<Leaf> leafs;
+         if( !items.isEmpty() )
+         {
+            leafs.append( leafs_m[begin] );
+            leafs[0].itemsBegin = 0;
+         }
+
+         replaceLeafs( begin, end, leafs, items );
+         end = begin + leafs.getLength();
+      }
+   }
+   else
+   {
+      OCTREE_COUNT( addTests( 1 ) );
+
+      // get subcell-item overlaps flags (same as when inserted)
+      const OctreeBound& bound    = cellData.getBound();
+      const dword        overlaps = agent.getSubcellOverlapsV( pItem,
+         bound.getLowerCorner(), bound.getCenter(), bound.getUpperCorner() );
+
+      dword runs[9];
+      findSubRuns( cellData.getLevel(), begin, end, runs );
+
+      // loop through sub cells, last first (as for insertion)
+      for( int i = 8;  i-- > 0; )
+      {
+         // remove item from non-empty sub cell overlapped by item
+         if( (runs[i] < runs[i + 1]) && ((overlaps >> i) & 1) )
+         {
+            const OctreeData subCellData( cellData, i );
+            udword           subKey[2];
+            makeSubKey( cellKey, subCellData.getLevel(), i, subKey );
+
+            dword subEnd = runs[i + 1];
+            isRemoved |= removeInCell( subCellData, subKey, runs[i], subEnd,
+               pItem, agent );
+            end -= runs[i + 1] - subEnd;
+         }
+      }
+
+      // collapse to leaf, as OctreeBranch::remove does
+      const dword itemRefCount = getItemsBegin( end ) - getItemsBegin( begin );
+      if( (itemRefCount > 0) &&
+         cellData.getDimensions().isCollapse( itemRefCount ) )
+      {
+         collapseRun( cellData, cellKey, begin, end );
+      }
+   }
+
+   return isRemoved;
+}
+
+
+void OctreeLinear::collapseInCell
+(
+   const OctreeData& cellData,
+   const udword      cellKey[2],
+   const dword       begin,
+   dword&            end
+)
+{
+   // only branchs (runs of deeper leafs) collapse
+   if( (begin < end) && !isLeaf( begin, end, cellData.getLevel() ) )
+   {
+      // collapse whole run to leaf, if few enough
+      const dword itemRefCount = getItemsBegin( end ) - getItemsBegin( begin );
+      if( itemRefCount <= cellData.getDimensions().getMaxItemCountPerCell() )
+      {
+         collapseRun( cellData, cellKey, begin, end );
+      }
+      else
+      {
+         dword runs[9];
+         findSubRuns( cellData.getLevel(), begin, end, runs );
+
+         // loop through sub cells, last first (so earlier runs stay put)
+         for( int i = 8;  i-- > 0; )
+         {
+            if( runs[i] < runs[i + 1] )
+            {
+               const OctreeData subCellData( cellData, i );
+               udword           subKey[2];
+               makeSubKey( cellKey, subCellData.getLevel(), i, subKey );
+
+               dword subEnd = runs[i + 1];
+               collapseInCell( subCellData, subKey, runs[i], subEnd );
+               end -= runs[i + 1] - subEnd;
+            }
+         }
+      }
+   }
+}
+
+
+void OctreeLinear::collapseRun
+(
+   const OctreeData& cellData,
+   const udword      cellKey[2],
+   const dword       begin,
+   dword&            end
+)
+{
+   // replace the run with one leaf (its items are already in subcell order,
+   // whatever the depth of the leafs)
+   const dword itemsBegin   = getItemsBegin( begin );
+   const dword itemRefCount = getItemsBegin( end ) - itemsBegin;
+
+   Array<const void*> items( itemRefCount );
+   for( dword j = itemRefCount;  j-- > 0; )
+   {
+      items[j] = items_m[ itemsBegin + j ];
+   }
+
+   Leaf leaf;
+   leaf.key[0]     = cellKey[0];
+   leaf.key[1]     = cellKey[1];
+   leaf.level      = cellData.getLevel();
+   leaf.itemsBegin = 0;
+   Array<Leaf> leafs;
+   leafs.append( leaf );
+
+   replaceLeafs( begin, end, leafs, items );
+   end = begin + 1;
+}
+
+
+void OctreeLinear::replaceLeafs
+(
+   const dword               begin,
+   const dword               end,
+   const Array<Leaf>&        leafs,
+   const Array<const void*>& items
+)
+{
+   const dword itemsBegin = getItemsBegin( begin );
+   const dword itemsEnd   = getItemsBegin( end );
+
+   // make room first, so nothing is changed if that throws
+   reserveGrowing( leafs_m, leafs_m.getLength() - (end - begin) +
+      leafs.getLength() );
+   reserveGrowing( items_m, items_m.getLength() - (itemsEnd - itemsBegin) +
+      items.getLength() );
+
+   // uncount the run, and the leaf after it (its branches depend on the leaf
+   // before it)
+   const dword after = (end < leafs_m.getLength()) ? 1 : 0;
+   countLeafs( begin, end + after, false );
+
+   spliceElements( leafs_m, begin, end - begin, leafs.getStorage(),
+      leafs.getLength() );
+   spliceElements( items_m, itemsBegin, itemsEnd - itemsBegin,
+      items.getStorage(), items.getLength() );
+
+   // offset the new leafs' item spans, and the following leafs'
+   const dword newEnd = begin + leafs.getLength();
+   for( dword i = begin;  i < newEnd;  ++i )
+   {
+      leafs_m[i].itemsBegin += itemsBegin;
+   }
+   const dword shift = items.getLength() - (itemsEnd - itemsBegin);
+   for( dword i = newEnd, length = leafs_m.getLength();  i < length;  ++i )
+   {
+      leafs_m[i].itemsBegin += shift;
+   }
+
+   countLeafs( begin, newEnd + after, true );
+}
+
+
+void OctreeLinear::countLeafs
+(
+   const dword begin,
+   const dword end,
+   const bool  isAdding
+)
+{
+   for( dword i = begin;  i < end;  ++i )
+   {
+      const Leaf& leaf = leafs_m[i];
+
+      // count the branches above this leaf but not above the previous one:
+      // the shared ones are the root and those on the paths' common digits
+      // (above either leaf)
+      dword shared = 0;
+      if( i > 0 )
+      {
+         const Leaf& previous = leafs_m[i - 1];
+         const dword last     = (previous.level < leaf.level) ? previous.level :
+            leaf.level;
+
+         dword common = 0;
+         while( (common < last) && (getKeyDigit( previous.key, common + 1 ) ==
+            getKeyDigit( leaf.key, common + 1 )) )
+         {
+            ++common;
+         }
+         shared = (common < last) ? (common + 1) : last;
+      }
+
+      const dword refCount = getItemsBegin( i + 1 ) - leaf.itemsBegin;
+      const dword byteSize = sizeof(Leaf) + (refCount * sizeof(void*));
+      if( isAdding )
+      {
+         for( dword level = shared;  level < leaf.level;  ++level )
+         {
+            stats_m.addBranch( level, 0 );
+         }
+         stats_m.addLeaf( leaf.level, refCount, byteSize );
+      }
+      else
+      {
+         for( dword level = shared;  level < leaf.level;  ++level )
+         {
+            stats_m.removeBranch( level, 0 );
+         }
+         stats_m.removeLeaf( leaf.level, refCount, byteSize );
+      }
+   }
+}
+
+
+bool OctreeLinear::isLeaf
+(
+   const dword begin,
+   const dword end,
+   const dword level
+) const
+{
+   return ((end - begin) == 1) && (leafs_m[begin].level == level);
+}
+
+
+dword OctreeLinear::getItemsBegin
+(
+   const dword leafIndex
+) const
+{
+   return (leafIndex < leafs_m.getLength()) ? leafs_m[leafIndex].itemsBegin :
+      items_m.getLength();
+}
+
+
+void OctreeLinear::findSubRuns
+(
+   const dword level,
+   const dword begin,
+   const dword end,
+   dword       runs[9]
+) const
+{
+   runs[0] = begin;
+   runs[8] = end;
+
+   // binary search for the first leaf in each subcell (a branch's leafs are
+   // all deeper, and ordered by their subcell digit)
+   for( dword i = 1;  i < 8;  ++i )
+   {
+      dword low  = runs[i - 1];
+      dword high = end;
+      while( low < high )
+      {
+         const dword middle = low + ((high - low) >> 1);
+         if( getKeyDigit( leafs_m[middle].key, level + 1 ) < i )
+         {
+            low = middle + 1;
+         }
+         else
+         {
+            high = middle;
+         }
+      }
+
+      runs[i] = low;
+   }
+}
+
+
+
+
+/// statics --------------------------------------------------------------------
+void OctreeLinear::build
+(
+   const OctreeData&   cellData,
+   const udword        cellKey[2],
+   const void* const*  pItems,
+   const dword         itemCount,
+   const OctreeAgentV& agent,
+   Array<Leaf>&        leafs,
+   Array<const void*>& items
+)
+{
+   if( itemCount > 0 )
+   {
+      // leaf, if not too many
+      if( !cellData.isSubdivide( itemCount ) )
+      {
+         Leaf leaf;
+         leaf.key[0]     = cellKey[0];
+         leaf.key[1]     = cellKey[1];
+         leaf.level      = cellData.getLevel();
+         leaf.itemsBegin = items.getLength();
+         leafs.append( leaf );
+
+         for( dword j = 0;  j < itemCount;  ++j )
+         {
+            items.append( pItems[j] );
+         }
+      }
+      // else branch
+      else
+      {
+         buildSubCells( cellData, cellKey, pItems, itemCount, agent, leafs,
+            items );
+      }
+   }
+}
+
+
+void OctreeLinear::buildSubCells
+(
+   const OctreeData&   cellData,
+   const udword        cellKey[2],
+   const void* const*  pItems,
+   const dword         itemCount,
+   const OctreeAgentV& agent,
+   Array<Leaf>&        leafs,
+   Array<const void*>& items
+)
+{
+   // get subcell-item overlaps flags, once for each item
+   const OctreeBound& bound = cellData.getBound();
+   Array<dword> overlaps( itemCount );
+   for( dword j = 0;  j < itemCount;  ++j )
+   {
+      overlaps[j] = agent.getSubcellOverlapsV( pItems[j],
+         bound.getLowerCorner(), bound.getCenter(), bound.getUpperCorner() );
+   }
+
+   // partition the items into the subcells, in subcell order (so the leafs
+   // come out sorted)
+   Array<const void*> subItems;
+   subItems.reserve( itemCount );
+   for( dword i = 0;  i < 8;  ++i )
+   {
+      subItems.setLength( 0 );
+      for( dword j = 0;  j < itemCount;  ++j )
+      {
+         if( (overlaps[j] >> i) & 1 )
+         {
+            subItems.append( pItems[j] );
+         }
+      }
+
+      if( !subItems.isEmpty() )
+      {
+         const OctreeData subCellData( cellData, i );
+         udword           subKey[2];
+         makeSubKey( cellKey, subCellData.getLevel(), i, subKey );
+
+         build( subCellData, subKey, subItems.getStorage(),
+            subItems.getLength(), agent, leafs, items );
+      }
+   }
+}
@@ -0,0 +1,374 @@
+/*------------------------------------------------------------------------------
+
+   Octree Component, version 2.1
+   Copyright (c) 2004-2007,  Harrison Ainsworth / HXA7241.
+
+   http://www.hxa7241.org/
+
+------------------------------------------------------------------------------*/
+
+/*------------------------------------------------------------------------------
+
+Copyright (c) 2004-2007, Harrison Ainsworth / HXA7241.
+
+Redistribution and use in source and binary forms, with or without modification,
+are permitted provided that the following conditions are met:
+
+* Redistributions of source code must retain the above copyright notice, this
+  list of conditions and the following disclaimer.
+* Redistributions in binary form must reproduce the above copyright notice, this
+  list of conditions and the following disclaimer in the documentation and/or
+  other materials provided with the distribution.
+* The name of the author may not be used to endorse or promote products derived
+  from this software without specific prior written permission.
+
+THIS SOFTWARE IS PROVIDED BY THE AUTHOR "AS IS" AND ANY EXPRESS OR IMPLIED
+WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT
+SHALL THE AUTHOR BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT
+OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING
+IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY
+OF SUCH DAMAGE.
+
+------------------------------------------------------------------------------*/
+
+
+#ifndef OctreeLinear_h
+#define OctreeLinear_h
+
+
+#include "OctreeImplementation.hpp"
+
+
+
+
+namespace hxa7241_graphics
+{
+
+
+/**
+ * Linear implementation class for the Octree template: an alternative to
+ * OctreeRoot, holding no cells.<br/><br/>
+ *
+ * Leafs are held in one array, in depth-first order -- sorted by Morton
+ * (Z-order) key, which is the path of subcell indexs from the root. So the
+ * leafs in any cell are a contiguous run of the array, and a branch is just a
+ * cell whose run holds deeper leafs. The item pointers of all leafs are held
+ * in one array too, in the same order, each leaf having the span from its
+ * itemsBegin to the next leaf's.<br/><br/>
+ *
+ * The cells and items are the same as OctreeRoot would have for the same
+ * commands. But insertion and removal move the following parts of the
+ * arrays, so insertRange (which moves them at most once per cell) is the way
+ * to fill one. Building is always on the calling thread.<br/><br/>
+ *
+ * Visiting presents cells as transient OctreeCell views, made during the
+ * traversal, so visitors work as with OctreeRoot. The views are read-only.
+ * query and queryNearest work on the runs directly, as OctreeFrozenRoot.
+ * <br/><br/>
+ *
+ * stats_m counts the cells and items, kept by the commands: replaceLeafs,
+ * which makes every change to the arrays, uncounts the run it replaces and
+ * counts the new one (and re-counts the leaf after, whose branches depend on
+ * the leaf before it). So getInfo and getStats are O(1).<br/><br/>
+ *
+ * Depth is limited to MAX_LEVEL_COUNT levels (keys are two 30-bit words).
+ *
+ * @invariants
+ * leafs_m is sorted by key, with each key a prefix of no other.<br/>
+ * leafs_m level is 0 to MAX_LEVEL_COUNT - 1, and key digits below it are
+ * 0.<br/>
+ * leafs_m itemsBegin is ascending, leafs_m[0] itemsBegin is 0, and every
+ * leaf has at least one item.<br/>
+ */
+class OctreeLinear
+{
+/// standard object services ---------------------------------------------------
+public:
+            OctreeLinear( const Vector3r&   position,
+                          real              sizeOfCube,
+                          dword             maxItemsPerCell,
+                          dword             maxLevelCount,
+                          real              minCellSize,
+                          dword             collapseItemCount,
+                          OctreeAllocatorV& allocator,
+                          real              looseness = 2.0f );
+            OctreeLinear( const OctreeLinear& other,
+                          OctreeAllocatorV&   allocator );
+
+           ~OctreeLinear();
+   OctreeLinear& operator=( const OctreeLinear& );
+private:
+            OctreeLinear( const OctreeLinear& );
+public:
+
+
+/// commands -------------------------------------------------------------------
+           bool  insert( const void*         pItem,
+                         const OctreeAgentV& agent );
+           dword insertRange( const void* const*  pItems,
+                              dword               itemCount,
+                              const OctreeAgentV& agent,
+                              dword               threadCount );
+           bool  remove( const void*         pItem,
+                         const OctreeAgentV& agent );
+           void  collapse();
+
+
+/// queries --------------------------------------------------------------------
+           void  visit( OctreeVisitorV& visitor )                         const;
+   template<class QUERY>
+           void  query( QUERY& query,
+                        dword  subCellOrder = 0 )                         const;
+   template<class QUERY>
+           void  queryNearest( QUERY& query )                             const;
+
+           bool  isEmpty()                                                const;
+           void  getInfo( dword  rootWrapperByteSize,
+                          dword& byteSize,
+                          dword& leafCount,
+                          dword& itemCount,
+                          dword& maxDepth )                               const;
+           void  getStats( OctreeStats& stats )                           const;
+
+           const Vector3r& getPosition()                                  const;
+           real            getSize()                                      const;
+           dword           getMaxItemCountPerCell()                       const;
+           dword           getMaxLevelCount()                             const;
+           real            getMinCellSize()                               const;
+           dword           getCollapseItemCount()                         const;
+           real            getLooseness()                                 const;
+
+
+/// constants ------------------------------------------------------------------
+   static const dword MAX_LEVEL_COUNT;
+
+
+/// implementation -------------------------------------------------------------
+protected:
+   struct Leaf
+   {
+      udword key[2];
+      dword  level;
+      dword  itemsBegin;
+   };
+
+   struct NearCell
+   {
+      real       distance;
+      dword      begin;
+      dword      end;
+      OctreeData data;
+   };
+
+   class Cell;
+   friend class Cell;
+
+           void  insertInCell( const OctreeData&   cellData,
+                               const udword        cellKey[2],
+                               dword               begin,
+                               dword               end,
+                               const void* const*  pItems,
+                               dword               itemCount,
+                               const OctreeAgentV& agent );
+           bool  removeInCell( const OctreeData&   cellData,
+                               const udword        cellKey[2],
+                               dword               begin,
+                               dword&              end,
+                               const void*         pItem,
+                               const OctreeAgentV& agent );
+           void  collapseInCell( const OctreeData& cellData,
+                                 const udword      cellKey[2],
+                                 dword             begin,
+                                 dword&            end );
+           void  collapseRun( const OctreeData& cellData,
+                              const udword      cellKey[2],
+                              dword             begin,
+                              dword&            end );
+           void  replaceLeafs( dword                     begin,
+                               dword                     end,
+                               const Array<Leaf>&        leafs,
+                               const Array<const void*>& items );
+           void  countLeafs( dword begin,
+                             dword end,
+                             bool  isAdding );
+
+           bool  isLeaf( dword begin,
+                         dword end,
+                         dword level )                                    const;
+           dword getItemsBegin( dword leafIndex )                         const;
+           void  findSubRuns( dword level,
+                              dword begin,
+                              dword end,
+                              dword runs[9] )                             const;
+   template<class QUERY>
+           void  queryCell( const OctreeData& cellData,
+                            dword             begin,
+                            dword             end,
+                            QUERY&            query,
+                            dword             subCellOrder )              const;
+
+   static  void  build( const OctreeData&   cellData,
+                        const udword        cellKey[2],
+                        const void* const*  pItems,
+                        dword               itemCount,
+                        const OctreeAgentV& agent,
+                        Array<Leaf>&        leafs,
+                        Array<const void*>& items );
+   static  void  buildSubCells( const OctreeData&   cellData,
+                                const udword        cellKey[2],
+                                const void* const*  pItems,
+                                dword               itemCount,
+                                const OctreeAgentV& agent,
+                                Array<Leaf>&        leafs,
+                                Array<const void*>& items );
+
+
+/// fields ---------------------------------------------------------------------
+private:
+   OctreeDimensions   dimensions_m;
+   OctreeAllocatorV*  pAllocator_m;
+   Array<Leaf>        leafs_m;
+   Array<const void*> items_m;
+   OctreeStats        stats_m;
+};
+
+
+
+
+/// templates ///
+
+/// queries --------------------------------------------------------------------
+template<class QUERY>
+void OctreeLinear::query
+(
+   QUERY&      query,
+   const dword subCellOrder
+) const
+{
+   if( !leafs_m.isEmpty() )
+   {
+      const OctreeData data( dimensions_m, *pAllocator_m );
+
+      if( OCTREE_COUNT_TEST( query.isEntering( data ) ) )
+      {
+         queryCell( data, 0, leafs_m.getLength(), query, subCellOrder );
+      }
+   }
+}
+
+
+template<class QUERY>
+void OctreeLinear::queryNearest
+(
+   QUERY& query
+) const
+{
+   if( !leafs_m.isEmpty() )
+   {
+      OctreeHeap<NearCell,false> cells;
+
+      NearCell cell;
+      cell.begin    = 0;
+      cell.end      = leafs_m.getLength();
+      cell.data     = OctreeData( dimensions_m, *pAllocator_m );
+      cell.distance = query.getCellDistance( cell.data );
+      if( OCTREE_COUNT_TEST( cell.distance <= query.getLimit() ) )
+      {
+         cells.push( cell );
+      }
+
+      // enter the nearest cell, until it is beyond the query's limit
+      while( !cells.isEmpty() && (cells.getTop().distance <= query.getLimit()) )
+      {
+         const NearCell nearest = cells.getTop();
+         cells.pop();
+
+         OCTREE_COUNT( addCell( nearest.data.getLevel() ) );
+
+         if( isLeaf( nearest.begin, nearest.end, nearest.data.getLevel() ) )
+         {
+            const dword itemsBegin = getItemsBegin( nearest.begin );
+            OCTREE_COUNT( addItemScans( getItemsBegin( nearest.end ) -
+               itemsBegin ) );
+            query.visitLeaf( items_m.getStorage() + itemsBegin,
+               getItemsBegin( nearest.end ) - itemsBegin, nearest.data );
+         }
+         else
+         {
+            dword runs[9];
+            findSubRuns( nearest.data.getLevel(), nearest.begin, nearest.end,
+               runs );
+
+            for( dword i = 0;  i < 8;  ++i )
+            {
+               if( runs[i] < runs[i + 1] )
+               {
+                  cell.begin    = runs[i];
+                  cell.end      = runs[i + 1];
+                  cell.data     = OctreeData( nearest.data, i );
+                  cell.distance = query.getCellDistance( cell.data );
+                  if( OCTREE_COUNT_TEST( cell.distance <=
+                     query.getLimit() ) )
+                  {
+                     cells.push( cell );
+                  }
+               }
+            }
+         }
+      }
+   }
+}
+
+
+template<class QUERY>
+void OctreeLinear::queryCell
+(
+   const OctreeData& cellData,
+   const dword       begin,
+   const dword       end,
+   QUERY&            query,
+   const dword       subCellOrder
+) const
+{
+   OCTREE_COUNT( addCell( cellData.getLevel() ) );
+
+   if( isLeaf( begin, end, cellData.getLevel() ) )
+   {
+      const dword itemsBegin = getItemsBegin( begin );
+      OCTREE_COUNT( addItemScans( getItemsBegin( end ) - itemsBegin ) );
+      query.visitLeaf( items_m.getStorage() + itemsBegin,
+         getItemsBegin( end ) - itemsBegin, cellData );
+   }
+   else
+   {
+      // step through non-empty subcell runs (in the given order)
+      dword runs[9];
+      findSubRuns( cellData.getLevel(), begin, end, runs );
+
+      for( dword i = 0;  i < 8;  ++i )
+      {
+         const dword s = i ^ subCellOrder;
+         if( runs[s] < runs[s + 1] )
+         {
+            const OctreeData subCellData( cellData, s );
+            if( OCTREE_COUNT_TEST( query.isEntering( subCellData ) ) )
+            {
+               queryCell( subCellData, runs[s], runs[s + 1], query,
+                  subCellOrder );
+            }
+         }
+      }
+   }
+}
+
+
+}//namespace
+
+
+
+
+#endif//OctreeLinear_h
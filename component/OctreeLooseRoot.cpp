@@ -0,0 +1,1070 @@
+/*------------------------------------------------------------------------------
+
+   Octree Component, version 2.1
+   Copyright (c) 2004-2007,  Harrison Ainsworth / HXA7241.
+
+   http://www.hxa7241.org/
+
+------------------------------------------------------------------------------*/
+
+/*------------------------------------------------------------------------------
+
+Copyright (c) 2004-2007, Harrison Ainsworth / HXA7241.
+
+Redistribution and use in source and binary forms, with or without modification,
+are permitted provided that the following conditions are met:
+
+* Redistributions of source code must retain the above copyright notice, this
+  list of conditions and the following disclaimer.
+* Redistributions in binary form must reproduce the above copyright notice, this
+  list of conditions and the following disclaimer in the documentation and/or
+  other materials provided with the distribution.
+* The name of the author may not be used to endorse or promote products derived
+  from this software without specific prior written permission.
+
+THIS SOFTWARE IS PROVIDED BY THE AUTHOR "AS IS" AND ANY EXPRESS OR IMPLIED
+WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT
+SHALL THE AUTHOR BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT
+OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING
+IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY
+OF SUCH DAMAGE.
+
+------------------------------------------------------------------------------*/
+
+
+#include "OctreeLooseRoot.hpp"
+
+
+using namespace hxa7241_graphics;
+
+
+
+
+/// OctreeLooseRoot::Cell //////////////////////////////////////////////////////
+
+/**
+ * View of a node of an OctreeLooseRoot, for visiting, presented through the
+ * OctreeCell interface.<br/><br/>
+ *
+ * Made during the visit traversal, on the stack, and read-only: the commands
+ * do nothing, and clone gives 0.
+ */
+class OctreeLooseRoot::Cell
+   : public OctreeCell
+{
+/// standard object services ---------------------------------------------------
+public:
+            Cell();
+   virtual ~Cell();
+private:
+            Cell( const Cell& );
+   Cell& operator=( const Cell& );
+public:
+
+
+/// commands -------------------------------------------------------------------
+           void  set( const Node* pNode );
+
+   virtual void  insert( const OctreeData&   thisData,
+                         OctreeCell*&        pThis,
+                         const void*         pItem,
+                         const OctreeAgentV& agent );
+   virtual void  insertRange( const OctreeData&   thisData,
+                              OctreeCell*&        pThis,
+                              const void* const*  pItems,
+                              dword               itemCount,
+                              const OctreeAgentV& agent,
+                              OctreeTaskPool*     pTasks );
+   virtual bool  remove( const OctreeData&   thisData,
+                         OctreeCell*&        pThis,
+                         const void*         pItem,
+                         const OctreeAgentV& agent );
+
+
+/// queries --------------------------------------------------------------------
+   virtual void  visit( const OctreeData& thisData,
+                        OctreeVisitorV&   visitor )                       const;
+
+   virtual OctreeCell* clone( OctreeAllocatorV& allocator )               const;
+
+   virtual dword getItemRefCount()                                        const;
+   virtual bool  isBranch()                                               const;
+
+   virtual void  getInfo( dword& byteSize,
+                          dword& leafCount,
+                          dword& itemCount,
+                          dword& maxDepth )                               const;
+
+
+/// implementation -------------------------------------------------------------
+protected:
+   virtual void  destroy( OctreeAllocatorV& allocator );
+
+
+/// fields ---------------------------------------------------------------------
+private:
+   const Node* pNode_m;
+};
+
+
+
+
+/// standard object services ---------------------------------------------------
+OctreeLooseRoot::Cell::Cell()
+ : pNode_m( 0 )
+{
+}
+
+
+OctreeLooseRoot::Cell::~Cell()
+{
+}
+
+
+
+
+/// commands -------------------------------------------------------------------
+void OctreeLooseRoot::Cell::set
+(
+   const Node* pNode
+)
+{
+   pNode_m = pNode;
+}
+
+
+void OctreeLooseRoot::Cell::insert
+(
+   const OctreeData&   ,//thisData,
+   OctreeCell*&        ,//pThis,
+   const void* const   ,//pItem,
+   const OctreeAgentV& //agent
+)
+{
+   // read-only view
+}
+
+
+void OctreeLooseRoot::Cell::insertRange
+(
+   const OctreeData&   ,//thisData,
+   OctreeCell*&        ,//pThis,
+   const void* const*  ,//pItems,
+   const dword         ,//itemCount,
+   const OctreeAgentV& ,//agent,
+   OctreeTaskPool*     //pTasks
+)
+{
+   // read-only view
+}
+
+
+bool OctreeLooseRoot::Cell::remove
+(
+   const OctreeData&   ,//thisData,
+   OctreeCell*&        ,//pThis,
+   const void* const   ,//pItem,
+   const OctreeAgentV& //agent
+)
+{
+   // read-only view
+   return false;
+}
+
+
+
+
+/// queries --------------------------------------------------------------------
+void OctreeLooseRoot::Cell::visit
+(
+   const OctreeData& thisData,
+   OctreeVisitorV&   visitor
+) const
+{
+   OCTREE_COUNT( addCell( thisData.getLevel() ) );
+   OCTREE_COUNT( addItemScans( pNode_m->items.getLength() ) );
+
+   if( pNode_m->isBranch )
+   {
+      // present the branch's own items, if any
+      if( !pNode_m->items.isEmpty() )
+      {
+         visitor.visitBranchItemsV( pNode_m->items, thisData );
+      }
+
+      // present the subnodes (null where empty)
+      Cell              subCells[8];
+      const OctreeCell* pSubCells[8];
+      for( int i = 8;  i-- > 0; )
+      {
+         subCells[i].set( pNode_m->subNodes[i] );
+         pSubCells[i] = pNode_m->subNodes[i] ? &subCells[i] : 0;
+      }
+
+      visitor.visitBranchV( pSubCells, thisData );
+   }
+   else
+   {
+      visitor.visitLeafV( pNode_m->items, thisData );
+   }
+}
+
+
+OctreeCell* OctreeLooseRoot::Cell::clone
+(
+   OctreeAllocatorV& //allocator
+) const
+{
+   // read-only view
+   return 0;
+}
+
+
+dword OctreeLooseRoot::Cell::getItemRefCount() const
+{
+   return pNode_m->itemCount;
+}
+
+
+bool OctreeLooseRoot::Cell::isBranch() const
+{
+   return pNode_m->isBranch;
+}
+
+
+void OctreeLooseRoot::Cell::getInfo
+(
+   dword& byteSize,
+   dword& leafCount,
+   dword& itemCount,
+   dword& maxDepth
+) const
+{
+   byteSize  += sizeof(Node) + (pNode_m->items.getCapacity() * sizeof(void*));
+   itemCount += pNode_m->items.getLength();
+
+   if( pNode_m->isBranch )
+   {
+      const dword thisDepth = maxDepth + 1;
+
+      for( int i = 8;  i-- > 0; )
+      {
+         if( pNode_m->subNodes[i] )
+         {
+            Cell subCell;
+            subCell.set( pNode_m->subNodes[i] );
+
+            dword depth = thisDepth;
+            subCell.getInfo( byteSize, leafCount, itemCount, depth );
+
+            if( maxDepth < depth )
+            {
+               maxDepth = depth;
+            }
+         }
+      }
+   }
+   else
+   {
+      ++leafCount;
+      ++maxDepth;
+   }
+}
+
+
+
+
+/// implementation -------------------------------------------------------------
+void OctreeLooseRoot::Cell::destroy
+(
+   OctreeAllocatorV& //allocator
+)
+{
+   // read-only view
+}
+
+
+
+
+
+
+
+
+/// OctreeLooseRoot::Node //////////////////////////////////////////////////////
+
+
+/// standard object services ---------------------------------------------------
+OctreeLooseRoot::Node::Node()
+ : items    ()
+ , itemCount( 0 )
+ , isBranch ( false )
+{
+   for( int i = 8;  i-- > 0; )
+   {
+      subNodes[i] = 0;
+   }
+}
+
+
+void* OctreeLooseRoot::Node::operator new
+(
+   size_t            ,//size,
+   OctreeAllocatorV& allocator
+)
+{
+   return allocator.allocateLooseNode();
+}
+
+
+void OctreeLooseRoot::Node::operator delete
+(
+   void*             pStorage,
+   OctreeAllocatorV& allocator
+)
+{
+   allocator.freeLooseNode( pStorage );
+}
+
+
+void OctreeLooseRoot::Node::operator delete
+(
+   void* //pStorage
+)
+{
+   // never used: nodes are disposed of by deleteNode
+}
+
+
+
+
+
+
+
+
+/// OctreeLooseRoot ////////////////////////////////////////////////////////////
+
+
+/// standard object services ---------------------------------------------------
+OctreeLooseRoot::OctreeLooseRoot
+(
+   const Vector3r&   position,
+   const real        sizeOfCube,
+   const dword       maxItemsPerCell,
+   const dword       maxLevelCount,
+   const real        minCellSize,
+   const dword       collapseItemCount,
+   OctreeAllocatorV& allocator,
+   const real        looseness
+)
+ : dimensions_m( position, sizeOfCube, maxItemsPerCell, maxLevelCount,
+      minCellSize, collapseItemCount, looseness )
+ , pAllocator_m( &allocator )
+ , pRootNode_m ( 0 )
+ , stats_m     ()
+{
+}
+
+
+OctreeLooseRoot::OctreeLooseRoot
+(
+   const OctreeLooseRoot& other,
+   OctreeAllocatorV&      allocator
+)
+ : dimensions_m( other.dimensions_m )
+ , pAllocator_m( &allocator )
+ , pRootNode_m ( other.pRootNode_m ?
+      copyNode( *other.pRootNode_m, allocator ) : 0 )
+ , stats_m     ( other.stats_m )
+{
+}
+
+
+OctreeLooseRoot::~OctreeLooseRoot()
+{
+   // release all nodes at once, or node by node (nodes are never shared, so
+   // only the allocator's sharing matters)
+   if( pAllocator_m->isFreeingAll() )
+   {
+      pAllocator_m->freeAll();
+   }
+   else
+   {
+      deleteNode( pRootNode_m, *pAllocator_m );
+   }
+}
+
+
+OctreeLooseRoot& OctreeLooseRoot::operator=
+(
+   const OctreeLooseRoot& other
+)
+{
+   if( &other != this )
+   {
+      // make new nodes before deleting old
+      Node*const pRootNode = other.pRootNode_m ?
+         copyNode( *other.pRootNode_m, *pAllocator_m ) : 0;
+      deleteNode( pRootNode_m, *pAllocator_m );
+      pRootNode_m = pRootNode;
+
+      dimensions_m = other.dimensions_m;
+      stats_m      = other.stats_m;
+   }
+
+   return *this;
+}
+
+
+
+
+/// commands -------------------------------------------------------------------
+bool OctreeLooseRoot::insert
+(
+   const void* const   pItem,
+   const OctreeAgentV& agent
+)
+{
+   bool isInserted = false;
+
+   const OctreeData data( dimensions_m, *pAllocator_m, stats_m );
+
+   // check if item overlaps root cell
+   if( OCTREE_COUNT_TEST( agent.isOverlappingCellV( pItem,
+      data.getBound().getLowerCorner(), data.getBound().getUpperCorner() ) ) )
+   {
+      Vector3r lowerCorner;
+      Vector3r upperCorner;
+      agent.getBoundV( pItem, lowerCorner, upperCorner );
+
+      stats_m.addItems( insertInNode( data, pRootNode_m, pItem, lowerCorner,
+         upperCorner, agent ) ? 1 : 0 );
+      isInserted = true;
+   }
+
+   return isInserted;
+}
+
+
+dword OctreeLooseRoot::insertRange
+(
+   const void* const*  pItems,
+   const dword         itemCount,
+   const OctreeAgentV& agent,
+   const dword         //threadCount
+)
+{
+   // each item goes down one path, so one at a time is as quick
+   dword insertedCount = 0;
+   for( dword i = 0;  i < itemCount;  ++i )
+   {
+      insertedCount += insert( pItems[i], agent ) ? 1 : 0;
+   }
+
+   return insertedCount;
+}
+
+
+bool OctreeLooseRoot::remove
+(
+   const void* const   pItem,
+   const OctreeAgentV& agent
+)
+{
+   bool isRemoved = false;
+
+   if( pRootNode_m )
+   {
+      const OctreeData data( dimensions_m, *pAllocator_m, stats_m );
+
+      // check if item overlaps root cell (if not, it cannot have been inserted)
+      if( OCTREE_COUNT_TEST( agent.isOverlappingCellV( pItem,
+         data.getBound().getLowerCorner(),
+         data.getBound().getUpperCorner() ) ) )
+      {
+         Vector3r lowerCorner;
+         Vector3r upperCorner;
+         agent.getBoundV( pItem, lowerCorner, upperCorner );
+
+         isRemoved = removeInNode( data, pRootNode_m, pItem, lowerCorner,
+            upperCorner );
+
+         stats_m.addItems( isRemoved ? -1 : 0 );
+      }
+   }
+
+   return isRemoved;
+}
+
+
+void OctreeLooseRoot::collapse()
+{
+   if( pRootNode_m )
+   {
+      const OctreeData data( dimensions_m, *pAllocator_m, stats_m );
+
+      collapseInNode( data, dimensions_m.getMaxItemCountPerCell(),
+         *pRootNode_m );
+   }
+}
+
+
+
+
+/// queries --------------------------------------------------------------------
+void OctreeLooseRoot::visit
+(
+   OctreeVisitorV& visitor
+) const
+{
+   const OctreeData data( dimensions_m, *pAllocator_m );
+
+   Cell rootCell;
+   rootCell.set( pRootNode_m );
+
+   visitor.visitRootV( pRootNode_m ? &rootCell : 0, data );
+}
+
+
+bool OctreeLooseRoot::isEmpty() const
+{
+   return !pRootNode_m;
+}
+
+
+void OctreeLooseRoot::getInfo
+(
+   const dword rootWrapperByteSize,
+   dword&      byteSize,
+   dword&      leafCount,
+   dword&      itemCount,
+   dword&      maxDepth
+) const
+{
+   byteSize  = rootWrapperByteSize + stats_m.getByteSize();
+   leafCount = stats_m.getLeafCount();
+   itemCount = stats_m.getItemRefCount();
+   maxDepth  = stats_m.getMaxDepth();
+}
+
+
+void OctreeLooseRoot::getStats
+(
+   OctreeStats& stats
+) const
+{
+   stats = stats_m;
+}
+
+
+const Vector3r& OctreeLooseRoot::getPosition() const
+{
+   return dimensions_m.getPosition();
+}
+
+
+real OctreeLooseRoot::getSize() const
+{
+   return dimensions_m.getSize();
+}
+
+
+dword OctreeLooseRoot::getMaxItemCountPerCell() const
+{
+   return dimensions_m.getMaxItemCountPerCell();
+}
+
+
+dword OctreeLooseRoot::getMaxLevelCount() const
+{
+   return dimensions_m.getMaxLevelCount();
+}
+
+
+real OctreeLooseRoot::getMinCellSize() const
+{
+   return dimensions_m.getMinCellSize();
+}
+
+
+dword OctreeLooseRoot::getCollapseItemCount() const
+{
+   return dimensions_m.getCollapseItemCount();
+}
+
+
+real OctreeLooseRoot::getLooseness() const
+{
+   return dimensions_m.getLooseness();
+}
+
+
+
+
+/// statics --------------------------------------------------------------------
+OctreeData OctreeLooseRoot::getLooseData
+(
+   const OctreeData& cellData
+)
+{
+   // expand by the looseness, about the center
+   const OctreeBound& bound     = cellData.getBound();
+   const real         looseness = cellData.getDimensions().getLooseness();
+   const real         margin    = bound.getSize() * ((looseness - 1.0f) *
+      0.5f);
+
+   return OctreeData( cellData, OctreeBound( bound.getLowerCorner() -
+      Vector3r( margin, margin, margin ), bound.getSize() * looseness ) );
+}
+
+
+
+
+/// implementation -------------------------------------------------------------
+bool OctreeLooseRoot::insertInNode
+(
+   const OctreeData&   nodeData,
+   Node*&              pNode,
+   const void* const   pItem,
+   const Vector3r&     lowerCorner,
+   const Vector3r&     upperCorner,
+   const OctreeAgentV& agent
+)
+{
+   bool isAdded = false;
+
+   OCTREE_COUNT( addCell( nodeData.getLevel() ) );
+
+   // check node exists
+   if( !pNode )
+   {
+      // make node, adding item
+      Node*const pNew = new( nodeData.getAllocator() ) Node;
+      try
+      {
+         pNew->items.append( pItem );
+      }
+      catch( ... )
+      {
+         deleteNode( pNew, nodeData.getAllocator() );
+         throw;
+      }
+      countNode( nodeData, *pNew, true );
+      pNode   = pNew;
+      isAdded = true;
+   }
+   else
+   {
+      // only insert if item not already present
+      OCTREE_COUNT( addItemScans( pNode->items.getLength() ) );
+      bool isPresent = false;
+      for( dword i = pNode->items.getLength();  i-- > 0; )
+      {
+         isPresent |= (pNode->items[i] == pItem);
+      }
+
+      if( !isPresent )
+      {
+         // down into the subcell it fits, if a branch, else here
+         const dword subIndex = pNode->isBranch ?
+            getSubNodeIndex( nodeData, lowerCorner, upperCorner ) : -1;
+         if( subIndex >= 0 )
+         {
+            isAdded = insertInNode( OctreeData( nodeData, subIndex ),
+               pNode->subNodes[subIndex], pItem, lowerCorner, upperCorner,
+               agent );
+         }
+         else
+         {
+            // (recounted, as the item storage may grow)
+            countNode( nodeData, *pNode, false );
+            try
+            {
+               pNode->items.append( pItem );
+            }
+            catch( ... )
+            {
+               countNode( nodeData, *pNode, true );
+               throw;
+            }
+            countNode( nodeData, *pNode, true );
+            isAdded = true;
+         }
+      }
+   }
+
+   if( isAdded )
+   {
+      ++pNode->itemCount;
+
+      // check if node should be subdivided
+      if( !pNode->isBranch &&
+         nodeData.isSubdivide( pNode->items.getLength() ) )
+      {
+         // (recounted whole, as the subnodes are made uncounted)
+         countNode( nodeData, *pNode, false );
+         try
+         {
+            subdivide( nodeData, *pNode, agent );
+         }
+         catch( ... )
+         {
+            countNodes( nodeData, *pNode, true );
+            throw;
+         }
+         countNodes( nodeData, *pNode, true );
+      }
+   }
+
+   return isAdded;
+}
+
+
+bool OctreeLooseRoot::removeInNode
+(
+   const OctreeData& nodeData,
+   Node*&            pNode,
+   const void* const pItem,
+   const Vector3r&   lowerCorner,
+   const Vector3r&   upperCorner
+)
+{
+   bool isRemoved = false;
+
+   OCTREE_COUNT( addCell( nodeData.getLevel() ) );
+   OCTREE_COUNT( addItemScans( pNode->items.getLength() ) );
+
+   // check if held here (order of items is not significant, and each is held
+   // once, so stop when found)
+   for( dword i = pNode->items.getLength();  !isRemoved && (i-- > 0); )
+   {
+      if( pNode->items[i] == pItem )
+      {
+         countNode( nodeData, *pNode, false );
+         pNode->items.removeUnordered( i );
+         countNode( nodeData, *pNode, true );
+         isRemoved = true;
+      }
+   }
+
+   // else down into the subcell it fits, if a branch
+   if( !isRemoved && pNode->isBranch )
+   {
+      const dword subIndex = getSubNodeIndex( nodeData, lowerCorner,
+         upperCorner );
+      if( (subIndex >= 0) && pNode->subNodes[subIndex] )
+      {
+         isRemoved = removeInNode( OctreeData( nodeData, subIndex ),
+            pNode->subNodes[subIndex], pItem, lowerCorner, upperCorner );
+      }
+   }
+
+   if( isRemoved )
+   {
+      --pNode->itemCount;
+
+      // remove this node if now empty
+      if( 0 == pNode->itemCount )
+      {
+         countNode( nodeData, *pNode, false );
+         deleteNode( pNode, nodeData.getAllocator() );
+         pNode = 0;
+      }
+      // collapse this branch if now few enough
+      else if( pNode->isBranch &&
+         nodeData.getDimensions().isCollapse( pNode->itemCount ) )
+      {
+         collapse( nodeData, *pNode );
+      }
+   }
+
+   return isRemoved;
+}
+
+
+void OctreeLooseRoot::subdivide
+(
+   const OctreeData&   nodeData,
+   Node&               node,
+   const OctreeAgentV& agent
+)
+{
+   // move down the items that fit a subcell, keeping the rest
+   // (into new storage, so nothing is changed if any allocation fails)
+   Node*              subNodes[8] = { 0, 0, 0, 0, 0, 0, 0, 0 };
+   Array<const void*> items;
+   try
+   {
+      for( dword i = 0;  i < node.items.getLength();  ++i )
+      {
+         Vector3r lowerCorner;
+         Vector3r upperCorner;
+         agent.getBoundV( node.items[i], lowerCorner, upperCorner );
+
+         const dword subIndex = getSubNodeIndex( nodeData, lowerCorner,
+            upperCorner );
+         if( subIndex >= 0 )
+         {
+            if( !subNodes[subIndex] )
+            {
+               subNodes[subIndex] = new( nodeData.getAllocator() ) Node;
+            }
+            subNodes[subIndex]->items.append( node.items[i] );
+            ++subNodes[subIndex]->itemCount;
+         }
+         else
+         {
+            items.append( node.items[i] );
+         }
+      }
+   }
+   catch( ... )
+   {
+      for( int i = 8;  i-- > 0; )
+      {
+         deleteNode( subNodes[i], nodeData.getAllocator() );
+      }
+
+      throw;
+   }
+
+   node.items.swap( items );
+   for( int i = 8;  i-- > 0; )
+   {
+      node.subNodes[i] = subNodes[i];
+   }
+   node.isBranch = true;
+
+   // subdivide the subnodes too, if too many
+   for( dword i = 0;  i < 8;  ++i )
+   {
+      if( subNodes[i] )
+      {
+         const OctreeData subData( nodeData, i );
+         if( subData.isSubdivide( subNodes[i]->items.getLength() ) )
+         {
+            subdivide( subData, *subNodes[i], agent );
+         }
+      }
+   }
+}
+
+
+void OctreeLooseRoot::collapse
+(
+   const OctreeData& nodeData,
+   Node&             node
+)
+{
+   // gather all the items below into this node, then delete the subnodes
+   Array<const void*> items;
+   items.reserve( node.itemCount );
+   gatherItems( node, items );
+
+   countNodes( nodeData, node, false );
+
+   node.items.swap( items );
+   for( int i = 8;  i-- > 0; )
+   {
+      deleteNode( node.subNodes[i], nodeData.getAllocator() );
+      node.subNodes[i] = 0;
+   }
+   node.isBranch = false;
+
+   countNode( nodeData, node, true );
+}
+
+
+void OctreeLooseRoot::collapseInNode
+(
+   const OctreeData& nodeData,
+   const dword       maxItemCount,
+   Node&             node
+)
+{
+   // collapse this branch whole, if few enough, else the branchs below
+   if( node.isBranch )
+   {
+      if( node.itemCount <= maxItemCount )
+      {
+         collapse( nodeData, node );
+      }
+      else
+      {
+         for( int i = 8;  i-- > 0; )
+         {
+            if( node.subNodes[i] )
+            {
+               collapseInNode( OctreeData( nodeData, i ), maxItemCount,
+                  *node.subNodes[i] );
+            }
+         }
+      }
+   }
+}
+
+
+void OctreeLooseRoot::gatherItems
+(
+   const Node&         node,
+   Array<const void*>& items
+)
+{
+   for( dword i = 0;  i < node.items.getLength();  ++i )
+   {
+      items.append( node.items[i] );
+   }
+
+   for( dword i = 0;  i < 8;  ++i )
+   {
+      if( node.subNodes[i] )
+      {
+         gatherItems( *node.subNodes[i], items );
+      }
+   }
+}
+
+
+dword OctreeLooseRoot::getSubNodeIndex
+(
+   const OctreeData& nodeData,
+   const Vector3r&   lowerCorner,
+   const Vector3r&   upperCorner
+)
+{
+   // subcell holding the box's center (halved first, so an unbounded box
+   // does not overflow)
+   const Vector3r& center   = nodeData.getBound().getCenter();
+   dword           subIndex = 0;
+   for( int i = 3;  i-- > 0; )
+   {
+      const real boxCenter = (lowerCorner[i] * 0.5f) + (upperCorner[i] * 0.5f);
+      subIndex |= static_cast<dword>(boxCenter >= center[i]) << i;
+   }
+
+   // check the box is within the subcell's loose bound (made as the queries
+   // make it, so exactly the same)
+   const OctreeData   subLooseData( getLooseData( OctreeData( nodeData,
+      subIndex ) ) );
+   const OctreeBound& bound = subLooseData.getBound();
+   bool isWithin = true;
+   for( int i = 3;  i-- > 0; )
+   {
+      isWithin &= (lowerCorner[i] >= bound.getLowerCorner()[i]) &
+         (upperCorner[i] <= bound.getUpperCorner()[i]);
+   }
+
+   return isWithin ? subIndex : -1;
+}
+
+
+OctreeLooseRoot::Node* OctreeLooseRoot::copyNode
+(
+   const Node&       node,
+   OctreeAllocatorV& allocator
+)
+{
+   Node*const pCopy = new( allocator ) Node;
+   try
+   {
+      pCopy->items     = node.items;
+      pCopy->itemCount = node.itemCount;
+      pCopy->isBranch  = node.isBranch;
+      for( int i = 8;  i-- > 0; )
+      {
+         if( node.subNodes[i] )
+         {
+            pCopy->subNodes[i] = copyNode( *node.subNodes[i], allocator );
+         }
+      }
+   }
+   catch( ... )
+   {
+      deleteNode( pCopy, allocator );
+      throw;
+   }
+
+   return pCopy;
+}
+
+
+void OctreeLooseRoot::deleteNode
+(
+   Node*const        pNode,
+   OctreeAllocatorV& allocator
+)
+{
+   if( pNode )
+   {
+      for( int i = 8;  i-- > 0; )
+      {
+         deleteNode( pNode->subNodes[i], allocator );
+      }
+
+      pNode->~Node();
+      allocator.freeLooseNode( pNode );
+   }
+}
+
+
+void OctreeLooseRoot::countNode
+(
+   const OctreeData& nodeData,
+   const Node&       node,
+   const bool        isAdding
+)
+{
+   // one node, without those below
+   OctreeStats& stats         = nodeData.getStats();
+   const dword  level         = nodeData.getLevel();
+   const dword  itemsByteSize = node.items.getCapacity() * sizeof(void*);
+
+   if( node.isBranch )
+   {
+      if( isAdding )
+      {
+         stats.addBranch( level, sizeof(Node) );
+         stats.addBranchItems( node.items.getLength(), itemsByteSize );
+      }
+      else
+      {
+         stats.removeBranch( level, sizeof(Node) );
+         stats.removeBranchItems( node.items.getLength(), itemsByteSize );
+      }
+   }
+   else
+   {
+      if( isAdding )
+      {
+         stats.addLeaf( level, node.items.getLength(), sizeof(Node) +
+            itemsByteSize );
+      }
+      else
+      {
+         stats.removeLeaf( level, node.items.getLength(), sizeof(Node) +
+            itemsByteSize );
+      }
+   }
+}
+
+
+void OctreeLooseRoot::countNodes
+(
+   const OctreeData& nodeData,
+   const Node&       node,
+   const bool        isAdding
+)
+{
+   countNode( nodeData, node, isAdding );
+
+   for( dword i = 0;  i < 8;  ++i )
+   {
+      if( node.subNodes[i] )
+      {
+         countNodes( OctreeData( nodeData, i ), *node.subNodes[i], isAdding );
+      }
+   }
+}
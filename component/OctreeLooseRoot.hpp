@@ -0,0 +1,371 @@
+/*------------------------------------------------------------------------------
+
+   Octree Component, version 2.1
+   Copyright (c) 2004-2007,  Harrison Ainsworth / HXA7241.
+
+   http://www.hxa7241.org/
+
+------------------------------------------------------------------------------*/
+
+/*------------------------------------------------------------------------------
+
+Copyright (c) 2004-2007, Harrison Ainsworth / HXA7241.
+
+Redistribution and use in source and binary forms, with or without modification,
+are permitted provided that the following conditions are met:
+
+* Redistributions of source code must retain the above copyright notice, this
+  list of conditions and the following disclaimer.
+* Redistributions in binary form must reproduce the above copyright notice, this
+  list of conditions and the following disclaimer in the documentation and/or
+  other materials provided with the distribution.
+* The name of the author may not be used to endorse or promote products derived
+  from this software without specific prior written permission.
+
+THIS SOFTWARE IS PROVIDED BY THE AUTHOR "AS IS" AND ANY EXPRESS OR IMPLIED
+WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT
+SHALL THE AUTHOR BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT
+OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING
+IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY
+OF SUCH DAMAGE.
+
+------------------------------------------------------------------------------*/
+
+
+#ifndef OctreeLooseRoot_h
+#define OctreeLooseRoot_h
+
+
+#include "OctreeImplementation.hpp"
+
+
+
+
+namespace hxa7241_graphics
+{
+
+
+/**
+ * Loose implementation class for the Octree template: an alternative to
+ * OctreeRoot, holding each item once.<br/><br/>
+ *
+ * Each item is held in one node, found from its bounding box (by the agent's
+ * getBoundV): going down through the subcell holding the box's center, to the
+ * deepest node whose loose bound -- the cell expanded about its center to
+ * looseness times its size (by default 2, see OctreeDimensions) -- contains
+ * the box. An item no larger than (looseness - 1) cells fits the loose bound
+ * of the cell holding its center, so items settle in cells about their own
+ * size: a larger looseness settles them deeper, in bounds overlapping more.
+ * So insert and remove are O(depth), with one item ref each, and queries meet
+ * each item once. An item the root's loose bound cannot contain (as with the
+ * agent's default, unbounded) is held at the root.<br/><br/>
+ *
+ * A node holds its items until it has more than maxItemCountPerCell, then
+ * (where OctreeData::isSubdivide allows) becomes a branch, moving down the
+ * items that fit a subcell; a branch keeps the rest, and takes any later item
+ * that fits no subcell. When a branch and all below it hold no more than
+ * the collapse item count, it collapses back to one node, as OctreeBranch
+ * does (and collapse does so at maxItemCountPerCell).<br/><br/>
+ *
+ * query and queryNearest give QUERY the loose bounds, and a branch's own
+ * items (through visitLeaf) before its subcells are entered. Visiting
+ * presents cells as transient OctreeCell views (as OctreeLinear), with their
+ * plain bounds, a branch's own items coming through visitBranchItemsV before
+ * visitBranchV. The views are read-only.<br/><br/>
+ *
+ * Nodes are made in the allocator (as OctreeRoot's cells), and the stats are
+ * kept up to date by the commands. Copying copies all nodes, and insertRange
+ * inserts on the calling thread, one item at a time.<br/><br/>
+ *
+ * freeze and visitParallel are not available (the frozen layout and a
+ * parallel visit both enter cells by their plain bounds): using them does not
+ * compile.
+ *
+ * @invariants
+ * pRootNode_m is 0 or a node, and is 0 if there are no items.<br/>
+ * Each node's itemCount is the number of its items and all below it, and is
+ * above 0.<br/>
+ * Each node's items fit its loose bound (except at the root), and, if it is
+ * a branch, fit none of its subcells' loose bounds.<br/>
+ * A node's subNodes are all 0 unless it is a branch.<br/>
+ * stats_m counts every node (as countNodes would from the root).<br/>
+ */
+class OctreeLooseRoot
+{
+/// standard object services ---------------------------------------------------
+public:
+            OctreeLooseRoot( const Vector3r&   position,
+                             real              sizeOfCube,
+                             dword             maxItemsPerCell,
+                             dword             maxLevelCount,
+                             real              minCellSize,
+                             dword             collapseItemCount,
+                             OctreeAllocatorV& allocator,
+                             real              looseness = 2.0f );
+            OctreeLooseRoot( const OctreeLooseRoot& other,
+                             OctreeAllocatorV&      allocator );
+
+           ~OctreeLooseRoot();
+   OctreeLooseRoot& operator=( const OctreeLooseRoot& );              // throws
+private:
+            OctreeLooseRoot( const OctreeLooseRoot& );
+public:
+
+
+/// commands -------------------------------------------------------------------
+           bool  insert( const void*         pItem,
+                         const OctreeAgentV& agent );
+           dword insertRange( const void* const*  pItems,
+                              dword               itemCount,
+                              const OctreeAgentV& agent,
+                              dword               threadCount );
+           bool  remove( const void*         pItem,
+                         const OctreeAgentV& agent );
+           void  collapse();
+
+
+/// queries --------------------------------------------------------------------
+           void  visit( OctreeVisitorV& visitor )                         const;
+   template<class QUERY>
+           void  query( QUERY& query,
+                        dword  subCellOrder = 0 )                         const;
+   template<class QUERY>
+           void  queryNearest( QUERY& query )                             const;
+
+           bool  isEmpty()                                                const;
+           void  getInfo( dword  rootWrapperByteSize,
+                          dword& byteSize,
+                          dword& leafCount,
+                          dword& itemCount,
+                          dword& maxDepth )                               const;
+           void  getStats( OctreeStats& stats )                           const;
+
+           const Vector3r& getPosition()                                  const;
+           real            getSize()                                      const;
+           dword           getMaxItemCountPerCell()                       const;
+           dword           getMaxLevelCount()                             const;
+           real            getMinCellSize()                               const;
+           dword           getCollapseItemCount()                         const;
+           real            getLooseness()                                 const;
+
+
+/// statics --------------------------------------------------------------------
+   static  OctreeData getLooseData( const OctreeData& cellData );
+
+
+/// implementation -------------------------------------------------------------
+protected:
+   friend class OctreeAllocatorHeap;
+   friend class OctreeAllocatorPool;
+
+   struct Node
+   {
+      Node();
+
+      static  void* operator new   ( size_t, OctreeAllocatorV& );
+      static  void  operator delete( void*,  OctreeAllocatorV& );
+
+      Array<const void*> items;
+      Node*              subNodes[8];
+      dword              itemCount;
+      bool               isBranch;
+
+   private:
+      Node( const Node& );
+      Node& operator=( const Node& );
+
+      static  void  operator delete( void* );
+   };
+
+   struct NearNode
+   {
+      real        distance;
+      const Node* pNode;
+      OctreeData  data;
+      OctreeData  looseData;
+   };
+
+   class Cell;
+   friend class Cell;
+
+   static  bool  insertInNode( const OctreeData&   nodeData,
+                               Node*&              pNode,
+                               const void*         pItem,
+                               const Vector3r&     lowerCorner,
+                               const Vector3r&     upperCorner,
+                               const OctreeAgentV& agent );
+   static  bool  removeInNode( const OctreeData&   nodeData,
+                               Node*&              pNode,
+                               const void*         pItem,
+                               const Vector3r&     lowerCorner,
+                               const Vector3r&     upperCorner );
+   static  void  subdivide( const OctreeData&   nodeData,
+                            Node&               node,
+                            const OctreeAgentV& agent );
+   static  void  collapse( const OctreeData& nodeData,
+                           Node&             node );
+   static  void  collapseInNode( const OctreeData& nodeData,
+                                 dword             maxItemCount,
+                                 Node&             node );
+   static  void  gatherItems( const Node&         node,
+                              Array<const void*>& items );
+
+   static  dword getSubNodeIndex( const OctreeData& nodeData,
+                                  const Vector3r&   lowerCorner,
+                                  const Vector3r&   upperCorner );
+   static  Node* copyNode( const Node&       node,
+                           OctreeAllocatorV& allocator );
+   static  void  deleteNode( Node*             pNode,
+                             OctreeAllocatorV& allocator );
+   static  void  countNode( const OctreeData& nodeData,
+                            const Node&       node,
+                            bool              isAdding );
+   static  void  countNodes( const OctreeData& nodeData,
+                             const Node&       node,
+                             bool              isAdding );
+
+   template<class QUERY>
+           void  queryNode( const OctreeData& nodeData,
+                            const OctreeData& looseData,
+                            const Node&       node,
+                            QUERY&            query,
+                            dword             subCellOrder )              const;
+
+
+/// fields ---------------------------------------------------------------------
+private:
+   OctreeDimensions  dimensions_m;
+   OctreeAllocatorV* pAllocator_m;
+   Node*             pRootNode_m;
+   OctreeStats       stats_m;
+};
+
+
+
+
+/// templates ///
+
+/// queries --------------------------------------------------------------------
+template<class QUERY>
+void OctreeLooseRoot::query
+(
+   QUERY&      query,
+   const dword subCellOrder
+) const
+{
+   if( pRootNode_m )
+   {
+      const OctreeData data( dimensions_m, *pAllocator_m );
+      const OctreeData looseData( getLooseData( data ) );
+
+      if( OCTREE_COUNT_TEST( query.isEntering( looseData ) ) )
+      {
+         queryNode( data, looseData, *pRootNode_m, query, subCellOrder );
+      }
+   }
+}
+
+
+template<class QUERY>
+void OctreeLooseRoot::queryNearest
+(
+   QUERY& query
+) const
+{
+   if( pRootNode_m )
+   {
+      OctreeHeap<NearNode,false> nodes;
+
+      NearNode node;
+      node.pNode     = pRootNode_m;
+      node.data      = OctreeData( dimensions_m, *pAllocator_m );
+      node.looseData = getLooseData( node.data );
+      node.distance  = query.getCellDistance( node.looseData );
+      if( OCTREE_COUNT_TEST( node.distance <= query.getLimit() ) )
+      {
+         nodes.push( node );
+      }
+
+      // enter the nearest node, until it is beyond the query's limit
+      while( !nodes.isEmpty() && (nodes.getTop().distance <= query.getLimit()) )
+      {
+         const NearNode nearest = nodes.getTop();
+         nodes.pop();
+
+         OCTREE_COUNT( addCell( nearest.data.getLevel() ) );
+
+         const Array<const void*>& items = nearest.pNode->items;
+         if( !items.isEmpty() )
+         {
+            OCTREE_COUNT( addItemScans( items.getLength() ) );
+            query.visitLeaf( items.getStorage(), items.getLength(),
+               nearest.looseData );
+         }
+
+         for( dword i = 0;  i < 8;  ++i )
+         {
+            if( nearest.pNode->subNodes[i] )
+            {
+               node.pNode     = nearest.pNode->subNodes[i];
+               node.data      = OctreeData( nearest.data, i );
+               node.looseData = getLooseData( node.data );
+               node.distance  = query.getCellDistance( node.looseData );
+               if( OCTREE_COUNT_TEST( node.distance <= query.getLimit() ) )
+               {
+                  nodes.push( node );
+               }
+            }
+         }
+      }
+   }
+}
+
+
+template<class QUERY>
+void OctreeLooseRoot::queryNode
+(
+   const OctreeData& nodeData,
+   const OctreeData& looseData,
+   const Node&       node,
+   QUERY&            query,
+   const dword       subCellOrder
+) const
+{
+   OCTREE_COUNT( addCell( nodeData.getLevel() ) );
+
+   // this node's own items first
+   if( !node.items.isEmpty() )
+   {
+      OCTREE_COUNT( addItemScans( node.items.getLength() ) );
+      query.visitLeaf( node.items.getStorage(), node.items.getLength(),
+         looseData );
+   }
+
+   // step through subnodes (in the given order)
+   for( dword i = 0;  i < 8;  ++i )
+   {
+      const dword s = i ^ subCellOrder;
+      if( node.subNodes[s] )
+      {
+         const OctreeData subData( nodeData, s );
+         const OctreeData subLooseData( getLooseData( subData ) );
+         if( OCTREE_COUNT_TEST( query.isEntering( subLooseData ) ) )
+         {
+            queryNode( subData, subLooseData, *node.subNodes[s], query,
+               subCellOrder );
+         }
+      }
+   }
+}
+
+
+}//namespace
+
+
+
+
+#endif//OctreeLooseRoot_h
@@ -0,0 +1,875 @@
+/*------------------------------------------------------------------------------
+
+   Octree Component, version 2.1
+   Copyright (c) 2004-2007,  Harrison Ainsworth / HXA7241.
+
+   http://www.hxa7241.org/
+
+------------------------------------------------------------------------------*/
+
+/*------------------------------------------------------------------------------
+
+Copyright (c) 2004-2007, Harrison Ainsworth / HXA7241.
+
+Redistribution and use in source and binary forms, with or without modification,
+are permitted provided that the following conditions are met:
+
+* Redistributions of source code must retain the above copyright notice, this
+  list of conditions and the following disclaimer.
+* Redistributions in binary form must reproduce the above copyright notice, this
+  list of conditions and the following disclaimer in the documentation and/or
+  other materials provided with the distribution.
+* The name of the author may not be used to endorse or promote products derived
+  from this software without specific prior written permission.
+
+THIS SOFTWARE IS PROVIDED BY THE AUTHOR "AS IS" AND ANY EXPRESS OR IMPLIED
+WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT
+SHALL THE AUTHOR BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT
+OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING
+IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY
+OF SUCH DAMAGE.
+
+------------------------------------------------------------------------------*/
+
+
+#include "OctreeStripedRoot.hpp"
+
+
+using namespace hxa7241_graphics;
+
+
+
+
+namespace
+{
+
+/// deepest fixed level (so at most 8 ^ 2 stripes)
+const dword STRIPE_LEVEL_MAX = 2;
+const dword STRIPE_COUNT_MAX = 64;
+
+
+/**
+ * Inserts a range of items into one stripe, under its lock.
+ */
+class StripeTask
+   : public OctreeTaskV
+{
+public:
+            StripeTask() {}
+   virtual ~StripeTask() {}
+
+   void set( const OctreeData&         stripeData,
+             OctreeCell*&              pCell,
+             OctreeMutex&              mutex,
+             const Array<const void*>& items,
+             const dword               firstCount,
+             const OctreeAgentV&       agent )
+   {
+      stripeData_m = stripeData;
+      ppCell_m     = &pCell;
+      pMutex_m     = &mutex;
+      pItems_m     = &items;
+      firstCount_m = firstCount;
+      pAgent_m     = &agent;
+   }
+
+   virtual void run()
+   {
+      OctreeMutexLocked locked( *pMutex_m );
+
+      OctreeCell::insertRangeMaybeCreate( stripeData_m, *ppCell_m,
+         pItems_m->getStorage(), pItems_m->getLength(), *pAgent_m, 0 );
+
+      // count the items this is the first stripe of
+      stripeData_m.getStats().addItems( firstCount_m );
+   }
+
+private:
+   OctreeData                stripeData_m;
+   OctreeCell**              ppCell_m;
+   OctreeMutex*              pMutex_m;
+   const Array<const void*>* pItems_m;
+   dword                     firstCount_m;
+   const OctreeAgentV*       pAgent_m;
+};
+
+}
+
+
+
+
+/// OctreeStripedRoot::Cell ////////////////////////////////////////////////////
+
+/**
+ * View of a fixed cell of an OctreeStripedRoot, for visiting: the run of its
+ * stripes, presented through the OctreeCell interface.<br/><br/>
+ *
+ * Made during the visit traversal, on the stack, and read-only: the commands
+ * do nothing, and clone gives 0.
+ */
+class OctreeStripedRoot::Cell
+   : public OctreeCell
+{
+/// standard object services ---------------------------------------------------
+public:
+            Cell();
+   virtual ~Cell();
+private:
+            Cell( const Cell& );
+   Cell& operator=( const Cell& );
+public:
+
+
+/// commands -------------------------------------------------------------------
+           void  set( const OctreeStripedRoot* pTree,
+                      dword                    level,
+                      dword                    begin );
+
+   virtual void  insert( const OctreeData&   thisData,
+                         OctreeCell*&        pThis,
+                         const void*         pItem,
+                         const OctreeAgentV& agent );
+   virtual void  insertRange( const OctreeData&   thisData,
+                              OctreeCell*&        pThis,
+                              const void* const*  pItems,
+                              dword               itemCount,
+                              const OctreeAgentV& agent,
+                              OctreeTaskPool*     pTasks );
+   virtual bool  remove( const OctreeData&   thisData,
+                         OctreeCell*&        pThis,
+                         const void*         pItem,
+                         const OctreeAgentV& agent );
+
+
+/// queries --------------------------------------------------------------------
+   virtual void  visit( const OctreeData& thisData,
+                        OctreeVisitorV&   visitor )                       const;
+
+   virtual OctreeCell* clone( OctreeAllocatorV& allocator )               const;
+
+   virtual dword getItemRefCount()                                        const;
+   virtual bool  isBranch()                                               const;
+
+   virtual void  getInfo( dword& byteSize,
+                          dword& leafCount,
+                          dword& itemCount,
+                          dword& maxDepth )                               const;
+
+
+/// implementation -------------------------------------------------------------
+protected:
+   virtual void  destroy( OctreeAllocatorV& allocator );
+
+
+/// fields ---------------------------------------------------------------------
+private:
+   const OctreeStripedRoot* pTree_m;
+   dword                    level_m;
+   dword                    begin_m;
+};
+
+
+
+
+/// standard object services ---------------------------------------------------
+OctreeStripedRoot::Cell::Cell()
+ : pTree_m ( 0 )
+ , level_m ( 0 )
+ , begin_m ( 0 )
+{
+}
+
+
+OctreeStripedRoot::Cell::~Cell()
+{
+}
+
+
+
+
+/// commands -------------------------------------------------------------------
+void OctreeStripedRoot::Cell::set
+(
+   const OctreeStripedRoot* pTree,
+   const dword              level,
+   const dword              begin
+)
+{
+   pTree_m  = pTree;
+   level_m  = level;
+   begin_m  = begin;
+}
+
+
+void OctreeStripedRoot::Cell::insert
+(
+   const OctreeData&   ,//thisData,
+   OctreeCell*&        ,//pThis,
+   const void* const   ,//pItem,
+   const OctreeAgentV& //agent
+)
+{
+   // read-only view
+}
+
+
+void OctreeStripedRoot::Cell::insertRange
+(
+   const OctreeData&   ,//thisData,
+   OctreeCell*&        ,//pThis,
+   const void* const*  ,//pItems,
+   const dword         ,//itemCount,
+   const OctreeAgentV& ,//agent,
+   OctreeTaskPool*     //pTasks
+)
+{
+   // read-only view
+}
+
+
+bool OctreeStripedRoot::Cell::remove
+(
+   const OctreeData&   ,//thisData,
+   OctreeCell*&        ,//pThis,
+   const void* const   ,//pItem,
+   const OctreeAgentV& //agent
+)
+{
+   // read-only view
+   return false;
+}
+
+
+
+
+/// queries --------------------------------------------------------------------
+void OctreeStripedRoot::Cell::visit
+(
+   const OctreeData& thisData,
+   OctreeVisitorV&   visitor
+) const
+{
+   OCTREE_COUNT( addCell( thisData.getLevel() ) );
+
+   // present the subcells: fixed cells as views, stripes as their own cells
+   // (null where empty)
+   const dword span = pTree_m->getStripeSpan( level_m + 1 );
+
+   Cell              subCells[8];
+   const OctreeCell* pSubCells[8];
+   for( int i = 8;  i-- > 0; )
+   {
+      pSubCells[i] = pTree_m->getCell( level_m + 1, begin_m + (i * span),
+         subCells[i] );
+   }
+
+   visitor.visitBranchV( pSubCells, thisData );
+}
+
+
+OctreeCell* OctreeStripedRoot::Cell::clone
+(
+   OctreeAllocatorV& //allocator
+) const
+{
+   // read-only view
+   return 0;
+}
+
+
+dword OctreeStripedRoot::Cell::getItemRefCount() const
+{
+   dword count = 0;
+
+   const dword end = begin_m + pTree_m->getStripeSpan( level_m );
+   for( dword i = begin_m;  i < end;  ++i )
+   {
+      const OctreeCell*const pCell = pTree_m->stripes_m[i].pCell;
+      count += pCell ? pCell->getItemRefCount() : 0;
+   }
+
+   return count;
+}
+
+
+bool OctreeStripedRoot::Cell::isBranch() const
+{
+   return true;
+}
+
+
+void OctreeStripedRoot::Cell::getInfo
+(
+   dword& byteSize,
+   dword& leafCount,
+   dword& itemCount,
+   dword& maxDepth
+) const
+{
+   // (fixed cells are counted in the root's size)
+   const dword stripeDepth = maxDepth + (pTree_m->stripeLevel_m - level_m);
+
+   const dword end = begin_m + pTree_m->getStripeSpan( level_m );
+   for( dword i = begin_m;  i < end;  ++i )
+   {
+      const OctreeCell*const pCell = pTree_m->stripes_m[i].pCell;
+      if( pCell )
+      {
+         dword depth = stripeDepth;
+         pCell->getInfo( byteSize, leafCount, itemCount, depth );
+
+         if( maxDepth < depth )
+         {
+            maxDepth = depth;
+         }
+      }
+   }
+}
+
+
+
+
+/// implementation -------------------------------------------------------------
+void OctreeStripedRoot::Cell::destroy
+(
+   OctreeAllocatorV& //allocator
+)
+{
+   // read-only view
+}
+
+
+
+
+
+
+
+
+/// OctreeStripedRoot //////////////////////////////////////////////////////////
+
+
+/// standard object services ---------------------------------------------------
+OctreeStripedRoot::OctreeStripedRoot
+(
+   const Vector3r&   position,
+   const real        sizeOfCube,
+   const dword       maxItemsPerCell,
+   const dword       maxLevelCount,
+   const real        minCellSize,
+   const dword       collapseItemCount,
+   OctreeAllocatorV& ,//allocator,
+   const real        looseness
+)
+ : dimensions_m ( position, sizeOfCube, maxItemsPerCell, maxLevelCount,
+      minCellSize, collapseItemCount, looseness )
+ , stripeLevel_m( 0 )
+ , stripes_m    ( 0 )
+{
+   // fix levels only where a full cell would subdivide anyway
+   const dword maxItems = dimensions_m.getMaxItemCountPerCell();
+   const dword fullCount = (maxItems < DWORD_MAX) ? (maxItems + 1) : maxItems;
+   for( real size = dimensions_m.getSize();  (stripeLevel_m < STRIPE_LEVEL_MAX)
+      && dimensions_m.isSubdivide( fullCount, stripeLevel_m, size );
+      size *= 0.5f )
+   {
+      ++stripeLevel_m;
+   }
+
+   stripes_m = new Stripe[ getStripeSpan( 0 ) ];
+}
+
+
+OctreeStripedRoot::OctreeStripedRoot
+(
+   const OctreeStripedRoot& other,
+   OctreeAllocatorV&        //allocator
+)
+ : dimensions_m ( other.dimensions_m )
+ , stripeLevel_m( other.stripeLevel_m )
+ , stripes_m    ( other.cloneStripes() )
+{
+}
+
+
+OctreeStripedRoot::~OctreeStripedRoot()
+{
+   // (each stripe's allocator releases its whole subtree at once)
+   delete[] stripes_m;
+}
+
+
+OctreeStripedRoot& OctreeStripedRoot::operator=
+(
+   const OctreeStripedRoot& other
+)
+{
+   if( &other != this )
+   {
+      // make new data before deleting old
+      Stripe* stripes = other.cloneStripes();
+      delete[] stripes_m;
+      stripes_m = stripes;
+
+      dimensions_m  = other.dimensions_m;
+      stripeLevel_m = other.stripeLevel_m;
+   }
+
+   return *this;
+}
+
+
+
+
+/// commands -------------------------------------------------------------------
+bool OctreeStripedRoot::insert
+(
+   const void* const   pItem,
+   const OctreeAgentV& agent
+)
+{
+   bool isInserted = false;
+
+   const OctreeData data( dimensions_m, stripes_m[0].allocator );
+
+   // check if item overlaps root cell
+   if( OCTREE_COUNT_TEST( agent.isOverlappingCellV( pItem,
+      data.getBound().getLowerCorner(), data.getBound().getUpperCorner() ) ) )
+   {
+      dword stripes[ STRIPE_COUNT_MAX ];
+      dword stripeCount = 0;
+      findStripes( data, 0, pItem, agent, stripes, stripeCount );
+
+      // insert into each stripe, under all their locks (so seen whole)
+      StripesLocked locked( *this, stripes, stripeCount );
+      for( dword i = 0;  i < stripeCount;  ++i )
+      {
+         Stripe&          stripe = stripes_m[ stripes[i] ];
+         const OctreeData stripeData( makeStripeData( stripes[i] ) );
+
+         OctreeLeaf::insertMaybeCreate( stripeData, stripe.pCell, pItem,
+            agent );
+
+         // count the item in its first stripe
+         stripe.stats.addItems( (0 == i) ? 1 : 0 );
+      }
+
+      isInserted = true;
+   }
+
+   return isInserted;
+}
+
+
+dword OctreeStripedRoot::insertRange
+(
+   const void* const*  pItems,
+   const dword         itemCount,
+   const OctreeAgentV& agent,
+   const dword         threadCount
+)
+{
+   const OctreeData data( dimensions_m, stripes_m[0].allocator );
+
+   // sort items overlapping root cell into the stripes they overlap
+   Array<const void*> stripeItems[ STRIPE_COUNT_MAX ];
+   dword              firstCounts[ STRIPE_COUNT_MAX ];
+   dword              insertedCount = 0;
+   for( dword s = 0;  s < STRIPE_COUNT_MAX;  ++s )
+   {
+      firstCounts[s] = 0;
+   }
+
+   for( dword i = 0;  i < itemCount;  ++i )
+   {
+      if( OCTREE_COUNT_TEST( agent.isOverlappingCellV( pItems[i],
+         data.getBound().getLowerCorner(),
+         data.getBound().getUpperCorner() ) ) )
+      {
+         dword stripes[ STRIPE_COUNT_MAX ];
+         dword stripeCount = 0;
+         findStripes( data, 0, pItems[i], agent, stripes, stripeCount );
+
+         for( dword j = 0;  j < stripeCount;  ++j )
+         {
+            stripeItems[ stripes[j] ].append( pItems[i] );
+         }
+         firstCounts[ stripes[0] ] += (stripeCount > 0) ? 1 : 0;
+
+         ++insertedCount;
+      }
+   }
+
+   // fill each stripe as a task (tasks touch only their own stripe, and
+   // use its own allocator)
+   StripeTask   stripeTasks[ STRIPE_COUNT_MAX ];
+   OctreeTaskV* pStripeTasks[ STRIPE_COUNT_MAX ];
+   dword        taskCount = 0;
+   for( dword s = 0;  s < getStripeSpan( 0 );  ++s )
+   {
+      if( !stripeItems[s].isEmpty() )
+      {
+         stripeTasks[s].set( makeStripeData( s ), stripes_m[s].pCell,
+            stripes_m[s].mutex, stripeItems[s], firstCounts[s], agent );
+         pStripeTasks[taskCount++] = &stripeTasks[s];
+      }
+   }
+
+   OctreeTaskPool tasks( threadCount );
+   tasks.runAll( pStripeTasks, taskCount );
+
+   return insertedCount;
+}
+
+
+bool OctreeStripedRoot::remove
+(
+   const void* const   pItem,
+   const OctreeAgentV& agent
+)
+{
+   bool isRemoved = false;
+
+   const OctreeData data( dimensions_m, stripes_m[0].allocator );
+
+   // check if item overlaps root cell (if not, it cannot have been inserted)
+   if( OCTREE_COUNT_TEST( agent.isOverlappingCellV( pItem,
+      data.getBound().getLowerCorner(), data.getBound().getUpperCorner() ) ) )
+   {
+      dword stripes[ STRIPE_COUNT_MAX ];
+      dword stripeCount = 0;
+      findStripes( data, 0, pItem, agent, stripes, stripeCount );
+
+      // remove from each stripe, under all their locks (so seen whole)
+      StripesLocked locked( *this, stripes, stripeCount );
+      for( dword i = 0;  i < stripeCount;  ++i )
+      {
+         Stripe&          stripe = stripes_m[ stripes[i] ];
+         const OctreeData stripeData( makeStripeData( stripes[i] ) );
+
+         if( stripe.pCell )
+         {
+            const bool isRemovedHere = stripe.pCell->remove( stripeData,
+               stripe.pCell, pItem, agent );
+            isRemoved |= isRemovedHere;
+
+            // uncount the item in its first stripe, if removed there
+            if( 0 == i )
+            {
+               stripe.stats.addItems( isRemovedHere ? -1 : 0 );
+            }
+         }
+      }
+   }
+
+   return isRemoved;
+}
+
+
+void OctreeStripedRoot::collapse()
+{
+   // collapse each stripe in turn, under its lock
+   for( dword i = 0;  i < getStripeSpan( 0 );  ++i )
+   {
+      Stripe&          stripe = stripes_m[i];
+      const OctreeData stripeData( makeStripeData( i ) );
+
+      OctreeMutexLocked locked( stripe.mutex );
+      OctreeCell::collapseAll( stripeData, stripe.pCell );
+   }
+}
+
+
+
+
+/// queries --------------------------------------------------------------------
+void OctreeStripedRoot::visit
+(
+   OctreeVisitorV& visitor
+) const
+{
+   StripesLocked locked( *this );
+
+   const OctreeData data( dimensions_m, stripes_m[0].allocator );
+
+   Cell rootCell;
+   visitor.visitRootV( getCell( 0, 0, rootCell ), data );
+}
+
+
+bool OctreeStripedRoot::isEmpty() const
+{
+   bool isEmpty = true;
+
+   for( dword i = 0;  (i < getStripeSpan( 0 )) & isEmpty;  ++i )
+   {
+      OctreeMutexLocked locked( stripes_m[i].mutex );
+      isEmpty = !stripes_m[i].pCell;
+   }
+
+   return isEmpty;
+}
+
+
+void OctreeStripedRoot::getInfo
+(
+   const dword rootWrapperByteSize,
+   dword&      byteSize,
+   dword&      leafCount,
+   dword&      itemCount,
+   dword&      maxDepth
+) const
+{
+   // (from the stats, kept by the commands, instead of visiting the cells)
+   OctreeStats stats;
+   getStats( stats );
+
+   // (fixed cells are counted in the root's size)
+   byteSize  = rootWrapperByteSize + (getStripeSpan( 0 ) * sizeof(Stripe)) +
+      stats.getByteSize();
+   leafCount = stats.getLeafCount();
+   itemCount = stats.getItemRefCount();
+   maxDepth  = stats.getMaxDepth();
+}
+
+
+void OctreeStripedRoot::getStats
+(
+   OctreeStats& stats
+) const
+{
+   StripesLocked locked( *this );
+
+   stats = OctreeStats();
+
+   for( dword i = 0;  i < getStripeSpan( 0 );  ++i )
+   {
+      stats.add( stripes_m[i].stats );
+   }
+
+   // add the fixed cells where they have any items, as visits present them
+   // (sized as none: they are in the root's size)
+   for( dword level = 0;  level < stripeLevel_m;  ++level )
+   {
+      const dword span = getStripeSpan( level );
+      for( dword begin = 0;  begin < getStripeSpan( 0 );  begin += span )
+      {
+         dword refCount = 0;
+         for( dword i = begin;  i < (begin + span);  ++i )
+         {
+            refCount += stripes_m[i].stats.getItemRefCount();
+         }
+
+         if( refCount > 0 )
+         {
+            stats.addBranch( level, 0 );
+         }
+      }
+   }
+}
+
+
+const Vector3r& OctreeStripedRoot::getPosition() const
+{
+   return dimensions_m.getPosition();
+}
+
+
+real OctreeStripedRoot::getSize() const
+{
+   return dimensions_m.getSize();
+}
+
+
+dword OctreeStripedRoot::getMaxItemCountPerCell() const
+{
+   return dimensions_m.getMaxItemCountPerCell();
+}
+
+
+dword OctreeStripedRoot::getMaxLevelCount() const
+{
+   return dimensions_m.getMaxLevelCount();
+}
+
+
+real OctreeStripedRoot::getMinCellSize() const
+{
+   return dimensions_m.getMinCellSize();
+}
+
+
+dword OctreeStripedRoot::getCollapseItemCount() const
+{
+   return dimensions_m.getCollapseItemCount();
+}
+
+
+real OctreeStripedRoot::getLooseness() const
+{
+   return dimensions_m.getLooseness();
+}
+
+
+
+
+/// implementation -------------------------------------------------------------
+void OctreeStripedRoot::findStripes
+(
+   const OctreeData&   cellData,
+   const dword         begin,
+   const void* const   pItem,
+   const OctreeAgentV& agent,
+   dword               stripes[],
+   dword&              stripeCount
+) const
+{
+   if( cellData.getLevel() >= stripeLevel_m )
+   {
+      stripes[stripeCount++] = begin;
+   }
+   else
+   {
+      OCTREE_COUNT( addCell( cellData.getLevel() ) );
+      OCTREE_COUNT( addTests( 1 ) );
+
+      // descend into the subcells the item overlaps (as a branch would)
+      const OctreeBound& bound    = cellData.getBound();
+      const dword        overlaps = agent.getSubcellOverlapsV( pItem,
+         bound.getLowerCorner(), bound.getCenter(), bound.getUpperCorner() );
+      const dword        span     = getStripeSpan( cellData.getLevel() + 1 );
+
+      for( dword i = 0;  i < 8;  ++i )
+      {
+         if( (overlaps >> i) & 1 )
+         {
+            findStripes( OctreeData( cellData, i ), begin + (i * span), pItem,
+               agent, stripes, stripeCount );
+         }
+      }
+   }
+}
+
+
+OctreeData OctreeStripedRoot::makeStripeData
+(
+   const dword stripeIndex
+) const
+{
+   // follow the stripe's path of subcell indexs (its digits, top first)
+   OctreeData data( dimensions_m, stripes_m[stripeIndex].allocator,
+      stripes_m[stripeIndex].stats );
+   for( dword level = stripeLevel_m;  level-- > 0; )
+   {
+      data = OctreeData( data, (stripeIndex >> (level * 3)) & 0x07 );
+   }
+
+   return data;
+}
+
+
+OctreeStripedRoot::Stripe* OctreeStripedRoot::cloneStripes() const
+{
+   const dword   count   = getStripeSpan( 0 );
+   Stripe* const stripes = new Stripe[ count ];
+
+   try
+   {
+      for( dword i = 0;  i < count;  ++i )
+      {
+         OctreeMutexLocked locked( stripes_m[i].mutex );
+         stripes[i].pCell = OctreeCell::cloneNonZero( stripes_m[i].pCell,
+            stripes[i].allocator );
+         stripes[i].stats = stripes_m[i].stats;
+      }
+   }
+   catch( ... )
+   {
+      // (each stripe's allocator releases its whole subtree at once)
+      delete[] stripes;
+      throw;
+   }
+
+   return stripes;
+}
+
+
+dword OctreeStripedRoot::getStripeSpan
+(
+   const dword level
+) const
+{
+   return 1 << ((stripeLevel_m - level) * 3);
+}
+
+
+const OctreeCell* OctreeStripedRoot::getCell
+(
+   const dword level,
+   const dword begin,
+   Cell&       view
+) const
+{
+   const OctreeCell* pCell = 0;
+
+   // a stripe is its own cell, a fixed cell is a view (if not empty)
+   if( level >= stripeLevel_m )
+   {
+      pCell = stripes_m[begin].pCell;
+   }
+   else
+   {
+      view.set( this, level, begin );
+      pCell = (view.getItemRefCount() > 0) ? &view : 0;
+   }
+
+   return pCell;
+}
+
+
+void OctreeStripedRoot::lockAll() const
+{
+   for( dword i = 0;  i < getStripeSpan( 0 );  ++i )
+   {
+      stripes_m[i].mutex.lock();
+   }
+}
+
+
+void OctreeStripedRoot::unlockAll() const
+{
+   for( dword i = getStripeSpan( 0 );  i-- > 0; )
+   {
+      stripes_m[i].mutex.unlock();
+   }
+}
+
+
+void OctreeStripedRoot::lockStripes
+(
+   const dword stripes[],
+   const dword stripeCount
+) const
+{
+   // (in ascending order, as lockAll, so never deadlocks)
+   for( dword i = 0;  i < stripeCount;  ++i )
+   {
+      stripes_m[ stripes[i] ].mutex.lock();
+   }
+}
+
+
+void OctreeStripedRoot::unlockStripes
+(
+   const dword stripes[],
+   const dword stripeCount
+) const
+{
+   for( dword i = stripeCount;  i-- > 0; )
+   {
+      stripes_m[ stripes[i] ].mutex.unlock();
+   }
+}
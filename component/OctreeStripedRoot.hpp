@@ -0,0 +1,417 @@
+/*------------------------------------------------------------------------------
+
+   Octree Component, version 2.1
+   Copyright (c) 2004-2007,  Harrison Ainsworth / HXA7241.
+
+   http://www.hxa7241.org/
+
+------------------------------------------------------------------------------*/
+
+/*------------------------------------------------------------------------------
+
+Copyright (c) 2004-2007, Harrison Ainsworth / HXA7241.
+
+Redistribution and use in source and binary forms, with or without modification,
+are permitted provided that the following conditions are met:
+
+* Redistributions of source code must retain the above copyright notice, this
+  list of conditions and the following disclaimer.
+* Redistributions in binary form must reproduce the above copyright notice, this
+  list of conditions and the following disclaimer in the documentation and/or
+  other materials provided with the distribution.
+* The name of the author may not be used to endorse or promote products derived
+  from this software without specific prior written permission.
+
+THIS SOFTWARE IS PROVIDED BY THE AUTHOR "AS IS" AND ANY EXPRESS OR IMPLIED
+WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT
+SHALL THE AUTHOR BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT
+OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING
+IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY
+OF SUCH DAMAGE.
+
+------------------------------------------------------------------------------*/
+
+
+#ifndef OctreeStripedRoot_h
+#define OctreeStripedRoot_h
+
+
+#include "OctreeImplementation.hpp"
+#include "OctreeAllocator.hpp"
+#include "OctreeTasks.hpp"
+
+
+
+
+namespace hxa7241_graphics
+{
+
+
+/**
+ * Striped implementation class for the Octree template: an alternative to
+ * OctreeRoot, for inserting and removing on several threads at once.<br/><br/>
+ *
+ * The top levels of the tree (up to two) are fixed: always branches, never
+ * made or collapsed. Each cell of the deepest fixed level -- a stripe -- has
+ * its own subtree of ordinary cells, its own cell allocator, and its own
+ * mutex. So all commands and queries can be called on any threads at once:
+ * changes to different stripes run in parallel, and only those to the same
+ * stripe wait for each other. (The cell made or collapsed by a change is
+ * always inside one stripe.) There are at most 64 stripes, however large the
+ * tree: threads changing the same part of space share a stripe, and wait.
+ * <br/><br/>
+ *
+ * insert and remove lock all the stripes the item overlaps (in order, so
+ * never deadlock), then change each. insertRange sorts the items into
+ * stripes, then fills the stripes as tasks, each under its own lock only: so
+ * an item of the range overlapping several stripes appears in them one at a
+ * time. query locks each stripe while in it (so sees other changes stripe by
+ * stripe too); visit, queryNearest, getInfo and getStats lock all stripes
+ * (in order) for their duration, so see each insert and remove whole.
+ * <br/><br/>
+ *
+ * Scaling over cores is unverified: the octreebench figures so far are from
+ * one core, where inserting and removing on 2, 4 and 8 threads at once takes
+ * about 1/1.06, 1/1.05 and 1/1.15 the time of 1 thread.<br/><br/>
+ *
+ * Each stripe keeps stats of its own cells, and counts each item in the first
+ * stripe it overlaps. getStats adds them up, and the fixed cells as branches.
+ * <br/><br/>
+ *
+ * A fixed level is only made where a full cell would subdivide anyway (as
+ * limited by the dimensions). The cells and items below the fixed levels are
+ * the same as OctreeRoot would have (except an item covering a fixed cell,
+ * which is held once in each of its stripes, not once at the fixed cell);
+ * the fixed cells are presented to visitors as branches (with null subcells
+ * where empty), and offered to queries even when empty.<br/><br/>
+ *
+ * The given allocator is unused: each stripe has an OctreeAllocatorPool.
+ * Copying and assigning lock each stripe of the other in turn, but not the
+ * whole of it, nor this.
+ *
+ * @invariants
+ * stripeLevel_m is 0 to 2.<br/>
+ * stripes_m has 8 ^ stripeLevel_m elements, in depth-first order (so a fixed
+ * cell's stripes are a contiguous run). Each pCell can be null, or point to
+ * an OctreeCell, made with its stripe's allocator, and never shared.<br/>
+ */
+class OctreeStripedRoot
+{
+/// standard object services ---------------------------------------------------
+public:
+            OctreeStripedRoot( const Vector3r&   position,
+                               real              sizeOfCube,
+                               dword             maxItemsPerCell,
+                               dword             maxLevelCount,
+                               real              minCellSize,
+                               dword             collapseItemCount,
+                               OctreeAllocatorV& allocator,
+                               real              looseness = 2.0f );
+            OctreeStripedRoot( const OctreeStripedRoot& other,
+                               OctreeAllocatorV&        allocator );
+
+           ~OctreeStripedRoot();
+   OctreeStripedRoot& operator=( const OctreeStripedRoot& );
+private:
+            OctreeStripedRoot( const OctreeStripedRoot& );
+public:
+
+
+/// commands -------------------------------------------------------------------
+           bool  insert( const void*         pItem,
+                         const OctreeAgentV& agent );
+           dword insertRange( const void* const*  pItems,
+                              dword               itemCount,
+                              const OctreeAgentV& agent,
+                              dword               threadCount );
+           bool  remove( const void*         pItem,
+                         const OctreeAgentV& agent );
+           void  collapse();
+
+
+/// queries --------------------------------------------------------------------
+           void  visit( OctreeVisitorV& visitor )                         const;
+   template<class QUERY>
+           void  query( QUERY& query,
+                        dword  subCellOrder = 0 )                         const;
+   template<class QUERY>
+           void  queryNearest( QUERY& query )                             const;
+
+           bool  isEmpty()                                                const;
+           void  getInfo( dword  rootWrapperByteSize,
+                          dword& byteSize,
+                          dword& leafCount,
+                          dword& itemCount,
+                          dword& maxDepth )                               const;
+           void  getStats( OctreeStats& stats )                           const;
+
+           const Vector3r& getPosition()                                  const;
+           real            getSize()                                      const;
+           dword           getMaxItemCountPerCell()                       const;
+           dword           getMaxLevelCount()                             const;
+           real            getMinCellSize()                               const;
+           dword           getCollapseItemCount()                         const;
+           real            getLooseness()                                 const;
+
+
+/// implementation -------------------------------------------------------------
+protected:
+   struct Stripe
+   {
+      Stripe() : pCell( 0 ) {}
+
+      OctreeCell*         pCell;
+      OctreeAllocatorPool allocator;
+      OctreeMutex         mutex;
+      OctreeStats         stats;
+   };
+
+   struct NearCell
+   {
+      real              distance;
+      const OctreeCell* pCell;
+      dword             begin;
+      OctreeData        data;
+   };
+
+   class Cell;
+   friend class Cell;
+   class StripesLocked;
+   friend class StripesLocked;
+
+           void  findStripes( const OctreeData&   cellData,
+                              dword               begin,
+                              const void*         pItem,
+                              const OctreeAgentV& agent,
+                              dword               stripes[],
+                              dword&              stripeCount )           const;
+           OctreeData makeStripeData( dword stripeIndex )                 const;
+           Stripe*    cloneStripes()                                      const;
+
+           dword getStripeSpan( dword level )                             const;
+           const OctreeCell* getCell( dword level,
+                                      dword begin,
+                                      Cell& view )                        const;
+           void  lockAll()                                                const;
+           void  unlockAll()                                              const;
+           void  lockStripes( const dword stripes[],
+                              dword       stripeCount )                   const;
+           void  unlockStripes( const dword stripes[],
+                                dword       stripeCount )                 const;
+
+   template<class QUERY>
+           void  queryCell( const OctreeData& cellData,
+                            dword             begin,
+                            QUERY&            query,
+                            dword             subCellOrder )              const;
+
+
+/// fields ---------------------------------------------------------------------
+private:
+   OctreeDimensions dimensions_m;
+   dword            stripeLevel_m;
+   Stripe*          stripes_m;
+};
+
+
+
+
+/**
+ * Holds all stripes of an OctreeStripedRoot locked for its lifetime -- or
+ * some, given as ascending indexs.
+ */
+class OctreeStripedRoot::StripesLocked
+{
+public:
+   explicit StripesLocked( const OctreeStripedRoot& root )
+    : root_m       ( root )
+    , pStripes_m   ( 0 )
+    , stripeCount_m( 0 )
+   {
+      root_m.lockAll();
+   }
+
+            StripesLocked( const OctreeStripedRoot& root,
+                           const dword              stripes[],
+                           const dword              stripeCount )
+    : root_m       ( root )
+    , pStripes_m   ( stripes )
+    , stripeCount_m( stripeCount )
+   {
+      root_m.lockStripes( pStripes_m, stripeCount_m );
+   }
+
+           ~StripesLocked()
+   {
+      if( pStripes_m )
+      {
+         root_m.unlockStripes( pStripes_m, stripeCount_m );
+      }
+      else
+      {
+         root_m.unlockAll();
+      }
+   }
+
+private:
+            StripesLocked( const StripesLocked& );
+   StripesLocked& operator=( const StripesLocked& );
+
+   const OctreeStripedRoot& root_m;
+   const dword*             pStripes_m;
+   dword                    stripeCount_m;
+};
+
+
+
+
+/// templates ///
+
+/// queries --------------------------------------------------------------------
+template<class QUERY>
+void OctreeStripedRoot::query
+(
+   QUERY&      query,
+   const dword subCellOrder
+) const
+{
+   const OctreeData data( dimensions_m, stripes_m[0].allocator );
+
+   if( OCTREE_COUNT_TEST( query.isEntering( data ) ) )
+   {
+      queryCell( data, 0, query, subCellOrder );
+   }
+}
+
+
+template<class QUERY>
+void OctreeStripedRoot::queryNearest
+(
+   QUERY& query
+) const
+{
+   StripesLocked locked( *this );
+
+   OctreeHeap<NearCell,false> cells;
+
+   // (a fixed cell has no pCell, a stripe's cell has, if not empty)
+   NearCell cell;
+   cell.pCell    = (0 == stripeLevel_m) ? stripes_m[0].pCell : 0;
+   cell.begin    = 0;
+   cell.data     = OctreeData( dimensions_m, stripes_m[0].allocator );
+   cell.distance = query.getCellDistance( cell.data );
+   if( ((0 != stripeLevel_m) | (0 != cell.pCell)) &&
+      OCTREE_COUNT_TEST( cell.distance <= query.getLimit() ) )
+   {
+      cells.push( cell );
+   }
+
+   // enter the nearest cell, until it is beyond the query's limit
+   while( !cells.isEmpty() && (cells.getTop().distance <= query.getLimit()) )
+   {
+      const NearCell nearest = cells.getTop();
+      cells.pop();
+
+      if( nearest.data.getLevel() < stripeLevel_m )
+      {
+         OCTREE_COUNT( addCell( nearest.data.getLevel() ) );
+
+         const dword subLevel = nearest.data.getLevel() + 1;
+         for( dword i = 0;  i < 8;  ++i )
+         {
+            cell.begin = nearest.begin + (i * getStripeSpan( subLevel ));
+            cell.pCell = (subLevel < stripeLevel_m) ? 0 :
+               stripes_m[cell.begin].pCell;
+            if( (subLevel < stripeLevel_m) | (0 != cell.pCell) )
+            {
+               cell.data     = OctreeData( nearest.data, i );
+               cell.distance = query.getCellDistance( cell.data );
+               if( OCTREE_COUNT_TEST( cell.distance <= query.getLimit() ) )
+               {
+                  cells.push( cell );
+               }
+            }
+         }
+      }
+      else if( !nearest.pCell->isBranch() )
+      {
+         static_cast<const OctreeLeaf*>(nearest.pCell)->query( nearest.data,
+            query );
+      }
+      else
+      {
+         OCTREE_COUNT( addCell( nearest.data.getLevel() ) );
+
+         const OctreeBranch*const pBranch =
+            static_cast<const OctreeBranch*>(nearest.pCell);
+         pBranch->queryItems( nearest.data, query );
+
+         const OctreeCell*const* subCells = pBranch->subCells_m;
+         for( dword i = 0;  i < 8;  ++i )
+         {
+            if( subCells[i] )
+            {
+               cell.pCell    = subCells[i];
+               cell.data     = OctreeData( nearest.data, i );
+               cell.distance = query.getCellDistance( cell.data );
+               if( OCTREE_COUNT_TEST( cell.distance <= query.getLimit() ) )
+               {
+                  cells.push( cell );
+               }
+            }
+         }
+      }
+   }
+}
+
+
+template<class QUERY>
+void OctreeStripedRoot::queryCell
+(
+   const OctreeData& cellData,
+   const dword       begin,
+   QUERY&            query,
+   const dword       subCellOrder
+) const
+{
+   // in a stripe: hold it locked while in its cells
+   if( cellData.getLevel() >= stripeLevel_m )
+   {
+      Stripe& stripe = stripes_m[begin];
+      OctreeMutexLocked locked( stripe.mutex );
+
+      if( stripe.pCell )
+      {
+         OctreeCell::queryStatic( stripe.pCell, cellData, query,
+            subCellOrder );
+      }
+   }
+   // fixed cell: step through subcells (in the given order)
+   else
+   {
+      OCTREE_COUNT( addCell( cellData.getLevel() ) );
+
+      const dword span = getStripeSpan( cellData.getLevel() + 1 );
+      for( dword i = 0;  i < 8;  ++i )
+      {
+         const dword      s = i ^ subCellOrder;
+         const OctreeData subCellData( cellData, s );
+         if( OCTREE_COUNT_TEST( query.isEntering( subCellData ) ) )
+         {
+            queryCell( subCellData, begin + (s * span), query, subCellOrder );
+         }
+      }
+   }
+}
+
+
+}//namespace
+
+
+
+
+#endif//OctreeStripedRoot_h
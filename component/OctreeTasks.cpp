@@ -0,0 +1,1025 @@
+/*------------------------------------------------------------------------------
+
+   Octree Component, version 2.1
+   Copyright (c) 2004-2007,  Harrison Ainsworth / HXA7241.
+
+   http://www.hxa7241.org/
+
+------------------------------------------------------------------------------*/
+
+/*------------------------------------------------------------------------------
+
+Copyright (c) 2004-2007, Harrison Ainsworth / HXA7241.
+
+Redistribution and use in source and binary forms, with or without modification,
+are permitted provided that the following conditions are met:
+
+* Redistributions of source code must retain the above copyright notice, this
+  list of conditions and the following disclaimer.
+* Redistributions in binary form must reproduce the above copyright notice, this
+  list of conditions and the following disclaimer in the documentation and/or
+  other materials provided with the distribution.
+* The name of the author may not be used to endorse or promote products derived
+  from this software without specific prior written permission.
+
+THIS SOFTWARE IS PROVIDED BY THE AUTHOR "AS IS" AND ANY EXPRESS OR IMPLIED
+WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT
+SHALL THE AUTHOR BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT
+OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING
+IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY
+OF SUCH DAMAGE.
+
+------------------------------------------------------------------------------*/
+
+
+#include <new>
+#include <assert.h>
+
+#ifdef _WIN32
+#ifndef _WIN32_WINNT
+#define _WIN32_WINNT 0x0600
+#endif
+#define WIN32_LEAN_AND_MEAN
+#define NOMINMAX
+#include <windows.h>
+#else
+#include <pthread.h>
+#include <time.h>
+#endif
+
+#include "Array.hpp"
+#include "OctreeImplementation.hpp"
+
+#include "OctreeTasks.hpp"
+
+
+using namespace hxa7241_graphics;
+
+
+
+
+/// platform ///////////////////////////////////////////////////////////////////
+
+namespace
+{
+
+#ifdef _WIN32
+
+typedef CRITICAL_SECTION   MutexHandle;
+typedef CONDITION_VARIABLE ConditionHandle;
+typedef HANDLE             ThreadHandle;
+
+
+void mutexOpen( MutexHandle& m )
+{
+   ::InitializeCriticalSection( &m );
+}
+
+void mutexClose( MutexHandle& m )
+{
+   ::DeleteCriticalSection( &m );
+}
+
+void mutexLock( MutexHandle& m )
+{
+   ::EnterCriticalSection( &m );
+}
+
+void mutexUnlock( MutexHandle& m )
+{
+   ::LeaveCriticalSection( &m );
+}
+
+
+void conditionOpen( ConditionHandle& c )
+{
+   ::InitializeConditionVariable( &c );
+}
+
+void conditionClose( ConditionHandle& )
+{
+}
+
+void conditionWakeAll( ConditionHandle& c )
+{
+   ::WakeAllConditionVariable( &c );
+}
+
+void conditionWait( ConditionHandle& c, MutexHandle& m )
+{
+   ::SleepConditionVariableCS( &c, &m, INFINITE );
+}
+
+
+dword atomicIncrement( dword& count )
+{
+   return ::InterlockedIncrement( reinterpret_cast<volatile LONG*>(&count) );
+}
+
+dword atomicDecrement( dword& count )
+{
+   return ::InterlockedDecrement( reinterpret_cast<volatile LONG*>(&count) );
+}
+
+dword atomicRead( const dword& count )
+{
+   // (exchanging equal values only reads, with a full barrier)
+   return ::InterlockedCompareExchange( reinterpret_cast<volatile LONG*>(
+      const_cast<dword*>(&count) ), 0, 0 );
+}
+
+void atomicWritePointer( void*& pointer, void* value )
+{
+   ::InterlockedExchangePointer( &pointer, value );
+}
+
+void* atomicReadPointer( void*const& pointer )
+{
+   return ::InterlockedCompareExchangePointer( const_cast<void**>(&pointer),
+      0, 0 );
+}
+
+
+DWORD WINAPI threadEntry( LPVOID pPool )
+{
+   OctreeTaskPool::work( static_cast<OctreeTaskPool*>( pPool ) );
+   return 0;
+}
+
+bool threadStart( ThreadHandle& t, OctreeTaskPool* pPool )
+{
+   t = ::CreateThread( 0, 0, threadEntry, pPool, 0, 0 );
+   return 0 != t;
+}
+
+void threadJoin( ThreadHandle& t )
+{
+   ::WaitForSingleObject( t, INFINITE );
+   ::CloseHandle( t );
+}
+
+
+#define THREAD_LOCAL __declspec(thread)
+
+void clockRead( udword time[2] )
+{
+   // seconds and nanoseconds
+   LARGE_INTEGER counter;
+   LARGE_INTEGER frequency;
+   ::QueryPerformanceCounter( &counter );
+   ::QueryPerformanceFrequency( &frequency );
+   time[0] = static_cast<udword>(counter.QuadPart / frequency.QuadPart);
+   time[1] = static_cast<udword>(((counter.QuadPart % frequency.QuadPart) *
+      1000000000) / frequency.QuadPart);
+}
+
+#else
+
+typedef pthread_mutex_t MutexHandle;
+typedef pthread_cond_t  ConditionHandle;
+typedef pthread_t       ThreadHandle;
+
+
+void mutexOpen( MutexHandle& m )
+{
+   ::pthread_mutex_init( &m, 0 );
+}
+
+void mutexClose( MutexHandle& m )
+{
+   ::pthread_mutex_destroy( &m );
+}
+
+void mutexLock( MutexHandle& m )
+{
+   ::pthread_mutex_lock( &m );
+}
+
+void mutexUnlock( MutexHandle& m )
+{
+   ::pthread_mutex_unlock( &m );
+}
+
+
+void conditionOpen( ConditionHandle& c )
+{
+   ::pthread_cond_init( &c, 0 );
+}
+
+void conditionClose( ConditionHandle& c )
+{
+   ::pthread_cond_destroy( &c );
+}
+
+void conditionWakeAll( ConditionHandle& c )
+{
+   ::pthread_cond_broadcast( &c );
+}
+
+void conditionWait( ConditionHandle& c, MutexHandle& m )
+{
+   ::pthread_cond_wait( &c, &m );
+}
+
+
+dword atomicIncrement( dword& count )
+{
+   return __atomic_add_fetch( &count, 1, __ATOMIC_SEQ_CST );
+}
+
+dword atomicDecrement( dword& count )
+{
+   return __atomic_sub_fetch( &count, 1, __ATOMIC_SEQ_CST );
+}
+
+dword atomicRead( const dword& count )
+{
+   return __atomic_load_n( &count, __ATOMIC_SEQ_CST );
+}
+
+void atomicWritePointer( void*& pointer, void* value )
+{
+   __atomic_store_n( &pointer, value, __ATOMIC_SEQ_CST );
+}
+
+void* atomicReadPointer( void*const& pointer )
+{
+   return __atomic_load_n( &pointer, __ATOMIC_SEQ_CST );
+}
+
+
+void* threadEntry( void* pPool )
+{
+   OctreeTaskPool::work( static_cast<OctreeTaskPool*>( pPool ) );
+   return 0;
+}
+
+bool threadStart( ThreadHandle& t, OctreeTaskPool* pPool )
+{
+   return 0 == ::pthread_create( &t, 0, threadEntry, pPool );
+}
+
+void threadJoin( ThreadHandle& t )
+{
+   ::pthread_join( t, 0 );
+}
+
+
+#define THREAD_LOCAL __thread
+
+void clockRead( udword time[2] )
+{
+   // seconds and nanoseconds
+   timespec t;
+   ::clock_gettime( CLOCK_MONOTONIC, &t );
+   time[0] = static_cast<udword>(t.tv_sec);
+   time[1] = static_cast<udword>(t.tv_nsec);
+}
+
+#endif
+
+
+/// counts of the counted call running on this thread (if any)
+THREAD_LOCAL OctreeCallCounts* pCurrentCounts = 0;
+
+
+/**
+ * Holds a mutex locked for its lifetime.
+ */
+class MutexLocked
+{
+public:
+   explicit MutexLocked( MutexHandle& m )
+    : mutex_m( m )
+   {
+      mutexLock( mutex_m );
+   }
+
+           ~MutexLocked()
+   {
+      mutexUnlock( mutex_m );
+   }
+
+private:
+            MutexLocked( const MutexLocked& );
+   MutexLocked& operator=( const MutexLocked& );
+
+   MutexHandle& mutex_m;
+};
+
+}
+
+
+
+
+
+
+
+
+/// OctreeTaskPool /////////////////////////////////////////////////////////////
+
+
+/// implementation -------------------------------------------------------------
+struct OctreeTaskPool::Group
+{
+   dword remaining;
+   bool  isFailed;
+};
+
+
+struct OctreeTaskPool::Platform
+{
+   struct Entry
+   {
+      OctreeTaskV* pTask;
+      Group*       pGroup;
+   };
+
+   MutexHandle         mutex;
+   ConditionHandle     condition;
+   Array<ThreadHandle> threads;
+   Array<Entry>        queue;
+   bool                isStopping;
+};
+
+
+
+
+/// standard object services ---------------------------------------------------
+OctreeTaskPool::OctreeTaskPool
+(
+   const dword threadCount
+)
+ : threadCount_m( 1 )
+ , pPlatform_m  ( 0 )
+{
+   if( threadCount > 1 )
+   {
+      pPlatform_m = new Platform;
+      pPlatform_m->isStopping = false;
+      mutexOpen( pPlatform_m->mutex );
+      conditionOpen( pPlatform_m->condition );
+
+      try
+      {
+         pPlatform_m->threads.reserve( threadCount - 1 );
+      }
+      catch( ... )
+      {
+         conditionClose( pPlatform_m->condition );
+         mutexClose( pPlatform_m->mutex );
+         delete pPlatform_m;
+
+         throw;
+      }
+
+      // start threads (the calling thread makes one more), carrying on with
+      // fewer if some cannot be started
+      for( dword i = threadCount - 1;  i-- > 0; )
+      {
+         ThreadHandle thread;
+         if( threadStart( thread, this ) )
+         {
+            pPlatform_m->threads.append( thread );
+         }
+      }
+
+      threadCount_m = pPlatform_m->threads.getLength() + 1;
+   }
+}
+
+
+OctreeTaskPool::~OctreeTaskPool()
+{
+   if( pPlatform_m )
+   {
+      // stop threads
+      mutexLock( pPlatform_m->mutex );
+      pPlatform_m->isStopping = true;
+      conditionWakeAll( pPlatform_m->condition );
+      mutexUnlock( pPlatform_m->mutex );
+
+      for( dword i = pPlatform_m->threads.getLength();  i-- > 0; )
+      {
+         threadJoin( pPlatform_m->threads[i] );
+      }
+
+      conditionClose( pPlatform_m->condition );
+      mutexClose( pPlatform_m->mutex );
+      delete pPlatform_m;
+   }
+}
+
+
+
+
+/// commands -------------------------------------------------------------------
+void OctreeTaskPool::runAll
+(
+   OctreeTaskV* const tasks[],
+   const dword        taskCount
+)
+{
+   Group group;
+   group.remaining = taskCount;
+   group.isFailed  = false;
+
+   bool isQueued = false;
+   if( pPlatform_m )
+   {
+      Platform& platform = *pPlatform_m;
+      MutexLocked locked( platform.mutex );
+
+      try
+      {
+         platform.queue.reserve( platform.queue.getLength() + taskCount );
+         isQueued = true;
+      }
+      catch( ... )
+      {
+         // fall through to running them here
+      }
+
+      if( isQueued )
+      {
+         // queue tasks, first last, since the newest is taken first
+         for( dword i = taskCount;  i-- > 0; )
+         {
+            Platform::Entry entry;
+            entry.pTask  = tasks[i];
+            entry.pGroup = &group;
+            platform.queue.append( entry );
+         }
+         conditionWakeAll( platform.condition );
+
+         // run any queued tasks (maybe of other groups) until this group is
+         // done
+         while( group.remaining > 0 )
+         {
+            const dword length = platform.queue.getLength();
+            if( length > 0 )
+            {
+               const Platform::Entry entry( platform.queue[length - 1] );
+               platform.queue.setLength( length - 1 );
+
+               mutexUnlock( platform.mutex );
+               runTask( entry.pTask, entry.pGroup );
+               mutexLock( platform.mutex );
+            }
+            else
+            {
+               conditionWait( platform.condition, platform.mutex );
+            }
+         }
+      }
+   }
+
+   if( !isQueued )
+   {
+      // run in order, on this thread
+      for( dword i = 0;  i < taskCount;  ++i )
+      {
+         runTask( tasks[i], &group );
+      }
+   }
+
+   if( group.isFailed )
+   {
+      throw std::bad_alloc();
+   }
+}
+
+
+
+
+/// queries --------------------------------------------------------------------
+dword OctreeTaskPool::getThreadCount() const
+{
+   return threadCount_m;
+}
+
+
+
+
+/// implementation -------------------------------------------------------------
+void OctreeTaskPool::runTask
+(
+   OctreeTaskV* const pTask,
+   Group* const       pGroup
+)
+{
+   bool isFailed = false;
+   try
+   {
+      pTask->run();
+   }
+   catch( ... )
+   {
+      isFailed = true;
+   }
+
+   // group is shared only when queued
+   if( pPlatform_m )
+   {
+      MutexLocked locked( pPlatform_m->mutex );
+
+      pGroup->isFailed |= isFailed;
+      if( 0 == --pGroup->remaining )
+      {
+         conditionWakeAll( pPlatform_m->condition );
+      }
+   }
+   else
+   {
+      pGroup->isFailed |= isFailed;
+      --pGroup->remaining;
+   }
+}
+
+
+void OctreeTaskPool::work
+(
+   OctreeTaskPool* const pPool
+)
+{
+   Platform& platform = *pPool->pPlatform_m;
+   MutexLocked locked( platform.mutex );
+
+   // run queued tasks until stopped
+   while( !platform.isStopping )
+   {
+      const dword length = platform.queue.getLength();
+      if( length > 0 )
+      {
+         const Platform::Entry entry( platform.queue[length - 1] );
+         platform.queue.setLength( length - 1 );
+
+         mutexUnlock( platform.mutex );
+         pPool->runTask( entry.pTask, entry.pGroup );
+         mutexLock( platform.mutex );
+      }
+      else
+      {
+         conditionWait( platform.condition, platform.mutex );
+      }
+   }
+}
+
+
+
+
+
+
+
+
+/// OctreeAllocatorLocking /////////////////////////////////////////////////////
+
+
+/// implementation -------------------------------------------------------------
+struct OctreeAllocatorLocking::Mutex
+{
+   MutexHandle handle;
+};
+
+
+
+
+/// standard object services ---------------------------------------------------
+OctreeAllocatorLocking::OctreeAllocatorLocking
+(
+   OctreeAllocatorV& allocator
+)
+ : pAllocator_m( &allocator )
+ , pMutex_m    ( new Mutex )
+{
+   mutexOpen( pMutex_m->handle );
+}
+
+
+OctreeAllocatorLocking::~OctreeAllocatorLocking()
+{
+   mutexClose( pMutex_m->handle );
+   delete pMutex_m;
+}
+
+
+
+
+/// commands -------------------------------------------------------------------
+void* OctreeAllocatorLocking::allocateBranch()
+{
+   MutexLocked locked( pMutex_m->handle );
+
+   return pAllocator_m->allocateBranch();
+}
+
+
+void OctreeAllocatorLocking::freeBranch
+(
+   void* pBranch
+)
+{
+   MutexLocked locked( pMutex_m->handle );
+
+   pAllocator_m->freeBranch( pBranch );
+}
+
+
+void* OctreeAllocatorLocking::allocateLeaf()
+{
+   MutexLocked locked( pMutex_m->handle );
+
+   return pAllocator_m->allocateLeaf();
+}
+
+
+void OctreeAllocatorLocking::freeLeaf
+(
+   void* pLeaf
+)
+{
+   MutexLocked locked( pMutex_m->handle );
+
+   pAllocator_m->freeLeaf( pLeaf );
+}
+
+
+void* OctreeAllocatorLocking::allocateLooseNode()
+{
+   MutexLocked locked( pMutex_m->handle );
+
+   return pAllocator_m->allocateLooseNode();
+}
+
+
+void OctreeAllocatorLocking::freeLooseNode
+(
+   void* pNode
+)
+{
+   MutexLocked locked( pMutex_m->handle );
+
+   pAllocator_m->freeLooseNode( pNode );
+}
+
+
+void OctreeAllocatorLocking::freeAll()
+{
+   MutexLocked locked( pMutex_m->handle );
+
+   pAllocator_m->freeAll();
+}
+
+
+
+
+/// queries --------------------------------------------------------------------
+bool OctreeAllocatorLocking::isFreeingAll() const
+{
+   return pAllocator_m->isFreeingAll();
+}
+
+
+
+
+
+
+
+
+/// OctreeMutex ////////////////////////////////////////////////////////////////
+
+
+/// implementation -------------------------------------------------------------
+struct OctreeMutex::Platform
+{
+   MutexHandle handle;
+};
+
+
+
+
+/// standard object services ---------------------------------------------------
+OctreeMutex::OctreeMutex()
+ : pPlatform_m( new Platform )
+{
+   mutexOpen( pPlatform_m->handle );
+}
+
+
+OctreeMutex::~OctreeMutex()
+{
+   mutexClose( pPlatform_m->handle );
+   delete pPlatform_m;
+}
+
+
+
+
+/// commands -------------------------------------------------------------------
+void OctreeMutex::lock()
+{
+   mutexLock( pPlatform_m->handle );
+}
+
+
+void OctreeMutex::unlock()
+{
+   mutexUnlock( pPlatform_m->handle );
+}
+
+
+
+
+
+
+
+
+/// OctreeAtomic ///////////////////////////////////////////////////////////////
+
+
+/// commands -------------------------------------------------------------------
+dword OctreeAtomic::increment
+(
+   dword& count
+)
+{
+   return atomicIncrement( count );
+}
+
+
+dword OctreeAtomic::decrement
+(
+   dword& count
+)
+{
+   return atomicDecrement( count );
+}
+
+
+void OctreeAtomic::writePointer
+(
+   void*&      pointer,
+   void* const value
+)
+{
+   atomicWritePointer( pointer, value );
+}
+
+
+
+
+/// queries --------------------------------------------------------------------
+dword OctreeAtomic::read
+(
+   const dword& count
+)
+{
+   return atomicRead( count );
+}
+
+
+void* OctreeAtomic::readPointer
+(
+   void*const& pointer
+)
+{
+   return atomicReadPointer( pointer );
+}
+
+
+
+
+
+
+
+
+/// OctreeRootVersions /////////////////////////////////////////////////////////
+
+
+/// standard object services ---------------------------------------------------
+OctreeRootVersions::OctreeRootVersions
+(
+   const OctreeRoot& writer
+)
+ : pWriter_m ( &writer )
+ , pCurrent_m( 0 )
+{
+   // first version
+   Version* pCurrent = new Version;
+   pCurrent->pRoot       = 0;
+   pCurrent->readerCount = 0;
+
+   try
+   {
+      pCurrent->pRoot = new OctreeRoot( writer );
+      versions_m.append( pCurrent );
+   }
+   catch( ... )
+   {
+      delete pCurrent->pRoot;
+      delete pCurrent;
+      throw;
+   }
+
+   pCurrent_m = pCurrent;
+}
+
+
+OctreeRootVersions::~OctreeRootVersions()
+{
+   for( dword i = 0;  i < versions_m.getLength();  ++i )
+   {
+      // every reader must have released before destruction
+      assert( 0 == OctreeAtomic::read( versions_m[i]->readerCount ) );
+
+      delete versions_m[i]->pRoot;
+      delete versions_m[i];
+   }
+}
+
+
+
+
+/// commands -------------------------------------------------------------------
+void OctreeRootVersions::publish()
+{
+   // share the writer's cells, as the new current version
+   OctreeRoot* pRoot = new OctreeRoot( *pWriter_m );
+
+   // in a free slot with no readers (a stale one may count itself in a free
+   // slot briefly), or a new one
+   Version* pCurrent = 0;
+   for( dword i = versions_m.getLength();  i-- > 0; )
+   {
+      if( !versions_m[i]->pRoot &&
+         (0 == OctreeAtomic::read( versions_m[i]->readerCount )) )
+      {
+         pCurrent = versions_m[i];
+         break;
+      }
+   }
+   if( !pCurrent )
+   {
+      try
+      {
+         pCurrent = new Version;
+         pCurrent->pRoot       = 0;
+         pCurrent->readerCount = 0;
+         versions_m.append( pCurrent );
+      }
+      catch( ... )
+      {
+         delete pCurrent;
+         delete pRoot;
+         throw;
+      }
+   }
+
+   pCurrent->pRoot = pRoot;
+   OctreeAtomic::writePointer( pCurrent_m, pCurrent );
+
+   reclaim();
+}
+
+
+OctreeRootVersions::Version* OctreeRootVersions::acquire()
+{
+   // count this reader in the current version, if it stays current meanwhile
+   for( ;; )
+   {
+      Version*const pCurrent = static_cast<Version*>(
+         OctreeAtomic::readPointer( pCurrent_m ) );
+
+      OctreeAtomic::increment( pCurrent->readerCount );
+      if( pCurrent == OctreeAtomic::readPointer( pCurrent_m ) )
+      {
+         return pCurrent;
+      }
+      OctreeAtomic::decrement( pCurrent->readerCount );
+   }
+}
+
+
+void OctreeRootVersions::release
+(
+   Version* pVersion
+)
+{
+   OctreeAtomic::decrement( pVersion->readerCount );
+}
+
+
+
+
+/// queries --------------------------------------------------------------------
+dword OctreeRootVersions::getVersionCount() const
+{
+   dword count = 0;
+   for( dword i = 0;  i < versions_m.getLength();  ++i )
+   {
+      count += (0 != versions_m[i]->pRoot) ? 1 : 0;
+   }
+
+   return count;
+}
+
+
+
+
+/// implementation -------------------------------------------------------------
+void OctreeRootVersions::reclaim()
+{
+   // free the older versions with no readers (their cells not shared by newer
+   // versions, or the writer), keeping their slots
+   for( dword i = 0;  i < versions_m.getLength();  ++i )
+   {
+      Version& version = *versions_m[i];
+      if( version.pRoot && (&version != pCurrent_m) &&
+         (0 == OctreeAtomic::read( version.readerCount )) )
+      {
+         delete version.pRoot;
+         version.pRoot = 0;
+      }
+   }
+}
+
+
+
+
+
+
+
+
+/// OctreeCallCounted //////////////////////////////////////////////////////////
+
+
+/// standard object services ---------------------------------------------------
+OctreeCallCounted::OctreeCallCounted
+(
+   OctreeCounts&                  counts,
+   OctreeMutex&                   mutex,
+   const OctreeCounts::EOperation operation
+)
+ : pCounts_m   ( pCurrentCounts ? 0 : &counts )
+ , pMutex_m    ( &mutex )
+ , operation_m ( operation )
+ , callCounts_m()
+{
+   startTime_m[0] = 0;
+   startTime_m[1] = 0;
+
+   // count only the outermost call
+   if( pCounts_m )
+   {
+      pCurrentCounts = &callCounts_m;
+      clockRead( startTime_m );
+   }
+}
+
+
+OctreeCallCounted::~OctreeCallCounted()
+{
+   if( pCounts_m )
+   {
+      udword endTime[2];
+      clockRead( endTime );
+      pCurrentCounts = 0;
+
+      // (clamped to what a dword holds)
+      const dword seconds     = static_cast<dword>(endTime[0] -
+         startTime_m[0]);
+      const dword nanoseconds = (seconds < 2) ? ((seconds * 1000000000) +
+         (static_cast<dword>(endTime[1]) - static_cast<dword>(startTime_m[1])))
+         : DWORD_MAX;
+
+      OctreeMutexLocked locked( *pMutex_m );
+      pCounts_m->addCall( operation_m, callCounts_m, nanoseconds );
+   }
+}
+
+
+
+
+/// queries --------------------------------------------------------------------
+OctreeCallCounts* OctreeCallCounted::getCurrent()
+{
+   return pCurrentCounts;
+}
+
+
+bool OctreeCallCounted::countTest
+(
+   const bool isPassed
+)
+{
+   if( pCurrentCounts )
+   {
+      pCurrentCounts->addTest( isPassed );
+   }
+
+   return isPassed;
+}
@@ -0,0 +1,492 @@
+/*------------------------------------------------------------------------------
+
+   Octree Component, version 2.1
+   Copyright (c) 2004-2007,  Harrison Ainsworth / HXA7241.
+
+   http://www.hxa7241.org/
+
+------------------------------------------------------------------------------*/
+
+/*------------------------------------------------------------------------------
+
+Copyright (c) 2004-2007, Harrison Ainsworth / HXA7241.
+
+Redistribution and use in source and binary forms, with or without modification,
+are permitted provided that the following conditions are met:
+
+* Redistributions of source code must retain the above copyright notice, this
+  list of conditions and the following disclaimer.
+* Redistributions in binary form must reproduce the above copyright notice, this
+  list of conditions and the following disclaimer in the documentation and/or
+  other materials provided with the distribution.
+* The name of the author may not be used to endorse or promote products derived
+  from this software without specific prior written permission.
+
+THIS SOFTWARE IS PROVIDED BY THE AUTHOR "AS IS" AND ANY EXPRESS OR IMPLIED
+WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT
+SHALL THE AUTHOR BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT
+OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING
+IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY
+OF SUCH DAMAGE.
+
+------------------------------------------------------------------------------*/
+
+
+#ifndef OctreeTasks_h
+#define OctreeTasks_h
+
+
+#include "OctreeAuxiliary.hpp"
+
+
+
+
+namespace hxa7241_graphics
+{
+   class OctreeRoot;
+
+
+/**
+ * Task abstract base, for running on an OctreeTaskPool.<br/><br/>
+ *
+ * run may be called on any thread of the pool. It may itself call runAll on
+ * the same pool, to run nested tasks.
+ */
+class OctreeTaskV
+{
+/// standard object services ---------------------------------------------------
+protected:
+            OctreeTaskV() {}
+public:
+   virtual ~OctreeTaskV() {}
+private:
+            OctreeTaskV( const OctreeTaskV& );
+   OctreeTaskV& operator=( const OctreeTaskV& );
+public:
+
+
+/// commands -------------------------------------------------------------------
+   virtual void  run()                                                       =0;
+};
+
+
+
+
+/**
+ * Fork-join pool of threads, for building octree subtrees in parallel.<br/>
+ * <br/>
+ *
+ * runAll queues a group of tasks, and returns when all of them have run. Any
+ * idle thread -- including one waiting in runAll for its own group -- takes
+ * the newest queued task, so nested groups are shared out as threads become
+ * free.<br/><br/>
+ *
+ * With a thread count of 1 (or less), no threads are started, and runAll runs
+ * the tasks in order on the calling thread.
+ *
+ * @implementation
+ * POSIX threads, or Win32 threads when _WIN32 is defined. The platform parts
+ * are hidden in the implementation file.
+ *
+ * @invariants
+ * pPlatform_m is 0 if threadCount_m <= 1, else points to the platform
+ * threads, mutex and condition<br/>
+ */
+class OctreeTaskPool
+{
+/// standard object services ---------------------------------------------------
+public:
+   explicit OctreeTaskPool( dword threadCount );                       // throws
+
+           ~OctreeTaskPool();
+private:
+            OctreeTaskPool( const OctreeTaskPool& );
+   OctreeTaskPool& operator=( const OctreeTaskPool& );
+public:
+
+
+/// commands -------------------------------------------------------------------
+   /**
+    * Runs the tasks, on any threads of the pool, and waits for all of them.
+    * <br/><br/>
+    * @exceptions
+    * If any task throws, the rest still run, then std::bad_alloc is thrown.
+    */
+           void  runAll( OctreeTaskV* const tasks[],
+                         dword              taskCount );               // throws
+
+
+/// queries --------------------------------------------------------------------
+           dword getThreadCount()                                         const;
+
+
+/// implementation -------------------------------------------------------------
+   struct Group;
+   struct Platform;
+
+   // thread body (public only for the platform thread entry function)
+   static  void  work( OctreeTaskPool* pPool );
+
+protected:
+           void  runTask( OctreeTaskV* pTask,
+                          Group*       pGroup );
+
+
+/// fields ---------------------------------------------------------------------
+private:
+   dword     threadCount_m;
+   Platform* pPlatform_m;
+};
+
+
+
+
+/**
+ * Cell allocator wrapper, making another allocator safe to share between
+ * threads.<br/><br/>
+ *
+ * Every call is forwarded to the wrapped allocator, one thread at a time.
+ */
+class OctreeAllocatorLocking
+   : public OctreeAllocatorV
+{
+/// standard object services ---------------------------------------------------
+public:
+   explicit OctreeAllocatorLocking( OctreeAllocatorV& allocator );     // throws
+
+   virtual ~OctreeAllocatorLocking();
+private:
+            OctreeAllocatorLocking( const OctreeAllocatorLocking& );
+   OctreeAllocatorLocking& operator=( const OctreeAllocatorLocking& );
+public:
+
+
+/// commands -------------------------------------------------------------------
+   virtual void* allocateBranch();
+   virtual void  freeBranch( void* pBranch );
+   virtual void* allocateLeaf();
+   virtual void  freeLeaf( void* pLeaf );
+   virtual void* allocateLooseNode();
+   virtual void  freeLooseNode( void* pNode );
+
+   virtual void  freeAll();
+
+
+/// queries --------------------------------------------------------------------
+   virtual bool  isFreeingAll()                                           const;
+
+
+/// implementation -------------------------------------------------------------
+   struct Mutex;
+
+
+/// fields ---------------------------------------------------------------------
+private:
+   OctreeAllocatorV* pAllocator_m;
+   Mutex*            pMutex_m;
+};
+
+
+
+
+/**
+ * Mutex, for locking parts of an octree between threads.<br/><br/>
+ *
+ * Not recursive. OctreeMutexLocked holds one locked for its lifetime.
+ *
+ * @implementation
+ * As OctreeTaskPool, the platform mutex is hidden in the implementation file.
+ *
+ * @see OctreeStripedRoot
+ */
+class OctreeMutex
+{
+/// standard object services ---------------------------------------------------
+public:
+            OctreeMutex();                                             // throws
+
+           ~OctreeMutex();
+private:
+            OctreeMutex( const OctreeMutex& );
+   OctreeMutex& operator=( const OctreeMutex& );
+public:
+
+
+/// commands -------------------------------------------------------------------
+           void  lock();
+           void  unlock();
+
+
+/// implementation -------------------------------------------------------------
+   struct Platform;
+
+
+/// fields ---------------------------------------------------------------------
+private:
+   Platform* pPlatform_m;
+};
+
+
+
+
+/**
+ * Holds an OctreeMutex locked for its lifetime.
+ */
+class OctreeMutexLocked
+{
+/// standard object services ---------------------------------------------------
+public:
+   explicit OctreeMutexLocked( OctreeMutex& mutex );
+
+           ~OctreeMutexLocked();
+private:
+            OctreeMutexLocked( const OctreeMutexLocked& );
+   OctreeMutexLocked& operator=( const OctreeMutexLocked& );
+public:
+
+
+/// fields ---------------------------------------------------------------------
+private:
+   OctreeMutex& mutex_m;
+};
+
+
+
+
+/**
+ * Atomic counting, for counts (and pointers) changed on several threads.
+ * <br/><br/>
+ *
+ * increment and decrement give the new count; read gives a count with all
+ * changes made before it on other threads (and what they did before them).
+ * All are sequentially consistent: every thread sees them in one order.
+ *
+ * @implementation
+ * As OctreeTaskPool, the platform atomics are hidden in the implementation
+ * file.
+ *
+ * @see OctreeCell OctreeAllocatorShared
+ */
+class OctreeAtomic
+{
+/// standard object services ---------------------------------------------------
+private:
+            OctreeAtomic();
+public:
+
+
+/// commands -------------------------------------------------------------------
+   static  dword increment( dword& count );
+   static  dword decrement( dword& count );
+
+
+   static  void  writePointer( void*& pointer,
+                               void*  value );
+
+
+/// queries --------------------------------------------------------------------
+   static  dword read( const dword& count );
+   static  void* readPointer( void*const& pointer );
+};
+
+
+
+
+/**
+ * Published versions of an OctreeRoot, for reading on any threads while one
+ * thread changes it.<br/><br/>
+ *
+ * publish makes a new current version: a sharing copy of the writer root, so
+ * the writer copies any cell (and the path to it) before changing it, and
+ * versions never change. Readers acquire the current version, query it, and
+ * release it, never locking. An older version is kept until none of its
+ * readers remain, then freed by a later publish.<br/><br/>
+ *
+ * publish, getVersionCount, construction and destruction are for the writer's
+ * thread (all readers must have released by destruction); acquire and release
+ * are for any thread.
+ *
+ * @implementation
+ * Each version is a slot, made with new and kept until destruction (so a
+ * reader can count itself in one the writer has meanwhile freed, or reused).
+ * acquire counts itself in the current slot, then checks it is still current
+ * -- else uncounts and tries again. publish fills a free slot, makes it
+ * current, then frees the roots of other slots with no readers. With the
+ * counts and current pointer atomic, either the reader sees the new current
+ * slot, or the writer sees the reader's count.
+ *
+ * @invariants
+ * versions_m holds all slots, and pCurrent_m is one of them, with a root.<br/>
+ * Each pRoot is zero (a free slot), or a sharing copy of *pWriter_m, made
+ * with new.<br/>
+ */
+class OctreeRootVersions
+{
+/// standard object services ---------------------------------------------------
+public:
+   explicit OctreeRootVersions( const OctreeRoot& writer );            // throws
+
+           ~OctreeRootVersions();
+private:
+            OctreeRootVersions( const OctreeRootVersions& );
+   OctreeRootVersions& operator=( const OctreeRootVersions& );
+public:
+
+
+/// commands -------------------------------------------------------------------
+           void  publish();                                           // throws
+
+   struct Version;
+
+           Version* acquire();
+           void     release( Version* pVersion );
+
+
+/// queries --------------------------------------------------------------------
+           dword getVersionCount()                                        const;
+
+
+/// implementation -------------------------------------------------------------
+   struct Version
+   {
+      const OctreeRoot* pRoot;
+      // by OctreeAtomic only
+      dword             readerCount;
+   };
+
+protected:
+           void  reclaim();
+
+
+/// fields ---------------------------------------------------------------------
+private:
+   const OctreeRoot* pWriter_m;
+   Array<Version*>   versions_m;
+   // the current Version, by OctreeAtomic only
+   void*             pCurrent_m;
+};
+
+
+
+
+/**
+ * Counts one call of an octree command or query, for its lifetime: makes its
+ * OctreeCallCounts the thread's current ones (for the OCTREE_COUNT points to
+ * add to), and times it, then adds both into an OctreeCounts, under a mutex.
+ * <br/><br/>
+ *
+ * A call made inside another counted one, on the same thread, counts as part
+ * of the outer one. Work on other threads -- the tasks of a parallel
+ * insertRange or visitParallel -- is timed with the call, but not counted.
+ *
+ * @implementation
+ * The current counts are a thread-local pointer, and the clock is monotonic:
+ * as OctreeTaskPool, the platform parts are hidden in the implementation
+ * file.
+ */
+class OctreeCallCounted
+{
+/// standard object services ---------------------------------------------------
+public:
+            OctreeCallCounted( OctreeCounts&            counts,
+                               OctreeMutex&             mutex,
+                               OctreeCounts::EOperation operation );
+
+           ~OctreeCallCounted();
+private:
+            OctreeCallCounted( const OctreeCallCounted& );
+   OctreeCallCounted& operator=( const OctreeCallCounted& );
+public:
+
+
+/// queries --------------------------------------------------------------------
+   static  OctreeCallCounts* getCurrent();
+   static  bool              countTest( bool isPassed );
+
+
+/// fields ---------------------------------------------------------------------
+private:
+   // null when inside another counted call
+   OctreeCounts*            pCounts_m;
+   OctreeMutex*             pMutex_m;
+   OctreeCounts::EOperation operation_m;
+   OctreeCallCounts         callCounts_m;
+   udword                   startTime_m[2];
+};
+
+
+
+
+
+
+
+
+/// inlines ///
+
+/// OctreeMutexLocked ----------------------------------------------------------
+inline
+OctreeMutexLocked::OctreeMutexLocked
+(
+   OctreeMutex& mutex
+)
+ : mutex_m( mutex )
+{
+   mutex_m.lock();
+}
+
+
+inline
+OctreeMutexLocked::~OctreeMutexLocked()
+{
+   mutex_m.unlock();
+}
+
+
+}//namespace
+
+
+
+
+/**
+ * Counting points, for OctreeCallCounted -- compiled in only when
+ * OCTREE_INSTRUMENTED is defined.<br/><br/>
+ *
+ * OCTREE_COUNT calls a command on the current call's counts (if any).
+ * OCTREE_COUNT_TEST counts an overlap test, and gives its result.
+ * OCTREE_COUNTED counts the rest of the enclosing block as a call.
+ */
+#ifdef OCTREE_INSTRUMENTED
+
+#define OCTREE_COUNT( command ) \
+   do \
+   { \
+      hxa7241_graphics::OctreeCallCounts*const pCurrent_ = \
+         hxa7241_graphics::OctreeCallCounted::getCurrent(); \
+      if( pCurrent_ ) \
+      { \
+         pCurrent_->command; \
+      } \
+   } while( false )
+
+#define OCTREE_COUNT_TEST( isPassed ) \
+   hxa7241_graphics::OctreeCallCounted::countTest( isPassed )
+
+#define OCTREE_COUNTED( counts, mutex, operation ) \
+   hxa7241_graphics::OctreeCallCounted counted_( counts, mutex, operation )
+
+#else
+
+#define OCTREE_COUNT( command )
+#define OCTREE_COUNT_TEST( isPassed ) (isPassed)
+#define OCTREE_COUNTED( counts, mutex, operation )
+
+#endif
+
+
+
+
+#endif//OctreeTasks_h
@@ -496,7 +496,7 @@ real Vector3r::length() const
 }
 
 
-/*real Vector3r::dot
+real Vector3r::dot
 (
    const Vector3r& v
 ) const
@@ -508,7 +508,7 @@ real Vector3r::length() const
 }
 
 
-real Vector3r::distance
+/*real Vector3r::distance
 (
    const Vector3r& v
 ) const
@@ -562,7 +562,7 @@ Vector3r Vector3r::unitized() const
       xyz_m[0] * oneOverLength,
       xyz_m[1] * oneOverLength,
       xyz_m[2] * oneOverLength );
-}
+}*/
 
 
 Vector3r Vector3r::cross
@@ -574,7 +574,7 @@ Vector3r Vector3r::cross
       (xyz_m[1] * v.xyz_m[2]) - (xyz_m[2] * v.xyz_m[1]),
       (xyz_m[2] * v.xyz_m[0]) - (xyz_m[0] * v.xyz_m[2]),
       (xyz_m[0] * v.xyz_m[1]) - (xyz_m[1] * v.xyz_m[0]) );
-}*/
+}
 
 
 Vector3r Vector3r::operator+
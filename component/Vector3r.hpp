@@ -120,14 +120,14 @@ public:
 //           real      largest()                                            const;
 
            real      length()                                             const;
-//           real      dot( const Vector3r& )                               const;
+           real      dot( const Vector3r& )                               const;
 //           real      distance ( const Vector3r& )                         const;
 //           real      distance2( const Vector3r& )                         const;
 
 //           Vector3r  operator-()                                          const;
 //           Vector3r  abs()                                                const;
 //           Vector3r  unitized()                                           const;
-//           Vector3r  cross( const Vector3r& )                             const;
+           Vector3r  cross( const Vector3r& )                             const;
 
            Vector3r  operator+( const Vector3r& )                         const;
            Vector3r  operator-( const Vector3r& )                         const;
@@ -0,0 +1,1403 @@
+/*------------------------------------------------------------------------------
+
+   Octree Component, version 2.1
+   Copyright (c) 2004-2007,  Harrison Ainsworth / HXA7241.
+
+   http://www.hxa7241.org/
+
+------------------------------------------------------------------------------*/
+
+/*------------------------------------------------------------------------------
+
+Copyright (c) 2004-2007, Harrison Ainsworth / HXA7241.
+
+Redistribution and use in source and binary forms, with or without modification,
+are permitted provided that the following conditions are met:
+
+* Redistributions of source code must retain the above copyright notice, this
+  list of conditions and the following disclaimer.
+* Redistributions in binary form must reproduce the above copyright notice, this
+  list of conditions and the following disclaimer in the documentation and/or
+  other materials provided with the distribution.
+* The name of the author may not be used to endorse or promote products derived
+  from this software without specific prior written permission.
+
+THIS SOFTWARE IS PROVIDED BY THE AUTHOR "AS IS" AND ANY EXPRESS OR IMPLIED
+WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT
+SHALL THE AUTHOR BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT
+OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING
+IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY
+OF SUCH DAMAGE.
+
+------------------------------------------------------------------------------*/
+
+
+#include <stdlib.h>
+#include <math.h>
+#include <string.h>
+#include <time.h>
+#ifdef _WIN32
+#define WIN32_LEAN_AND_MEAN
+#define NOMINMAX
+#include <windows.h>
+#include <psapi.h>
+#else
+#include <sys/time.h>
+#include <sys/resource.h>
+#endif
+#include <vector>
+#include <memory>
+#include <algorithm>
+#include <iostream>
+
+#include "Octree.hpp"
+#include "RandomFast.hpp"
+
+
+using namespace hxa7241_graphics;
+
+
+
+
+/**
+ * Benchmark of Octree against OctreeStatic.<br/><br/>
+ *
+ * Times the same work -- inserting random small blocks one at a time,
+ * counting those in random boxes, removing them one at a time -- through the
+ * virtual agent and visitor, and through the static (compile-time) agent and
+ * query. Both use the same overlap arithmetic.<br/><br/>
+ *
+ * Also times finding the nearest blocks to random points, with
+ * queryNearest on each, against a brute-force scan of all the blocks.<br/><br/>
+ *
+ * And times packets of nearby rays, and of nearby boxes, each queried one at
+ * a time (queryRay, queryBox) against all at once (queryRays, queryBoxes), on
+ * the static octree.<br/><br/>
+ *
+ * And times inserting then removing all the blocks on 1, 2, 4 and 8 threads
+ * at once, each its own slab of space, by wall-clock: into an Octree behind
+ * one lock, against an Octree with OctreeStripedRoot.<br/><br/>
+ *
+ * And times inserting all the blocks, removing every second one, then
+ * destroying the octree, with cells from OctreeAllocatorHeap against
+ * OctreeAllocatorPool.<br/><br/>
+ *
+ * Usage: octreebench [itemCount [queryCount [seed]]]<br/><br/>
+ *
+ * Or, for tracking between versions, times a suite of workloads on Octree,
+ * and writes a row for each operation as CSV or JSON: ns per op, ops per
+ * second, and the peak resident size so far. The workloads are points (blocks
+ * one 2^-24 step wide) and small blocks, placed uniformly, in clusters, near a
+ * plane, or 16 at each place -- at each item count given (1K to 100M, say).
+ * Each is made from the seed alone, and a smaller one is the start of a
+ * larger. The operations are insertRange of all, queryBox, queryNearest,
+ * queryRay, copy (and destroy of the copy), destroy of all, and insert then
+ * remove of each in turn. The same queries on OctreeLinear, OctreeStripedRoot
+ * and OctreeLooseRoot are checked against OctreeRoot's results (untimed, up
+ * to 1M items), and any difference fails the run.<br/><br/>
+ *
+ * Usage: octreebench -csv|-json [seed [itemCount ...]]<br/><br/>
+ *
+ * Other arguments -- not numbers, or counts of zero -- are refused, with the
+ * usage.
+ */
+
+
+
+
+/// Block //////////////////////////////////////////////////////////////////////
+
+/**
+ * A minimal axis-aligned block item.
+ */
+struct Block
+{
+   Vector3r lower;
+   Vector3r upper;
+};
+
+
+
+
+/// OctreeAgentStaticBlock /////////////////////////////////////////////////////
+
+/**
+ * Agent for OctreeStatic: public, non-virtual members.
+ */
+class OctreeAgentStaticBlock
+{
+/// queries --------------------------------------------------------------------
+public:
+   bool  isOverlappingCell ( const Block&    item,
+                             const Vector3r& lowerCorner,
+                             const Vector3r& upperCorner )                const
+   {
+      // check the two ranges overlap in every dimension
+      bool isOverlap = true;
+      for( int i = 3;  i-- > 0; )
+      {
+         isOverlap &= (item.lower[i] < upperCorner[i]) &
+                      (item.upper[i] > lowerCorner[i]);
+      }
+
+      return isOverlap;
+   }
+
+   bool  isCoveringCell    ( const Block&    item,
+                             const Vector3r& lowerCorner,
+                             const Vector3r& upperCorner )                const
+   {
+      return OctreeShape::isCoveringBox( item.lower, item.upper, lowerCorner,
+         upperCorner );
+   }
+
+   dword getSubcellOverlaps( const Block&    item,
+                             const Vector3r& lower,
+                             const Vector3r& middle,
+                             const Vector3r& upper )                      const
+   {
+      // find which halfs are overlapped, along each axis
+      dword halfs[3][2];
+      for( int k = 3;  k-- > 0; )
+      {
+         halfs[k][0] = (item.lower[k] < middle[k]) & (item.upper[k] > lower[k]);
+         halfs[k][1] = (item.lower[k] < upper[k]) & (item.upper[k] > middle[k]);
+      }
+
+      // a subcell is overlapped if its half along every axis is
+      dword flags = 0;
+      for( dword i = 8;  i-- > 0; )
+      {
+         flags |= (halfs[0][i & 1] & halfs[1][(i >> 1) & 1] &
+            halfs[2][(i >> 2) & 1]) << i;
+      }
+
+      return flags;
+   }
+
+   real  getDistance       ( const Block&    item,
+                             const Vector3r& point )                      const
+   {
+      // sum the squared distances outside the range, along each axis
+      real distance2 = 0.0f;
+      for( int i = 3;  i-- > 0; )
+      {
+         const real below = item.lower[i] - point[i];
+         const real above = point[i] - item.upper[i];
+         const real d     = (below > 0.0f) ? below : ((above > 0.0f) ? above :
+            0.0f);
+         distance2 += d * d;
+      }
+
+      return sqrt( distance2 );
+   }
+
+   real  getRayIntersection( const Block&    item,
+                             const Vector3r& rayOrigin,
+                             const Vector3r& rayDirection )               const
+   {
+      // narrow the ray's span by the slab along each axis
+      real tEnter = 0.0f;
+      real tExit  = REAL_MAX;
+      for( int i = 3;  i-- > 0; )
+      {
+         const real d = rayDirection[i];
+         if( 0.0f != d )
+         {
+            const real t0 = (item.lower[i] - rayOrigin[i]) / d;
+            const real t1 = (item.upper[i] - rayOrigin[i]) / d;
+            tEnter = std::max( tEnter, std::min( t0, t1 ) );
+            tExit  = std::min( tExit,  std::max( t0, t1 ) );
+         }
+         else if( (rayOrigin[i] < item.lower[i]) |
+            (rayOrigin[i] > item.upper[i]) )
+         {
+            tExit = -1.0f;
+         }
+      }
+
+      return (tEnter <= tExit) ? tEnter : REAL_MAX;
+   }
+};
+
+
+
+
+/// OctreeAgentBlock ///////////////////////////////////////////////////////////
+
+/**
+ * Agent for Octree: the same arithmetic, behind the virtual interface.
+ */
+class OctreeAgentBlock
+   : public OctreeAgent<Block>
+{
+/// standard object services ---------------------------------------------------
+public:
+            OctreeAgentBlock() {};
+
+   virtual ~OctreeAgentBlock() {};
+private:
+            OctreeAgentBlock( const OctreeAgentBlock& );
+   OctreeAgentBlock& operator=( const OctreeAgentBlock& );
+
+
+/// queries --------------------------------------------------------------------
+/// octree agent overrides
+protected:
+   virtual bool  isOverlappingCell ( const Block&    item,
+                                     const Vector3r& lowerCorner,
+                                     const Vector3r& upperCorner )        const
+   {
+      return agent_m.isOverlappingCell( item, lowerCorner, upperCorner );
+   }
+
+   virtual bool  isCoveringCell    ( const Block&    item,
+                                     const Vector3r& lowerCorner,
+                                     const Vector3r& upperCorner )        const
+   {
+      return agent_m.isCoveringCell( item, lowerCorner, upperCorner );
+   }
+
+   virtual dword getSubcellOverlaps( const Block&    item,
+                                     const Vector3r& lower,
+                                     const Vector3r& middle,
+                                     const Vector3r& upper )              const
+   {
+      return agent_m.getSubcellOverlaps( item, lower, middle, upper );
+   }
+
+   virtual real  getDistance       ( const Block&    item,
+                                     const Vector3r& point )              const
+   {
+      return agent_m.getDistance( item, point );
+   }
+
+   virtual real  getRayIntersection( const Block&    item,
+                                     const Vector3r& rayOrigin,
+                                     const Vector3r& rayDirection )       const
+   {
+      return agent_m.getRayIntersection( item, rayOrigin, rayDirection );
+   }
+
+   virtual void  getBound          ( const Block&    item,
+                                     Vector3r&       lowerCorner,
+                                     Vector3r&       upperCorner )        const
+   {
+      lowerCorner = item.lower;
+      upperCorner = item.upper;
+   }
+
+
+/// fields ---------------------------------------------------------------------
+private:
+   OctreeAgentStaticBlock agent_m;
+};
+
+
+
+
+/// OctreeQueryBox /////////////////////////////////////////////////////////////
+
+/**
+ * Query for OctreeStatic: counts item refs in leafs overlapping a box.
+ */
+class OctreeQueryBox
+{
+/// standard object services ---------------------------------------------------
+public:
+   explicit OctreeQueryBox( const Block& box )
+    : box_m  ( box )
+    , count_m( 0 )
+   {
+   }
+
+
+/// commands -------------------------------------------------------------------
+/// octree static query
+   bool  isEntering( const OctreeData& cellData )
+   {
+      return OctreeAgentStaticBlock().isOverlappingCell( box_m,
+         cellData.getBound().getLowerCorner(),
+         cellData.getBound().getUpperCorner() );
+   }
+
+   void  visitLeaf ( const Block* const* ,//pItems,
+                     const dword         itemCount,
+                     const OctreeData&   )//leafData )
+   {
+      count_m += itemCount;
+   }
+
+
+/// queries --------------------------------------------------------------------
+   dword getCount()                                                       const
+   {
+      return count_m;
+   }
+
+
+/// fields ---------------------------------------------------------------------
+private:
+   Block box_m;
+   dword count_m;
+};
+
+
+
+
+/// OctreeVisitorBox ///////////////////////////////////////////////////////////
+
+/**
+ * Visitor for Octree: the same count, behind the virtual interface.
+ */
+class OctreeVisitorBox
+   : public OctreeVisitor<Block>
+{
+/// standard object services ---------------------------------------------------
+public:
+   explicit OctreeVisitorBox( const Block& box )
+    : query_m( box )
+   {
+   }
+
+   virtual ~OctreeVisitorBox() {};
+private:
+            OctreeVisitorBox( const OctreeVisitorBox& );
+   OctreeVisitorBox& operator=( const OctreeVisitorBox& );
+
+
+/// commands -------------------------------------------------------------------
+/// octree visitor overrides
+protected:
+   virtual void  visitRoot  ( const OctreeCell* pRootCell,
+                              const OctreeData& octreeData )
+   {
+      OctreeRoot::continueVisit( pRootCell, octreeData, *this );
+   }
+
+   virtual void  visitBranch( const OctreeCell* subCells[8],
+                              const OctreeData& octreeData )
+   {
+      if( query_m.isEntering( octreeData ) )
+      {
+         for( dword i = 0;  i < 8;  ++i )
+         {
+            OctreeBranch::continueVisit( subCells, octreeData, i, *this );
+         }
+      }
+   }
+
+   virtual void  visitLeaf  ( const Array<const Block*>& items,
+                              const OctreeData&          octreeData )
+   {
+      if( query_m.isEntering( octreeData ) )
+      {
+         query_m.visitLeaf( items.getStorage(), items.getLength(),
+            octreeData );
+      }
+   }
+
+
+/// queries --------------------------------------------------------------------
+public:
+   dword getCount()                                                       const
+   {
+      return query_m.getCount();
+   }
+
+
+/// fields ---------------------------------------------------------------------
+private:
+   OctreeQueryBox query_m;
+};
+
+
+
+
+
+
+
+
+/// InsertRemoveTask ///////////////////////////////////////////////////////////
+
+/**
+ * Inserts some blocks into an octree, then removes them, one at a time --
+ * each under a lock, if given one.
+ */
+template<class OCTREE>
+class InsertRemoveTask
+   : public OctreeTaskV
+{
+/// standard object services ---------------------------------------------------
+public:
+            InsertRemoveTask() {}
+   virtual ~InsertRemoveTask() {}
+private:
+            InsertRemoveTask( const InsertRemoveTask& );
+   InsertRemoveTask& operator=( const InsertRemoveTask& );
+public:
+
+
+/// commands -------------------------------------------------------------------
+   void set( OCTREE&                          octree,
+             OctreeMutex*                     pMutex,
+             const std::vector<const Block*>& items )
+   {
+      pOctree_m = &octree;
+      pMutex_m  = pMutex;
+      pItems_m  = &items;
+   }
+
+   virtual void run()
+   {
+      const OctreeAgentBlock           agent;
+      const std::vector<const Block*>& items = *pItems_m;
+
+      for( udword i = 0;  i < items.size();  ++i )
+      {
+         if( pMutex_m )
+         {
+            OctreeMutexLocked locked( *pMutex_m );
+            pOctree_m->insert( *items[i], agent );
+         }
+         else
+         {
+            pOctree_m->insert( *items[i], agent );
+         }
+      }
+
+      for( udword i = 0;  i < items.size();  ++i )
+      {
+         if( pMutex_m )
+         {
+            OctreeMutexLocked locked( *pMutex_m );
+            pOctree_m->remove( *items[i], agent );
+         }
+         else
+         {
+            pOctree_m->remove( *items[i], agent );
+         }
+      }
+   }
+
+
+/// fields ---------------------------------------------------------------------
+private:
+   OCTREE*                          pOctree_m;
+   OctreeMutex*                     pMutex_m;
+   const std::vector<const Block*>* pItems_m;
+};
+
+
+
+
+
+
+
+
+/// functions //////////////////////////////////////////////////////////////////
+
+/// most threads to insert and remove on at once
+static const dword THREAD_COUNT_MAX = 8;
+
+/// workload placements, for the suite
+static const char* const DISTRIBUTION_NAMES[] =
+   { "uniform", "clustered", "planar", "duplicate" };
+static const dword       DISTRIBUTION_COUNT = 4;
+
+/// queries of each kind, and copies, for each workload of the suite
+static const dword SUITE_QUERY_COUNT = 1000;
+
+/// smallest cell for the suite (else blocks at one place, more than a leaf
+/// holds, subdivide down to the depth limit all over)
+static const real  SUITE_MIN_CELL_SIZE = 1.0f / 4096.0f;
+
+/// most items for which the suite checks the other roots (each holds a copy
+/// of the index)
+static const dword SUITE_CHECK_ITEM_MAX = 1000000;
+
+
+static void makeBlocks
+(
+   const dword         count,
+   const real          extent,
+   RandomFast&         rand,
+   std::vector<Block>& blocks
+)
+{
+   blocks.resize( count );
+   for( dword i = 0;  i < count;  ++i )
+   {
+      real lower[3];
+      real upper[3];
+      for( int k = 3;  k-- > 0; )
+      {
+         const real size = rand.next().getFloat() * extent;
+         lower[k] = rand.next().getFloat() * (1.0f - size);
+         upper[k] = lower[k] + size;
+      }
+      blocks[i].lower = Vector3r( lower[0], lower[1], lower[2] );
+      blocks[i].upper = Vector3r( upper[0], upper[1], upper[2] );
+   }
+}
+
+
+/**
+ * Makes points (blocks one 2^-24 step wide, so each is in one cell) or small
+ * blocks, placed by a distribution: 0 uniform, 1 clustered (about 16 random
+ * centres), 2 planar (near z = 0.5), 3 duplicate (16 at each place).
+ */
+static void makeWorkload
+(
+   const dword         distribution,
+   const bool          isPoints,
+   const dword         count,
+   RandomFast&         rand,
+   std::vector<Block>& blocks
+)
+{
+   real centres[16][3];
+   for( dword c = 0;  c < 16;  ++c )
+   {
+      for( int k = 3;  k-- > 0; )
+      {
+         centres[c][k] = 0.1f + (rand.next().getFloat() * 0.8f);
+      }
+   }
+
+   blocks.resize( count );
+   for( dword i = 0;  i < count;  ++i )
+   {
+      // duplicate: repeat the first of each 16
+      if( (3 == distribution) && (0 != (i & 15)) )
+      {
+         blocks[i] = blocks[i & ~15];
+      }
+      else
+      {
+         const dword c = rand.next().getUdword() >> 28;
+
+         real lower[3];
+         real upper[3];
+         for( int k = 3;  k-- > 0; )
+         {
+            const real size = isPoints ? (1.0f / static_cast<real>(1 << 24)) :
+               (rand.next().getFloat() * 0.002f);
+
+            real place = rand.next().getFloat() * (1.0f - size);
+            if( 1 == distribution )
+            {
+               // roughly normal about the centre (a sum of three uniforms)
+               place = centres[c][k] + ((place + rand.next().getFloat() +
+                  rand.next().getFloat() - 1.5f) * 0.03f);
+            }
+            else if( (2 == distribution) && (2 == k) )
+            {
+               place = 0.5f + ((place - 0.5f) * 0.002f);
+            }
+
+            // keep inside the root cell
+            lower[k] = std::max( 0.0f, std::min( place, 1.0f - size ) );
+            upper[k] = lower[k] + size;
+         }
+         blocks[i].lower = Vector3r( lower[0], lower[1], lower[2] );
+         blocks[i].upper = Vector3r( upper[0], upper[1], upper[2] );
+      }
+   }
+}
+
+
+static double seconds( const clock_t begin )
+{
+   return static_cast<double>(clock() - begin) /
+      static_cast<double>(CLOCKS_PER_SEC);
+}
+
+
+/**
+ * Wall-clock time, in seconds (clock gives processor time, which sums all
+ * threads).
+ */
+static double wallSeconds()
+{
+#ifdef _WIN32
+   LARGE_INTEGER count;
+   LARGE_INTEGER frequency;
+   ::QueryPerformanceCounter( &count );
+   ::QueryPerformanceFrequency( &frequency );
+   return static_cast<double>(count.QuadPart) /
+      static_cast<double>(frequency.QuadPart);
+#else
+   timeval now;
+   ::gettimeofday( &now, 0 );
+   return static_cast<double>(now.tv_sec) +
+      (static_cast<double>(now.tv_usec) * 1e-6);
+#endif
+}
+
+
+/**
+ * Peak resident size of the process so far, in kilobytes.
+ */
+static dword peakKilobytes()
+{
+#ifdef _WIN32
+   PROCESS_MEMORY_COUNTERS counters;
+   ::GetProcessMemoryInfo( ::GetCurrentProcess(), &counters,
+      sizeof(counters) );
+   return static_cast<dword>(counters.PeakWorkingSetSize / 1024);
+#else
+   // (in kilobytes, on Linux)
+   rusage usage;
+   ::getrusage( RUSAGE_SELF, &usage );
+   return static_cast<dword>(usage.ru_maxrss);
+#endif
+}
+
+
+/**
+ * Inserts then removes each slab's blocks, on a thread each, at once (at
+ * most THREAD_COUNT_MAX slabs).
+ * @return wall-clock seconds
+ */
+template<class OCTREE>
+static double timeInsertRemove
+(
+   OCTREE&                                        octree,
+   OctreeMutex*                                   pMutex,
+   const std::vector<std::vector<const Block*> >& slabs
+)
+{
+   const dword threadCount = slabs.size();
+
+   InsertRemoveTask<OCTREE> tasks[ THREAD_COUNT_MAX ];
+   OctreeTaskV*             pTasks[ THREAD_COUNT_MAX ];
+   for( dword t = 0;  t < threadCount;  ++t )
+   {
+      tasks[t].set( octree, pMutex, slabs[t] );
+      pTasks[t] = &tasks[t];
+   }
+
+   OctreeTaskPool pool( threadCount );
+   const double begin = wallSeconds();
+   pool.runAll( pTasks, threadCount );
+
+   return wallSeconds() - begin;
+}
+
+
+/**
+ * Inserts all the blocks, removes every second one, then destroys the
+ * octree.
+ * @return times: insert, remove and destroy, in seconds
+ */
+template<class OCTREE>
+static void timeAllocator
+(
+   std::auto_ptr<OCTREE>     pOctree,
+   const std::vector<Block>& items,
+   double                    times[3]
+)
+{
+   const OctreeAgentBlock a;
+
+   clock_t begin = clock();
+   for( udword i = 0;  i < items.size();  ++i )
+   {
+      pOctree->insert( items[i], a );
+   }
+   times[0] = seconds( begin );
+
+   begin = clock();
+   for( udword i = 0;  i < items.size();  i += 2 )
+   {
+      pOctree->remove( items[i], a );
+   }
+   times[1] = seconds( begin );
+
+   begin = clock();
+   pOctree.reset();
+   times[2] = seconds( begin );
+}
+
+
+static void writeTimes
+(
+   const char* pName,
+   const double virtualTime,
+   const double staticTime
+)
+{
+   std::cout << pName << ":  virtual " << virtualTime << " s,  static " <<
+      staticTime << " s,  ratio " <<
+      ((staticTime > 0.0) ? (virtualTime / staticTime) : 0.0) << "\n";
+}
+
+
+static void writeThreadTimes
+(
+   const dword  threadCount,
+   const double lockedTime,
+   const double stripedTime,
+   const double stripedOneTime
+)
+{
+   std::cout << "insert+remove, " << threadCount << " threads:  one lock " <<
+      lockedTime << " s,  striped " << stripedTime << " s,  scaling " <<
+      ((stripedTime > 0.0) ? (stripedOneTime / stripedTime) : 0.0) << "\n";
+}
+
+
+static void writeAllocatorTimes
+(
+   const char* pName,
+   const double heapTime,
+   const double poolTime
+)
+{
+   std::cout << pName << ":  heap " << heapTime << " s,  pool " << poolTime <<
+      " s,  ratio " << ((poolTime > 0.0) ? (heapTime / poolTime) : 0.0) <<
+      "\n";
+}
+
+
+static void writePacketTimes
+(
+   const char* pName,
+   const double singleTime,
+   const double packetTime
+)
+{
+   std::cout << pName << ":  single " << singleTime << " s,  packet " <<
+      packetTime << " s,  ratio " <<
+      ((packetTime > 0.0) ? (singleTime / packetTime) : 0.0) << "\n";
+}
+
+
+/**
+ * Writes a suite row: a CSV line, or a JSON object (the first opening the
+ * array).
+ */
+static void writeRow
+(
+   const bool   isJson,
+   bool&        isFirst,
+   const char*  pWorkload,
+   const char*  pShape,
+   const dword  itemCount,
+   const char*  pOperation,
+   const dword  opCount,
+   const double time
+)
+{
+   const double nsPerOp = (opCount > 0) ? ((time * 1e9) /
+      static_cast<double>(opCount)) : 0.0;
+   const double opsPerS = (time > 0.0) ? (static_cast<double>(opCount) /
+      time) : 0.0;
+
+   if( isJson )
+   {
+      std::cout << (isFirst ? "[\n" : ",\n") << "   { \"workload\": \"" <<
+         pWorkload << "\", \"shape\": \"" << pShape << "\", \"items\": " <<
+         itemCount << ", \"operation\": \"" << pOperation <<
+         "\", \"ops\": " << opCount << ", \"seconds\": " << time <<
+         ", \"ns_per_op\": " << nsPerOp << ", \"ops_per_s\": " << opsPerS <<
+         ", \"peak_rss_kb\": " << peakKilobytes() << " }";
+   }
+   else
+   {
+      std::cout << pWorkload << "," << pShape << "," << itemCount << "," <<
+         pOperation << "," << opCount << "," << time << "," << nsPerOp <<
+         "," << opsPerS << "," << peakKilobytes() << "\n";
+   }
+
+   isFirst = false;
+}
+
+
+template<class TYPE>
+static bool isSameArray
+(
+   const Array<TYPE>& a1,
+   const Array<TYPE>& a2
+)
+{
+   return (a1.getLength() == a2.getLength()) && std::equal( a1.getStorage(),
+      a1.getStorage() + a1.getLength(), a2.getStorage() );
+}
+
+
+/**
+ * Checks an octree with another ROOT gives the same query results as the
+ * reference (an OctreeRoot), for one workload: the same items in each box,
+ * the same nearest distances to each box's lower corner (the items may differ
+ * at ties), and the same ray hit ts.
+ * @return count of calls giving other than the reference
+ */
+template<class ROOT>
+static dword checkRoot
+(
+   const Octree<Block>&         reference,
+   const std::vector<Block>&    items,
+   const std::vector<Block>&    boxes,
+   const std::vector<Vector3r>& rayOrigins,
+   const std::vector<Vector3r>& rayDirections
+)
+{
+   dword mismatches = 0;
+
+   const dword            itemCount = items.size();
+   const OctreeAgentBlock a;
+
+   Octree<Block, OctreeAllocatorPool, ROOT> octree( reference.getPosition(),
+      reference.getSize(), reference.getMaxItemCountPerCell(),
+      reference.getMaxLevelCount(), reference.getMinCellSize() );
+   mismatches += (octree.insertRange( &items[0], itemCount, a ) != itemCount);
+
+   Array<const Block*> found[2];
+   Array<real>         distances[2];
+   for( dword i = 0;  i < SUITE_QUERY_COUNT;  ++i )
+   {
+      reference.queryBox( boxes[i].lower, boxes[i].upper, a, found[0] );
+      octree.queryBox( boxes[i].lower, boxes[i].upper, a, found[1] );
+      for( int j = 2;  j-- > 0; )
+      {
+         std::sort( found[j].getStorage(), found[j].getStorage() +
+            found[j].getLength() );
+      }
+      mismatches += !isSameArray( found[0], found[1] );
+
+      reference.queryNearest( boxes[i].lower, 8, REAL_MAX, a, found[0],
+         distances[0] );
+      octree.queryNearest( boxes[i].lower, 8, REAL_MAX, a, found[1],
+         distances[1] );
+      mismatches += !isSameArray( distances[0], distances[1] );
+
+      real hitTs[2] = { 0.0f, 0.0f };
+      reference.queryRay( rayOrigins[i], rayDirections[i], REAL_MAX, a,
+         hitTs[0] );
+      octree.queryRay( rayOrigins[i], rayDirections[i], REAL_MAX, a,
+         hitTs[1] );
+      mismatches += (hitTs[0] != hitTs[1]);
+   }
+
+   return mismatches;
+}
+
+
+/**
+ * Times each operation of the suite on one workload, writing a row for each.
+ * @return count of calls giving other than expected
+ */
+static dword benchWorkload
+(
+   const bool                isJson,
+   bool&                     isFirst,
+   const char*               pWorkload,
+   const char*               pShape,
+   const std::vector<Block>& items,
+   const udword              seed
+)
+{
+   dword mismatches = 0;
+
+   const dword            itemCount = items.size();
+   const OctreeAgentBlock a;
+
+   // queries: boxes, their lower corners as points, and rays from below the
+   // root toward them (the same for each workload)
+   RandomFast         rand( static_cast<dword>(seed) );
+   std::vector<Block> boxes;
+   makeBlocks( SUITE_QUERY_COUNT, 0.02f, rand, boxes );
+
+   // insert all in bulk
+   std::auto_ptr<Octree<Block> > pOctree( new Octree<Block>( Vector3r::ZERO(),
+      1.0f, 8, 16, SUITE_MIN_CELL_SIZE ) );
+   double begin = wallSeconds();
+   mismatches += (pOctree->insertRange( &items[0], itemCount, a ) !=
+      itemCount);
+   writeRow( isJson, isFirst, pWorkload, pShape, itemCount, "insert_bulk",
+      itemCount, wallSeconds() - begin );
+
+   // range, nearest, and ray queries
+   Array<const Block*> found;
+   Array<real>         distances;
+   begin = wallSeconds();
+   for( dword i = 0;  i < SUITE_QUERY_COUNT;  ++i )
+   {
+      pOctree->queryBox( boxes[i].lower, boxes[i].upper, a, found );
+   }
+   writeRow( isJson, isFirst, pWorkload, pShape, itemCount, "range",
+      SUITE_QUERY_COUNT, wallSeconds() - begin );
+
+   begin = wallSeconds();
+   for( dword i = 0;  i < SUITE_QUERY_COUNT;  ++i )
+   {
+      pOctree->queryNearest( boxes[i].lower, 8, REAL_MAX, a, found,
+         distances );
+   }
+   writeRow( isJson, isFirst, pWorkload, pShape, itemCount, "knn",
+      SUITE_QUERY_COUNT, wallSeconds() - begin );
+
+   std::vector<Vector3r> rayOrigins( SUITE_QUERY_COUNT );
+   std::vector<Vector3r> rayDirections( SUITE_QUERY_COUNT );
+   for( dword i = 0;  i < SUITE_QUERY_COUNT;  ++i )
+   {
+      rayOrigins[i] = Vector3r( rand.next().getFloat(), rand.next().getFloat(),
+         -0.5f );
+      const Vector3r toward( boxes[i].lower - rayOrigins[i] );
+      rayDirections[i] = toward / toward.length();
+   }
+   begin = wallSeconds();
+   for( dword i = 0;  i < SUITE_QUERY_COUNT;  ++i )
+   {
+      real hitT = 0.0f;
+      pOctree->queryRay( rayOrigins[i], rayDirections[i], REAL_MAX, a,
+         hitT );
+   }
+   writeRow( isJson, isFirst, pWorkload, pShape, itemCount, "ray",
+      SUITE_QUERY_COUNT, wallSeconds() - begin );
+
+   // the other roots' query results, against this one's (untimed)
+   if( itemCount <= SUITE_CHECK_ITEM_MAX )
+   {
+      mismatches += checkRoot<OctreeLinear>( *pOctree, items, boxes,
+         rayOrigins, rayDirections );
+      mismatches += checkRoot<OctreeStripedRoot>( *pOctree, items, boxes,
+         rayOrigins, rayDirections );
+      mismatches += checkRoot<OctreeLooseRoot>( *pOctree, items, boxes,
+         rayOrigins, rayDirections );
+   }
+
+   // copy (sharing all cells) and destroy the copy
+   begin = wallSeconds();
+   for( dword i = 0;  i < SUITE_QUERY_COUNT;  ++i )
+   {
+      const Octree<Block> copy( *pOctree );
+   }
+   writeRow( isJson, isFirst, pWorkload, pShape, itemCount, "copy",
+      SUITE_QUERY_COUNT, wallSeconds() - begin );
+
+   // destroy all
+   begin = wallSeconds();
+   pOctree.reset();
+   writeRow( isJson, isFirst, pWorkload, pShape, itemCount, "destroy",
+      itemCount, wallSeconds() - begin );
+
+   // insert then remove each in turn
+   Octree<Block> octree( Vector3r::ZERO(), 1.0f, 8, 16, SUITE_MIN_CELL_SIZE );
+   begin = wallSeconds();
+   for( dword i = 0;  i < itemCount;  ++i )
+   {
+      mismatches += !octree.insert( items[i], a );
+   }
+   writeRow( isJson, isFirst, pWorkload, pShape, itemCount, "insert",
+      itemCount, wallSeconds() - begin );
+
+   begin = wallSeconds();
+   for( dword i = 0;  i < itemCount;  ++i )
+   {
+      mismatches += !octree.remove( items[i], a );
+   }
+   writeRow( isJson, isFirst, pWorkload, pShape, itemCount, "remove",
+      itemCount, wallSeconds() - begin );
+   mismatches += !octree.isEmpty();
+
+   return mismatches;
+}
+
+
+/**
+ * Runs the suite: each workload at each item count.
+ * @parameters
+ * * arguments are: [seed [itemCount ...]]
+ */
+static bool benchSuite
+(
+   const bool         isJson,
+   const int          argumentCount,
+   const char* const* pArguments
+)
+{
+   // read options
+   const udword seed = (argumentCount > 0) ? atoi( pArguments[0] ) : 1;
+   std::vector<dword> itemCounts;
+   for( int i = 1;  i < argumentCount;  ++i )
+   {
+      itemCounts.push_back( atoi( pArguments[i] ) );
+   }
+   if( itemCounts.empty() )
+   {
+      for( dword n = 1000;  n <= 1000000;  n *= 10 )
+      {
+         itemCounts.push_back( n );
+      }
+   }
+
+   if( !isJson )
+   {
+      std::cout << "workload,shape,items,operation,ops,seconds,ns_per_op,"
+         "ops_per_s,peak_rss_kb\n";
+   }
+
+   // each distribution, of points then blocks, at each item count
+   dword mismatches = 0;
+   bool  isFirst    = true;
+   for( dword d = 0;  d < DISTRIBUTION_COUNT;  ++d )
+   {
+      for( dword p = 2;  p-- > 0; )
+      {
+         for( udword i = 0;  i < itemCounts.size();  ++i )
+         {
+            // (from the seed alone, so a smaller is the start of a larger)
+            RandomFast         rand( static_cast<dword>(seed + (d * 2) + p) );
+            std::vector<Block> items;
+            makeWorkload( d, (0 != p), itemCounts[i], rand, items );
+
+            mismatches += benchWorkload( isJson, isFirst,
+               DISTRIBUTION_NAMES[d], p ? "point" : "block", items, seed );
+         }
+      }
+   }
+
+   if( isJson )
+   {
+      std::cout << (isFirst ? "[\n]\n" : "\n]\n");
+   }
+
+   return 0 == mismatches;
+}
+
+
+
+
+/**
+ * Runs the comparisons, writing a report.
+ * @parameters
+ * * arguments are: [itemCount [queryCount [seed]]]
+ */
+static bool benchComparisons
+(
+   const int          argc,
+   const char* const* argv
+)
+{
+   // write banner
+   std::cout << "\n  HXA Octree Component v2.1 C++  *benchmark*\n" <<
+      "  Copyright (c) 2004-2007, Harrison Ainsworth / HXA7241.\n"
+      "  http://www.hxa7241.org/\n\n";
+
+   // read options
+   const dword itemCount  = (argc > 1) ? atoi( argv[1] ) : 200000;
+   const dword queryCount = (argc > 2) ? atoi( argv[2] ) : 2000;
+   RandomFast  rand( (argc > 3) ? atoi( argv[3] ) : 1 );
+
+   // make items and query boxes
+   std::vector<Block> items;
+   makeBlocks( itemCount, 0.002f, rand, items );
+   std::vector<Block> boxes;
+   makeBlocks( queryCount, 0.1f, rand, boxes );
+
+   std::cout << "items " << itemCount << ",  queries " << queryCount <<
+      "\n\n";
+
+   typedef OctreeStatic<Block, OctreeAgentStaticBlock> OctreeStaticBlock;
+
+   Octree<Block>     o1( Vector3r::ZERO(), 1.0f, 8, 16, 0.0f );
+   OctreeStaticBlock o2( Vector3r::ZERO(), 1.0f, 8, 16, 0.0f );
+   OctreeAgentBlock       a1;
+   OctreeAgentStaticBlock a2;
+
+   // insert
+   clock_t begin = clock();
+   for( dword i = 0;  i < itemCount;  ++i )
+   {
+      o1.insert( items[i], a1 );
+   }
+   const double insert1 = seconds( begin );
+
+   begin = clock();
+   for( dword i = 0;  i < itemCount;  ++i )
+   {
+      o2.insert( items[i], a2 );
+   }
+   const double insert2 = seconds( begin );
+
+   // query
+   dword count1 = 0;
+   begin = clock();
+   for( dword i = 0;  i < queryCount;  ++i )
+   {
+      OctreeVisitorBox v( boxes[i] );
+      o1.visit( v );
+      count1 += v.getCount();
+   }
+   const double query1 = seconds( begin );
+
+   dword count2 = 0;
+   begin = clock();
+   for( dword i = 0;  i < queryCount;  ++i )
+   {
+      OctreeQueryBox q( boxes[i] );
+      o2.query( q );
+      count2 += q.getCount();
+   }
+   const double query2 = seconds( begin );
+
+   // nearest, to the query boxes' lower corners
+   const dword nearestK = 8;
+   Array<const Block*> found;
+   Array<real>         distances1;
+   Array<real>         distances2;
+   std::vector<real>   scanned( itemCount );
+   dword mismatches = 0;
+
+   double nearest1 = 0.0;
+   double nearest2 = 0.0;
+   double nearestScan = 0.0;
+   for( dword i = 0;  i < queryCount;  ++i )
+   {
+      const Vector3r& point = boxes[i].lower;
+
+      begin = clock();
+      o1.queryNearest( point, nearestK, REAL_MAX, a1, found, distances1 );
+      nearest1 += seconds( begin );
+
+      begin = clock();
+      o2.queryNearest( point, nearestK, REAL_MAX, a2, found, distances2 );
+      nearest2 += seconds( begin );
+
+      // brute force: every item's distance, then the k smallest
+      begin = clock();
+      for( dword j = 0;  j < itemCount;  ++j )
+      {
+         scanned[j] = a2.getDistance( items[j], point );
+      }
+      const dword k = (nearestK < itemCount) ? nearestK : itemCount;
+      std::partial_sort( scanned.begin(), scanned.begin() + k, scanned.end() );
+      nearestScan += seconds( begin );
+
+      mismatches += !((distances1.getLength() == k) &&
+         (distances2.getLength() == k) &&
+         std::equal( scanned.begin(), scanned.begin() + k,
+         distances1.getStorage() ) &&
+         std::equal( scanned.begin(), scanned.begin() + k,
+         distances2.getStorage() ));
+   }
+
+   // ray packets: from below the root, each toward a small patch in it
+   const dword packetLength = 16;
+   std::vector<Vector3r>     rayOrigins( packetLength );
+   std::vector<Vector3r>     rayDirections( packetLength );
+   std::vector<const Block*> hitItems( packetLength );
+   std::vector<real>         hitTs( packetLength );
+
+   double raySingle = 0.0;
+   double rayPacket = 0.0;
+   for( dword i = 0;  i < queryCount;  ++i )
+   {
+      const Vector3r origin( rand.next().getFloat(), rand.next().getFloat(),
+         -0.5f );
+      const Vector3r patch( boxes[i].lower[0], boxes[i].lower[1], 0.5f );
+      for( dword j = 0;  j < packetLength;  ++j )
+      {
+         const Vector3r toward( patch + Vector3r( (j & 3) * 0.005f,
+            (j >> 2) * 0.005f, 0.0f ) - origin );
+         rayOrigins[j]    = origin;
+         rayDirections[j] = toward / toward.length();
+      }
+
+      begin = clock();
+      o2.queryRays( packetLength, &rayOrigins[0], &rayDirections[0], REAL_MAX,
+         a2, &hitItems[0], &hitTs[0] );
+      rayPacket += seconds( begin );
+
+      begin = clock();
+      for( dword j = 0;  j < packetLength;  ++j )
+      {
+         real hitT = 0.0f;
+         const Block* pHit = o2.queryRay( rayOrigins[j], rayDirections[j],
+            REAL_MAX, a2, hitT );
+         mismatches += !((pHit == hitItems[j]) && (hitT == hitTs[j]));
+      }
+      raySingle += seconds( begin );
+   }
+
+   // box packets: small boxes, each at a small patch
+   std::vector<Vector3r>            boxLowers( packetLength );
+   std::vector<Vector3r>            boxUppers( packetLength );
+   std::vector<Array<const Block*> > boxItems( packetLength );
+
+   double boxSingle = 0.0;
+   double boxPacket = 0.0;
+   for( dword i = 0;  i < queryCount;  ++i )
+   {
+      for( dword j = 0;  j < packetLength;  ++j )
+      {
+         const Vector3r offset( (j & 3) * 0.01f, (j >> 2) * 0.01f, 0.0f );
+         boxLowers[j] = boxes[i].lower + offset;
+         boxUppers[j] = boxes[i].lower + offset + (Vector3r::ONE() * 0.02f);
+      }
+
+      begin = clock();
+      o2.queryBoxes( packetLength, &boxLowers[0], &boxUppers[0], a2,
+         &boxItems[0] );
+      boxPacket += seconds( begin );
+
+      begin = clock();
+      for( dword j = 0;  j < packetLength;  ++j )
+      {
+         o2.queryBox( boxLowers[j], boxUppers[j], a2, found );
+         mismatches += !((found.getLength() == boxItems[j].getLength()) &&
+            std::equal( found.getStorage(), found.getStorage() +
+            found.getLength(), boxItems[j].getStorage() ));
+      }
+      boxSingle += seconds( begin );
+   }
+
+   // insert and remove on threads at once, each its own slab of space (by
+   // lower x): into one octree behind one lock, and into a striped one
+   typedef Octree<Block, OctreeAllocatorPool, OctreeStripedRoot>
+      OctreeStripedBlock;
+
+   double lockedTimes[ THREAD_COUNT_MAX ];
+   double stripedTimes[ THREAD_COUNT_MAX ];
+   dword  threadRunCount = 0;
+   for( dword r = 0;  (1 << r) <= THREAD_COUNT_MAX;  ++r )
+   {
+      const dword threadCount = 1 << r;
+      std::vector<std::vector<const Block*> > slabs( threadCount );
+      for( dword i = 0;  i < itemCount;  ++i )
+      {
+         const dword slab = static_cast<dword>(items[i].lower[0] *
+            static_cast<real>(threadCount));
+         slabs[ (slab < threadCount) ? slab : (threadCount - 1) ].push_back(
+            &items[i] );
+      }
+
+      Octree<Block> o3( Vector3r::ZERO(), 1.0f, 8, 16, 0.0f );
+      OctreeMutex   mutex;
+      lockedTimes[r] = timeInsertRemove( o3, &mutex, slabs );
+
+      OctreeStripedBlock o4( Vector3r::ZERO(), 1.0f, 8, 16, 0.0f );
+      stripedTimes[r] = timeInsertRemove( o4, 0, slabs );
+
+      mismatches += !(o3.isEmpty() && o4.isEmpty());
+      ++threadRunCount;
+   }
+
+   // insert all, remove every second, then destroy (with many cells freed),
+   // with cells from the heap, and from a pool
+   double heapTimes[3];
+   double poolTimes[3];
+   timeAllocator( std::auto_ptr<Octree<Block, OctreeAllocatorHeap> >( new
+      Octree<Block, OctreeAllocatorHeap>( Vector3r::ZERO(), 1.0f, 8, 16,
+      0.0f ) ), items, heapTimes );
+   timeAllocator( std::auto_ptr<Octree<Block> >( new Octree<Block>(
+      Vector3r::ZERO(), 1.0f, 8, 16, 0.0f ) ), items, poolTimes );
+
+   // remove
+   begin = clock();
+   for( dword i = 0;  i < itemCount;  ++i )
+   {
+      o1.remove( items[i], a1 );
+   }
+   const double remove1 = seconds( begin );
+
+   begin = clock();
+   for( dword i = 0;  i < itemCount;  ++i )
+   {
+      o2.remove( items[i], a2 );
+   }
+   const double remove2 = seconds( begin );
+
+   // write results
+   writeTimes( "insert", insert1, insert2 );
+   writeTimes( "query ", query1,  query2 );
+   writeTimes( "remove", remove1, remove2 );
+   writeTimes( "nearest", nearest1, nearest2 );
+   std::cout << "nearest, brute-force scan:  " << nearestScan <<
+      " s,  ratio " << ((nearest1 > 0.0) ? (nearestScan / nearest1) : 0.0) <<
+      "\n";
+   writePacketTimes( "ray packets", raySingle, rayPacket );
+   writePacketTimes( "box packets", boxSingle, boxPacket );
+   for( dword r = 0;  r < threadRunCount;  ++r )
+   {
+      writeThreadTimes( 1 << r, lockedTimes[r], stripedTimes[r],
+         stripedTimes[0] );
+   }
+   writeAllocatorTimes( "insert, cells", heapTimes[0], poolTimes[0] );
+   writeAllocatorTimes( "remove half, cells", heapTimes[1], poolTimes[1] );
+   writeAllocatorTimes( "destroy, cells", heapTimes[2], poolTimes[2] );
+   std::cout << "\n(item refs found: " << count1 << " " << count2 <<
+      ",  nearest, packet and thread mismatches: " << mismatches << ")\n";
+
+   return (count1 == count2) && (0 == mismatches) && o1.isEmpty() &&
+      o2.isEmpty();
+}
+
+
+
+
+/**
+ * Reports if an argument is a whole number (of up to 9 digits, so atoi reads
+ * it whole).
+ */
+static bool isNumber
+(
+   const char* pArgument
+)
+{
+   dword length = 0;
+   while( (pArgument[length] >= '0') && (pArgument[length] <= '9') )
+   {
+      ++length;
+   }
+
+   return (length > 0) && (length <= 9) && ('\0' == pArgument[length]);
+}
+
+
+
+
+int main
+(
+   int   argc,
+   char* argv[]
+)
+{
+   bool isOk = false;
+
+   // suite (machine-readable), or comparisons (a report)
+   const bool isCsv   = (argc > 1) && (0 == strcmp( argv[1], "-csv" ));
+   const bool isJson  = (argc > 1) && (0 == strcmp( argv[1], "-json" ));
+   const bool isSuite = isCsv | isJson;
+
+   // check the rest are numbers, and the counts above zero, else give usage
+   const int first   = isSuite ? 2 : 1;
+   bool      isValid = isSuite || (argc <= 4);
+   for( int i = first;  i < argc;  ++i )
+   {
+      const bool isCount = isSuite ? (i > first) : (i < 3);
+      isValid &= isNumber( argv[i] ) && (!isCount || (atoi( argv[i] ) > 0));
+   }
+   if( !isValid )
+   {
+      std::cerr << "usage: octreebench [itemCount [queryCount [seed]]]\n"
+         "       octreebench -csv|-json [seed [itemCount ...]]\n";
+   }
+   else if( isSuite )
+   {
+      isOk = benchSuite( isJson, argc - 2, argv + 2 );
+   }
+   else
+   {
+      isOk = benchComparisons( argc, argv );
+   }
+
+   return isOk ? EXIT_SUCCESS : EXIT_FAILURE;
+}
@@ -36,6 +36,7 @@ OF SUCH DAMAGE.
 ------------------------------------------------------------------------------*/
 
 
+#include <stdlib.h>
 #include <vector>
 #include <iostream>
 
@@ -0,0 +1,506 @@
+/*------------------------------------------------------------------------------
+
+   Octree Component, version 2.1
+   Copyright (c) 2004-2007,  Harrison Ainsworth / HXA7241.
+
+   http://www.hxa7241.org/
+
+------------------------------------------------------------------------------*/
+
+/*------------------------------------------------------------------------------
+
+Copyright (c) 2004-2007, Harrison Ainsworth / HXA7241.
+
+Redistribution and use in source and binary forms, with or without modification,
+are permitted provided that the following conditions are met:
+
+* Redistributions of source code must retain the above copyright notice, this
+  list of conditions and the following disclaimer.
+* Redistributions in binary form must reproduce the above copyright notice, this
+  list of conditions and the following disclaimer in the documentation and/or
+  other materials provided with the distribution.
+* The name of the author may not be used to endorse or promote products derived
+  from this software without specific prior written permission.
+
+THIS SOFTWARE IS PROVIDED BY THE AUTHOR "AS IS" AND ANY EXPRESS OR IMPLIED
+WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT
+SHALL THE AUTHOR BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT
+OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING
+IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY
+OF SUCH DAMAGE.
+
+------------------------------------------------------------------------------*/
+
+
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <time.h>
+#include <vector>
+#include <string>
+#include <fstream>
+#include <sstream>
+#include <iostream>
+
+#include "OctreeAgents.hpp"
+
+
+using namespace hxa7241_graphics;
+
+
+
+
+/**
+ * Mesh ingest sample, and benchmark of building.<br/><br/>
+ *
+ * Reads a triangle mesh from an OBJ file (only its vertexs and faces, faces
+ * split into triangles), or makes a torus, and indexes its triangles in an
+ * OctreeStatic, three ways:
+ * <ul>
+ * <li>plain: an agent with a hand-written separating-axis test of one cell,
+ *     called for each subcell in turn</li>
+ * <li>stock: OctreeAgentStaticTriangle, testing all 8 subcells at once</li>
+ * <li>stock virtual: OctreeAgentTriangle, with an Octree</li>
+ * </ul>
+ * Times each build, then casts rays at the mesh through each and checks they
+ * hit the same.<br/><br/>
+ *
+ * Usage: octreemesh [meshFile.obj | -torusRings [maxItemCountPerCell
+ * [maxLevelCount [rayCount]]]]
+ */
+
+
+
+
+/// MeshTriangle ///////////////////////////////////////////////////////////////
+
+/**
+ * A triangle of a mesh: indexes into the mesh's vertexs.
+ */
+class MeshTriangle
+{
+/// standard object services ---------------------------------------------------
+public:
+   MeshTriangle()
+    : pVertexs_m( 0 )
+   {
+      indexs_m[0] = indexs_m[1] = indexs_m[2] = 0;
+   }
+
+   MeshTriangle( const Vector3r* pVertexs,
+                 const dword     index0,
+                 const dword     index1,
+                 const dword     index2 )
+    : pVertexs_m( pVertexs )
+   {
+      indexs_m[0] = index0;
+      indexs_m[1] = index1;
+      indexs_m[2] = index2;
+   }
+
+
+/// queries --------------------------------------------------------------------
+   const Vector3r& getVertex( const dword index )                         const
+   {
+      return pVertexs_m[ indexs_m[index] ];
+   }
+
+
+/// fields ---------------------------------------------------------------------
+private:
+   const Vector3r* pVertexs_m;
+   dword           indexs_m[3];
+};
+
+
+
+
+/// OctreeAgentStaticTrianglePlain /////////////////////////////////////////////
+
+/**
+ * Agent for OctreeStatic: a plain separating-axis test of one cell (as
+ * Akenine-Moller), and subcells tested one at a time.
+ */
+class OctreeAgentStaticTrianglePlain
+{
+/// queries --------------------------------------------------------------------
+public:
+   bool  isOverlappingCell ( const MeshTriangle& item,
+                             const Vector3r&     lowerCorner,
+                             const Vector3r&     upperCorner )            const
+   {
+      // the triangle, relative to the cell's center
+      real vertexs[3][3];
+      real halfs[3];
+      for( int k = 3;  k-- > 0; )
+      {
+         const real center = (lowerCorner[k] + upperCorner[k]) * 0.5f;
+         halfs[k] = (upperCorner[k] - lowerCorner[k]) * 0.5f;
+         for( dword v = 3;  v-- > 0; )
+         {
+            vertexs[v][k] = item.getVertex( v )[k] - center;
+         }
+      }
+      real edges[3][3];
+      for( int k = 3;  k-- > 0; )
+      {
+         edges[0][k] = vertexs[1][k] - vertexs[0][k];
+         edges[1][k] = vertexs[2][k] - vertexs[1][k];
+         edges[2][k] = vertexs[0][k] - vertexs[2][k];
+      }
+
+      // the axes: cell face normals, triangle normal, and edge crosses
+      real axes[13][3];
+      for( int k = 3;  k-- > 0; )
+      {
+         axes[k][k]           = 1.0f;
+         axes[k][(k + 1) % 3] = 0.0f;
+         axes[k][(k + 2) % 3] = 0.0f;
+         axes[3][k] = (edges[0][(k + 1) % 3] * edges[1][(k + 2) % 3]) -
+                      (edges[0][(k + 2) % 3] * edges[1][(k + 1) % 3]);
+      }
+      for( int e = 3;  e-- > 0; )
+      {
+         for( int k = 3;  k-- > 0; )
+         {
+            real* axis = axes[4 + (e * 3) + k];
+            axis[k]           = 0.0f;
+            axis[(k + 1) % 3] = -edges[e][(k + 2) % 3];
+            axis[(k + 2) % 3] =  edges[e][(k + 1) % 3];
+         }
+      }
+
+      // separated if the triangle's projection is clear of the cell's, on any
+      bool isSeparated = false;
+      for( int a = 0;  (a < 13) & !isSeparated;  ++a )
+      {
+         const real* axis = axes[a];
+         const real  r = (fabs( axis[0] ) * halfs[0]) +
+            (fabs( axis[1] ) * halfs[1]) + (fabs( axis[2] ) * halfs[2]);
+         real pMin = REAL_MAX;
+         real pMax = -REAL_MAX;
+         for( dword v = 3;  v-- > 0; )
+         {
+            const real p = (axis[0] * vertexs[v][0]) +
+               (axis[1] * vertexs[v][1]) + (axis[2] * vertexs[v][2]);
+            pMin = (p < pMin) ? p : pMin;
+            pMax = (p > pMax) ? p : pMax;
+         }
+         isSeparated = (pMin > r) | (pMax < -r);
+      }
+
+      return !isSeparated;
+   }
+
+   bool  isCoveringCell    ( const MeshTriangle& ,//item,
+                             const Vector3r&     ,//lowerCorner,
+                             const Vector3r&     //upperCorner
+                           )                                              const
+   {
+      // a triangle is flat, so never covers a cell
+      return false;
+   }
+
+   dword getSubcellOverlaps( const MeshTriangle& item,
+                             const Vector3r&     lower,
+                             const Vector3r&     middle,
+                             const Vector3r&     upper )                  const
+   {
+      const Vector3r* lowMidPoints[]  = { &lower,  &middle };
+      const Vector3r* midHighPoints[] = { &middle, &upper };
+
+      // step through each subcell
+      dword flags = 0;
+      for( dword i = 8;  i-- > 0; )
+      {
+         const Vector3r cellLower( lowMidPoints[ i       & 1]->getX(),
+                                   lowMidPoints[(i >> 1) & 1]->getY(),
+                                   lowMidPoints[(i >> 2) & 1]->getZ() );
+         const Vector3r cellUpper( midHighPoints[ i       & 1]->getX(),
+                                   midHighPoints[(i >> 1) & 1]->getY(),
+                                   midHighPoints[(i >> 2) & 1]->getZ() );
+         flags |= static_cast<dword>(isOverlappingCell( item, cellLower,
+            cellUpper )) << i;
+      }
+
+      return flags;
+   }
+
+   real  getRayIntersection( const MeshTriangle& item,
+                             const Vector3r&     rayOrigin,
+                             const Vector3r&     rayDirection )           const
+   {
+      return OctreeShape::getRayIntersectionTriangle( item.getVertex( 0 ),
+         item.getVertex( 1 ), item.getVertex( 2 ), rayOrigin, rayDirection );
+   }
+};
+
+
+
+
+
+
+
+
+/// functions //////////////////////////////////////////////////////////////////
+
+static bool readObj
+(
+   const char*            pFileName,
+   std::vector<Vector3r>& vertexs,
+   std::vector<dword>&    indexs
+)
+{
+   std::ifstream file( pFileName );
+
+   std::string line;
+   while( file && std::getline( file, line ) )
+   {
+      std::istringstream in( line );
+      std::string        tag;
+      in >> tag;
+
+      if( "v" == tag )
+      {
+         real x = 0.0f, y = 0.0f, z = 0.0f;
+         in >> x >> y >> z;
+         vertexs.push_back( Vector3r( x, y, z ) );
+      }
+      else if( "f" == tag )
+      {
+         // vertex indexs (before any '/'), 1-based or negative-relative, and
+         // the polygon split into a fan of triangles
+         std::vector<dword> face;
+         std::string        token;
+         while( in >> token )
+         {
+            const dword index = atoi( token.c_str() );
+            face.push_back( (index < 0) ?
+               static_cast<dword>(vertexs.size()) + index : index - 1 );
+         }
+         for( udword i = 2;  i < face.size();  ++i )
+         {
+            indexs.push_back( face[0] );
+            indexs.push_back( face[i - 1] );
+            indexs.push_back( face[i] );
+         }
+      }
+   }
+
+   // drop any triangle with an index out of range
+   udword valid = 0;
+   for( udword i = 0;  i < indexs.size();  i += 3 )
+   {
+      bool isValid = true;
+      for( udword j = 3;  j-- > 0; )
+      {
+         isValid &= (indexs[i + j] >= 0) &
+            (indexs[i + j] < static_cast<dword>(vertexs.size()));
+      }
+      if( isValid )
+      {
+         for( udword j = 3;  j-- > 0; )
+         {
+            indexs[valid + j] = indexs[i + j];
+         }
+         valid += 3;
+      }
+   }
+   indexs.resize( valid );
+
+   return !vertexs.empty();
+}
+
+
+static void makeTorus
+(
+   const dword            rings,
+   std::vector<Vector3r>& vertexs,
+   std::vector<dword>&    indexs
+)
+{
+   // rings around the main circle, and half as many sides around the tube
+   const dword sides = (rings / 2) + 1;
+   const real  pi2   = 6.2831853f;
+   for( dword i = 0;  i < rings;  ++i )
+   {
+      const real a = (static_cast<real>(i) / static_cast<real>(rings)) * pi2;
+      for( dword j = 0;  j < sides;  ++j )
+      {
+         const real b = (static_cast<real>(j) / static_cast<real>(sides)) *
+            pi2;
+         const real r = 0.35f + (0.12f * cos( b ));
+         vertexs.push_back( Vector3r( r * cos( a ), r * sin( a ),
+            0.12f * sin( b ) ) );
+      }
+   }
+
+   // two triangles for each quad
+   for( dword i = 0;  i < rings;  ++i )
+   {
+      for( dword j = 0;  j < sides;  ++j )
+      {
+         const dword i1 = (i + 1) % rings;
+         const dword j1 = (j + 1) % sides;
+         const dword quad[4] = { (i * sides) + j, (i1 * sides) + j,
+            (i1 * sides) + j1, (i * sides) + j1 };
+         const dword corners[6] = { 0, 1, 2, 0, 2, 3 };
+         for( dword k = 0;  k < 6;  ++k )
+         {
+            indexs.push_back( quad[ corners[k] ] );
+         }
+      }
+   }
+}
+
+
+static double seconds( const clock_t begin )
+{
+   return static_cast<double>(clock() - begin) /
+      static_cast<double>(CLOCKS_PER_SEC);
+}
+
+
+
+
+int main
+(
+   int   argc,
+   char* argv[]
+)
+{
+   // write banner
+   std::cout << "\n  HXA Octree Component v2.1 C++  *mesh*\n" <<
+      "  Copyright (c) 2004-2007, Harrison Ainsworth / HXA7241.\n"
+      "  http://www.hxa7241.org/\n\n";
+
+   // read options
+   const char* pMesh    = (argc > 1) ? argv[1] : "-1000";
+   const dword maxItems = (argc > 2) ? atoi( argv[2] ) : 8;
+   const dword maxLevel = (argc > 3) ? atoi( argv[3] ) : 16;
+   const dword rayCount = (argc > 4) ? atoi( argv[4] ) : 100000;
+
+   // read or make the mesh
+   std::vector<Vector3r> vertexs;
+   std::vector<dword>    indexs;
+   if( '-' == pMesh[0] )
+   {
+      const dword rings = atoi( pMesh + 1 );
+      makeTorus( (rings >= 3) ? rings : 3, vertexs, indexs );
+   }
+   else if( !readObj( pMesh, vertexs, indexs ) )
+   {
+      std::cout << "could not read mesh file: " << pMesh << "\n";
+      return EXIT_FAILURE;
+   }
+
+   std::vector<MeshTriangle> triangles( indexs.size() / 3 );
+   for( udword i = 0;  i < triangles.size();  ++i )
+   {
+      triangles[i] = MeshTriangle( &vertexs[0], indexs[(i * 3) + 0],
+         indexs[(i * 3) + 1], indexs[(i * 3) + 2] );
+   }
+   const dword triangleCount = static_cast<dword>(triangles.size());
+
+   // a root cube just enclosing the mesh
+   real bound[2][3] = { { REAL_MAX, REAL_MAX, REAL_MAX },
+      { -REAL_MAX, -REAL_MAX, -REAL_MAX } };
+   for( udword i = 0;  i < vertexs.size();  ++i )
+   {
+      for( int k = 3;  k-- > 0; )
+      {
+         bound[0][k] = (vertexs[i][k] < bound[0][k]) ? vertexs[i][k] :
+            bound[0][k];
+         bound[1][k] = (vertexs[i][k] > bound[1][k]) ? vertexs[i][k] :
+            bound[1][k];
+      }
+   }
+   real size = 0.0f;
+   for( int k = 3;  k-- > 0; )
+   {
+      size = ((bound[1][k] - bound[0][k]) > size) ?
+         (bound[1][k] - bound[0][k]) : size;
+   }
+   size = (size > 0.0f) ? size * 1.01f : 1.0f;
+   const Vector3r center( (Vector3r( bound[0][0], bound[0][1], bound[0][2] ) +
+      Vector3r( bound[1][0], bound[1][1], bound[1][2] )) * 0.5f );
+   const Vector3r position( center - (Vector3r::ONE() * (size * 0.5f)) );
+
+   std::cout << "vertexs " << vertexs.size() << ",  triangles " <<
+      triangleCount << "\n\n";
+
+   typedef OctreeStatic<MeshTriangle, OctreeAgentStaticTrianglePlain>
+      OctreeStaticPlain;
+   typedef OctreeStatic<MeshTriangle, OctreeAgentStaticTriangle<MeshTriangle> >
+      OctreeStaticStock;
+
+   OctreeStaticPlain   o1( position, size, maxItems, maxLevel, 0.0f );
+   OctreeStaticStock   o2( position, size, maxItems, maxLevel, 0.0f );
+   Octree<MeshTriangle> o3( position, size, maxItems, maxLevel, 0.0f );
+   const OctreeAgentStaticTrianglePlain         a1;
+   const OctreeAgentStaticTriangle<MeshTriangle> a2;
+   const OctreeAgentTriangle<MeshTriangle>       a3;
+
+   // build each
+   clock_t begin = clock();
+   const dword count1 = o1.insertRange( &triangles[0], triangleCount, a1 );
+   const double build1 = seconds( begin );
+
+   begin = clock();
+   const dword count2 = o2.insertRange( &triangles[0], triangleCount, a2 );
+   const double build2 = seconds( begin );
+
+   begin = clock();
+   const dword count3 = o3.insertRange( &triangles[0], triangleCount, a3 );
+   const double build3 = seconds( begin );
+
+   // cast rays, from around a sphere outside the root, toward its middle
+   dword hits       = 0;
+   dword mismatches = 0;
+   udword state = 1;
+   for( dword i = 0;  i < rayCount;  ++i )
+   {
+      real r[3];
+      for( int k = 3;  k-- > 0; )
+      {
+         state = (1664525u * state) + 1013904223u;
+         r[k] = static_cast<real>(state >> 8) * (1.0f / 16777216.0f);
+      }
+      const Vector3r toward( position + (Vector3r( r[0], r[1], r[2] ) *
+         size) );
+      const Vector3r from( center + (Vector3r( r[1] - 0.5f, r[2] - 0.5f,
+         r[0] - 0.5f ) * (size * 4.0f)) );
+      const Vector3r direction( (toward - from) / (toward - from).length() );
+
+      real hitT1 = 0.0f;
+      real hitT2 = 0.0f;
+      real hitT3 = 0.0f;
+      const MeshTriangle* pHit1 = o1.queryRay( from, direction, REAL_MAX, a1,
+         hitT1 );
+      const MeshTriangle* pHit2 = o2.queryRay( from, direction, REAL_MAX, a2,
+         hitT2 );
+      const MeshTriangle* pHit3 = o3.queryRay( from, direction, REAL_MAX, a3,
+         hitT3 );
+
+      hits       += (0 != pHit2);
+      mismatches += !((hitT1 == hitT2) & (hitT2 == hitT3) & (pHit1 == pHit2) &
+         (pHit2 == pHit3));
+   }
+
+   // write results
+   std::cout << "build, plain:  " << build1 << " s\n";
+   std::cout << "build, stock:  " << build2 << " s,  ratio " <<
+      ((build2 > 0.0) ? (build1 / build2) : 0.0) << "\n";
+   std::cout << "build, stock virtual:  " << build3 << " s,  ratio " <<
+      ((build3 > 0.0) ? (build1 / build3) : 0.0) << "\n";
+   std::cout << "\n(triangles inserted: " << count1 << " " << count2 << " " <<
+      count3 << ",  rays " << rayCount << ",  hits " << hits <<
+      ",  mismatches " << mismatches << ")\n";
+
+   return (count1 == count2) && (count2 == count3) && (0 == mismatches) ?
+      EXIT_SUCCESS : EXIT_FAILURE;
+}
@@ -40,14 +40,17 @@ OF SUCH DAMAGE.
 #include <set>
 #include <utility>
 #include <algorithm>
+#include <iterator>
 #include <memory>
 #include <iostream>
 #include <sstream>
 #include <time.h>
 
 #include "Octree.hpp"
+#include "OctreeAgents.hpp"
 
 #include "OctreeStreamOut.hpp"
+#include "RandomFast.hpp"
 #include "OctreeTest.hpp"
 
 
@@ -210,6 +213,17 @@ protected:
    virtual bool  isOverlappingCell ( const OctreeItemTest& item,
                                      const Vector3r& lowerCorner,
                                      const Vector3r& upperCorner )        const;
+   virtual bool  isCoveringCell    ( const OctreeItemTest& item,
+                                     const Vector3r& lowerCorner,
+                                     const Vector3r& upperCorner )        const;
+   virtual real  getDistance       ( const OctreeItemTest& item,
+                                     const Vector3r&       point )        const;
+   virtual real  getRayIntersection( const OctreeItemTest& item,
+                                     const Vector3r&       rayOrigin,
+                                     const Vector3r&       rayDirection ) const;
+   virtual void  getBound          ( const OctreeItemTest& item,
+                                     Vector3r&             lowerCorner,
+                                     Vector3r&             upperCorner )  const;
 
 
 /// implementation -------------------------------------------------------------
@@ -218,6 +232,13 @@ public:
                                const Vector3r& itemUpper,
                                const Vector3r& cellLower,
                                const Vector3r& cellUpper );
+   static  real getDistance  ( const Vector3r& itemLower,
+                               const Vector3r& itemUpper,
+                               const Vector3r& point );
+   static  real getRayIntersection( const Vector3r& itemLower,
+                                    const Vector3r& itemUpper,
+                                    const Vector3r& rayOrigin,
+                                    const Vector3r& rayDirection );
 };
 
 
@@ -225,6 +246,18 @@ public:
 
 /// queries --------------------------------------------------------------------
 /// octree agent overrides
+bool OctreeAgentTest::isCoveringCell
+(
+   const OctreeItemTest& item,
+   const Vector3r&       lowerCorner,
+   const Vector3r&       upperCorner
+) const
+{
+   return OctreeShape::isCoveringBox( item.getPosition(),
+      item.getPosition() + item.getDimensions(), lowerCorner, upperCorner );
+}
+
+
 bool OctreeAgentTest::isOverlappingCell
 (
    const OctreeItemTest& item,
@@ -237,6 +270,41 @@ bool OctreeAgentTest::isOverlappingCell
 }
 
 
+real OctreeAgentTest::getDistance
+(
+   const OctreeItemTest& item,
+   const Vector3r&       point
+) const
+{
+   return getDistance( item.getPosition(),
+      item.getPosition() + item.getDimensions(), point );
+}
+
+
+real OctreeAgentTest::getRayIntersection
+(
+   const OctreeItemTest& item,
+   const Vector3r&       rayOrigin,
+   const Vector3r&       rayDirection
+) const
+{
+   return getRayIntersection( item.getPosition(),
+      item.getPosition() + item.getDimensions(), rayOrigin, rayDirection );
+}
+
+
+void OctreeAgentTest::getBound
+(
+   const OctreeItemTest& item,
+   Vector3r&             lowerCorner,
+   Vector3r&             upperCorner
+) const
+{
+   lowerCorner = item.getPosition();
+   upperCorner = item.getPosition() + item.getDimensions();
+}
+
+
 bool OctreeAgentTest::isOverlapping
 (
    const Vector3r& itemLower,
@@ -257,6 +325,174 @@ bool OctreeAgentTest::isOverlapping
 }
 
 
+real OctreeAgentTest::getDistance
+(
+   const Vector3r& itemLower,
+   const Vector3r& itemUpper,
+   const Vector3r& point
+)
+{
+   // nearest point of the item, by clamping the point into its range
+   real nearest[3];
+   for( int i = 3;  i-- > 0; )
+   {
+      nearest[i] = (point[i] < itemLower[i]) ? itemLower[i] :
+         ((point[i] > itemUpper[i]) ? itemUpper[i] : point[i]);
+   }
+
+   return (Vector3r( nearest[0], nearest[1], nearest[2] ) - point).length();
+}
+
+
+real OctreeAgentTest::getRayIntersection
+(
+   const Vector3r& itemLower,
+   const Vector3r& itemUpper,
+   const Vector3r& rayOrigin,
+   const Vector3r& rayDirection
+)
+{
+   // intersect the ray's span with each axis's slab
+   real tEnter = 0.0f;
+   real tExit  = REAL_MAX;
+   for( int i = 3;  i-- > 0; )
+   {
+      if( 0.0f != rayDirection[i] )
+      {
+         const real t0 = (itemLower[i] - rayOrigin[i]) / rayDirection[i];
+         const real t1 = (itemUpper[i] - rayOrigin[i]) / rayDirection[i];
+         tEnter = std::max( tEnter, std::min( t0, t1 ) );
+         tExit  = std::min( tExit,  std::max( t0, t1 ) );
+      }
+      else if( (rayOrigin[i] < itemLower[i]) | (rayOrigin[i] > itemUpper[i]) )
+      {
+         tExit = -1.0f;
+      }
+   }
+
+   return (tEnter <= tExit) ? tEnter : REAL_MAX;
+}
+
+
+
+
+/// OctreeAgentStaticTest //////////////////////////////////////////////////////
+
+class OctreeAgentStaticTest
+{
+/// standard object services ---------------------------------------------------
+public:
+            OctreeAgentStaticTest() {};
+
+           ~OctreeAgentStaticTest() {};
+private:
+            OctreeAgentStaticTest( const OctreeAgentStaticTest& );
+   OctreeAgentStaticTest& operator=( const OctreeAgentStaticTest& );
+public:
+
+
+/// queries --------------------------------------------------------------------
+/// octree static agent
+           bool  isOverlappingCell ( const OctreeItemTest& item,
+                                     const Vector3r& lowerCorner,
+                                     const Vector3r& upperCorner )        const;
+           bool  isCoveringCell    ( const OctreeItemTest& item,
+                                     const Vector3r& lowerCorner,
+                                     const Vector3r& upperCorner )        const;
+           dword getSubcellOverlaps( const OctreeItemTest& item,
+                                     const Vector3r& lower,
+                                     const Vector3r& middle,
+                                     const Vector3r& upper )              const;
+           real  getDistance       ( const OctreeItemTest& item,
+                                     const Vector3r&       point )        const;
+           real  getRayIntersection( const OctreeItemTest& item,
+                                     const Vector3r&       rayOrigin,
+                                     const Vector3r&       rayDirection ) const;
+};
+
+
+
+
+/// queries --------------------------------------------------------------------
+/// octree static agent
+bool OctreeAgentStaticTest::isCoveringCell
+(
+   const OctreeItemTest& item,
+   const Vector3r&       lowerCorner,
+   const Vector3r&       upperCorner
+) const
+{
+   return OctreeShape::isCoveringBox( item.getPosition(),
+      item.getPosition() + item.getDimensions(), lowerCorner, upperCorner );
+}
+
+
+bool OctreeAgentStaticTest::isOverlappingCell
+(
+   const OctreeItemTest& item,
+   const Vector3r&       lowerCorner,
+   const Vector3r&       upperCorner
+) const
+{
+   return OctreeAgentTest::isOverlapping( item.getPosition(),
+      item.getPosition() + item.getDimensions(), lowerCorner, upperCorner );
+}
+
+
+dword OctreeAgentStaticTest::getSubcellOverlaps
+(
+   const OctreeItemTest& item,
+   const Vector3r&       lower,
+   const Vector3r&       middle,
+   const Vector3r&       upper
+) const
+{
+   const Vector3r& itemLower = item.getPosition();
+   const Vector3r  itemUpper( item.getPosition() + item.getDimensions() );
+
+   // find which halfs are overlapped, along each axis
+   dword halfs[3][2];
+   for( int k = 3;  k-- > 0; )
+   {
+      halfs[k][0] = (itemLower[k] < middle[k]) & (itemUpper[k] > lower[k]);
+      halfs[k][1] = (itemLower[k] < upper[k])  & (itemUpper[k] > middle[k]);
+   }
+
+   // a subcell is overlapped if its half along every axis is
+   dword flags = 0;
+   for( dword i = 8;  i-- > 0; )
+   {
+      flags |= (halfs[0][i & 1] & halfs[1][(i >> 1) & 1] &
+         halfs[2][(i >> 2) & 1]) << i;
+   }
+
+   return flags;
+}
+
+
+real OctreeAgentStaticTest::getDistance
+(
+   const OctreeItemTest& item,
+   const Vector3r&       point
+) const
+{
+   return OctreeAgentTest::getDistance( item.getPosition(),
+      item.getPosition() + item.getDimensions(), point );
+}
+
+
+real OctreeAgentStaticTest::getRayIntersection
+(
+   const OctreeItemTest& item,
+   const Vector3r&       rayOrigin,
+   const Vector3r&       rayDirection
+) const
+{
+   return OctreeAgentTest::getRayIntersection( item.getPosition(),
+      item.getPosition() + item.getDimensions(), rayOrigin, rayDirection );
+}
+
+
 
 
 /// OctreeVisitorTest //////////////////////////////////////////////////////////
@@ -266,7 +502,8 @@ class OctreeVisitorTest
 {
 /// standard object services ---------------------------------------------------
 public:
-            OctreeVisitorTest( const Octree<OctreeItemTest>& );
+   template<class OCTREE>
+   explicit OctreeVisitorTest( const OCTREE& );
 
    virtual ~OctreeVisitorTest();
 private:
@@ -282,6 +519,8 @@ protected:
                               const OctreeData& octreeData );
    virtual void  visitLeaf  ( const Array<const OctreeItemTest*>& items,
                               const OctreeData& octreeData );
+   virtual void  visitBranchItems( const Array<const OctreeItemTest*>& items,
+                                   const OctreeData& octreeData );
 
 
 /// queries --------------------------------------------------------------------
@@ -290,24 +529,28 @@ public:
 
    const std::vector<const void*>& getIds()                               const;
    const std::vector<LeafData>&    getLeafs()                             const;
+   const std::vector<LeafData>&    getBranchItems()                       const;
 
 
 /// fields ---------------------------------------------------------------------
 private:
    std::vector<const void*> ids_m;
    std::vector<LeafData>    leafs_m;
+   std::vector<LeafData>    branchItems_m;
 };
 
 
 
 
 /// standard object services ---------------------------------------------------
+template<class OCTREE>
 OctreeVisitorTest::OctreeVisitorTest
 (
-   const Octree<OctreeItemTest>& octree
+   const OCTREE& octree
 )
- : ids_m  ()
- , leafs_m()
+ : ids_m        ()
+ , leafs_m      ()
+ , branchItems_m()
 {
    ids_m.push_back( static_cast<const void*>(&octree) );
 }
@@ -323,8 +566,9 @@ OctreeVisitorTest::OctreeVisitorTest
    const OctreeVisitorTest& other
 )
  : OctreeVisitor<OctreeItemTest>()
- , ids_m  ( other.ids_m )
- , leafs_m( other.leafs_m )
+ , ids_m        ( other.ids_m )
+ , leafs_m      ( other.leafs_m )
+ , branchItems_m( other.branchItems_m )
 {
 }
 
@@ -336,8 +580,9 @@ OctreeVisitorTest& OctreeVisitorTest::operator=
 {
    if( &other != this )
    {
-      ids_m   = other.ids_m;
-      leafs_m = other.leafs_m;
+      ids_m         = other.ids_m;
+      leafs_m       = other.leafs_m;
+      branchItems_m = other.branchItems_m;
    }
 
    return *this;
@@ -395,6 +640,16 @@ void OctreeVisitorTest::visitLeaf
 }
 
 
+void OctreeVisitorTest::visitBranchItems
+(
+   const Array<const OctreeItemTest*>& items,
+   const OctreeData& octreeData
+)
+{
+   branchItems_m.push_back( LeafData( octreeData, items ) );
+}
+
+
 /// queries --------------------------------------------------------------------
 const std::vector<const void*>& OctreeVisitorTest::getIds() const
 {
@@ -409,586 +664,6171 @@ const
 }
 
 
+const std::vector<OctreeVisitorTest::LeafData>&
+OctreeVisitorTest::getBranchItems() const
+{
+   return branchItems_m;
+}
 
 
 
 
 
 
-/// declarations ///////////////////////////////////////////////////////////////
 
-static bool testConstruction
-(
-   std::ostream* out       = 0,
-   const bool    isVerbose = false,
-   const dword   seed      = 0
-);
-static bool testCommands
-(
-   std::ostream* out       = 0,
-   const bool    isVerbose = false,
-   const dword   seed      = 0
-);
-static bool testCommands1
-(
-   std::ostream* out       = 0,
-   const bool    isVerbose = false,
-   const dword   seed      = 0
-);
-static bool testCommands2
-(
-   std::ostream* out       = 0,
-   const bool    isVerbose = false,
-   const dword   seed      = 0
-);
-static bool testCommands3
-(
-   std::ostream* out       = 0,
-   const bool    isVerbose = false,
-   const dword   seed      = 0
-);
 
+/// OctreeVisitorStatsTest /////////////////////////////////////////////////////
 
-class RandomFast
+/**
+ * Counts the cells and items visited, as OctreeStats would (but for byte
+ * size), the items held at branchs too (and whether those cover their
+ * branch, as OctreeRoot holds them), and the fewest item refs any branch
+ * holds. Checks each cell's item ref count against the refs visited in and
+ * below it.
+ */
+class OctreeVisitorStatsTest
+   : public OctreeVisitor<OctreeItemTest>
 {
-public:
 /// standard object services ---------------------------------------------------
-   explicit RandomFast( const dword seed =0 )
-    : random_m( seed )
-   {
-   }
+public:
+            OctreeVisitorStatsTest();
 
-   ~RandomFast()
-   {
-   }
+   virtual ~OctreeVisitorStatsTest();
+private:
+            OctreeVisitorStatsTest( const OctreeVisitorStatsTest& );
+   OctreeVisitorStatsTest& operator=( const OctreeVisitorStatsTest& );
 
-   RandomFast( const RandomFast& other )
-    : random_m( other.random_m )
-   {
-   }
 
-   RandomFast& operator=( const RandomFast& other )
-   {
-      random_m = other.random_m;
+/// commands -------------------------------------------------------------------
+protected:
+   virtual void  visitRoot  ( const OctreeCell* pRootCell,
+                              const OctreeData& octreeData );
+   virtual void  visitBranch( const OctreeCell* subCells[8],
+                              const OctreeData& octreeData );
+   virtual void  visitLeaf  ( const Array<const OctreeItemTest*>& items,
+                              const OctreeData& octreeData );
+   virtual void  visitBranchItems( const Array<const OctreeItemTest*>& items,
+                                   const OctreeData& octreeData );
 
-      return *this;
-   }
 
+/// queries --------------------------------------------------------------------
+public:
+   const OctreeStats& getStats()                                          const;
+   dword              getItemCount()                                      const;
+   bool               isBranchItemsCovering()                             const;
+   dword              getMinBranchRefCount()                              const;
+   bool               isRefCountsRight()                                  const;
 
-/// commands -------------------------------------------------------------------
-   RandomFast& setSeed( const dword seed )
-   {
-      random_m = seed;
 
-      return *this;
-   }
+/// fields ---------------------------------------------------------------------
+private:
+   OctreeStats                     stats_m;
+   std::set<const OctreeItemTest*> items_m;
+   bool                            isBranchItemsCovering_m;
+   dword                           branchItemCount_m;
+   dword                           minBranchRefCount_m;
+   dword                           refCount_m;
+   bool                            isRefCountsRight_m;
+};
 
-   RandomFast& next()
-   {
-      random_m = static_cast<dword>(1664525) * random_m +
-         static_cast<dword>(1013904223);
 
-      return *this;
-   }
 
 
-/// queries --------------------------------------------------------------------
-   dword getDword()                                                       const
-   {
-      return random_m;
-   }
+/// standard object services ---------------------------------------------------
+OctreeVisitorStatsTest::OctreeVisitorStatsTest()
+ : stats_m                ()
+ , items_m                ()
+ , isBranchItemsCovering_m( true )
+ , branchItemCount_m      ( 0 )
+ , minBranchRefCount_m    ( DWORD_MAX )
+ , refCount_m             ( 0 )
+ , isRefCountsRight_m     ( true )
+{
+}
+
+
+OctreeVisitorStatsTest::~OctreeVisitorStatsTest()
+{
+}
 
-   udword getUdword()                                                     const
+
+/// commands -------------------------------------------------------------------
+void OctreeVisitorStatsTest::visitRoot
+(
+   const OctreeCell* pRootCell,
+   const OctreeData& octreeData
+)
+{
+   if( pRootCell )
    {
-      return static_cast<udword>(random_m);
+      const dword before = refCount_m;
+      pRootCell->visit( octreeData, *this );
+      isRefCountsRight_m &= (refCount_m - before ==
+         pRootCell->getItemRefCount());
    }
+}
 
-   float getFloat()                                                       const
+
+void OctreeVisitorStatsTest::visitBranch
+(
+   const OctreeCell* subCells[8],
+   const OctreeData& octreeData
+)
+{
+   stats_m.addBranch( octreeData.getLevel(), 0 );
+
+   // item refs of the branch: its own items (visited just before) and below
+   dword refCount = branchItemCount_m;
+   branchItemCount_m = 0;
+   for( dword i = 8;  i-- > 0; )
    {
-      dword itemp = static_cast<dword>(0x3F800000) |
-         (static_cast<dword>(0x007FFFFF) & random_m);
-      return *(reinterpret_cast<float*>(&itemp)) - 1.0f;
+      refCount += subCells[i] ? subCells[i]->getItemRefCount() : 0;
    }
+   minBranchRefCount_m = std::min( minBranchRefCount_m, refCount );
 
-   float getFloat( const float scale,
-                   const float displace = 0.0f )                          const
+   for( dword i = 8;  i-- > 0; )
    {
-      return getFloat() * scale + displace;
+      if( subCells[i] )
+      {
+         const dword before = refCount_m;
+         OctreeBranch::continueVisit( subCells, octreeData, i, *this );
+         isRefCountsRight_m &= (refCount_m - before ==
+            subCells[i]->getItemRefCount());
+      }
    }
+}
 
 
-/// fields ---------------------------------------------------------------------
-private:
-   // current value of sequence and seed of the following part of the sequence
-   dword random_m;
-};
+void OctreeVisitorStatsTest::visitLeaf
+(
+   const Array<const OctreeItemTest*>& items,
+   const OctreeData& octreeData
+)
+{
+   stats_m.addLeaf( octreeData.getLevel(), items.getLength(), 0 );
+   refCount_m += items.getLength();
 
+   items_m.insert( items.getStorage(), items.getStorage() +
+      items.getLength() );
+}
 
-static void makeRandomFilledOctree
-(
-   RandomFast&                             rand,
-   const dword                             howManyItems,
-   std::auto_ptr<Octree<OctreeItemTest> >& pOctree,
-   std::vector<OctreeItemTest>&            items
-);
-static void makeRandomOctree
+
+void OctreeVisitorStatsTest::visitBranchItems
 (
-   RandomFast&                             rand,
+   const Array<const OctreeItemTest*>& items,
+   const OctreeData& octreeData
+)
+{
+   stats_m.addBranchItems( items.getLength(), 0 );
+   branchItemCount_m = items.getLength();
+   refCount_m       += items.getLength();
+
+   items_m.insert( items.getStorage(), items.getStorage() +
+      items.getLength() );
+
+   const OctreeBound& bound = octreeData.getBound();
+   for( dword i = 0;  i < items.getLength();  ++i )
+   {
+      isBranchItemsCovering_m &= OctreeShape::isCoveringBox(
+         items[i]->getPosition(), items[i]->getPosition() +
+         items[i]->getDimensions(), bound.getLowerCorner(),
+         bound.getUpperCorner() );
+   }
+}
+
+
+/// queries --------------------------------------------------------------------
+const OctreeStats& OctreeVisitorStatsTest::getStats() const
+{
+   return stats_m;
+}
+
+
+dword OctreeVisitorStatsTest::getItemCount() const
+{
+   return static_cast<dword>(items_m.size());
+}
+
+
+bool OctreeVisitorStatsTest::isBranchItemsCovering() const
+{
+   return isBranchItemsCovering_m;
+}
+
+
+dword OctreeVisitorStatsTest::getMinBranchRefCount() const
+{
+   return minBranchRefCount_m;
+}
+
+
+bool OctreeVisitorStatsTest::isRefCountsRight() const
+{
+   return isRefCountsRight_m;
+}
+
+
+
+
+
+
+
+
+/// OctreeQueryTest ////////////////////////////////////////////////////////////
+
+class OctreeQueryTest
+{
+/// standard object services ---------------------------------------------------
+public:
+            OctreeQueryTest( const Vector3r& lowerCorner,
+                             const Vector3r& upperCorner );
+
+           ~OctreeQueryTest();
+private:
+            OctreeQueryTest( const OctreeQueryTest& );
+   OctreeQueryTest& operator=( const OctreeQueryTest& );
+public:
+
+
+/// commands -------------------------------------------------------------------
+/// octree frozen query
+           bool  isEntering( const OctreeData& cellData );
+           void  visitLeaf ( const OctreeItemTest* const* pItems,
+                             dword                        itemCount,
+                             const OctreeData&            leafData );
+
+
+/// queries --------------------------------------------------------------------
+           const std::vector<const OctreeItemTest*>& getItems()           const;
+
+
+/// fields ---------------------------------------------------------------------
+private:
+   Vector3r                           lowerCorner_m;
+   Vector3r                           upperCorner_m;
+   std::vector<const OctreeItemTest*> items_m;
+};
+
+
+
+
+/// standard object services ---------------------------------------------------
+OctreeQueryTest::OctreeQueryTest
+(
+   const Vector3r& lowerCorner,
+   const Vector3r& upperCorner
+)
+ : lowerCorner_m( lowerCorner )
+ , upperCorner_m( upperCorner )
+ , items_m      ()
+{
+}
+
+
+OctreeQueryTest::~OctreeQueryTest()
+{
+}
+
+
+/// commands -------------------------------------------------------------------
+bool OctreeQueryTest::isEntering
+(
+   const OctreeData& cellData
+)
+{
+   return OctreeAgentTest::isOverlapping( lowerCorner_m, upperCorner_m,
+      cellData.getBound().getLowerCorner(),
+      cellData.getBound().getUpperCorner() );
+}
+
+
+void OctreeQueryTest::visitLeaf
+(
+   const OctreeItemTest* const* pItems,
+   const dword                  itemCount,
+   const OctreeData&            //leafData
+)
+{
+   items_m.insert( items_m.end(), pItems, pItems + itemCount );
+}
+
+
+/// queries --------------------------------------------------------------------
+const std::vector<const OctreeItemTest*>& OctreeQueryTest::getItems() const
+{
+   return items_m;
+}
+
+
+
+
+/// OctreeVisitorParallelTest //////////////////////////////////////////////////
+
+class OctreeVisitorParallelTest
+   : public OctreeVisitorParallel<OctreeItemTest>
+{
+/// standard object services ---------------------------------------------------
+public:
+            OctreeVisitorParallelTest( const Vector3r& lowerCorner,
+                                       const Vector3r& upperCorner );
+
+   virtual ~OctreeVisitorParallelTest();
+private:
+            OctreeVisitorParallelTest( const OctreeVisitorParallelTest& );
+   OctreeVisitorParallelTest& operator=( const OctreeVisitorParallelTest& );
+public:
+
+
+/// commands -------------------------------------------------------------------
+/// octree visitor parallel
+   virtual OctreeVisitorParallel<OctreeItemTest>* clone()               const;
+   virtual void  reduce( const OctreeVisitorParallel<OctreeItemTest>& clone );
+
+   virtual bool  isEntering( const OctreeData& cellData );
+   virtual void  visitLeaf ( const OctreeItemTest* const* pItems,
+                             dword                        itemCount,
+                             const OctreeData&            leafData );
+
+
+/// queries --------------------------------------------------------------------
+           const std::vector<const OctreeItemTest*>& getItems()           const;
+           real                                      getSum()             const;
+
+
+/// fields ---------------------------------------------------------------------
+private:
+   Vector3r                           lowerCorner_m;
+   Vector3r                           upperCorner_m;
+   std::vector<const OctreeItemTest*> items_m;
+   real                               sum_m;
+};
+
+
+
+
+/// standard object services ---------------------------------------------------
+OctreeVisitorParallelTest::OctreeVisitorParallelTest
+(
+   const Vector3r& lowerCorner,
+   const Vector3r& upperCorner
+)
+ : lowerCorner_m( lowerCorner )
+ , upperCorner_m( upperCorner )
+ , items_m      ()
+ , sum_m        ( 0.0f )
+{
+}
+
+
+OctreeVisitorParallelTest::~OctreeVisitorParallelTest()
+{
+}
+
+
+/// commands -------------------------------------------------------------------
+OctreeVisitorParallel<OctreeItemTest>* OctreeVisitorParallelTest::clone() const
+{
+   return new OctreeVisitorParallelTest( lowerCorner_m, upperCorner_m );
+}
+
+
+void OctreeVisitorParallelTest::reduce
+(
+   const OctreeVisitorParallel<OctreeItemTest>& clone
+)
+{
+   const OctreeVisitorParallelTest& other =
+      static_cast<const OctreeVisitorParallelTest&>( clone );
+
+   items_m.insert( items_m.end(), other.items_m.begin(), other.items_m.end() );
+   sum_m += other.sum_m;
+}
+
+
+bool OctreeVisitorParallelTest::isEntering
+(
+   const OctreeData& cellData
+)
+{
+   return OctreeAgentTest::isOverlapping( lowerCorner_m, upperCorner_m,
+      cellData.getBound().getLowerCorner(),
+      cellData.getBound().getUpperCorner() );
+}
+
+
+void OctreeVisitorParallelTest::visitLeaf
+(
+   const OctreeItemTest* const* pItems,
+   const dword                  itemCount,
+   const OctreeData&            //leafData
+)
+{
+   items_m.insert( items_m.end(), pItems, pItems + itemCount );
+
+   // (a sum whose rounding depends on the order of adding)
+   for( dword i = 0;  i < itemCount;  ++i )
+   {
+      sum_m += pItems[i]->getPosition()[0] * 1.1f;
+   }
+}
+
+
+/// queries --------------------------------------------------------------------
+const std::vector<const OctreeItemTest*>& OctreeVisitorParallelTest::getItems()
+   const
+{
+   return items_m;
+}
+
+
+real OctreeVisitorParallelTest::getSum() const
+{
+   return sum_m;
+}
+
+
+
+
+/// OctreeQueryRayTest /////////////////////////////////////////////////////////
+
+class OctreeQueryRayTest
+{
+/// standard object services ---------------------------------------------------
+public:
+            OctreeQueryRayTest( const Vector3r& rayOrigin,
+                                const Vector3r& rayDirection );
+
+           ~OctreeQueryRayTest();
+private:
+            OctreeQueryRayTest( const OctreeQueryRayTest& );
+   OctreeQueryRayTest& operator=( const OctreeQueryRayTest& );
+public:
+
+
+/// commands -------------------------------------------------------------------
+/// octree frozen query
+           bool  isEntering( const OctreeData& cellData );
+           void  visitLeaf ( const OctreeItemTest* const* pItems,
+                             dword                        itemCount,
+                             const OctreeData&            leafData );
+
+
+/// queries --------------------------------------------------------------------
+           dword getSubcellOrder()                                        const;
+           dword getLeafCount()                                           const;
+           bool  isFrontToBack( real tolerance )                          const;
+
+
+/// fields ---------------------------------------------------------------------
+private:
+   Vector3r rayOrigin_m;
+   Vector3r rayDirection_m;
+   dword    leafCount_m;
+   real     lastT_m;
+   real     maxStepBack_m;
+};
+
+
+
+
+/// standard object services ---------------------------------------------------
+OctreeQueryRayTest::OctreeQueryRayTest
+(
+   const Vector3r& rayOrigin,
+   const Vector3r& rayDirection
+)
+ : rayOrigin_m   ( rayOrigin )
+ , rayDirection_m( rayDirection )
+ , leafCount_m   ( 0 )
+ , lastT_m       ( 0.0f )
+ , maxStepBack_m ( 0.0f )
+{
+}
+
+
+OctreeQueryRayTest::~OctreeQueryRayTest()
+{
+}
+
+
+/// commands -------------------------------------------------------------------
+bool OctreeQueryRayTest::isEntering
+(
+   const OctreeData& cellData
+)
+{
+   return REAL_MAX != OctreeAgentTest::getRayIntersection(
+      cellData.getBound().getLowerCorner(),
+      cellData.getBound().getUpperCorner(), rayOrigin_m, rayDirection_m );
+}
+
+
+void OctreeQueryRayTest::visitLeaf
+(
+   const OctreeItemTest* const* ,//pItems,
+   const dword                  ,//itemCount,
+   const OctreeData&            leafData
+)
+{
+   // record how far the ray's entry to this leaf is behind the last's
+   const real t = OctreeAgentTest::getRayIntersection(
+      leafData.getBound().getLowerCorner(),
+      leafData.getBound().getUpperCorner(), rayOrigin_m, rayDirection_m );
+   maxStepBack_m = std::max( maxStepBack_m, lastT_m - t );
+   lastT_m = t;
+
+   ++leafCount_m;
+}
+
+
+/// queries --------------------------------------------------------------------
+dword OctreeQueryRayTest::getSubcellOrder() const
+{
+   return (static_cast<dword>(rayDirection_m.getX() < 0.0f) << 0) |
+          (static_cast<dword>(rayDirection_m.getY() < 0.0f) << 1) |
+          (static_cast<dword>(rayDirection_m.getZ() < 0.0f) << 2);
+}
+
+
+dword OctreeQueryRayTest::getLeafCount() const
+{
+   return leafCount_m;
+}
+
+
+bool OctreeQueryRayTest::isFrontToBack
+(
+   const real tolerance
+) const
+{
+   return maxStepBack_m <= tolerance;
+}
+
+
+
+
+/// OctreeShapeItemTest ////////////////////////////////////////////////////////
+
+/**
+ * A ball, that can be taken as a point, box, or sphere, for the stock agents.
+ */
+class OctreeShapeItemTest
+{
+/// standard object services ---------------------------------------------------
+public:
+            OctreeShapeItemTest( const Vector3r& center = Vector3r::ZERO(),
+                                 real            radius = 0.0f );
+
+
+/// queries --------------------------------------------------------------------
+           const Vector3r& getPosition()                                  const;
+           const Vector3r& getCenter()                                    const;
+           real            getRadius()                                    const;
+           Vector3r        getLowerCorner()                               const;
+           Vector3r        getUpperCorner()                               const;
+
+
+/// fields ---------------------------------------------------------------------
+private:
+   Vector3r center_m;
+   real     radius_m;
+};
+
+
+
+
+/// standard object services ---------------------------------------------------
+OctreeShapeItemTest::OctreeShapeItemTest
+(
+   const Vector3r& center,
+   const real      radius
+)
+ : center_m( center )
+ , radius_m( radius )
+{
+}
+
+
+/// queries --------------------------------------------------------------------
+const Vector3r& OctreeShapeItemTest::getPosition() const
+{
+   return center_m;
+}
+
+
+const Vector3r& OctreeShapeItemTest::getCenter() const
+{
+   return center_m;
+}
+
+
+real OctreeShapeItemTest::getRadius() const
+{
+   return radius_m;
+}
+
+
+Vector3r OctreeShapeItemTest::getLowerCorner() const
+{
+   return center_m - (Vector3r::ONE() * radius_m);
+}
+
+
+Vector3r OctreeShapeItemTest::getUpperCorner() const
+{
+   return center_m + (Vector3r::ONE() * radius_m);
+}
+
+
+
+
+/// OctreeTriangleItemTest /////////////////////////////////////////////////////
+
+/**
+ * A triangle, for the stock triangle agent.
+ */
+class OctreeTriangleItemTest
+{
+/// standard object services ---------------------------------------------------
+public:
+            OctreeTriangleItemTest();
+            OctreeTriangleItemTest( const Vector3r& vertex0,
+                                    const Vector3r& vertex1,
+                                    const Vector3r& vertex2 );
+
+
+/// queries --------------------------------------------------------------------
+           const Vector3r& getVertex( dword index )                       const;
+
+
+/// fields ---------------------------------------------------------------------
+private:
+   Vector3r vertexs_m[3];
+};
+
+
+
+
+/// standard object services ---------------------------------------------------
+OctreeTriangleItemTest::OctreeTriangleItemTest()
+{
+}
+
+
+OctreeTriangleItemTest::OctreeTriangleItemTest
+(
+   const Vector3r& vertex0,
+   const Vector3r& vertex1,
+   const Vector3r& vertex2
+)
+{
+   vertexs_m[0] = vertex0;
+   vertexs_m[1] = vertex1;
+   vertexs_m[2] = vertex2;
+}
+
+
+/// queries --------------------------------------------------------------------
+const Vector3r& OctreeTriangleItemTest::getVertex
+(
+   const dword index
+) const
+{
+   return vertexs_m[index];
+}
+
+
+
+
+
+
+
+
+/// OctreeConcurrentTaskTest ///////////////////////////////////////////////////
+
+/**
+ * Writer or reader of an OctreeConcurrent, as a task, for running together.
+ * <br/><br/>
+ *
+ * The writer inserts the items a batch at a time, then removes them a batch
+ * at a time from the front, publishing after each batch. So every version
+ * holds a run of whole batches, which the reader checks of each version it
+ * sees.
+ */
+class OctreeConcurrentTaskTest
+   : public OctreeTaskV
+{
+/// standard object services ---------------------------------------------------
+public:
+            OctreeConcurrentTaskTest(
+               OctreeConcurrent<OctreeItemTest>&  octree,
+               const std::vector<OctreeItemTest>& items,
+               dword                              batchLength,
+               bool                               isWriter );
+
+   virtual ~OctreeConcurrentTaskTest();
+private:
+            OctreeConcurrentTaskTest( const OctreeConcurrentTaskTest& );
+   OctreeConcurrentTaskTest& operator=( const OctreeConcurrentTaskTest& );
+public:
+
+
+/// commands -------------------------------------------------------------------
+   virtual void  run();
+
+
+/// queries --------------------------------------------------------------------
+           bool  isOk()                                                   const;
+
+
+/// implementation -------------------------------------------------------------
+protected:
+           void  write();
+           void  read();
+
+
+/// fields ---------------------------------------------------------------------
+private:
+   OctreeConcurrent<OctreeItemTest>*  pOctree_m;
+   const std::vector<OctreeItemTest>* pItems_m;
+   dword                              batchLength_m;
+   bool                               isWriter_m;
+   bool                               isOk_m;
+};
+
+
+
+
+/// standard object services ---------------------------------------------------
+OctreeConcurrentTaskTest::OctreeConcurrentTaskTest
+(
+   OctreeConcurrent<OctreeItemTest>&  octree,
+   const std::vector<OctreeItemTest>& items,
+   const dword                        batchLength,
+   const bool                         isWriter
+)
+ : pOctree_m    ( &octree )
+ , pItems_m     ( &items )
+ , batchLength_m( batchLength )
+ , isWriter_m   ( isWriter )
+ , isOk_m       ( true )
+{
+}
+
+
+OctreeConcurrentTaskTest::~OctreeConcurrentTaskTest()
+{
+}
+
+
+/// commands -------------------------------------------------------------------
+void OctreeConcurrentTaskTest::run()
+{
+   if( isWriter_m )
+   {
+      write();
+   }
+   else
+   {
+      read();
+   }
+}
+
+
+/// queries --------------------------------------------------------------------
+bool OctreeConcurrentTaskTest::isOk() const
+{
+   return isOk_m;
+}
+
+
+/// implementation -------------------------------------------------------------
+void OctreeConcurrentTaskTest::write()
+{
+   const OctreeAgentTest a;
+   const dword           batchCount = pItems_m->size() / batchLength_m;
+
+   // insert batches, in turn by insertRange and by insert
+   for( dword b = 0;  b < batchCount;  ++b )
+   {
+      const OctreeItemTest* pBatch = &(*pItems_m)[b * batchLength_m];
+      if( b & 1 )
+      {
+         pOctree_m->insertRange( pBatch, batchLength_m, a );
+      }
+      else
+      {
+         for( dword i = 0;  i < batchLength_m;  ++i )
+         {
+            pOctree_m->insert( pBatch[i], a );
+         }
+      }
+      pOctree_m->publish();
+   }
+
+   // remove batches
+   for( dword b = 0;  b < batchCount;  ++b )
+   {
+      const OctreeItemTest* pBatch = &(*pItems_m)[b * batchLength_m];
+      for( dword i = 0;  i < batchLength_m;  ++i )
+      {
+         isOk_m &= pOctree_m->remove( pBatch[i], a );
+      }
+      pOctree_m->publish();
+   }
+}
+
+
+void OctreeConcurrentTaskTest::read()
+{
+   const OctreeAgentTest        a;
+   Array<const OctreeItemTest*> found;
+
+   for( dword r = 0;  r < 300;  ++r )
+   {
+      const OctreeReader<OctreeItemTest> reader( *pOctree_m );
+
+      // find all items (in index order, as they are in one vector)
+      reader.queryBox( reader.getPosition() - Vector3r::ONE(),
+         reader.getPosition() + (Vector3r::ONE() * (reader.getSize() + 1.0f)),
+         a, found );
+      std::sort( found.getStorage(), found.getStorage() + found.getLength() );
+
+      // check they are a run of whole batches
+      const dword first = found.isEmpty() ? 0 :
+         static_cast<dword>(found[0] - &(*pItems_m)[0]);
+      isOk_m &= (0 == (first % batchLength_m)) &
+         (0 == (found.getLength() % batchLength_m)) &
+         (found.isEmpty() == reader.isEmpty());
+      for( dword i = 0;  i < found.getLength();  ++i )
+      {
+         isOk_m &= (found[i] == &(*pItems_m)[first + i]);
+      }
+   }
+}
+
+
+
+
+typedef Octree<OctreeItemTest, OctreeAllocatorPool, OctreeStripedRoot>
+   OctreeStripedTest;
+
+
+/**
+ * Writer of part of a striped octree, as a task, for running together.
+ * <br/><br/>
+ *
+ * Inserts its own run of the items (half by insert, half by insertRange),
+ * checks they are all found, removes every other one, and checks again. The
+ * others' items come and go meanwhile.
+ */
+class OctreeStripedTaskTest
+   : public OctreeTaskV
+{
+/// standard object services ---------------------------------------------------
+public:
+            OctreeStripedTaskTest( OctreeStripedTest&                 octree,
+                                   const std::vector<OctreeItemTest>& items,
+                                   dword                              begin,
+                                   dword                              end );
+
+   virtual ~OctreeStripedTaskTest();
+private:
+            OctreeStripedTaskTest( const OctreeStripedTaskTest& );
+   OctreeStripedTaskTest& operator=( const OctreeStripedTaskTest& );
+public:
+
+
+/// commands -------------------------------------------------------------------
+   virtual void  run();
+
+
+/// queries --------------------------------------------------------------------
+           bool  isOk()                                                   const;
+
+
+/// implementation -------------------------------------------------------------
+protected:
+           void  check( bool isHalfRemoved );
+
+
+/// fields ---------------------------------------------------------------------
+private:
+   OctreeStripedTest*                 pOctree_m;
+   const std::vector<OctreeItemTest>* pItems_m;
+   dword                              begin_m;
+   dword                              end_m;
+   bool                               isOk_m;
+};
+
+
+
+
+/// standard object services ---------------------------------------------------
+OctreeStripedTaskTest::OctreeStripedTaskTest
+(
+   OctreeStripedTest&                 octree,
+   const std::vector<OctreeItemTest>& items,
+   const dword                        begin,
+   const dword                        end
+)
+ : pOctree_m( &octree )
+ , pItems_m ( &items )
+ , begin_m  ( begin )
+ , end_m    ( end )
+ , isOk_m   ( true )
+{
+}
+
+
+OctreeStripedTaskTest::~OctreeStripedTaskTest()
+{
+}
+
+
+/// commands -------------------------------------------------------------------
+void OctreeStripedTaskTest::run()
+{
+   const OctreeAgentTest a;
+   const dword           middle = (begin_m + end_m) / 2;
+
+   for( dword i = begin_m;  i < middle;  ++i )
+   {
+      isOk_m &= pOctree_m->insert( (*pItems_m)[i], a );
+   }
+   isOk_m &= (end_m - middle) == pOctree_m->insertRange( &(*pItems_m)[middle],
+      end_m - middle, a, 2 );
+   check( false );
+
+   for( dword i = begin_m;  i < end_m;  i += 2 )
+   {
+      isOk_m &= pOctree_m->remove( (*pItems_m)[i], a );
+   }
+   check( true );
+}
+
+
+/// queries --------------------------------------------------------------------
+bool OctreeStripedTaskTest::isOk() const
+{
+   return isOk_m;
+}
+
+
+/// implementation -------------------------------------------------------------
+void OctreeStripedTaskTest::check
+(
+   const bool isHalfRemoved
+)
+{
+   // find all items, and check own ones are present (but not the removed)
+   const OctreeAgentTest        a;
+   Array<const OctreeItemTest*> found;
+   pOctree_m->queryBox( pOctree_m->getPosition() - Vector3r::ONE(),
+      pOctree_m->getPosition() + (Vector3r::ONE() * (pOctree_m->getSize() +
+      1.0f)), a, found );
+   std::sort( found.getStorage(), found.getStorage() + found.getLength() );
+
+   for( dword i = begin_m;  i < end_m;  ++i )
+   {
+      const bool isFound = std::binary_search( found.getStorage(),
+         found.getStorage() + found.getLength(), &(*pItems_m)[i] );
+      isOk_m &= (isFound == (!isHalfRemoved || (0 != ((i - begin_m) & 1))));
+   }
+}
+
+
+
+
+
+/**
+ * Changer of an octree, as a task, for running on another thread.<br/><br/>
+ *
+ * Removes the items, then inserts every other one again.
+ */
+class OctreeChangeTaskTest
+   : public OctreeTaskV
+{
+/// standard object services ---------------------------------------------------
+public:
+            OctreeChangeTaskTest( Octree<OctreeItemTest>&            octree,
+                                  const std::vector<OctreeItemTest>& items );
+
+   virtual ~OctreeChangeTaskTest();
+private:
+            OctreeChangeTaskTest( const OctreeChangeTaskTest& );
+   OctreeChangeTaskTest& operator=( const OctreeChangeTaskTest& );
+public:
+
+
+/// commands -------------------------------------------------------------------
+   virtual void  run();
+
+
+/// fields ---------------------------------------------------------------------
+private:
+   Octree<OctreeItemTest>*            pOctree_m;
+   const std::vector<OctreeItemTest>* pItems_m;
+};
+
+
+
+
+/// standard object services ---------------------------------------------------
+OctreeChangeTaskTest::OctreeChangeTaskTest
+(
+   Octree<OctreeItemTest>&            octree,
+   const std::vector<OctreeItemTest>& items
+)
+ : pOctree_m( &octree )
+ , pItems_m ( &items )
+{
+}
+
+
+OctreeChangeTaskTest::~OctreeChangeTaskTest()
+{
+}
+
+
+/// commands -------------------------------------------------------------------
+void OctreeChangeTaskTest::run()
+{
+   const OctreeAgentTest a;
+
+   for( udword i = 0;  i < pItems_m->size();  ++i )
+   {
+      pOctree_m->remove( (*pItems_m)[i], a );
+   }
+   for( udword i = 0;  i < pItems_m->size();  i += 2 )
+   {
+      pOctree_m->insert( (*pItems_m)[i], a );
+   }
+}
+
+
+
+
+/**
+ * Writer of an octree, or reader of a snapshot of it, as a task, for running
+ * together.<br/><br/>
+ *
+ * The writer repeatedly removes all the items, and inserts them again in two
+ * halves, taking a snapshot between, which it checks holds nothing. The
+ * reader repeatedly checks its snapshot holds what it did at construction,
+ * then destroys it (so the writer's cells and allocator are released on the
+ * reader's thread).
+ */
+class OctreeSnapshotTaskTest
+   : public OctreeTaskV
+{
+/// standard object services ---------------------------------------------------
+public:
+            OctreeSnapshotTaskTest(
+               Octree<OctreeItemTest>&            octree,
+               const std::vector<OctreeItemTest>& items,
+               bool                               isWriter );
+
+   virtual ~OctreeSnapshotTaskTest();
+private:
+            OctreeSnapshotTaskTest( const OctreeSnapshotTaskTest& );
+   OctreeSnapshotTaskTest& operator=( const OctreeSnapshotTaskTest& );
+public:
+
+
+/// commands -------------------------------------------------------------------
+   virtual void  run();
+
+
+/// queries --------------------------------------------------------------------
+           bool  isOk()                                                   const;
+
+
+/// implementation -------------------------------------------------------------
+protected:
+           void  write();
+           void  read();
+
+   static  void  queryAll( const Octree<OctreeItemTest>& octree,
+                           Array<const OctreeItemTest*>& found );
+
+
+/// fields ---------------------------------------------------------------------
+private:
+   // the reader's is a snapshot made with new, and owned
+   Octree<OctreeItemTest>*            pOctree_m;
+   const std::vector<OctreeItemTest>* pItems_m;
+   bool                               isWriter_m;
+   Array<const OctreeItemTest*>       snapshotItems_m;
+   bool                               isOk_m;
+};
+
+
+
+
+/// standard object services ---------------------------------------------------
+OctreeSnapshotTaskTest::OctreeSnapshotTaskTest
+(
+   Octree<OctreeItemTest>&            octree,
+   const std::vector<OctreeItemTest>& items,
+   const bool                         isWriter
+)
+ : pOctree_m      ( &octree )
+ , pItems_m       ( &items )
+ , isWriter_m     ( isWriter )
+ , snapshotItems_m()
+ , isOk_m         ( true )
+{
+   if( !isWriter_m )
+   {
+      queryAll( *pOctree_m, snapshotItems_m );
+   }
+}
+
+
+OctreeSnapshotTaskTest::~OctreeSnapshotTaskTest()
+{
+   if( !isWriter_m )
+   {
+      delete pOctree_m;
+   }
+}
+
+
+/// commands -------------------------------------------------------------------
+void OctreeSnapshotTaskTest::run()
+{
+   if( isWriter_m )
+   {
+      write();
+   }
+   else
+   {
+      read();
+   }
+}
+
+
+/// queries --------------------------------------------------------------------
+bool OctreeSnapshotTaskTest::isOk() const
+{
+   return isOk_m;
+}
+
+
+/// implementation -------------------------------------------------------------
+void OctreeSnapshotTaskTest::write()
+{
+   const OctreeAgentTest        a;
+   Array<const OctreeItemTest*> found;
+
+   for( dword r = 0;  r < 4;  ++r )
+   {
+      for( udword i = 0;  i < pItems_m->size();  ++i )
+      {
+         pOctree_m->remove( (*pItems_m)[i], a );
+      }
+
+      {
+         const Octree<OctreeItemTest> snapshot( *pOctree_m );
+         for( udword i = 0;  i < pItems_m->size();  i += 2 )
+         {
+            pOctree_m->insert( (*pItems_m)[i], a );
+         }
+         queryAll( snapshot, found );
+         isOk_m &= found.isEmpty();
+      }
+
+      for( udword i = 1;  i < pItems_m->size();  i += 2 )
+      {
+         pOctree_m->insert( (*pItems_m)[i], a );
+      }
+   }
+}
+
+
+void OctreeSnapshotTaskTest::read()
+{
+   Array<const OctreeItemTest*> found;
+
+   for( dword r = 0;  r < 100;  ++r )
+   {
+      queryAll( *pOctree_m, found );
+      isOk_m &= (found.getLength() == snapshotItems_m.getLength()) &&
+         std::equal( found.getStorage(), found.getStorage() +
+            found.getLength(), snapshotItems_m.getStorage() );
+   }
+
+   delete pOctree_m;
+   pOctree_m = 0;
+}
+
+
+void OctreeSnapshotTaskTest::queryAll
+(
+   const Octree<OctreeItemTest>& octree,
+   Array<const OctreeItemTest*>& found
+)
+{
+   // (sorted, for comparing)
+   const OctreeAgentTest a;
+   octree.queryBox( octree.getPosition() - Vector3r::ONE(),
+      octree.getPosition() + (Vector3r::ONE() * (octree.getSize() + 1.0f)), a,
+      found );
+   std::sort( found.getStorage(), found.getStorage() + found.getLength() );
+}
+
+
+
+
+
+
+
+
+/// declarations ///////////////////////////////////////////////////////////////
+
+static bool testConstruction
+(
+   std::ostream* out       = 0,
+   const bool    isVerbose = false,
+   const dword   seed      = 0
+);
+static bool testCommands
+(
+   std::ostream* out       = 0,
+   const bool    isVerbose = false,
+   const dword   seed      = 0
+);
+static bool testCommands1
+(
+   std::ostream* out       = 0,
+   const bool    isVerbose = false,
+   const dword   seed      = 0
+);
+static bool testCommands2
+(
+   std::ostream* out       = 0,
+   const bool    isVerbose = false,
+   const dword   seed      = 0
+);
+static bool testCommands3
+(
+   std::ostream* out       = 0,
+   const bool    isVerbose = false,
+   const dword   seed      = 0
+);
+static bool testCommands4
+(
+   std::ostream* out       = 0,
+   const bool    isVerbose = false,
+   const dword   seed      = 0
+);
+static bool testCommands5
+(
+   std::ostream* out       = 0,
+   const bool    isVerbose = false,
+   const dword   seed      = 0
+);
+static bool testCommands6
+(
+   std::ostream* out       = 0,
+   const bool    isVerbose = false,
+   const dword   seed      = 0
+);
+static bool testCommands7
+(
+   std::ostream* out       = 0,
+   const bool    isVerbose = false,
+   const dword   seed      = 0
+);
+static bool testCommands8
+(
+   std::ostream* out       = 0,
+   const bool    isVerbose = false,
+   const dword   seed      = 0
+);
+static bool testCommands9
+(
+   std::ostream* out       = 0,
+   const bool    isVerbose = false,
+   const dword   seed      = 0
+);
+static bool testCommands10
+(
+   std::ostream* out       = 0,
+   const bool    isVerbose = false,
+   const dword   seed      = 0
+);
+static bool testCommands11
+(
+   std::ostream* out       = 0,
+   const bool    isVerbose = false,
+   const dword   seed      = 0
+);
+static bool testCommands12
+(
+   std::ostream* out       = 0,
+   const bool    isVerbose = false,
+   const dword   seed      = 0
+);
+static bool testCommands13
+(
+   std::ostream* out       = 0,
+   const bool    isVerbose = false,
+   const dword   seed      = 0
+);
+static bool testCommands14
+(
+   std::ostream* out       = 0,
+   const bool    isVerbose = false,
+   const dword   seed      = 0
+);
+static bool testCommands15
+(
+   std::ostream* out       = 0,
+   const bool    isVerbose = false,
+   const dword   seed      = 0
+);
+static bool testCommands16
+(
+   std::ostream* out       = 0,
+   const bool    isVerbose = false,
+   const dword   seed      = 0
+);
+static bool testCommands17
+(
+   std::ostream* out       = 0,
+   const bool    isVerbose = false,
+   const dword   seed      = 0
+);
+static bool testCommands18
+(
+   std::ostream* out       = 0,
+   const bool    isVerbose = false,
+   const dword   seed      = 0
+);
+static bool testCommands19
+(
+   std::ostream* out       = 0,
+   const bool    isVerbose = false,
+   const dword   seed      = 0
+);
+static bool testCommands20
+(
+   std::ostream* out       = 0,
+   const bool    isVerbose = false,
+   const dword   seed      = 0
+);
+static bool testCommands21
+(
+   std::ostream* out       = 0,
+   const bool    isVerbose = false,
+   const dword   seed      = 0
+);
+static bool testCommands22
+(
+   std::ostream* out       = 0,
+   const bool    isVerbose = false,
+   const dword   seed      = 0
+);
+static bool testCommands23
+(
+   std::ostream* out       = 0,
+   const bool    isVerbose = false,
+   const dword   seed      = 0
+);
+static bool testCommands24
+(
+   std::ostream* out       = 0,
+   const bool    isVerbose = false,
+   const dword   seed      = 0
+);
+static bool testCommands25
+(
+   std::ostream* out       = 0,
+   const bool    isVerbose = false,
+   const dword   seed      = 0
+);
+static bool testCommands26
+(
+   std::ostream* out       = 0,
+   const bool    isVerbose = false,
+   const dword   seed      = 0
+);
+static bool testCommands27
+(
+   std::ostream* out       = 0,
+   const bool    isVerbose = false,
+   const dword   seed      = 0
+);
+static bool testCommands28
+(
+   std::ostream* out       = 0,
+   const bool    isVerbose = false,
+   const dword   seed      = 0
+);
+static bool testCommands29
+(
+   std::ostream* out       = 0,
+   const bool    isVerbose = false,
+   const dword   seed      = 0
+);
+
+
+static void makeRandomFilledOctree
+(
+   RandomFast&                             rand,
+   const dword                             howManyItems,
+   std::auto_ptr<Octree<OctreeItemTest> >& pOctree,
+   std::vector<OctreeItemTest>&            items
+);
+static void makeRandomOctree
+(
+   RandomFast&                             rand,
    std::auto_ptr<Octree<OctreeItemTest> >& pOctree
 );
 static void makeRandomItems
 (
-   RandomFast&                  rand,
-   dword                        howMany,
-   const Vector3r&              position,
-   real                         size,
-   std::vector<OctreeItemTest>& items
-);
+   RandomFast&                  rand,
+   dword                        howMany,
+   const Vector3r&              position,
+   real                         size,
+   std::vector<OctreeItemTest>& items
+);
+template<class OCTREE1, class OCTREE2>
+static bool isSameLeafs
+(
+   const OCTREE1& o1,
+   const OCTREE2& o2,
+   bool           isSameByteSize = true
+);
+static bool isSameCellItems
+(
+   const std::vector<OctreeVisitorTest::LeafData>& l1,
+   const std::vector<OctreeVisitorTest::LeafData>& l2
+);
+template<class AGENT_STATIC, class AGENT>
+static bool testStockAgent
+(
+   RandomFast& rand,
+   dword       i
+);
+template<class OCTREE>
+static bool testVisitParallel
+(
+   const OCTREE&   octree,
+   const Vector3r& lowerCorner,
+   const Vector3r& upperCorner
+);
+template<class OCTREE>
+static bool isSameQueries
+(
+   const Octree<OctreeItemTest>& o1,
+   const OCTREE&                 o2,
+   RandomFast&                   rand
+);
+static bool changeAlike
+(
+   RandomFast&                        rand,
+   Octree<OctreeItemTest>&            o1,
+   Octree<OctreeItemTest>&            o2,
+   const std::vector<OctreeItemTest>& items
+);
+static bool isSharingAll
+(
+   const Octree<OctreeItemTest>& o1,
+   const Octree<OctreeItemTest>& o2
+);
+template<class OCTREE, class AGENT>
+static void changeUniquely
+(
+   OCTREE&                            octree,
+   const AGENT&                       agent,
+   const std::vector<OctreeItemTest>& items,
+   const std::vector<bool>&           isIn,
+   dword                              op,
+   dword                              begin,
+   dword                              length
+);
+template<class OCTREE>
+static bool isCountedStats
+(
+   const OCTREE& octree,
+   dword         itemCount
+);
+template<class OCTREE1, class OCTREE2>
+static bool isSameStats
+(
+   const OCTREE1& o1,
+   const OCTREE2& o2
+);
+template<class OCTREE>
+static bool isCountedCalls
+(
+   OCTREE&                            octree,
+   const std::vector<OctreeItemTest>& items,
+   dword                              first,
+   dword                              removeCount
+);
+template<class OCTREE>
+static bool isSameAsScanned
+(
+   const OCTREE&                      octree,
+   const std::vector<OctreeItemTest>& items,
+   const std::vector<bool>&           isIn,
+   RandomFast&                        rand
+);
+template<class OCTREE>
+static bool isBranchsOver
+(
+   const OCTREE& octree,
+   dword         itemRefCount
+);
+template<class OCTREE>
+static bool isRefCounted
+(
+   const OCTREE& octree
+);
+template<class OCTREE>
+static bool isInLooseBounds
+(
+   const OCTREE& octree
+);
+static void destroySlotTest
+(
+   void* pSlot
+);
+
+
+typedef Octree<OctreeItemTest, OctreeAllocatorPool, OctreeLinear>
+   OctreeLinearTest;
+typedef Octree<OctreeItemTest, OctreeAllocatorPool, OctreeLooseRoot>
+   OctreeLooseTest;
+typedef Octree<OctreeItemTest, OctreeAllocatorHeap, OctreeLooseRoot>
+   OctreeLooseHeapTest;
+typedef OctreeStatic<OctreeItemTest, OctreeAgentStaticTest>
+   OctreeStaticTest;
+
+
+
+
+
+
+
+
+/// test functions /////////////////////////////////////////////////////////////
+
+void hxa7241_graphics::preTest()
+{
+   // make items
+   OctreeItemTest item1( Vector3r( 1, 1, 1 ) );
+   OctreeItemTest item2( Vector3r( 3, 3, 3 ) );
+   OctreeItemTest item3( Vector3r( 4, 4, 4 ) );
+
+   // make octree
+   Vector3r position( 0, 0, 0 );
+   real     size      = 5.0f;
+   dword    maxItems  = 1;
+   dword    maxLevels = 4;
+
+   Octree<OctreeItemTest> o1( position, size, maxItems, maxLevels, 0.001f );
+
+   // insert items into octree
+   OctreeAgentTest a;
+   o1.insert( item1, a );
+   o1.insert( item2, a );
+   o1.insert( item3, a );
+
+   // stream out octree
+   OctreeStreamOut<OctreeItemTest> vso( std::cout, true );
+   o1.visit( vso );
+}
+
+
+
+
+bool hxa7241_graphics::test_Octree
+(
+   std::ostream* pOut,
+   const bool    isVerbose,
+   dword         seed
+)
+{
+   if( 0 == seed )
+   {
+      seed = static_cast<dword>(::time(0));
+   }
+
+   if( pOut )
+   {
+      pOut->flags( std::ios_base::boolalpha );// | std::ios_base::uppercase );
+   }
+
+   return testConstruction( pOut, isVerbose, seed ) &&
+      testCommands( pOut, isVerbose, seed );
+}
+
+
+
+
+bool testConstruction
+(
+   std::ostream* pOut,
+   const bool    isVerbose,
+   const dword   seed
+)
+{
+   // Copying:
+   //
+   // Generate some random octrees. Copy each (sharing, and not), and assign
+   // each to an unrelated octree, and check all are identical to their
+   // original in value. Check the sharing copy shares all cells with its
+   // original (the same object ids, but for the octree itself), and the
+   // unshared copy and the assigned one share none (all object ids are
+   // different).
+
+   bool isOk = true;
+
+   RandomFast rand( seed );
+   if( pOut )
+   {
+      *pOut << "\nseed= " << rand.getDword() << "\n";
+   }
+
+   // loop
+   for( dword i = 0;  i < 10;  ++i )
+   {
+      std::auto_ptr<Octree<OctreeItemTest> > po1;
+      std::vector<OctreeItemTest>            items;
+      makeRandomFilledOctree( rand, 30, po1, items );
+
+      if( (*pOut != 0) && isVerbose )
+      {
+         OctreeStreamOut<OctreeItemTest> so( *pOut, true );
+         po1->visit( so );
+         *pOut << "\n";
+      }
+
+      // make copy octree, and assigned unrelated octree
+      Octree<OctreeItemTest> o2( *po1 );
+      Octree<OctreeItemTest> o3( po1->getPosition(), po1->getSize(),
+         po1->getMaxItemCountPerCell(), po1->getMaxLevelCount(),
+         po1->getMinCellSize() );
+      o3 = *po1;
+      Octree<OctreeItemTest> o4( *po1, false );
+
+      {
+         // stream out each to string
+         std::ostringstream ss1;
+         OctreeStreamOut<OctreeItemTest> so1( ss1, false );
+         po1->visit( so1 );
+         std::ostringstream ss2;
+         OctreeStreamOut<OctreeItemTest> so2( ss2, false );
+         o2.visit( so2 );
+         std::ostringstream ss3;
+         OctreeStreamOut<OctreeItemTest> so3( ss3, false );
+         o3.visit( so3 );
+         std::ostringstream ss4;
+         OctreeStreamOut<OctreeItemTest> so4( ss4, false );
+         o4.visit( so4 );
+
+         // compare strings
+         isOk &= (ss1.str() == ss2.str()) && (ss1.str() == ss3.str()) &&
+            (ss1.str() == ss4.str());
+      }
+
+      {
+         // make arrays of octree object ids
+         OctreeVisitorTest v1( *po1 );
+         po1->visit( v1 );
+         OctreeVisitorTest v2( o2 );
+         o2.visit( v2 );
+         OctreeVisitorTest v3( o3 );
+         o3.visit( v3 );
+         OctreeVisitorTest v4( o4 );
+         o4.visit( v4 );
+
+         isOk &= (v1.getIds().size() == v2.getIds().size()) &&
+            (v1.getIds().size() == v3.getIds().size()) &&
+            (v1.getIds().size() == v4.getIds().size());
+
+         // check ids of copy are the same, but for the octree's own
+         isOk &= (v1.getIds()[0] != v2.getIds()[0]) &&
+            std::equal( v1.getIds().begin() + 1, v1.getIds().end(),
+               v2.getIds().begin() + 1 );
+
+         // check set intersection of ids of assigned, and of unshared copy,
+         // is empty
+         std::vector<const void*> ids1( v1.getIds() );
+         std::vector<const void*> ids3( v3.getIds() );
+         std::vector<const void*> ids4( v4.getIds() );
+         std::sort( ids1.begin(), ids1.end() );
+         std::sort( ids3.begin(), ids3.end() );
+         std::sort( ids4.begin(), ids4.end() );
+         std::vector<const void*> intersect;
+         std::set_intersection( ids1.begin(), ids1.end(),
+                           ids3.begin(), ids3.end(),
+                           std::back_inserter( intersect ) );
+         std::set_intersection( ids1.begin(), ids1.end(),
+                           ids4.begin(), ids4.end(),
+                           std::back_inserter( intersect ) );
+         isOk &= intersect.empty();
+      }
+
+      if( pOut )
+      {
+         *pOut << i << " " << isOk << "\n";
+      }
+   }
+
+   if( pOut )
+   {
+      *pOut << "\n--- testConstruction: " << isOk << "\n";
+   }
+
+   return isOk;
+}
+
+
+bool testCommands
+(
+   std::ostream* pOut,
+   const bool    isVerbose,
+   const dword   seed
+)
+{
+   return testCommands1( pOut, isVerbose, seed ) &&
+          testCommands2( pOut, isVerbose, seed ) &&
+          testCommands3( pOut, isVerbose, seed ) &&
+          testCommands4( pOut, isVerbose, seed ) &&
+          testCommands5( pOut, isVerbose, seed ) &&
+          testCommands6( pOut, isVerbose, seed ) &&
+          testCommands7( pOut, isVerbose, seed ) &&
+          testCommands8( pOut, isVerbose, seed ) &&
+          testCommands9( pOut, isVerbose, seed ) &&
+          testCommands10( pOut, isVerbose, seed ) &&
+          testCommands11( pOut, isVerbose, seed ) &&
+          testCommands12( pOut, isVerbose, seed ) &&
+          testCommands13( pOut, isVerbose, seed ) &&
+          testCommands14( pOut, isVerbose, seed ) &&
+          testCommands15( pOut, isVerbose, seed ) &&
+          testCommands16( pOut, isVerbose, seed ) &&
+          testCommands17( pOut, isVerbose, seed ) &&
+          testCommands18( pOut, isVerbose, seed ) &&
+          testCommands19( pOut, isVerbose, seed ) &&
+          testCommands20( pOut, isVerbose, seed ) &&
+          testCommands21( pOut, isVerbose, seed ) &&
+          testCommands22( pOut, isVerbose, seed ) &&
+          testCommands23( pOut, isVerbose, seed ) &&
+          testCommands24( pOut, isVerbose, seed ) &&
+          testCommands25( pOut, isVerbose, seed ) &&
+          testCommands26( pOut, isVerbose, seed ) &&
+          testCommands27( pOut, isVerbose, seed ) &&
+          testCommands28( pOut, isVerbose, seed ) &&
+          testCommands29( pOut, isVerbose, seed );
+}
+
+
+bool testCommands1
+(
+   std::ostream* pOut,
+   const bool    isVerbose,
+   const dword   //seed
+)
+{
+   // simple structural test:
+   //
+   // 1) make octree with four item per leaf limit
+   // 2) add an item in each octant
+   // 3) check each item is in the correct octant
+
+   bool isOk = true;
+
+   if( pOut )
+   {
+      *pOut << "\n\n";
+   }
+
+
+   // make octree
+   Octree<OctreeItemTest> o1( Vector3r::ZERO(), 2, 4, 4, 0.0001f );
+
+   // make items
+   std::vector<OctreeItemTest> i1(8);
+   OctreeAgentTest a;
+   for( dword i = 0;  i < 8;  ++i )
+   {
+      // add item in each octant
+      const Vector3r position( static_cast<real>(i & 1)        + 0.25f,
+                               static_cast<real>((i >> 1) & 1) + 0.25f,
+                               static_cast<real>((i >> 2) & 1) + 0.25f );
+      i1[i] = OctreeItemTest( position, Vector3r::HALF(), i );
+      o1.insert( i1[i], a );
+
+      if( pOut && isVerbose )
+      {
+         *pOut << "item " << i << " :  " << i1[i] << "\n";
+      }
+   }
+   if( pOut && isVerbose )
+   {
+      *pOut << "\n";
+   }
+
+   if( pOut && isVerbose )
+   {
+      OctreeStreamOut<OctreeItemTest> so( *pOut, true );
+      o1.visit( so );
+      *pOut << "\n";
+   }
+
+   // make info from octree
+   OctreeVisitorTest v1( o1 );
+   o1.visit( v1 );
+
+   // step through leafs
+   const std::vector<OctreeVisitorTest::LeafData>& leafs( v1.getLeafs() );
+   for( udword j = leafs.size();  j-- > 0; )
+   {
+      const OctreeVisitorTest::LeafData& leaf( leafs[j] );
+
+      const Vector3r& cellLower( leaf.first.getBound().getLowerCorner() );
+      const Vector3r& cellUpper( leaf.first.getBound().getUpperCorner() );
+
+      // step through items
+      const Array<const OctreeItemTest*>& items( leaf.second );
+      for( int i = 0;  i < items.getLength();  ++i )
+      {
+         const OctreeItemTest* pItem = items[i];
+
+         const Vector3r itemLower( pItem->getPosition() );
+         const Vector3r itemUpper( itemLower + pItem->getDimensions() );
+
+         // check item is overlapping its leaf cell
+         const bool is =
+            OctreeAgentTest::isOverlapping( itemLower, itemUpper,
+                                             cellLower, cellUpper );
+         isOk &= is;
+         if( pOut && isVerbose )
+         {
+            *pOut << "overlap " << is << " :  " <<
+                     itemLower << "  " << itemUpper << "  " <<
+                     cellLower << "  " << cellUpper << "\n";
+         }
+
+         // check item is in correct leaf cell
+         const dword octantIndex = pItem->getPayload();
+         const Vector3r octantLower( static_cast<real>(octantIndex & 1),
+                                    static_cast<real>((octantIndex >> 1) & 1),
+                                    static_cast<real>((octantIndex >> 2) & 1) );
+         const Vector3r octantUpper( octantLower + Vector3r::ONE() );
+         isOk &= (cellLower == octantLower);
+         isOk &= (cellUpper == octantUpper);
+
+         if( pOut )
+         {
+            if( isVerbose )
+            {
+               *pOut << "\toctant match " << (cellLower == octantLower) <<
+                        " :  " << cellLower << "  " << octantLower << "\n";
+               *pOut << "\toctant match " << (cellUpper == octantUpper) <<
+                        " :  " << cellUpper << "  " << octantUpper << "\n";
+            }
+            else
+            {
+               *pOut << isOk << "\n";
+            }
+         }
+      }
+   }
+
+   if( pOut )
+   {
+      *pOut << "\n--- testCommands1: " << isOk << "\n";
+   }
+
+   return isOk;
+}
+
+
+bool testCommands2
+(
+   std::ostream* pOut,
+   const bool    ,//isVerbose,
+   const dword   seed
+)
+{
+   // basic insert/remove test:
+   //
+   // insert a lot, visit to collect all items, check they are all there
+   // remove them all, get counts to check they all came out
+
+   bool isOk = true;
+
+
+   if( pOut )
+   {
+      *pOut << "\n\n";
+   }
+
+   RandomFast rand( seed );
+   if( pOut )
+   {
+      *pOut << "\nseed= " << rand.getDword() << "\n\n";
+   }
+
+   for( dword j = 0;  j < 10;  ++j )
+   {
+      // make octree with items
+      std::auto_ptr<Octree<OctreeItemTest> > po1;
+      std::vector<OctreeItemTest>            i1;
+      makeRandomFilledOctree( rand, 100, po1, i1 );
+
+//    // only for 10 or so items (otherwise > 14MB of output)
+//    if( pOut && isVerbose )
+//    {
+//       OctreeStreamOut<OctreeItemTest> so( *pOut, false );
+//       po1->visit( so );
+//       *pOut << "\n";
+//       for( udword i = 0;  i < i1.size();  ++i )
+//       {
+//          *pOut << i1[i] << "\n";
+//       }
+//    }
+
+      // collect leafs items
+      OctreeVisitorTest v1( *po1 );
+      po1->visit( v1 );
+
+      dword byteSize, leafCount, itemRefCount, maxDepth;
+      po1->getInfo( byteSize, leafCount, itemRefCount, maxDepth );
+
+      // check collection length equals info leaf count
+      isOk &= (v1.getLeafs().size() == static_cast<udword>(leafCount));
+
+      // compare items list to leafs collection
+      {
+         const std::vector<OctreeVisitorTest::LeafData>& leafs( v1.getLeafs() );
+
+         std::set<const void*> i2s;
+         for( udword k = 0;  k < leafs.size();  ++k )
+         {
+            const Array<const OctreeItemTest*>& items( leafs[k].second );
+            for( dword m = 0;  m < items.getLength();  ++m )
+            {
+               i2s.insert( items[m] );
+            }
+         }
+         std::set<const void*> i1s;
+         for( udword k = 0;  k < i1.size();  ++k )
+         {
+            i1s.insert( &(i1[k]) );
+         }
+
+         isOk &= (i1s == i2s);
+      }
+
+      // remove items
+      OctreeAgentTest a;
+      for( udword i = 0;  i < i1.size();  ++i )
+      {
+         po1->remove( i1[i], a );
+
+//       // only for 10 or so items (otherwise > 14MB of output)
+//       if( pOut && isVerbose )
+//       {
+//          OctreeStreamOut<OctreeItemTest> so( *pOut, false );
+//          po1->visit( so );
+//       }
+      }
+
+      // check octree info data is all 'zero'
+      //dword byteSize, leafCount, itemRefCount, maxDepth;
+      po1->getInfo( byteSize, leafCount, itemRefCount, maxDepth );
+      isOk &= (leafCount == 0);
+      isOk &= (itemRefCount == 0);
+      isOk &= (maxDepth == 0);
+      isOk &= po1->isEmpty();
+
+      if( pOut )
+      {
+         *pOut << j << " " << isOk << "\n";
+      }
+   }
+
+   if( pOut )
+   {
+      *pOut << "\n--- testCommands2: " << isOk << "\n";
+   }
+
+
+   return isOk;
+}
+
+
+bool testCommands3
+(
+   std::ostream* ,//pOut,
+   const bool    ,//isVerbose,
+   const dword   //seed
+)
+{
+   // Structural conformance postconditions:
+   //
+   // Randomly insert and remove many random points, one at a time.
+   // After each command, check structure of octree:
+   // * after insertion, the octree is (one of):
+   //    * same, or
+   //    * one leaf holding one more item, or
+   //    * one leaf has changed to a branch containing 1-8 leafs and 0-7 nils,
+   //      or
+   //    * one leaf has changed to 0-n levels of branchs of one subcell, and
+   //      either 2-8 leafs, or one leaf at max level
+   // * after removal, the octree is (one of):
+   //    * same, or
+   //    * one leaf holding one less item, or
+   //    * one leaf has changed to nil, or
+   //    * eight leafs have disappeared, and their direct parent branch has
+   //      changed to a leaf, or
+   //    * one leaf has disappeared, one of its parent branchs has changed to
+   //      nil, and any branchs between have disappeared
+
+   bool isOk = true;
+/*
+   if( pOut )
+   {
+      *pOut << "\n\n";
+   }
+
+   RandomFast rand( seed );
+   if( pOut )
+   {
+      *pOut << "\nseed= " << rand.getDword() << "\n\n";
+   }
+
+
+   if( pOut )
+   {
+      *pOut << "\n--- testCommands3: " << isOk << "\n";
+   }
+*/
+   return isOk;
+}
+
+
+bool testCommands4
+(
+   std::ostream* pOut,
+   const bool    ,//isVerbose,
+   const dword   seed
+)
+{
+   // Bulk insertion equivalence:
+   //
+   // Generate some random octrees and items. Insert the items one at a time
+   // into one; with insertRange into a copy of the empty octree (after
+   // inserting a first part one at a time, for some); and with insertRange on
+   // several threads into another copy. Check all have the same info, and the
+   // same leafs, holding the same items.
+
+   bool isOk = true;
+
+   if( pOut )
+   {
+      *pOut << "\n\n";
+   }
+
+   RandomFast rand( seed );
+   if( pOut )
+   {
+      *pOut << "\nseed= " << rand.getDword() << "\n\n";
+   }
+
+   OctreeAgentTest a;
+
+   // loop
+   for( dword i = 0;  i < 20;  ++i )
+   {
+      std::auto_ptr<Octree<OctreeItemTest> > po1;
+      makeRandomOctree( rand, po1 );
+      Octree<OctreeItemTest> o2( *po1 );
+      Octree<OctreeItemTest> o3( *po1 );
+
+      const dword itemCount = (i & 2) ? 3000 : 200;
+      std::vector<OctreeItemTest> items;
+      makeRandomItems( rand, itemCount, po1->getPosition(), po1->getSize(),
+         items );
+
+      // insert one at a time
+      for( dword j = 0;  j < itemCount;  ++j )
+      {
+         po1->insert( items[j], a );
+      }
+
+      // insert in bulk (after some first part)
+      const dword first = (i & 1) ? (rand.next().getUdword() % itemCount) : 0;
+      for( dword j = 0;  j < first;  ++j )
+      {
+         o2.insert( items[j], a );
+      }
+      isOk &= (o2.insertRange( &items[first], itemCount - first, a ) ==
+         (itemCount - first));
+
+      // insert in bulk, in parallel
+      isOk &= (o3.insertRange( &items[0], itemCount, a, 4 ) == itemCount);
+
+      isOk &= isSameLeafs( *po1, o2 ) && isSameLeafs( *po1, o3 );
+
+      if( pOut )
+      {
+         *pOut << i << " " << isOk << "\n";
+      }
+   }
+
+   if( pOut )
+   {
+      *pOut << "\n--- testCommands4: " << isOk << "\n";
+   }
+
+   return isOk;
+}
+
+
+bool testCommands5
+(
+   std::ostream* pOut,
+   const bool    ,//isVerbose,
+   const dword   seed
+)
+{
+   // Linear implementation equivalence:
+   //
+   // Generate some random octrees and items, and a linear octree of the same
+   // format for each. Into both: insert the items, some one at a time and the
+   // rest in bulk; remove a part of them one at a time; insert that part again
+   // in bulk. After each step, check both gave the same results, and have the
+   // same info (except byte size), and the same leafs, holding the same items.
+   // Then check a copy, and removal of all.
+
+   bool isOk = true;
+
+   if( pOut )
+   {
+      *pOut << "\n\n";
+   }
+
+   RandomFast rand( seed );
+   if( pOut )
+   {
+      *pOut << "\nseed= " << rand.getDword() << "\n\n";
+   }
+
+   OctreeAgentTest a;
+
+   // loop
+   for( dword i = 0;  i < 20;  ++i )
+   {
+      std::auto_ptr<Octree<OctreeItemTest> > po1;
+      makeRandomOctree( rand, po1 );
+      OctreeLinearTest o2( po1->getPosition(), po1->getSize(),
+         po1->getMaxItemCountPerCell(), po1->getMaxLevelCount(),
+         po1->getMinCellSize() );
+
+      const dword itemCount = (i & 2) ? 1000 : 200;
+      std::vector<OctreeItemTest> items;
+      makeRandomItems( rand, itemCount, po1->getPosition(), po1->getSize(),
+         items );
+
+      // insert some one at a time, the rest in bulk
+      const dword first = rand.next().getUdword() % itemCount;
+      for( dword j = 0;  j < first;  ++j )
+      {
+         isOk &= (po1->insert( items[j], a ) == o2.insert( items[j], a ));
+      }
+      isOk &= (po1->insertRange( &items[first], itemCount - first, a ) ==
+         o2.insertRange( &items[first], itemCount - first, a ));
+      isOk &= isSameLeafs( *po1, o2, false );
+
+      // remove a part one at a time (some twice)
+      const dword begin = rand.next().getUdword() % itemCount;
+      const dword end   = begin + (rand.next().getUdword() % (itemCount -
+         begin)) + 1;
+      for( dword j = begin;  j < end;  ++j )
+      {
+         isOk &= (po1->remove( items[j], a ) == o2.remove( items[j], a ));
+         if( 0 == (j & 7) )
+         {
+            isOk &= (po1->remove( items[j], a ) == o2.remove( items[j], a ));
+         }
+      }
+      isOk &= isSameLeafs( *po1, o2, false );
+
+      // insert that part again in bulk
+      isOk &= (po1->insertRange( &items[begin], end - begin, a ) ==
+         o2.insertRange( &items[begin], end - begin, a ));
+      isOk &= isSameLeafs( *po1, o2, false );
+
+      // copy
+      OctreeLinearTest o3( o2 );
+      isOk &= isSameLeafs( o2, o3, false );
+
+      // remove all, and assign back
+      for( dword j = itemCount;  j-- > 0; )
+      {
+         isOk &= (po1->remove( items[j], a ) == o2.remove( items[j], a ));
+      }
+      isOk &= po1->isEmpty() && o2.isEmpty();
+      o2 = o3;
+      isOk &= isSameLeafs( o2, o3, false );
+
+      if( pOut )
+      {
+         *pOut << i << " " << isOk << "\n";
+      }
+   }
+
+   if( pOut )
+   {
+      *pOut << "\n--- testCommands5: " << isOk << "\n";
+   }
+
+   return isOk;
+}
+
+
+bool testCommands6
+(
+   std::ostream* pOut,
+   const bool    ,//isVerbose,
+   const dword   seed
+)
+{
+   // Freezing equivalence:
+   //
+   // Generate some random filled octrees, and linear octrees of the same
+   // format and items, and freeze each. Check the frozen ones have the same
+   // info (except byte size), and the same leafs, holding the same items, as
+   // the originals, and their copies too. Query one for the leafs overlapping a
+   // random box, and check it finds the same items as visiting does.
+
+   bool isOk = true;
+
+   if( pOut )
+   {
+      *pOut << "\n\n";
+   }
+
+   RandomFast rand( seed );
+   if( pOut )
+   {
+      *pOut << "\nseed= " << rand.getDword() << "\n\n";
+   }
+
+   OctreeAgentTest a;
+
+   // loop
+   for( dword i = 0;  i < 20;  ++i )
+   {
+      std::auto_ptr<Octree<OctreeItemTest> > po1;
+      std::vector<OctreeItemTest>            items;
+      makeRandomFilledOctree( rand, (i & 2) ? 1000 : 100, po1, items );
+      OctreeLinearTest o2( po1->getPosition(), po1->getSize(),
+         po1->getMaxItemCountPerCell(), po1->getMaxLevelCount(),
+         po1->getMinCellSize() );
+      o2.insertRange( &items[0], items.size(), a );
+
+      // freeze each
+      OctreeFrozen<OctreeItemTest> f1;
+      isOk &= f1.isEmpty();
+      po1->freeze( f1 );
+      OctreeFrozen<OctreeItemTest> f2;
+      o2.freeze( f2 );
+      isOk &= isSameLeafs( *po1, f1, false ) && isSameLeafs( o2, f2, false );
+
+      // copy
+      const OctreeFrozen<OctreeItemTest> f3( f1 );
+      isOk &= isSameLeafs( f1, f3, false );
+
+      // query a box
+      real box[2][3];
+      for( int k = 3;  k-- > 0; )
+      {
+         const real p0 = rand.next().getFloat() * po1->getSize();
+         const real p1 = rand.next().getFloat() * po1->getSize();
+         box[0][k] = po1->getPosition()[k] + ((p0 < p1) ? p0 : p1);
+         box[1][k] = po1->getPosition()[k] + ((p0 < p1) ? p1 : p0);
+      }
+      const Vector3r lower( box[0][0], box[0][1], box[0][2] );
+      const Vector3r upper( box[1][0], box[1][1], box[1][2] );
+      OctreeQueryTest q( lower, upper );
+      f1.query( q );
+      std::vector<const OctreeItemTest*> found( q.getItems() );
+
+      // same by visiting
+      OctreeVisitorTest v( f1 );
+      f1.visit( v );
+      std::vector<const OctreeItemTest*> expected;
+      for( udword j = 0;  j < v.getLeafs().size();  ++j )
+      {
+         const OctreeVisitorTest::LeafData& leaf = v.getLeafs()[j];
+         if( OctreeAgentTest::isOverlapping( lower, upper,
+            leaf.first.getBound().getLowerCorner(),
+            leaf.first.getBound().getUpperCorner() ) )
+         {
+            expected.insert( expected.end(), leaf.second.getStorage(),
+               leaf.second.getStorage() + leaf.second.getLength() );
+         }
+      }
+
+      std::sort( found.begin(), found.end() );
+      std::sort( expected.begin(), expected.end() );
+      isOk &= (found == expected);
+
+      if( pOut )
+      {
+         *pOut << i << " " << isOk << "\n";
+      }
+   }
+
+   if( pOut )
+   {
+      *pOut << "\n--- testCommands6: " << isOk << "\n";
+   }
+
+   return isOk;
+}
+
+
+bool testCommands7
+(
+   std::ostream* pOut,
+   const bool    ,//isVerbose,
+   const dword   seed
+)
+{
+   // Static dispatch equivalence:
+   //
+   // Generate some random octrees and items, and a static octree of the same
+   // format for each. Into both: insert the items, some one at a time and the
+   // rest in bulk; remove a part of them one at a time; insert that part again
+   // one at a time. After each step, check both gave the same results, and
+   // have the same info, and the same leafs, holding the same items. Query the
+   // static one for the leafs overlapping a random box, and check it finds the
+   // same items as its frozen copy does. Then check removal of all.
+
+   bool isOk = true;
+
+   if( pOut )
+   {
+      *pOut << "\n\n";
+   }
+
+   RandomFast rand( seed );
+   if( pOut )
+   {
+      *pOut << "\nseed= " << rand.getDword() << "\n\n";
+   }
+
+   OctreeAgentTest       a;
+   OctreeAgentStaticTest s;
+
+   // (an instrumented Octree holds its counts too, so is bigger)
+#ifdef OCTREE_INSTRUMENTED
+   const bool isSameByteSize = false;
+#else
+   const bool isSameByteSize = true;
+#endif
+
+   // loop
+   for( dword i = 0;  i < 20;  ++i )
+   {
+      std::auto_ptr<Octree<OctreeItemTest> > po1;
+      makeRandomOctree( rand, po1 );
+      OctreeStaticTest o2( po1->getPosition(), po1->getSize(),
+         po1->getMaxItemCountPerCell(), po1->getMaxLevelCount(),
+         po1->getMinCellSize() );
+
+      const dword itemCount = (i & 2) ? 1000 : 200;
+      std::vector<OctreeItemTest> items;
+      makeRandomItems( rand, itemCount, po1->getPosition(), po1->getSize(),
+         items );
+
+      // insert some one at a time, the rest in bulk
+      const dword first = rand.next().getUdword() % itemCount;
+      for( dword j = 0;  j < first;  ++j )
+      {
+         isOk &= (po1->insert( items[j], a ) == o2.insert( items[j], s ));
+      }
+      isOk &= (po1->insertRange( &items[first], itemCount - first, a ) ==
+         o2.insertRange( &items[first], itemCount - first, s ));
+      isOk &= isSameLeafs( *po1, o2, isSameByteSize );
+
+      // remove a part one at a time (some twice)
+      const dword begin = rand.next().getUdword() % itemCount;
+      const dword end   = begin + (rand.next().getUdword() % (itemCount -
+         begin)) + 1;
+      for( dword j = begin;  j < end;  ++j )
+      {
+         isOk &= (po1->remove( items[j], a ) == o2.remove( items[j], s ));
+         if( 0 == (j & 7) )
+         {
+            isOk &= (po1->remove( items[j], a ) == o2.remove( items[j], s ));
+         }
+      }
+      isOk &= isSameLeafs( *po1, o2, isSameByteSize );
+
+      // insert that part again one at a time
+      for( dword j = begin;  j < end;  ++j )
+      {
+         isOk &= (po1->insert( items[j], a ) == o2.insert( items[j], s ));
+      }
+      isOk &= isSameLeafs( *po1, o2, isSameByteSize );
+
+      // query a box, directly and frozen
+      real box[2][3];
+      for( int k = 3;  k-- > 0; )
+      {
+         const real p0 = rand.next().getFloat() * po1->getSize();
+         const real p1 = rand.next().getFloat() * po1->getSize();
+         box[0][k] = po1->getPosition()[k] + ((p0 < p1) ? p0 : p1);
+         box[1][k] = po1->getPosition()[k] + ((p0 < p1) ? p1 : p0);
+      }
+      const Vector3r lower( box[0][0], box[0][1], box[0][2] );
+      const Vector3r upper( box[1][0], box[1][1], box[1][2] );
+      OctreeQueryTest q1( lower, upper );
+      o2.query( q1 );
+      OctreeFrozen<OctreeItemTest> f;
+      o2.freeze( f );
+      OctreeQueryTest q2( lower, upper );
+      f.query( q2 );
+      isOk &= (q1.getItems() == q2.getItems());
+
+      // remove all
+      for( dword j = itemCount;  j-- > 0; )
+      {
+         isOk &= (po1->remove( items[j], a ) == o2.remove( items[j], s ));
+      }
+      isOk &= po1->isEmpty() && o2.isEmpty();
+
+      if( pOut )
+      {
+         *pOut << i << " " << isOk << "\n";
+      }
+   }
+
+   if( pOut )
+   {
+      *pOut << "\n--- testCommands7: " << isOk << "\n";
+   }
+
+   return isOk;
+}
+
+
+bool testCommands8
+(
+   std::ostream* pOut,
+   const bool    ,//isVerbose,
+   const dword   seed
+)
+{
+   // Box range query:
+   //
+   // Generate some random filled octrees, and linear, frozen, and static
+   // octrees of the same format and items. Query each for the items
+   // overlapping a random box (sometimes the whole root), into one reused
+   // array, and check each finds the same items, once each, as visiting and
+   // testing every item in the leafs overlapping the box does.
+
+   bool isOk = true;
+
+   if( pOut )
+   {
+      *pOut << "\n\n";
+   }
+
+   RandomFast rand( seed );
+   if( pOut )
+   {
+      *pOut << "\nseed= " << rand.getDword() << "\n\n";
+   }
+
+   OctreeAgentTest       a;
+   OctreeAgentStaticTest s;
+
+   Array<const OctreeItemTest*> found;
+
+   // loop
+   for( dword i = 0;  i < 20;  ++i )
+   {
+      std::auto_ptr<Octree<OctreeItemTest> > po1;
+      std::vector<OctreeItemTest>            items;
+      makeRandomFilledOctree( rand, (i & 2) ? 1000 : 100, po1, items );
+      OctreeLinearTest o2( po1->getPosition(), po1->getSize(),
+         po1->getMaxItemCountPerCell(), po1->getMaxLevelCount(),
+         po1->getMinCellSize() );
+      o2.insertRange( &items[0], items.size(), a );
+      OctreeFrozen<OctreeItemTest> f3;
+      po1->freeze( f3 );
+      OctreeStaticTest o4( po1->getPosition(), po1->getSize(),
+         po1->getMaxItemCountPerCell(), po1->getMaxLevelCount(),
+         po1->getMinCellSize() );
+      o4.insertRange( &items[0], items.size(), s );
+
+      // make a box (sometimes the whole root)
+      real box[2][3];
+      for( int k = 3;  k-- > 0; )
+      {
+         const real p0 = (i % 3) ? rand.next().getFloat() * po1->getSize() :
+            -1.0f;
+         const real p1 = (i % 3) ? rand.next().getFloat() * po1->getSize() :
+            po1->getSize() + 1.0f;
+         box[0][k] = po1->getPosition()[k] + ((p0 < p1) ? p0 : p1);
+         box[1][k] = po1->getPosition()[k] + ((p0 < p1) ? p1 : p0);
+      }
+      const Vector3r lower( box[0][0], box[0][1], box[0][2] );
+      const Vector3r upper( box[1][0], box[1][1], box[1][2] );
+
+      // expected, by visiting
+      OctreeVisitorTest v( *po1 );
+      po1->visit( v );
+      std::vector<const OctreeItemTest*> expected;
+      for( udword j = 0;  j < v.getLeafs().size();  ++j )
+      {
+         const OctreeVisitorTest::LeafData& leaf = v.getLeafs()[j];
+         if( OctreeAgentTest::isOverlapping( lower, upper,
+            leaf.first.getBound().getLowerCorner(),
+            leaf.first.getBound().getUpperCorner() ) )
+         {
+            for( dword k = 0;  k < leaf.second.getLength();  ++k )
+            {
+               const OctreeItemTest* pItem = leaf.second[k];
+               if( OctreeAgentTest::isOverlapping( pItem->getPosition(),
+                  pItem->getPosition() + pItem->getDimensions(), lower,
+                  upper ) )
+               {
+                  expected.push_back( pItem );
+               }
+            }
+         }
+      }
+      std::sort( expected.begin(), expected.end() );
+      expected.erase( std::unique( expected.begin(), expected.end() ),
+         expected.end() );
+
+      // query each
+      for( dword j = 0;  j < 4;  ++j )
+      {
+         if( 0 == j )
+         {
+            po1->queryBox( lower, upper, a, found );
+         }
+         else if( 1 == j )
+         {
+            o2.queryBox( lower, upper, a, found );
+         }
+         else if( 2 == j )
+         {
+            f3.queryBox( lower, upper, a, found );
+         }
+         else
+         {
+            o4.queryBox( lower, upper, s, found );
+         }
+
+         isOk &= (found.getLength() == static_cast<dword>(expected.size())) &&
+            std::equal( expected.begin(), expected.end(),
+            found.getStorage() );
+      }
+
+      if( pOut )
+      {
+         *pOut << i << " " << isOk << "\n";
+      }
+   }
+
+   if( pOut )
+   {
+      *pOut << "\n--- testCommands8: " << isOk << "\n";
+   }
+
+   return isOk;
+}
+
+
+bool testCommands9
+(
+   std::ostream* pOut,
+   const bool    ,//isVerbose,
+   const dword   seed
+)
+{
+   // Nearest neighbours query:
+   //
+   // Generate some random filled octrees, and linear, frozen, and static
+   // octrees of the same format and items. Query each for the k nearest items
+   // to a random point in the root, within a max distance (sometimes
+   // unlimited), and check each finds, nearest first, the same distances as
+   // a brute-force scan of all the items in the leafs does, for distinct
+   // items at those distances.
+
+   bool isOk = true;
+
+   if( pOut )
+   {
+      *pOut << "\n\n";
+   }
+
+   RandomFast rand( seed );
+   if( pOut )
+   {
+      *pOut << "\nseed= " << rand.getDword() << "\n\n";
+   }
+
+   OctreeAgentTest       a;
+   OctreeAgentStaticTest s;
+
+   Array<const OctreeItemTest*> found;
+   Array<real>                  distances;
+
+   // loop
+   for( dword i = 0;  i < 20;  ++i )
+   {
+      std::auto_ptr<Octree<OctreeItemTest> > po1;
+      std::vector<OctreeItemTest>            items;
+      makeRandomFilledOctree( rand, (i & 2) ? 1000 : 100, po1, items );
+      OctreeLinearTest o2( po1->getPosition(), po1->getSize(),
+         po1->getMaxItemCountPerCell(), po1->getMaxLevelCount(),
+         po1->getMinCellSize() );
+      o2.insertRange( &items[0], items.size(), a );
+      OctreeFrozen<OctreeItemTest> f3;
+      po1->freeze( f3 );
+      OctreeStaticTest o4( po1->getPosition(), po1->getSize(),
+         po1->getMaxItemCountPerCell(), po1->getMaxLevelCount(),
+         po1->getMinCellSize() );
+      o4.insertRange( &items[0], items.size(), s );
+
+      // make a point in the root, a count (sometimes more than the items),
+      // and a max distance (sometimes unlimited)
+      const Vector3r point( po1->getPosition() + Vector3r(
+         rand.next().getFloat(), rand.next().getFloat(),
+         rand.next().getFloat() ) * po1->getSize() );
+      const dword k = (i % 5) ? (rand.next().getUdword() >> 28) + 1 : 2000;
+      const real  maxDistance = (i % 3) ? rand.next().getFloat() *
+         po1->getSize() * 0.5f : REAL_MAX;
+
+      // expected, by brute force over the items in the leafs
+      OctreeVisitorTest v( *po1 );
+      po1->visit( v );
+      std::vector<const OctreeItemTest*> inTree;
+      for( udword j = 0;  j < v.getLeafs().size();  ++j )
+      {
+         const OctreeVisitorTest::LeafData& leaf = v.getLeafs()[j];
+         for( dword m = 0;  m < leaf.second.getLength();  ++m )
+         {
+            inTree.push_back( leaf.second[m] );
+         }
+      }
+      std::sort( inTree.begin(), inTree.end() );
+      inTree.erase( std::unique( inTree.begin(), inTree.end() ),
+         inTree.end() );
+      std::vector<real> expected;
+      for( udword j = 0;  j < inTree.size();  ++j )
+      {
+         const real distance = a.getDistanceV( inTree[j], point );
+         if( distance <= maxDistance )
+         {
+            expected.push_back( distance );
+         }
+      }
+      std::sort( expected.begin(), expected.end() );
+      if( expected.size() > static_cast<udword>(k) )
+      {
+         expected.resize( k );
+      }
+
+      // query each
+      for( dword j = 0;  j < 4;  ++j )
+      {
+         if( 0 == j )
+         {
+            po1->queryNearest( point, k, maxDistance, a, found, distances );
+         }
+         else if( 1 == j )
+         {
+            o2.queryNearest( point, k, maxDistance, a, found, distances );
+         }
+         else if( 2 == j )
+         {
+            f3.queryNearest( point, k, maxDistance, a, found, distances );
+         }
+         else
+         {
+            o4.queryNearest( point, k, maxDistance, s, found, distances );
+         }
+
+         isOk &= (found.getLength() == static_cast<dword>(expected.size())) &&
+            (distances.getLength() == found.getLength()) &&
+            std::equal( expected.begin(), expected.end(),
+            distances.getStorage() );
+
+         // each is a distinct item, at its distance
+         std::set<const OctreeItemTest*> distinct;
+         for( dword m = 0;  m < found.getLength();  ++m )
+         {
+            distinct.insert( found[m] );
+            isOk &= (a.getDistanceV( found[m], point ) == distances[m]);
+         }
+         isOk &= (static_cast<dword>(distinct.size()) == found.getLength());
+      }
+
+      if( pOut )
+      {
+         *pOut << i << " " << isOk << "\n";
+      }
+   }
+
+   if( pOut )
+   {
+      *pOut << "\n--- testCommands9: " << isOk << "\n";
+   }
+
+   return isOk;
+}
+
+
+bool testCommands10
+(
+   std::ostream* pOut,
+   const bool    ,//isVerbose,
+   const dword   seed
+)
+{
+   // Ray query:
+   //
+   // Generate some random octrees, filled with random blocks, and linear,
+   // frozen, and static octrees of the same format and items. Query each for
+   // the first item hit by random rays (from inside and outside the root,
+   // some along an axis), within a max t (sometimes unlimited), and check
+   // each finds the same nearest hit as testing every item in the leafs does.
+   // Check a direct query of each, in the ray's subcell order, enters the
+   // leafs the ray crosses front-to-back, and the same number as in plain
+   // order.
+
+   bool isOk = true;
+
+   if( pOut )
+   {
+      *pOut << "\n\n";
+   }
+
+   RandomFast rand( seed );
+   if( pOut )
+   {
+      *pOut << "\nseed= " << rand.getDword() << "\n\n";
+   }
+
+   OctreeAgentTest       a;
+   OctreeAgentStaticTest s;
+
+   // loop
+   for( dword i = 0;  i < 20;  ++i )
+   {
+      std::auto_ptr<Octree<OctreeItemTest> > po1;
+      makeRandomOctree( rand, po1 );
+      const real size = po1->getSize();
+
+      // make blocks (within the root)
+      std::vector<OctreeItemTest> items( (i & 2) ? 1000 : 100 );
+      for( udword j = 0;  j < items.size();  ++j )
+      {
+         const Vector3r position( rand.next().getFloat(),
+            rand.next().getFloat(), rand.next().getFloat() );
+         const Vector3r dimensions( rand.next().getFloat(),
+            rand.next().getFloat(), rand.next().getFloat() );
+         items[j] = OctreeItemTest( po1->getPosition() +
+            (position * (size * 0.95f)), dimensions * (size * 0.05f) );
+      }
+
+      po1->insertRange( &items[0], items.size(), a );
+      OctreeLinearTest o2( po1->getPosition(), size,
+         po1->getMaxItemCountPerCell(), po1->getMaxLevelCount(),
+         po1->getMinCellSize() );
+      o2.insertRange( &items[0], items.size(), a );
+      OctreeFrozen<OctreeItemTest> f3;
+      po1->freeze( f3 );
+      OctreeStaticTest o4( po1->getPosition(), size,
+         po1->getMaxItemCountPerCell(), po1->getMaxLevelCount(),
+         po1->getMinCellSize() );
+      o4.insertRange( &items[0], items.size(), s );
+
+      // the items in the leafs
+      OctreeVisitorTest v( *po1 );
+      po1->visit( v );
+      std::vector<const OctreeItemTest*> inTree;
+      for( udword j = 0;  j < v.getLeafs().size();  ++j )
+      {
+         const OctreeVisitorTest::LeafData& leaf = v.getLeafs()[j];
+         for( dword m = 0;  m < leaf.second.getLength();  ++m )
+         {
+            inTree.push_back( leaf.second[m] );
+         }
+      }
+
+      for( dword j = 0;  j < 10;  ++j )
+      {
+         // make a ray (from a point within twice the root's bound, in a
+         // random direction, or along an axis), and a max t
+         const Vector3r origin( po1->getPosition() + (Vector3r(
+            rand.next().getFloat(), rand.next().getFloat(),
+            rand.next().getFloat() ) * (size * 2.0f)) -
+            (Vector3r::ONE() * (size * 0.5f)) );
+         Vector3r direction( rand.next().getFloat( 2.0f, -1.0f ),
+            rand.next().getFloat( 2.0f, -1.0f ),
+            rand.next().getFloat( 2.0f, -1.0f ) );
+         if( (0 == (j % 4)) || (direction.length() < 0.01f) )
+         {
+            const real d = (j & 8) ? -1.0f : 1.0f;
+            const dword axis = j % 3;
+            direction = Vector3r( (0 == axis) ? d : 0.0f,
+               (1 == axis) ? d : 0.0f, (2 == axis) ? d : 0.0f );
+         }
+         direction = direction / direction.length();
+         const real maxT = (j % 3) ? rand.next().getFloat() * size * 2.0f :
+            REAL_MAX;
+
+         // expected, by testing every item
+         real expected = maxT;
+         for( udword k = 0;  k < inTree.size();  ++k )
+         {
+            const real t = a.getRayIntersectionV( inTree[k], origin,
+               direction );
+            expected = (t < expected) ? t : expected;
+         }
+
+         // query each
+         for( dword k = 0;  k < 4;  ++k )
+         {
+            real                  hitT  = 0.0f;
+            const OctreeItemTest* pItem = 0;
+            if( 0 == k )
+            {
+               pItem = po1->queryRay( origin, direction, maxT, a, hitT );
+            }
+            else if( 1 == k )
+            {
+               pItem = o2.queryRay( origin, direction, maxT, a, hitT );
+            }
+            else if( 2 == k )
+            {
+               pItem = f3.queryRay( origin, direction, maxT, a, hitT );
+            }
+            else
+            {
+               pItem = o4.queryRay( origin, direction, maxT, s, hitT );
+            }
+
+            isOk &= (hitT == expected) && ((0 == pItem) == (maxT == hitT)) &&
+               (!pItem || (a.getRayIntersectionV( pItem, origin,
+               direction ) == hitT));
+         }
+
+         // order of leafs entered
+         OctreeQueryRayTest q0( origin, direction );
+         po1->query( q0 );
+         for( dword k = 0;  k < 4;  ++k )
+         {
+            OctreeQueryRayTest q( origin, direction );
+            if( 0 == k )
+            {
+               po1->query( q, q.getSubcellOrder() );
+            }
+            else if( 1 == k )
+            {
+               o2.query( q, q.getSubcellOrder() );
+            }
+            else if( 2 == k )
+            {
+               f3.query( q, q.getSubcellOrder() );
+            }
+            else
+            {
+               o4.query( q, q.getSubcellOrder() );
+            }
+
+            isOk &= q.isFrontToBack( size * 1e-4f ) &&
+               (q.getLeafCount() == q0.getLeafCount());
+         }
+      }
+
+      if( pOut )
+      {
+         *pOut << i << " " << isOk << "\n";
+      }
+   }
+
+   if( pOut )
+   {
+      *pOut << "\n--- testCommands10: " << isOk << "\n";
+   }
+
+   return isOk;
+}
+
+
+bool testCommands11
+(
+   std::ostream* pOut,
+   const bool    ,//isVerbose,
+   const dword   seed
+)
+{
+   // Ray and box packet queries:
+   //
+   // Generate some random octrees, filled with random blocks, and linear,
+   // frozen, and static octrees of the same format and items. Query each with
+   // arrays of random rays (some coherent, some not, some along an axis, some
+   // packets with every other ray reversed), and of random boxes, of lengths
+   // within, of, and beyond one packet, and check each ray's hit and each
+   // box's items are the same as single queries give. Check a packet's subcell
+   // order follows the direction signs most of its rays share.
+
+   bool isOk = true;
+
+   if( pOut )
+   {
+      *pOut << "\n\n";
+   }
+
+   RandomFast rand( seed );
+   if( pOut )
+   {
+      *pOut << "\nseed= " << rand.getDword() << "\n\n";
+   }
+
+   OctreeAgentTest       a;
+   OctreeAgentStaticTest s;
+
+   Array<const OctreeItemTest*> found;
+
+   // subcell order: the first ray outvoted on x and z, agreeing on y
+   {
+      const Vector3r origins[3];
+      const Vector3r directions[3] = { Vector3r( 1.0f, -1.0f, 1.0f ),
+         Vector3r( -1.0f, -1.0f, -1.0f ), Vector3r( -1.0f, 1.0f, -1.0f ) };
+      OctreeQueryRayPacketV<OctreeItemTest,OctreeAgentV> q3( origins,
+         directions, 3, REAL_MAX, a );
+      OctreeQueryRayPacketV<OctreeItemTest,OctreeAgentV> q1( origins,
+         directions, 1, REAL_MAX, a );
+      isOk &= (7 == q3.getSubcellOrder()) && (2 == q1.getSubcellOrder());
+   }
+
+   // loop
+   for( dword i = 0;  i < 20;  ++i )
+   {
+      std::auto_ptr<Octree<OctreeItemTest> > po1;
+      std::vector<OctreeItemTest>            items;
+      makeRandomFilledOctree( rand, (i & 2) ? 1000 : 100, po1, items );
+      const real size = po1->getSize();
+      OctreeLinearTest o2( po1->getPosition(), size,
+         po1->getMaxItemCountPerCell(), po1->getMaxLevelCount(),
+         po1->getMinCellSize() );
+      o2.insertRange( &items[0], items.size(), a );
+      OctreeFrozen<OctreeItemTest> f3;
+      po1->freeze( f3 );
+      OctreeStaticTest o4( po1->getPosition(), size,
+         po1->getMaxItemCountPerCell(), po1->getMaxLevelCount(),
+         po1->getMinCellSize() );
+      o4.insertRange( &items[0], items.size(), s );
+
+      const dword count = (0 == (i % 3)) ? 1 : ((1 == (i % 3)) ? 32 : 77);
+
+      // make rays (from near one point and in near one direction, or not)
+      std::vector<Vector3r> origins( count );
+      std::vector<Vector3r> directions( count );
+      const real spread = (i & 1) ? 0.05f : 1.0f;
+      const Vector3r origin( po1->getPosition() + (Vector3r(
+         rand.next().getFloat(), rand.next().getFloat(),
+         rand.next().getFloat() ) * (size * 2.0f)) -
+         (Vector3r::ONE() * (size * 0.5f)) );
+      const Vector3r toward( po1->getPosition() + (Vector3r::ONE() *
+         (size * 0.5f)) - origin );
+      for( dword j = 0;  j < count;  ++j )
+      {
+         origins[j] = origin + (Vector3r( rand.next().getFloat(),
+            rand.next().getFloat(), rand.next().getFloat() ) *
+            (size * spread));
+         Vector3r direction( toward + (Vector3r(
+            rand.next().getFloat( 2.0f, -1.0f ),
+            rand.next().getFloat( 2.0f, -1.0f ),
+            rand.next().getFloat( 2.0f, -1.0f ) ) * (size * spread)) );
+         if( (0 == (j % 5)) || (direction.length() < 0.01f) )
+         {
+            const dword axis = j % 3;
+            direction = Vector3r( (0 == axis) ? 1.0f : 0.0f,
+               (1 == axis) ? 1.0f : 0.0f, (2 == axis) ? 1.0f : 0.0f );
+         }
+         if( (i & 8) && (j & 1) )
+         {
+            direction = Vector3r::ZERO() - direction;
+         }
+         directions[j] = direction / direction.length();
+      }
+      const real maxT = (i & 4) ? size * 2.0f : REAL_MAX;
+
+      // query each, and compare with single queries
+      std::vector<const OctreeItemTest*> hitItems( count );
+      std::vector<real>                  hitTs( count );
+      for( dword k = 0;  k < 4;  ++k )
+      {
+         if( 0 == k )
+         {
+            po1->queryRays( count, &origins[0], &directions[0], maxT, a,
+               &hitItems[0], &hitTs[0] );
+         }
+         else if( 1 == k )
+         {
+            o2.queryRays( count, &origins[0], &directions[0], maxT, a,
+               &hitItems[0], &hitTs[0] );
+         }
+         else if( 2 == k )
+         {
+            f3.queryRays( count, &origins[0], &directions[0], maxT, a,
+               &hitItems[0], &hitTs[0] );
+         }
+         else
+         {
+            o4.queryRays( count, &origins[0], &directions[0], maxT, s,
+               &hitItems[0], &hitTs[0] );
+         }
+
+         for( dword j = 0;  j < count;  ++j )
+         {
+            real hitT = 0.0f;
+            po1->queryRay( origins[j], directions[j], maxT, a, hitT );
+            isOk &= (hitTs[j] == hitT) && ((0 == hitItems[j]) ==
+               (maxT == hitT)) && (!hitItems[j] || (a.getRayIntersectionV(
+               hitItems[j], origins[j], directions[j] ) == hitT));
+         }
+      }
+
+      // make boxes (sometimes the whole root)
+      std::vector<Vector3r> lowers( count );
+      std::vector<Vector3r> uppers( count );
+      for( dword j = 0;  j < count;  ++j )
+      {
+         real box[2][3];
+         for( int k = 3;  k-- > 0; )
+         {
+            const real p0 = (j % 7) ? rand.next().getFloat() * size : -1.0f;
+            const real p1 = (j % 7) ? rand.next().getFloat() * size :
+               size + 1.0f;
+            box[0][k] = po1->getPosition()[k] + ((p0 < p1) ? p0 : p1);
+            box[1][k] = po1->getPosition()[k] + ((p0 < p1) ? p1 : p0);
+         }
+         lowers[j] = Vector3r( box[0][0], box[0][1], box[0][2] );
+         uppers[j] = Vector3r( box[1][0], box[1][1], box[1][2] );
+      }
+
+      // query each, and compare with single queries
+      std::vector<Array<const OctreeItemTest*> > foundAll( count );
+      for( dword k = 0;  k < 4;  ++k )
+      {
+         if( 0 == k )
+         {
+            po1->queryBoxes( count, &lowers[0], &uppers[0], a, &foundAll[0] );
+         }
+         else if( 1 == k )
+         {
+            o2.queryBoxes( count, &lowers[0], &uppers[0], a, &foundAll[0] );
+         }
+         else if( 2 == k )
+         {
+            f3.queryBoxes( count, &lowers[0], &uppers[0], a, &foundAll[0] );
+         }
+         else
+         {
+            o4.queryBoxes( count, &lowers[0], &uppers[0], s, &foundAll[0] );
+         }
+
+         for( dword j = 0;  j < count;  ++j )
+         {
+            po1->queryBox( lowers[j], uppers[j], a, found );
+            isOk &= (foundAll[j].getLength() == found.getLength()) &&
+               std::equal( found.getStorage(), found.getStorage() +
+               found.getLength(), foundAll[j].getStorage() );
+         }
+      }
+
+      if( pOut )
+      {
+         *pOut << i << " " << isOk << "\n";
+      }
+   }
+
+   if( pOut )
+   {
+      *pOut << "\n--- testCommands11: " << isOk << "\n";
+   }
+
+   return isOk;
+}
+
+
+bool testCommands12
+(
+   std::ostream* pOut,
+   const bool    ,//isVerbose,
+   const dword   seed
+)
+{
+   // Stock agents:
+   //
+   // For each shape (point, box, sphere): check the stock agent's subcell
+   // overlaps for random items and cells (some items on a cell's faces or
+   // middle, some of zero size) are the same as single-cell overlap tests of
+   // each subcell, and (if built with them) the SSE kernels give the same as
+   // the scalar ones. Then fill an Octree with the virtual agent, and an
+   // OctreeStatic with the static agent, with random items, and check box,
+   // nearest, and ray queries of each find the same as testing every item.
+
+   bool isOk = true;
+
+   if( pOut )
+   {
+      *pOut << "\n\n";
+   }
+
+   RandomFast rand( seed );
+   if( pOut )
+   {
+      *pOut << "\nseed= " << rand.getDword() << "\n\n";
+   }
+
+   // loop
+   for( dword i = 0;  i < 20;  ++i )
+   {
+      isOk &= testStockAgent<OctreeAgentStaticPoint<OctreeShapeItemTest>,
+         OctreeAgentPoint<OctreeShapeItemTest> >( rand, i );
+      isOk &= testStockAgent<OctreeAgentStaticBox<OctreeShapeItemTest>,
+         OctreeAgentBox<OctreeShapeItemTest> >( rand, i );
+      isOk &= testStockAgent<OctreeAgentStaticSphere<OctreeShapeItemTest>,
+         OctreeAgentSphere<OctreeShapeItemTest> >( rand, i );
+
+      if( pOut )
+      {
+         *pOut << i << " " << isOk << "\n";
+      }
+   }
+
+   if( pOut )
+   {
+      *pOut << "\n--- testCommands12: " << isOk << "\n";
+   }
+
+   return isOk;
+}
+
+
+bool testCommands13
+(
+   std::ostream* pOut,
+   const bool    ,//isVerbose,
+   const dword   seed
+)
+{
+   // Stock triangle agent:
+   //
+   // Check the stock triangle agent's subcell overlaps for random triangles
+   // and cells (some vertexs on a cell's faces or middle, some triangles
+   // degenerate) are the same as single-cell overlap tests of each subcell,
+   // and (if built with it) the SSE kernel gives the same as the scalar one
+   // (under fast-math, only where no vertex is exactly on a subcell plane).
+   // Check single-cell overlaps against some plain facts: a triangle with a
+   // point (sampled across it) in the cell overlaps it; one whose bound, or
+   // plane, is clear of the cell does not. Then fill an Octree with the
+   // virtual agent, and an OctreeStatic with the static agent, with random
+   // triangles, and check box, nearest, and ray queries of each find the same
+   // as testing every triangle.
+
+   bool isOk = true;
+
+   if( pOut )
+   {
+      *pOut << "\n\n";
+   }
+
+   RandomFast rand( seed );
+   if( pOut )
+   {
+      *pOut << "\nseed= " << rand.getDword() << "\n\n";
+   }
+
+   const OctreeAgentStaticTriangle<OctreeTriangleItemTest> s;
+   const OctreeAgentTriangle<OctreeTriangleItemTest>       a;
+
+   // loop
+   for( dword i = 0;  i < 20;  ++i )
+   {
+      // overlaps
+      for( dword j = 0;  j < 500;  ++j )
+      {
+         const real size = rand.next().getFloat( 4.0f, 0.01f );
+         const Vector3r lower( Vector3r( rand.next().getFloat(),
+            rand.next().getFloat(), rand.next().getFloat() ) * 4.0f -
+            (Vector3r::ONE() * 2.0f) );
+         const Vector3r middle( lower + (Vector3r::ONE() * (size * 0.5f)) );
+         const Vector3r upper ( lower + (Vector3r::ONE() * size) );
+         const Vector3r* bounds[] = { &lower, &middle, &upper };
+
+         // vertexs (some coordinates on a lower, middle, or upper plane, some
+         // the same as another vertex's)
+         Vector3r vertexs[3];
+         bool     isOnPlane = false;
+         for( dword v = 0;  v < 3;  ++v )
+         {
+            real coords[3];
+            for( int k = 3;  k-- > 0; )
+            {
+               const dword plane = rand.next().getUdword() % ((j & 1) ? 12 : 1);
+               isOnPlane |= (plane < 3);
+               coords[k] = (plane < 3) ? (*bounds[plane])[k] : lower[k] +
+                  rand.next().getFloat( size * 2.0f, size * -0.5f );
+            }
+            vertexs[v] = Vector3r( coords[0], coords[1], coords[2] );
+         }
+         if( 0 == (j % 16) )
+         {
+            vertexs[2] = vertexs[(j >> 4) & 1];
+         }
+         const OctreeTriangleItemTest item( vertexs[0], vertexs[1],
+            vertexs[2] );
+
+         // subcell overlaps, against single-cell overlaps
+         dword expected = 0;
+         for( dword m = 8;  m-- > 0; )
+         {
+            const Vector3r subLower( bounds[m & 1]->getX(),
+               bounds[(m >> 1) & 1]->getY(), bounds[(m >> 2) & 1]->getZ() );
+            const Vector3r subUpper( bounds[(m & 1) + 1]->getX(),
+               bounds[((m >> 1) & 1) + 1]->getY(),
+               bounds[((m >> 2) & 1) + 1]->getZ() );
+            expected |= static_cast<dword>(s.isOverlappingCell( item,
+               subLower, subUpper )) << m;
+         }
+         isOk &= (s.getSubcellOverlaps( item, lower, middle, upper ) ==
+            expected) && (a.getSubcellOverlapsV( &item, lower, middle,
+            upper ) == expected);
+
+#ifdef OCTREE_SSE
+         // the SSE kernel, against the scalar one (fast-math may regroup
+         // either kernel's sums, so exact ties -- a vertex on a subcell
+         // plane -- can fall either way: then only on subcells the triangle
+         // just touches, within a ten-thousandth of the cell size)
+         const dword differ = OctreeShape::getSubcellOverlapsTriangleSse(
+            vertexs[0], vertexs[1], vertexs[2], lower, middle, upper ) ^
+            OctreeShape::getSubcellOverlapsTriangleScalar( vertexs[0],
+            vertexs[1], vertexs[2], lower, middle, upper );
+#ifdef __FAST_MATH__
+         const Vector3r tie( Vector3r::ONE() * (size * 1e-4f) );
+         for( dword m = 8;  m-- > 0; )
+         {
+            if( (differ >> m) & 1 )
+            {
+               const Vector3r subLower( bounds[m & 1]->getX(),
+                  bounds[(m >> 1) & 1]->getY(), bounds[(m >> 2) & 1]->getZ() );
+               const Vector3r subUpper( bounds[(m & 1) + 1]->getX(),
+                  bounds[((m >> 1) & 1) + 1]->getY(),
+                  bounds[((m >> 2) & 1) + 1]->getZ() );
+               isOk &= isOnPlane &&
+                  s.isOverlappingCell( item, subLower - tie, subUpper + tie ) &&
+                  !s.isOverlappingCell( item, subLower + tie, subUpper - tie );
+            }
+         }
+#else
+         isOk &= (0 == differ);
+#endif
+#endif
+
+         // single-cell overlap, against a point sampled across it
+         const bool isOverlap = s.isOverlappingCell( item, lower, upper );
+         const real u = rand.next().getFloat();
+         const real v = rand.next().getFloat() * (1.0f - u);
+         const Vector3r sample( vertexs[0] + ((vertexs[1] - vertexs[0]) * u) +
+            ((vertexs[2] - vertexs[0]) * v) );
+         isOk &= isOverlap || !OctreeShape::isOverlappingPoint( sample, lower,
+            upper );
+
+         // single-cell overlap, against bound and plane
+         bool isBoundClear = false;
+         for( int k = 3;  k-- > 0; )
+         {
+            isBoundClear |= ((vertexs[0][k] > upper[k]) &
+               (vertexs[1][k] > upper[k]) & (vertexs[2][k] > upper[k])) |
+               ((vertexs[0][k] < lower[k]) & (vertexs[1][k] < lower[k]) &
+               (vertexs[2][k] < lower[k]));
+         }
+         const Vector3r normal( (vertexs[1] - vertexs[0]).cross(
+            vertexs[2] - vertexs[0] ) );
+         const real     offset = normal.dot( vertexs[0] );
+         dword sides = 0;
+         for( dword m = 8;  m-- > 0; )
+         {
+            const Vector3r corner( bounds[(m & 1) << 1]->getX(),
+               bounds[(m & 2)]->getY(), bounds[(m >> 2) << 1]->getZ() );
+            const real d = normal.dot( corner ) - offset;
+            sides |= (d > (size * 1e-3f) * normal.length()) ? 1 :
+               ((d < (size * -1e-3f) * normal.length()) ? 2 : 3);
+         }
+         const bool isPlaneClear = (1 == sides) | (2 == sides);
+         isOk &= !isOverlap || !(isBoundClear || isPlaneClear);
+      }
+
+      // make octrees, of random format, and triangles (within the root)
+      const Vector3r position( rand.next().getFloat( 2.0f, -1.0f ),
+         rand.next().getFloat( 2.0f, -1.0f ),
+         rand.next().getFloat( 2.0f, -1.0f ) );
+      const real  size     = rand.next().getFloat( 4.0f, 0.5f );
+      const dword maxItems = (rand.next().getUdword() % 8) + 1;
+      const dword maxLevel = (rand.next().getUdword() % 10) + 1;
+      Octree<OctreeTriangleItemTest> o1( position, size, maxItems, maxLevel,
+         0.0f );
+      OctreeStatic<OctreeTriangleItemTest,
+         OctreeAgentStaticTriangle<OctreeTriangleItemTest> > o2( position,
+         size, maxItems, maxLevel, 0.0f );
+
+      std::vector<OctreeTriangleItemTest> items( (i & 2) ? 500 : 50 );
+      for( udword j = 0;  j < items.size();  ++j )
+      {
+         Vector3r vertexs[3];
+         const Vector3r center( position + (Vector3r( rand.next().getFloat(),
+            rand.next().getFloat(), rand.next().getFloat() ) *
+            (size * 0.8f)) + (Vector3r::ONE() * (size * 0.1f)) );
+         for( dword v = 0;  v < 3;  ++v )
+         {
+            vertexs[v] = center + (Vector3r(
+               rand.next().getFloat( 2.0f, -1.0f ),
+               rand.next().getFloat( 2.0f, -1.0f ),
+               rand.next().getFloat( 2.0f, -1.0f ) ) * (size * 0.1f));
+         }
+         items[j] = OctreeTriangleItemTest( vertexs[0], vertexs[1],
+            vertexs[2] );
+      }
+      o1.insertRange( &items[0], items.size(), a );
+      o2.insertRange( &items[0], items.size(), s );
+
+      Array<const OctreeTriangleItemTest*> found;
+      Array<real>                          distances;
+      for( dword j = 0;  j < 10;  ++j )
+      {
+         // box query
+         real box[2][3];
+         for( int k = 3;  k-- > 0; )
+         {
+            const real p0 = rand.next().getFloat() * size;
+            const real p1 = rand.next().getFloat() * size;
+            box[0][k] = position[k] + ((p0 < p1) ? p0 : p1);
+            box[1][k] = position[k] + ((p0 < p1) ? p1 : p0);
+         }
+         const Vector3r lower( box[0][0], box[0][1], box[0][2] );
+         const Vector3r upper( box[1][0], box[1][1], box[1][2] );
+
+         std::vector<const OctreeTriangleItemTest*> expected;
+         for( udword k = 0;  k < items.size();  ++k )
+         {
+            if( s.isOverlappingCell( items[k], lower, upper ) )
+            {
+               expected.push_back( &items[k] );
+            }
+         }
+         std::sort( expected.begin(), expected.end() );
+
+         // nearest query, and ray query (from the box's lower corner)
+         std::vector<real> scanned( items.size() );
+         real              hitExpected = REAL_MAX;
+         const Vector3r direction( (upper - lower) /
+            (upper - lower).length() );
+         for( udword k = 0;  k < items.size();  ++k )
+         {
+            scanned[k] = s.getDistance( items[k], lower );
+            const real t = s.getRayIntersection( items[k], lower, direction );
+            hitExpected = (t < hitExpected) ? t : hitExpected;
+         }
+         const dword nearestK = 5;
+         std::partial_sort( scanned.begin(), scanned.begin() + nearestK,
+            scanned.end() );
+
+         for( dword k = 0;  k < 2;  ++k )
+         {
+            real hitT = 0.0f;
+            if( 0 == k )
+            {
+               o1.queryBox( lower, upper, a, found );
+               isOk &= (found.getLength() ==
+                  static_cast<dword>(expected.size())) && std::equal(
+                  expected.begin(), expected.end(), found.getStorage() );
+               o1.queryNearest( lower, nearestK, REAL_MAX, a, found,
+                  distances );
+               o1.queryRay( lower, direction, REAL_MAX, a, hitT );
+            }
+            else
+            {
+               o2.queryBox( lower, upper, s, found );
+               isOk &= (found.getLength() ==
+                  static_cast<dword>(expected.size())) && std::equal(
+                  expected.begin(), expected.end(), found.getStorage() );
+               o2.queryNearest( lower, nearestK, REAL_MAX, s, found,
+                  distances );
+               o2.queryRay( lower, direction, REAL_MAX, s, hitT );
+            }
+            isOk &= (distances.getLength() == nearestK) && std::equal(
+               scanned.begin(), scanned.begin() + nearestK,
+               distances.getStorage() ) && (hitT == hitExpected);
+         }
+      }
+
+      if( pOut )
+      {
+         *pOut << i << " " << isOk << "\n";
+      }
+   }
+
+   if( pOut )
+   {
+      *pOut << "\n--- testCommands13: " << isOk << "\n";
+   }
+
+   return isOk;
+}
+
+
+bool testCommands14
+(
+   std::ostream* pOut,
+   const bool    ,//isVerbose,
+   const dword   seed
+)
+{
+   // Parallel visit:
+   //
+   // Check a parallel visit of an empty octree visits nothing. Then generate
+   // some random octrees, filled with random items, and linear, frozen, and
+   // static octrees of the same format and items. Visit each in parallel,
+   // with a visitor entering only cells overlapping a random box (or all),
+   // on one thread and on several, and check each gives the same items, in
+   // the same order, as a query, and the same sum (to the bit) on any number
+   // of threads.
+
+   bool isOk = true;
+
+   if( pOut )
+   {
+      *pOut << "\n\n";
+   }
+
+   RandomFast rand( seed );
+   if( pOut )
+   {
+      *pOut << "\nseed= " << rand.getDword() << "\n\n";
+   }
+
+   OctreeAgentTest       a;
+   OctreeAgentStaticTest s;
+
+   // empty
+   {
+      const Octree<OctreeItemTest> o( Vector3r::ZERO(), 1.0f, 4, 4, 0.0f );
+      OctreeVisitorParallelTest v( Vector3r::ZERO(), Vector3r::ONE() );
+      o.visitParallel( v, 4 );
+      isOk &= v.getItems().empty() && (0.0f == v.getSum());
+   }
+
+   // loop
+   for( dword i = 0;  i < 20;  ++i )
+   {
+      std::auto_ptr<Octree<OctreeItemTest> > po1;
+      std::vector<OctreeItemTest>            items;
+      makeRandomFilledOctree( rand, (i & 2) ? 3000 : 200, po1, items );
+      const real size = po1->getSize();
+      OctreeLinearTest o2( po1->getPosition(), size,
+         po1->getMaxItemCountPerCell(), po1->getMaxLevelCount(),
+         po1->getMinCellSize() );
+      o2.insertRange( &items[0], items.size(), a );
+      OctreeFrozen<OctreeItemTest> f3;
+      po1->freeze( f3 );
+      OctreeStaticTest o4( po1->getPosition(), size,
+         po1->getMaxItemCountPerCell(), po1->getMaxLevelCount(),
+         po1->getMinCellSize() );
+      o4.insertRange( &items[0], items.size(), s );
+
+      // random box (or all)
+      real l[3] = { -1.0f, -1.0f, -1.0f };
+      real u[3] = { size + 1.0f, size + 1.0f, size + 1.0f };
+      if( i & 1 )
+      {
+         for( dword k = 3;  k-- > 0; )
+         {
+            const real p0 = rand.next().getFloat( size );
+            const real p1 = rand.next().getFloat( size );
+            l[k] = (p0 < p1) ? p0 : p1;
+            u[k] = (p0 < p1) ? p1 : p0;
+         }
+      }
+      const Vector3r lower( po1->getPosition() + Vector3r( l[0], l[1], l[2] ) );
+      const Vector3r upper( po1->getPosition() + Vector3r( u[0], u[1], u[2] ) );
+
+      isOk &= testVisitParallel( *po1, lower, upper ) &&
+         testVisitParallel( o2, lower, upper ) &&
+         testVisitParallel( f3, lower, upper ) &&
+         testVisitParallel( o4, lower, upper );
+
+      if( pOut )
+      {
+         *pOut << i << " " << isOk << "\n";
+      }
+   }
+
+   if( pOut )
+   {
+      *pOut << "\n--- testCommands14: " << isOk << "\n";
+   }
+
+   return isOk;
+}
+
+
+bool testCommands15
+(
+   std::ostream* pOut,
+   const bool    ,//isVerbose,
+   const dword   seed
+)
+{
+   // Concurrent octree:
+   //
+   // Generate some random concurrent octrees, and plain octrees of the same
+   // format. Change both alike by random inserts, insertRanges and removes,
+   // publishing now and then, and keeping readers of some versions, each
+   // with a copy of the plain octree at the time. Check every reader still
+   // matches its copy, however the octree changes after, and that only the
+   // versions with readers are kept. Then run readers on threads while a
+   // writer changes the octree, and check they only ever see whole published
+   // versions.
+
+   bool isOk = true;
+
+   if( pOut )
+   {
+      *pOut << "\n\n";
+   }
+
+   RandomFast rand( seed );
+   if( pOut )
+   {
+      *pOut << "\nseed= " << rand.getDword() << "\n\n";
+   }
+
+   OctreeAgentTest a;
+
+   // loop
+   for( dword i = 0;  i < 20;  ++i )
+   {
+      std::auto_ptr<Octree<OctreeItemTest> > po1;
+      makeRandomOctree( rand, po1 );
+      std::vector<OctreeItemTest> items;
+      makeRandomItems( rand, (i & 1) ? 2000 : 200, po1->getPosition(),
+         po1->getSize(), items );
+      OctreeConcurrent<OctreeItemTest> o2( po1->getPosition(), po1->getSize(),
+         po1->getMaxItemCountPerCell(), po1->getMaxLevelCount(),
+         po1->getMinCellSize() );
+
+      std::vector<OctreeReader<OctreeItemTest>*> readers;
+      std::vector<Octree<OctreeItemTest>*>       copies;
+
+      for( dword j = 0;  j < 40;  ++j )
+      {
+         // change both alike: insertRange, insert, or remove a run of items
+         const dword op     = rand.next().getUdword() >> 30;
+         const dword begin  = (rand.next().getUdword() >> 8) % items.size();
+         const dword length = (rand.next().getUdword() >> 8) %
+            (items.size() - begin) % 100;
+         for( dword k = begin;  k < begin + length;  ++k )
+         {
+            if( 1 == op )
+            {
+               po1->insert( items[k], a );
+               o2.insert( items[k], a );
+            }
+            else if( 1 < op )
+            {
+               po1->remove( items[k], a );
+               o2.remove( items[k], a );
+            }
+         }
+         if( 0 == op )
+         {
+            po1->insertRange( &items[begin], length, a );
+            o2.insertRange( &items[begin], length, a, (j & 1) ? 4 : 1 );
+         }
+
+         // publish sometimes, keeping a reader and a copy
+         if( rand.next().getUdword() >> 31 )
+         {
+            o2.publish();
+            readers.push_back( new OctreeReader<OctreeItemTest>( o2 ) );
+            copies.push_back( new Octree<OctreeItemTest>( *po1 ) );
+         }
+
+         // drop a reader sometimes
+         if( !readers.empty() && (0 == (rand.next().getUdword() >> 30)) )
+         {
+            const dword k = (rand.next().getUdword() >> 8) % readers.size();
+            delete readers[k];
+            delete copies[k];
+            readers.erase( readers.begin() + k );
+            copies.erase( copies.begin() + k );
+         }
+
+         // check every reader still sees its version
+         const dword readerCount = static_cast<dword>(readers.size());
+         for( dword k = 0;  k < readerCount;  ++k )
+         {
+            isOk &= isSameLeafs( *readers[k], *copies[k], false );
+         }
+      }
+
+      // check the last changes are published, and only versions with
+      // readers are kept (each reader has its own)
+      o2.publish();
+      {
+         const OctreeReader<OctreeItemTest> reader( o2 );
+         isOk &= isSameLeafs( reader, *po1, false );
+      }
+      const dword readerCount = static_cast<dword>(readers.size());
+      isOk &= (o2.getVersionCount() == (readerCount + 1));
+
+      for( dword k = 0;  k < readerCount;  ++k )
+      {
+         delete readers[k];
+         delete copies[k];
+      }
+
+      if( pOut )
+      {
+         *pOut << i << " " << isOk << "\n";
+      }
+   }
+
+   // readers on threads, while a writer changes
+   {
+      std::auto_ptr<Octree<OctreeItemTest> > po1;
+      std::vector<OctreeItemTest>            items;
+      makeRandomOctree( rand, po1 );
+      makeRandomItems( rand, 2000, po1->getPosition(), po1->getSize(),
+         items );
+      OctreeConcurrent<OctreeItemTest> o2( po1->getPosition(), po1->getSize(),
+         po1->getMaxItemCountPerCell(), po1->getMaxLevelCount(),
+         po1->getMinCellSize() );
+
+      // (give the items some extent, so none can fall between cells, on a
+      // boundary, when one subdivides)
+      for( udword k = 0;  k < items.size();  ++k )
+      {
+         items[k] = OctreeItemTest( items[k].getPosition(),
+            items[k].getDimensions() + (Vector3r::ONE() * (po1->getSize() *
+            0.0001f)) );
+      }
+
+      OctreeConcurrentTaskTest writer ( o2, items, 20, true );
+      OctreeConcurrentTaskTest reader1( o2, items, 20, false );
+      OctreeConcurrentTaskTest reader2( o2, items, 20, false );
+      OctreeConcurrentTaskTest reader3( o2, items, 20, false );
+      OctreeTaskV* tasks[] = { &writer, &reader1, &reader2, &reader3 };
+      {
+         OctreeTaskPool pool( 4 );
+         pool.runAll( tasks, 4 );
+      }
+
+      isOk &= writer.isOk() & reader1.isOk() & reader2.isOk() &
+         reader3.isOk();
+
+      // check all old versions are freed, once their readers are gone
+      o2.publish();
+      isOk &= (1 == o2.getVersionCount());
+
+      if( pOut )
+      {
+         *pOut << "threads " << isOk << "\n";
+      }
+   }
+
+   if( pOut )
+   {
+      *pOut << "\n--- testCommands15: " << isOk << "\n";
+   }
+
+   return isOk;
+}
+
+
+bool testCommands16
+(
+   std::ostream* pOut,
+   const bool    ,//isVerbose,
+   const dword   seed
+)
+{
+   // Striped octree:
+   //
+   // Generate some random striped octrees (some with fewer fixed levels), and
+   // plain octrees of the same format. Change both alike by random inserts,
+   // insertRanges (on one thread and several) and removes, and check both
+   // find the same items in random boxes, at the same nearest distances, and
+   // by parallel visit; and copies and assignments of the striped octree
+   // too. Then insert and remove on threads at once, each its own items,
+   // and check each sees its own changes throughout, and the result matches
+   // a plain octree of the items left.
+
+   bool isOk = true;
+
+   if( pOut )
+   {
+      *pOut << "\n\n";
+   }
+
+   RandomFast rand( seed );
+   if( pOut )
+   {
+      *pOut << "\nseed= " << rand.getDword() << "\n\n";
+   }
+
+   OctreeAgentTest a;
+
+   // loop
+   for( dword i = 0;  i < 20;  ++i )
+   {
+      std::auto_ptr<Octree<OctreeItemTest> > po1;
+      makeRandomOctree( rand, po1 );
+      if( i < 2 )
+      {
+         po1.reset( new Octree<OctreeItemTest>( po1->getPosition(),
+            po1->getSize(), po1->getMaxItemCountPerCell(), i + 1,
+            po1->getMinCellSize() ) );
+      }
+      std::vector<OctreeItemTest> items;
+      makeRandomItems( rand, (i & 1) ? 2000 : 200, po1->getPosition(),
+         po1->getSize(), items );
+      OctreeStripedTest o2( po1->getPosition(), po1->getSize(),
+         po1->getMaxItemCountPerCell(), po1->getMaxLevelCount(),
+         po1->getMinCellSize() );
+      isOk &= o2.isEmpty();
+
+      for( dword j = 0;  j < 30;  ++j )
+      {
+         // change both alike: insertRange, insert, or remove a run of items
+         const dword op     = rand.next().getUdword() >> 30;
+         const dword begin  = (rand.next().getUdword() >> 8) % items.size();
+         const dword length = (rand.next().getUdword() >> 8) %
+            (items.size() - begin) % 300;
+         for( dword k = begin;  k < begin + length;  ++k )
+         {
+            if( 1 == op )
+            {
+               isOk &= (po1->insert( items[k], a ) == o2.insert( items[k],
+                  a ));
+            }
+            else if( 1 < op )
+            {
+               isOk &= (po1->remove( items[k], a ) == o2.remove( items[k],
+                  a ));
+            }
+         }
+         if( 0 == op )
+         {
+            isOk &= (po1->insertRange( &items[begin], length, a ) ==
+               o2.insertRange( &items[begin], length, a, (j & 1) ? 4 : 1 ));
+         }
+
+         isOk &= isSameQueries( *po1, o2, rand );
+
+         // copy and assign sometimes
+         if( 9 == (j % 10) )
+         {
+            const OctreeStripedTest o3( o2 );
+            OctreeStripedTest o4( Vector3r::ZERO(), 1.0f, 1, 1, 0.0f );
+            o4.insert( items[0], a );
+            o4 = o2;
+            isOk &= isSameQueries( *po1, o3, rand ) &&
+               isSameQueries( *po1, o4, rand ) && isSameLeafs( o2, o3 ) &&
+               isSameLeafs( o2, o4 );
+         }
+      }
+
+      if( pOut )
+      {
+         *pOut << i << " " << isOk << "\n";
+      }
+   }
+
+   // inserts and removes on threads at once
+   {
+      std::auto_ptr<Octree<OctreeItemTest> > po1;
+      std::vector<OctreeItemTest>            items;
+      makeRandomOctree( rand, po1 );
+      makeRandomItems( rand, 4000, po1->getPosition(), po1->getSize(),
+         items );
+      OctreeStripedTest o2( po1->getPosition(), po1->getSize(),
+         po1->getMaxItemCountPerCell(), po1->getMaxLevelCount(),
+         po1->getMinCellSize() );
+
+      // (give the items some extent, so none can fall between cells, on a
+      // boundary, when one subdivides)
+      for( udword k = 0;  k < items.size();  ++k )
+      {
+         items[k] = OctreeItemTest( items[k].getPosition(),
+            items[k].getDimensions() + (Vector3r::ONE() * (po1->getSize() *
+            0.0001f)) );
+      }
+
+      OctreeStripedTaskTest writer1( o2, items,    0, 1000 );
+      OctreeStripedTaskTest writer2( o2, items, 1000, 2000 );
+      OctreeStripedTaskTest writer3( o2, items, 2000, 3000 );
+      OctreeStripedTaskTest writer4( o2, items, 3000, 4000 );
+      OctreeTaskV* tasks[] = { &writer1, &writer2, &writer3, &writer4 };
+      {
+         OctreeTaskPool pool( 4 );
+         pool.runAll( tasks, 4 );
+      }
+
+      isOk &= writer1.isOk() & writer2.isOk() & writer3.isOk() &
+         writer4.isOk();
+
+      // the odd ones are left
+      for( udword k = 1;  k < items.size();  k += 2 )
+      {
+         po1->insert( items[k], a );
+      }
+      isOk &= isSameQueries( *po1, o2, rand );
+
+      if( pOut )
+      {
+         *pOut << "threads " << isOk << "\n";
+      }
+   }
+
+   if( pOut )
+   {
+      *pOut << "\n--- testCommands16: " << isOk << "\n";
+   }
+
+   return isOk;
+}
+
+
+bool testCommands17
+(
+   std::ostream* pOut,
+   const bool    ,//isVerbose,
+   const dword   seed
+)
+{
+   // Copy-on-write copies:
+   //
+   // Generate some random octrees, holding half of some random items.
+   // Repeatedly snapshot each (by copy, then by assignment), checking the
+   // snapshot shares all its cells, then change the octree, and sometimes the
+   // snapshot, by random inserts, insertRanges and removes. Check each has the
+   // same leafs as an unrelated octree given the same changes (so no change to
+   // one shows in the other). Sometimes destroy the original first, and check
+   // the snapshot still. Then change the original on one thread while an
+   // unshared copy of it changes alike on another, and check both end the
+   // same as an unrelated octree changed alike.
+
+   bool isOk = true;
+
+   if( pOut )
+   {
+      *pOut << "\n\n";
+   }
+
+   RandomFast rand( seed );
+   if( pOut )
+   {
+      *pOut << "\nseed= " << rand.getDword() << "\n\n";
+   }
+
+   OctreeAgentTest a;
+
+   // loop
+   for( dword i = 0;  i < 20;  ++i )
+   {
+      std::auto_ptr<Octree<OctreeItemTest> > po1;
+      std::vector<OctreeItemTest>            items;
+      makeRandomOctree( rand, po1 );
+      makeRandomItems( rand, (i & 1) ? 2000 : 200, po1->getPosition(),
+         po1->getSize(), items );
+      po1->insertRange( &items[0], items.size() / 2, a );
+
+      // unrelated octree, the same as the original
+      Octree<OctreeItemTest> o2( po1->getPosition(), po1->getSize(),
+         po1->getMaxItemCountPerCell(), po1->getMaxLevelCount(),
+         po1->getMinCellSize() );
+      o2 = *po1;
+
+      std::auto_ptr<Octree<OctreeItemTest> > pSnapshot;
+      for( dword j = 0;  j < 10;  ++j )
+      {
+         // snapshot
+         if( 0 == j )
+         {
+            pSnapshot.reset( new Octree<OctreeItemTest>( *po1 ) );
+         }
+         else
+         {
+            *pSnapshot = *po1;
+         }
+         isOk &= isSharingAll( *po1, *pSnapshot );
+
+         // unrelated octree, the same as the snapshot
+         Octree<OctreeItemTest> o3( o2 );
+         o3 = *pSnapshot;
+
+         // change the original, and sometimes the snapshot
+         isOk &= changeAlike( rand, *po1, o2, items );
+         if( j & 1 )
+         {
+            isOk &= changeAlike( rand, *pSnapshot, o3, items );
+         }
+
+         isOk &= isSameLeafs( *po1, o2, false ) &&
+            isSameLeafs( *pSnapshot, o3, false );
+
+         // destroy the original first, sometimes
+         if( (i & 2) && (9 == j) )
+         {
+            po1.reset();
+            isOk &= isSameLeafs( *pSnapshot, o3, false ) &&
+               isSameQueries( o3, *pSnapshot, rand );
+         }
+      }
+
+      // unshared copy, changed on another thread from the original
+      if( po1.get() )
+      {
+         Octree<OctreeItemTest> o4( *po1, false );
+         OctreeChangeTaskTest change1( *po1, items );
+         OctreeChangeTaskTest change4( o4, items );
+         OctreeTaskV* tasks[] = { &change1, &change4 };
+         {
+            OctreeTaskPool pool( 2 );
+            pool.runAll( tasks, 2 );
+         }
+
+         OctreeChangeTaskTest change2( o2, items );
+         change2.run();
+         isOk &= isSameLeafs( *po1, o2, false ) && isSameLeafs( o4, o2, false );
+      }
+
+      if( pOut )
+      {
+         *pOut << i << " " << isOk << "\n";
+      }
+   }
+
+   if( pOut )
+   {
+      *pOut << "\n--- testCommands17: " << isOk << "\n";
+   }
+
+   return isOk;
+}
+
+
+bool testCommands18
+(
+   std::ostream* pOut,
+   const bool    ,//isVerbose,
+   const dword   seed
+)
+{
+   // Stats:
+   //
+   // Generate some random octrees, of each kind, with the same format, and a
+   // copy of the first. Give them all the same random changes: insertRanges
+   // (on one thread or several) and inserts of items not held, and removes.
+   // Each time, check each one's stats and info against counts made by
+   // visiting it, and the number of items held.
+
+   bool isOk = true;
+
+   if( pOut )
+   {
+      *pOut << "\n\n";
+   }
+
+   RandomFast rand( seed );
+   if( pOut )
+   {
+      *pOut << "\nseed= " << rand.getDword() << "\n\n";
+   }
+
+   const OctreeAgentTest       a;
+   const OctreeAgentStaticTest s;
+
+   // loop
+   for( dword i = 0;  i < 20;  ++i )
+   {
+      std::auto_ptr<Octree<OctreeItemTest> > po1;
+      std::vector<OctreeItemTest>            items;
+      makeRandomOctree( rand, po1 );
+      makeRandomItems( rand, (i & 1) ? 2000 : 200, po1->getPosition(),
+         po1->getSize(), items );
+
+      OctreeStripedTest o2( po1->getPosition(), po1->getSize(),
+         po1->getMaxItemCountPerCell(), po1->getMaxLevelCount(),
+         po1->getMinCellSize() );
+      OctreeLinearTest  o3( po1->getPosition(), po1->getSize(),
+         po1->getMaxItemCountPerCell(), po1->getMaxLevelCount(),
+         po1->getMinCellSize() );
+      OctreeStaticTest  o4( po1->getPosition(), po1->getSize(),
+         po1->getMaxItemCountPerCell(), po1->getMaxLevelCount(),
+         po1->getMinCellSize() );
+
+      std::vector<bool> isIn( items.size(), false );
+      dword             itemCount = 0;
+      for( dword j = 0;  j < 10;  ++j )
+      {
+         // copy (sharing all cells), to be changed alike
+         Octree<OctreeItemTest> o5( *po1 );
+
+         // insertRange, insert, or remove a run of items
+         const dword op     = rand.next().getUdword() >> 30;
+         const dword begin  = (rand.next().getUdword() >> 8) % items.size();
+         const dword length = (rand.next().getUdword() >> 8) %
+            (items.size() - begin) % 300;
+         changeUniquely( *po1, a, items, isIn, op, begin, length );
+         changeUniquely( o2,   a, items, isIn, op, begin, length );
+         changeUniquely( o3,   a, items, isIn, op, begin, length );
+         changeUniquely( o4,   s, items, isIn, op, begin, length );
+         changeUniquely( o5,   a, items, isIn, op, begin, length );
+         for( dword k = begin;  k < begin + length;  ++k )
+         {
+            itemCount += (op < 2) ? !isIn[k] : -static_cast<dword>(isIn[k]);
+            isIn[k] = (op < 2);
+         }
+
+         isOk &= isCountedStats( *po1, itemCount ) &&
+            isCountedStats( o2, itemCount ) &&
+            isCountedStats( o3, itemCount ) &&
+            isCountedStats( o4, itemCount ) &&
+            isCountedStats( o5, itemCount );
+      }
+
+      if( pOut )
+      {
+         *pOut << i << " " << isOk << "\n";
+      }
+   }
+
+   if( pOut )
+   {
+      *pOut << "\n--- testCommands18: " << isOk << "\n";
+   }
+
+   return isOk;
+}
+
+
+bool testCommands19
+(
+   std::ostream* pOut,
+   const bool    ,//isVerbose,
+   const dword   seed
+)
+{
+   // Traversal counts:
+   //
+   // Generate some random octrees, of each kind, with the same format, and
+   // some random items. Clear each one's counts, then insert some items one at
+   // a time and the rest in bulk, remove some, query, and visit. Check the
+   // calls counted are those made, the counts of each kind of call sum
+   // consistently, and the visit entered each cell once, making its data, and
+   // scanned each item ref once. And check clearing leaves no counts. (Built
+   // without OCTREE_INSTRUMENTED, check there are never any counts.)
+
+   bool isOk = true;
+
+   if( pOut )
+   {
+      *pOut << "\n\n";
+   }
+
+   RandomFast rand( seed );
+   if( pOut )
+   {
+      *pOut << "\nseed= " << rand.getDword() << "\n\n";
+   }
+
+   // loop
+   for( dword i = 0;  i < 20;  ++i )
+   {
+      std::auto_ptr<Octree<OctreeItemTest> > po1;
+      std::vector<OctreeItemTest>            items;
+      makeRandomOctree( rand, po1 );
+      makeRandomItems( rand, (i & 1) ? 2000 : 200, po1->getPosition(),
+         po1->getSize(), items );
+
+      OctreeStripedTest o2( po1->getPosition(), po1->getSize(),
+         po1->getMaxItemCountPerCell(), po1->getMaxLevelCount(),
+         po1->getMinCellSize() );
+      OctreeLinearTest  o3( po1->getPosition(), po1->getSize(),
+         po1->getMaxItemCountPerCell(), po1->getMaxLevelCount(),
+         po1->getMinCellSize() );
+
+      const dword first       = rand.next().getUdword() % items.size();
+      const dword removeCount = rand.next().getUdword() % items.size();
+      isOk &= isCountedCalls( *po1, items, first, removeCount ) &&
+         isCountedCalls( o2, items, first, removeCount ) &&
+         isCountedCalls( o3, items, first, removeCount );
+
+      if( pOut )
+      {
+         *pOut << i << " " << isOk << "\n";
+      }
+   }
+
+   if( pOut )
+   {
+      *pOut << "\n--- testCommands19: " << isOk << "\n";
+   }
+
+   return isOk;
+}
+
+
+bool testCommands20
+(
+   std::ostream* pOut,
+   const bool    ,//isVerbose,
+   const dword   seed
+)
+{
+   // Loose octree:
+   //
+   // Generate some random loose octrees, filled with random items, some of
+   // them large blocks, part one at a time and part in bulk, and again (so
+   // each is held already). Check each item is held once (one ref each), the
+   // stats and info agree with visiting, and box, nearest, and ray queries
+   // find the same as testing every item held. Then remove random runs, and
+   // copy, assign and collapse, checking again. Then remove all, checking all
+   // are found and it ends empty. Keep a loose octree on the heap allocator
+   // the same way, with another looseness (1 to 4, or below 1, clamped to
+   // 1), checking it holds the same. Check each holds its items within their
+   // cells' loose bounds.
+
+   bool isOk = true;
+
+   if( pOut )
+   {
+      *pOut << "\n\n";
+   }
+
+   RandomFast rand( seed );
+   if( pOut )
+   {
+      *pOut << "\nseed= " << rand.getDword() << "\n\n";
+   }
+
+   const OctreeAgentTest a;
+
+   // loop
+   for( dword i = 0;  i < 20;  ++i )
+   {
+      std::auto_ptr<Octree<OctreeItemTest> > po1;
+      std::vector<OctreeItemTest>            items;
+      makeRandomOctree( rand, po1 );
+      makeRandomItems( rand, (i & 1) ? 2000 : 200, po1->getPosition(),
+         po1->getSize(), items );
+
+      // some large blocks (up to half the root)
+      for( udword j = 0;  j < items.size();  j += 8 )
+      {
+         const Vector3r dimensions( rand.next().getFloat(),
+            rand.next().getFloat(), rand.next().getFloat() );
+         items[j] = OctreeItemTest( items[j].getPosition(),
+            dimensions * (po1->getSize() * 0.5f) );
+      }
+
+      OctreeLooseTest     o2( po1->getPosition(), po1->getSize(),
+         po1->getMaxItemCountPerCell(), po1->getMaxLevelCount(),
+         po1->getMinCellSize() );
+      const real          looseness = (i < 19) ?
+         (1.0f + (static_cast<real>(i) / 6.0f)) : 0.5f;
+      OctreeLooseHeapTest o4( po1->getPosition(), po1->getSize(),
+         po1->getMaxItemCountPerCell(), po1->getMaxLevelCount(),
+         po1->getMinCellSize(), DWORD_MAX, looseness );
+      isOk &= (o2.getLooseness() == 2.0f) &&
+         (o4.getLooseness() == ((looseness >= 1.0f) ? looseness : 1.0f));
+
+      // insert half one at a time, the rest in bulk, then all again
+      const dword half = static_cast<dword>(items.size()) / 2;
+      for( dword j = 0;  j < half;  ++j )
+      {
+         isOk &= o2.insert( items[j], a );
+      }
+      isOk &= (o2.insertRange( &items[half], items.size() - half, a ) ==
+         static_cast<dword>(items.size()) - half);
+      isOk &= (o2.insertRange( &items[0], items.size(), a ) ==
+         static_cast<dword>(items.size()));
+      o4.insertRange( &items[0], items.size(), a );
+
+      std::vector<bool> isIn( items.size(), true );
+      dword             itemCount = static_cast<dword>(items.size());
+      for( dword j = 0;  j < 4;  ++j )
+      {
+         // one ref for each item, and the same as visited and scanned
+         OctreeStats stats;
+         o2.getStats( stats );
+         isOk &= (stats.getItemRefCount() == itemCount) &&
+            isCountedStats( o2, itemCount );
+         for( dword k = 0;  k < 4;  ++k )
+         {
+            isOk &= isSameAsScanned( o2, items, isIn, rand );
+         }
+
+         // copy and assign
+         OctreeLooseTest o3( o2 );
+         isOk &= isCountedStats( o3, itemCount ) &&
+            isSameAsScanned( o3, items, isIn, rand );
+         o3 = OctreeLooseTest( o2.getPosition(), o2.getSize(), 1, 1, 1.0f );
+         o3 = o2;
+         isOk &= isCountedStats( o3, itemCount ) &&
+            isSameAsScanned( o3, items, isIn, rand );
+
+         // collapse the copy
+         o3.collapse();
+         isOk &= isCountedStats( o3, itemCount ) &&
+            isSameAsScanned( o3, items, isIn, rand );
+
+         // the heap one too, and each holding items in its loose bounds
+         isOk &= isCountedStats( o4, itemCount ) &&
+            isSameAsScanned( o4, items, isIn, rand ) &&
+            isInLooseBounds( o2 ) && isInLooseBounds( o4 );
+
+         // remove a random run
+         const dword begin  = (rand.next().getUdword() >> 8) % items.size();
+         const dword length = (rand.next().getUdword() >> 8) %
+            (items.size() - begin);
+         for( dword k = begin;  k < begin + length;  ++k )
+         {
+            isOk &= (o2.remove( items[k], a ) == isIn[k]);
+            isOk &= (o4.remove( items[k], a ) == isIn[k]);
+            itemCount -= isIn[k] ? 1 : 0;
+            isIn[k] = false;
+         }
+      }
+
+      // remove all
+      for( udword j = 0;  j < items.size();  ++j )
+      {
+         isOk &= (o2.remove( items[j], a ) == isIn[j]);
+         isOk &= (o4.remove( items[j], a ) == isIn[j]);
+      }
+      OctreeStats stats;
+      o2.getStats( stats );
+      isOk &= o2.isEmpty() && (0 == stats.getItemCount()) &&
+         (0 == stats.getItemRefCount()) && isCountedStats( o2, 0 );
+      isOk &= o4.isEmpty() && isCountedStats( o4, 0 );
+
+      if( pOut )
+      {
+         *pOut << i << " " << isOk << "\n";
+      }
+   }
+
+   if( pOut )
+   {
+      *pOut << "\n--- testCommands20: " << isOk << "\n";
+   }
+
+   return isOk;
+}
+
+
+bool testCommands21
+(
+   std::ostream* pOut,
+   const bool    ,//isVerbose,
+   const dword   seed
+)
+{
+   // Covering items:
+   //
+   // Generate some random octrees, of each kind, with the same format, filled
+   // with random items, many of them large blocks and one the whole root,
+   // part one at a time and part in bulk. Check the items held at branchs
+   // cover them, the whole-root item is held once at a branch root, there are
+   // no more item refs than OctreeLinear holds (which does not hold items at
+   // branchs), OctreeStatic holds the same, the stats and info agree with
+   // visiting, and box, nearest, and ray queries, and parallel visits and
+   // frozen copies, find the same as testing every item held. Then remove
+   // random runs, checking again, then all, checking it ends empty.
+
+   bool isOk = true;
+
+   if( pOut )
+   {
+      *pOut << "\n\n";
+   }
+
+   RandomFast rand( seed );
+   if( pOut )
+   {
+      *pOut << "\nseed= " << rand.getDword() << "\n\n";
+   }
+
+   const OctreeAgentTest       a;
+   const OctreeAgentStaticTest s;
+
+   // loop
+   for( dword i = 0;  i < 20;  ++i )
+   {
+      std::auto_ptr<Octree<OctreeItemTest> > po1;
+      std::vector<OctreeItemTest>            items;
+      makeRandomOctree( rand, po1 );
+      makeRandomItems( rand, (i & 1) ? 2000 : 200, po1->getPosition(),
+         po1->getSize(), items );
+
+      // all blocks (with some extent, so none can fall between subcells):
+      // every eighth large (up to half the root), and one the whole root
+      for( udword j = 0;  j < items.size();  ++j )
+      {
+         const real scale = po1->getSize() * ((0 == (j & 7)) ? 0.5f : 0.02f);
+         Vector3r dimensions( rand.next().getFloat(), rand.next().getFloat(),
+            rand.next().getFloat() );
+         dimensions = ((dimensions * 0.9f) + Vector3r( 0.1f, 0.1f, 0.1f )) *
+            scale;
+         items[j] = OctreeItemTest( items[j].getPosition() - (dimensions *
+            0.5f), dimensions );
+      }
+      items[0] = OctreeItemTest( po1->getPosition(), Vector3r( po1->getSize(),
+         po1->getSize(), po1->getSize() ) );
+
+      OctreeStripedTest o2( po1->getPosition(), po1->getSize(),
+         po1->getMaxItemCountPerCell(), po1->getMaxLevelCount(),
+         po1->getMinCellSize() );
+      OctreeLinearTest  o3( po1->getPosition(), po1->getSize(),
+         po1->getMaxItemCountPerCell(), po1->getMaxLevelCount(),
+         po1->getMinCellSize() );
+      OctreeStaticTest  o4( po1->getPosition(), po1->getSize(),
+         po1->getMaxItemCountPerCell(), po1->getMaxLevelCount(),
+         po1->getMinCellSize() );
+
+      // insert half one at a time, the rest in bulk
+      const dword half = static_cast<dword>(items.size()) / 2;
+      for( dword j = 0;  j < half;  ++j )
+      {
+         po1->insert( items[j], a );
+         o2.insert( items[j], a );
+         o3.insert( items[j], a );
+         o4.insert( items[j], s );
+      }
+      po1->insertRange( &items[half], items.size() - half, a );
+      o2.insertRange( &items[half], items.size() - half, a, (i & 1) ? 4 : 1 );
+      o3.insertRange( &items[half], items.size() - half, a );
+      o4.insertRange( &items[half], items.size() - half, s );
+
+      std::vector<bool> isIn( items.size(), true );
+      dword             itemCount = static_cast<dword>(items.size());
+      for( dword j = 0;  j < 4;  ++j )
+      {
+         // branchs hold only covering items, and the whole root once
+         OctreeVisitorStatsTest v;
+         po1->visit( v );
+         OctreeQueryTest q( po1->getPosition(), po1->getPosition() +
+            Vector3r( po1->getSize(), po1->getSize(), po1->getSize() ) );
+         po1->query( q );
+         isOk &= v.isBranchItemsCovering() && (std::count(
+            q.getItems().begin(), q.getItems().end(), &items[0] ) ==
+            (isIn[0] ? 1 : 0));
+
+         // no more refs than OctreeLinear, and the same as OctreeStatic
+         OctreeStats stats[3];
+         po1->getStats( stats[0] );
+         o3.getStats( stats[1] );
+         o4.getStats( stats[2] );
+         isOk &= (stats[0].getItemRefCount() <= stats[1].getItemRefCount()) &&
+            (stats[0].getItemRefCount() == stats[2].getItemRefCount()) &&
+            (stats[0].getBranchCount() == stats[2].getBranchCount());
+
+         // same as visited and scanned
+         isOk &= isCountedStats( *po1, itemCount ) &&
+            isCountedStats( o2, itemCount ) &&
+            isCountedStats( o3, itemCount ) &&
+            isCountedStats( o4, itemCount );
+         for( dword k = 0;  k < 4;  ++k )
+         {
+            isOk &= isSameAsScanned( *po1, items, isIn, rand ) &&
+               isSameAsScanned( o2, items, isIn, rand ) &&
+               isSameAsScanned( o3, items, isIn, rand );
+         }
+
+         // parallel visits and frozen copies find the same
+         OctreeFrozen<OctreeItemTest> f;
+         po1->freeze( f );
+         isOk &= isSameQueries( *po1, *po1, rand ) &&
+            isSameQueries( *po1, f, rand ) && isSameQueries( *po1, o2, rand );
+
+         // remove a random run
+         const dword begin  = (rand.next().getUdword() >> 8) % items.size();
+         const dword length = (rand.next().getUdword() >> 8) %
+            (items.size() - begin);
+         for( dword k = begin;  k < begin + length;  ++k )
+         {
+            isOk &= (po1->remove( items[k], a ) == isIn[k]) &&
+               (o2.remove( items[k], a ) == isIn[k]) &&
+               (o3.remove( items[k], a ) == isIn[k]) &&
+               (o4.remove( items[k], s ) == isIn[k]);
+            itemCount -= isIn[k] ? 1 : 0;
+            isIn[k] = false;
+         }
+      }
+
+      // remove all
+      for( udword j = 0;  j < items.size();  ++j )
+      {
+         isOk &= (po1->remove( items[j], a ) == isIn[j]) &&
+            (o4.remove( items[j], s ) == isIn[j]);
+      }
+      OctreeStats stats;
+      po1->getStats( stats );
+      isOk &= po1->isEmpty() && o4.isEmpty() && (0 == stats.getItemCount()) &&
+         (0 == stats.getItemRefCount()) && (0 == stats.getByteSize()) &&
+         isCountedStats( *po1, 0 );
+
+      if( pOut )
+      {
+         *pOut << i << " " << isOk << "\n";
+      }
+   }
+
+   if( pOut )
+   {
+      *pOut << "\n--- testCommands21: " << isOk << "\n";
+   }
+
+   return isOk;
+}
+
+
+bool testCommands22
+(
+   std::ostream* pOut,
+   const bool    ,//isVerbose,
+   const dword   seed
+)
+{
+   // Collapse hysteresis:
+   //
+   // Make a branch by inserting one item too many into a leaf, then remove
+   // and re-insert items about the threshold, checking it collapses only when
+   // down to the collapse count: at once by default, later below the max,
+   // and only by collapse at 0. Then generate some random octrees, of each
+   // kind, with the same format and a random collapse count, filled with
+   // random small blocks. Remove and re-insert random runs, checking every
+   // branch holds more item refs than the collapse count, the stats and info
+   // agree with visiting, and box, nearest, and ray queries find the same as
+   // testing every item held. Then collapse, checking every branch holds more
+   // than the max.
+
+   bool isOk = true;
+
+   if( pOut )
+   {
+      *pOut << "\n\n";
+   }
+
+   RandomFast rand( seed );
+   if( pOut )
+   {
+      *pOut << "\nseed= " << rand.getDword() << "\n\n";
+   }
+
+   const OctreeAgentTest       a;
+   const OctreeAgentStaticTest s;
+
+   // one too many, hovering
+   {
+      // five points, three in the lower x half, two in the upper
+      std::vector<OctreeItemTest> items;
+      for( dword j = 0;  j < 5;  ++j )
+      {
+         items.push_back( OctreeItemTest( Vector3r( 0.05f + (0.19f *
+            static_cast<real>(j)), 0.3f, 0.3f ), Vector3r::ZERO() ) );
+      }
+
+      // collapse counts: default, below the max, 0, and clamped ones
+      const dword collapseCounts[5] = { DWORD_MAX, 2, 0, 9, -3 };
+      const dword clamped[5]        = { 4, 2, 0, 4, 0 };
+      for( dword i = 0;  i < 5;  ++i )
+      {
+         Octree<OctreeItemTest> o( Vector3r::ZERO(), 1.0f, 4, 4, 0.001f,
+            collapseCounts[i] );
+         isOk &= (o.getCollapseItemCount() == clamped[i]);
+
+         OctreeStats stats;
+         for( dword j = 0;  j < 5;  ++j )
+         {
+            o.insert( items[j], a );
+         }
+         o.getStats( stats );
+         isOk &= (1 == stats.getBranchCount());
+
+         // remove one then re-insert it, then remove down to two
+         o.remove( items[4], a );
+         o.getStats( stats );
+         isOk &= (stats.getBranchCount() == ((4 > clamped[i]) ? 1 : 0));
+         o.insert( items[4], a );
+         o.getStats( stats );
+         isOk &= (1 == stats.getBranchCount());
+         for( dword j = 5;  j-- > 2; )
+         {
+            o.remove( items[j], a );
+            o.getStats( stats );
+            isOk &= (stats.getBranchCount() == ((j > clamped[i]) ? 1 : 0)) &&
+               isCountedStats( o, j );
+         }
+
+         // collapse leaves one leaf, with the rest
+         o.collapse();
+         o.getStats( stats );
+         isOk &= (0 == stats.getBranchCount()) &&
+            (1 == stats.getLeafCount()) && isCountedStats( o, 2 );
+      }
+   }
+
+   // loop
+   for( dword i = 0;  i < 20;  ++i )
+   {
+      std::auto_ptr<Octree<OctreeItemTest> > po1;
+      std::vector<OctreeItemTest>            items;
+      makeRandomOctree( rand, po1 );
+      makeRandomItems( rand, (i & 1) ? 1000 : 100, po1->getPosition(),
+         po1->getSize(), items );
+
+      // all small blocks (with some extent, so none can fall between
+      // subcells)
+      for( udword j = 0;  j < items.size();  ++j )
+      {
+         Vector3r dimensions( rand.next().getFloat(), rand.next().getFloat(),
+            rand.next().getFloat() );
+         dimensions = ((dimensions * 0.9f) + Vector3r( 0.1f, 0.1f, 0.1f )) *
+            (po1->getSize() * 0.02f);
+         items[j] = OctreeItemTest( items[j].getPosition() - (dimensions *
+            0.5f), dimensions );
+      }
+
+      // collapse count: random between 0 and the max (the default)
+      const dword maxItems      = po1->getMaxItemCountPerCell();
+      const dword collapseCount = static_cast<dword>(
+         (rand.next().getUdword() >> 8) % (maxItems + 1) );
+      isOk &= (po1->getCollapseItemCount() == maxItems);
+
+      Octree<OctreeItemTest> o1( po1->getPosition(), po1->getSize(),
+         maxItems, po1->getMaxLevelCount(), po1->getMinCellSize(),
+         collapseCount );
+      OctreeStripedTest      o2( po1->getPosition(), po1->getSize(),
+         maxItems, po1->getMaxLevelCount(), po1->getMinCellSize(),
+         collapseCount );
+      OctreeLinearTest       o3( po1->getPosition(), po1->getSize(),
+         maxItems, po1->getMaxLevelCount(), po1->getMinCellSize(),
+         collapseCount );
+      OctreeLooseTest        o4( po1->getPosition(), po1->getSize(),
+         maxItems, po1->getMaxLevelCount(), po1->getMinCellSize(),
+         collapseCount );
+      OctreeStaticTest       o5( po1->getPosition(), po1->getSize(),
+         maxItems, po1->getMaxLevelCount(), po1->getMinCellSize(),
+         collapseCount );
+      isOk &= (o1.getCollapseItemCount() == collapseCount) &&
+         (o2.getCollapseItemCount() == collapseCount) &&
+         (o3.getCollapseItemCount() == collapseCount) &&
+         (o4.getCollapseItemCount() == collapseCount) &&
+         (o5.getCollapseItemCount() == collapseCount);
+
+      o1.insertRange( &items[0], items.size(), a );
+      o2.insertRange( &items[0], items.size(), a );
+      o3.insertRange( &items[0], items.size(), a );
+      o4.insertRange( &items[0], items.size(), a );
+      o5.insertRange( &items[0], items.size(), s );
+
+      std::vector<bool> isIn( items.size(), true );
+      dword             itemCount = static_cast<dword>(items.size());
+      for( dword j = 0;  j < 4;  ++j )
+      {
+         // remove a random run, and re-insert part of it
+         const dword begin  = (rand.next().getUdword() >> 8) % items.size();
+         const dword length = (rand.next().getUdword() >> 8) %
+            (items.size() - begin);
+         for( dword k = begin;  k < begin + length;  ++k )
+         {
+            isOk &= (o1.remove( items[k], a ) == isIn[k]) &&
+               (o2.remove( items[k], a ) == isIn[k]) &&
+               (o3.remove( items[k], a ) == isIn[k]) &&
+               (o4.remove( items[k], a ) == isIn[k]) &&
+               (o5.remove( items[k], s ) == isIn[k]);
+            itemCount -= isIn[k] ? 1 : 0;
+            isIn[k] = false;
+         }
+         for( dword k = begin;  k < begin + (length / 2);  ++k )
+         {
+            o1.insert( items[k], a );
+            o2.insert( items[k], a );
+            o3.insert( items[k], a );
+            o4.insert( items[k], a );
+            o5.insert( items[k], s );
+            ++itemCount;
+            isIn[k] = true;
+         }
+
+         // every branch holds more than the collapse count
+         isOk &= isBranchsOver( o1, collapseCount ) &&
+            isBranchsOver( o3, collapseCount ) &&
+            isBranchsOver( o4, collapseCount ) &&
+            isBranchsOver( o5, collapseCount );
+
+         // same as visited and scanned
+         isOk &= isCountedStats( o1, itemCount ) &&
+            isCountedStats( o2, itemCount ) &&
+            isCountedStats( o3, itemCount ) &&
+            isCountedStats( o4, itemCount ) &&
+            isCountedStats( o5, itemCount );
+         isOk &= isSameAsScanned( o1, items, isIn, rand ) &&
+            isSameAsScanned( o2, items, isIn, rand ) &&
+            isSameAsScanned( o3, items, isIn, rand ) &&
+            isSameAsScanned( o4, items, isIn, rand );
+      }
+
+      // collapse: every branch holds more than the max
+      o1.collapse();
+      o2.collapse();
+      o3.collapse();
+      o4.collapse();
+      o5.collapse();
+      isOk &= isBranchsOver( o1, maxItems ) &&
+         isBranchsOver( o3, maxItems ) &&
+         isBranchsOver( o4, maxItems ) &&
+         isBranchsOver( o5, maxItems );
+      isOk &= isCountedStats( o1, itemCount ) &&
+         isCountedStats( o2, itemCount ) &&
+         isCountedStats( o3, itemCount ) &&
+         isCountedStats( o4, itemCount ) &&
+         isCountedStats( o5, itemCount );
+      isOk &= isSameAsScanned( o1, items, isIn, rand ) &&
+         isSameAsScanned( o2, items, isIn, rand ) &&
+         isSameAsScanned( o3, items, isIn, rand ) &&
+         isSameAsScanned( o4, items, isIn, rand );
+
+      if( pOut )
+      {
+         *pOut << i << " " << isOk << "\n";
+      }
+   }
+
+   if( pOut )
+   {
+      *pOut << "\n--- testCommands22: " << isOk << "\n";
+   }
+
+   return isOk;
+}
+
+
+bool testCommands23
+(
+   std::ostream* pOut,
+   const bool    ,//isVerbose,
+   const dword   seed
+)
+{
+   // Guided removal:
+   //
+   // Make a branch by inserting one item too many into a leaf, one of them a
+   // block across all subcells, and check removing items collapses it to one
+   // leaf exactly when its item refs fall to the threshold, with every ref of
+   // a removed item gone, and removing an item not held changes nothing.
+   // Then generate some random octrees, filled with random items, some of
+   // them large blocks (held in many cells), and some never inserted. Remove
+   // random runs, and again, checking remove reports only items held, each
+   // cell's item ref count is the refs held in and below it, the stats and
+   // info agree with visiting, and box, nearest, and ray queries find the
+   // same as testing every item held. Then remove all, checking it ends
+   // empty.
+
+   bool isOk = true;
+
+   if( pOut )
+   {
+      *pOut << "\n\n";
+   }
+
+   RandomFast rand( seed );
+   if( pOut )
+   {
+      *pOut << "\nseed= " << rand.getDword() << "\n\n";
+   }
+
+   const OctreeAgentTest a;
+
+   // one too many
+   {
+      // four points, one in each lower-z subcell, and a block across all
+      std::vector<OctreeItemTest> items;
+      for( dword j = 0;  j < 4;  ++j )
+      {
+         items.push_back( OctreeItemTest( Vector3r( 0.25f + (0.5f *
+            static_cast<real>(j & 1)), 0.25f + (0.5f * static_cast<real>(j >>
+            1)), 0.25f ), Vector3r::ZERO() ) );
+      }
+      items.push_back( OctreeItemTest( Vector3r( 0.4f, 0.4f, 0.4f ),
+         Vector3r( 0.2f, 0.2f, 0.2f ) ) );
+      const OctreeItemTest other( Vector3r( 0.7f, 0.7f, 0.7f ) );
+
+      Octree<OctreeItemTest> o( Vector3r::ZERO(), 1.0f, 4, 4, 0.001f );
+      for( dword j = 0;  j < 5;  ++j )
+      {
+         o.insert( items[j], a );
+      }
+
+      // a branch of eight leafs: the points once, the block in each
+      OctreeStats stats;
+      o.getStats( stats );
+      isOk &= (1 == stats.getBranchCount()) && (8 == stats.getLeafCount()) &&
+         (12 == stats.getItemRefCount()) && isRefCounted( o ) &&
+         isCountedStats( o, 5 );
+
+      // not held: nothing changes
+      isOk &= !o.remove( other, a );
+      o.getStats( stats );
+      isOk &= (12 == stats.getItemRefCount()) && isCountedStats( o, 5 );
+
+      // the block: down to 4 refs, the threshold, so one leaf, then again
+      isOk &= o.remove( items[4], a );
+      o.getStats( stats );
+      isOk &= (0 == stats.getBranchCount()) && (1 == stats.getLeafCount()) &&
+         (4 == stats.getItemRefCount()) && isRefCounted( o ) &&
+         isCountedStats( o, 4 );
+      isOk &= !o.remove( items[4], a );
+
+      // branch again, then a point: 11 refs, though only 4 items, so still a
+      // branch, then the block: 3 refs, so one leaf
+      o.insert( items[4], a );
+      o.getStats( stats );
+      isOk &= (1 == stats.getBranchCount()) && isCountedStats( o, 5 );
+      isOk &= o.remove( items[0], a );
+      o.getStats( stats );
+      isOk &= (1 == stats.getBranchCount()) &&
+         (11 == stats.getItemRefCount()) && isRefCounted( o ) &&
+         isCountedStats( o, 4 );
+      isOk &= o.remove( items[4], a );
+      o.getStats( stats );
+      isOk &= (0 == stats.getBranchCount()) && (1 == stats.getLeafCount()) &&
+         (3 == stats.getItemRefCount()) && isRefCounted( o ) &&
+         isCountedStats( o, 3 );
+   }
+
+   // loop
+   for( dword i = 0;  i < 20;  ++i )
+   {
+      std::auto_ptr<Octree<OctreeItemTest> > po1;
+      std::vector<OctreeItemTest>            items;
+      makeRandomOctree( rand, po1 );
+      makeRandomItems( rand, (i & 1) ? 2000 : 200, po1->getPosition(),
+         po1->getSize(), items );
+
+      // some large blocks (up to a quarter of the root)
+      for( udword j = 0;  j < items.size();  j += 8 )
+      {
+         const Vector3r dimensions( rand.next().getFloat(),
+            rand.next().getFloat(), rand.next().getFloat() );
+         items[j] = OctreeItemTest( items[j].getPosition(),
+            dimensions * (po1->getSize() * 0.25f) );
+      }
+
+      // insert all but the last tenth
+      dword itemCount = static_cast<dword>(items.size()) -
+         (static_cast<dword>(items.size()) / 10);
+      po1->insertRange( &items[0], itemCount, a );
+      std::vector<bool> isIn( items.size(), false );
+      std::fill( isIn.begin(), isIn.begin() + itemCount, true );
+
+      for( dword j = 0;  j < 4;  ++j )
+      {
+         isOk &= isRefCounted( *po1 ) && isCountedStats( *po1, itemCount ) &&
+            isSameAsScanned( *po1, items, isIn, rand );
+
+         // remove a random run, then the same again (none held)
+         const dword begin  = (rand.next().getUdword() >> 8) % items.size();
+         const dword length = (rand.next().getUdword() >> 8) %
+            (items.size() - begin);
+         for( dword k = begin;  k < begin + length;  ++k )
+         {
+            isOk &= (po1->remove( items[k], a ) == isIn[k]);
+            itemCount -= isIn[k] ? 1 : 0;
+            isIn[k] = false;
+         }
+         for( dword k = begin;  k < begin + length;  ++k )
+         {
+            isOk &= !po1->remove( items[k], a );
+         }
+      }
+
+      // remove all
+      for( udword j = 0;  j < items.size();  ++j )
+      {
+         isOk &= (po1->remove( items[j], a ) == isIn[j]);
+      }
+      isOk &= po1->isEmpty() && isCountedStats( *po1, 0 );
+
+      if( pOut )
+      {
+         *pOut << i << " " << isOk << "\n";
+      }
+   }
+
+   if( pOut )
+   {
+      *pOut << "\n--- testCommands23: " << isOk << "\n";
+   }
+
+   return isOk;
+}
+
+
+bool testCommands24
+(
+   std::ostream* pOut,
+   const bool    ,//isVerbose,
+   const dword   seed
+)
+{
+   // Pool slots:
+   //
+   // Make slot pools of a few sizes, allocate random counts of slots (within
+   // one slab, and across many), free a random part of them in random order,
+   // then allocate again. Check slots are whole words and apart, freed ones
+   // are reused before more storage is taken, and freeAll destroys each live
+   // slot once, and no freed one (each slot holds a pointer to its destroy
+   // count twice, so one is left when freed). Then check the pool is empty,
+   // and usable again.
+
+   bool isOk = true;
+
+   if( pOut )
+   {
+      *pOut << "\n\n";
+   }
+
+   RandomFast rand( seed );
+   if( pOut )
+   {
+      *pOut << "\nseed= " << rand.getDword() << "\n\n";
+   }
+
+   // loop
+   for( dword i = 0;  i < 20;  ++i )
+   {
+      // two to four words (a byte short, sometimes, to round up)
+      const dword    slotSize = static_cast<dword>((2 + (i % 3)) *
+         sizeof(void*));
+      OctreeSlotPool pool( slotSize - (i & 1) );
+      isOk &= (pool.getSlotSize() == slotSize) && (0 == pool.getByteSize());
+
+      // allocate
+      const dword count = 1 + ((rand.next().getUdword() >> 8) %
+         ((i & 2) ? 2000 : 100));
+      std::vector<void*> slots( count );
+      std::vector<dword> destroyCounts( count, 0 );
+      for( dword j = 0;  j < count;  ++j )
+      {
+         slots[j] = pool.allocate();
+         static_cast<dword**>( slots[j] )[0] = &destroyCounts[j];
+         static_cast<dword**>( slots[j] )[1] = &destroyCounts[j];
+      }
+
+      // whole words, and apart
+      std::vector<char*> sorted( count );
+      for( dword j = 0;  j < count;  ++j )
+      {
+         sorted[j] = static_cast<char*>( slots[j] );
+         isOk &= (0 == (reinterpret_cast<std::size_t>(sorted[j]) %
+            sizeof(void*)));
+      }
+      std::sort( sorted.begin(), sorted.end() );
+      for( dword j = 1;  j < count;  ++j )
+      {
+         isOk &= (sorted[j] - sorted[j - 1] >= slotSize);
+      }
+      const dword byteSize = pool.getByteSize();
+      isOk &= (byteSize >= (count * pool.getSlotSize()));
+
+      // free a random part, in random order (shuffled)
+      std::vector<dword> order( count );
+      for( dword j = 0;  j < count;  ++j )
+      {
+         order[j] = j;
+      }
+      for( dword j = count;  j-- > 1; )
+      {
+         std::swap( order[j], order[(rand.next().getUdword() >> 8) %
+            (j + 1)] );
+      }
+      const dword freeCount = (rand.next().getUdword() >> 8) % (count + 1);
+      std::vector<bool> isLive( count, true );
+      std::set<void*>   freed;
+      for( dword j = 0;  j < freeCount;  ++j )
+      {
+         pool.free( slots[order[j]] );
+         isLive[order[j]] = false;
+         freed.insert( slots[order[j]] );
+      }
+      pool.free( 0 );
+
+      // allocate again, some: only freed slots, and no more storage
+      for( dword j = freeCount / 2;  j-- > 0; )
+      {
+         void*const pSlot = pool.allocate();
+         isOk &= (1 == freed.erase( pSlot ));
+
+         const dword k = static_cast<dword>(std::find( slots.begin(),
+            slots.end(), pSlot ) - slots.begin());
+         isOk &= (k < count) && !isLive[k];
+         if( k < count )
+         {
+            static_cast<dword**>( pSlot )[0] = &destroyCounts[k];
+            isLive[k] = true;
+         }
+      }
+      isOk &= (pool.getByteSize() == byteSize);
+
+      // free all: each live slot destroyed once, and no freed one
+      pool.freeAll( &destroySlotTest );
+      for( dword j = 0;  j < count;  ++j )
+      {
+         isOk &= (destroyCounts[j] == (isLive[j] ? 1 : 0));
+      }
+      isOk &= (0 == pool.getByteSize());
+
+      // usable again (and freed by destruction)
+      isOk &= (0 != pool.allocate()) && (0 != pool.getByteSize());
+
+      if( pOut )
+      {
+         *pOut << i << " " << isOk << "\n";
+      }
+   }
+
+   if( pOut )
+   {
+      *pOut << "\n--- testCommands24: " << isOk << "\n";
+   }
+
+   return isOk;
+}
+
+
+bool testCommands25
+(
+   std::ostream* pOut,
+   const bool    ,//isVerbose,
+   const dword   seed
+)
+{
+   // Arrays:
+   //
+   // Append random counts of elements, checking capacity grows only when
+   // full, and then doubles (from one), with every element kept. Set random
+   // lengths, shorter and longer, checking the elements up to the lesser of
+   // the lengths are kept, and capacity grows only beyond it, to the length.
+   // Shrink to fit, checking capacity is the length, with the elements kept.
+   // Then give arrays external storage (buffers owned here): checking the
+   // elements are copied into it, it is used in place, and growing beyond it
+   // or shrinking moves the elements out, leaving it as it was, and neither
+   // that nor destruction deletes it.
+
+   bool isOk = true;
+
+   if( pOut )
+   {
+      *pOut << "\n\n";
+   }
+
+   RandomFast rand( seed );
+   if( pOut )
+   {
+      *pOut << "\nseed= " << rand.getDword() << "\n\n";
+   }
+
+   // loop
+   for( dword i = 0;  i < 20;  ++i )
+   {
+      // append
+      Array<dword>       a;
+      std::vector<dword> values;
+      const dword count = (rand.next().getUdword() >> 8) % 1000;
+      for( dword j = 0;  j < count;  ++j )
+      {
+         const dword capacity = a.getCapacity();
+         const bool  isFull   = (a.getLength() == capacity);
+
+         values.push_back( rand.next().getDword() );
+         a.append( values.back() );
+
+         isOk &= (a.getCapacity() == (isFull ? (capacity ? capacity * 2 :
+            1) : capacity));
+      }
+      isOk &= (a.getLength() == count) && std::equal( values.begin(),
+         values.end(), a.getStorage() );
+
+      // set lengths, shorter and longer
+      for( dword j = 0;  j < 8;  ++j )
+      {
+         const dword capacity = a.getCapacity();
+         const dword length   = (rand.next().getUdword() >> 8) %
+            ((capacity * 2) + 8);
+         const dword kept     = (length < a.getLength()) ? length :
+            a.getLength();
+
+         a.setLength( length );
+         isOk &= (a.getLength() == length) && (a.getCapacity() ==
+            ((length > capacity) ? length : capacity)) && std::equal(
+            values.begin(), values.begin() + kept, a.getStorage() );
+
+         // (added elements are unspecified: make them known)
+         values.resize( length );
+         for( dword k = kept;  k < length;  ++k )
+         {
+            a[k] = values[k] = rand.next().getDword();
+         }
+      }
+
+      // shrink to fit
+      a.shrinkToFit();
+      isOk &= (a.getCapacity() == a.getLength()) &&
+         (a.getLength() == static_cast<dword>(values.size())) &&
+         std::equal( values.begin(), values.end(), a.getStorage() );
+
+      // external storage, with a mark after the part used
+      const dword        mark = 0x5A5A5A5A;
+      const dword        size = 1 + ((rand.next().getUdword() >> 8) % 64);
+      dword*const        buffer = new dword[ size + 1 ];
+      std::fill( buffer, buffer + size + 1, mark );
+      {
+         // used in place, until grown beyond
+         Array<dword> e( &buffer[0], size );
+         isOk &= e.isStorageExternal() && (e.getCapacity() == size) &&
+            (e.getStorage() == &buffer[0]);
+         for( dword j = 0;  j < size;  ++j )
+         {
+            e.append( j );
+         }
+         isOk &= e.isStorageExternal() && (e.getStorage() == &buffer[0]) &&
+            (e.getCapacity() == size) && (mark == buffer[size]);
+
+         e.append( size );
+         isOk &= !e.isStorageExternal() && (e.getStorage() != &buffer[0]) &&
+            (e.getLength() == size + 1);
+         for( dword j = 0;  j <= size;  ++j )
+         {
+            isOk &= (e[j] == j) && ((j == size) || (buffer[j] == j));
+         }
+      }
+      {
+         // elements copied in, then moved out by shrinking
+         Array<dword> e( a );
+         const dword length = (e.getLength() <= size) ? e.getLength() :
+            size;
+         e.setLength( length );
+         e.useExternalStorage( &buffer[0], size );
+         isOk &= e.isStorageExternal() && (e.getStorage() == &buffer[0]) &&
+            (e.getLength() == length) && std::equal( values.begin(),
+            values.begin() + length, &buffer[0] ) && (mark == buffer[size]);
+
+         e.shrinkToFit();
+         isOk &= ((length < size) ? !e.isStorageExternal() :
+            e.isStorageExternal()) && (e.getLength() == length) &&
+            std::equal( values.begin(), values.begin() + length,
+            e.getStorage() ) && std::equal( values.begin(), values.begin() +
+            length, &buffer[0] );
+      }
+      // (the buffer still its own: deleted here, once)
+      isOk &= (mark == buffer[size]);
+      delete[] buffer;
+
+      if( pOut )
+      {
+         *pOut << i << " " << isOk << "\n";
+      }
+   }
+
+   if( pOut )
+   {
+      *pOut << "\n--- testCommands25: " << isOk << "\n";
+   }
+
+   return isOk;
+}
+
+
+bool testCommands26
+(
+   std::ostream* pOut,
+   const bool    ,//isVerbose,
+   const dword   seed
+)
+{
+   // Leaf inline items:
+   //
+   // Make an octree that is one leaf (of many items), then insert items up
+   // past the inline limit, remove them down to one, insert up past it again,
+   // and remove all -- each time in random order. Check after each change the
+   // leaf holds just the items inserted and not removed, and its items are
+   // inline exactly when expected: from the start, until beyond the limit,
+   // then again when removing brings it to half or less (and not when
+   // inserting does). Inline items add nothing to the leaf's byte size.
+
+   bool isOk = true;
+
+   if( pOut )
+   {
+      *pOut << "\n\n";
+   }
+
+   RandomFast rand( seed );
+   if( pOut )
+   {
+      *pOut << "\nseed= " << rand.getDword() << "\n\n";
+   }
+
+   const OctreeAgentTest a;
+   const dword           limit = OCTREE_LEAF_INLINE_ITEMS;
+
+   // loop
+   for( dword i = 0;  i < 10;  ++i )
+   {
+      Octree<OctreeItemTest>      o( Vector3r::ZERO(), 1.0f, 4 * limit, 4,
+         0.001f );
+      std::vector<OctreeItemTest> items;
+      makeRandomItems( rand, (2 * limit) + 1, o.getPosition(), o.getSize(),
+         items );
+
+      // up past the limit, down to one, up again, then down to none
+      const dword       ends[] = { 0, static_cast<dword>(items.size()), 1,
+         static_cast<dword>(items.size()), 0 };
+      std::vector<bool> isIn( items.size(), false );
+      dword             length   = 0;
+      bool              isInline = true;
+      for( udword e = 1;  e < sizeof(ends) / sizeof(ends[0]);  ++e )
+      {
+         const bool isInserting = (ends[e] > ends[e - 1]);
+         while( length != ends[e] )
+         {
+            // a random item not held (inserting) or held (removing)
+            dword k = (rand.next().getUdword() >> 8) % items.size();
+            while( isIn[k] == isInserting )
+            {
+               k = (k + 1) % items.size();
+            }
+
+            if( isInserting )
+            {
+               o.insert( items[k], a );
+               ++length;
+               isInline &= (length <= limit);
+            }
+            else
+            {
+               isOk &= o.remove( items[k], a );
+               --length;
+               isInline |= (length <= (limit / 2));
+            }
+            isIn[k] = isInserting;
+
+            // the items held, in one leaf (or none)
+            OctreeVisitorTest v( o );
+            o.visit( v );
+            const std::vector<OctreeVisitorTest::LeafData>& leafs =
+               v.getLeafs();
+            isOk &= (leafs.size() == (length ? 1u : 0u));
+
+            std::set<const OctreeItemTest*> held;
+            for( udword j = 0;  j < items.size();  ++j )
+            {
+               if( isIn[j] )
+               {
+                  held.insert( &items[j] );
+               }
+            }
+            if( !leafs.empty() )
+            {
+               const Array<const OctreeItemTest*>& leafItems =
+                  leafs[0].second;
+               isOk &= (leafItems.getLength() == length) &&
+                  (held == std::set<const OctreeItemTest*>(
+                  leafItems.getStorage(), leafItems.getStorage() +
+                  leafItems.getLength() ));
+            }
+
+            // inline exactly when expected
+            OctreeStats stats;
+            o.getStats( stats );
+            isOk &= !length || ((stats.getByteSize() ==
+               static_cast<dword>(sizeof(OctreeLeaf))) == isInline);
+            isOk &= isCountedStats( o, length );
+         }
+      }
+      isOk &= o.isEmpty();
+
+      if( pOut )
+      {
+         *pOut << i << " " << isOk << "\n";
+      }
+   }
+
+   if( pOut )
+   {
+      *pOut << "\n--- testCommands26: " << isOk << "\n";
+   }
+
+   return isOk;
+}
 
 
+bool testCommands27
+(
+   std::ostream* pOut,
+   const bool    ,//isVerbose,
+   const dword   seed
+)
+{
+   // Parallel bulk insertion:
+   //
+   // Generate some random octrees and items, some of them large blocks
+   // (covering cells, so held at branchs). Insert them with insertRange on
+   // the calling thread into one copy, and on one to eight threads into
+   // another -- for some, after inserting a first part one at a time into
+   // both. Check both hold the same items in each leaf and at each branch,
+   // and have the same stats, counting all the items, and each cell's item
+   // ref count is the refs held in and below it. (Stats are not checked
+   // against visiting: a point on a cell boundary is in no subcell, by the
+   // test agent, so is counted but not held -- alike in both.)
+
+   bool isOk = true;
 
+   if( pOut )
+   {
+      *pOut << "\n\n";
+   }
 
+   RandomFast rand( seed );
+   if( pOut )
+   {
+      *pOut << "\nseed= " << rand.getDword() << "\n\n";
+   }
 
+   const OctreeAgentTest a;
 
+   // loop
+   for( dword i = 0;  i < 20;  ++i )
+   {
+      std::auto_ptr<Octree<OctreeItemTest> > po1;
+      makeRandomOctree( rand, po1 );
+      Octree<OctreeItemTest> o2( *po1 );
 
+      const dword itemCount = (i & 2) ? 3000 : 200;
+      std::vector<OctreeItemTest> items;
+      makeRandomItems( rand, itemCount, po1->getPosition(), po1->getSize(),
+         items );
 
-/// test functions /////////////////////////////////////////////////////////////
+      // some large blocks (up to half the root)
+      for( udword j = 0;  j < items.size();  j += 16 )
+      {
+         const Vector3r dimensions( rand.next().getFloat(),
+            rand.next().getFloat(), rand.next().getFloat() );
+         items[j] = OctreeItemTest( items[j].getPosition(),
+            dimensions * (po1->getSize() * 0.5f) );
+      }
 
-void hxa7241_graphics::preTest()
-{
-   // make items
-   OctreeItemTest item1( Vector3r( 1, 1, 1 ) );
-   OctreeItemTest item2( Vector3r( 3, 3, 3 ) );
-   OctreeItemTest item3( Vector3r( 4, 4, 4 ) );
+      // a first part one at a time, for some
+      const dword first = (i & 1) ? (rand.next().getUdword() % itemCount) : 0;
+      for( dword j = 0;  j < first;  ++j )
+      {
+         po1->insert( items[j], a );
+         o2.insert( items[j], a );
+      }
 
-   // make octree
-   Vector3r position( 0, 0, 0 );
-   real     size      = 5.0f;
-   dword    maxItems  = 1;
-   dword    maxLevels = 4;
+      // the rest in bulk: serially, and in parallel
+      const dword threadCount = 1 + (i % 8);
+      isOk &= (po1->insertRange( &items[first], itemCount - first, a ) ==
+         (itemCount - first));
+      isOk &= (o2.insertRange( &items[first], itemCount - first, a,
+         threadCount ) == (itemCount - first));
 
-   Octree<OctreeItemTest> o1( position, size, maxItems, maxLevels, 0.001f );
+      // the same items in each cell
+      OctreeVisitorTest v1( *po1 );
+      po1->visit( v1 );
+      OctreeVisitorTest v2( o2 );
+      o2.visit( v2 );
+      isOk &= isSameCellItems( v1.getLeafs(), v2.getLeafs() ) &&
+         isSameCellItems( v1.getBranchItems(), v2.getBranchItems() );
 
-   // insert items into octree
-   OctreeAgentTest a;
-   o1.insert( item1, a );
-   o1.insert( item2, a );
-   o1.insert( item3, a );
+      // the same stats, and ref counts
+      OctreeStats stats;
+      o2.getStats( stats );
+      isOk &= isSameStats( *po1, o2 ) && (stats.getItemCount() == itemCount) &&
+         isRefCounted( *po1 ) && isRefCounted( o2 );
 
-   // stream out octree
-   OctreeStreamOut<OctreeItemTest> vso( std::cout, true );
-   o1.visit( vso );
-}
+      if( pOut )
+      {
+         *pOut << i << " " << isOk << "  " << threadCount << "\n";
+      }
+   }
 
+   if( pOut )
+   {
+      *pOut << "\n--- testCommands27: " << isOk << "\n";
+   }
 
+   return isOk;
+}
 
 
-bool hxa7241_graphics::test_Octree
+bool testCommands28
 (
    std::ostream* pOut,
-   const bool    isVerbose,
-   dword         seed
+   const bool    ,//isVerbose,
+   const dword   seed
 )
 {
-   if( 0 == seed )
+   // Snapshots on other threads:
+   //
+   // Generate some random octrees, holding half of some random items. Take an
+   // O(1) snapshot of each, and on another thread query it repeatedly, then
+   // destroy it, while the original is changed (and snapshotted again) on
+   // this one. Check the snapshot always held what the original did when
+   // taken, and the original ends with each cell's item ref count the refs
+   // held in and below it. (Run under a thread checker, this checks shares
+   // and the allocator are safe between threads.)
+
+   bool isOk = true;
+
+   if( pOut )
    {
-      seed = static_cast<dword>(::time(0));
+      *pOut << "\n\n";
    }
 
+   RandomFast rand( seed );
    if( pOut )
    {
-      pOut->flags( std::ios_base::boolalpha );// | std::ios_base::uppercase );
+      *pOut << "\nseed= " << rand.getDword() << "\n\n";
    }
 
-   return testConstruction( pOut, isVerbose, seed ) &&
-      testCommands( pOut, isVerbose, seed );
-}
+   const OctreeAgentTest a;
 
+   // loop
+   for( dword i = 0;  i < 20;  ++i )
+   {
+      std::auto_ptr<Octree<OctreeItemTest> > po1;
+      std::vector<OctreeItemTest>            items;
+      makeRandomOctree( rand, po1 );
+      makeRandomItems( rand, (i & 1) ? 2000 : 200, po1->getPosition(),
+         po1->getSize(), items );
+      po1->insertRange( &items[0], items.size() / 2, a );
 
+      // read a snapshot on one thread, change the original on the other
+      {
+         OctreeSnapshotTaskTest reader( *(new Octree<OctreeItemTest>( *po1 )),
+            items, false );
+         OctreeSnapshotTaskTest writer( *po1, items, true );
+         OctreeTaskV* tasks[] = { &reader, &writer };
+         {
+            OctreeTaskPool pool( 2 );
+            pool.runAll( tasks, 2 );
+         }
 
+         isOk &= reader.isOk() && writer.isOk() && isRefCounted( *po1 );
+      }
 
-bool testConstruction
+      if( pOut )
+      {
+         *pOut << i << " " << isOk << "\n";
+      }
+   }
+
+   if( pOut )
+   {
+      *pOut << "\n--- testCommands28: " << isOk << "\n";
+   }
+
+   return isOk;
+}
+
+
+bool testCommands29
 (
    std::ostream* pOut,
-   const bool    isVerbose,
+   const bool    ,//isVerbose,
    const dword   seed
 )
 {
-   // Copying:
+   // Readers during publish:
    //
-   // Generate some random octrees. Copy each and check it is identical to
-   // its original in value, and check all octree object ids are different.
+   // Generate some random concurrent octrees and items. Run one to seven
+   // readers on threads, each repeatedly acquiring the current version and
+   // querying it, while a writer inserts and removes the items in small
+   // batches, publishing after each -- so acquiring often meets publishing,
+   // and version slots are freed and reused under the readers. Check the
+   // readers only ever see whole published versions, and all old versions
+   // are freed once their readers are gone. (Run under a thread checker,
+   // this checks acquire and release are safe without locking.)
 
    bool isOk = true;
 
+   if( pOut )
+   {
+      *pOut << "\n\n";
+   }
+
    RandomFast rand( seed );
    if( pOut )
    {
-      *pOut << "\nseed= " << rand.getDword() << "\n";
+      *pOut << "\nseed= " << rand.getDword() << "\n\n";
    }
 
    // loop
-   for( dword i = 0;  i < 10;  ++i )
+   for( dword i = 0;  i < 8;  ++i )
    {
       std::auto_ptr<Octree<OctreeItemTest> > po1;
       std::vector<OctreeItemTest>            items;
-      makeRandomFilledOctree( rand, 30, po1, items );
-
-      if( (*pOut != 0) && isVerbose )
+      makeRandomOctree( rand, po1 );
+      makeRandomItems( rand, (i & 1) ? 600 : 120, po1->getPosition(),
+         po1->getSize(), items );
+      OctreeConcurrent<OctreeItemTest> o2( po1->getPosition(), po1->getSize(),
+         po1->getMaxItemCountPerCell(), po1->getMaxLevelCount(),
+         po1->getMinCellSize() );
+
+      // (give the items some extent, as testCommands15)
+      for( udword k = 0;  k < items.size();  ++k )
       {
-         OctreeStreamOut<OctreeItemTest> so( *pOut, true );
-         po1->visit( so );
-         *pOut << "\n";
+         items[k] = OctreeItemTest( items[k].getPosition(),
+            items[k].getDimensions() + (Vector3r::ONE() * (po1->getSize() *
+            0.0001f)) );
       }
 
-      // make copy octree
-      Octree<OctreeItemTest> o2( *po1 );
-
+      // one writer, and some readers
+      const dword batchLength = (i & 2) ? 3 : 1;
+      const dword readerCount = 1 + (i % 7);
+      std::vector<OctreeConcurrentTaskTest*> tasks;
+      tasks.push_back( new OctreeConcurrentTaskTest( o2, items, batchLength,
+         true ) );
+      for( dword k = 0;  k < readerCount;  ++k )
       {
-         // stream out each to string
-         std::ostringstream ss1;
-         OctreeStreamOut<OctreeItemTest> so1( ss1, false );
-         po1->visit( so1 );
-         std::ostringstream ss2;
-         OctreeStreamOut<OctreeItemTest> so2( ss2, false );
-         o2.visit( so2 );
-
-         // compare strings
-         isOk &= (ss1.str() == ss2.str());
+         tasks.push_back( new OctreeConcurrentTaskTest( o2, items,
+            batchLength, false ) );
       }
-
       {
-         // make arrays of octree object ids
-         OctreeVisitorTest v1( *po1 );
-         po1->visit( v1 );
-         OctreeVisitorTest v2( o2 );
-         o2.visit( v2 );
-
-         isOk &= (v1.getIds().size() == v2.getIds().size());
+         std::vector<OctreeTaskV*> tasksV( tasks.begin(), tasks.end() );
+         OctreeTaskPool pool( readerCount + 1 );
+         pool.runAll( &tasksV[0], static_cast<dword>(tasksV.size()) );
+      }
 
-         // check set intersection of ids is empty
-         std::vector<const void*> ids1( v1.getIds() );
-         std::vector<const void*> ids2( v2.getIds() );
-         std::sort( ids1.begin(), ids1.end() );
-         std::sort( ids2.begin(), ids2.end() );
-         std::vector<const void*> intersect;
-         std::set_intersection( ids1.begin(), ids1.end(),
-                           ids2.begin(), ids2.end(),
-                           intersect.begin() );
-         isOk &= intersect.empty();
+      for( udword k = 0;  k < tasks.size();  ++k )
+      {
+         isOk &= tasks[k]->isOk();
+         delete tasks[k];
       }
 
+      // check all old versions are freed, once their readers are gone
+      o2.publish();
+      isOk &= (1 == o2.getVersionCount());
+
       if( pOut )
       {
-         *pOut << i << " " << isOk << "\n";
+         *pOut << i << " " << isOk << "  " << readerCount << "\n";
       }
    }
 
    if( pOut )
    {
-      *pOut << "\n--- testConstruction: " << isOk << "\n";
+      *pOut << "\n--- testCommands29: " << isOk << "\n";
    }
 
    return isOk;
 }
 
 
-bool testCommands
+template<class OCTREE>
+bool testVisitParallel
 (
-   std::ostream* pOut,
-   const bool    isVerbose,
-   const dword   seed
+   const OCTREE&   octree,
+   const Vector3r& lowerCorner,
+   const Vector3r& upperCorner
 )
 {
-   return testCommands1( pOut, isVerbose, seed ) &&
-          testCommands2( pOut, isVerbose, seed ) &&
-          testCommands3( pOut, isVerbose, seed );
+   OctreeQueryTest query( lowerCorner, upperCorner );
+   octree.query( query );
+
+   OctreeVisitorParallelTest v1( lowerCorner, upperCorner );
+   octree.visitParallel( v1, 1 );
+   OctreeVisitorParallelTest v4( lowerCorner, upperCorner );
+   octree.visitParallel( v4, 4 );
+
+   return (v1.getItems() == query.getItems()) &&
+      (v4.getItems() == query.getItems()) && (v1.getSum() == v4.getSum());
 }
 
 
-bool testCommands1
+template<class OCTREE>
+bool isSameQueries
 (
-   std::ostream* pOut,
-   const bool    isVerbose,
-   const dword   //seed
+   const Octree<OctreeItemTest>& o1,
+   const OCTREE&                 o2,
+   RandomFast&                   rand
 )
 {
-   // simple structural test:
-   //
-   // 1) make octree with four item per leaf limit
-   // 2) add an item in each octant
-   // 3) check each item is in the correct octant
+   bool isOk = (o1.isEmpty() == o2.isEmpty());
 
-   bool isOk = true;
-
-   if( pOut )
+   // random box
+   const real size = o1.getSize();
+   real l[3];
+   real u[3];
+   for( dword k = 3;  k-- > 0; )
    {
-      *pOut << "\n\n";
+      const real p0 = rand.next().getFloat( size + 2.0f, -1.0f );
+      const real p1 = rand.next().getFloat( size + 2.0f, -1.0f );
+      l[k] = (p0 < p1) ? p0 : p1;
+      u[k] = (p0 < p1) ? p1 : p0;
    }
+   const Vector3r lower( o1.getPosition() + Vector3r( l[0], l[1], l[2] ) );
+   const Vector3r upper( o1.getPosition() + Vector3r( u[0], u[1], u[2] ) );
+
+   // same items in the box
+   const OctreeAgentTest        a;
+   Array<const OctreeItemTest*> found1;
+   Array<const OctreeItemTest*> found2;
+   o1.queryBox( lower, upper, a, found1 );
+   o2.queryBox( lower, upper, a, found2 );
+   std::sort( found1.getStorage(), found1.getStorage() + found1.getLength() );
+   std::sort( found2.getStorage(), found2.getStorage() + found2.getLength() );
+   isOk &= (found1.getLength() == found2.getLength()) && std::equal(
+      found1.getStorage(), found1.getStorage() + found1.getLength(),
+      found2.getStorage() );
+
+   // same nearest distances (to the box's lower corner)
+   Array<real> distances1;
+   Array<real> distances2;
+   o1.queryNearest( lower, 5, REAL_MAX, a, found1, distances1 );
+   o2.queryNearest( lower, 5, REAL_MAX, a, found2, distances2 );
+   isOk &= (distances1.getLength() == distances2.getLength()) && std::equal(
+      distances1.getStorage(), distances1.getStorage() +
+      distances1.getLength(), distances2.getStorage() );
+
+   // same by parallel visit
+   isOk &= testVisitParallel( o2, lower, upper );
 
+   return isOk;
+}
 
-   // make octree
-   Octree<OctreeItemTest> o1( Vector3r::ZERO(), 2, 4, 4, 0.0001f );
 
-   // make items
-   std::vector<OctreeItemTest> i1(8);
-   OctreeAgentTest a;
-   for( dword i = 0;  i < 8;  ++i )
-   {
-      // add item in each octant
-      const Vector3r position( static_cast<real>(i & 1)        + 0.25f,
-                               static_cast<real>((i >> 1) & 1) + 0.25f,
-                               static_cast<real>((i >> 2) & 1) + 0.25f );
-      i1[i] = OctreeItemTest( position, Vector3r::HALF(), i );
-      o1.insert( i1[i], a );
+bool changeAlike
+(
+   RandomFast&                        rand,
+   Octree<OctreeItemTest>&            o1,
+   Octree<OctreeItemTest>&            o2,
+   const std::vector<OctreeItemTest>& items
+)
+{
+   bool isOk = true;
 
-      if( pOut && isVerbose )
+   const OctreeAgentTest a;
+
+   // insertRange (on one thread or several), insert, or remove a run of
+   // items
+   const dword op     = rand.next().getUdword() >> 30;
+   const dword begin  = (rand.next().getUdword() >> 8) % items.size();
+   const dword length = (rand.next().getUdword() >> 8) %
+      (items.size() - begin) % 300;
+   for( dword k = begin;  k < begin + length;  ++k )
+   {
+      if( 1 == op )
       {
-         *pOut << "item " << i << " :  " << i1[i] << "\n";
+         isOk &= (o1.insert( items[k], a ) == o2.insert( items[k], a ));
+      }
+      else if( 1 < op )
+      {
+         isOk &= (o1.remove( items[k], a ) == o2.remove( items[k], a ));
       }
    }
-   if( pOut && isVerbose )
+   if( 0 == op )
    {
-      *pOut << "\n";
+      isOk &= (o1.insertRange( &items[begin], length, a, (begin & 1) ? 4 :
+         1 ) == o2.insertRange( &items[begin], length, a ));
    }
 
-   if( pOut && isVerbose )
-   {
-      OctreeStreamOut<OctreeItemTest> so( *pOut, true );
-      o1.visit( so );
-      *pOut << "\n";
-   }
+   return isOk;
+}
 
-   // make info from octree
-   OctreeVisitorTest v1( o1 );
-   o1.visit( v1 );
 
-   // step through leafs
-   const std::vector<OctreeVisitorTest::LeafData>& leafs( v1.getLeafs() );
-   for( udword j = leafs.size();  j-- > 0; )
+template<class OCTREE, class AGENT>
+void changeUniquely
+(
+   OCTREE&                            octree,
+   const AGENT&                       agent,
+   const std::vector<OctreeItemTest>& items,
+   const std::vector<bool>&           isIn,
+   const dword                        op,
+   const dword                        begin,
+   const dword                        length
+)
+{
+   // insertRange (after removing the held ones), insert the unheld ones, or
+   // remove all (so none is held twice)
+   for( dword k = begin;  k < begin + length;  ++k )
    {
-      const OctreeVisitorTest::LeafData& leaf( leafs[j] );
-
-      const Vector3r& cellLower( leaf.first.getBound().getLowerCorner() );
-      const Vector3r& cellUpper( leaf.first.getBound().getUpperCorner() );
-
-      // step through items
-      const Array<const OctreeItemTest*>& items( leaf.second );
-      for( int i = 0;  i < items.getLength();  ++i )
+      if( (0 == op) && isIn[k] )
       {
-         const OctreeItemTest* pItem = items[i];
-
-         const Vector3r itemLower( pItem->getPosition() );
-         const Vector3r itemUpper( itemLower + pItem->getDimensions() );
-
-         // check item is overlapping its leaf cell
-         const bool is =
-            OctreeAgentTest::isOverlapping( itemLower, itemUpper,
-                                             cellLower, cellUpper );
-         isOk &= is;
-         if( pOut && isVerbose )
-         {
-            *pOut << "overlap " << is << " :  " <<
-                     itemLower << "  " << itemUpper << "  " <<
-                     cellLower << "  " << cellUpper << "\n";
-         }
-
-         // check item is in correct leaf cell
-         const dword octantIndex = pItem->getPayload();
-         const Vector3r octantLower( static_cast<real>(octantIndex & 1),
-                                    static_cast<real>((octantIndex >> 1) & 1),
-                                    static_cast<real>((octantIndex >> 2) & 1) );
-         const Vector3r octantUpper( octantLower + Vector3r::ONE() );
-         isOk &= (cellLower == octantLower);
-         isOk &= (cellUpper == octantUpper);
-
-         if( pOut )
+         octree.remove( items[k], agent );
+      }
+      else if( 1 == op )
+      {
+         if( !isIn[k] )
          {
-            if( isVerbose )
-            {
-               *pOut << "\toctant match " << (cellLower == octantLower) <<
-                        " :  " << cellLower << "  " << octantLower << "\n";
-               *pOut << "\toctant match " << (cellUpper == octantUpper) <<
-                        " :  " << cellUpper << "  " << octantUpper << "\n";
-            }
-            else
-            {
-               *pOut << isOk << "\n";
-            }
+            octree.insert( items[k], agent );
          }
       }
+      else if( 1 < op )
+      {
+         octree.remove( items[k], agent );
+      }
+   }
+   if( 0 == op )
+   {
+      octree.insertRange( &items[begin], length, agent, (begin & 1) ? 4 : 1 );
    }
+}
 
-   if( pOut )
+
+template<class OCTREE>
+bool isCountedStats
+(
+   const OCTREE& octree,
+   const dword   itemCount
+)
+{
+   OctreeStats stats;
+   octree.getStats( stats );
+
+   OctreeVisitorStatsTest v;
+   octree.visit( v );
+   const OctreeStats& counted = v.getStats();
+
+   // same counts as visited
+   bool isOk = (stats.getItemCount() == itemCount) &&
+      (v.getItemCount() == itemCount) &&
+      (stats.getItemRefCount() == counted.getItemRefCount()) &&
+      (stats.getBranchCount() == counted.getBranchCount()) &&
+      (stats.getLeafCount() == counted.getLeafCount()) &&
+      (stats.getMaxDepth() == counted.getMaxDepth());
+   for( dword k = 0;  k < OctreeStats::LEVEL_COUNT;  ++k )
    {
-      *pOut << "\n--- testCommands1: " << isOk << "\n";
+      isOk &= (stats.getBranchCount( k ) == counted.getBranchCount( k )) &&
+         (stats.getLeafCount( k ) == counted.getLeafCount( k ));
+   }
+   for( dword k = 0;  k < OctreeStats::FILL_BUCKET_COUNT;  ++k )
+   {
+      isOk &= (stats.getFillCount( k ) == counted.getFillCount( k ));
    }
 
+   // info the same as stats
+   dword info[4];
+   octree.getInfo( info[0], info[1], info[2], info[3] );
+   isOk &= (info[0] >= stats.getByteSize()) &&
+      (info[1] == stats.getLeafCount()) &&
+      (info[2] == stats.getItemRefCount()) &&
+      (info[3] == stats.getMaxDepth());
+
    return isOk;
 }
 
 
-bool testCommands2
+template<class OCTREE1, class OCTREE2>
+bool isSameStats
 (
-   std::ostream* pOut,
-   const bool    ,//isVerbose,
-   const dword   seed
+   const OCTREE1& o1,
+   const OCTREE2& o2
 )
 {
-   // basic insert/remove test:
-   //
-   // insert a lot, visit to collect all items, check they are all there
-   // remove them all, get counts to check they all came out
+   OctreeStats s1;
+   o1.getStats( s1 );
+   OctreeStats s2;
+   o2.getStats( s2 );
+
+   bool isOk = (s1.getItemCount() == s2.getItemCount()) &&
+      (s1.getItemRefCount() == s2.getItemRefCount()) &&
+      (s1.getByteSize() == s2.getByteSize()) &&
+      (s1.getBranchCount() == s2.getBranchCount()) &&
+      (s1.getLeafCount() == s2.getLeafCount()) &&
+      (s1.getMaxDepth() == s2.getMaxDepth());
+   for( dword k = 0;  k < OctreeStats::LEVEL_COUNT;  ++k )
+   {
+      isOk &= (s1.getBranchCount( k ) == s2.getBranchCount( k )) &&
+         (s1.getLeafCount( k ) == s2.getLeafCount( k ));
+   }
+   for( dword k = 0;  k < OctreeStats::FILL_BUCKET_COUNT;  ++k )
+   {
+      isOk &= (s1.getFillCount( k ) == s2.getFillCount( k ));
+   }
+
+   return isOk;
+}
+
 
+template<class OCTREE>
+bool isCountedCalls
+(
+   OCTREE&                            octree,
+   const std::vector<OctreeItemTest>& items,
+   const dword                        first,
+   const dword                        removeCount
+)
+{
    bool isOk = true;
 
+   const OctreeAgentTest a;
 
-   if( pOut )
+   OctreeCounts counts;
+   octree.getCounts( counts, true );
+
+   // make calls of each kind
+   for( dword j = 0;  j < first;  ++j )
    {
-      *pOut << "\n\n";
+      octree.insert( items[j], a );
    }
-
-   RandomFast rand( seed );
-   if( pOut )
+   octree.insertRange( &items[first], items.size() - first, a );
+   for( dword j = 0;  j < removeCount;  ++j )
    {
-      *pOut << "\nseed= " << rand.getDword() << "\n\n";
+      octree.remove( items[j], a );
    }
 
-   for( dword j = 0;  j < 10;  ++j )
-   {
-      // make octree with items
-      std::auto_ptr<Octree<OctreeItemTest> > po1;
-      std::vector<OctreeItemTest>            i1;
-      makeRandomFilledOctree( rand, 100, po1, i1 );
+   const Vector3r               upper( octree.getPosition() +
+      Vector3r( octree.getSize(), octree.getSize(), octree.getSize() ) );
+   Array<const OctreeItemTest*> found;
+   Array<real>                  distances;
+   octree.queryBox( octree.getPosition(), upper, a, found );
+   octree.queryNearest( upper, 5, REAL_MAX, a, found, distances );
 
-//    // only for 10 or so items (otherwise > 14MB of output)
-//    if( pOut && isVerbose )
-//    {
-//       OctreeStreamOut<OctreeItemTest> so( *pOut, false );
-//       po1->visit( so );
-//       *pOut << "\n";
-//       for( udword i = 0;  i < i1.size();  ++i )
-//       {
-//          *pOut << i1[i] << "\n";
-//       }
-//    }
+   OctreeVisitorStatsTest v;
+   octree.visit( v );
 
-      // collect leafs items
-      OctreeVisitorTest v1( *po1 );
-      po1->visit( v1 );
+   octree.getCounts( counts, true );
 
-      dword byteSize, leafCount, itemRefCount, maxDepth;
-      po1->getInfo( byteSize, leafCount, itemRefCount, maxDepth );
+#ifdef OCTREE_INSTRUMENTED
+   // the calls made
+   isOk &= (counts.getCallCount( OctreeCounts::INSERT ) == first) &&
+      (counts.getCallCount( OctreeCounts::INSERT_RANGE ) == 1) &&
+      (counts.getCallCount( OctreeCounts::REMOVE ) == removeCount) &&
+      (counts.getCallCount( OctreeCounts::QUERY ) == 2) &&
+      (counts.getCallCount( OctreeCounts::VISIT ) == 1);
 
-      // check collection length equals info leaf count
-      isOk &= (v1.getLeafs().size() == static_cast<udword>(leafCount));
+   // consistent sums, for each kind of call
+   for( dword k = OctreeCounts::OPERATION_COUNT;  k-- > 0; )
+   {
+      const OctreeCounts::EOperation operation =
+         static_cast<OctreeCounts::EOperation>(k);
+      const OctreeCallCounts& c = counts.getCounts( operation );
 
-      // compare items list to leafs collection
+      dword cellCount = 0;
+      for( dword l = OctreeStats::LEVEL_COUNT;  l-- > 0; )
       {
-         const std::vector<OctreeVisitorTest::LeafData>& leafs( v1.getLeafs() );
+         cellCount += c.getCellCount( l );
+      }
+      dword callCount = 0;
+      for( dword b = OctreeCounts::LATENCY_BUCKET_COUNT;  b-- > 0; )
+      {
+         callCount += counts.getLatencyCount( operation, b );
+      }
 
-         std::set<const void*> i2s;
-         for( udword k = 0;  k < leafs.size();  ++k )
-         {
-            const Array<const OctreeItemTest*>& items( leafs[k].second );
-            for( dword m = 0;  m < items.getLength();  ++m )
-            {
-               i2s.insert( items[m] );
-            }
-         }
-         std::set<const void*> i1s;
-         for( udword k = 0;  k < i1.size();  ++k )
+      isOk &= (cellCount == c.getCellCount()) &&
+         (c.getExitCount() <= c.getTestCount()) &&
+         (callCount == counts.getCallCount( operation )) &&
+         (counts.getSlowestCounts( operation ).getCellCount() <=
+            c.getCellCount());
+   }
+   isOk &= (counts.getCounts( OctreeCounts::INSERT ).getTestCount() >=
+      first);
+
+   // each cell entered once by the visit
+   const OctreeStats&      stats = v.getStats();
+   const OctreeCallCounts& c     = counts.getCounts( OctreeCounts::VISIT );
+   isOk &= (c.getCellCount() == (stats.getBranchCount() +
+      stats.getLeafCount())) &&
+      (c.getDataCount() == c.getCellCount()) &&
+      (c.getItemScanCount() == stats.getItemRefCount());
+#endif
+
+   // none left after clearing (or ever, if not instrumented)
+   octree.getCounts( counts );
+   for( dword k = OctreeCounts::OPERATION_COUNT;  k-- > 0; )
+   {
+      const OctreeCounts::EOperation operation =
+         static_cast<OctreeCounts::EOperation>(k);
+      isOk &= (0 == counts.getCallCount( operation )) &&
+         (0 == counts.getCounts( operation ).getCellCount()) &&
+         (0 == counts.getCounts( operation ).getTestCount());
+   }
+
+   return isOk;
+}
+
+
+template<class OCTREE>
+bool isSameAsScanned
+(
+   const OCTREE&                      octree,
+   const std::vector<OctreeItemTest>& items,
+   const std::vector<bool>&           isIn,
+   RandomFast&                        rand
+)
+{
+   const OctreeAgentTest a;
+
+   // random box, and point and ray from its lower corner (in the root)
+   const real size = octree.getSize();
+   real l[3];
+   real u[3];
+   for( dword k = 3;  k-- > 0; )
+   {
+      const real p0 = rand.next().getFloat( size );
+      const real p1 = rand.next().getFloat( size );
+      l[k] = (p0 < p1) ? p0 : p1;
+      u[k] = (p0 < p1) ? p1 : p0;
+   }
+   const Vector3r lower( octree.getPosition() + Vector3r( l[0], l[1], l[2] ) );
+   const Vector3r upper( octree.getPosition() + Vector3r( u[0], u[1], u[2] ) );
+   Vector3r direction( rand.next().getFloat( 2.0f, -1.0f ),
+      rand.next().getFloat( 2.0f, -1.0f ),
+      rand.next().getFloat( 2.0f, -1.0f ) );
+   direction = direction / direction.length();
+
+   // expected, by testing every item held
+   std::vector<const OctreeItemTest*> inBox;
+   std::vector<real>                  distances;
+   real                               hitT = REAL_MAX;
+   for( udword k = 0;  k < items.size();  ++k )
+   {
+      if( isIn[k] )
+      {
+         const Vector3r itemLower( items[k].getPosition() );
+         const Vector3r itemUpper( itemLower + items[k].getDimensions() );
+         if( OctreeAgentTest::isOverlapping( itemLower, itemUpper, lower,
+            upper ) )
          {
-            i1s.insert( &(i1[k]) );
+            inBox.push_back( &items[k] );
          }
-
-         isOk &= (i1s == i2s);
+         distances.push_back( OctreeAgentTest::getDistance( itemLower,
+            itemUpper, lower ) );
+         hitT = std::min( hitT, OctreeAgentTest::getRayIntersection(
+            itemLower, itemUpper, lower, direction ) );
       }
+   }
+   std::sort( inBox.begin(), inBox.end() );
+   std::sort( distances.begin(), distances.end() );
+   distances.resize( std::min( distances.size(), static_cast<size_t>(5) ) );
+
+   // same items in the box
+   Array<const OctreeItemTest*> found;
+   octree.queryBox( lower, upper, a, found );
+   std::sort( found.getStorage(), found.getStorage() + found.getLength() );
+   bool isOk = (static_cast<udword>(found.getLength()) == inBox.size()) &&
+      std::equal( inBox.begin(), inBox.end(), found.getStorage() );
+
+   // same nearest distances (to the box's lower corner)
+   Array<real> foundDistances;
+   octree.queryNearest( lower, 5, REAL_MAX, a, found, foundDistances );
+   isOk &= (static_cast<udword>(foundDistances.getLength()) ==
+      distances.size()) && std::equal( distances.begin(), distances.end(),
+      foundDistances.getStorage() );
+
+   // same ray hit (from the box's lower corner)
+   real foundT = 0.0f;
+   octree.queryRay( lower, direction, REAL_MAX, a, foundT );
+   isOk &= (foundT == hitT);
 
-      // remove items
-      OctreeAgentTest a;
-      for( udword i = 0;  i < i1.size();  ++i )
-      {
-         po1->remove( i1[i], a );
+   return isOk;
+}
 
-//       // only for 10 or so items (otherwise > 14MB of output)
-//       if( pOut && isVerbose )
-//       {
-//          OctreeStreamOut<OctreeItemTest> so( *pOut, false );
-//          po1->visit( so );
-//       }
-      }
 
-      // check octree info data is all 'zero'
-      //dword byteSize, leafCount, itemRefCount, maxDepth;
-      po1->getInfo( byteSize, leafCount, itemRefCount, maxDepth );
-      isOk &= (leafCount == 0);
-      isOk &= (itemRefCount == 0);
-      isOk &= (maxDepth == 0);
-      isOk &= po1->isEmpty();
+template<class OCTREE>
+bool isBranchsOver
+(
+   const OCTREE& octree,
+   const dword   itemRefCount
+)
+{
+   OctreeVisitorStatsTest v;
+   octree.visit( v );
 
-      if( pOut )
+   return v.getMinBranchRefCount() > itemRefCount;
+}
+
+
+template<class OCTREE>
+bool isRefCounted
+(
+   const OCTREE& octree
+)
+{
+   OctreeVisitorStatsTest v;
+   octree.visit( v );
+
+   return v.isRefCountsRight();
+}
+
+
+template<class OCTREE>
+bool isInLooseBounds
+(
+   const OCTREE& octree
+)
+{
+   bool isOk = true;
+
+   OctreeVisitorTest v( octree );
+   octree.visit( v );
+
+   // each item held below the root is within its cell expanded by the
+   // looseness, about the center (give or take rounding)
+   for( dword b = 2;  b-- > 0; )
+   {
+      const std::vector<OctreeVisitorTest::LeafData>& cells( b ?
+         v.getBranchItems() : v.getLeafs() );
+      for( udword i = 0;  i < cells.size();  ++i )
       {
-         *pOut << j << " " << isOk << "\n";
+         const OctreeBound& bound  = cells[i].first.getBound();
+         const real         margin = bound.getSize() *
+            (((octree.getLooseness() - 1.0f) * 0.5f) + 1e-5f);
+
+         const Array<const OctreeItemTest*>& items( cells[i].second );
+         for( dword j = 0;  (j < items.getLength()) &&
+            (cells[i].first.getLevel() > 0);  ++j )
+         {
+            const Vector3r lower( items[j]->getPosition() );
+            const Vector3r upper( lower + items[j]->getDimensions() );
+            for( int k = 3;  k-- > 0; )
+            {
+               isOk &= (lower[k] >= (bound.getLowerCorner()[k] - margin)) &&
+                  (upper[k] <= (bound.getUpperCorner()[k] + margin));
+            }
+         }
       }
    }
 
-   if( pOut )
-   {
-      *pOut << "\n--- testCommands2: " << isOk << "\n";
-   }
+   return isOk;
+}
 
 
-   return isOk;
+void destroySlotTest
+(
+   void* pSlot
+)
+{
+   // count, by the second word (the first links the free list, when freed)
+   ++*static_cast<dword**>( pSlot )[1];
 }
 
 
-bool testCommands3
+bool isSharingAll
 (
-   std::ostream* ,//pOut,
-   const bool    ,//isVerbose,
-   const dword   //seed
+   const Octree<OctreeItemTest>& o1,
+   const Octree<OctreeItemTest>& o2
 )
 {
-   // Structural conformance postconditions:
-   //
-   // Randomly insert and remove many random points, one at a time.
-   // After each command, check structure of octree:
-   // * after insertion, the octree is (one of):
-   //    * same, or
-   //    * one leaf holding one more item, or
-   //    * one leaf has changed to a branch containing 1-8 leafs and 0-7 nils,
-   //      or
-   //    * one leaf has changed to 0-n levels of branchs of one subcell, and
-   //      either 2-8 leafs, or one leaf at max level
-   // * after removal, the octree is (one of):
-   //    * same, or
-   //    * one leaf holding one less item, or
-   //    * one leaf has changed to nil, or
-   //    * eight leafs have disappeared, and their direct parent branch has
-   //      changed to a leaf, or
-   //    * one leaf has disappeared, one of its parent branchs has changed to
-   //      nil, and any branchs between have disappeared
+   // same object ids, but for the octrees' own
+   OctreeVisitorTest v1( o1 );
+   o1.visit( v1 );
+   OctreeVisitorTest v2( o2 );
+   o2.visit( v2 );
 
+   return (v1.getIds().size() == v2.getIds().size()) &&
+      std::equal( v1.getIds().begin() + 1, v1.getIds().end(),
+         v2.getIds().begin() + 1 );
+}
+
+
+template<class AGENT_STATIC, class AGENT>
+bool testStockAgent
+(
+   RandomFast& rand,
+   const dword i
+)
+{
    bool isOk = true;
-/*
-   if( pOut )
+
+   const AGENT_STATIC s;
+   const AGENT        a;
+
+   // subcell overlaps, against single-cell overlaps
+   for( dword j = 0;  j < 100;  ++j )
    {
-      *pOut << "\n\n";
+      const real size = rand.next().getFloat( 4.0f, 0.01f );
+      const Vector3r lower( Vector3r( rand.next().getFloat(),
+         rand.next().getFloat(), rand.next().getFloat() ) * 4.0f -
+         (Vector3r::ONE() * 2.0f) );
+      const Vector3r middle( lower + (Vector3r::ONE() * (size * 0.5f)) );
+      const Vector3r upper ( lower + (Vector3r::ONE() * size) );
+      const Vector3r* bounds[] = { &lower, &middle, &upper };
+
+      // some coordinates on a lower, middle, or upper plane
+      real center[3];
+      for( int k = 3;  k-- > 0; )
+      {
+         const dword plane = rand.next().getUdword() % 6;
+         center[k] = (plane < 3) ? (*bounds[plane])[k] : lower[k] +
+            rand.next().getFloat( size * 2.0f, size * -0.5f );
+      }
+      const real radius = (j & 3) ? rand.next().getFloat( size * 0.6f ) :
+         0.0f;
+      const OctreeShapeItemTest item( Vector3r( center[0], center[1],
+         center[2] ), radius );
+
+      dword expected = 0;
+      for( dword m = 8;  m-- > 0; )
+      {
+         const Vector3r subLower( bounds[m & 1]->getX(),
+            bounds[(m >> 1) & 1]->getY(), bounds[(m >> 2) & 1]->getZ() );
+         const Vector3r subUpper( bounds[(m & 1) + 1]->getX(),
+            bounds[((m >> 1) & 1) + 1]->getY(),
+            bounds[((m >> 2) & 1) + 1]->getZ() );
+         expected |= static_cast<dword>(s.isOverlappingCell( item, subLower,
+            subUpper )) << m;
+      }
+
+      isOk &= (s.getSubcellOverlaps( item, lower, middle, upper ) ==
+         expected) && (a.getSubcellOverlapsV( &item, lower, middle, upper ) ==
+         expected);
+
+#ifdef OCTREE_SSE
+      // the SSE kernels, against the scalar ones, for every shape
+      const Vector3r itemLower( item.getLowerCorner() );
+      const Vector3r itemUpper( item.getUpperCorner() );
+      isOk &= (OctreeShape::getSubcellOverlapsPointSse( item.getCenter(),
+         lower, middle, upper ) == OctreeShape::getSubcellOverlapsPointScalar(
+         item.getCenter(), lower, middle, upper )) &&
+         (OctreeShape::getSubcellOverlapsBoxSse( itemLower, itemUpper, lower,
+         middle, upper ) == OctreeShape::getSubcellOverlapsBoxScalar(
+         itemLower, itemUpper, lower, middle, upper )) &&
+         (OctreeShape::getSubcellOverlapsSphereSse( item.getCenter(), radius,
+         lower, middle, upper ) == OctreeShape::getSubcellOverlapsSphereScalar(
+         item.getCenter(), radius, lower, middle, upper ));
+#endif
    }
 
-   RandomFast rand( seed );
-   if( pOut )
+   // make octrees, of random format, and items (within the root)
+   const Vector3r position( rand.next().getFloat( 2.0f, -1.0f ),
+      rand.next().getFloat( 2.0f, -1.0f ),
+      rand.next().getFloat( 2.0f, -1.0f ) );
+   const real  size     = rand.next().getFloat( 4.0f, 0.5f );
+   const dword maxItems = (rand.next().getUdword() % 8) + 1;
+   const dword maxLevel = (rand.next().getUdword() % 10) + 1;
+   Octree<OctreeShapeItemTest>                       o1( position, size,
+      maxItems, maxLevel, 0.0f );
+   OctreeStatic<OctreeShapeItemTest, AGENT_STATIC> o2( position, size,
+      maxItems, maxLevel, 0.0f );
+
+   std::vector<OctreeShapeItemTest> items( (i & 2) ? 500 : 50 );
+   for( udword j = 0;  j < items.size();  ++j )
    {
-      *pOut << "\nseed= " << rand.getDword() << "\n\n";
+      items[j] = OctreeShapeItemTest( position + (Vector3r(
+         rand.next().getFloat(), rand.next().getFloat(),
+         rand.next().getFloat() ) * (size * 0.9f)) +
+         (Vector3r::ONE() * (size * 0.05f)),
+         rand.next().getFloat( size * 0.05f ) );
    }
+   o1.insertRange( &items[0], items.size(), a );
+   o2.insertRange( &items[0], items.size(), s );
 
-
-   if( pOut )
+   Array<const OctreeShapeItemTest*> found;
+   Array<real>                       distances;
+   for( dword j = 0;  j < 10;  ++j )
    {
-      *pOut << "\n--- testCommands3: " << isOk << "\n";
+      // box query
+      real box[2][3];
+      for( int k = 3;  k-- > 0; )
+      {
+         const real p0 = rand.next().getFloat() * size;
+         const real p1 = rand.next().getFloat() * size;
+         box[0][k] = position[k] + ((p0 < p1) ? p0 : p1);
+         box[1][k] = position[k] + ((p0 < p1) ? p1 : p0);
+      }
+      const Vector3r lower( box[0][0], box[0][1], box[0][2] );
+      const Vector3r upper( box[1][0], box[1][1], box[1][2] );
+
+      std::vector<const OctreeShapeItemTest*> expected;
+      for( udword k = 0;  k < items.size();  ++k )
+      {
+         if( s.isOverlappingCell( items[k], lower, upper ) )
+         {
+            expected.push_back( &items[k] );
+         }
+      }
+      std::sort( expected.begin(), expected.end() );
+
+      for( dword k = 0;  k < 2;  ++k )
+      {
+         if( 0 == k )
+         {
+            o1.queryBox( lower, upper, a, found );
+         }
+         else
+         {
+            o2.queryBox( lower, upper, s, found );
+         }
+         isOk &= (found.getLength() == static_cast<dword>(expected.size())) &&
+            std::equal( expected.begin(), expected.end(), found.getStorage() );
+      }
+
+      // nearest query, and ray query (from the box's lower corner)
+      std::vector<real> scanned( items.size() );
+      real              hitExpected = REAL_MAX;
+      const Vector3r direction( (upper - lower) / (upper - lower).length() );
+      for( udword k = 0;  k < items.size();  ++k )
+      {
+         scanned[k] = s.getDistance( items[k], lower );
+         const real t = s.getRayIntersection( items[k], lower, direction );
+         hitExpected = (t < hitExpected) ? t : hitExpected;
+      }
+      const dword nearestK = 5;
+      std::partial_sort( scanned.begin(), scanned.begin() + nearestK,
+         scanned.end() );
+
+      for( dword k = 0;  k < 2;  ++k )
+      {
+         real hitT = 0.0f;
+         if( 0 == k )
+         {
+            o1.queryNearest( lower, nearestK, REAL_MAX, a, found, distances );
+            o1.queryRay( lower, direction, REAL_MAX, a, hitT );
+         }
+         else
+         {
+            o2.queryNearest( lower, nearestK, REAL_MAX, s, found, distances );
+            o2.queryRay( lower, direction, REAL_MAX, s, hitT );
+         }
+         isOk &= (distances.getLength() == nearestK) && std::equal(
+            scanned.begin(), scanned.begin() + nearestK,
+            distances.getStorage() ) && (hitT == hitExpected);
+      }
    }
-*/
+
    return isOk;
 }
 
@@ -1088,6 +6928,66 @@ void makeRandomItems
 }
 
 
+template<class OCTREE1, class OCTREE2>
+bool isSameLeafs
+(
+   const OCTREE1& o1,
+   const OCTREE2& o2,
+   const bool     isSameByteSize
+)
+{
+   bool isOk = true;
+
+   // compare info
+   dword info1[4];
+   dword info2[4];
+   o1.getInfo( info1[0], info1[1], info1[2], info1[3] );
+   o2.getInfo( info2[0], info2[1], info2[2], info2[3] );
+   for( int k = 4;  k-- > 0; )
+   {
+      isOk &= (info1[k] == info2[k]) | ((0 == k) & !isSameByteSize);
+   }
+
+   // compare leafs (item order within a leaf is not significant)
+   OctreeVisitorTest v1( o1 );
+   o1.visit( v1 );
+   OctreeVisitorTest v2( o2 );
+   o2.visit( v2 );
+   isOk &= isSameCellItems( v1.getLeafs(), v2.getLeafs() );
+
+   return isOk;
+}
+
+
+bool isSameCellItems
+(
+   const std::vector<OctreeVisitorTest::LeafData>& l1,
+   const std::vector<OctreeVisitorTest::LeafData>& l2
+)
+{
+   bool isOk = (l1.size() == l2.size());
+
+   for( udword j = (l1.size() < l2.size()) ? l1.size() : l2.size();  j-- > 0; )
+   {
+      isOk &= (l1[j].first.getLevel() == l2[j].first.getLevel());
+      isOk &= (l1[j].first.getBound().getLowerCorner() ==
+         l2[j].first.getBound().getLowerCorner());
+
+      const Array<const OctreeItemTest*>& a1( l1[j].second );
+      const Array<const OctreeItemTest*>& a2( l2[j].second );
+      std::vector<const OctreeItemTest*> s1( a1.getStorage(),
+         a1.getStorage() + a1.getLength() );
+      std::vector<const OctreeItemTest*> s2( a2.getStorage(),
+         a2.getStorage() + a2.getLength() );
+      std::sort( s1.begin(), s1.end() );
+      std::sort( s2.begin(), s2.end() );
+      isOk &= (s1 == s2);
+   }
+
+   return isOk;
+}
+
+
 
 
 
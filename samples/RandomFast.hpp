@@ -0,0 +1,146 @@
+/*------------------------------------------------------------------------------
+
+   Octree Component, version 2.1
+   Copyright (c) 2004-2007,  Harrison Ainsworth / HXA7241.
+
+   http://www.hxa7241.org/
+
+------------------------------------------------------------------------------*/
+
+/*------------------------------------------------------------------------------
+
+Copyright (c) 2004-2007, Harrison Ainsworth / HXA7241.
+
+Redistribution and use in source and binary forms, with or without modification,
+are permitted provided that the following conditions are met:
+
+* Redistributions of source code must retain the above copyright notice, this
+  list of conditions and the following disclaimer.
+* Redistributions in binary form must reproduce the above copyright notice, this
+  list of conditions and the following disclaimer in the documentation and/or
+  other materials provided with the distribution.
+* The name of the author may not be used to endorse or promote products derived
+  from this software without specific prior written permission.
+
+THIS SOFTWARE IS PROVIDED BY THE AUTHOR "AS IS" AND ANY EXPRESS OR IMPLIED
+WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT
+SHALL THE AUTHOR BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT
+OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING
+IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY
+OF SUCH DAMAGE.
+
+------------------------------------------------------------------------------*/
+
+
+#ifndef RandomFast_h
+#define RandomFast_h
+
+
+#include <string.h>
+
+#include "Primitives.hpp"
+
+
+
+
+namespace hxa7241_graphics
+{
+   using namespace hxa7241;
+
+
+/**
+ * Quick pseudo-random numbers, for the samples: a linear congruential
+ * sequence, so a seed always gives the same numbers.<br/><br/>
+ *
+ * getFloat is 0 to 1 (23 bits, from the low bits of the value).
+ */
+class RandomFast
+{
+public:
+/// standard object services ---------------------------------------------------
+   explicit RandomFast( const dword seed =0 )
+    : random_m( seed )
+   {
+   }
+
+   ~RandomFast()
+   {
+   }
+
+   RandomFast( const RandomFast& other )
+    : random_m( other.random_m )
+   {
+   }
+
+   RandomFast& operator=( const RandomFast& other )
+   {
+      random_m = other.random_m;
+
+      return *this;
+   }
+
+
+/// commands -------------------------------------------------------------------
+   RandomFast& setSeed( const dword seed )
+   {
+      random_m = seed;
+
+      return *this;
+   }
+
+   RandomFast& next()
+   {
+      random_m = static_cast<dword>(1664525) * random_m +
+         static_cast<dword>(1013904223);
+
+      return *this;
+   }
+
+
+/// queries --------------------------------------------------------------------
+   dword getDword()                                                       const
+   {
+      return random_m;
+   }
+
+   udword getUdword()                                                     const
+   {
+      return static_cast<udword>(random_m);
+   }
+
+   float getFloat()                                                       const
+   {
+      // the low bits as a mantissa, of a float from 1 to 2
+      const dword bits = static_cast<dword>(0x3F800000) |
+         (static_cast<dword>(0x007FFFFF) & random_m);
+      float       f;
+      ::memcpy( &f, &bits, sizeof(f) );
+
+      return f - 1.0f;
+   }
+
+   float getFloat( const float scale,
+                   const float displace = 0.0f )                          const
+   {
+      return getFloat() * scale + displace;
+   }
+
+
+/// fields ---------------------------------------------------------------------
+private:
+   // current value of sequence and seed of the following part of the sequence
+   dword random_m;
+};
+
+
+
+}//namespace
+
+
+
+
+#endif//RandomFast_h